@@ -33,6 +33,14 @@
 #include <linux/nospec.h>
 #include <linux/mutex.h>
 #include <linux/version.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include <crypto/rng.h>
 #include <crypto/hash.h>
 #include <linux/platform/tegra/common.h>
@@ -53,6 +61,8 @@
 #define MAX_RSA_MSG_LEN 256
 #define MAX_RSA1_MSG_LEN 512
 #define AES_IV_SIZE 16
+#define NUM_SHA_ALGO (SHA512 + 1)
+#define TEGRA_CRYPTO_RING_MAX_BUF_SIZE SZ_16M
 
 #define get_driver_name(tfm_type, tfm) crypto_tfm_alg_driver_name(tfm_type ## _tfm(tfm))
 
@@ -81,6 +91,63 @@ struct tegra_crypto_ctx {
 	int use_ssk;
 	bool skip_exit;
 	struct mutex lock;
+	struct tegra_crypto_ring *ring;
+};
+
+/* Pinned user buffer referenced by ring entries */
+struct tegra_crypto_ring_buf {
+	struct page **pages;
+	unsigned int nr_pages;
+	unsigned int offset;	/* offset of the user address in pages[0] */
+	u64 len;
+	atomic_t users;		/* in-flight ops using this buffer */
+};
+
+/* AES tfm shared by all ring ops of one mode */
+struct tegra_crypto_ring_aes {
+	struct crypto_skcipher *tfm;
+	u8 key[TEGRA_CRYPTO_MAX_KEY_SIZE];
+	unsigned int keylen;
+	atomic_t inflight;
+};
+
+struct tegra_crypto_ring {
+	void *mem;		/* vmalloc_user area mapped by user space */
+	size_t size;
+	struct tegra_crypto_ring_hdr *hdr;
+	struct tegra_crypto_sqe *sqes;
+	struct tegra_crypto_cqe *cqes;
+	u32 sq_entries;
+	u32 cq_entries;
+	/* private copies, user space may scribble over the shared header */
+	u32 sq_head;
+	u32 cq_tail;
+	/* Lock to protect CQ posting */
+	spinlock_t cq_lock;
+	wait_queue_head_t cq_wait;
+	wait_queue_head_t idle_wait;
+	atomic_t inflight;
+	struct eventfd_ctx *eventfd;
+	struct tegra_crypto_ring_aes aes[TEGRA_CRYPTO_MAX];
+	struct crypto_ahash *sha_tfm[NUM_SHA_ALGO];
+	struct tegra_crypto_ring_buf bufs[TEGRA_CRYPTO_RING_MAX_BUFS];
+};
+
+struct tegra_crypto_ring_op {
+	struct tegra_crypto_ring *ring;
+	struct tegra_crypto_ring_aes *aes;
+	struct tegra_crypto_ring_buf *src_buf;
+	struct tegra_crypto_ring_buf *dst_buf;
+	struct skcipher_request *skreq;
+	struct ahash_request *hreq;
+	u64 user_data;
+	struct scatterlist *src_sg;
+	struct scatterlist *dst_sg;
+	unsigned int dst_nents;
+	unsigned int digest_len;
+	u8 iv[TEGRA_CRYPTO_IV_SIZE];
+	u8 digest[HASH_MAX_DIGESTSIZE];
+	struct scatterlist sg[];
 };
 
 struct tegra_crypto_completion {
@@ -149,6 +216,8 @@ static void free_bufs(unsigned long *buf[NBUFS])
 		free_page((unsigned long)buf[i]);
 }
 
+static void tegra_crypto_ring_free(struct tegra_crypto_ring *ring);
+
 static int tegra_crypto_dev_open(struct inode *inode, struct file *filp)
 {
 	struct tegra_crypto_ctx *ctx;
@@ -192,6 +261,11 @@ static int tegra_crypto_dev_release(struct inode *inode, struct file *filp)
 	static struct crypto_skcipher *store_tfm[
 					TEGRA_CRYPTO_AES_TEST_KEYSLOTS];
 
+	if (ctx->ring) {
+		tegra_crypto_ring_free(ctx->ring);
+		ctx->ring = NULL;
+	}
+
 	/* Only when skip_exit is false, the concerned tfm is freed,
 	 * else it is just saved in store_tfm that is freed later
 	 */
@@ -239,6 +313,19 @@ static void tegra_crypt_complete(struct crypto_async_request *req, int err)
 	}
 }
 
+static bool tegra_crypto_aes_keylen_valid(unsigned int keylen)
+{
+	switch (keylen & CRYPTO_KEY_LEN_MASK) {
+	case TEGRA_CRYPTO_KEY_128_SIZE:
+	case TEGRA_CRYPTO_KEY_192_SIZE:
+	case TEGRA_CRYPTO_KEY_256_SIZE:
+	case TEGRA_CRYPTO_KEY_512_SIZE:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static int process_crypt_req(struct tegra_crypto_ctx *ctx,
 			     struct tegra_crypt_req *crypt_req)
 {
@@ -290,14 +377,7 @@ static int process_crypt_req(struct tegra_crypto_ctx *ctx,
 		goto process_req_out;
 	}
 
-	if (((crypt_req->keylen &
-		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_128_SIZE) &&
-		((crypt_req->keylen &
-		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_192_SIZE) &&
-		((crypt_req->keylen &
-		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_256_SIZE) &&
-		((crypt_req->keylen &
-		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_512_SIZE)) {
+	if (!tegra_crypto_aes_keylen_valid(crypt_req->keylen)) {
 		ret = -EINVAL;
 		pr_err("crypt_req keylen invalid");
 		goto process_req_out;
@@ -1534,6 +1614,566 @@ out_alloc:
 	return ret;
 }
 
+static void tegra_crypto_ring_unpin(struct page **pages,
+				    unsigned int nr_pages, bool dirty)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+	unpin_user_pages_dirty_lock(pages, nr_pages, dirty);
+#else
+	unsigned int i;
+
+	for (i = 0; i < nr_pages; i++) {
+		if (dirty)
+			set_page_dirty_lock(pages[i]);
+		put_page(pages[i]);
+	}
+#endif
+}
+
+/*
+ * Post one CQ entry. Every SQ entry consumed by RING_ENTER ends up here
+ * exactly once, either from the crypto completion callback or directly
+ * when the entry is rejected. May be called from atomic context.
+ */
+static void tegra_crypto_ring_complete(struct tegra_crypto_ring *ring,
+				       u64 user_data, int result, const u8 *iv)
+{
+	struct tegra_crypto_cqe *cqe;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ring->cq_lock, flags);
+	if (ring->cq_tail - READ_ONCE(ring->hdr->cq_head) >=
+	    ring->cq_entries) {
+		/* only possible if user space moved cq_head backwards */
+		ring->hdr->cq_overflow++;
+	} else {
+		cqe = &ring->cqes[ring->cq_tail & (ring->cq_entries - 1)];
+		cqe->user_data = user_data;
+		cqe->result = result;
+		cqe->reserved = 0;
+		if (iv)
+			memcpy(cqe->iv, iv, TEGRA_CRYPTO_IV_SIZE);
+		else
+			memset(cqe->iv, 0, TEGRA_CRYPTO_IV_SIZE);
+		ring->cq_tail++;
+		smp_store_release(&ring->hdr->cq_tail, ring->cq_tail);
+	}
+
+	if (ring->eventfd)
+		eventfd_signal(ring->eventfd, 1);
+	wake_up_interruptible(&ring->cq_wait);
+
+	/* ring teardown syncs on cq_lock after inflight drops to zero */
+	atomic_dec(&ring->inflight);
+	wake_up(&ring->idle_wait);
+	spin_unlock_irqrestore(&ring->cq_lock, flags);
+}
+
+static void tegra_crypto_ring_op_finish(struct tegra_crypto_ring_op *op,
+					int err)
+{
+	struct tegra_crypto_ring *ring = op->ring;
+
+	if (op->skreq) {
+		skcipher_request_free(op->skreq);
+		atomic_dec(&op->aes->inflight);
+	}
+
+	if (op->hreq) {
+		if (!err)
+			sg_pcopy_from_buffer(op->dst_sg, op->dst_nents,
+					     op->digest, op->digest_len, 0);
+		ahash_request_free(op->hreq);
+	}
+
+	atomic_dec(&op->src_buf->users);
+	atomic_dec(&op->dst_buf->users);
+
+	tegra_crypto_ring_complete(ring, op->user_data, err,
+				   op->skreq ? op->iv : NULL);
+	kfree(op);
+}
+
+static void tegra_crypto_ring_op_done(struct crypto_async_request *req,
+				      int err)
+{
+	struct tegra_crypto_ring_op *op = req->data;
+
+	/* backlogged request has been moved to the queue */
+	if (err == -EINPROGRESS)
+		return;
+
+	tegra_crypto_ring_op_finish(op, err);
+}
+
+static struct tegra_crypto_ring_buf *tegra_crypto_ring_get_buf(
+	struct tegra_crypto_ring *ring, u32 index, u32 off, u32 len,
+	unsigned int *nents)
+{
+	struct tegra_crypto_ring_buf *buf;
+
+	if (index >= TEGRA_CRYPTO_RING_MAX_BUFS || !len)
+		return ERR_PTR(-EINVAL);
+
+	index = array_index_nospec(index, TEGRA_CRYPTO_RING_MAX_BUFS);
+	buf = &ring->bufs[index];
+	if (!buf->pages || off > buf->len || len > buf->len - off)
+		return ERR_PTR(-EINVAL);
+
+	*nents = DIV_ROUND_UP(offset_in_page(buf->offset + off) + len,
+			      PAGE_SIZE);
+
+	return buf;
+}
+
+static void tegra_crypto_ring_buf_sg(struct tegra_crypto_ring_buf *buf,
+				     u32 off, u32 len, struct scatterlist *sg,
+				     unsigned int nents)
+{
+	u64 pos = (u64)buf->offset + off;
+	unsigned int idx = pos >> PAGE_SHIFT;
+	unsigned int poff = offset_in_page(pos);
+	unsigned int i, seg;
+
+	sg_init_table(sg, nents);
+	for (i = 0; i < nents; i++) {
+		seg = min_t(u32, len, PAGE_SIZE - poff);
+		sg_set_page(&sg[i], buf->pages[idx++], seg, poff);
+		len -= seg;
+		poff = 0;
+	}
+}
+
+/* Validate the buffer references of an SQ entry and build its sg lists */
+static struct tegra_crypto_ring_op *tegra_crypto_ring_op_alloc(
+	struct tegra_crypto_ring *ring, const struct tegra_crypto_sqe *sqe,
+	u32 dst_len)
+{
+	struct tegra_crypto_ring_buf *src, *dst;
+	struct tegra_crypto_ring_op *op;
+	unsigned int src_nents, dst_nents;
+	bool in_place;
+
+	src = tegra_crypto_ring_get_buf(ring, sqe->src_buf, sqe->src_off,
+					sqe->len, &src_nents);
+	if (IS_ERR(src))
+		return ERR_CAST(src);
+
+	dst = tegra_crypto_ring_get_buf(ring, sqe->dst_buf, sqe->dst_off,
+					dst_len, &dst_nents);
+	if (IS_ERR(dst))
+		return ERR_CAST(dst);
+
+	in_place = src == dst && sqe->src_off == sqe->dst_off &&
+		   sqe->len == dst_len;
+
+	op = kzalloc(struct_size(op, sg, src_nents +
+				 (in_place ? 0 : dst_nents)), GFP_KERNEL);
+	if (!op)
+		return ERR_PTR(-ENOMEM);
+
+	op->ring = ring;
+	op->user_data = sqe->user_data;
+	op->src_buf = src;
+	op->dst_buf = dst;
+	op->src_sg = op->sg;
+	tegra_crypto_ring_buf_sg(src, sqe->src_off, sqe->len, op->src_sg,
+				 src_nents);
+	if (in_place) {
+		op->dst_sg = op->src_sg;
+	} else {
+		op->dst_sg = op->sg + src_nents;
+		tegra_crypto_ring_buf_sg(dst, sqe->dst_off, dst_len,
+					 op->dst_sg, dst_nents);
+	}
+	op->dst_nents = dst_nents;
+
+	atomic_inc(&src->users);
+	atomic_inc(&dst->users);
+
+	return op;
+}
+
+static void tegra_crypto_ring_op_free(struct tegra_crypto_ring_op *op)
+{
+	atomic_dec(&op->src_buf->users);
+	atomic_dec(&op->dst_buf->users);
+	kfree(op);
+}
+
+static int tegra_crypto_ring_submit_aes(struct tegra_crypto_ring *ring,
+					const struct tegra_crypto_sqe *sqe)
+{
+	static const char * const aes_algo[] = {
+		"ecb(aes)", "cbc(aes)", "ofb(aes)", "ctr(aes)", "xts(aes)"
+	};
+	struct tegra_crypto_ring_aes *aes;
+	struct tegra_crypto_ring_op *op;
+	struct crypto_skcipher *tfm;
+	struct skcipher_request *req;
+	unsigned int mode, keylen;
+	int ret;
+
+	if (sqe->mode >= TEGRA_CRYPTO_MAX ||
+	    !tegra_crypto_aes_keylen_valid(sqe->keylen))
+		return -EINVAL;
+
+	mode = array_index_nospec(sqe->mode, TEGRA_CRYPTO_MAX);
+	keylen = sqe->keylen & CRYPTO_KEY_LEN_MASK;
+	aes = &ring->aes[mode];
+
+	if (!aes->tfm) {
+		tfm = crypto_alloc_skcipher(aes_algo[mode],
+			CRYPTO_ALG_TYPE_SKCIPHER | CRYPTO_ALG_ASYNC, 0);
+		if (IS_ERR(tfm)) {
+			pr_err("Failed to load transform for %s: %ld\n",
+				aes_algo[mode], PTR_ERR(tfm));
+			return PTR_ERR(tfm);
+		}
+		aes->tfm = tfm;
+	}
+
+	/* The key lives in the tfm, drain its users before changing it */
+	if (aes->keylen != sqe->keylen || memcmp(aes->key, sqe->key, keylen)) {
+		wait_event(ring->idle_wait, !atomic_read(&aes->inflight));
+
+		aes->keylen = 0;
+		crypto_skcipher_clear_flags(aes->tfm, ~0);
+		ret = crypto_skcipher_setkey(aes->tfm, sqe->key, sqe->keylen);
+		if (ret < 0) {
+			pr_err("setkey failed");
+			return ret;
+		}
+		memcpy(aes->key, sqe->key, keylen);
+		aes->keylen = sqe->keylen;
+	}
+
+	op = tegra_crypto_ring_op_alloc(ring, sqe, sqe->len);
+	if (IS_ERR(op))
+		return PTR_ERR(op);
+
+	req = skcipher_request_alloc(aes->tfm, GFP_KERNEL);
+	if (!req) {
+		tegra_crypto_ring_op_free(op);
+		return -ENOMEM;
+	}
+
+	memcpy(op->iv, sqe->iv, TEGRA_CRYPTO_IV_SIZE);
+	op->skreq = req;
+	op->aes = aes;
+	atomic_inc(&aes->inflight);
+
+	skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_crypto_ring_op_done, op);
+	skcipher_request_set_crypt(req, op->src_sg, op->dst_sg, sqe->len,
+				   op->iv);
+
+	ret = sqe->opcode == TEGRA_CRYPTO_RING_OP_AES_ENCRYPT ?
+		crypto_skcipher_encrypt(req) :
+		crypto_skcipher_decrypt(req);
+	if (ret != -EINPROGRESS && ret != -EBUSY)
+		tegra_crypto_ring_op_finish(op, ret);
+
+	return 0;
+}
+
+static int tegra_crypto_ring_submit_sha(struct tegra_crypto_ring *ring,
+					const struct tegra_crypto_sqe *sqe)
+{
+	static const char * const sha_algo[] = {
+		"sha1", "sha224", "sha256", "sha384", "sha512"
+	};
+	struct tegra_crypto_ring_op *op;
+	struct crypto_ahash *tfm;
+	struct ahash_request *req;
+	unsigned int algo;
+	int ret;
+
+	if (sqe->mode >= NUM_SHA_ALGO)
+		return -EINVAL;
+
+	algo = array_index_nospec(sqe->mode, NUM_SHA_ALGO);
+	tfm = ring->sha_tfm[algo];
+	if (!tfm) {
+		tfm = crypto_alloc_ahash(sha_algo[algo], 0, 0);
+		if (IS_ERR(tfm)) {
+			pr_err("alg: hash: Failed to load transform for %s: %ld\n",
+				sha_algo[algo], PTR_ERR(tfm));
+			return PTR_ERR(tfm);
+		}
+		ring->sha_tfm[algo] = tfm;
+	}
+
+	op = tegra_crypto_ring_op_alloc(ring, sqe,
+					crypto_ahash_digestsize(tfm));
+	if (IS_ERR(op))
+		return PTR_ERR(op);
+
+	req = ahash_request_alloc(tfm, GFP_KERNEL);
+	if (!req) {
+		tegra_crypto_ring_op_free(op);
+		return -ENOMEM;
+	}
+
+	op->hreq = req;
+	op->digest_len = crypto_ahash_digestsize(tfm);
+
+	ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_crypto_ring_op_done, op);
+	ahash_request_set_crypt(req, op->src_sg, op->digest, sqe->len);
+
+	ret = crypto_ahash_digest(req);
+	if (ret != -EINPROGRESS && ret != -EBUSY)
+		tegra_crypto_ring_op_finish(op, ret);
+
+	return 0;
+}
+
+/*
+ * Doorbell: consume up to to_submit SQ entries. An entry is only taken
+ * when its completion is guaranteed a free CQ slot, so the CQ can never
+ * overflow while user space keeps cq_head honest.
+ */
+static int tegra_crypto_ring_enter(struct tegra_crypto_ctx *ctx,
+				   u32 to_submit)
+{
+	struct tegra_crypto_ring *ring = ctx->ring;
+	struct tegra_crypto_sqe sqe;
+	u32 avail, used, n;
+	int ret;
+
+	if (!ring)
+		return -EINVAL;
+
+	avail = smp_load_acquire(&ring->hdr->sq_tail) - ring->sq_head;
+	if (avail > ring->sq_entries)
+		return -EINVAL;
+
+	to_submit = min(to_submit, avail);
+	for (n = 0; n < to_submit; n++) {
+		spin_lock_irq(&ring->cq_lock);
+		used = ring->cq_tail - READ_ONCE(ring->hdr->cq_head) +
+			atomic_read(&ring->inflight);
+		if (used >= ring->cq_entries) {
+			spin_unlock_irq(&ring->cq_lock);
+			break;
+		}
+		atomic_inc(&ring->inflight);
+		spin_unlock_irq(&ring->cq_lock);
+
+		/* snapshot the entry, user space may still write to it */
+		memcpy(&sqe, &ring->sqes[ring->sq_head &
+					 (ring->sq_entries - 1)], sizeof(sqe));
+		ring->sq_head++;
+
+		switch (sqe.opcode) {
+		case TEGRA_CRYPTO_RING_OP_AES_ENCRYPT:
+		case TEGRA_CRYPTO_RING_OP_AES_DECRYPT:
+			ret = tegra_crypto_ring_submit_aes(ring, &sqe);
+			break;
+		case TEGRA_CRYPTO_RING_OP_SHA:
+			ret = tegra_crypto_ring_submit_sha(ring, &sqe);
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+
+		if (ret)
+			tegra_crypto_ring_complete(ring, sqe.user_data, ret,
+						   NULL);
+	}
+
+	smp_store_release(&ring->hdr->sq_head, ring->sq_head);
+
+	if (!n && to_submit)
+		return -EBUSY;
+
+	return n;
+}
+
+static int tegra_crypto_ring_setup(struct tegra_crypto_ctx *ctx,
+				   struct tegra_crypto_ring_setup *setup)
+{
+	struct tegra_crypto_ring *ring;
+	u32 sq_off, cq_off;
+	size_t size;
+	int ret;
+
+	if (ctx->ring)
+		return -EBUSY;
+
+	if (!setup->entries ||
+	    setup->entries > TEGRA_CRYPTO_RING_MAX_ENTRIES ||
+	    !is_power_of_2(setup->entries))
+		return -EINVAL;
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+
+	ring->sq_entries = setup->entries;
+	ring->cq_entries = 2 * setup->entries;
+
+	sq_off = ALIGN(sizeof(struct tegra_crypto_ring_hdr), SMP_CACHE_BYTES);
+	cq_off = ALIGN(sq_off + ring->sq_entries *
+		       sizeof(struct tegra_crypto_sqe), SMP_CACHE_BYTES);
+	size = PAGE_ALIGN(cq_off + ring->cq_entries *
+			  sizeof(struct tegra_crypto_cqe));
+
+	ring->mem = vmalloc_user(size);
+	if (!ring->mem) {
+		ret = -ENOMEM;
+		goto free_ring;
+	}
+
+	if (setup->eventfd >= 0) {
+		ring->eventfd = eventfd_ctx_fdget(setup->eventfd);
+		if (IS_ERR(ring->eventfd)) {
+			ret = PTR_ERR(ring->eventfd);
+			goto free_mem;
+		}
+	}
+
+	ring->size = size;
+	ring->hdr = ring->mem;
+	ring->sqes = ring->mem + sq_off;
+	ring->cqes = ring->mem + cq_off;
+	ring->hdr->sq_entries = ring->sq_entries;
+	ring->hdr->cq_entries = ring->cq_entries;
+	spin_lock_init(&ring->cq_lock);
+	init_waitqueue_head(&ring->cq_wait);
+	init_waitqueue_head(&ring->idle_wait);
+
+	setup->sq_off = sq_off;
+	setup->cq_off = cq_off;
+	setup->ring_size = size;
+
+	/* poll() looks at the ring without ctx->lock */
+	smp_store_release(&ctx->ring, ring);
+
+	return 0;
+
+free_mem:
+	vfree(ring->mem);
+free_ring:
+	kfree(ring);
+	return ret;
+}
+
+static void tegra_crypto_ring_free(struct tegra_crypto_ring *ring)
+{
+	struct tegra_crypto_ring_buf *buf;
+	int i;
+
+	wait_event(ring->idle_wait, !atomic_read(&ring->inflight));
+	/* let the last completion leave tegra_crypto_ring_complete() */
+	spin_lock_irq(&ring->cq_lock);
+	spin_unlock_irq(&ring->cq_lock);
+
+	for (i = 0; i < TEGRA_CRYPTO_MAX; i++)
+		if (ring->aes[i].tfm)
+			crypto_free_skcipher(ring->aes[i].tfm);
+
+	for (i = 0; i < NUM_SHA_ALGO; i++)
+		if (ring->sha_tfm[i])
+			crypto_free_ahash(ring->sha_tfm[i]);
+
+	for (i = 0; i < TEGRA_CRYPTO_RING_MAX_BUFS; i++) {
+		buf = &ring->bufs[i];
+		if (buf->pages) {
+			tegra_crypto_ring_unpin(buf->pages, buf->nr_pages,
+						true);
+			kvfree(buf->pages);
+		}
+	}
+
+	if (ring->eventfd)
+		eventfd_ctx_put(ring->eventfd);
+
+	vfree(ring->mem);
+	kfree(ring);
+}
+
+static int tegra_crypto_ring_buf_register(struct tegra_crypto_ctx *ctx,
+					  struct tegra_crypto_buf_reg *reg)
+{
+	struct tegra_crypto_ring *ring = ctx->ring;
+	struct tegra_crypto_ring_buf *buf = NULL;
+	struct page **pages;
+	unsigned int nr_pages, offset;
+	int i, pinned;
+
+	if (!ring)
+		return -EINVAL;
+
+	if (!reg->len || reg->len > TEGRA_CRYPTO_RING_MAX_BUF_SIZE ||
+	    reg->addr + reg->len < reg->addr)
+		return -EINVAL;
+
+	for (i = 0; i < TEGRA_CRYPTO_RING_MAX_BUFS; i++) {
+		if (!ring->bufs[i].pages) {
+			buf = &ring->bufs[i];
+			break;
+		}
+	}
+	if (!buf)
+		return -ENOSPC;
+
+	offset = offset_in_page(reg->addr);
+	nr_pages = DIV_ROUND_UP(offset + reg->len, PAGE_SIZE);
+	pages = kvmalloc_array(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+	pinned = pin_user_pages_fast(reg->addr & PAGE_MASK, nr_pages,
+				     FOLL_WRITE, pages);
+#else
+	pinned = get_user_pages_fast(reg->addr & PAGE_MASK, nr_pages,
+				     FOLL_WRITE, pages);
+#endif
+	if (pinned != nr_pages) {
+		if (pinned > 0)
+			tegra_crypto_ring_unpin(pages, pinned, false);
+		kvfree(pages);
+		return pinned < 0 ? pinned : -EFAULT;
+	}
+
+	buf->nr_pages = nr_pages;
+	buf->offset = offset;
+	buf->len = reg->len;
+	atomic_set(&buf->users, 0);
+	buf->pages = pages;
+	reg->index = i;
+
+	return 0;
+}
+
+static int tegra_crypto_ring_buf_unregister(struct tegra_crypto_ctx *ctx,
+					    struct tegra_crypto_buf_reg *reg)
+{
+	struct tegra_crypto_ring *ring = ctx->ring;
+	struct tegra_crypto_ring_buf *buf;
+
+	if (!ring || reg->index >= TEGRA_CRYPTO_RING_MAX_BUFS)
+		return -EINVAL;
+
+	buf = &ring->bufs[array_index_nospec(reg->index,
+					     TEGRA_CRYPTO_RING_MAX_BUFS)];
+	if (!buf->pages)
+		return -EINVAL;
+
+	if (atomic_read(&buf->users))
+		return -EBUSY;
+
+	tegra_crypto_ring_unpin(buf->pages, buf->nr_pages, true);
+	kvfree(buf->pages);
+	buf->pages = NULL;
+
+	return 0;
+}
+
 static long tegra_crypto_dev_ioctl(struct file *filp,
 	unsigned int ioctl_num, unsigned long arg)
 {
@@ -1548,6 +2188,8 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 	struct tegra_sha_req_shash sha_req_shash;
 	struct tegra_rsa_req rsa_req;
 	struct tegra_rsa_req_ahash rsa_req_ah;
+	struct tegra_crypto_ring_setup ring_setup;
+	struct tegra_crypto_buf_reg buf_reg;
 #ifdef CONFIG_COMPAT
 	struct tegra_crypt_req_32 crypt_req_32;
 	struct tegra_rng_req_32 rng_req_32;
@@ -1994,6 +2636,52 @@ rng1_out:
 		kfree(rng);
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_RING_SETUP:
+		if (copy_from_user(&ring_setup, (void __user *)arg,
+				   sizeof(ring_setup))) {
+			ret = -EFAULT;
+			goto out;
+		}
+
+		ret = tegra_crypto_ring_setup(ctx, &ring_setup);
+		if (ret)
+			goto out;
+
+		if (copy_to_user((void __user *)arg, &ring_setup,
+				 sizeof(ring_setup)))
+			ret = -EFAULT;
+		break;
+
+	case TEGRA_CRYPTO_IOCTL_RING_ENTER:
+		ret = tegra_crypto_ring_enter(ctx, (u32)arg);
+		break;
+
+	case TEGRA_CRYPTO_IOCTL_BUF_REGISTER:
+		if (copy_from_user(&buf_reg, (void __user *)arg,
+				   sizeof(buf_reg))) {
+			ret = -EFAULT;
+			goto out;
+		}
+
+		ret = tegra_crypto_ring_buf_register(ctx, &buf_reg);
+		if (ret)
+			goto out;
+
+		if (copy_to_user((void __user *)arg, &buf_reg,
+				 sizeof(buf_reg)))
+			ret = -EFAULT;
+		break;
+
+	case TEGRA_CRYPTO_IOCTL_BUF_UNREGISTER:
+		if (copy_from_user(&buf_reg, (void __user *)arg,
+				   sizeof(buf_reg))) {
+			ret = -EFAULT;
+			goto out;
+		}
+
+		ret = tegra_crypto_ring_buf_unregister(ctx, &buf_reg);
+		break;
+
 	default:
 		pr_debug("invalid ioctl code(%d)", ioctl_num);
 		ret = -EINVAL;
@@ -2003,10 +2691,50 @@ out:
 	return ret;
 }
 
+static __poll_t tegra_crypto_dev_poll(struct file *filp, poll_table *wait)
+{
+	struct tegra_crypto_ctx *ctx = filp->private_data;
+	struct tegra_crypto_ring *ring;
+
+	ring = ctx ? smp_load_acquire(&ctx->ring) : NULL;
+	if (!ring)
+		return EPOLLERR;
+
+	poll_wait(filp, &ring->cq_wait, wait);
+
+	if (smp_load_acquire(&ring->hdr->cq_tail) !=
+	    READ_ONCE(ring->hdr->cq_head))
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+static int tegra_crypto_dev_mmap(struct file *filp,
+				 struct vm_area_struct *vma)
+{
+	struct tegra_crypto_ctx *ctx = filp->private_data;
+	int ret;
+
+	if (!ctx)
+		return -EPERM;
+
+	mutex_lock(&ctx->lock);
+	if (!ctx->ring || vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start > ctx->ring->size)
+		ret = -EINVAL;
+	else
+		ret = remap_vmalloc_range(vma, ctx->ring->mem, 0);
+	mutex_unlock(&ctx->lock);
+
+	return ret;
+}
+
 static const struct file_operations tegra_crypto_fops = {
 	.owner = THIS_MODULE,
 	.open = tegra_crypto_dev_open,
 	.release = tegra_crypto_dev_release,
+	.poll = tegra_crypto_dev_poll,
+	.mmap = tegra_crypto_dev_mmap,
 	.unlocked_ioctl = tegra_crypto_dev_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl =  tegra_crypto_dev_ioctl,
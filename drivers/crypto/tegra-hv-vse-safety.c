@@ -47,15 +47,34 @@
 #include <linux/tegra-ivc.h>
 #include <linux/iommu.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/dmapool.h>
 #include <linux/interrupt.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/semaphore.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
 #include <linux/version.h>
 
 #define TEGRA_HV_VSE_SHA_MAX_LL_NUM_1				1
 #define TEGRA_HV_VSE_AES_CMAC_MAX_LL_NUM			1
 #define TEGRA_HV_VSE_MAX_TASKS_PER_SUBMIT			1
 #define TEGRA_HV_VSE_TIMEOUT			(msecs_to_jiffies(10000))
+/* Requests that may be outstanding on the IVC channel for one engine */
+#define TEGRA_HV_VSE_ENGINE_MAX_OUTSTANDING		8
+/* AES requests queued per engine while all its credits are in use */
+#define TEGRA_HV_VSE_ENGINE_QUEUE_LEN			64
 #define TEGRA_HV_VSE_SHA_MAX_BLOCK_SIZE				128
+/* Intermediate hash results are allocated from a dma_pool of this size */
+#define TEGRA_HV_VSE_SHA_RESULT_SIZE		(TEGRA_HV_VSE_SHA_MAX_BLOCK_SIZE * 2)
+/* Pre-mapped SHA staging buffers per size class */
+#define TEGRA_HV_VSE_SHA_POOL_SMALL_SIZE			SZ_64K
+#define TEGRA_HV_VSE_SHA_POOL_SMALL_NUM				8
+#define TEGRA_HV_VSE_SHA_POOL_LARGE_SIZE			SZ_4M
+#define TEGRA_HV_VSE_SHA_POOL_LARGE_NUM				1
 #define TEGRA_VIRTUAL_SE_AES_BLOCK_SIZE				16
 #define TEGRA_VIRTUAL_SE_AES_GCM_TAG_SIZE			16
 #define TEGRA_VIRTUAL_SE_AES_MIN_KEY_SIZE			16
@@ -140,8 +159,10 @@ struct tegra_virtual_se_ll {
 	u32 data_len; /* Data length in DMA buffer */
 };
 
+/* Request tag echoed back by the SE server in the IVC header */
 struct tegra_vse_tag {
-	unsigned int *priv_data;
+	u32 slot;
+	u32 seq;
 };
 
 /* Tegra Virtual Security Engine commands */
@@ -196,6 +217,15 @@ struct tegra_vse_priv_data {
 	struct skcipher_request *req;
 	struct tegra_virtual_se_dev *se_dev;
 	struct completion alg_complete;
+	struct tegra_vse_tag tag;
+	/*
+	 * Called instead of completing alg_complete when the submitter
+	 * does not wait for the response. err is 0 when a response was
+	 * received, rx_status then holds the server status.
+	 */
+	void (*complete)(struct tegra_vse_priv_data *priv, int err);
+	struct work_struct complete_work;
+	struct delayed_work timeout_work;
 	int cmd;
 	int slot_num;
 	struct scatterlist sg;
@@ -206,6 +236,40 @@ struct tegra_vse_priv_data {
 	struct tegra_vse_cmac_data cmac;
 };
 
+enum tegra_vse_sha_buf_class {
+	SHA_BUF_SMALL,
+	SHA_BUF_LARGE,
+	SHA_BUF_NUM_CLASSES
+};
+
+/* SHA staging buffer, either from the pool or allocated on pool miss */
+struct tegra_vse_sha_buf {
+	struct list_head node;
+	u8 *buf;
+	dma_addr_t buf_addr;
+	u32 size;
+	enum tegra_vse_sha_buf_class cls;
+	bool pooled;
+};
+
+struct tegra_vse_sha_pool {
+	spinlock_t lock;
+	struct list_head free[SHA_BUF_NUM_CLASSES];
+	u32 num_free[SHA_BUF_NUM_CLASSES];
+	u32 num_total[SHA_BUF_NUM_CLASSES];
+	u32 peak_in_use[SHA_BUF_NUM_CLASSES];
+	u64 hits[SHA_BUF_NUM_CLASSES];
+	u64 misses[SHA_BUF_NUM_CLASSES];
+	u64 alloc_failures;
+	u64 alloc_count;
+	u64 alloc_ns_total;
+	u64 alloc_ns_max;
+	/* Requests hashed by direct DMA from a multi-entry scatterlist */
+	u64 direct_dma;
+	struct dma_pool *result_pool;
+	struct dentry *debugfs;
+};
+
 struct tegra_virtual_se_dev {
 	struct device *dev;
 	struct mutex mtx;
@@ -213,8 +277,16 @@ struct tegra_virtual_se_dev {
 	unsigned int engine_id;
 	/* Engine suspend state */
 	atomic_t se_suspended;
-	/* Mutex lock for SE server */
-	struct mutex server_lock;
+	/* Bounds the number of requests outstanding on this engine */
+	struct semaphore credits;
+	/* Requests sent to the SE server and not completed yet */
+	atomic_t inflight;
+	/* AES requests waiting for a credit, submitted by queue_work */
+	spinlock_t queue_lock;
+	struct crypto_queue queue;
+	struct work_struct queue_work;
+	/* SHA staging buffers, SHA engine only */
+	struct tegra_vse_sha_pool *sha_pool;
 	struct tegra_vse_soc_info *chipdata;
 	atomic_t mempoolbuf_in_use;
 };
@@ -435,10 +507,14 @@ struct tegra_virtual_se_req_context {
 	unsigned int digest_size;
 	unsigned int intermediate_digest_size;
 	u8 mode;			/* SHA operation mode */
+	struct tegra_vse_sha_buf *staging;	/* Backs sha_buf */
 	u8 *sha_buf;			/* Buffer to store residual data */
 	dma_addr_t sha_buf_addr;	/* DMA address to residual data */
 	u8 *hash_result;		/* Intermediate hash result */
 	dma_addr_t hash_result_addr;	/* Intermediate hash result dma addr */
+	u32 hash_result_size;		/* Size of hash_result allocation */
+	bool src_mapped;		/* req->src mapped as one DMA segment */
+	dma_addr_t src_addr;		/* DMA address of mapped req->src */
 	u64 total_count;		/* Total bytes in all the requests */
 	u32 residual_bytes;		/* Residual byte count */
 	u32 blk_size;			/* SHA block size */
@@ -495,14 +571,84 @@ enum tegra_virtual_se_aes_iv_type {
 	AES_IV_REG
 };
 
-/* Lock for IVC channel */
-static DEFINE_MUTEX(se_ivc_lock);
+/* Serialises writes to the IVC channel shared by all engines */
+static DEFINE_SPINLOCK(se_ivc_lock);
+
+#define TEGRA_HV_VSE_MAX_OUTSTANDING \
+	(VIRTUAL_MAX_SE_ENGINE_NUM * TEGRA_HV_VSE_ENGINE_MAX_OUTSTANDING)
+
+/* Outstanding requests indexed by tag slot */
+static DEFINE_SPINLOCK(tegra_vse_tag_lock);
+static struct tegra_vse_priv_data *tegra_vse_tags[TEGRA_HV_VSE_MAX_OUTSTANDING];
+static u32 tegra_vse_tag_seq;
 
 static struct tegra_hv_ivc_cookie *g_ivck;
 static struct tegra_hv_ivm_cookie *g_ivmk;
 static void *mempool_buf;
 static struct tegra_virtual_se_dev *g_virtual_se_dev[VIRTUAL_MAX_SE_ENGINE_NUM];
 static struct completion tegra_vse_complete;
+/* Runs async completions and AES submissions, never the IVC receive thread */
+static struct workqueue_struct *tegra_vse_wq;
+
+static bool standin_server;
+module_param(standin_server, bool, 0444);
+MODULE_PARM_DESC(standin_server,
+	"Answer requests with a local stand-in instead of the SE server");
+
+/*
+ * Local stand-in for the SE server, used with standin_server=1 to test and
+ * benchmark the request path without a hypervisor. Every request completes
+ * successfully and the data is left as is.
+ */
+struct tegra_vse_standin_msg {
+	struct list_head node;
+	struct tegra_virtual_se_ivc_msg_t msg;
+};
+
+static DEFINE_SPINLOCK(tegra_vse_standin_lock);
+static LIST_HEAD(tegra_vse_standin_msgs);
+
+static int tegra_hv_vse_safety_standin_write(void *pbuf, int length)
+{
+	struct tegra_vse_standin_msg *m;
+
+	m = kzalloc(sizeof(*m), GFP_ATOMIC);
+	if (!m)
+		return -ENOMEM;
+
+	memcpy(&m->msg, pbuf, length);
+
+	spin_lock(&tegra_vse_standin_lock);
+	list_add_tail(&m->node, &tegra_vse_standin_msgs);
+	spin_unlock(&tegra_vse_standin_lock);
+
+	complete(&tegra_vse_complete);
+
+	return 0;
+}
+
+/* Returns the size of the response read into @resp, 0 if there is none */
+static int tegra_hv_vse_safety_standin_read(
+	struct tegra_virtual_se_ivc_msg_t *resp)
+{
+	struct tegra_vse_standin_msg *m;
+
+	spin_lock(&tegra_vse_standin_lock);
+	m = list_first_entry_or_null(&tegra_vse_standin_msgs,
+			struct tegra_vse_standin_msg, node);
+	if (m)
+		list_del(&m->node);
+	spin_unlock(&tegra_vse_standin_lock);
+
+	if (!m)
+		return 0;
+
+	memset(resp, 0, sizeof(*resp));
+	resp->ivc_hdr = m->msg.ivc_hdr;
+	kfree(m);
+
+	return sizeof(*resp);
+}
 
 static int tegra_hv_vse_safety_send_ivc(
 	struct tegra_virtual_se_dev *se_dev,
@@ -513,22 +659,28 @@ static int tegra_hv_vse_safety_send_ivc(
 	u32 timeout;
 	int err = 0;
 
-	timeout = TEGRA_VIRTUAL_SE_TIMEOUT_1S;
-	mutex_lock(&se_ivc_lock);
-	while (tegra_hv_ivc_channel_notified(pivck) != 0) {
-		if (!timeout) {
-			mutex_unlock(&se_ivc_lock);
-			dev_err(se_dev->dev, "ivc reset timeout\n");
-			return -EINVAL;
-		}
-		udelay(1);
-		timeout--;
+	if (length > sizeof(struct tegra_virtual_se_ivc_msg_t)) {
+		dev_err(se_dev->dev,
+				"Wrong write msg len %d\n", length);
+		return -E2BIG;
 	}
 
+	if (standin_server)
+		return tegra_hv_vse_safety_standin_write(pbuf, length);
+
+	/*
+	 * Only the write itself is serialised, waiting for the channel
+	 * is done unlocked so one engine does not stall the others.
+	 */
 	timeout = TEGRA_VIRTUAL_SE_TIMEOUT_1S;
-	while (tegra_hv_ivc_can_write(pivck) == 0) {
+	for (;;) {
+		spin_lock(&se_ivc_lock);
+		if (tegra_hv_ivc_channel_notified(pivck) == 0 &&
+				tegra_hv_ivc_can_write(pivck))
+			break;
+		spin_unlock(&se_ivc_lock);
+
 		if (!timeout) {
-			mutex_unlock(&se_ivc_lock);
 			dev_err(se_dev->dev, "ivc send message timeout\n");
 			return -EINVAL;
 		}
@@ -536,23 +688,185 @@ static int tegra_hv_vse_safety_send_ivc(
 		timeout--;
 	}
 
-	if (length > sizeof(struct tegra_virtual_se_ivc_msg_t)) {
-		mutex_unlock(&se_ivc_lock);
-		dev_err(se_dev->dev,
-				"Wrong write msg len %d\n", length);
-		return -E2BIG;
-	}
-
 	err = tegra_hv_ivc_write(pivck, pbuf, length);
+	spin_unlock(&se_ivc_lock);
 	if (err < 0) {
-		mutex_unlock(&se_ivc_lock);
 		dev_err(se_dev->dev, "ivc write error!!! error=%d\n", err);
 		return err;
 	}
-	mutex_unlock(&se_ivc_lock);
+
 	return 0;
 }
 
+static int tegra_hv_vse_safety_tag_attach(struct tegra_vse_priv_data *priv,
+	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr)
+{
+	u32 slot;
+
+	spin_lock(&tegra_vse_tag_lock);
+	for (slot = 0; slot < TEGRA_HV_VSE_MAX_OUTSTANDING; slot++) {
+		if (!tegra_vse_tags[slot])
+			break;
+	}
+	/* Engine credits guarantee a free slot */
+	if (WARN_ON(slot == TEGRA_HV_VSE_MAX_OUTSTANDING)) {
+		spin_unlock(&tegra_vse_tag_lock);
+		return -EBUSY;
+	}
+	tegra_vse_tags[slot] = priv;
+	priv->tag.slot = slot;
+	priv->tag.seq = ++tegra_vse_tag_seq;
+	spin_unlock(&tegra_vse_tag_lock);
+
+	memcpy(ivc_hdr->tag, &priv->tag, sizeof(priv->tag));
+
+	return 0;
+}
+
+/*
+ * Take the request owning @tag out of the tag table. Only one of the
+ * response path and the timeout path gets a non-NULL result, that one
+ * completes the request.
+ */
+static struct tegra_vse_priv_data *tegra_hv_vse_safety_tag_detach(
+	const struct tegra_vse_tag *tag)
+{
+	struct tegra_vse_priv_data *priv = NULL;
+
+	if (tag->slot >= TEGRA_HV_VSE_MAX_OUTSTANDING)
+		return NULL;
+
+	spin_lock(&tegra_vse_tag_lock);
+	if (tegra_vse_tags[tag->slot] &&
+			tegra_vse_tags[tag->slot]->tag.seq == tag->seq) {
+		priv = tegra_vse_tags[tag->slot];
+		tegra_vse_tags[tag->slot] = NULL;
+	}
+	spin_unlock(&tegra_vse_tag_lock);
+
+	return priv;
+}
+
+static void tegra_hv_vse_safety_put_credit(struct tegra_virtual_se_dev *se_dev)
+{
+	atomic_dec(&se_dev->inflight);
+	up(&se_dev->credits);
+}
+
+static void tegra_hv_vse_safety_timeout_worker(struct work_struct *work)
+{
+	struct tegra_vse_priv_data *priv = container_of(to_delayed_work(work),
+			struct tegra_vse_priv_data, timeout_work);
+
+	if (!tegra_hv_vse_safety_tag_detach(&priv->tag))
+		return;
+
+	dev_err(priv->se_dev->dev, "%s: request timeout\n", __func__);
+	tegra_hv_vse_safety_put_credit(priv->se_dev);
+	priv->complete(priv, -ETIMEDOUT);
+}
+
+static void tegra_hv_vse_safety_complete_worker(struct work_struct *work)
+{
+	struct tegra_vse_priv_data *priv = container_of(work,
+			struct tegra_vse_priv_data, complete_work);
+
+	cancel_delayed_work_sync(&priv->timeout_work);
+	priv->complete(priv, 0);
+}
+
+/*
+ * Send @ivc_req_msg tagged with @priv. Up to
+ * TEGRA_HV_VSE_ENGINE_MAX_OUTSTANDING requests per engine may be in
+ * flight, the response is matched back to @priv by tag in the IVC
+ * receive thread. If priv->complete is set it is called from tegra_vse_wq
+ * once the response arrives or the request times out, with the credit
+ * already returned. Otherwise the caller waits with
+ * tegra_hv_vse_safety_wait().
+ */
+static int tegra_hv_vse_safety_submit(struct tegra_virtual_se_dev *se_dev,
+	struct tegra_vse_priv_data *priv,
+	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg)
+{
+	int err;
+
+	/* Return error if engine is in suspended state */
+	if (atomic_read(&se_dev->se_suspended))
+		return -ENODEV;
+
+	down(&se_dev->credits);
+	atomic_inc(&se_dev->inflight);
+
+	priv->se_dev = se_dev;
+	init_completion(&priv->alg_complete);
+	err = tegra_hv_vse_safety_tag_attach(priv, &ivc_req_msg->ivc_hdr);
+	if (err)
+		goto put_credit;
+
+	if (priv->complete) {
+		INIT_WORK(&priv->complete_work,
+				tegra_hv_vse_safety_complete_worker);
+		INIT_DELAYED_WORK(&priv->timeout_work,
+				tegra_hv_vse_safety_timeout_worker);
+		schedule_delayed_work(&priv->timeout_work,
+				TEGRA_HV_VSE_TIMEOUT);
+	}
+
+	vse_thread_start = true;
+	err = tegra_hv_vse_safety_send_ivc(se_dev, g_ivck, ivc_req_msg,
+			sizeof(struct tegra_virtual_se_ivc_msg_t));
+	if (err) {
+		/* Already completed by the timeout worker */
+		if (!tegra_hv_vse_safety_tag_detach(&priv->tag))
+			return -EINPROGRESS;
+		if (priv->complete)
+			cancel_delayed_work_sync(&priv->timeout_work);
+		goto put_credit;
+	}
+
+	return 0;
+
+put_credit:
+	tegra_hv_vse_safety_put_credit(se_dev);
+	return err;
+}
+
+static int tegra_hv_vse_safety_wait(struct tegra_vse_priv_data *priv)
+{
+	struct tegra_virtual_se_dev *se_dev = priv->se_dev;
+	unsigned long time_left;
+	int err = 0;
+
+	time_left = wait_for_completion_timeout(&priv->alg_complete,
+			TEGRA_HV_VSE_TIMEOUT);
+	if (time_left == 0) {
+		if (tegra_hv_vse_safety_tag_detach(&priv->tag))
+			err = -ETIMEDOUT;
+		else
+			/* Response raced with the timeout and is being handled */
+			wait_for_completion(&priv->alg_complete);
+	}
+
+	tegra_hv_vse_safety_put_credit(se_dev);
+
+	return err;
+}
+
+static int tegra_hv_vse_safety_send_and_wait(
+	struct tegra_virtual_se_dev *se_dev,
+	struct tegra_vse_priv_data *priv,
+	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg)
+{
+	int err;
+
+	priv->complete = NULL;
+	err = tegra_hv_vse_safety_submit(se_dev, priv, ivc_req_msg);
+	if (err)
+		return err;
+
+	return tegra_hv_vse_safety_wait(priv);
+}
+
 static int tegra_hv_vse_safety_prepare_ivc_linked_list(
 	struct tegra_virtual_se_dev *se_dev, struct scatterlist *sg,
 	u32 total_len, int max_ll_len, int block_size,
@@ -648,12 +962,9 @@ static int tegra_hv_vse_safety_send_sha_data(struct tegra_virtual_se_dev *se_dev
 {
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx = NULL;
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr = NULL;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	struct tegra_vse_priv_data *priv = NULL;
 	struct tegra_virtual_se_req_context *req_ctx;
-	struct tegra_vse_tag *priv_data_ptr;
 	union tegra_virtual_se_sha_args *psha = NULL;
-	int time_left;
 	int err = 0;
 	u64 total_count = 0, msg_len = 0;
 
@@ -717,37 +1028,332 @@ static int tegra_hv_vse_safety_send_sha_data(struct tegra_virtual_se_dev *se_dev
 	ivc_hdr->header_magic[2] = 'D';
 	ivc_hdr->header_magic[3] = 'A';
 	ivc_hdr->num_reqs = 1;
-	priv_data_ptr = (struct tegra_vse_tag *)ivc_req_msg->ivc_hdr.tag;
-	priv_data_ptr->priv_data = (unsigned int *)priv;
 	priv->cmd = VIRTUAL_SE_PROCESS;
-	priv->se_dev = se_dev;
 
-	vse_thread_start = true;
-	init_completion(&priv->alg_complete);
+	err = tegra_hv_vse_safety_send_and_wait(se_dev, priv, ivc_req_msg);
+	if (err == -ETIMEDOUT)
+		dev_err(se_dev->dev, "%s timeout\n", __func__);
 
-	mutex_lock(&se_dev->server_lock);
-	/* Return error if engine is in suspended state */
-	if (atomic_read(&se_dev->se_suspended)) {
-		err = -ENODEV;
-		goto exit;
+	devm_kfree(se_dev->dev, priv);
+
+	return err;
+}
+
+static const u32 tegra_vse_sha_buf_size[SHA_BUF_NUM_CLASSES] = {
+	[SHA_BUF_SMALL] = TEGRA_HV_VSE_SHA_POOL_SMALL_SIZE,
+	[SHA_BUF_LARGE] = TEGRA_HV_VSE_SHA_POOL_LARGE_SIZE,
+};
+
+static const u32 tegra_vse_sha_buf_num[SHA_BUF_NUM_CLASSES] = {
+	[SHA_BUF_SMALL] = TEGRA_HV_VSE_SHA_POOL_SMALL_NUM,
+	[SHA_BUF_LARGE] = TEGRA_HV_VSE_SHA_POOL_LARGE_NUM,
+};
+
+static struct tegra_vse_sha_buf *tegra_hv_vse_safety_sha_buf_alloc(
+	struct device *dev, enum tegra_vse_sha_buf_class cls)
+{
+	struct tegra_vse_sha_buf *sbuf;
+
+	sbuf = kzalloc(sizeof(*sbuf), GFP_KERNEL);
+	if (!sbuf)
+		return NULL;
+
+	sbuf->size = tegra_vse_sha_buf_size[cls];
+	sbuf->cls = cls;
+	sbuf->buf = dma_alloc_coherent(dev, sbuf->size, &sbuf->buf_addr,
+			GFP_KERNEL);
+	if (!sbuf->buf) {
+		kfree(sbuf);
+		return NULL;
 	}
 
-	err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-			sizeof(struct tegra_virtual_se_ivc_msg_t));
-	if (err)
-		goto exit;
+	return sbuf;
+}
 
-	time_left = wait_for_completion_timeout(&priv->alg_complete,
-			TEGRA_HV_VSE_TIMEOUT);
-	if (time_left == 0) {
-		dev_err(se_dev->dev, "%s timeout\n", __func__);
-		err = -ETIMEDOUT;
+static void tegra_hv_vse_safety_sha_buf_free(struct device *dev,
+	struct tegra_vse_sha_buf *sbuf)
+{
+	dma_free_coherent(dev, sbuf->size, sbuf->buf, sbuf->buf_addr);
+	kfree(sbuf);
+}
+
+/*
+ * Take a staging buffer of class @cls from the pool. On a pool miss a
+ * buffer is allocated and freed again on put, as before pooling.
+ */
+static struct tegra_vse_sha_buf *tegra_hv_vse_safety_sha_buf_get(
+	struct tegra_virtual_se_dev *se_dev,
+	enum tegra_vse_sha_buf_class cls)
+{
+	struct tegra_vse_sha_pool *pool = se_dev->sha_pool;
+	struct tegra_vse_sha_buf *sbuf;
+	ktime_t start = ktime_get();
+	u32 in_use;
+	u64 ns;
+
+	spin_lock(&pool->lock);
+	sbuf = list_first_entry_or_null(&pool->free[cls],
+			struct tegra_vse_sha_buf, node);
+	if (sbuf) {
+		list_del(&sbuf->node);
+		pool->num_free[cls]--;
+		pool->hits[cls]++;
+		in_use = pool->num_total[cls] - pool->num_free[cls];
+		pool->peak_in_use[cls] = max(pool->peak_in_use[cls], in_use);
+	} else {
+		pool->misses[cls]++;
 	}
-exit:
-	mutex_unlock(&se_dev->server_lock);
-	devm_kfree(se_dev->dev, priv);
+	spin_unlock(&pool->lock);
 
-	return err;
+	if (!sbuf)
+		sbuf = tegra_hv_vse_safety_sha_buf_alloc(se_dev->dev, cls);
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&pool->lock);
+	if (sbuf) {
+		pool->alloc_count++;
+		pool->alloc_ns_total += ns;
+		pool->alloc_ns_max = max(pool->alloc_ns_max, ns);
+	} else {
+		pool->alloc_failures++;
+	}
+	spin_unlock(&pool->lock);
+
+	return sbuf;
+}
+
+static void tegra_hv_vse_safety_sha_buf_put(
+	struct tegra_virtual_se_dev *se_dev, struct tegra_vse_sha_buf *sbuf)
+{
+	struct tegra_vse_sha_pool *pool = se_dev->sha_pool;
+
+	if (!sbuf)
+		return;
+
+	if (!sbuf->pooled) {
+		tegra_hv_vse_safety_sha_buf_free(se_dev->dev, sbuf);
+		return;
+	}
+
+	spin_lock(&pool->lock);
+	list_add(&sbuf->node, &pool->free[sbuf->cls]);
+	pool->num_free[sbuf->cls]++;
+	spin_unlock(&pool->lock);
+}
+
+static void tegra_hv_vse_safety_sha_set_staging(
+	struct tegra_virtual_se_req_context *req_ctx,
+	struct tegra_vse_sha_buf *sbuf)
+{
+	req_ctx->staging = sbuf;
+	req_ctx->sha_buf = sbuf ? sbuf->buf : NULL;
+	req_ctx->sha_buf_addr = sbuf ? sbuf->buf_addr : 0;
+}
+
+/*
+ * Move to a large staging buffer when @needed bytes do not fit in the
+ * current one. Keeps the current buffer if no large one is available,
+ * the slow path then just hashes in smaller chunks.
+ */
+static void tegra_hv_vse_safety_sha_grow_staging(
+	struct tegra_virtual_se_dev *se_dev,
+	struct tegra_virtual_se_req_context *req_ctx, u64 needed)
+{
+	struct tegra_vse_sha_buf *sbuf;
+
+	if (needed <= req_ctx->staging->size ||
+			req_ctx->staging->cls == SHA_BUF_LARGE)
+		return;
+
+	sbuf = tegra_hv_vse_safety_sha_buf_get(se_dev, SHA_BUF_LARGE);
+	if (!sbuf)
+		return;
+
+	memcpy(sbuf->buf, req_ctx->sha_buf, req_ctx->residual_bytes);
+	tegra_hv_vse_safety_sha_buf_put(se_dev, req_ctx->staging);
+	tegra_hv_vse_safety_sha_set_staging(req_ctx, sbuf);
+}
+
+/*
+ * Page aligned multi-entry scatterlists that the IOMMU maps to a single
+ * contiguous IOVA range can be hashed directly instead of being copied
+ * through the staging buffer.
+ */
+static bool tegra_hv_vse_safety_sha_map_contig(
+	struct tegra_virtual_se_dev *se_dev, struct ahash_request *req)
+{
+	struct tegra_virtual_se_req_context *req_ctx = ahash_request_ctx(req);
+	int nents = sg_nents(req->src);
+	struct scatterlist *sg;
+	int i, mapped;
+
+	if (req->nbytes >= TEGRA_VIRTUAL_SE_MAX_BUFFER_SIZE)
+		return false;
+
+	for_each_sg(req->src, sg, nents, i) {
+		if (i > 0 && sg->offset)
+			return false;
+		if (!sg_is_last(sg) && !PAGE_ALIGNED(sg->offset + sg->length))
+			return false;
+	}
+
+	mapped = dma_map_sg(se_dev->dev, req->src, nents, DMA_TO_DEVICE);
+	if (!mapped)
+		return false;
+
+	if (mapped != 1 || sg_dma_len(req->src) < req->nbytes) {
+		dma_unmap_sg(se_dev->dev, req->src, nents, DMA_TO_DEVICE);
+		return false;
+	}
+
+	req_ctx->src_addr = sg_dma_address(req->src);
+	req_ctx->src_mapped = true;
+
+	spin_lock(&se_dev->sha_pool->lock);
+	se_dev->sha_pool->direct_dma++;
+	spin_unlock(&se_dev->sha_pool->lock);
+
+	return true;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *tegra_vse_debugfs;
+
+static struct dentry *tegra_hv_vse_safety_debugfs_dir(void)
+{
+	if (!tegra_vse_debugfs)
+		tegra_vse_debugfs = debugfs_create_dir("tegra_hv_vse_safety",
+				NULL);
+
+	return IS_ERR_OR_NULL(tegra_vse_debugfs) ? NULL : tegra_vse_debugfs;
+}
+
+static int tegra_hv_vse_safety_sha_pool_show(struct seq_file *s, void *data)
+{
+	struct tegra_vse_sha_pool *pool = s->private;
+	static const char * const names[SHA_BUF_NUM_CLASSES] = {
+		"small", "large",
+	};
+	u64 avg_ns;
+	int i;
+
+	spin_lock(&pool->lock);
+	seq_puts(s, "class  size     total free peak_in_use hits       misses\n");
+	for (i = 0; i < SHA_BUF_NUM_CLASSES; i++)
+		seq_printf(s, "%-6s %-8u %-5u %-4u %-11u %-10llu %llu\n",
+			   names[i], tegra_vse_sha_buf_size[i],
+			   pool->num_total[i], pool->num_free[i],
+			   pool->peak_in_use[i], pool->hits[i],
+			   pool->misses[i]);
+	avg_ns = pool->alloc_count ?
+		div64_u64(pool->alloc_ns_total, pool->alloc_count) : 0;
+	seq_printf(s, "alloc_failures: %llu\n", pool->alloc_failures);
+	seq_printf(s, "alloc_latency_avg_ns: %llu\n", avg_ns);
+	seq_printf(s, "alloc_latency_max_ns: %llu\n", pool->alloc_ns_max);
+	seq_printf(s, "direct_dma: %llu\n", pool->direct_dma);
+	spin_unlock(&pool->lock);
+
+	return 0;
+}
+
+static int tegra_hv_vse_safety_sha_pool_open(struct inode *inode,
+	struct file *file)
+{
+	return single_open(file, tegra_hv_vse_safety_sha_pool_show,
+			inode->i_private);
+}
+
+static const struct file_operations tegra_hv_vse_safety_sha_pool_fops = {
+	.open = tegra_hv_vse_safety_sha_pool_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void tegra_hv_vse_safety_sha_pool_debugfs_init(
+	struct tegra_vse_sha_pool *pool)
+{
+	struct dentry *dir = tegra_hv_vse_safety_debugfs_dir();
+
+	if (!dir)
+		return;
+
+	pool->debugfs = debugfs_create_file("sha_pool", 0444, dir, pool,
+			&tegra_hv_vse_safety_sha_pool_fops);
+}
+#else
+static inline void tegra_hv_vse_safety_sha_pool_debugfs_init(
+	struct tegra_vse_sha_pool *pool)
+{
+}
+#endif
+
+static void tegra_hv_vse_safety_sha_pool_destroy(
+	struct tegra_virtual_se_dev *se_dev)
+{
+	struct tegra_vse_sha_pool *pool = se_dev->sha_pool;
+	struct tegra_vse_sha_buf *sbuf, *tmp;
+	int i;
+
+	if (!pool)
+		return;
+
+	debugfs_remove(pool->debugfs);
+
+	for (i = 0; i < SHA_BUF_NUM_CLASSES; i++) {
+		list_for_each_entry_safe(sbuf, tmp, &pool->free[i], node) {
+			list_del(&sbuf->node);
+			tegra_hv_vse_safety_sha_buf_free(se_dev->dev, sbuf);
+		}
+	}
+
+	dma_pool_destroy(pool->result_pool);
+	kfree(pool);
+	se_dev->sha_pool = NULL;
+}
+
+static int tegra_hv_vse_safety_sha_pool_create(
+	struct tegra_virtual_se_dev *se_dev)
+{
+	struct tegra_vse_sha_pool *pool;
+	struct tegra_vse_sha_buf *sbuf;
+	int i, j;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return -ENOMEM;
+
+	spin_lock_init(&pool->lock);
+	for (i = 0; i < SHA_BUF_NUM_CLASSES; i++)
+		INIT_LIST_HEAD(&pool->free[i]);
+	se_dev->sha_pool = pool;
+
+	pool->result_pool = dma_pool_create("tegra_hv_vse_sha_result",
+			se_dev->dev, TEGRA_HV_VSE_SHA_RESULT_SIZE,
+			TEGRA_HV_VSE_SHA_MAX_BLOCK_SIZE, 0);
+	if (!pool->result_pool)
+		goto err;
+
+	for (i = 0; i < SHA_BUF_NUM_CLASSES; i++) {
+		for (j = 0; j < tegra_vse_sha_buf_num[i]; j++) {
+			sbuf = tegra_hv_vse_safety_sha_buf_alloc(se_dev->dev, i);
+			if (!sbuf)
+				goto err;
+			sbuf->pooled = true;
+			list_add(&sbuf->node, &pool->free[i]);
+			pool->num_free[i]++;
+			pool->num_total[i]++;
+		}
+	}
+
+	tegra_hv_vse_safety_sha_pool_debugfs_init(pool);
+
+	return 0;
+
+err:
+	tegra_hv_vse_safety_sha_pool_destroy(se_dev);
+	return -ENOMEM;
 }
 
 static int tegra_hv_vse_safety_sha_send_one(struct ahash_request *req,
@@ -867,18 +1473,26 @@ static int tegra_hv_vse_safety_sha_fast_path(struct ahash_request *req,
 			dev_dbg(se_dev->dev, "%s: bytes_process_in_req %u\n",
 				__func__, bytes_process_in_req);
 
-			err = tegra_hv_vse_safety_prepare_ivc_linked_list(se_dev,
-					req->src, bytes_process_in_req,
-					(TEGRA_HV_VSE_SHA_MAX_LL_NUM_1 -
-						num_lists),
-					req_ctx->blk_size,
-					src_addr,
-					&num_lists,
-					DMA_TO_DEVICE, &num_mapped_sgs);
-			if (err) {
-				dev_err(se_dev->dev, "%s: ll error %d\n",
-					__func__, err);
-				goto unmap;
+			if (req_ctx->src_mapped) {
+				/* req->src already mapped by sha_op() */
+				src_addr->lo = req_ctx->src_addr;
+				src_addr->hi = bytes_process_in_req;
+				num_lists = 1;
+			} else {
+				err = tegra_hv_vse_safety_prepare_ivc_linked_list(
+						se_dev, req->src,
+						bytes_process_in_req,
+						(TEGRA_HV_VSE_SHA_MAX_LL_NUM_1 -
+							num_lists),
+						req_ctx->blk_size,
+						src_addr,
+						&num_lists,
+						DMA_TO_DEVICE, &num_mapped_sgs);
+				if (err) {
+					dev_err(se_dev->dev, "%s: ll error %d\n",
+						__func__, err);
+					goto unmap;
+				}
 			}
 
 			dev_dbg(se_dev->dev, "%s: num_lists %u\n",
@@ -948,7 +1562,7 @@ static int tegra_hv_vse_safety_sha_slow_path(struct ahash_request *req,
 {
 	struct tegra_virtual_se_dev *se_dev = g_virtual_se_dev[VIRTUAL_SE_SHA];
 	struct tegra_virtual_se_req_context *req_ctx = ahash_request_ctx(req);
-	u32 nblk_bytes = 0, num_blks, buflen = SZ_4M;
+	u32 nblk_bytes = 0, num_blks, buflen;
 	u32 length = 0, skip = 0, offset = 0;
 	u64 total_bytes = 0, left_bytes = 0;
 	int err = 0;
@@ -958,6 +1572,11 @@ static int tegra_hv_vse_safety_sha_slow_path(struct ahash_request *req,
 		(process_cur_req == true && is_last == true)) {
 
 		total_bytes = req_ctx->residual_bytes + req->nbytes;
+
+		tegra_hv_vse_safety_sha_grow_staging(se_dev, req_ctx,
+				total_bytes);
+		/* Every chunk except the last must be block aligned */
+		buflen = rounddown(req_ctx->staging->size, req_ctx->blk_size);
 		num_blks = total_bytes / req_ctx->blk_size;
 		nblk_bytes = num_blks * req_ctx->blk_size;
 		offset = req_ctx->residual_bytes;
@@ -1205,7 +1824,9 @@ static int tegra_hv_vse_safety_sha_op(struct ahash_request *req, bool is_last,
 
 	num_blks = req->nbytes / req_ctx->blk_size;
 
-	if (sg_nents(req->src) > 1)
+	if (sg_nents(req->src) > 1 && req_ctx->force_align == false &&
+			num_blks > 0 &&
+			!tegra_hv_vse_safety_sha_map_contig(se_dev, req))
 		req_ctx->force_align = true;
 
 	if (req_ctx->force_align == false && num_blks > 0)
@@ -1213,6 +1834,12 @@ static int tegra_hv_vse_safety_sha_op(struct ahash_request *req, bool is_last,
 	else
 		ret = tegra_hv_vse_safety_sha_slow_path(req, is_last, process_cur_req);
 
+	if (req_ctx->src_mapped) {
+		dma_unmap_sg(se_dev->dev, req->src, sg_nents(req->src),
+				DMA_TO_DEVICE);
+		req_ctx->src_mapped = false;
+	}
+
 	return ret;
 }
 
@@ -1298,8 +1925,8 @@ static int tegra_hv_vse_safety_sha_init(struct ahash_request *req)
 		return -EINVAL;
 	}
 
-	req_ctx->sha_buf = dma_alloc_coherent(se_dev->dev, SZ_4M,
-					&req_ctx->sha_buf_addr, GFP_KERNEL);
+	tegra_hv_vse_safety_sha_set_staging(req_ctx,
+			tegra_hv_vse_safety_sha_buf_get(se_dev, SHA_BUF_SMALL));
 	if (!req_ctx->sha_buf) {
 		dev_err(se_dev->dev, "Cannot allocate memory to sha_buf\n");
 		return -ENOMEM;
@@ -1316,16 +1943,22 @@ static int tegra_hv_vse_safety_sha_init(struct ahash_request *req)
 	dst_len = req_ctx->intermediate_digest_size;
 #endif
 
-	req_ctx->hash_result = dma_alloc_coherent(
-			se_dev->dev, dst_len,
-			&req_ctx->hash_result_addr, GFP_KERNEL);
+	req_ctx->hash_result_size = dst_len;
+	if (dst_len <= TEGRA_HV_VSE_SHA_RESULT_SIZE)
+		req_ctx->hash_result = dma_pool_zalloc(
+				se_dev->sha_pool->result_pool, GFP_KERNEL,
+				&req_ctx->hash_result_addr);
+	else
+		req_ctx->hash_result = dma_alloc_coherent(
+				se_dev->dev, dst_len,
+				&req_ctx->hash_result_addr, GFP_KERNEL);
 	if (!req_ctx->hash_result) {
-		dma_free_coherent(se_dev->dev, SZ_4M,
-				req_ctx->sha_buf, req_ctx->sha_buf_addr);
-		req_ctx->sha_buf = NULL;
+		tegra_hv_vse_safety_sha_buf_put(se_dev, req_ctx->staging);
+		tegra_hv_vse_safety_sha_set_staging(req_ctx, NULL);
 		dev_err(se_dev->dev, "Cannot allocate memory to hash_result\n");
 		return -ENOMEM;
 	}
+	req_ctx->src_mapped = false;
 	req_ctx->total_count = 0;
 	req_ctx->is_first = true;
 	req_ctx->residual_bytes = 0;
@@ -1340,14 +1973,20 @@ static void tegra_hv_vse_safety_sha_req_deinit(struct ahash_request *req)
 	struct tegra_virtual_se_dev *se_dev = g_virtual_se_dev[VIRTUAL_SE_SHA];
 	struct tegra_virtual_se_req_context *req_ctx = ahash_request_ctx(req);
 
-	/* dma_free_coherent does not panic if addr is NULL */
-	dma_free_coherent(se_dev->dev, SZ_4M,
-			req_ctx->sha_buf, req_ctx->sha_buf_addr);
-	req_ctx->sha_buf = NULL;
+	tegra_hv_vse_safety_sha_buf_put(se_dev, req_ctx->staging);
+	tegra_hv_vse_safety_sha_set_staging(req_ctx, NULL);
 
-	dma_free_coherent(
-		se_dev->dev, (TEGRA_HV_VSE_SHA_MAX_BLOCK_SIZE * 2),
-		req_ctx->hash_result, req_ctx->hash_result_addr);
+	if (req_ctx->hash_result) {
+		if (req_ctx->hash_result_size <= TEGRA_HV_VSE_SHA_RESULT_SIZE)
+			dma_pool_free(se_dev->sha_pool->result_pool,
+					req_ctx->hash_result,
+					req_ctx->hash_result_addr);
+		else
+			dma_free_coherent(se_dev->dev,
+					req_ctx->hash_result_size,
+					req_ctx->hash_result,
+					req_ctx->hash_result_addr);
+	}
 	req_ctx->hash_result = NULL;
 	req_ctx->req_context_initialized = false;
 }
@@ -1569,11 +2208,9 @@ static int tegra_hv_vse_safety_aes_gen_random_iv(
 		struct tegra_virtual_se_ivc_msg_t *ivc_req_msg)
 {
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx = &ivc_req_msg->tx[0];
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	union tegra_virtual_se_aes_args *aes = &ivc_tx->aes;
 	struct tegra_virtual_se_aes_context *aes_ctx;
 	int err = 0;
-	int time_left;
 
 	ivc_tx->cmd = TEGRA_VIRTUAL_SE_CMD_AES_ENCRYPT_INIT;
 	priv->cmd = VIRTUAL_SE_PROCESS;
@@ -1581,25 +2218,15 @@ static int tegra_hv_vse_safety_aes_gen_random_iv(
 	aes->op.keyslot = aes_ctx->aes_keyslot;
 	aes->op.key_length = aes_ctx->keylen;
 
-	init_completion(&priv->alg_complete);
-	mutex_lock(&se_dev->server_lock);
-	err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-			sizeof(struct tegra_virtual_se_ivc_msg_t));
-	if (err) {
+	err = tegra_hv_vse_safety_send_and_wait(se_dev, priv, ivc_req_msg);
+	if (err == -ETIMEDOUT) {
+		dev_err(se_dev->dev, "%s timeout\n", __func__);
+		return err;
+	} else if (err) {
 		dev_err(se_dev->dev,
 				"\n %s send ivc failed %d\n", __func__, err);
-		mutex_unlock(&se_dev->server_lock);
 		return err;
 	}
-	time_left = wait_for_completion_timeout(&priv->alg_complete,
-			TEGRA_HV_VSE_TIMEOUT);
-	if (time_left == 0) {
-		dev_err(se_dev->dev, "%s timeout\n", __func__);
-		err = -ETIMEDOUT;
-		mutex_unlock(&se_dev->server_lock);
-		return err;
-	}
-	mutex_unlock(&se_dev->server_lock);
 
 	err = status_to_errno(priv->rx_status);
 
@@ -1611,6 +2238,54 @@ static int tegra_hv_vse_safety_aes_gen_random_iv(
 	return err;
 }
 
+static void tegra_hv_vse_safety_aes_complete(struct tegra_vse_priv_data *priv,
+		int err)
+{
+	struct skcipher_request *req = priv->req;
+	struct tegra_virtual_se_dev *se_dev = priv->se_dev;
+	struct tegra_virtual_se_aes_req_context *req_ctx =
+		skcipher_request_ctx(req);
+	int num_sgs;
+
+	if (err)
+		goto exit;
+
+	if (priv->rx_status == 0U) {
+		dma_sync_single_for_cpu(priv->se_dev->dev, priv->buf_addr,
+			req->cryptlen, DMA_BIDIRECTIONAL);
+
+		num_sgs = tegra_hv_vse_safety_count_sgs(req->dst, req->cryptlen);
+		if (num_sgs == 1)
+			memcpy(sg_virt(req->dst), priv->buf, req->cryptlen);
+		else
+			sg_copy_from_buffer(req->dst, num_sgs,
+					priv->buf, req->cryptlen);
+
+		if (((req_ctx->op_mode == AES_CBC)
+				|| (req_ctx->op_mode == AES_CTR))
+				&& req_ctx->encrypt == true)
+			memcpy(req->iv, priv->iv, TEGRA_VIRTUAL_SE_AES_IV_SIZE);
+	} else {
+		dev_err(se_dev->dev,
+				"%s: SE server returned error %u\n",
+				__func__, priv->rx_status);
+	}
+
+	err = status_to_errno(priv->rx_status);
+
+exit:
+	dma_unmap_sg(se_dev->dev, &priv->sg, 1, DMA_BIDIRECTIONAL);
+	kfree(priv->buf);
+	devm_kfree(se_dev->dev, priv);
+
+	req->base.complete(&req->base, err);
+}
+
+/*
+ * Returns -EINPROGRESS once the request is queued to the SE server, the
+ * request is then completed from tegra_vse_wq by
+ * tegra_hv_vse_safety_aes_complete().
+ */
 static int tegra_hv_vse_safety_process_aes_req(struct tegra_virtual_se_dev *se_dev,
 		struct skcipher_request *req)
 {
@@ -1618,13 +2293,10 @@ static int tegra_hv_vse_safety_process_aes_req(struct tegra_virtual_se_dev *se_d
 	struct tegra_virtual_se_aes_context *aes_ctx;
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx = NULL;
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr = NULL;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	int err = 0;
 	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg = NULL;
 	struct tegra_vse_priv_data *priv = NULL;
-	struct tegra_vse_tag *priv_data_ptr;
 	union tegra_virtual_se_aes_args *aes;
-	int time_left;
 	int num_sgs;
 	int dma_ents = 0;
 
@@ -1683,10 +2355,7 @@ static int tegra_hv_vse_safety_process_aes_req(struct tegra_virtual_se_dev *se_d
 	ivc_hdr->header_magic[3] = 'A';
 	ivc_hdr->engine = req_ctx->engine_id;
 
-	priv_data_ptr = (struct tegra_vse_tag *)ivc_hdr->tag;
-	priv_data_ptr->priv_data = (unsigned int *)priv;
 	priv->se_dev = se_dev;
-	vse_thread_start = true;
 
 	/*
 	 * If first byte of iv is 1 and the request is for AES CBC/CTR encryption,
@@ -1710,48 +2379,14 @@ static int tegra_hv_vse_safety_process_aes_req(struct tegra_virtual_se_dev *se_d
 	aes->op.dst_addr.lo = priv->buf_addr;
 	aes->op.dst_addr.hi = req->cryptlen;
 
-	init_completion(&priv->alg_complete);
-	mutex_lock(&se_dev->server_lock);
-	err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-			sizeof(struct tegra_virtual_se_ivc_msg_t));
-	if (err) {
-		dev_err(se_dev->dev,
-			"\n %s send ivc failed %d\n", __func__, err);
-		mutex_unlock(&se_dev->server_lock);
-		goto exit;
-	}
-	time_left = wait_for_completion_timeout(&priv->alg_complete,
-			TEGRA_HV_VSE_TIMEOUT);
-	if (time_left == 0) {
-		dev_err(se_dev->dev, "%s timeout\n", __func__);
-		err = -ETIMEDOUT;
-		mutex_unlock(&se_dev->server_lock);
-		goto exit;
-	}
-	mutex_unlock(&se_dev->server_lock);
-
-	if (priv->rx_status == 0U) {
-		dma_sync_single_for_cpu(priv->se_dev->dev, priv->buf_addr,
-			req->cryptlen, DMA_BIDIRECTIONAL);
-
-		num_sgs = tegra_hv_vse_safety_count_sgs(req->dst, req->cryptlen);
-		if (num_sgs == 1)
-			memcpy(sg_virt(req->dst), priv->buf, req->cryptlen);
-		else
-			sg_copy_from_buffer(req->dst, num_sgs,
-					priv->buf, req->cryptlen);
-
-		if (((req_ctx->op_mode == AES_CBC)
-				|| (req_ctx->op_mode == AES_CTR))
-				&& req_ctx->encrypt == true)
-			memcpy(req->iv, priv->iv, TEGRA_VIRTUAL_SE_AES_IV_SIZE);
-	} else {
-		dev_err(se_dev->dev,
-				"%s: SE server returned error %u\n",
-				__func__, priv->rx_status);
+	/* priv is owned by the completion path once submitted */
+	priv->complete = tegra_hv_vse_safety_aes_complete;
+	err = tegra_hv_vse_safety_submit(se_dev, priv, ivc_req_msg);
+	if (err == 0 || err == -EINPROGRESS) {
+		devm_kfree(se_dev->dev, ivc_req_msg);
+		return -EINPROGRESS;
 	}
-
-	err = status_to_errno(priv->rx_status);
+	dev_err(se_dev->dev, "\n %s send ivc failed %d\n", __func__, err);
 
 exit:
 	if (dma_ents > 0)
@@ -1763,8 +2398,59 @@ exit:
 		devm_kfree(se_dev->dev, priv);
 	}
 
-	if (ivc_req_msg)
-		devm_kfree(se_dev->dev, ivc_req_msg);
+	if (ivc_req_msg)
+		devm_kfree(se_dev->dev, ivc_req_msg);
+
+	return err;
+}
+
+/*
+ * Submits the AES requests queued on @se_dev. Only this worker sleeps for a
+ * credit, so .encrypt/.decrypt never do and may be called again from a
+ * completion callback.
+ */
+static void tegra_hv_vse_safety_aes_queue_worker(struct work_struct *work)
+{
+	struct tegra_virtual_se_dev *se_dev = container_of(work,
+			struct tegra_virtual_se_dev, queue_work);
+	struct crypto_async_request *async_req, *backlog;
+	struct skcipher_request *req;
+	int err;
+
+	for (;;) {
+		spin_lock_bh(&se_dev->queue_lock);
+		backlog = crypto_get_backlog(&se_dev->queue);
+		async_req = crypto_dequeue_request(&se_dev->queue);
+		spin_unlock_bh(&se_dev->queue_lock);
+
+		if (!async_req)
+			break;
+
+		if (backlog)
+			backlog->complete(backlog, -EINPROGRESS);
+
+		req = skcipher_request_cast(async_req);
+		mutex_lock(&se_dev->mtx);
+		err = tegra_hv_vse_safety_process_aes_req(se_dev, req);
+		mutex_unlock(&se_dev->mtx);
+		if (err != -EINPROGRESS) {
+			dev_err(se_dev->dev, "%s failed with error %d\n",
+					__func__, err);
+			req->base.complete(&req->base, err);
+		}
+	}
+}
+
+static int tegra_hv_vse_safety_aes_enqueue(struct tegra_virtual_se_dev *se_dev,
+		struct skcipher_request *req)
+{
+	int err;
+
+	spin_lock_bh(&se_dev->queue_lock);
+	err = crypto_enqueue_request(&se_dev->queue, &req->base);
+	spin_unlock_bh(&se_dev->queue_lock);
+
+	queue_work(tegra_vse_wq, &se_dev->queue_work);
 
 	return err;
 }
@@ -1804,12 +2490,10 @@ static int tegra_hv_vse_safety_aes_cbc_encrypt(struct skcipher_request *req)
 	req_ctx->op_mode = AES_CBC;
 	req_ctx->engine_id = VIRTUAL_SE_AES1;
 	req_ctx->se_dev = g_virtual_se_dev[VIRTUAL_SE_AES1];
-	mutex_lock(&req_ctx->se_dev->mtx);
-	err = tegra_hv_vse_safety_process_aes_req(req_ctx->se_dev, req);
-	if (err)
+	err = tegra_hv_vse_safety_aes_enqueue(req_ctx->se_dev, req);
+	if (err && err != -EINPROGRESS && err != -EBUSY)
 		dev_err(req_ctx->se_dev->dev,
 				"%s failed with error %d\n", __func__, err);
-	mutex_unlock(&req_ctx->se_dev->mtx);
 	return err;
 }
 
@@ -1828,12 +2512,10 @@ static int tegra_hv_vse_safety_aes_cbc_decrypt(struct skcipher_request *req)
 	req_ctx->op_mode = AES_CBC;
 	req_ctx->engine_id = VIRTUAL_SE_AES1;
 	req_ctx->se_dev = g_virtual_se_dev[VIRTUAL_SE_AES1];
-	mutex_lock(&req_ctx->se_dev->mtx);
-	err = tegra_hv_vse_safety_process_aes_req(req_ctx->se_dev, req);
-	if (err)
+	err = tegra_hv_vse_safety_aes_enqueue(req_ctx->se_dev, req);
+	if (err && err != -EINPROGRESS && err != -EBUSY)
 		dev_err(req_ctx->se_dev->dev,
 				"%s failed with error %d\n", __func__, err);
-	mutex_unlock(&req_ctx->se_dev->mtx);
 	return err;
 }
 
@@ -1852,12 +2534,10 @@ static int tegra_hv_vse_safety_aes_ecb_encrypt(struct skcipher_request *req)
 	req_ctx->op_mode = AES_ECB;
 	req_ctx->engine_id = VIRTUAL_SE_AES1;
 	req_ctx->se_dev = g_virtual_se_dev[VIRTUAL_SE_AES1];
-	mutex_lock(&req_ctx->se_dev->mtx);
-	err = tegra_hv_vse_safety_process_aes_req(req_ctx->se_dev, req);
-	if (err)
+	err = tegra_hv_vse_safety_aes_enqueue(req_ctx->se_dev, req);
+	if (err && err != -EINPROGRESS && err != -EBUSY)
 		dev_err(req_ctx->se_dev->dev,
 				"%s failed with error %d\n", __func__, err);
-	mutex_unlock(&req_ctx->se_dev->mtx);
 	return err;
 }
 
@@ -1876,12 +2556,10 @@ static int tegra_hv_vse_safety_aes_ecb_decrypt(struct skcipher_request *req)
 	req_ctx->op_mode = AES_ECB;
 	req_ctx->engine_id = VIRTUAL_SE_AES1;
 	req_ctx->se_dev = g_virtual_se_dev[VIRTUAL_SE_AES1];
-	mutex_lock(&req_ctx->se_dev->mtx);
-	err = tegra_hv_vse_safety_process_aes_req(req_ctx->se_dev, req);
-	if (err)
+	err = tegra_hv_vse_safety_aes_enqueue(req_ctx->se_dev, req);
+	if (err && err != -EINPROGRESS && err != -EBUSY)
 		dev_err(req_ctx->se_dev->dev,
 				"%s failed with error %d\n", __func__, err);
-	mutex_unlock(&req_ctx->se_dev->mtx);
 	return err;
 }
 
@@ -1907,12 +2585,10 @@ static int tegra_hv_vse_safety_aes_ctr_encrypt(struct skcipher_request *req)
 	req_ctx->op_mode = AES_CTR;
 	req_ctx->engine_id = VIRTUAL_SE_AES1;
 	req_ctx->se_dev = g_virtual_se_dev[VIRTUAL_SE_AES1];
-	mutex_lock(&req_ctx->se_dev->mtx);
-	err = tegra_hv_vse_safety_process_aes_req(req_ctx->se_dev, req);
-	if (err)
+	err = tegra_hv_vse_safety_aes_enqueue(req_ctx->se_dev, req);
+	if (err && err != -EINPROGRESS && err != -EBUSY)
 		dev_err(req_ctx->se_dev->dev,
 				"%s failed with error %d\n", __func__, err);
-	mutex_unlock(&req_ctx->se_dev->mtx);
 	return err;
 }
 
@@ -1931,12 +2607,10 @@ static int tegra_hv_vse_safety_aes_ctr_decrypt(struct skcipher_request *req)
 	req_ctx->op_mode = AES_CTR;
 	req_ctx->engine_id = VIRTUAL_SE_AES1;
 	req_ctx->se_dev = g_virtual_se_dev[VIRTUAL_SE_AES1];
-	mutex_lock(&req_ctx->se_dev->mtx);
-	err = tegra_hv_vse_safety_process_aes_req(req_ctx->se_dev, req);
-	if (err)
+	err = tegra_hv_vse_safety_aes_enqueue(req_ctx->se_dev, req);
+	if (err && err != -EINPROGRESS && err != -EBUSY)
 		dev_err(req_ctx->se_dev->dev,
 				"%s failed with error %d\n", __func__, err);
-	mutex_unlock(&req_ctx->se_dev->mtx);
 	return err;
 }
 
@@ -1948,7 +2622,6 @@ static int tegra_hv_vse_safety_cmac_op(struct ahash_request *req, bool is_last)
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr;
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx;
 	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	struct scatterlist *src_sg;
 	struct sg_mapping_iter miter;
 	u32 num_sgs, blocks_to_process, last_block_bytes = 0, bytes_to_copy = 0;
@@ -1959,9 +2632,7 @@ static int tegra_hv_vse_safety_cmac_op(struct ahash_request *req, bool is_last)
 	u8 *temp_buffer = NULL;
 	int err = 0;
 	int num_lists = 0;
-	int time_left;
 	struct tegra_vse_priv_data *priv = NULL;
-	struct tegra_vse_tag *priv_data_ptr;
 	unsigned int num_mapped_sgs = 0;
 
 	blocks_to_process = req->nbytes / TEGRA_VIRTUAL_SE_AES_BLOCK_SIZE;
@@ -2079,35 +2750,15 @@ static int tegra_hv_vse_safety_cmac_op(struct ahash_request *req, bool is_last)
 	memcpy(ivc_tx->aes.op_cmac_s.cmac_reg,
 		cmac_ctx->hash_result, cmac_ctx->digest_size);
 
-	priv_data_ptr = (struct tegra_vse_tag *)ivc_req_msg->ivc_hdr.tag;
-	priv_data_ptr->priv_data = (unsigned int *)priv;
 	if (is_last == true)
 		priv->cmd = VIRTUAL_CMAC_PROCESS;
 	else
 		priv->cmd = VIRTUAL_SE_PROCESS;
-	priv->se_dev = se_dev;
-	init_completion(&priv->alg_complete);
-	mutex_lock(&se_dev->server_lock);
-	/* Return error if engine is in suspended state */
-	if (atomic_read(&se_dev->se_suspended)) {
-		mutex_unlock(&se_dev->server_lock);
-		err = -ENODEV;
-		goto unmap_exit;
-	}
-	err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-			sizeof(struct tegra_virtual_se_ivc_msg_t));
-	if (err) {
-		mutex_unlock(&se_dev->server_lock);
-		goto unmap_exit;
-	}
-
-	time_left = wait_for_completion_timeout(&priv->alg_complete,
-			TEGRA_HV_VSE_TIMEOUT);
-	mutex_unlock(&se_dev->server_lock);
-	if (time_left == 0) {
+	err = tegra_hv_vse_safety_send_and_wait(se_dev, priv, ivc_req_msg);
+	if (err == -ETIMEDOUT)
 		dev_err(se_dev->dev, "cmac_op timeout\n");
-		err = -ETIMEDOUT;
-	}
+	else if (err)
+		goto unmap_exit;
 
 	if (is_last)
 		memcpy(req->result, priv->cmac.data, TEGRA_VIRTUAL_SE_AES_CMAC_DIGEST_SIZE);
@@ -2135,16 +2786,13 @@ static int tegra_hv_vse_safety_cmac_sv_op(struct ahash_request *req, bool is_las
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr;
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx;
 	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	struct scatterlist *src_sg;
 	u32 blocks_to_process, last_block_bytes = 0;
 	int num_sgs;
 	unsigned int total_len;
 	int err = 0;
 	int num_lists = 0;
-	int time_left;
 	struct tegra_vse_priv_data *priv = NULL;
-	struct tegra_vse_tag *priv_data_ptr;
 	unsigned int num_mapped_sgs = 0;
 
 	if ((req->nbytes == 0) || (req->nbytes > TEGRA_VIRTUAL_SE_MAX_SUPPORTED_BUFLEN)) {
@@ -2242,37 +2890,16 @@ static int tegra_hv_vse_safety_cmac_sv_op(struct ahash_request *req, bool is_las
 		cmac_ctx->is_first = false;
 	}
 
-	priv_data_ptr = (struct tegra_vse_tag *)ivc_req_msg->ivc_hdr.tag;
-	priv_data_ptr->priv_data = (unsigned int *)priv;
 	if (is_last == true)
 		priv->cmd = VIRTUAL_CMAC_PROCESS;
 	else
 		priv->cmd = VIRTUAL_SE_PROCESS;
 
-	priv->se_dev = se_dev;
-	init_completion(&priv->alg_complete);
-	mutex_lock(&se_dev->server_lock);
-	/* Return error if engine is in suspended state */
-	if (atomic_read(&se_dev->se_suspended)) {
-		mutex_unlock(&se_dev->server_lock);
-		err = -ENODEV;
-		goto unmap_exit;
-	}
-
-	err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-			sizeof(struct tegra_virtual_se_ivc_msg_t));
-	if (err) {
-		mutex_unlock(&se_dev->server_lock);
-		goto unmap_exit;
-	}
-
-	time_left = wait_for_completion_timeout(&priv->alg_complete,
-			TEGRA_HV_VSE_TIMEOUT);
-	mutex_unlock(&se_dev->server_lock);
-	if (time_left == 0) {
+	err = tegra_hv_vse_safety_send_and_wait(se_dev, priv, ivc_req_msg);
+	if (err == -ETIMEDOUT)
 		dev_err(se_dev->dev, "cmac_op timeout\n");
-		err = -ETIMEDOUT;
-	}
+	else if (err)
+		goto unmap_exit;
 
 	if (is_last) {
 		if (cmac_req_data->request_type == CMAC_SIGN) {
@@ -2485,12 +3112,9 @@ static int tegra_hv_vse_safety_cmac_setkey(struct crypto_ahash *tfm, const u8 *k
 	struct tegra_virtual_se_dev *se_dev = g_virtual_se_dev[VIRTUAL_SE_AES1];
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr;
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg;
 	struct tegra_vse_priv_data *priv = NULL;
-	struct tegra_vse_tag *priv_data_ptr;
 	int err = 0;
-	unsigned long time_left;
 	s8 label[TEGRA_VIRTUAL_SE_AES_MAX_KEY_SIZE];
 	u32 slot;
 	bool is_keyslot_label;
@@ -2544,37 +3168,12 @@ static int tegra_hv_vse_safety_cmac_setkey(struct crypto_ahash *tfm, const u8 *k
 		ivc_tx->cmd = TEGRA_VIRTUAL_SE_CMD_AES_CMAC_GEN_SUBKEY;
 		ivc_tx->aes.op_cmac_subkey_s.keyslot = ctx->aes_keyslot;
 		ivc_tx->aes.op_cmac_subkey_s.key_length = ctx->keylen;
-		priv_data_ptr =
-			(struct tegra_vse_tag *)ivc_req_msg->ivc_hdr.tag;
-		priv_data_ptr->priv_data = (unsigned int *)priv;
 		priv->cmd = VIRTUAL_SE_PROCESS;
-		priv->se_dev = se_dev;
-		init_completion(&priv->alg_complete);
 
-		mutex_lock(&se_dev->server_lock);
-		/* Return error if engine is in suspended state */
-		if (atomic_read(&se_dev->se_suspended)) {
-			mutex_unlock(&se_dev->server_lock);
-			err = -ENODEV;
-			goto free_exit;
-		}
-		err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-				sizeof(struct tegra_virtual_se_ivc_msg_t));
-		if (err) {
-			mutex_unlock(&se_dev->server_lock);
-			goto free_exit;
-		}
-
-		time_left = wait_for_completion_timeout(
-				&priv->alg_complete,
-				TEGRA_HV_VSE_TIMEOUT);
-		mutex_unlock(&se_dev->server_lock);
-		if (time_left == 0) {
-			dev_err(se_dev->dev, "%s timeout\n",
-				__func__);
-			err = -ETIMEDOUT;
-			goto free_exit;
-		}
+		err = tegra_hv_vse_safety_send_and_wait(se_dev, priv,
+				ivc_req_msg);
+		if (err == -ETIMEDOUT)
+			dev_err(se_dev->dev, "%s timeout\n", __func__);
 
 free_exit:
 		devm_kfree(se_dev->dev, priv);
@@ -2680,12 +3279,9 @@ static int tegra_hv_vse_safety_rng_drbg_get_random(struct crypto_rng *tfm,
 	u8 *rdata_addr;
 	int err = 0, j, num_blocks, data_len = 0;
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg;
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr = NULL;
 	struct tegra_vse_priv_data *priv = NULL;
-	struct tegra_vse_tag *priv_data_ptr;
-	int time_left;
 
 	if (dlen == 0) {
 		return -EINVAL;
@@ -2717,10 +3313,7 @@ static int tegra_hv_vse_safety_rng_drbg_get_random(struct crypto_rng *tfm,
 	ivc_hdr->header_magic[2] = 'D';
 	ivc_hdr->header_magic[3] = 'A';
 	ivc_hdr->engine = VIRTUAL_SE_AES0;
-	priv_data_ptr = (struct tegra_vse_tag *)ivc_hdr->tag;
-	priv_data_ptr->priv_data = (unsigned int *)priv;
 	priv->cmd = VIRTUAL_SE_PROCESS;
-	priv->se_dev = se_dev;
 
 	ivc_tx->cmd = TEGRA_VIRTUAL_SE_CMD_AES_RNG_DBRG;
 
@@ -2728,29 +3321,12 @@ static int tegra_hv_vse_safety_rng_drbg_get_random(struct crypto_rng *tfm,
 		ivc_tx->aes.op_rng.dst_addr.lo = rng_ctx->rng_buf_adr & 0xFFFFFFFF;
 		ivc_tx->aes.op_rng.dst_addr.hi = (rng_ctx->rng_buf_adr >> 32)
 				| TEGRA_VIRTUAL_SE_RNG_DT_SIZE;
-		init_completion(&priv->alg_complete);
-		vse_thread_start = true;
 
-		mutex_lock(&se_dev->server_lock);
-		/* Return error if engine is in suspended state */
-		if (atomic_read(&se_dev->se_suspended)) {
-			mutex_unlock(&se_dev->server_lock);
-			dlen = 0;
-			goto exit;
-		}
-		err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-				sizeof(struct tegra_virtual_se_ivc_msg_t));
+		err = tegra_hv_vse_safety_send_and_wait(se_dev, priv,
+				ivc_req_msg);
 		if (err) {
-			mutex_unlock(&se_dev->server_lock);
-			dlen = 0;
-			goto exit;
-		}
-
-		time_left = wait_for_completion_timeout(&priv->alg_complete,
-				TEGRA_HV_VSE_TIMEOUT);
-		mutex_unlock(&se_dev->server_lock);
-		if (time_left == 0) {
-			dev_err(se_dev->dev, "%s timeout\n", __func__);
+			if (err == -ETIMEDOUT)
+				dev_err(se_dev->dev, "%s timeout\n", __func__);
 			dlen = 0;
 			goto exit;
 		}
@@ -2899,11 +3475,8 @@ static int tegra_vse_aes_gcm_enc_dec(struct aead_request *req, bool encrypt)
 	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg = NULL;
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr;
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	struct tegra_vse_priv_data *priv = NULL;
-	struct tegra_vse_tag *priv_data_ptr;
 	int err = 0;
-	int time_left;
 	uint32_t cryptlen = 0;
 
 	void *aad_buf = NULL;
@@ -2914,16 +3487,12 @@ static int tegra_vse_aes_gcm_enc_dec(struct aead_request *req, bool encrypt)
 	dma_addr_t src_buf_addr;
 	dma_addr_t tag_buf_addr;
 
-	mutex_lock(&se_dev->server_lock);
 	/* Return error if mempool is being used for another operation */
-	if (atomic_read(&se_dev->mempoolbuf_in_use)) {
-		mutex_unlock(&se_dev->server_lock);
+	if (atomic_cmpxchg(&se_dev->mempoolbuf_in_use, false, true)) {
 		dev_err(se_dev->dev, "%s: mempool is in use\n", __func__);
 		err = -EPERM;
 		goto exit;
 	}
-	atomic_set(&se_dev->mempoolbuf_in_use, true);
-	mutex_unlock(&se_dev->server_lock);
 
 	err = tegra_vse_aes_gcm_check_params(req, encrypt);
 	if (err != 0)
@@ -2997,8 +3566,6 @@ static int tegra_vse_aes_gcm_enc_dec(struct aead_request *req, bool encrypt)
 	ivc_hdr->header_magic[2] = 'D';
 	ivc_hdr->header_magic[3] = 'A';
 	ivc_hdr->engine = VIRTUAL_SE_AES1;
-	priv_data_ptr = (struct tegra_vse_tag *)ivc_hdr->tag;
-	priv_data_ptr->priv_data = (unsigned int *)priv;
 
 	priv->se_dev = se_dev;
 
@@ -3016,25 +3583,16 @@ static int tegra_vse_aes_gcm_enc_dec(struct aead_request *req, bool encrypt)
 			//Random IV generation is required
 			ivc_tx->cmd = TEGRA_VIRTUAL_SE_CMD_AES_ENCRYPT_INIT;
 			priv->cmd = VIRTUAL_SE_PROCESS;
-			init_completion(&priv->alg_complete);
-			mutex_lock(&se_dev->server_lock);
-			err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-					sizeof(struct tegra_virtual_se_ivc_msg_t));
-			if (err) {
+			err = tegra_hv_vse_safety_send_and_wait(se_dev, priv,
+					ivc_req_msg);
+			if (err == -ETIMEDOUT) {
+				dev_err(se_dev->dev, "%s timeout\n", __func__);
+				goto free_exit;
+			} else if (err) {
 				dev_err(se_dev->dev,
 						"\n %s send ivc failed %d\n", __func__, err);
-				mutex_unlock(&se_dev->server_lock);
-				goto free_exit;
-			}
-			time_left = wait_for_completion_timeout(&priv->alg_complete,
-					TEGRA_HV_VSE_TIMEOUT);
-			if (time_left == 0) {
-				dev_err(se_dev->dev, "%s timeout\n", __func__);
-				err = -ETIMEDOUT;
-				mutex_unlock(&se_dev->server_lock);
 				goto free_exit;
 			}
-			mutex_unlock(&se_dev->server_lock);
 			err = status_to_errno(priv->rx_status);
 			if (err) {
 				dev_err(se_dev->dev,
@@ -3080,27 +3638,10 @@ static int tegra_vse_aes_gcm_enc_dec(struct aead_request *req, bool encrypt)
 		ivc_tx->aes.op_gcm.tag_addr_lo = tag_buf_addr;
 	}
 
-	init_completion(&priv->alg_complete);
-	mutex_lock(&se_dev->server_lock);
-	/* Return error if engine is in suspended state */
-	if (atomic_read(&se_dev->se_suspended)) {
-		mutex_unlock(&se_dev->server_lock);
-		err = -ENODEV;
-		goto free_exit;
-	}
-	err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-			sizeof(struct tegra_virtual_se_ivc_msg_t));
+	err = tegra_hv_vse_safety_send_and_wait(se_dev, priv, ivc_req_msg);
 	if (err) {
-		mutex_unlock(&se_dev->server_lock);
-		goto free_exit;
-	}
-
-	time_left = wait_for_completion_timeout(&priv->alg_complete,
-			TEGRA_HV_VSE_TIMEOUT);
-	mutex_unlock(&se_dev->server_lock);
-	if (time_left == 0) {
-		dev_err(se_dev->dev, "%s: completion timeout\n", __func__);
-		err = -ETIMEDOUT;
+		if (err == -ETIMEDOUT)
+			dev_err(se_dev->dev, "%s: completion timeout\n", __func__);
 		goto free_exit;
 	}
 
@@ -3261,11 +3802,8 @@ static int tegra_hv_vse_aes_gmac_sv_init(struct ahash_request *req)
 	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg = NULL;
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr = NULL;
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx = NULL;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
-	struct tegra_vse_tag *priv_data_ptr = NULL;
 	struct tegra_vse_priv_data *priv = NULL;
 	int err = 0;
-	u64 time_left;
 
 	/* Return error if engine is in suspended state */
 	if (atomic_read(&se_dev->se_suspended)) {
@@ -3333,8 +3871,6 @@ static int tegra_hv_vse_aes_gmac_sv_init(struct ahash_request *req)
 	ivc_hdr->header_magic[2] = 'D';
 	ivc_hdr->header_magic[3] = 'A';
 	ivc_hdr->engine = VIRTUAL_SE_AES0;
-	priv_data_ptr = (struct tegra_vse_tag *)ivc_hdr->tag;
-	priv_data_ptr->priv_data = (unsigned int *)priv;
 	priv->cmd = VIRTUAL_SE_AES_GCM_ENC_PROCESS;
 	priv->se_dev = se_dev;
 
@@ -3342,30 +3878,15 @@ static int tegra_hv_vse_aes_gmac_sv_init(struct ahash_request *req)
 	ivc_tx->aes.op_gcm.keyslot = gmac_ctx->aes_keyslot;
 	ivc_tx->aes.op_gcm.key_length = gmac_ctx->keylen;
 
-	vse_thread_start = true;
-	init_completion(&priv->alg_complete);
-	mutex_lock(&se_dev->server_lock);
-	/* Return error if engine is in suspended state */
-	if (atomic_read(&se_dev->se_suspended)) {
-		mutex_unlock(&se_dev->server_lock);
+	err = tegra_hv_vse_safety_send_and_wait(se_dev, priv, ivc_req_msg);
+	if (err == -ENODEV) {
 		dev_err(se_dev->dev, "%s: engine is in suspended state", __func__);
-		err = -ENODEV;
-		goto free_exit;
-	}
-	err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-			sizeof(struct tegra_virtual_se_ivc_msg_t));
-	if (err) {
-		dev_err(se_dev->dev, "%s: send_ivc failed %d\n", __func__, err);
-		mutex_unlock(&se_dev->server_lock);
 		goto free_exit;
-	}
-
-	time_left = wait_for_completion_timeout(&priv->alg_complete,
-			TEGRA_HV_VSE_TIMEOUT);
-	mutex_unlock(&se_dev->server_lock);
-	if (time_left == 0UL) {
+	} else if (err == -ETIMEDOUT) {
 		dev_err(se_dev->dev, "%s: completion timeout\n", __func__);
-		err = -ETIMEDOUT;
+		goto free_exit;
+	} else if (err) {
+		dev_err(se_dev->dev, "%s: send_ivc failed %d\n", __func__, err);
 		goto free_exit;
 	}
 
@@ -3420,15 +3941,12 @@ static int tegra_hv_vse_aes_gmac_sv_op(struct ahash_request *req, bool is_last)
 	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg = NULL;
 	struct tegra_virtual_se_ivc_hdr_t *ivc_hdr;
 	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx;
-	struct tegra_hv_ivc_cookie *pivck = g_ivck;
 	struct tegra_vse_priv_data *priv = NULL;
-	struct tegra_vse_tag *priv_data_ptr;
 	void *aad_buf = NULL;
 	void *tag_buf = NULL;
 	dma_addr_t aad_buf_addr;
 	dma_addr_t tag_buf_addr;
 	int err = 0;
-	u64 time_left;
 
 	gmac_ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
 	if (!gmac_ctx) {
@@ -3484,8 +4002,6 @@ static int tegra_hv_vse_aes_gmac_sv_op(struct ahash_request *req, bool is_last)
 	ivc_hdr->header_magic[3] = 'A';
 	ivc_hdr->engine = VIRTUAL_SE_AES0;
 
-	priv_data_ptr = (struct tegra_vse_tag *)ivc_hdr->tag;
-	priv_data_ptr->priv_data = (unsigned int *)priv;
 	priv->cmd = VIRTUAL_SE_AES_GCM_ENC_PROCESS;
 	priv->se_dev = se_dev;
 
@@ -3518,31 +4034,15 @@ static int tegra_hv_vse_aes_gmac_sv_op(struct ahash_request *req, bool is_last)
 		}
 	}
 
-	vse_thread_start = true;
-	init_completion(&priv->alg_complete);
-	mutex_lock(&se_dev->server_lock);
-	/* Return error if engine is in suspended state */
-	if (atomic_read(&se_dev->se_suspended)) {
-		mutex_unlock(&se_dev->server_lock);
+	err = tegra_hv_vse_safety_send_and_wait(se_dev, priv, ivc_req_msg);
+	if (err == -ENODEV) {
 		dev_err(se_dev->dev, "%s: engine is in suspended state\n", __func__);
-		err = -ENODEV;
-		goto free_exit;
-	}
-
-	err = tegra_hv_vse_safety_send_ivc(se_dev, pivck, ivc_req_msg,
-			sizeof(struct tegra_virtual_se_ivc_msg_t));
-	if (err) {
-		mutex_unlock(&se_dev->server_lock);
-		dev_err(se_dev->dev, "%s: send_ivc failed %d\n", __func__, err);
 		goto free_exit;
-	}
-
-	time_left = wait_for_completion_timeout(&priv->alg_complete,
-			TEGRA_HV_VSE_TIMEOUT);
-	mutex_unlock(&se_dev->server_lock);
-	if (time_left == 0UL) {
+	} else if (err == -ETIMEDOUT) {
 		dev_err(se_dev->dev, "%s: completion timeout\n", __func__);
-		err = -ETIMEDOUT;
+		goto free_exit;
+	} else if (err) {
+		dev_err(se_dev->dev, "%s: send_ivc failed %d\n", __func__, err);
 		goto free_exit;
 	}
 
@@ -4050,6 +4550,273 @@ static struct ahash_alg sha_algs[] = {
 	},
 };
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * tcrypt-style AES throughput and latency test. Writing
+ * "<requests> <depth> <bytes>" to debugfs tegra_hv_vse_safety/aes_bench
+ * encrypts <requests> buffers with cbc-aes-tegra, keeping <depth> of them
+ * in flight. Completed requests are resubmitted from their completion
+ * callback. Reading the file shows the result of the last run. Load the
+ * module with standin_server=1 to run it without the SE server.
+ */
+#define TEGRA_VSE_BENCH_MAX_DEPTH	256
+#define TEGRA_VSE_BENCH_MAX_LEN		SZ_1M
+
+struct tegra_vse_bench {
+	struct mutex lock;
+	struct completion done;
+	spinlock_t stat_lock;
+	/* requests still to be submitted and not completed yet */
+	atomic_t remaining;
+	atomic_t pending;
+	u32 depth;
+	u32 len;
+	u64 ops;
+	u64 lat_ns_total;
+	u64 lat_ns_max;
+	u64 elapsed_ns;
+	int err;
+};
+
+struct tegra_vse_bench_req {
+	struct tegra_vse_bench *bench;
+	struct skcipher_request *req;
+	struct scatterlist sg;
+	u8 *buf;
+	u8 iv[TEGRA_VIRTUAL_SE_AES_IV_SIZE];
+	ktime_t submitted;
+};
+
+static struct tegra_vse_bench tegra_vse_bench;
+
+static int tegra_vse_bench_submit(struct tegra_vse_bench_req *br)
+{
+	int err;
+
+	/* iv[0] == 1 would ask for a random IV */
+	memset(br->iv, 0, sizeof(br->iv));
+	br->submitted = ktime_get();
+
+	err = crypto_skcipher_encrypt(br->req);
+	if (err == -EINPROGRESS || err == -EBUSY)
+		return 0;
+
+	return err;
+}
+
+static void tegra_vse_bench_end(struct tegra_vse_bench *bench, int err)
+{
+	if (err) {
+		spin_lock(&bench->stat_lock);
+		if (!bench->err)
+			bench->err = err;
+		spin_unlock(&bench->stat_lock);
+	}
+
+	if (atomic_dec_and_test(&bench->pending))
+		complete(&bench->done);
+}
+
+static void tegra_vse_bench_complete(struct crypto_async_request *areq,
+		int err)
+{
+	struct tegra_vse_bench_req *br = areq->data;
+	struct tegra_vse_bench *bench = br->bench;
+	u64 ns;
+
+	/* moved from the backlog to the engine queue */
+	if (err == -EINPROGRESS)
+		return;
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), br->submitted));
+
+	spin_lock(&bench->stat_lock);
+	bench->ops++;
+	bench->lat_ns_total += ns;
+	bench->lat_ns_max = max(bench->lat_ns_max, ns);
+	spin_unlock(&bench->stat_lock);
+
+	if (!err && atomic_dec_if_positive(&bench->remaining) >= 0) {
+		err = tegra_vse_bench_submit(br);
+		if (!err)
+			return;
+	}
+
+	tegra_vse_bench_end(bench, err);
+}
+
+static int tegra_vse_bench_run(struct tegra_vse_bench *bench, u32 count,
+		u32 depth, u32 len)
+{
+	char key[TEGRA_VIRTUAL_SE_AES_KEYSLOT_LABEL_SIZE] = { 0 };
+	struct tegra_vse_bench_req *brs;
+	struct crypto_skcipher *tfm;
+	ktime_t start;
+	u32 i;
+	int err;
+
+	tfm = crypto_alloc_skcipher("cbc-aes-tegra", 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	snprintf(key, sizeof(key), "%s 1", TEGRA_VIRTUAL_SE_AES_KEYSLOT_LABEL);
+	err = crypto_skcipher_setkey(tfm, key, sizeof(key));
+	if (err)
+		goto free_tfm;
+
+	depth = min(depth, count);
+	brs = kcalloc(depth, sizeof(*brs), GFP_KERNEL);
+	if (!brs) {
+		err = -ENOMEM;
+		goto free_tfm;
+	}
+
+	for (i = 0; i < depth; i++) {
+		struct tegra_vse_bench_req *br = &brs[i];
+
+		br->bench = bench;
+		br->buf = kzalloc(len, GFP_KERNEL);
+		br->req = skcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!br->buf || !br->req) {
+			err = -ENOMEM;
+			goto free_reqs;
+		}
+
+		sg_init_one(&br->sg, br->buf, len);
+		skcipher_request_set_callback(br->req,
+				CRYPTO_TFM_REQ_MAY_BACKLOG,
+				tegra_vse_bench_complete, br);
+		skcipher_request_set_crypt(br->req, &br->sg, &br->sg, len,
+				br->iv);
+	}
+
+	bench->depth = depth;
+	bench->len = len;
+	bench->ops = 0;
+	bench->lat_ns_total = 0;
+	bench->lat_ns_max = 0;
+	bench->err = 0;
+	atomic_set(&bench->remaining, count - depth);
+	atomic_set(&bench->pending, depth);
+	reinit_completion(&bench->done);
+
+	start = ktime_get();
+	for (i = 0; i < depth; i++) {
+		err = tegra_vse_bench_submit(&brs[i]);
+		if (err)
+			tegra_vse_bench_end(bench, err);
+	}
+	wait_for_completion(&bench->done);
+	bench->elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	err = bench->err;
+
+free_reqs:
+	for (i = 0; i < depth; i++) {
+		skcipher_request_free(brs[i].req);
+		kfree(brs[i].buf);
+	}
+	kfree(brs);
+free_tfm:
+	crypto_free_skcipher(tfm);
+	return err;
+}
+
+static int tegra_vse_bench_show(struct seq_file *s, void *data)
+{
+	struct tegra_vse_bench *bench = s->private;
+	u64 us;
+
+	mutex_lock(&bench->lock);
+	us = max_t(u64, div_u64(bench->elapsed_ns, NSEC_PER_USEC), 1);
+	seq_printf(s, "ops: %llu\n", bench->ops);
+	seq_printf(s, "depth: %u\n", bench->depth);
+	seq_printf(s, "bytes_per_op: %u\n", bench->len);
+	seq_printf(s, "elapsed_us: %llu\n", us);
+	seq_printf(s, "ops_per_sec: %llu\n",
+			div64_u64(bench->ops * USEC_PER_SEC, us));
+	seq_printf(s, "mbytes_per_sec: %llu\n",
+			div64_u64(bench->ops * bench->len, us));
+	seq_printf(s, "latency_avg_us: %llu\n", bench->ops ?
+			div64_u64(bench->lat_ns_total,
+				bench->ops * NSEC_PER_USEC) : 0);
+	seq_printf(s, "latency_max_us: %llu\n",
+			div_u64(bench->lat_ns_max, NSEC_PER_USEC));
+	seq_printf(s, "error: %d\n", bench->err);
+	mutex_unlock(&bench->lock);
+
+	return 0;
+}
+
+static int tegra_vse_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_vse_bench_show, inode->i_private);
+}
+
+static ssize_t tegra_vse_bench_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct tegra_vse_bench *bench =
+		((struct seq_file *)file->private_data)->private;
+	u32 reqs, depth, len;
+	char buf[64];
+	int err;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%u %u %u", &reqs, &depth, &len) != 3)
+		return -EINVAL;
+	if (!reqs || !depth || depth > TEGRA_VSE_BENCH_MAX_DEPTH ||
+			!len || len > TEGRA_VSE_BENCH_MAX_LEN ||
+			!IS_ALIGNED(len, TEGRA_VIRTUAL_SE_AES_BLOCK_SIZE))
+		return -EINVAL;
+
+	mutex_lock(&bench->lock);
+	err = tegra_vse_bench_run(bench, reqs, depth, len);
+	mutex_unlock(&bench->lock);
+
+	return err ? err : count;
+}
+
+static const struct file_operations tegra_vse_bench_fops = {
+	.open = tegra_vse_bench_open,
+	.read = seq_read,
+	.write = tegra_vse_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void tegra_hv_vse_safety_bench_init(void)
+{
+	struct dentry *dir = tegra_hv_vse_safety_debugfs_dir();
+
+	mutex_init(&tegra_vse_bench.lock);
+	init_completion(&tegra_vse_bench.done);
+	spin_lock_init(&tegra_vse_bench.stat_lock);
+
+	if (dir)
+		debugfs_create_file("aes_bench", 0600, dir, &tegra_vse_bench,
+				&tegra_vse_bench_fops);
+}
+
+static void tegra_hv_vse_safety_debugfs_remove(void)
+{
+	debugfs_remove_recursive(tegra_vse_debugfs);
+	tegra_vse_debugfs = NULL;
+}
+#else
+static inline void tegra_hv_vse_safety_bench_init(void)
+{
+}
+
+static inline void tegra_hv_vse_safety_debugfs_remove(void)
+{
+}
+#endif
+
 static const struct tegra_vse_soc_info t194_vse_sinfo = {
 	.cmac_hw_padding_supported = false,
 	.gcm_decrypt_supported = false,
@@ -4076,6 +4843,35 @@ static irqreturn_t tegra_vse_irq_handler(int irq, void *data)
 	return IRQ_HANDLED;
 }
 
+/*
+ * Called from the IVC receive thread, which must not run completion
+ * callbacks: a callback may submit again and wait for a credit, and only
+ * this thread returns credits. Return the credit here and complete async
+ * requests from tegra_vse_wq.
+ */
+static void tegra_vse_complete_req(struct tegra_vse_priv_data *priv)
+{
+	if (priv->complete) {
+		tegra_hv_vse_safety_put_credit(priv->se_dev);
+		queue_work(tegra_vse_wq, &priv->complete_work);
+	} else {
+		complete(&priv->alg_complete);
+	}
+}
+
+static int tegra_vse_rx_read(struct tegra_hv_ivc_cookie *pivck,
+	struct tegra_virtual_se_ivc_msg_t *ivc_msg)
+{
+	if (standin_server)
+		return tegra_hv_vse_safety_standin_read(ivc_msg);
+
+	if (!tegra_hv_ivc_can_read(pivck))
+		return 0;
+
+	return tegra_hv_ivc_read(pivck, ivc_msg,
+			sizeof(struct tegra_virtual_se_ivc_msg_t));
+}
+
 static int tegra_vse_kthread(void *unused)
 {
 	struct tegra_virtual_se_dev *se_dev = NULL;
@@ -4109,7 +4905,8 @@ static int tegra_vse_kthread(void *unused)
 			continue;
 		}
 		timeout = TEGRA_VIRTUAL_SE_TIMEOUT_1S;
-		while (tegra_hv_ivc_channel_notified(pivck) != 0) {
+		while (!standin_server &&
+				tegra_hv_ivc_channel_notified(pivck) != 0) {
 			if (!timeout) {
 				reinit_completion(
 					&tegra_vse_complete);
@@ -4127,18 +4924,19 @@ static int tegra_vse_kthread(void *unused)
 			continue;
 		}
 
-		while (tegra_hv_ivc_can_read(pivck)) {
-			read_size = tegra_hv_ivc_read(pivck,
-					ivc_msg,
-					sizeof(struct tegra_virtual_se_ivc_msg_t));
-			if (read_size > 0 &&
-					read_size < sizeof(struct tegra_virtual_se_ivc_msg_t)) {
+		while ((read_size = tegra_vse_rx_read(pivck, ivc_msg)) != 0) {
+			if (read_size < 0) {
+				pr_err("ivc read error %d\n", read_size);
+				break;
+			}
+			if (read_size < sizeof(struct tegra_virtual_se_ivc_msg_t)) {
 				pr_err("Wrong read msg len %d\n", read_size);
 				continue;
 			}
 			p_dat =
 				(struct tegra_vse_tag *)ivc_msg->ivc_hdr.tag;
-			priv = (struct tegra_vse_priv_data *)p_dat->priv_data;
+			/* NULL for responses to requests that timed out */
+			priv = tegra_hv_vse_safety_tag_detach(p_dat);
 			if (!priv) {
 				pr_err("%s no call back info\n", __func__);
 				continue;
@@ -4155,17 +4953,17 @@ static int tegra_vse_kthread(void *unused)
 					memcpy(priv->iv, ivc_msg->rx[0].iv,
 							TEGRA_VIRTUAL_SE_AES_IV_SIZE);
 				}
-				complete(&priv->alg_complete);
+				tegra_vse_complete_req(priv);
 				break;
 			case VIRTUAL_SE_KEY_SLOT:
 				ivc_rx = &ivc_msg->rx[0];
 				priv->slot_num = ivc_rx->keyslot;
-				complete(&priv->alg_complete);
+				tegra_vse_complete_req(priv);
 				break;
 			case VIRTUAL_SE_PROCESS:
 				ivc_rx = &ivc_msg->rx[0];
 				priv->rx_status = ivc_rx->status;
-				complete(&priv->alg_complete);
+				tegra_vse_complete_req(priv);
 				break;
 			case VIRTUAL_CMAC_PROCESS:
 				ivc_rx = &ivc_msg->rx[0];
@@ -4175,7 +4973,7 @@ static int tegra_vse_kthread(void *unused)
 					memcpy(priv->cmac.data, ivc_rx->cmac_result, \
 							TEGRA_VIRTUAL_SE_AES_CMAC_DIGEST_SIZE);
 				}
-				complete(&priv->alg_complete);
+				tegra_vse_complete_req(priv);
 				break;
 			case VIRTUAL_SE_AES_GCM_ENC_PROCESS:
 				ivc_rx = &ivc_msg->rx[0];
@@ -4184,10 +4982,12 @@ static int tegra_vse_kthread(void *unused)
 					memcpy(priv->iv, ivc_rx->iv,
 							TEGRA_VIRTUAL_SE_AES_GCM_IV_SIZE);
 
-				complete(&priv->alg_complete);
+				tegra_vse_complete_req(priv);
 				break;
 			default:
 				dev_err(se_dev->dev, "Unknown command\n");
+				priv->rx_status = ivc_msg->rx[0].status;
+				tegra_vse_complete_req(priv);
 			}
 		}
 	}
@@ -4238,7 +5038,7 @@ static int tegra_hv_vse_safety_probe(struct platform_device *pdev)
 	se_dev->chipdata = pdata;
 
 	if ((se_dev->chipdata->gcm_decrypt_supported) &&
-			(!g_ivmk) &&
+			(!standin_server) && (!g_ivmk) &&
 			((engine_id == VIRTUAL_SE_AES0) || (engine_id == VIRTUAL_SE_AES1))) {
 		err = of_property_read_u32(pdev->dev.of_node, "mempool_id", &mempool_id);
 		if (err) {
@@ -4264,7 +5064,31 @@ static int tegra_hv_vse_safety_probe(struct platform_device *pdev)
 		atomic_set(&se_dev->mempoolbuf_in_use, false);
 	}
 
-	if (!g_ivck) {
+	if (!tegra_vse_wq) {
+		tegra_vse_wq = alloc_workqueue("tegra_vse",
+				WQ_UNBOUND | WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+		if (!tegra_vse_wq) {
+			err = -ENOMEM;
+			goto exit;
+		}
+	}
+
+	if (standin_server && !tegra_vse_task) {
+		dev_info(se_dev->dev, "Virtual SE using local stand-in server\n");
+		init_completion(&tegra_vse_complete);
+
+		tegra_vse_task = kthread_run(tegra_vse_kthread,
+				NULL, "tegra_vse_kthread");
+		if (IS_ERR(tegra_vse_task)) {
+			dev_err(se_dev->dev,
+				"Couldn't create kthread for vse\n");
+			err = PTR_ERR(tegra_vse_task);
+			tegra_vse_task = NULL;
+			goto exit;
+		}
+	}
+
+	if (!standin_server && !g_ivck) {
 		err = of_property_read_u32(pdev->dev.of_node, "ivc", &ivc_id);
 		if (err) {
 			dev_err(&pdev->dev, "ivc property not present\n");
@@ -4302,6 +5126,11 @@ static int tegra_hv_vse_safety_probe(struct platform_device *pdev)
 
 	g_virtual_se_dev[engine_id] = se_dev;
 	mutex_init(&se_dev->mtx);
+	sema_init(&se_dev->credits, TEGRA_HV_VSE_ENGINE_MAX_OUTSTANDING);
+	atomic_set(&se_dev->inflight, 0);
+	spin_lock_init(&se_dev->queue_lock);
+	crypto_init_queue(&se_dev->queue, TEGRA_HV_VSE_ENGINE_QUEUE_LEN);
+	INIT_WORK(&se_dev->queue_work, tegra_hv_vse_safety_aes_queue_worker);
 
 	if (engine_id == VIRTUAL_SE_AES0) {
 		err = crypto_register_ahash(&cmac_alg);
@@ -4336,8 +5165,12 @@ static int tegra_hv_vse_safety_probe(struct platform_device *pdev)
 			goto exit;
 		}
 
+		tegra_hv_vse_safety_bench_init();
 
-		if (se_dev->chipdata->gcm_decrypt_supported) {
+
+		/* GCM needs the IVM mempool, which the stand-in lacks */
+		if (se_dev->chipdata->gcm_decrypt_supported &&
+				!standin_server) {
 			err = crypto_register_aeads(aead_algs, ARRAY_SIZE(aead_algs));
 			if (err) {
 				dev_err(&pdev->dev, "aead alg register failed: %d\n",
@@ -4348,6 +5181,12 @@ static int tegra_hv_vse_safety_probe(struct platform_device *pdev)
 	}
 
 	if (engine_id == VIRTUAL_SE_SHA) {
+		err = tegra_hv_vse_safety_sha_pool_create(se_dev);
+		if (err) {
+			dev_err(&pdev->dev, "sha buffer pool create failed\n");
+			goto exit;
+		}
+
 		for (i = 0; i < ARRAY_SIZE(sha_algs); i++) {
 			err = crypto_register_ahash(&sha_algs[i]);
 			if (err) {
@@ -4363,7 +5202,6 @@ static int tegra_hv_vse_safety_probe(struct platform_device *pdev)
 	/* Set Engine suspended state to false*/
 	atomic_set(&se_dev->se_suspended, 0);
 	platform_set_drvdata(pdev, se_dev);
-	mutex_init(&se_dev->server_lock);
 
 	return 0;
 
@@ -4378,18 +5216,25 @@ static void tegra_hv_vse_safety_shutdown(struct platform_device *pdev)
 	/* Set engine to suspend state */
 	atomic_set(&se_dev->se_suspended, 1);
 
-	/* Wait for  SE server to be free*/
-	while (mutex_is_locked(&se_dev->server_lock))
+	/* Queued AES requests now fail with -ENODEV */
+	flush_work(&se_dev->queue_work);
+
+	/* Wait for outstanding SE server requests to complete */
+	while (atomic_read(&se_dev->inflight))
 		usleep_range(8, 10);
 }
 
 static int tegra_hv_vse_safety_remove(struct platform_device *pdev)
 {
+	struct tegra_virtual_se_dev *se_dev = platform_get_drvdata(pdev);
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(sha_algs); i++)
 		crypto_unregister_ahash(&sha_algs[i]);
 
+	if (se_dev)
+		tegra_hv_vse_safety_sha_pool_destroy(se_dev);
+
 	return 0;
 }
 
@@ -4442,6 +5287,9 @@ static int __init tegra_hv_vse_safety_module_init(void)
 static void __exit tegra_hv_vse_safety_module_exit(void)
 {
 	platform_driver_unregister(&tegra_hv_vse_safety_driver);
+	tegra_hv_vse_safety_debugfs_remove();
+	if (tegra_vse_wq)
+		destroy_workqueue(tegra_vse_wq);
 }
 
 module_init(tegra_hv_vse_safety_module_init);
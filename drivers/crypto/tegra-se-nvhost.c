@@ -51,6 +51,10 @@
 #include <linux/version.h>
 #include <linux/pm_qos.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/platform/tegra/emc_bwmgr.h>
 #include <dt-bindings/interconnect/tegra_icc_id.h>
 
@@ -158,6 +162,20 @@ enum tegra_se_callback {
 	SHA_CB,
 };
 
+/* AES data path statistics, copy (bounce buffer) vs zero-copy */
+struct tegra_se_aes_dma_stats {
+	atomic64_t zc_reqs;
+	atomic64_t zc_bytes;
+	atomic64_t zc_ns;	/* summed batch latency */
+	atomic64_t bounce_reqs;
+	atomic64_t bounce_bytes;
+	atomic64_t bounce_ns;	/* summed batch latency */
+	atomic64_t copy_ns;	/* CPU time spent in bounce copies */
+	atomic64_t fallback_unaligned;
+	atomic64_t fallback_nents;
+	atomic64_t fallback_map;
+};
+
 struct tegra_se_dev {
 	struct platform_device *pdev;
 	struct device *dev;
@@ -225,9 +243,38 @@ struct tegra_se_dev {
 	bool sha_last;
 	bool sha_src_mapped;
 	bool sha_dst_mapped;
+	/* Zero-copy AES: request scatterlists mapped straight into LL */
+	bool aes_zc_enable;
+	bool aes_zero_copy;
+	struct tegra_se_ll *aes_zc_src_ll;
+	struct tegra_se_ll *aes_zc_dst_ll;
+	unsigned int aes_zc_ll_cur;
+	ktime_t aes_batch_start;
+	struct tegra_se_aes_dma_stats aes_stats;
+	struct dentry *debugfs_dir;
+	/* Dispatcher load and engine utilization accounting */
+	atomic_t aes_pending;	/* AES requests queued or on the engine */
+	atomic_t aes_tfms;	/* AES tfms bound to this engine */
+	struct list_head aes_ctxs;	/* Their contexts, se_engines_lock */
+	atomic64_t aes_dispatched;
+	atomic64_t aes_completed;
+	spinlock_t busy_lock;	/* Protect busy time accounting */
+	unsigned int busy_jobs;
+	ktime_t busy_since;
+	u64 busy_ns;
+	ktime_t stats_start;
 };
 
 static struct tegra_se_dev *se_devices[NUM_SE_ALGO];
+/* All engines per algorithm, se_devices[] holds the first one */
+static struct tegra_se_dev *se_engines[NUM_SE_ALGO][SE_MAX_ENGINES];
+static unsigned int se_num_engines[NUM_SE_ALGO];
+static atomic_t se_aes_rr = ATOMIC_INIT(0);
+/* Protects the engine set, tfm binding and AES algorithm registration */
+static DEFINE_MUTEX(se_engines_lock);
+static bool se_aes_algs_registered;
+static bool se_aes_xts_registered;
+static struct dentry *tegra_se_debugfs_root;
 
 /* Security Engine request context */
 struct tegra_se_req_context {
@@ -254,10 +301,12 @@ struct tegra_se_priv_data {
 	bool sha_last;
 	bool sha_src_mapped;
 	bool sha_dst_mapped;
+	bool zero_copy;
 	dma_addr_t buf_addr;
 	dma_addr_t iova;
 	unsigned int cmdbuf_node;
 	unsigned int aesbuf_entry;
+	ktime_t start;
 };
 
 /* Security Engine AES context */
@@ -269,7 +318,9 @@ struct tegra_se_aes_context {
 	u32 keylen;	/* key length in bits */
 	u32 op_mode;	/* AES operation mode */
 	bool is_key_in_mem; /* Whether key is in memory */
-	u8 key[64]; /* To store key if is_key_in_mem set */
+	u8 key[64]; /* To store key if is_key_in_mem set or in own slot */
+	struct crypto_skcipher *tfm;	/* To reload the key on migration */
+	struct list_head node;	/* Entry in se_dev->aes_ctxs */
 };
 
 /* Security Engine random number generator context */
@@ -1031,6 +1082,23 @@ static unsigned int tegra_se_count_sgs(struct scatterlist *sl, u32 nbytes)
 	return sg_nents;
 }
 
+static void tegra_se_aes_unmap_zc_req(struct device *dev,
+				      struct skcipher_request *req)
+{
+	if (req->src == req->dst) {
+		dma_unmap_sg(dev, req->src,
+			     tegra_se_count_sgs(req->src, req->cryptlen),
+			     DMA_BIDIRECTIONAL);
+	} else {
+		dma_unmap_sg(dev, req->src,
+			     tegra_se_count_sgs(req->src, req->cryptlen),
+			     DMA_TO_DEVICE);
+		dma_unmap_sg(dev, req->dst,
+			     tegra_se_count_sgs(req->dst, req->cryptlen),
+			     DMA_FROM_DEVICE);
+	}
+}
+
 static int tegra_se_get_free_cmdbuf(struct tegra_se_dev *se_dev)
 {
 	int i = 0;
@@ -1049,6 +1117,28 @@ static int tegra_se_get_free_cmdbuf(struct tegra_se_dev *se_dev)
 	return (i == SE_MAX_CMDBUF_TIMEOUT) ? -ENOMEM : index;
 }
 
+/* Engine busy time: accumulated while at least one job is on the engine */
+static void tegra_se_engine_busy(struct tegra_se_dev *se_dev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&se_dev->busy_lock, flags);
+	if (!se_dev->busy_jobs++)
+		se_dev->busy_since = ktime_get();
+	spin_unlock_irqrestore(&se_dev->busy_lock, flags);
+}
+
+static void tegra_se_engine_idle(struct tegra_se_dev *se_dev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&se_dev->busy_lock, flags);
+	if (se_dev->busy_jobs && !--se_dev->busy_jobs)
+		se_dev->busy_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							 se_dev->busy_since));
+	spin_unlock_irqrestore(&se_dev->busy_lock, flags);
+}
+
 static void tegra_se_sha_complete_callback(void *priv, int nr_completed)
 {
 	struct tegra_se_priv_data *priv_data = priv;
@@ -1063,6 +1153,7 @@ static void tegra_se_sha_complete_callback(void *priv, int nr_completed)
 
 	se_dev = priv_data->se_dev;
 	atomic_set(&se_dev->cmdbuf_addr_list[priv_data->cmdbuf_node].free, 1);
+	tegra_se_engine_idle(se_dev);
 
 	req = priv_data->sha_req;
 	if (!req) {
@@ -1110,6 +1201,7 @@ static void tegra_se_aes_complete_callback(void *priv, int nr_completed)
 	struct tegra_se_priv_data *priv_data = priv;
 	struct skcipher_request *req;
 	struct tegra_se_dev *se_dev;
+	ktime_t copy_start, now;
 	void *buf;
 	u32 num_sgs;
 
@@ -1117,16 +1209,38 @@ static void tegra_se_aes_complete_callback(void *priv, int nr_completed)
 
 	se_dev = priv_data->se_dev;
 	atomic_set(&se_dev->cmdbuf_addr_list[priv_data->cmdbuf_node].free, 1);
+	tegra_se_engine_idle(se_dev);
 
 	if (!priv_data->req_cnt) {
 		devm_kfree(se_dev->dev, priv_data);
 		return;
 	}
 
+	atomic_sub(priv_data->req_cnt, &se_dev->aes_pending);
+	atomic64_add(priv_data->req_cnt, &se_dev->aes_completed);
+
+	if (priv_data->zero_copy) {
+		for (i = 0; i < priv_data->req_cnt; i++) {
+			req = priv_data->reqs[i];
+			tegra_se_aes_unmap_zc_req(se_dev->dev, req);
+			req->base.complete(&req->base, 0);
+		}
+
+		atomic64_add(priv_data->req_cnt, &se_dev->aes_stats.zc_reqs);
+		atomic64_add(priv_data->gather_buf_sz,
+			     &se_dev->aes_stats.zc_bytes);
+		atomic64_add(ktime_to_ns(ktime_sub(ktime_get(),
+						   priv_data->start)),
+			     &se_dev->aes_stats.zc_ns);
+		devm_kfree(se_dev->dev, priv_data);
+		return;
+	}
+
 	if (!se_dev->ioc)
 		dma_sync_single_for_cpu(se_dev->dev, priv_data->buf_addr,
 				priv_data->gather_buf_sz, DMA_BIDIRECTIONAL);
 
+	copy_start = ktime_get();
 	buf = priv_data->buf;
 	for (i = 0; i < priv_data->req_cnt; i++) {
 		req = priv_data->reqs[i];
@@ -1149,6 +1263,14 @@ static void tegra_se_aes_complete_callback(void *priv, int nr_completed)
 		req->base.complete(&req->base, 0);
 	}
 
+	now = ktime_get();
+	atomic64_add(ktime_to_ns(ktime_sub(now, copy_start)),
+		     &se_dev->aes_stats.copy_ns);
+	atomic64_add(priv_data->req_cnt, &se_dev->aes_stats.bounce_reqs);
+	atomic64_add(priv_data->gather_buf_sz, &se_dev->aes_stats.bounce_bytes);
+	atomic64_add(ktime_to_ns(ktime_sub(now, priv_data->start)),
+		     &se_dev->aes_stats.bounce_ns);
+
 	if (!se_dev->ioc)
 		dma_unmap_sg(se_dev->dev, &priv_data->sg, 1, DMA_BIDIRECTIONAL);
 
@@ -1249,9 +1371,16 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 		goto error;
 	}
 
+	/*
+	 * Every job (AES, SHA, CMAC, RSA, key loads) is accounted from here
+	 * until its completion: in the AES/SHA callbacks, or below for jobs
+	 * waited for synchronously.
+	 */
+	tegra_se_engine_busy(se_dev);
 	err = nvhost_channel_submit(job);
 	if (err) {
 		dev_err(se_dev->dev, "Nvhost submit failed\n");
+		tegra_se_engine_idle(se_dev);
 		goto error;
 	}
 	pr_debug("%s:%d submitted job\n", __func__, __LINE__);
@@ -1261,21 +1390,28 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 		for (i = 0; i < se_dev->req_cnt; i++)
 			priv->reqs[i] = se_dev->reqs[i];
 
-		if (!se_dev->ioc)
-			priv->sg = se_dev->sg;
-
-		if (unlikely(se_dev->dynamic_mem)) {
-			priv->buf = se_dev->aes_buf;
-			priv->dynmem = se_dev->dynamic_mem;
+		if (se_dev->aes_zero_copy) {
+			priv->zero_copy = true;
 		} else {
-			priv->buf = se_dev->aes_bufs[se_dev->aesbuf_entry];
-			priv->aesbuf_entry = se_dev->aesbuf_entry;
+			if (!se_dev->ioc)
+				priv->sg = se_dev->sg;
+
+			if (unlikely(se_dev->dynamic_mem)) {
+				priv->buf = se_dev->aes_buf;
+				priv->dynmem = se_dev->dynamic_mem;
+			} else {
+				priv->buf =
+					se_dev->aes_bufs[se_dev->aesbuf_entry];
+				priv->aesbuf_entry = se_dev->aesbuf_entry;
+			}
+
+			priv->buf_addr = se_dev->aes_addr;
 		}
 
-		priv->buf_addr = se_dev->aes_addr;
 		priv->req_cnt = se_dev->req_cnt;
 		priv->gather_buf_sz = se_dev->gather_buf_sz;
 		priv->cmdbuf_node = se_dev->cmdbuf_list_entry;
+		priv->start = se_dev->aes_batch_start;
 
 		/* Register callback to be called once
 		 * syncpt value has been reached
@@ -1286,6 +1422,7 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 		if (err) {
 			dev_err(se_dev->dev,
 				"add nvhost interrupt action failed for AES\n");
+			tegra_se_engine_idle(se_dev);
 			goto error;
 		}
 	} else if (callback == SHA_CB) {
@@ -1306,6 +1443,7 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 		if (err) {
 			dev_err(se_dev->dev,
 				"add nvhost interrupt action failed for SHA\n");
+			tegra_se_engine_idle(se_dev);
 			goto error;
 		}
 	} else {
@@ -1313,6 +1451,7 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 		nvhost_syncpt_wait_timeout_ext(
 			se_dev->pdev, job->sp->id, job->sp->fence,
 			U32_MAX, NULL, NULL);
+		tegra_se_engine_idle(se_dev);
 
 		if (se_dev->cmdbuf_addr_list)
 			atomic_set(&se_dev->cmdbuf_addr_list[
@@ -1327,6 +1466,7 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 	se_dev->sha_src_mapped = false;
 	se_dev->sha_dst_mapped = false;
 	se_dev->sha_last = false;
+	se_dev->aes_zero_copy = false;
 error:
 	nvhost_job_put(job);
 	job = NULL;
@@ -2016,7 +2156,10 @@ static void tegra_se_send_data(struct tegra_se_dev *se_dev,
 	struct tegra_se_ll *src_ll;
 	struct tegra_se_ll *dst_ll;
 
-	if (req) {
+	if (req && se_dev->aes_zero_copy) {
+		src_ll = se_dev->aes_zc_src_ll + se_dev->aes_zc_ll_cur;
+		dst_ll = se_dev->aes_zc_dst_ll + se_dev->aes_zc_ll_cur;
+	} else if (req) {
 		src_ll = se_dev->aes_src_ll;
 		dst_ll = se_dev->aes_dst_ll;
 		src_ll->addr = se_dev->aes_cur_addr;
@@ -2108,11 +2251,13 @@ static void tegra_se_send_data(struct tegra_se_dev *se_dev,
 		total -= src_ll->data_len;
 		src_ll++;
 		dst_ll++;
+		if (req && se_dev->aes_zero_copy)
+			se_dev->aes_zc_ll_cur++;
 	}
 
 	cmdbuf_num_words = i;
 	se_dev->cmdbuf_cnt = i;
-	if (req)
+	if (req && !se_dev->aes_zero_copy)
 		se_dev->aes_cur_addr += req->cryptlen;
 }
 
@@ -2237,9 +2382,199 @@ static int tegra_map_sg(struct device *dev, struct scatterlist *sg,
 	return ret;
 }
 
+/*
+ * Walk src and dst of a request in lock step and check that every LL
+ * chunk (split at either side's segment boundary) starts block aligned and,
+ * except for the last one, is a whole number of AES blocks so the engine
+ * can restart across chunks. Returns the number of LL entries needed, or
+ * 0 if the request has to go through the bounce buffer. DMA mapping can
+ * only merge segments, so the count is an upper bound for the mapped list.
+ */
+static unsigned int tegra_se_aes_zc_count_ll(struct skcipher_request *req)
+{
+	struct scatterlist *src = req->src, *dst = req->dst;
+	u32 src_off = 0, dst_off = 0, total = req->cryptlen, chunk;
+	unsigned int cnt = 0;
+
+	if (!total)
+		return 0;
+
+	while (total) {
+		if (!src || !dst)
+			return 0;
+
+		if (!IS_ALIGNED(src->offset + src_off, TEGRA_SE_AES_BLOCK_SIZE) ||
+		    !IS_ALIGNED(dst->offset + dst_off, TEGRA_SE_AES_BLOCK_SIZE))
+			return 0;
+
+		chunk = min3(src->length - src_off, dst->length - dst_off,
+			     total);
+		if (chunk) {
+			if (chunk != total &&
+			    !IS_ALIGNED(chunk, TEGRA_SE_AES_BLOCK_SIZE))
+				return 0;
+			if (chunk > SE_AES_ZC_MAX_LL_LEN ||
+			    ++cnt > SE_AES_ZC_MAX_LL)
+				return 0;
+		}
+
+		total -= chunk;
+		src_off += chunk;
+		dst_off += chunk;
+		if (src_off == src->length) {
+			src = sg_next(src);
+			src_off = 0;
+		}
+		if (dst_off == dst->length) {
+			dst = sg_next(dst);
+			dst_off = 0;
+		}
+	}
+
+	return cnt;
+}
+
+/* Same walk as above over the DMA mapped lists, filling the LL entries */
+static int tegra_se_aes_zc_fill_ll(struct scatterlist *src, int src_cnt,
+				   struct scatterlist *dst, int dst_cnt,
+				   u32 total, struct tegra_se_ll *src_ll,
+				   struct tegra_se_ll *dst_ll,
+				   unsigned int max_ll)
+{
+	u32 src_off = 0, dst_off = 0, chunk;
+	unsigned int cnt = 0;
+
+	while (total) {
+		if (!src_cnt || !dst_cnt)
+			return -EINVAL;
+
+		chunk = min3(sg_dma_len(src) - src_off,
+			     sg_dma_len(dst) - dst_off, total);
+		if (chunk) {
+			if (cnt == max_ll || chunk > SE_AES_ZC_MAX_LL_LEN ||
+			    (chunk != total &&
+			     !IS_ALIGNED(chunk, TEGRA_SE_AES_BLOCK_SIZE)))
+				return -EINVAL;
+
+			src_ll[cnt].addr = sg_dma_address(src) + src_off;
+			src_ll[cnt].data_len = chunk;
+			dst_ll[cnt].addr = sg_dma_address(dst) + dst_off;
+			dst_ll[cnt].data_len = chunk;
+			cnt++;
+		}
+
+		total -= chunk;
+		src_off += chunk;
+		dst_off += chunk;
+		if (src_off == sg_dma_len(src)) {
+			src = sg_next(src);
+			src_cnt--;
+			src_off = 0;
+		}
+		if (dst_off == sg_dma_len(dst)) {
+			dst = sg_next(dst);
+			dst_cnt--;
+			dst_off = 0;
+		}
+	}
+
+	return cnt;
+}
+
+static int tegra_se_aes_map_zc_req(struct tegra_se_dev *se_dev,
+				   struct skcipher_request *req,
+				   unsigned int ll_idx)
+{
+	int src_cnt, dst_cnt, ret;
+
+	if (req->src == req->dst) {
+		src_cnt = dma_map_sg(se_dev->dev, req->src,
+				     tegra_se_count_sgs(req->src, req->cryptlen),
+				     DMA_BIDIRECTIONAL);
+		if (!src_cnt)
+			return -ENOMEM;
+		dst_cnt = src_cnt;
+	} else {
+		src_cnt = dma_map_sg(se_dev->dev, req->src,
+				     tegra_se_count_sgs(req->src, req->cryptlen),
+				     DMA_TO_DEVICE);
+		if (!src_cnt)
+			return -ENOMEM;
+
+		dst_cnt = dma_map_sg(se_dev->dev, req->dst,
+				     tegra_se_count_sgs(req->dst, req->cryptlen),
+				     DMA_FROM_DEVICE);
+		if (!dst_cnt) {
+			dma_unmap_sg(se_dev->dev, req->src,
+				     tegra_se_count_sgs(req->src,
+							req->cryptlen),
+				     DMA_TO_DEVICE);
+			return -ENOMEM;
+		}
+	}
+
+	ret = tegra_se_aes_zc_fill_ll(req->src, src_cnt, req->dst, dst_cnt,
+				      req->cryptlen,
+				      se_dev->aes_zc_src_ll + ll_idx,
+				      se_dev->aes_zc_dst_ll + ll_idx,
+				      SE_AES_ZC_MAX_LL - ll_idx);
+	if (ret < 0)
+		tegra_se_aes_unmap_zc_req(se_dev->dev, req);
+
+	return ret;
+}
+
+/*
+ * Try to map all requests of the current batch for zero-copy. Falls back
+ * to the bounce buffer for the whole batch if any request has a misaligned
+ * fragment or the batch needs more LL entries than a command buffer holds.
+ */
+static int tegra_se_aes_map_zc_reqs(struct tegra_se_dev *se_dev)
+{
+	struct tegra_se_aes_dma_stats *stats = &se_dev->aes_stats;
+	unsigned int i, j, cnt, nr_ll = 0;
+	int ret;
+
+	if (!READ_ONCE(se_dev->aes_zc_enable) || !se_dev->aes_zc_src_ll)
+		return -EOPNOTSUPP;
+
+	for (i = 0; i < se_dev->req_cnt; i++) {
+		cnt = tegra_se_aes_zc_count_ll(se_dev->reqs[i]);
+		if (!cnt) {
+			atomic64_inc(&stats->fallback_unaligned);
+			return -EINVAL;
+		}
+
+		nr_ll += cnt;
+		if (nr_ll > SE_AES_ZC_MAX_LL) {
+			atomic64_inc(&stats->fallback_nents);
+			return -E2BIG;
+		}
+	}
+
+	nr_ll = 0;
+	for (i = 0; i < se_dev->req_cnt; i++) {
+		ret = tegra_se_aes_map_zc_req(se_dev, se_dev->reqs[i], nr_ll);
+		if (ret < 0) {
+			for (j = 0; j < i; j++)
+				tegra_se_aes_unmap_zc_req(se_dev->dev,
+							  se_dev->reqs[j]);
+			atomic64_inc(&stats->fallback_map);
+			return ret;
+		}
+		nr_ll += ret;
+	}
+
+	se_dev->aes_zc_ll_cur = 0;
+	se_dev->aes_zero_copy = true;
+
+	return 0;
+}
+
 static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev)
 {
 	struct skcipher_request *req;
+	ktime_t copy_start;
 	void *buf;
 	int i, ret = 0;
 	u32 num_sgs;
@@ -2276,6 +2611,7 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev)
 		buf = se_dev->aes_bufs[index];
 	}
 
+	copy_start = ktime_get();
 	for (i = 0; i < se_dev->req_cnt; i++) {
 		req = se_dev->reqs[i];
 
@@ -2287,6 +2623,8 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev)
 			sg_copy_to_buffer(req->src, num_sgs, buf, req->cryptlen);
 		buf += req->cryptlen;
 	}
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), copy_start)),
+		     &se_dev->aes_stats.copy_ns);
 
 	if (se_dev->ioc) {
 		if (unlikely(se_dev->dynamic_mem))
@@ -2438,18 +2776,21 @@ static void tegra_se_process_new_req(struct tegra_se_dev *se_dev)
 				se_dev->req_cnt);
 
 	tegra_se_boost_cpu_freq(se_dev);
+	se_dev->aes_batch_start = ktime_get();
 
-	for (i = 0; i < se_dev->req_cnt; i++) {
-		req = se_dev->reqs[i];
-		if (req->cryptlen != SE_STATIC_MEM_ALLOC_BUFSZ) {
-			se_dev->dynamic_mem = true;
-			break;
+	if (tegra_se_aes_map_zc_reqs(se_dev)) {
+		for (i = 0; i < se_dev->req_cnt; i++) {
+			req = se_dev->reqs[i];
+			if (req->cryptlen != SE_STATIC_MEM_ALLOC_BUFSZ) {
+				se_dev->dynamic_mem = true;
+				break;
+			}
 		}
-	}
 
-	err = tegra_se_setup_ablk_req(se_dev);
-	if (err)
-		goto mem_out;
+		err = tegra_se_setup_ablk_req(se_dev);
+		if (err)
+			goto mem_out;
+	}
 
 	err = tegra_se_get_free_cmdbuf(se_dev);
 	if (err < 0) {
@@ -2479,9 +2820,16 @@ static void tegra_se_process_new_req(struct tegra_se_dev *se_dev)
 cmdbuf_out:
 	atomic_set(&se_dev->cmdbuf_addr_list[index].free, 1);
 index_out:
-	dma_unmap_sg(se_dev->dev, &se_dev->sg, 1, DMA_BIDIRECTIONAL);
-	kfree(se_dev->aes_buf);
+	if (se_dev->aes_zero_copy) {
+		for (i = 0; i < se_dev->req_cnt; i++)
+			tegra_se_aes_unmap_zc_req(se_dev->dev,
+						  se_dev->reqs[i]);
+	} else {
+		dma_unmap_sg(se_dev->dev, &se_dev->sg, 1, DMA_BIDIRECTIONAL);
+		kfree(se_dev->aes_buf);
+	}
 mem_out:
+	atomic_sub(se_dev->req_cnt, &se_dev->aes_pending);
 	for (i = 0; i < se_dev->req_cnt; i++) {
 		req = se_dev->reqs[i];
 		req->base.complete(&req->base, err);
@@ -2490,6 +2838,7 @@ mem_out:
 	se_dev->gather_buf_sz = 0;
 	se_dev->cmdbuf_cnt = 0;
 	se_dev->dynamic_mem = false;
+	se_dev->aes_zero_copy = false;
 }
 
 static void tegra_se_work_handler(struct work_struct *work)
@@ -2501,7 +2850,6 @@ static void tegra_se_work_handler(struct work_struct *work)
 	struct skcipher_request *req;
 	bool process_requests;
 
-	mutex_lock(&se_dev->mtx);
 	do {
 		process_requests = false;
 		mutex_lock(&se_dev->lock);
@@ -2529,10 +2877,86 @@ static void tegra_se_work_handler(struct work_struct *work)
 			 (se_dev->req_cnt < SE_MAX_TASKS_PER_SUBMIT));
 		mutex_unlock(&se_dev->lock);
 
-		if (process_requests)
+		/*
+		 * Take the engine per batch, not for the whole drain, so
+		 * synchronous hash/RSA users of this engine get in between
+		 * bulk cipher batches.
+		 */
+		if (process_requests) {
+			mutex_lock(&se_dev->mtx);
 			tegra_se_process_new_req(se_dev);
+			mutex_unlock(&se_dev->mtx);
+		}
 	} while (se_dev->work_q_busy);
-	mutex_unlock(&se_dev->mtx);
+}
+
+/*
+ * Pick the AES engine a new tfm is bound to: the one with the fewest bound
+ * tfms, round-robin on ties. A tfm's key slot is only loaded and used by
+ * its engine, so engines never race on a slot's key or updated IV, and
+ * setkey is serialized with the engine's requests by its mutex.
+ */
+static struct tegra_se_dev *tegra_se_aes_pick_engine(void)
+{
+	struct tegra_se_dev *se_dev, *best = se_devices[SE_AES];
+	unsigned int i, n, start, load, best_load = UINT_MAX;
+
+	n = READ_ONCE(se_num_engines[SE_AES]);
+	if (n <= 1)
+		return best;
+
+	start = atomic_inc_return(&se_aes_rr);
+	for (i = 0; i < n; i++) {
+		se_dev = se_engines[SE_AES][(start + i) % n];
+		load = atomic_read(&se_dev->aes_tfms);
+		if (load < best_load) {
+			best = se_dev;
+			best_load = load;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * move a tfm to another engine, e.g. one that owns a shared key slot.
+ * Called with se_engines_lock held, so an engine being removed sees all
+ * tfms bound to it.
+ */
+static void tegra_se_aes_bind_engine(struct tegra_se_aes_context *ctx,
+				     struct tegra_se_dev *se_dev)
+{
+	lockdep_assert_held(&se_engines_lock);
+
+	if (ctx->se_dev == se_dev)
+		return;
+
+	if (ctx->se_dev) {
+		atomic_dec(&ctx->se_dev->aes_tfms);
+		list_del_init(&ctx->node);
+	}
+	if (se_dev) {
+		atomic_inc(&se_dev->aes_tfms);
+		list_add_tail(&ctx->node, &se_dev->aes_ctxs);
+	}
+	WRITE_ONCE(ctx->se_dev, se_dev);
+}
+
+/* key loaded into a slot allocated for this tfm, lost with its engine */
+static bool tegra_se_aes_own_slot(struct tegra_se_aes_context *ctx)
+{
+	return ctx->slot && !ctx->is_key_in_mem &&
+	       ctx->slot != &ssk_slot && ctx->slot != &pre_allocated_slot &&
+	       ctx->slot != &keymem_slot;
+}
+
+static struct tegra_se_dev *tegra_se_aes_req_engine(
+	struct skcipher_request *req)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
+	struct tegra_se_aes_context *ctx = crypto_skcipher_ctx(tfm);
+
+	return READ_ONCE(ctx->se_dev);
 }
 
 static int tegra_se_aes_queue_req(struct tegra_se_dev *se_dev,
@@ -2542,6 +2966,11 @@ static int tegra_se_aes_queue_req(struct tegra_se_dev *se_dev,
 
 	mutex_lock(&se_dev->lock);
 	err = crypto_enqueue_request(&se_dev->queue, &req->base);
+	if (err == -EINPROGRESS ||
+	    (err == -EBUSY && (req->base.flags & CRYPTO_TFM_REQ_MAY_BACKLOG))) {
+		atomic_inc(&se_dev->aes_pending);
+		atomic64_inc(&se_dev->aes_dispatched);
+	}
 
 	if (!se_dev->work_q_busy) {
 		se_dev->work_q_busy = true;
@@ -2558,7 +2987,7 @@ static int tegra_se_aes_xts_encrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	if (!req_ctx->se_dev) {
 		pr_err("Device is NULL\n");
 		return -ENODEV;
@@ -2574,7 +3003,7 @@ static int tegra_se_aes_xts_decrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	if (!req_ctx->se_dev) {
 		pr_err("Device is NULL\n");
 		return -ENODEV;
@@ -2590,7 +3019,7 @@ static int tegra_se_aes_cbc_encrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	req_ctx->encrypt = true;
 	req_ctx->op_mode = SE_AES_OP_MODE_CBC;
 
@@ -2601,7 +3030,7 @@ static int tegra_se_aes_cbc_decrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	req_ctx->encrypt = false;
 	req_ctx->op_mode = SE_AES_OP_MODE_CBC;
 
@@ -2612,7 +3041,7 @@ static int tegra_se_aes_ecb_encrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	req_ctx->encrypt = true;
 	req_ctx->op_mode = SE_AES_OP_MODE_ECB;
 
@@ -2623,7 +3052,7 @@ static int tegra_se_aes_ecb_decrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	req_ctx->encrypt = false;
 	req_ctx->op_mode = SE_AES_OP_MODE_ECB;
 
@@ -2634,7 +3063,7 @@ static int tegra_se_aes_ctr_encrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	req_ctx->encrypt = true;
 	req_ctx->op_mode = SE_AES_OP_MODE_CTR;
 
@@ -2645,7 +3074,7 @@ static int tegra_se_aes_ctr_decrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	req_ctx->encrypt = false;
 	req_ctx->op_mode = SE_AES_OP_MODE_CTR;
 
@@ -2656,7 +3085,7 @@ static int tegra_se_aes_ofb_encrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	req_ctx->encrypt = true;
 	req_ctx->op_mode = SE_AES_OP_MODE_OFB;
 
@@ -2667,7 +3096,7 @@ static int tegra_se_aes_ofb_decrypt(struct skcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = skcipher_request_ctx(req);
 
-	req_ctx->se_dev = se_devices[SE_AES];
+	req_ctx->se_dev = tegra_se_aes_req_engine(req);
 	req_ctx->encrypt = false;
 	req_ctx->op_mode = SE_AES_OP_MODE_OFB;
 
@@ -2689,8 +3118,9 @@ static void tegra_se_init_aesbuf(struct tegra_se_dev *se_dev)
 	}
 }
 
-static int tegra_se_aes_setkey(struct crypto_skcipher *tfm,
-			       const u8 *key, u32 keylen)
+/* load the key on the engine the tfm is bound to, se_engines_lock held */
+static int __tegra_se_aes_setkey(struct crypto_skcipher *tfm,
+				 const u8 *key, u32 keylen)
 {
 	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(&tfm->base);
 	struct tegra_se_dev *se_dev;
@@ -2701,13 +3131,11 @@ static int tegra_se_aes_setkey(struct crypto_skcipher *tfm,
 	u32 *cpuvaddr = NULL;
 	dma_addr_t iova = 0;
 
-	se_dev = se_devices[SE_AES];
-
-	if (!ctx || !se_dev) {
-		pr_err("invalid context or dev");
+	se_dev = ctx->se_dev;
+	if (!se_dev) {
+		pr_err("invalid dev");
 		return -EINVAL;
 	}
-	ctx->se_dev = se_dev;
 
 	if (((keylen & SE_KEY_LEN_MASK) != TEGRA_SE_KEY_128_SIZE) &&
 	    ((keylen & SE_KEY_LEN_MASK) != TEGRA_SE_KEY_192_SIZE) &&
@@ -2753,6 +3181,9 @@ static int tegra_se_aes_setkey(struct crypto_skcipher *tfm,
 			}
 		}
 		ctx->keylen = keylen;
+		/* kept to reload the slot if the engine goes away */
+		if (key != ctx->key)
+			memcpy(ctx->key, key, keylen & SE_KEY_LEN_MASK);
 	} else if ((keylen >> SE_MAGIC_PATTERN_OFFSET) == SE_MAGIC_PATTERN) {
 		ctx->slot = &pre_allocated_slot;
 		spin_lock(&key_slot_lock);
@@ -2822,10 +3253,51 @@ out:
 	return ret;
 }
 
+static int tegra_se_aes_setkey(struct crypto_skcipher *tfm,
+			       const u8 *key, u32 keylen)
+{
+	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(&tfm->base);
+	int ret;
+
+	if (!ctx) {
+		pr_err("invalid context");
+		return -EINVAL;
+	}
+
+	/*
+	 * Shared key slots (SSK, pre-allocated, key in memory) are only used
+	 * from the first engine, own slots from the engine the tfm is bound to.
+	 * The engine set must not change until the key is loaded.
+	 */
+	mutex_lock(&se_engines_lock);
+	if (key && (keylen >> SE_MAGIC_PATTERN_OFFSET) != SE_STORE_KEY_IN_MEM) {
+		if (!ctx->se_dev)
+			tegra_se_aes_bind_engine(ctx,
+						 tegra_se_aes_pick_engine());
+	} else {
+		tegra_se_aes_bind_engine(ctx, se_devices[SE_AES]);
+	}
+
+	ret = __tegra_se_aes_setkey(tfm, key, keylen);
+	mutex_unlock(&se_engines_lock);
+
+	return ret;
+}
+
 static int tegra_se_aes_cra_init(struct crypto_skcipher *tfm)
 {
+	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(&tfm->base);
+
 	tfm->reqsize = sizeof(struct tegra_se_req_context);
 
+	/* spread tfms, not requests, over the engines */
+	ctx->se_dev = NULL;
+	ctx->tfm = tfm;
+	INIT_LIST_HEAD(&ctx->node);
+	mutex_lock(&se_engines_lock);
+	tegra_se_aes_bind_engine(ctx, tegra_se_aes_pick_engine());
+	mutex_unlock(&se_engines_lock);
+
 	return 0;
 }
 
@@ -2833,10 +3305,14 @@ static void tegra_se_aes_cra_exit(struct crypto_skcipher *tfm)
 {
 	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(&tfm->base);
 
+	mutex_lock(&se_engines_lock);
+	tegra_se_aes_bind_engine(ctx, NULL);
+	mutex_unlock(&se_engines_lock);
 	tegra_se_free_key_slot(ctx->slot);
 	tegra_se_free_key_slot(ctx->slot2);
 	ctx->slot = NULL;
 	ctx->slot2 = NULL;
+	memzero_explicit(ctx->key, sizeof(ctx->key));
 }
 
 static int tegra_se_rng_drbg_init(struct crypto_tfm *tfm)
@@ -7114,22 +7590,281 @@ static bool is_algo_supported(struct device_node *node, char *algo)
 		return false;
 }
 
+static void tegra_se_add_engine(struct tegra_se_dev *se_dev,
+				enum tegra_se_algo algo)
+{
+	unsigned int n = se_num_engines[algo];
+
+	if (!se_devices[algo])
+		se_devices[algo] = se_dev;
+
+	if (n < SE_MAX_ENGINES) {
+		se_engines[algo][n] = se_dev;
+		WRITE_ONCE(se_num_engines[algo], n + 1);
+	} else {
+		dev_warn(se_dev->dev, "too many engines for algo %d\n", algo);
+	}
+}
+
+static void tegra_se_remove_engine(struct tegra_se_dev *se_dev)
+{
+	unsigned int algo, i, n;
+
+	for (algo = 0; algo < NUM_SE_ALGO; algo++) {
+		n = se_num_engines[algo];
+		for (i = 0; i < n; i++) {
+			if (se_engines[algo][i] != se_dev)
+				continue;
+			se_engines[algo][i] = se_engines[algo][n - 1];
+			se_engines[algo][n - 1] = NULL;
+			WRITE_ONCE(se_num_engines[algo], n - 1);
+			break;
+		}
+
+		if (se_devices[algo] == se_dev)
+			se_devices[algo] = se_num_engines[algo] ?
+					   se_engines[algo][0] : NULL;
+	}
+}
+
+/*
+ * The AES algorithms stay registered as long as at least one AES engine
+ * is present, whichever engine registered them.
+ */
+static int tegra_se_aes_register_algs(struct tegra_se_dev *se_dev, bool xts)
+{
+	int i, err;
+
+	lockdep_assert_held(&se_engines_lock);
+
+	if (se_aes_algs_registered)
+		return 0;
+
+	if (xts) {
+		INIT_LIST_HEAD(&aes_algs[0].base.cra_list);
+		err = crypto_register_skcipher(&aes_algs[0]);
+		if (err) {
+			dev_err(se_dev->dev,
+				"crypto_register_alg xts failed\n");
+			return err;
+		}
+	}
+
+	for (i = 1; i < ARRAY_SIZE(aes_algs); i++) {
+		INIT_LIST_HEAD(&aes_algs[i].base.cra_list);
+		err = crypto_register_skcipher(&aes_algs[i]);
+		if (err) {
+			dev_err(se_dev->dev,
+				"crypto_register_alg %s failed\n",
+				aes_algs[i].base.cra_name);
+			goto unregister;
+		}
+	}
+
+	se_aes_xts_registered = xts;
+	se_aes_algs_registered = true;
+
+	return 0;
+
+unregister:
+	while (--i > 0)
+		crypto_unregister_skcipher(&aes_algs[i]);
+	if (xts)
+		crypto_unregister_skcipher(&aes_algs[0]);
+
+	return err;
+}
+
+static void tegra_se_aes_unregister_algs(void)
+{
+	int i;
+
+	lockdep_assert_held(&se_engines_lock);
+
+	if (!se_aes_algs_registered)
+		return;
+
+	for (i = 1; i < ARRAY_SIZE(aes_algs); i++)
+		crypto_unregister_skcipher(&aes_algs[i]);
+	if (se_aes_xts_registered)
+		crypto_unregister_skcipher(&aes_algs[0]);
+
+	se_aes_xts_registered = false;
+	se_aes_algs_registered = false;
+}
+
+/*
+ * Move the tfms bound to an engine that is going away to the remaining
+ * ones, reloading keys held in their own slots on the new engine. Without
+ * any engine left they are unbound and their requests fail with -ENODEV.
+ */
+static void tegra_se_aes_migrate_tfms(struct tegra_se_dev *se_dev)
+{
+	struct tegra_se_aes_context *ctx, *tmp;
+	bool own;
+	int err;
+
+	lockdep_assert_held(&se_engines_lock);
+
+	list_for_each_entry_safe(ctx, tmp, &se_dev->aes_ctxs, node) {
+		own = tegra_se_aes_own_slot(ctx);
+		tegra_se_aes_bind_engine(ctx, own || !ctx->slot ?
+					 tegra_se_aes_pick_engine() :
+					 se_devices[SE_AES]);
+		if (!own || !ctx->se_dev)
+			continue;
+
+		err = __tegra_se_aes_setkey(ctx->tfm, ctx->key, ctx->keylen);
+		if (err)
+			dev_err(se_dev->dev,
+				"failed to reload key of migrated tfm: %d\n",
+				err);
+	}
+}
+
+/*
+ * Several instances may advertise the same algorithm; requests are then
+ * spread over them, while the crypto algorithms are registered once for
+ * the whole set. AES engines join the set at the end of probe, once they
+ * can take tfms.
+ */
 static void tegra_se_fill_se_dev_info(struct tegra_se_dev *se_dev)
 {
 	struct device_node *node = of_node_get(se_dev->dev->of_node);
 
-	if (is_algo_supported(node, "aes"))
-		se_devices[SE_AES] = se_dev;
 	if (is_algo_supported(node, "drbg"))
-		se_devices[SE_DRBG] = se_dev;
+		tegra_se_add_engine(se_dev, SE_DRBG);
 	if (is_algo_supported(node, "sha"))
-		se_devices[SE_SHA] = se_dev;
+		tegra_se_add_engine(se_dev, SE_SHA);
 	if (is_algo_supported(node, "rsa"))
-		se_devices[SE_RSA] = se_dev;
+		tegra_se_add_engine(se_dev, SE_RSA);
 	if (is_algo_supported(node, "cmac"))
-		se_devices[SE_CMAC] = se_dev;
+		tegra_se_add_engine(se_dev, SE_CMAC);
 	if (is_algo_supported(node, "aead"))
-		se_devices[SE_AEAD] = se_dev;
+		tegra_se_add_engine(se_dev, SE_AEAD);
+}
+
+static void tegra_se_aes_stats_line(struct seq_file *s, const char *name,
+				    atomic64_t *reqs, atomic64_t *bytes,
+				    atomic64_t *ns)
+{
+	u64 nr_bytes = atomic64_read(bytes);
+	u64 nr_ns = atomic64_read(ns);
+
+	/* bytes per ns * 1000 == MB/s */
+	seq_printf(s, "%-10s %12lld %16llu %16llu %10llu\n", name,
+		   (long long)atomic64_read(reqs), nr_bytes, nr_ns,
+		   nr_ns ? div64_u64(nr_bytes * 1000, nr_ns) : 0);
+}
+
+static int tegra_se_aes_stats_show(struct seq_file *s, void *data)
+{
+	struct tegra_se_dev *se_dev = s->private;
+	struct tegra_se_aes_dma_stats *stats = &se_dev->aes_stats;
+
+	seq_printf(s, "zero-copy: %s\n",
+		   READ_ONCE(se_dev->aes_zc_enable) ? "enabled" : "disabled");
+	seq_printf(s, "%-10s %12s %16s %16s %10s\n", "path", "requests",
+		   "bytes", "latency_ns", "MB/s");
+	tegra_se_aes_stats_line(s, "zero-copy", &stats->zc_reqs,
+				&stats->zc_bytes, &stats->zc_ns);
+	tegra_se_aes_stats_line(s, "bounce", &stats->bounce_reqs,
+				&stats->bounce_bytes, &stats->bounce_ns);
+	seq_printf(s, "bounce copy_ns: %lld\n",
+		   (long long)atomic64_read(&stats->copy_ns));
+	seq_printf(s, "fallback: unaligned %lld nents %lld map %lld\n",
+		   (long long)atomic64_read(&stats->fallback_unaligned),
+		   (long long)atomic64_read(&stats->fallback_nents),
+		   (long long)atomic64_read(&stats->fallback_map));
+
+	return 0;
+}
+
+static int tegra_se_aes_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_aes_stats_show, inode->i_private);
+}
+
+static const struct file_operations tegra_se_aes_stats_fops = {
+	.open		= tegra_se_aes_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int tegra_se_engine_stats_show(struct seq_file *s, void *data)
+{
+	static const char * const algo_names[] = {
+		[SE_DRBG] = "drbg", [SE_AES] = "aes", [SE_CMAC] = "cmac",
+		[SE_RSA] = "rsa", [SE_SHA] = "sha", [SE_AEAD] = "aead",
+	};
+	struct tegra_se_dev *se_dev = s->private;
+	unsigned long flags;
+	unsigned int algo, i;
+	u64 busy_ns, elapsed_ns;
+	ktime_t now;
+
+	seq_puts(s, "algos:");
+	for (algo = 0; algo < NUM_SE_ALGO; algo++)
+		for (i = 0; i < READ_ONCE(se_num_engines[algo]); i++)
+			if (se_engines[algo][i] == se_dev)
+				seq_printf(s, " %s%s", algo_names[algo],
+					   se_devices[algo] == se_dev ?
+					   "*" : "");
+	seq_puts(s, "\n");
+
+	spin_lock_irqsave(&se_dev->busy_lock, flags);
+	now = ktime_get();
+	busy_ns = se_dev->busy_ns;
+	if (se_dev->busy_jobs)
+		busy_ns += ktime_to_ns(ktime_sub(now, se_dev->busy_since));
+	spin_unlock_irqrestore(&se_dev->busy_lock, flags);
+	elapsed_ns = ktime_to_ns(ktime_sub(now, se_dev->stats_start));
+
+	seq_printf(s, "aes_tfms: %d\n", atomic_read(&se_dev->aes_tfms));
+	seq_printf(s, "aes_pending: %d\n", atomic_read(&se_dev->aes_pending));
+	seq_printf(s, "aes_dispatched: %lld\n",
+		   (long long)atomic64_read(&se_dev->aes_dispatched));
+	seq_printf(s, "aes_completed: %lld\n",
+		   (long long)atomic64_read(&se_dev->aes_completed));
+	seq_printf(s, "busy_ns: %llu\n", busy_ns);
+	seq_printf(s, "utilization: %llu.%llu%%\n",
+		   elapsed_ns ? div64_u64(busy_ns * 100, elapsed_ns) : 0,
+		   elapsed_ns ?
+		   div64_u64(busy_ns * 1000, elapsed_ns) % 10 : 0);
+
+	return 0;
+}
+
+static int tegra_se_engine_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_engine_stats_show, inode->i_private);
+}
+
+static const struct file_operations tegra_se_engine_stats_fops = {
+	.open		= tegra_se_engine_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_se_debugfs_init(struct tegra_se_dev *se_dev, bool aes)
+{
+	if (!tegra_se_debugfs_root)
+		tegra_se_debugfs_root = debugfs_create_dir("tegra_se_nvhost",
+							   NULL);
+
+	se_dev->debugfs_dir = debugfs_create_dir(dev_name(se_dev->dev),
+						 tegra_se_debugfs_root);
+	debugfs_create_file("engine_stats", 0444, se_dev->debugfs_dir, se_dev,
+			    &tegra_se_engine_stats_fops);
+	if (!aes)
+		return;
+
+	debugfs_create_bool("aes_zero_copy", 0644, se_dev->debugfs_dir,
+			    &se_dev->aes_zc_enable);
+	debugfs_create_file("aes_stats", 0444, se_dev->debugfs_dir, se_dev,
+			    &tegra_se_aes_stats_fops);
 }
 
 static int tegra_se_probe(struct platform_device *pdev)
@@ -7162,6 +7897,8 @@ static int tegra_se_probe(struct platform_device *pdev)
 
 	mutex_init(&se_dev->lock);
 	crypto_init_queue(&se_dev->queue, TEGRA_SE_CRYPTO_QUEUE_LENGTH);
+	spin_lock_init(&se_dev->busy_lock);
+	se_dev->stats_start = ktime_get();
 
 	se_dev->dev = &pdev->dev;
 	se_dev->pdev = pdev;
@@ -7222,13 +7959,16 @@ static int tegra_se_probe(struct platform_device *pdev)
 	if (!of_property_count_strings(node, "supported-algos"))
 		return -ENOTSUPP;
 
+	INIT_LIST_HEAD(&se_dev->aes_ctxs);
+	mutex_lock(&se_engines_lock);
 	tegra_se_fill_se_dev_info(se_dev);
+	mutex_unlock(&se_engines_lock);
 
 	if (is_algo_supported(node, "aes") || is_algo_supported(node, "drbg")) {
 		err = tegra_init_key_slot(se_dev);
 		if (err) {
 			dev_err(se_dev->dev, "init_key_slot failed\n");
-			return err;
+			goto ll_alloc_fail;
 		}
 	}
 
@@ -7236,7 +7976,7 @@ static int tegra_se_probe(struct platform_device *pdev)
 		err = tegra_init_rsa_key_slot(se_dev);
 		if (err) {
 			dev_err(se_dev->dev, "init_rsa_key_slot failed\n");
-			return err;
+			goto ll_alloc_fail;
 		}
 	}
 
@@ -7246,7 +7986,8 @@ static int tegra_se_probe(struct platform_device *pdev)
 					    WQ_HIGHPRI | WQ_UNBOUND, 1);
 	if (!se_dev->se_work_q) {
 		dev_err(se_dev->dev, "alloc_workqueue failed\n");
-		return -ENOMEM;
+		err = -ENOMEM;
+		goto ll_alloc_fail;
 	}
 
 	err = tegra_se_alloc_ll_buf(se_dev, SE_MAX_SRC_SG_COUNT,
@@ -7265,29 +8006,6 @@ static int tegra_se_probe(struct platform_device *pdev)
 		}
 	}
 
-	if (is_algo_supported(node, "xts")) {
-		INIT_LIST_HEAD(&aes_algs[0].base.cra_list);
-		err = crypto_register_skcipher(&aes_algs[0]);
-		if (err) {
-			dev_err(se_dev->dev,
-				"crypto_register_alg xts failed\n");
-			goto reg_fail;
-		}
-	}
-
-	if (is_algo_supported(node, "aes")) {
-		for (i = 1; i < ARRAY_SIZE(aes_algs); i++) {
-			INIT_LIST_HEAD(&aes_algs[i].base.cra_list);
-			err = crypto_register_skcipher(&aes_algs[i]);
-			if (err) {
-				dev_err(se_dev->dev,
-					"crypto_register_alg %s failed\n",
-					aes_algs[i].base.cra_name);
-				goto reg_fail;
-			}
-		}
-	}
-
 	if (is_algo_supported(node, "cmac")) {
 		err = crypto_register_ahash(&hash_algs[0]);
 		if (err) {
@@ -7408,10 +8126,18 @@ static int tegra_se_probe(struct platform_device *pdev)
 				      GFP_KERNEL);
 	se_dev->aes_dst_ll = devm_kzalloc(&pdev->dev, sizeof(struct tegra_se_ll),
 				      GFP_KERNEL);
-	if (!se_dev->aes_src_ll || !se_dev->aes_dst_ll) {
+	se_dev->aes_zc_src_ll = devm_kcalloc(&pdev->dev, SE_AES_ZC_MAX_LL,
+					     sizeof(struct tegra_se_ll),
+					     GFP_KERNEL);
+	se_dev->aes_zc_dst_ll = devm_kcalloc(&pdev->dev, SE_AES_ZC_MAX_LL,
+					     sizeof(struct tegra_se_ll),
+					     GFP_KERNEL);
+	if (!se_dev->aes_src_ll || !se_dev->aes_dst_ll ||
+	    !se_dev->aes_zc_src_ll || !se_dev->aes_zc_dst_ll) {
 		dev_err(se_dev->dev, "Linked list memory allocation failed\n");
 		goto aes_buf_alloc_fail;
 	}
+	se_dev->aes_zc_enable = true;
 
 	if (se_dev->ioc)
 		se_dev->total_aes_buf = dma_alloc_coherent(
@@ -7444,8 +8170,20 @@ static int tegra_se_probe(struct platform_device *pdev)
 		}
 	}
 
+	if (is_algo_supported(node, "aes")) {
+		mutex_lock(&se_engines_lock);
+		tegra_se_add_engine(se_dev, SE_AES);
+		err = tegra_se_aes_register_algs(se_dev,
+					is_algo_supported(node, "xts"));
+		mutex_unlock(&se_engines_lock);
+		if (err)
+			goto dma_free;
+	}
+
 	tegra_se_boost_cpu_init(se_dev);
 
+	tegra_se_debugfs_init(se_dev, is_algo_supported(node, "aes"));
+
 	dev_info(se_dev->dev, "%s: complete", __func__);
 
 	return 0;
@@ -7462,6 +8200,9 @@ reg_fail:
 ll_alloc_fail:
 	if (se_dev->se_work_q)
 		destroy_workqueue(se_dev->se_work_q);
+	mutex_lock(&se_engines_lock);
+	tegra_se_remove_engine(se_dev);
+	mutex_unlock(&se_engines_lock);
 
 	return err;
 }
@@ -7479,6 +8220,20 @@ static int tegra_se_remove(struct platform_device *pdev)
 	}
 
 	tegra_se_boost_cpu_deinit(se_dev);
+	debugfs_remove_recursive(se_dev->debugfs_dir);
+
+	/*
+	 * Leave the engine set first: its tfms move to the remaining engines
+	 * and the last AES engine takes the algorithms with it. Requests
+	 * already queued here still run before the command buffers go away.
+	 */
+	mutex_lock(&se_engines_lock);
+	tegra_se_remove_engine(se_dev);
+	tegra_se_aes_migrate_tfms(se_dev);
+	if (!se_num_engines[SE_AES])
+		tegra_se_aes_unregister_algs();
+	mutex_unlock(&se_engines_lock);
+	flush_work(&se_dev->se_work);
 
 	if (se_dev->aes_cmdbuf_cpuvaddr)
 		dma_free_attrs(
@@ -7490,15 +8245,6 @@ static int tegra_se_remove(struct platform_device *pdev)
 	if (is_algo_supported(node, "drbg"))
 		crypto_unregister_rng(&rng_algs[0]);
 
-	if (is_algo_supported(node, "xts"))
-		crypto_unregister_skcipher(&aes_algs[0]);
-
-	if (is_algo_supported(node, "aes")) {
-		crypto_unregister_skcipher(&aes_algs[1]);
-		for (i = 2; i < ARRAY_SIZE(aes_algs); i++)
-			crypto_unregister_skcipher(&aes_algs[i]);
-	}
-
 	if (is_algo_supported(node, "cmac"))
 		crypto_unregister_ahash(&hash_algs[0]);
 
@@ -7551,6 +8297,7 @@ static int __init tegra_se_module_init(void)
 static void __exit tegra_se_module_exit(void)
 {
 	platform_driver_unregister(&tegra_se_driver);
+	debugfs_remove_recursive(tegra_se_debugfs_root);
 }
 
 late_initcall(tegra_se_module_init);
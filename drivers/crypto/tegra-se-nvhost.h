@@ -241,6 +241,7 @@
 #define SE_BUFF_SIZE_MASK	0xFF000000
 
 #define SE_MAX_TASKS_PER_SUBMIT		64
+#define SE_MAX_ENGINES			4
 #define SE_MAX_SUBMIT_CHAIN_SZ		10
 #define SE_WORD_SIZE_BYTES		4
 
@@ -249,6 +250,10 @@
 #define SE_MAX_AESBUF_ALLOC	(SE_MAX_MEM_ALLOC / SE_MAX_GATHER_BUF_SZ)
 #define SE_MAX_AESBUF_TIMEOUT		(20 * SE_MAX_AESBUF_ALLOC)
 
+/* Zero-copy AES: LL entries per submit and max length of one entry */
+#define SE_AES_ZC_MAX_LL		(2 * SE_MAX_TASKS_PER_SUBMIT)
+#define SE_AES_ZC_MAX_LL_LEN		(~SE_BUFF_SIZE_MASK)
+
 /* FIXME: The below 2 macros should fine tuned
  * based on discussions with CPU team
  */
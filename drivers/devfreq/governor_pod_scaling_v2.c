@@ -32,6 +32,7 @@
 #include <linux/slab.h>
 #include <linux/clk/tegra.h>
 #include <linux/module.h>
+#include <linux/math64.h>
 #include <linux/version.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/nvhost_podgov.h>
@@ -101,6 +102,18 @@ struct podgov_info_rec {
 
 	int			freq_avg;
 
+	/* predictive mode: burst arrival tracking */
+	unsigned int		p_predict;
+	unsigned int		p_predict_idle;
+	ktime_t			last_sample;
+	s64			sample_us_avg;
+	bool			in_burst;
+	ktime_t			burst_start;
+	s64			period_us_avg;
+	s64			period_us_dev;
+	u64			burst_work;
+	u64			burst_work_avg;
+
 	struct kobj_attribute	enable_3d_scaling_attr;
 	struct kobj_attribute	user_attr;
 	struct kobj_attribute	freq_request_attr;
@@ -415,6 +428,125 @@ static unsigned long scaling_state_check(struct devfreq *df, ktime_t time)
 	return res;
 }
 
+/*******************************************************************************
+ * podgov_predict_reset(pg)
+ *
+ * Forget burst history used by the predictive mode
+ ******************************************************************************/
+
+static void podgov_predict_reset(struct podgov_info_rec *pg)
+{
+	pg->last_sample = 0;
+	pg->sample_us_avg = 0;
+	pg->in_burst = false;
+	pg->burst_start = 0;
+	pg->period_us_avg = 0;
+	pg->period_us_dev = 0;
+	pg->burst_work = 0;
+	pg->burst_work_avg = 0;
+}
+
+/*******************************************************************************
+ * freq = podgov_predict_freq(df, time, norm_load)
+ *
+ * Predictive mode. Work is seen as bursts separated by idle gaps (i.e. one
+ * burst per frame). Burst period and its mean deviation are tracked with
+ * EWMAs like a TCP RTT estimator, and so is the work done per burst. The
+ * frequency that finishes a typical burst within its period at
+ * p_load_target is used as soon as a burst starts and, if bursts are
+ * periodic, one sample ahead of the expected arrival. While idle, the
+ * device is dropped straight to the frequency the idle load needs. Returns
+ * 0 to let the reactive path decide.
+ ******************************************************************************/
+
+static unsigned long podgov_predict_freq(struct devfreq *df, ktime_t time,
+					 unsigned long norm_load)
+{
+	struct podgov_info_rec *pg = df->data;
+	bool busy = pg->rt_load > pg->p_predict_idle;
+	s64 sample_us = 0, period_us, err, since_us, until_us;
+	unsigned long res, burst_freq = 0;
+
+	if (pg->last_sample) {
+		sample_us = ktime_us_delta(time, pg->last_sample);
+		if (pg->sample_us_avg)
+			pg->sample_us_avg += (sample_us - pg->sample_us_avg) / 8;
+		else
+			pg->sample_us_avg = sample_us;
+	}
+	pg->last_sample = time;
+
+	/* frequency that finishes a typical burst within its period */
+	if (pg->period_us_avg > 0 && pg->burst_work_avg)
+		burst_freq = div64_u64(pg->burst_work_avg, pg->period_us_avg) *
+			     1000 / pg->p_load_target;
+
+	if (busy && !pg->in_burst) {
+		/* new burst: update period estimate */
+		if (pg->burst_start) {
+			period_us = ktime_us_delta(time, pg->burst_start);
+			if (!pg->period_us_avg) {
+				pg->period_us_avg = period_us;
+				pg->period_us_dev = period_us / 2;
+			} else {
+				err = period_us - pg->period_us_avg;
+				pg->period_us_avg += err / 8;
+				pg->period_us_dev +=
+					(abs(err) - pg->period_us_dev) / 4;
+			}
+		}
+		pg->burst_start = time;
+		pg->burst_work = 0;
+		pg->in_burst = true;
+	}
+
+	if (busy) {
+		pg->burst_work += (u64)norm_load * sample_us;
+		/* burst came early or was not expected, catch up at once */
+		if (burst_freq > df->last_status.current_frequency) {
+			res = burst_freq;
+			goto out;
+		}
+		return 0;
+	}
+
+	if (pg->in_burst) {
+		/* burst ended: update typical work per burst */
+		pg->in_burst = false;
+		if (pg->burst_work_avg)
+			pg->burst_work_avg = pg->burst_work_avg -
+				pg->burst_work_avg / 4 + pg->burst_work / 4;
+		else
+			pg->burst_work_avg = pg->burst_work;
+	}
+
+	/* periodic if deviation is within a quarter of the period */
+	if (burst_freq && pg->sample_us_avg > 0 &&
+	    pg->period_us_dev * 4 < pg->period_us_avg) {
+		since_us = ktime_us_delta(time, pg->burst_start);
+		/* stream stopped, do not boost for missed bursts forever */
+		if (since_us < 4 * pg->period_us_avg) {
+			until_us = since_us -
+				   div64_s64(since_us, pg->period_us_avg) *
+				   pg->period_us_avg;
+			until_us = pg->period_us_avg - until_us;
+			if (until_us <= pg->sample_us_avg) {
+				res = burst_freq;
+				goto out;
+			}
+		}
+	}
+
+	/* idle gap: drop without smoothing */
+	res = div_u64((u64)norm_load * 1000, pg->p_load_target);
+
+out:
+	scaling_limit(df, &res);
+	pg->freq_avg = res / 1000000;
+
+	return res ? res : 1;
+}
+
 /*******************************************************************************
  * freqlist_up(podgov, target, steps)
  *
@@ -470,6 +602,8 @@ static void nvhost_scale_emc_debug_init(struct devfreq *df)
 	CREATE_PODGOV_FILE(bias);
 	CREATE_PODGOV_FILE(damp);
 	CREATE_PODGOV_FILE(smooth);
+	CREATE_PODGOV_FILE(predict);
+	CREATE_PODGOV_FILE(predict_idle);
 #undef CREATE_PODGOV_FILE
 }
 
@@ -617,6 +751,7 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 	unsigned long *cycles_buffer = pg->cycles_history_buf;
 	ktime_t now;
 	unsigned long long norm_load;
+	bool predicted = false;
 
 	/* If the device is suspended, clear the history and set frequency to
 	 * min freq.
@@ -631,6 +766,7 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 		pg->history_next = 0;
 		pg->recent_high = 0;
 		pg->freq_avg = 0;
+		podgov_predict_reset(pg);
 		return 0;
 	}
 
@@ -704,17 +840,25 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 			pg->recent_high = norm_load;
 	}
 
-	*freq = scaling_state_check(df, now);
-
-	if (!(*freq)) {
-		*freq = ds->current_frequency;
-		return 0;
+	*freq = 0;
+	if (pg->p_predict)
+		*freq = podgov_predict_freq(df, now, norm_load);
+	if (*freq) {
+		predicted = true;
+	} else {
+		*freq = scaling_state_check(df, now);
+		if (!(*freq)) {
+			*freq = ds->current_frequency;
+			return 0;
+		}
 	}
 
 	if ((*freq = freqlist_up(pg, *freq, 0)) == ds->current_frequency)
 		return 0;
 
-	pg->last_scale = now;
+	/* predicted changes must not hold off the reactive path */
+	if (!predicted)
+		pg->last_scale = now;
 
 	trace_podgov_estimate_freq(df->dev.parent, df->previous_freq, *freq);
 
@@ -764,6 +908,9 @@ static int nvhost_pod_init(struct devfreq *df)
 	podgov->p_smooth = 10;
 	podgov->p_damp = 7;
 	podgov->p_block_window = 50000;
+	podgov->p_predict = 0;
+	podgov->p_predict_idle = 100;
+	podgov_predict_reset(podgov);
 
 	podgov->adjustment_type = ADJUSTMENT_DEVICE_REQ;
 	podgov->p_user = 0;
@@ -22,6 +22,7 @@
 #include <linux/notifier.h>
 #include <linux/platform_device.h>
 #include <linux/module.h>
+#include <linux/math64.h>
 
 #include "governor.h"
 
@@ -34,6 +35,8 @@ struct wmark_gov_param {
 	unsigned int		load_max;
 	unsigned int		smooth;
 	bool			freq_boost_en;
+	unsigned int		hyst_max;
+	unsigned int		osc_window;
 };
 
 struct wmark_gov_info {
@@ -49,9 +52,22 @@ struct wmark_gov_info {
 	struct kobj_attribute	load_max_attr;
 	struct kobj_attribute	smooth_attr;
 	struct kobj_attribute	freq_boost_en_attr;
+	struct kobj_attribute	hyst_max_attr;
+	struct kobj_attribute	osc_window_attr;
+	struct kobj_attribute	trans_hist_attr;
 
 	spinlock_t		param_lock;
 
+	/* transition statistics and learned hysteresis */
+	spinlock_t		stats_lock;
+	u64			*time_in_state;
+	unsigned int		*trans_count;
+	unsigned int		osc_count;
+	unsigned int		hyst;
+	int			last_idx;
+	int			prev_idx;
+	ktime_t			last_change;
+
 	/* common data */
 	struct devfreq		*df;
 	struct platform_device	*pdev;
@@ -107,6 +123,91 @@ static unsigned long freqlist_round(struct wmark_gov_info *wmarkinfo,
 	return wmarkinfo->freqlist[pos];
 }
 
+static int freqlist_index(struct wmark_gov_info *wmarkinfo,
+			  unsigned long freq)
+{
+	int i;
+
+	for (i = 0; i < wmarkinfo->freq_count - 1; i++)
+		if (wmarkinfo->freqlist[i] >= freq)
+			break;
+
+	return i;
+}
+
+static unsigned int wmark_get_hyst(struct wmark_gov_info *wmarkinfo)
+{
+	unsigned int hyst;
+	unsigned long flags;
+
+	spin_lock_irqsave(&wmarkinfo->stats_lock, flags);
+	hyst = wmarkinfo->hyst;
+	spin_unlock_irqrestore(&wmarkinfo->stats_lock, flags);
+
+	return hyst;
+}
+
+static void wmark_stats_reset(struct wmark_gov_info *wmarkinfo,
+			      unsigned long freq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&wmarkinfo->stats_lock, flags);
+	wmarkinfo->hyst = 0;
+	wmarkinfo->last_idx = freqlist_index(wmarkinfo, freq);
+	wmarkinfo->prev_idx = -1;
+	wmarkinfo->last_change = ktime_get();
+	spin_unlock_irqrestore(&wmarkinfo->stats_lock, flags);
+}
+
+ /*
+  * wmark_account_transition - Record a frequency change
+  *     @wmarkinfo: governor data
+  *     @freq: new frequency of the device
+  *
+  * Updates the time-in-state and transition histograms. Returning to the
+  * previous OPP within osc_window is taken as ping-pong and widens the
+  * hysteresis by a quarter of hyst_max; any other transition halves it.
+  */
+
+static void wmark_account_transition(struct wmark_gov_info *wmarkinfo,
+				     unsigned long freq)
+{
+	ktime_t now = ktime_get();
+	int idx = freqlist_index(wmarkinfo, freq);
+	unsigned int hyst_max, osc_window;
+	unsigned long flags;
+	s64 dt;
+
+	spin_lock_irqsave(&wmarkinfo->param_lock, flags);
+	hyst_max = wmarkinfo->param.hyst_max;
+	osc_window = wmarkinfo->param.osc_window;
+	spin_unlock_irqrestore(&wmarkinfo->param_lock, flags);
+
+	spin_lock_irqsave(&wmarkinfo->stats_lock, flags);
+
+	if (idx == wmarkinfo->last_idx)
+		goto out;
+
+	dt = ktime_us_delta(now, wmarkinfo->last_change);
+	wmarkinfo->time_in_state[wmarkinfo->last_idx] += dt;
+	wmarkinfo->trans_count[idx]++;
+
+	if (idx == wmarkinfo->prev_idx && dt < osc_window) {
+		wmarkinfo->osc_count++;
+		wmarkinfo->hyst = min(wmarkinfo->hyst + max(hyst_max / 4, 1U),
+				      hyst_max);
+	} else {
+		wmarkinfo->hyst /= 2;
+	}
+
+	wmarkinfo->prev_idx = wmarkinfo->last_idx;
+	wmarkinfo->last_idx = idx;
+	wmarkinfo->last_change = now;
+
+out:
+	spin_unlock_irqrestore(&wmarkinfo->stats_lock, flags);
+}
 
  /*
   * update_watermarks - Re-estimate low and high watermarks
@@ -117,6 +218,7 @@ static unsigned long freqlist_round(struct wmark_gov_info *wmarkinfo,
   * This function updates the devfreq high and low watermarks. Target is
   * to ensure that the interrupts are triggered whenever the load changes
   * enough to make a change to the ideal frequency (given the DVFS table).
+  * The learned hysteresis moves both watermarks away from the load target.
   */
 
 static void update_watermarks(struct devfreq *df,
@@ -128,6 +230,7 @@ static void update_watermarks(struct devfreq *df,
 	unsigned long long current_frequency_khz = current_frequency / 1000;
 	unsigned long flags;
 	struct wmark_gov_param param;
+	unsigned int hyst = wmark_get_hyst(wmarkinfo);
 
 	/* get governor parameters */
 	spin_lock_irqsave(&wmarkinfo->param_lock, flags);
@@ -145,7 +248,8 @@ static void update_watermarks(struct devfreq *df,
 		 * that we are running at the new frequency? */
 		next_freq = freqlist_down(wmarkinfo, ideal_frequency);
 		relation = ((next_freq / current_frequency_khz) *
-			param.load_target) / 1000;
+			(param.load_target - min(hyst, param.load_target))) /
+			1000;
 		df->profile->set_low_wmark(df->dev.parent, relation);
 	}
 
@@ -159,7 +263,7 @@ static void update_watermarks(struct devfreq *df,
 		 * that we are running at the new frequency? */
 		next_freq = freqlist_up(wmarkinfo, ideal_frequency);
 		relation = ((next_freq / current_frequency_khz) *
-			param.load_target) / 1000;
+			(param.load_target + hyst)) / 1000;
 		relation = min_t(unsigned long long, param.load_max,
 			       relation);
 		df->profile->set_high_wmark(df->dev.parent, relation);
@@ -177,6 +281,7 @@ static int devfreq_watermark_target_freq(struct devfreq *df,
 	s64 dt = ktime_us_delta(current_time, wmarkinfo->last_frequency_update);
 	int err;
 	unsigned long flags;
+	unsigned int hyst;
 
 	struct wmark_gov_param param;
 
@@ -211,10 +316,23 @@ static int devfreq_watermark_target_freq(struct devfreq *df,
 	} else {
 		/* otherwise, based on relation between current load and
 		 * load target we calculate the "ideal" frequency
-		 * where we would be just at the target */
-		relation = (load * 1000) / param.load_target;
+		 * where we would be just at the target. the learned
+		 * hysteresis raises the target for going up and lowers
+		 * it for going down */
+		hyst = wmark_get_hyst(wmarkinfo);
+		relation = (load * 1000) / (param.load_target + hyst);
 		ideal_freq = relation * (dev_stat.current_frequency / 1000);
 
+		if (ideal_freq <= dev_stat.current_frequency) {
+			relation = (load * 1000) /
+				max(param.load_target - min(hyst,
+					param.load_target), 1U);
+			ideal_freq = relation *
+				(dev_stat.current_frequency / 1000);
+			ideal_freq = min_t(unsigned long long, ideal_freq,
+					   dev_stat.current_frequency);
+		}
+
 		/* round this frequency */
 		ideal_freq = freqlist_round(wmarkinfo, ideal_freq);
 	}
@@ -462,6 +580,151 @@ static ssize_t freq_boost_en_store(struct kobject *kobj,
 	return count;
 }
 
+static ssize_t hyst_max_show(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					char *buf)
+{
+	struct wmark_gov_info *wmarkinfo = NULL;
+	ssize_t res;
+	unsigned int val;
+	unsigned long flags;
+
+	wmarkinfo = container_of(attr,
+			struct wmark_gov_info,
+			hyst_max_attr);
+
+	spin_lock_irqsave(&wmarkinfo->param_lock, flags);
+	val = wmarkinfo->param.hyst_max;
+	spin_unlock_irqrestore(&wmarkinfo->param_lock, flags);
+
+	res = snprintf(buf, PAGE_SIZE, "%u\n", val);
+
+	return res;
+}
+
+static ssize_t hyst_max_store(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct wmark_gov_info *wmarkinfo = NULL;
+	unsigned long val = 0;
+	unsigned long flags;
+
+	wmarkinfo = container_of(attr,
+			struct wmark_gov_info,
+			hyst_max_attr);
+
+	if (kstrtoul(buf, 10, &val) < 0 || val > 1000)
+		return -EINVAL;
+
+	spin_lock_irqsave(&wmarkinfo->param_lock, flags);
+	wmarkinfo->param.hyst_max = val;
+	spin_unlock_irqrestore(&wmarkinfo->param_lock, flags);
+
+	spin_lock_irqsave(&wmarkinfo->stats_lock, flags);
+	wmarkinfo->hyst = min_t(unsigned int, wmarkinfo->hyst, val);
+	spin_unlock_irqrestore(&wmarkinfo->stats_lock, flags);
+
+	return count;
+}
+
+static ssize_t osc_window_show(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					char *buf)
+{
+	struct wmark_gov_info *wmarkinfo = NULL;
+	ssize_t res;
+	unsigned int val;
+	unsigned long flags;
+
+	wmarkinfo = container_of(attr,
+			struct wmark_gov_info,
+			osc_window_attr);
+
+	spin_lock_irqsave(&wmarkinfo->param_lock, flags);
+	val = wmarkinfo->param.osc_window;
+	spin_unlock_irqrestore(&wmarkinfo->param_lock, flags);
+
+	res = snprintf(buf, PAGE_SIZE, "%u\n", val);
+
+	return res;
+}
+
+static ssize_t osc_window_store(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct wmark_gov_info *wmarkinfo = NULL;
+	unsigned long val = 0;
+	unsigned long flags;
+
+	wmarkinfo = container_of(attr,
+			struct wmark_gov_info,
+			osc_window_attr);
+
+	if (kstrtoul(buf, 10, &val) < 0)
+		return -EINVAL;
+
+	spin_lock_irqsave(&wmarkinfo->param_lock, flags);
+	wmarkinfo->param.osc_window = val;
+	spin_unlock_irqrestore(&wmarkinfo->param_lock, flags);
+
+	return count;
+}
+
+static ssize_t trans_hist_show(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					char *buf)
+{
+	struct wmark_gov_info *wmarkinfo = NULL;
+	ktime_t now = ktime_get();
+	ssize_t len = 0;
+	unsigned long flags;
+	u64 time_us;
+	int i;
+
+	wmarkinfo = container_of(attr,
+			struct wmark_gov_info,
+			trans_hist_attr);
+
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "%12s %12s %12s\n", "freq", "transitions",
+			 "time(ms)");
+
+	spin_lock_irqsave(&wmarkinfo->stats_lock, flags);
+
+	for (i = 0; i < wmarkinfo->freq_count; i++) {
+		time_us = wmarkinfo->time_in_state[i];
+		if (i == wmarkinfo->last_idx)
+			time_us += ktime_us_delta(now,
+						  wmarkinfo->last_change);
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%c%11lu %12u %12llu\n",
+				 i == wmarkinfo->last_idx ? '*' : ' ',
+				 wmarkinfo->freqlist[i],
+				 wmarkinfo->trans_count[i],
+				 div_u64(time_us, 1000));
+	}
+
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "oscillations: %u\nhysteresis: %u\n",
+			 wmarkinfo->osc_count, wmarkinfo->hyst);
+
+	spin_unlock_irqrestore(&wmarkinfo->stats_lock, flags);
+
+	return len;
+}
+
+#define INIT_SYSFS_ATTR_RO(sysfs_name) \
+	do { \
+		attr->attr.name = #sysfs_name; \
+		attr->attr.mode = 0444; \
+		attr->show = sysfs_name##_show; \
+		attr->store = NULL; \
+		sysfs_attr_init(&attr->attr); \
+	} while (0)
+
 #define INIT_SYSFS_ATTR_RW(sysfs_name) \
 	do { \
 		attr->attr.name = #sysfs_name; \
@@ -480,6 +743,7 @@ static int devfreq_watermark_debug_start(struct devfreq *df)
 		return 0;
 
 	spin_lock_init(&wmarkinfo->param_lock);
+	spin_lock_init(&wmarkinfo->stats_lock);
 
 	attr = &wmarkinfo->block_window_attr;
 	INIT_SYSFS_ATTR_RW(block_window);
@@ -506,8 +770,32 @@ static int devfreq_watermark_debug_start(struct devfreq *df)
 	if (sysfs_create_file(&df->dev.parent->kobj, &attr->attr))
 		goto err_create_freq_boost_en_sysfs_entry;
 
+	attr = &wmarkinfo->hyst_max_attr;
+	INIT_SYSFS_ATTR_RW(hyst_max);
+	if (sysfs_create_file(&df->dev.parent->kobj, &attr->attr))
+		goto err_create_hyst_max_sysfs_entry;
+
+	attr = &wmarkinfo->osc_window_attr;
+	INIT_SYSFS_ATTR_RW(osc_window);
+	if (sysfs_create_file(&df->dev.parent->kobj, &attr->attr))
+		goto err_create_osc_window_sysfs_entry;
+
+	attr = &wmarkinfo->trans_hist_attr;
+	INIT_SYSFS_ATTR_RO(trans_hist);
+	if (sysfs_create_file(&df->dev.parent->kobj, &attr->attr))
+		goto err_create_trans_hist_sysfs_entry;
+
 	return 0;
 
+err_create_trans_hist_sysfs_entry:
+	sysfs_remove_file(&df->dev.parent->kobj,
+			&wmarkinfo->osc_window_attr.attr);
+err_create_osc_window_sysfs_entry:
+	sysfs_remove_file(&df->dev.parent->kobj,
+			&wmarkinfo->hyst_max_attr.attr);
+err_create_hyst_max_sysfs_entry:
+	sysfs_remove_file(&df->dev.parent->kobj,
+			&wmarkinfo->freq_boost_en_attr.attr);
 err_create_freq_boost_en_sysfs_entry:
 	sysfs_remove_file(&df->dev.parent->kobj,
 			&wmarkinfo->smooth_attr.attr);
@@ -529,6 +817,12 @@ static void devfreq_watermark_debug_stop(struct devfreq *df)
 {
 	struct wmark_gov_info *wmarkinfo = df->data;
 
+	sysfs_remove_file(&df->dev.parent->kobj,
+			&wmarkinfo->trans_hist_attr.attr);
+	sysfs_remove_file(&df->dev.parent->kobj,
+			&wmarkinfo->osc_window_attr.attr);
+	sysfs_remove_file(&df->dev.parent->kobj,
+			&wmarkinfo->hyst_max_attr.attr);
 	sysfs_remove_file(&df->dev.parent->kobj,
 			&wmarkinfo->freq_boost_en_attr.attr);
 	sysfs_remove_file(&df->dev.parent->kobj,
@@ -564,10 +858,33 @@ static int devfreq_watermark_start(struct devfreq *df)
 	wmarkinfo->param.smooth = 10;
 	wmarkinfo->param.block_window = 50000;
 	wmarkinfo->param.freq_boost_en = true;
+	wmarkinfo->param.hyst_max = 100;
+	wmarkinfo->param.osc_window = 4 * wmarkinfo->param.block_window;
 	wmarkinfo->df = df;
 	wmarkinfo->pdev = pdev;
 
+	wmarkinfo->time_in_state = kcalloc(wmarkinfo->freq_count,
+					   sizeof(*wmarkinfo->time_in_state),
+					   GFP_KERNEL);
+	wmarkinfo->trans_count = kcalloc(wmarkinfo->freq_count,
+					 sizeof(*wmarkinfo->trans_count),
+					 GFP_KERNEL);
+	if (!wmarkinfo->time_in_state || !wmarkinfo->trans_count) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
 	ret = devfreq_watermark_debug_start(df);
+	if (ret)
+		goto err_free;
+
+	return 0;
+
+err_free:
+	kfree(wmarkinfo->trans_count);
+	kfree(wmarkinfo->time_in_state);
+	kfree(wmarkinfo);
+	df->data = NULL;
 
 	return ret;
 }
@@ -588,8 +905,10 @@ static int devfreq_watermark_notifier_call(struct notifier_block *nb,
 		df->profile->get_cur_freq(df->dev.parent, &freq);
 
 		/* update watermarks by current device freq. */
-		if (freq)
+		if (freq) {
+			wmark_account_transition(data, freq);
 			update_watermarks(df, freq, freq);
+		}
 		break;
 	default:
 		break;
@@ -620,6 +939,7 @@ static int devfreq_watermark_event_handler(struct devfreq *df,
 		/* initialize average target freq */
 		wmarkinfo = df->data;
 		wmarkinfo->average_target_freq = dev_stat.current_frequency;
+		wmark_stats_reset(wmarkinfo, dev_stat.current_frequency);
 
 		update_watermarks(df, dev_stat.current_frequency,
 					dev_stat.current_frequency);
@@ -640,6 +960,8 @@ static int devfreq_watermark_event_handler(struct devfreq *df,
 
 		/* free wmark_gov_info struct */
 		if (df->data != NULL) {
+			kfree(wmarkinfo->trans_count);
+			kfree(wmarkinfo->time_in_state);
 			kfree(df->data);
 			df->data = NULL;
 		}
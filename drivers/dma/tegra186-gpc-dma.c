@@ -167,6 +167,13 @@
 /* Channel base address offset from GPCDMA base address */
 #define TEGRA_GPCDMA_CHANNEL_BASE_ADD_OFFSET	0x10000
 
+/*
+ * Default per-channel pool of descriptors and sg requests, so prep_* calls
+ * recycle instead of allocating. DT can override both, zero disables.
+ */
+#define TEGRA_GPCDMA_DEF_PREALLOC_DESCS		4
+#define TEGRA_GPCDMA_DEF_PREALLOC_SG		16
+
 struct tegra_dma;
 
 /*
@@ -817,7 +824,9 @@ static irqreturn_t tegra_dma_isr(int irq, void *dev_id)
 				tdc->id, status);
 			tegra_dma_dump_chan_regs(tdc);
 		}
-		tasklet_schedule(&tdc->tasklet);
+		/* Only descriptor completions need the bottom half */
+		if (!list_empty(&tdc->cb_desc))
+			tasklet_schedule(&tdc->tasklet);
 		raw_spin_unlock_irqrestore(&tdc->lock, flags);
 		return IRQ_HANDLED;
 	}
@@ -1360,6 +1369,7 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
 	unsigned long csr, mc_seq, apb_ptr = 0, mmio_seq = 0;
 	struct list_head req_list;
 	struct tegra_dma_sg_req *sg_req = NULL;
+	dma_addr_t req_mem = 0;
 	u32 burst_size;
 	enum dma_slave_buswidth slave_bw = 0;
 	int ret;
@@ -1445,6 +1455,25 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
 			return NULL;
 		}
 
+		/*
+		 * Fold a segment that continues the previous one in memory
+		 * into the same request, saving an EOC interrupt and a
+		 * reprogram. The low pointer must not carry into the high
+		 * address bits.
+		 */
+		if (sg_req && mem == req_mem + sg_req->req_len &&
+		    sg_req->req_len + len <=
+				tdc->tdma->chip_data->max_dma_count &&
+		    upper_32_bits(mem + len - 1) == upper_32_bits(req_mem)) {
+			sg_req->req_len += len;
+			sg_req->ch_regs.wcount = ((sg_req->req_len - 4) >> 2);
+			mmio_seq |= get_burst_size(tdc, burst_size, slave_bw,
+						   sg_req->req_len);
+			sg_req->ch_regs.mmio_seq = mmio_seq;
+			dma_desc->bytes_requested += len;
+			continue;
+		}
+
 		sg_req = tegra_dma_sg_req_get(tdc);
 		if (!sg_req) {
 			dev_err(tdc2dev(tdc), "Dma sg-req not available\n");
@@ -1452,6 +1481,7 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
 			return NULL;
 		}
 
+		req_mem = mem;
 		mmio_seq |= get_burst_size(tdc, burst_size, slave_bw, len);
 		dma_desc->bytes_requested += len;
 
@@ -1689,21 +1719,23 @@ static int tegra_dma_alloc_chan_resources(struct dma_chan *dc)
 static void tegra_dma_free_chan_resources(struct dma_chan *dc)
 {
 	struct tegra_dma_channel *tdc = to_tegra_dma_chan(dc);
-	struct list_head dma_desc_list;
-	struct list_head sg_req_list;
+	struct tegra_dma_desc *dma_desc;
 	unsigned long flags;
 
-	INIT_LIST_HEAD(&dma_desc_list);
-	INIT_LIST_HEAD(&sg_req_list);
-
 	dev_dbg(tdc2dev(tdc), "Freeing channel %d\n", tdc->id);
 
 	if (tdc->busy)
 		tegra_dma_terminate_all(dc);
 	raw_spin_lock_irqsave(&tdc->lock, flags);
-	list_splice_init(&tdc->pending_sg_req, &sg_req_list);
-	list_splice_init(&tdc->free_sg_req, &sg_req_list);
-	list_splice_init(&tdc->free_dma_desc, &dma_desc_list);
+	/*
+	 * Keep descriptors and sg requests in the channel pool for the next
+	 * client, they are device managed and only freed on remove.
+	 */
+	list_splice_init(&tdc->pending_sg_req, &tdc->free_sg_req);
+	list_for_each_entry(dma_desc, &tdc->free_dma_desc, node) {
+		list_splice_init(&dma_desc->tx_list, &tdc->free_sg_req);
+		dma_desc->txd.flags = DMA_CTRL_ACK;
+	}
 	INIT_LIST_HEAD(&tdc->cb_desc);
 	tdc->config_init = false;
 	tdc->isr_handler = NULL;
@@ -1816,7 +1848,8 @@ static int tegra_dma_probe(struct platform_device *pdev)
 	struct tegra_dma_chip_data *chip_data = NULL;
 	int start_chan_idx = 0;
 	int nr_chans, stream_id;
-	int preallocated_desc = 0, preallocated_sg = 0;
+	int preallocated_desc = TEGRA_GPCDMA_DEF_PREALLOC_DESCS;
+	int preallocated_sg = TEGRA_GPCDMA_DEF_PREALLOC_SG;
 
 	if (pdev->dev.of_node) {
 		const struct of_device_id *match;
@@ -1857,8 +1890,8 @@ static int tegra_dma_probe(struct platform_device *pdev)
 			stream_id = TEGRA_SID_GPCDMA_0;
 
 		/*
-		 * if these properties are unreadable, leave them zeroes
-		 * zeroes imply:
+		 * if these properties are unreadable, keep the default pool
+		 * sizes; zeroes imply:
 		 * - NO preallocated sg requests
 		 * - NO preallocated descriptors
 		 */
@@ -909,6 +909,8 @@ static const struct drm_driver tegra_drm_driver = {
 int tegra_drm_register_client(struct tegra_drm *tegra,
 			      struct tegra_drm_client *client)
 {
+	int err;
+
 	/*
 	 * When MLOCKs are implemented, change to allocate a shared channel
 	 * only when MLOCKs are disabled.
@@ -917,6 +919,13 @@ int tegra_drm_register_client(struct tegra_drm *tegra,
 	if (!client->shared_channel)
 		return -EBUSY;
 
+	err = tegra_drm_fw_init(client);
+	if (err < 0) {
+		host1x_channel_put(client->shared_channel);
+		client->shared_channel = NULL;
+		return err;
+	}
+
 	mutex_lock(&tegra->clients_lock);
 	list_add_tail(&client->list, &tegra->clients);
 	client->drm = tegra;
@@ -936,6 +945,8 @@ int tegra_drm_unregister_client(struct tegra_drm *tegra,
 	if (client->shared_channel)
 		host1x_channel_put(client->shared_channel);
 
+	tegra_drm_fw_exit(client);
+
 	return 0;
 }
 
@@ -117,6 +117,10 @@ struct tegra_drm_client {
 	/* Set by driver */
 	unsigned int version;
 	const struct tegra_drm_client_ops *ops;
+
+	/* Address register maps compiled by the firewall at registration */
+	struct tegra_drm_fw_class *fw_classes;
+	unsigned int num_fw_classes;
 };
 
 static inline struct tegra_drm_client *
@@ -129,6 +133,8 @@ int tegra_drm_register_client(struct tegra_drm *tegra,
 			      struct tegra_drm_client *client);
 int tegra_drm_unregister_client(struct tegra_drm *tegra,
 				struct tegra_drm_client *client);
+int tegra_drm_fw_init(struct tegra_drm_client *client);
+void tegra_drm_fw_exit(struct tegra_drm_client *client);
 int host1x_client_iommu_attach(struct host1x_client *client);
 void host1x_client_iommu_detach(struct host1x_client *client);
 
@@ -1,19 +1,110 @@
 // SPDX-License-Identifier: GPL-2.0-only
 /* Copyright (c) 2010-2020 NVIDIA Corporation */
 
+#include <linux/bitmap.h>
+#include <linux/slab.h>
+
 #include "drm.h"
 #include "submit.h"
 #include "uapi.h"
 
+/*
+ * Register offsets encoded by the short opcodes are 12 bits wide. Address
+ * registers in that range are looked up from a per-class bitmap compiled
+ * when the client registers; wide opcodes addressing beyond it fall back
+ * to the client's is_addr_reg() callback.
+ */
+#define TEGRA_DRM_FW_NUM_REGS	0x1000
+#define TEGRA_DRM_FW_NUM_CLASSES	0x400
+
+struct tegra_drm_fw_class {
+	u32 class;
+	DECLARE_BITMAP(addr_regs, TEGRA_DRM_FW_NUM_REGS);
+};
+
 struct tegra_drm_firewall {
 	struct tegra_drm_submit_data *submit;
 	struct tegra_drm_client *client;
+	const struct tegra_drm_fw_class *map;
 	u32 *data;
 	u32 pos;
 	u32 end;
 	u32 class;
 };
 
+static bool fw_class_is_valid(struct tegra_drm_client *client, u32 class)
+{
+	if (!client->ops->is_valid_class)
+		return class == client->base.class;
+
+	return client->ops->is_valid_class(class);
+}
+
+int tegra_drm_fw_init(struct tegra_drm_client *client)
+{
+	struct tegra_drm_fw_class *maps;
+	unsigned int num = 0;
+	u32 class, offset;
+
+	client->fw_classes = NULL;
+	client->num_fw_classes = 0;
+
+	if (!client->ops || !client->ops->is_addr_reg)
+		return 0;
+
+	for (class = 0; class < TEGRA_DRM_FW_NUM_CLASSES; class++)
+		if (class == HOST1X_CLASS_HOST1X ||
+		    fw_class_is_valid(client, class))
+			num++;
+
+	maps = kcalloc(num, sizeof(*maps), GFP_KERNEL);
+	if (!maps)
+		return -ENOMEM;
+
+	num = 0;
+
+	for (class = 0; class < TEGRA_DRM_FW_NUM_CLASSES; class++) {
+		struct tegra_drm_fw_class *map = &maps[num];
+
+		if (class != HOST1X_CLASS_HOST1X &&
+		    !fw_class_is_valid(client, class))
+			continue;
+
+		map->class = class;
+
+		for (offset = 0; offset < TEGRA_DRM_FW_NUM_REGS; offset++)
+			if (client->ops->is_addr_reg(client->base.dev, class,
+						     offset))
+				__set_bit(offset, map->addr_regs);
+
+		num++;
+	}
+
+	client->fw_classes = maps;
+	client->num_fw_classes = num;
+
+	return 0;
+}
+
+void tegra_drm_fw_exit(struct tegra_drm_client *client)
+{
+	kfree(client->fw_classes);
+	client->fw_classes = NULL;
+	client->num_fw_classes = 0;
+}
+
+static const struct tegra_drm_fw_class *
+fw_find_class(struct tegra_drm_client *client, u32 class)
+{
+	unsigned int i;
+
+	for (i = 0; i < client->num_fw_classes; i++)
+		if (client->fw_classes[i].class == class)
+			return &client->fw_classes[i];
+
+	return NULL;
+}
+
 static int fw_next(struct tegra_drm_firewall *fw, u32 *word)
 {
 	if (fw->pos == fw->end)
@@ -24,6 +115,28 @@ static int fw_next(struct tegra_drm_firewall *fw, u32 *word)
 	return 0;
 }
 
+static int fw_skip(struct tegra_drm_firewall *fw, u32 count)
+{
+	if (count > fw->end - fw->pos)
+		return -EINVAL;
+
+	fw->pos += count;
+
+	return 0;
+}
+
+static bool fw_is_addr_reg(struct tegra_drm_firewall *fw, u32 offset)
+{
+	if (fw->map && offset < TEGRA_DRM_FW_NUM_REGS)
+		return test_bit(offset, fw->map->addr_regs);
+
+	if (!fw->client->ops->is_addr_reg)
+		return false;
+
+	return fw->client->ops->is_addr_reg(fw->client->base.dev, fw->class,
+					    offset);
+}
+
 static bool fw_check_addr_valid(struct tegra_drm_firewall *fw, u32 offset)
 {
 	u32 i;
@@ -40,7 +153,6 @@ static bool fw_check_addr_valid(struct tegra_drm_firewall *fw, u32 offset)
 
 static int fw_check_reg(struct tegra_drm_firewall *fw, u32 offset)
 {
-	bool is_addr;
 	u32 word;
 	int err;
 
@@ -48,13 +160,7 @@ static int fw_check_reg(struct tegra_drm_firewall *fw, u32 offset)
 	if (err)
 		return err;
 
-	if (!fw->client->ops->is_addr_reg)
-		return 0;
-
-	is_addr = fw->client->ops->is_addr_reg(fw->client->base.dev, fw->class,
-					       offset);
-
-	if (!is_addr)
+	if (!fw_is_addr_reg(fw, offset))
 		return 0;
 
 	if (!fw_check_addr_valid(fw, word))
@@ -66,14 +172,52 @@ static int fw_check_reg(struct tegra_drm_firewall *fw, u32 offset)
 static int fw_check_regs_seq(struct tegra_drm_firewall *fw, u32 offset,
 			     u32 count, bool incr)
 {
-	u32 i;
+	u32 end, next, i;
+
+	if (count > fw->end - fw->pos)
+		return -EINVAL;
+
+	if (!incr) {
+		if (!fw_is_addr_reg(fw, offset))
+			return fw_skip(fw, count);
+
+		for (i = 0; i < count; i++)
+			if (fw_check_reg(fw, offset))
+				return -EINVAL;
+
+		return 0;
+	}
+
+	/*
+	 * Scan the bitmap a word at a time and only look at the data words
+	 * that land on address registers; everything in between is skipped.
+	 */
+	if (fw->map && offset < TEGRA_DRM_FW_NUM_REGS &&
+	    count <= TEGRA_DRM_FW_NUM_REGS - offset) {
+		end = offset + count;
+
+		while (offset < end) {
+			next = find_next_bit(fw->map->addr_regs, end, offset);
+			if (fw_skip(fw, next - offset))
+				return -EINVAL;
+
+			if (next == end)
+				break;
+
+			if (fw_check_reg(fw, next))
+				return -EINVAL;
+
+			offset = next + 1;
+		}
+
+		return 0;
+	}
 
 	for (i = 0; i < count; i++) {
 		if (fw_check_reg(fw, offset))
 			return -EINVAL;
 
-		if (incr)
-			offset++;
+		offset++;
 	}
 
 	return 0;
@@ -95,11 +239,7 @@ static int fw_check_regs_mask(struct tegra_drm_firewall *fw, u32 offset,
 
 static int fw_check_regs_imm(struct tegra_drm_firewall *fw, u32 offset)
 {
-	bool is_addr;
-
-	is_addr = fw->client->ops->is_addr_reg(fw->client->base.dev, fw->class,
-					       offset);
-	if (is_addr)
+	if (fw_is_addr_reg(fw, offset))
 		return -EINVAL;
 
 	return 0;
@@ -107,14 +247,7 @@ static int fw_check_regs_imm(struct tegra_drm_firewall *fw, u32 offset)
 
 static int fw_check_class(struct tegra_drm_firewall *fw, u32 class)
 {
-	if (!fw->client->ops->is_valid_class) {
-		if (class == fw->client->base.class)
-			return 0;
-		else
-			return -EINVAL;
-	}
-
-	if (!fw->client->ops->is_valid_class(class))
+	if (!fw_class_is_valid(fw->client, class))
 		return -EINVAL;
 
 	return 0;
@@ -149,6 +282,7 @@ int tegra_drm_fw_validate(struct tegra_drm_client *client, u32 *data, u32 start,
 		.pos = start,
 		.end = start+words,
 		.class = *job_class,
+		.map = fw_find_class(client, *job_class),
 	};
 	bool payload_valid = false;
 	u32 payload;
@@ -170,6 +304,7 @@ int tegra_drm_fw_validate(struct tegra_drm_client *client, u32 *data, u32 start,
 			class = (word >> 6) & 0x3ff;
 			err = fw_check_class(&fw, class);
 			fw.class = class;
+			fw.map = fw_find_class(client, class);
 			*job_class = class;
 			if (!err)
 				err = fw_check_regs_mask(&fw, offset, mask);
@@ -289,7 +289,22 @@ static int tegra_bo_iommu_unmap(struct tegra_drm *tegra, struct tegra_bo *bo)
 	return 0;
 }
 
+static void tegra_bo_close_object(struct drm_gem_object *gem,
+				  struct drm_file *file)
+{
+	struct tegra_bo *bo = to_tegra_bo(gem);
+
+	/*
+	 * Once the last handle goes away, the job mapping caches must not keep
+	 * the buffer allocated and mapped. Their references would otherwise
+	 * only be dropped on eviction.
+	 */
+	if (gem->handle_count == 1)
+		host1x_bo_uncache(&bo->base);
+}
+
 static const struct drm_gem_object_funcs tegra_gem_object_funcs = {
+	.close = tegra_bo_close_object,
 	.free = tegra_bo_free_object,
 	.export = tegra_gem_prime_export,
 	.vm_ops = &tegra_bo_vm_ops,
@@ -15,6 +15,7 @@
  */
 
 #include <linux/dma-buf.h>
+#include <linux/hashtable.h>
 #include <linux/shmem_fs.h>
 #include <linux/version.h>
 #include <linux/extcon.h>
@@ -75,32 +76,71 @@ struct tegra_udrm_file {
 	struct eventfd_ctx *efd_ctx_drop_master;
 	struct eventfd_ctx *efd_ctx_set_master;
 
-	/* Holds list of dmabuf fd and corresponding unique id. Id is used
+	/* Holds list of dmabufs and corresponding unique id. Id is used
 	 * to return fake offset in dmabuf mmap ioctl. User space sends this
-	 * offset in mmap(), driver then uses it to find dambuf fd.
+	 * offset in mmap(), driver then uses it to find the dmabuf.
 	 */
 	struct idr idr;
+
+	/* Same entries as in idr, hashed by dmabuf so that repeated dmabuf
+	 * mmap ioctls for a buffer return the existing offset without
+	 * scanning or allocating.
+	 */
+	DECLARE_HASHTABLE(mmap_hash, 5);
+
+	/* Protects idr and mmap_hash. */
+	struct mutex mmap_lock;
 };
 
 struct tegra_udrm_mmap_entry {
+	/* fd the mapping was created with. */
 	int dmabuf_fd;
+	/* Reference held until the mapping is destroyed. */
+	struct dma_buf *dmabuf;
+	struct hlist_node node;
+	int id;
 };
 
+static struct tegra_udrm_mmap_entry *tegra_udrm_find_mmap_entry(
+	struct tegra_udrm_file *fpriv, struct dma_buf *dmabuf)
+{
+	struct tegra_udrm_mmap_entry *mmap_entry;
+
+	hash_for_each_possible(fpriv->mmap_hash, mmap_entry, node,
+			(unsigned long)dmabuf) {
+		if (mmap_entry->dmabuf == dmabuf)
+			return mmap_entry;
+	}
+
+	return NULL;
+}
+
+static void tegra_udrm_remove_mmap_entry(struct tegra_udrm_file *fpriv,
+	struct tegra_udrm_mmap_entry *mmap_entry)
+{
+	idr_remove(&fpriv->idr, mmap_entry->id);
+	hash_del(&mmap_entry->node);
+	dma_buf_put(mmap_entry->dmabuf);
+	kfree(mmap_entry);
+}
+
 static int tegra_udrm_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	struct drm_file *priv = file->private_data;
 	struct tegra_udrm_file *fpriv = priv->driver_priv;
-	struct dma_buf *dmabuf;
+	struct dma_buf *dmabuf = NULL;
 	struct tegra_udrm_mmap_entry *mmap_entry;
 	int ret;
 
+	mutex_lock(&fpriv->mmap_lock);
 	mmap_entry = idr_find(&fpriv->idr, vma->vm_pgoff);
+	if (mmap_entry) {
+		dmabuf = mmap_entry->dmabuf;
+		get_dma_buf(dmabuf);
+	}
+	mutex_unlock(&fpriv->mmap_lock);
 
-	if (!mmap_entry)
-		return -EINVAL;
-
-	dmabuf = dma_buf_get(mmap_entry->dmabuf_fd);
-	if (IS_ERR(dmabuf))
+	if (!dmabuf)
 		return -EINVAL;
 
 	/* set the vm_pgoff (used as a fake buffer offset by DRM) to 0
@@ -122,24 +162,40 @@ static int tegra_udrm_dmabuf_mmap_ioctl(struct drm_device *drm,
 	struct drm_tegra_udrm_dmabuf_mmap *args =
 		(struct drm_tegra_udrm_dmabuf_mmap *)data;
 	struct tegra_udrm_mmap_entry *mmap_entry;
+	struct dma_buf *dmabuf;
 	int id;
 
 	if (args->fd < 0)
 		return -EINVAL;
 
-	/* Check if set up for mmap for this dmabuf fd has already done. */
-	idr_for_each_entry(&fpriv->idr, mmap_entry, id) {
-		if (args->fd == mmap_entry->dmabuf_fd) {
-			args->offset = (unsigned long)(id) << PAGE_SHIFT;
-			return 0;
-		}
+	dmabuf = dma_buf_get(args->fd);
+	if (IS_ERR(dmabuf))
+		return -EINVAL;
+
+	mutex_lock(&fpriv->mmap_lock);
+
+	/* Check if set up for mmap for this dmabuf has already done. The
+	 * lookup is by dmabuf rather than fd, so remapping a buffer through
+	 * a different fd returns the same offset as well.
+	 */
+	mmap_entry = tegra_udrm_find_mmap_entry(fpriv, dmabuf);
+	if (mmap_entry) {
+		id = mmap_entry->id;
+		mutex_unlock(&fpriv->mmap_lock);
+		dma_buf_put(dmabuf);
+		args->offset = (unsigned long)(id) << PAGE_SHIFT;
+		return 0;
 	}
 
 	mmap_entry = kmalloc(sizeof(*mmap_entry), GFP_KERNEL);
-	if (!mmap_entry)
+	if (!mmap_entry) {
+		mutex_unlock(&fpriv->mmap_lock);
+		dma_buf_put(dmabuf);
 		return -ENOMEM;
+	}
 
 	mmap_entry->dmabuf_fd = args->fd;
+	mmap_entry->dmabuf = dmabuf;
 
 	/* mmap_entry will be freed when user space calls destroy mappings
 	 * ioctl. Driver's preclose function will free all unfreed mmap
@@ -148,10 +204,17 @@ static int tegra_udrm_dmabuf_mmap_ioctl(struct drm_device *drm,
 	id = idr_alloc(&fpriv->idr, mmap_entry, 0, 0 /* INT_MAX */,
 			GFP_KERNEL);
 	if (id < 0) {
+		mutex_unlock(&fpriv->mmap_lock);
+		dma_buf_put(dmabuf);
 		kfree(mmap_entry);
 		return -ENOMEM;
 	}
 
+	mmap_entry->id = id;
+	hash_add(fpriv->mmap_hash, &mmap_entry->node, (unsigned long)dmabuf);
+
+	mutex_unlock(&fpriv->mmap_lock);
+
 	/* We have to return fake offset to use for subsequent mmap by user
 	 * space. Return offset by doing id << PAGE_SHIFT as mmap() does
 	 * offset = offset >> PAGE_SHIFT before sending offset to driver.
@@ -171,18 +234,32 @@ static int tegra_udrm_dmabuf_destroy_mappings_ioctl(struct drm_device *drm,
 	struct tegra_udrm_file *fpriv = file->driver_priv;
 	struct drm_tegra_udrm_dmabuf_destroy_mappings *args =
 		(struct drm_tegra_udrm_dmabuf_destroy_mappings *)data;
-	struct tegra_udrm_mmap_entry *mmap_entry;
+	struct tegra_udrm_mmap_entry *mmap_entry = NULL;
+	struct dma_buf *dmabuf;
 	int id;
 
-	idr_for_each_entry(&fpriv->idr, mmap_entry, id) {
-		if (args->fd == mmap_entry->dmabuf_fd) {
-			idr_remove(&fpriv->idr, id);
-			kfree(mmap_entry);
-			return 0;
+	mutex_lock(&fpriv->mmap_lock);
+
+	dmabuf = dma_buf_get(args->fd);
+	if (!IS_ERR(dmabuf)) {
+		mmap_entry = tegra_udrm_find_mmap_entry(fpriv, dmabuf);
+		dma_buf_put(dmabuf);
+	} else {
+		/* fd may already be closed, fall back to the fd the mapping
+		 * was created with.
+		 */
+		idr_for_each_entry(&fpriv->idr, mmap_entry, id) {
+			if (args->fd == mmap_entry->dmabuf_fd)
+				break;
 		}
 	}
 
-	return -EINVAL;
+	if (mmap_entry)
+		tegra_udrm_remove_mmap_entry(fpriv, mmap_entry);
+
+	mutex_unlock(&fpriv->mmap_lock);
+
+	return mmap_entry ? 0 : -EINVAL;
 }
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 14, 0)
@@ -195,12 +272,11 @@ static void tegra_udrm_postclose(struct drm_device *drm, struct drm_file *file)
 	struct tegra_udrm_mmap_entry *mmap_entry;
 	int id;
 
-	idr_for_each_entry(&fpriv->idr, mmap_entry, id) {
-		idr_remove(&fpriv->idr, id);
-		kfree(mmap_entry);
-	}
+	idr_for_each_entry(&fpriv->idr, mmap_entry, id)
+		tegra_udrm_remove_mmap_entry(fpriv, mmap_entry);
 
 	idr_destroy(&fpriv->idr);
+	mutex_destroy(&fpriv->mmap_lock);
 
 	if (fpriv->efd_ctx_drop_master) {
 		eventfd_signal(fpriv->efd_ctx_drop_master, 1);
@@ -319,37 +395,49 @@ static int tegra_udrm_set_master_notify_ioctl(struct drm_device *drm,
 	return 0;
 }
 
-static int tegra_udrm_send_vblank_event_ioctl(struct drm_device *drm,
-	void *data, struct drm_file *file)
+static struct drm_pending_vblank_event *tegra_udrm_alloc_vblank_event(
+	const struct drm_event_vblank *vblank)
 {
-	struct drm_tegra_udrm_send_vblank_event *args =
-		(struct drm_tegra_udrm_send_vblank_event *)data;
 	struct drm_pending_vblank_event *e;
-	int ret;
 
 	e = kzalloc(sizeof(*e), GFP_KERNEL);
 	if (!e)
-		return -ENOMEM;
+		return NULL;
 
 	/* make event */
 	e->pipe = 0;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 14, 0)
 	e->base.pid = current->pid;
 #endif
-	e->event.base.type = args->vblank.base.type;
+	e->event.base.type = vblank->base.type;
 	e->event.base.length = sizeof(e->event);
 #if KERNEL_VERSION(5, 8, 0) <= LINUX_VERSION_CODE
-	e->event.vbl.user_data = args->vblank.user_data;
-	e->event.vbl.sequence = args->vblank.sequence;
-	e->event.vbl.tv_sec = args->vblank.tv_sec;
-	e->event.vbl.tv_usec = args->vblank.tv_usec;
+	e->event.vbl.user_data = vblank->user_data;
+	e->event.vbl.sequence = vblank->sequence;
+	e->event.vbl.tv_sec = vblank->tv_sec;
+	e->event.vbl.tv_usec = vblank->tv_usec;
 #else
-	e->event.user_data = args->vblank.user_data;
-	e->event.sequence = args->vblank.sequence;
-	e->event.tv_sec = args->vblank.tv_sec;
-	e->event.tv_usec = args->vblank.tv_usec;
+	e->event.user_data = vblank->user_data;
+	e->event.sequence = vblank->sequence;
+	e->event.tv_sec = vblank->tv_sec;
+	e->event.tv_usec = vblank->tv_usec;
 #endif
 
+	return e;
+}
+
+static int tegra_udrm_send_vblank_event_ioctl(struct drm_device *drm,
+	void *data, struct drm_file *file)
+{
+	struct drm_tegra_udrm_send_vblank_event *args =
+		(struct drm_tegra_udrm_send_vblank_event *)data;
+	struct drm_pending_vblank_event *e;
+	int ret;
+
+	e = tegra_udrm_alloc_vblank_event(&args->vblank);
+	if (!e)
+		return -ENOMEM;
+
 	ret = drm_event_reserve_init(drm, file, &e->base, &e->event.base);
 	if (ret) {
 		kfree(e);
@@ -361,20 +449,18 @@ static int tegra_udrm_send_vblank_event_ioctl(struct drm_device *drm,
 	return 0;
 }
 
-static int tegra_udrm_send_connector_status_event_ioctl(struct drm_device *drm,
-		void *data, struct drm_file *file)
+static int tegra_udrm_send_connector_status_uevent(struct drm_device *drm,
+		u32 conn, u32 prop)
 {
-	struct drm_tegra_udrm_connector_status_event *args =
-		(struct drm_tegra_udrm_connector_status_event *)data;
 	char hotplug_str[] = "HOTPLUG=1", conn_id[30], prop_id[30];
 	char *envp[4] = { hotplug_str, conn_id, prop_id, NULL };
 	int ret = 0;
 
-	ret = snprintf(conn_id, ARRAY_SIZE(conn_id), "CONNECTOR=%u", args->conn_id);
+	ret = snprintf(conn_id, ARRAY_SIZE(conn_id), "CONNECTOR=%u", conn);
 	if ((ret < 0) || (ret >= sizeof(conn_id)))
 		return -EINVAL;
 
-	ret = snprintf(prop_id, ARRAY_SIZE(prop_id), "PROPERTY=%u", args->prop_id);
+	ret = snprintf(prop_id, ARRAY_SIZE(prop_id), "PROPERTY=%u", prop);
 	if ((ret < 0) || (ret >= sizeof(prop_id)))
 		return -EINVAL;
 
@@ -385,6 +471,123 @@ static int tegra_udrm_send_connector_status_event_ioctl(struct drm_device *drm,
 	return ret;
 }
 
+static int tegra_udrm_send_connector_status_event_ioctl(struct drm_device *drm,
+		void *data, struct drm_file *file)
+{
+	struct drm_tegra_udrm_connector_status_event *args =
+		(struct drm_tegra_udrm_connector_status_event *)data;
+
+	return tegra_udrm_send_connector_status_uevent(drm, args->conn_id,
+			args->prop_id);
+}
+
+static int tegra_udrm_send_events_ioctl(struct drm_device *drm,
+		void *data, struct drm_file *file)
+{
+	struct drm_tegra_udrm_send_events *args =
+		(struct drm_tegra_udrm_send_events *)data;
+	struct drm_pending_vblank_event **pending;
+	struct drm_tegra_udrm_event *events;
+	unsigned long flags;
+	u32 i, num = args->num_events;
+	int ret = 0;
+
+	args->num_sent = 0;
+
+	if (num == 0)
+		return 0;
+
+	if (num > DRM_TEGRA_UDRM_MAX_EVENTS)
+		return -EINVAL;
+
+	events = memdup_user(u64_to_user_ptr(args->events),
+			num * sizeof(*events));
+	if (IS_ERR(events))
+		return PTR_ERR(events);
+
+	pending = kcalloc(num, sizeof(*pending), GFP_KERNEL);
+	if (!pending) {
+		ret = -ENOMEM;
+		goto free_events;
+	}
+
+	/* Validate the whole batch and allocate all vblank events up front
+	 * so that nothing is delivered for a malformed request.
+	 */
+	for (i = 0; i < num; i++) {
+		if (events[i].reserved != 0) {
+			ret = -EINVAL;
+			goto free_pending;
+		}
+
+		switch (events[i].type) {
+		case DRM_TEGRA_UDRM_EVENT_VBLANK:
+			pending[i] = tegra_udrm_alloc_vblank_event(
+					&events[i].u.vblank);
+			if (!pending[i]) {
+				ret = -ENOMEM;
+				goto free_pending;
+			}
+			break;
+		case DRM_TEGRA_UDRM_EVENT_CONNECTOR_STATUS:
+			break;
+		default:
+			ret = -EINVAL;
+			goto free_pending;
+		}
+	}
+
+	i = 0;
+	while (i < num) {
+		if (events[i].type == DRM_TEGRA_UDRM_EVENT_CONNECTOR_STATUS) {
+			ret = tegra_udrm_send_connector_status_uevent(drm,
+					events[i].u.connector.conn_id,
+					events[i].u.connector.prop_id);
+			if (ret < 0)
+				break;
+			i++;
+			continue;
+		}
+
+		/* Queue each run of consecutive vblank events under a single
+		 * event_lock acquisition.
+		 */
+		spin_lock_irqsave(&drm->event_lock, flags);
+		for (; i < num &&
+		       events[i].type == DRM_TEGRA_UDRM_EVENT_VBLANK; i++) {
+			ret = drm_event_reserve_init_locked(drm, file,
+					&pending[i]->base,
+					&pending[i]->event.base);
+			if (ret)
+				break;
+
+			drm_send_event_locked(drm, &pending[i]->base);
+			pending[i] = NULL;
+		}
+		spin_unlock_irqrestore(&drm->event_lock, flags);
+
+		if (ret)
+			break;
+	}
+
+	args->num_sent = i;
+
+	/* Report a partial batch as success, num_sent tells user space
+	 * where delivery stopped.
+	 */
+	if (i > 0)
+		ret = 0;
+
+free_pending:
+	for (i = 0; i < num; i++)
+		kfree(pending[i]);
+	kfree(pending);
+free_events:
+	kfree(events);
+
+	return ret;
+}
+
 static const struct file_operations tegra_udrm_fops = {
 	.owner = THIS_MODULE,
 	.open = drm_open,
@@ -429,6 +632,8 @@ static const struct drm_ioctl_desc tegra_udrm_ioctls[] = {
 		tegra_udrm_set_master_notify_ioctl, 0),
 	DRM_IOCTL_DEF_DRV(TEGRA_UDRM_SEND_CONNECTOR_STATUS_EVENT,
 		tegra_udrm_send_connector_status_event_ioctl, 0),
+	DRM_IOCTL_DEF_DRV(TEGRA_UDRM_SEND_EVENTS,
+		tegra_udrm_send_events_ioctl, 0),
 };
 
 static int tegra_udrm_open(struct drm_device *drm, struct drm_file *filp)
@@ -444,6 +649,8 @@ static int tegra_udrm_open(struct drm_device *drm, struct drm_file *filp)
 	fpriv->efd_ctx_close = NULL;
 	fpriv->efd_ctx_drop_master = NULL;
 	idr_init(&fpriv->idr);
+	hash_init(fpriv->mmap_hash);
+	mutex_init(&fpriv->mmap_lock);
 
 	return 0;
 }
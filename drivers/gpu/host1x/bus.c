@@ -16,6 +16,14 @@
 #include "bus.h"
 #include "dev.h"
 
+/*
+ * Number of buffer mappings kept pinned per client between submits. This
+ * bounds client->cache as a whole, so it also covers mappings cached by
+ * display planes (dc), not only job relocs. Evicting a mapping that is still
+ * in use only drops the cache's reference, the user keeps its own.
+ */
+#define HOST1X_CLIENT_BO_CACHE_CAPACITY 64
+
 static DEFINE_MUTEX(clients_lock);
 static LIST_HEAD(clients);
 
@@ -749,6 +757,7 @@ EXPORT_SYMBOL(host1x_driver_unregister);
 void __host1x_client_init(struct host1x_client *client, struct lock_class_key *key)
 {
 	host1x_bo_cache_init(&client->cache);
+	client->cache.capacity = HOST1X_CLIENT_BO_CACHE_CAPACITY;
 	INIT_LIST_HEAD(&client->list);
 	__mutex_init(&client->lock, "host1x client lock", key);
 	client->usecount = 0;
@@ -836,6 +845,7 @@ int host1x_client_unregister(struct host1x_client *client)
 
 	mutex_unlock(&clients_lock);
 
+	host1x_bo_cache_flush(&client->cache);
 	host1x_bo_cache_destroy(&client->cache);
 
 	return 0;
@@ -913,6 +923,19 @@ unlock:
 }
 EXPORT_SYMBOL(host1x_client_resume);
 
+static void __host1x_bo_unpin(struct kref *ref);
+
+/* must be called with the cache lock held */
+static void host1x_bo_cache_evict(struct host1x_bo_cache *cache,
+				  struct host1x_bo_mapping *mapping)
+{
+	list_del_init(&mapping->entry);
+	mapping->cache = NULL;
+	cache->count--;
+
+	kref_put(&mapping->ref, __host1x_bo_unpin);
+}
+
 struct host1x_bo_mapping *host1x_bo_pin(struct device *dev, struct host1x_bo *bo,
 					enum dma_data_direction dir,
 					struct host1x_bo_cache *cache)
@@ -923,8 +946,20 @@ struct host1x_bo_mapping *host1x_bo_pin(struct device *dev, struct host1x_bo *bo
 		mutex_lock(&cache->lock);
 
 		list_for_each_entry(mapping, &cache->mappings, entry) {
-			if (mapping->bo == bo && mapping->direction == dir) {
+			if (mapping->bo == bo && mapping->dev == dev &&
+			    mapping->direction == dir) {
+				list_move_tail(&mapping->entry, &cache->mappings);
 				kref_get(&mapping->ref);
+
+				/*
+				 * The mapping was not torn down since its last
+				 * use, so CPU writes made in between have not
+				 * been flushed to the device yet.
+				 */
+				if (mapping->sgt)
+					dma_sync_sgtable_for_device(mapping->dev,
+								    mapping->sgt,
+								    dir);
 				goto unlock;
 			}
 		}
@@ -939,10 +974,19 @@ struct host1x_bo_mapping *host1x_bo_pin(struct device *dev, struct host1x_bo *bo
 	spin_unlock(&mapping->bo->lock);
 
 	if (cache) {
+		if (cache->capacity && cache->count >= cache->capacity) {
+			struct host1x_bo_mapping *lru;
+
+			lru = list_first_entry(&cache->mappings,
+					       struct host1x_bo_mapping, entry);
+			host1x_bo_cache_evict(cache, lru);
+		}
+
 		INIT_LIST_HEAD(&mapping->entry);
 		mapping->cache = cache;
 
 		list_add_tail(&mapping->entry, &cache->mappings);
+		cache->count++;
 
 		/* bump reference count to track the copy in the cache */
 		kref_get(&mapping->ref);
@@ -964,8 +1008,10 @@ static void __host1x_bo_unpin(struct kref *ref)
 	 * When the last reference of the mapping goes away, make sure to remove the mapping from
 	 * the cache.
 	 */
-	if (mapping->cache)
+	if (mapping->cache) {
 		list_del(&mapping->entry);
+		mapping->cache->count--;
+	}
 
 	spin_lock(&mapping->bo->lock);
 	list_del(&mapping->list);
@@ -987,3 +1033,64 @@ void host1x_bo_unpin(struct host1x_bo_mapping *mapping)
 		mutex_unlock(&cache->lock);
 }
 EXPORT_SYMBOL(host1x_bo_unpin);
+
+/**
+ * host1x_bo_cache_flush() - drop the cache's references to all its mappings
+ * @cache: host1x buffer object cache
+ *
+ * Mappings that are still pinned by other users stay alive until they are
+ * unpinned, but are no longer tracked by the cache.
+ */
+void host1x_bo_cache_flush(struct host1x_bo_cache *cache)
+{
+	struct host1x_bo_mapping *mapping, *tmp;
+
+	mutex_lock(&cache->lock);
+
+	list_for_each_entry_safe(mapping, tmp, &cache->mappings, entry)
+		host1x_bo_cache_evict(cache, mapping);
+
+	mutex_unlock(&cache->lock);
+}
+EXPORT_SYMBOL(host1x_bo_cache_flush);
+
+/**
+ * host1x_bo_uncache() - drop all cached mappings of a buffer object
+ * @bo: host1x buffer object
+ *
+ * Cached mappings hold a reference to their buffer object, so a buffer that
+ * is released by its owner would otherwise stay allocated and mapped until
+ * it is evicted. Mappings still pinned by other users stay alive until they
+ * are unpinned.
+ */
+void host1x_bo_uncache(struct host1x_bo *bo)
+{
+	struct host1x_bo_mapping *mapping;
+	struct host1x_bo_cache *cache;
+
+	while (true) {
+		cache = NULL;
+
+		spin_lock(&bo->lock);
+		list_for_each_entry(mapping, &bo->mappings, list) {
+			if (mapping->cache &&
+			    kref_get_unless_zero(&mapping->ref)) {
+				cache = mapping->cache;
+				break;
+			}
+		}
+		spin_unlock(&bo->lock);
+
+		if (!cache)
+			break;
+
+		mutex_lock(&cache->lock);
+		if (mapping->cache == cache)
+			host1x_bo_cache_evict(cache, mapping);
+		mutex_unlock(&cache->lock);
+
+		/* drop the reference taken above */
+		host1x_bo_unpin(mapping);
+	}
+}
+EXPORT_SYMBOL(host1x_bo_uncache);
@@ -189,6 +189,23 @@ static const struct file_operations host1x_debug_fops = {
 	.release = single_release,
 };
 
+static int host1x_debug_job_stats_show(struct seq_file *s, void *unused)
+{
+	struct host1x *m = s->private;
+	struct host1x_job_stats *stats = &m->job_stats;
+
+	seq_printf(s, "pins: %lld\n", atomic64_read(&stats->pins));
+	seq_printf(s, "unpins: %lld\n", atomic64_read(&stats->unpins));
+	seq_printf(s, "pinned_bos: %lld\n", atomic64_read(&stats->pinned_bos));
+	seq_printf(s, "batched_gather_maps: %lld\n",
+		   atomic64_read(&stats->batched_maps));
+	seq_printf(s, "pin_time_ns: %lld\n", atomic64_read(&stats->pin_ns));
+	seq_printf(s, "unpin_time_ns: %lld\n", atomic64_read(&stats->unpin_ns));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(host1x_debug_job_stats);
+
 static void host1x_debugfs_init(struct host1x *host1x)
 {
 	struct dentry *de = debugfs_create_dir("tegra-host1x", NULL);
@@ -199,6 +216,8 @@ static void host1x_debugfs_init(struct host1x *host1x)
 	debugfs_create_file("status", S_IRUGO, de, host1x, &host1x_debug_fops);
 	debugfs_create_file("status_all", S_IRUGO, de, host1x,
 			    &host1x_debug_all_fops);
+	debugfs_create_file("job_stats", S_IRUGO, de, host1x,
+			    &host1x_debug_job_stats_fops);
 
 	debugfs_create_u32("trace_cmdbuf", S_IRUGO|S_IWUSR, de,
 			   &host1x_debug_trace_cmdbuf);
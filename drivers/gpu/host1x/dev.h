@@ -118,6 +118,15 @@ struct host1x_info {
 	bool reserve_vblank_syncpts;
 };
 
+struct host1x_job_stats {
+	atomic64_t pins;
+	atomic64_t unpins;
+	atomic64_t pinned_bos;
+	atomic64_t batched_maps;
+	atomic64_t pin_ns;
+	atomic64_t unpin_ns;
+};
+
 struct host1x {
 	const struct host1x_info *info;
 
@@ -163,6 +172,8 @@ struct host1x {
 	struct device_dma_parameters dma_parms;
 
 	struct host1x_bo_cache cache;
+
+	struct host1x_job_stats job_stats;
 };
 
 void host1x_common_writel(struct host1x *host1x, u32 v, u32 r);
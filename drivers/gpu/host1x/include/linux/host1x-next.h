@@ -34,25 +34,35 @@ u64 host1x_get_dma_mask(struct host1x *host1x);
 
 /**
  * struct host1x_bo_cache - host1x buffer object cache
- * @mappings: list of mappings
+ * @mappings: list of mappings, least recently used first
  * @lock: synchronizes accesses to the list of mappings
+ * @count: number of mappings in the cache
+ * @capacity: maximum number of mappings kept, or 0 for no limit
  *
  * Note that entries are not periodically evicted from this cache and instead need to be
  * explicitly released. This is used primarily for DRM/KMS where the cache's reference is
  * released when the last reference to a buffer object represented by a mapping in this
- * cache is dropped.
+ * cache is dropped. Caches with a non-zero capacity additionally evict the least recently
+ * used mapping when a new one is added to a full cache, and host1x_bo_uncache() drops the
+ * cached mappings of a buffer object that its owner has released.
  */
 struct host1x_bo_cache {
 	struct list_head mappings;
 	struct mutex lock;
+	unsigned int count;
+	unsigned int capacity;
 };
 
 static inline void host1x_bo_cache_init(struct host1x_bo_cache *cache)
 {
 	INIT_LIST_HEAD(&cache->mappings);
 	mutex_init(&cache->lock);
+	cache->count = 0;
+	cache->capacity = 0;
 }
 
+void host1x_bo_cache_flush(struct host1x_bo_cache *cache);
+
 static inline void host1x_bo_cache_destroy(struct host1x_bo_cache *cache)
 {
 	/* XXX warn if not empty? */
@@ -180,6 +190,7 @@ struct host1x_bo_mapping *host1x_bo_pin(struct device *dev, struct host1x_bo *bo
 					enum dma_data_direction dir,
 					struct host1x_bo_cache *cache);
 void host1x_bo_unpin(struct host1x_bo_mapping *map);
+void host1x_bo_uncache(struct host1x_bo *bo);
 
 static inline void *host1x_bo_mmap(struct host1x_bo *bo)
 {
@@ -319,6 +330,10 @@ struct host1x_job {
 	dma_addr_t gather_copy;
 	u8 *gather_copy_mapped;
 
+	/* IOVA range holding all gathers when they are mapped in one batch */
+	size_t gather_iova_size;
+	dma_addr_t gather_iova;
+
 	/* Check if register is marked as an address reg */
 	int (*is_addr_reg)(struct device *dev, u32 class, u32 reg);
 
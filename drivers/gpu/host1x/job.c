@@ -10,6 +10,7 @@
 #include <linux/host1x-next.h>
 #include <linux/iommu.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
@@ -147,16 +148,163 @@ void host1x_job_add_wait(struct host1x_job *job, u32 id, u32 thresh,
 }
 EXPORT_SYMBOL(host1x_job_add_wait);
 
+static bool gathers_can_batch(struct host1x *host, struct host1x_job *job,
+			      unsigned int first, unsigned int *nents)
+{
+	struct scatterlist *sg;
+	unsigned int i, j;
+
+	*nents = 0;
+
+	for (i = first; i < job->num_unpins; i++) {
+		struct host1x_bo_mapping *map = job->unpins[i].map;
+
+		for_each_sgtable_sg(map->sgt, sg, j) {
+			if (iova_offset(&host->iova, sg_phys(sg)) ||
+			    iova_offset(&host->iova, sg->length))
+				return false;
+		}
+
+		*nents += map->sgt->orig_nents;
+	}
+
+	return *nents > 0;
+}
+
+/*
+ * Map all gathers of a job into one contiguous IOVA range with a single
+ * iommu_map_sg() call. This only works if every segment is aligned to the
+ * IOVA granule; otherwise each gather gets its own range as before.
+ */
+static int map_gathers_batched(struct host1x *host, struct host1x_job *job,
+			       unsigned int first, unsigned int nents)
+{
+	struct scatterlist *sg, *dst;
+	struct sg_table sgt;
+	unsigned long shift;
+	struct iova *alloc;
+	size_t size = 0, offset = 0;
+	unsigned int i, j;
+	int err;
+
+	err = sg_alloc_table(&sgt, nents, GFP_KERNEL);
+	if (err < 0)
+		return err;
+
+	dst = sgt.sgl;
+
+	for (i = first; i < job->num_unpins; i++) {
+		struct host1x_bo_mapping *map = job->unpins[i].map;
+
+		for_each_sgtable_sg(map->sgt, sg, j) {
+			sg_set_page(dst, sg_page(sg), sg->length, sg->offset);
+			size += sg->length;
+			dst = sg_next(dst);
+		}
+	}
+
+	shift = iova_shift(&host->iova);
+	alloc = alloc_iova(&host->iova, size >> shift,
+			   host->iova_end >> shift, true);
+	if (!alloc) {
+		err = -ENOMEM;
+		goto free;
+	}
+
+	job->gather_iova = iova_dma_addr(&host->iova, alloc);
+
+	if (iommu_map_sgtable(host->domain, job->gather_iova, &sgt,
+			      IOMMU_READ) != size) {
+		__free_iova(&host->iova, alloc);
+		err = -EINVAL;
+		goto free;
+	}
+
+	job->gather_iova_size = size;
+
+	for (i = 0; i < job->num_cmds; i++) {
+		if (job->cmds[i].is_wait)
+			continue;
+
+		job->gather_addr_phys[i] = job->gather_iova + offset;
+		job->addr_phys[first] = job->gather_addr_phys[i];
+		job->unpins[first].map->phys = job->gather_addr_phys[i];
+
+		for_each_sgtable_sg(job->unpins[first].map->sgt, sg, j)
+			offset += sg->length;
+
+		first++;
+	}
+
+	atomic64_inc(&host->job_stats.batched_maps);
+
+free:
+	sg_free_table(&sgt);
+	return err;
+}
+
+static int map_gathers(struct host1x *host, struct host1x_job *job,
+		       unsigned int first)
+{
+	struct host1x_job_unpin_data *unpin;
+	size_t gather_size;
+	struct scatterlist *sg;
+	unsigned long shift;
+	struct iova *alloc;
+	unsigned int i, j, nents;
+	int err;
+
+	if (gathers_can_batch(host, job, first, &nents) &&
+	    map_gathers_batched(host, job, first, nents) == 0)
+		return 0;
+
+	for (i = 0; i < job->num_cmds; i++) {
+		if (job->cmds[i].is_wait)
+			continue;
+
+		unpin = &job->unpins[first];
+		gather_size = 0;
+
+		for_each_sgtable_sg(unpin->map->sgt, sg, j)
+			gather_size += sg->length;
+
+		gather_size = iova_align(&host->iova, gather_size);
+
+		shift = iova_shift(&host->iova);
+		alloc = alloc_iova(&host->iova, gather_size >> shift,
+				   host->iova_end >> shift, true);
+		if (!alloc)
+			return -ENOMEM;
+
+		err = iommu_map_sgtable(host->domain, iova_dma_addr(&host->iova, alloc),
+					unpin->map->sgt, IOMMU_READ);
+		if (err == 0) {
+			__free_iova(&host->iova, alloc);
+			return -EINVAL;
+		}
+
+		unpin->map->phys = iova_dma_addr(&host->iova, alloc);
+		unpin->iova_size = gather_size;
+
+		job->addr_phys[first] = unpin->map->phys;
+		job->gather_addr_phys[i] = unpin->map->phys;
+		first++;
+	}
+
+	return 0;
+}
+
 static unsigned int pin_job(struct host1x *host, struct host1x_job *job)
 {
 	unsigned long mask = HOST1X_RELOC_READ | HOST1X_RELOC_WRITE;
 	struct host1x_client *client = job->client;
 	struct device *dev = client->dev;
 	struct host1x_job_gather *g;
-	unsigned int i;
+	unsigned int i, first_gather;
 	int err;
 
 	job->num_unpins = 0;
+	job->gather_iova_size = 0;
 
 	for (i = 0; i < job->num_relocs; i++) {
 		struct host1x_reloc *reloc = &job->relocs[i];
@@ -190,7 +338,11 @@ static unsigned int pin_job(struct host1x *host, struct host1x_job *job)
 			goto unpin;
 		}
 
-		map = host1x_bo_pin(dev, bo, direction, NULL);
+		/*
+		 * Keep reloc targets mapped in the client's cache so that buffers
+		 * reused across submits are not re-mapped every time.
+		 */
+		map = host1x_bo_pin(dev, bo, direction, &client->cache);
 		if (IS_ERR(map)) {
 			err = PTR_ERR(map);
 			goto unpin;
@@ -208,9 +360,12 @@ static unsigned int pin_job(struct host1x *host, struct host1x_job *job)
 
 		job->addr_phys[job->num_unpins] = map->phys;
 		job->unpins[job->num_unpins].map = map;
+		job->unpins[job->num_unpins].iova_size = 0;
 		job->num_unpins++;
 	}
 
+	first_gather = job->num_unpins;
+
 	/*
 	 * We will copy gathers BO content later, so there is no need to
 	 * hold and pin them.
@@ -220,11 +375,6 @@ static unsigned int pin_job(struct host1x *host, struct host1x_job *job)
 
 	for (i = 0; i < job->num_cmds; i++) {
 		struct host1x_bo_mapping *map;
-		size_t gather_size = 0;
-		struct scatterlist *sg;
-		unsigned long shift;
-		struct iova *alloc;
-		unsigned int j;
 
 		if (job->cmds[i].is_wait)
 			continue;
@@ -240,42 +390,23 @@ static unsigned int pin_job(struct host1x *host, struct host1x_job *job)
 		map = host1x_bo_pin(host->dev, g->bo, DMA_TO_DEVICE, NULL);
 		if (IS_ERR(map)) {
 			err = PTR_ERR(map);
-			goto unpin;
-		}
-
-		if (host->domain) {
-			for_each_sgtable_sg(map->sgt, sg, j)
-				gather_size += sg->length;
-
-			gather_size = iova_align(&host->iova, gather_size);
-
-			shift = iova_shift(&host->iova);
-			alloc = alloc_iova(&host->iova, gather_size >> shift,
-					   host->iova_end >> shift, true);
-			if (!alloc) {
-				err = -ENOMEM;
-				goto put;
-			}
-
-			err = iommu_map_sgtable(host->domain, iova_dma_addr(&host->iova, alloc),
-						map->sgt, IOMMU_READ);
-			if (err == 0) {
-				__free_iova(&host->iova, alloc);
-				err = -EINVAL;
-				goto put;
-			}
-
-			map->phys = iova_dma_addr(&host->iova, alloc);
-			map->size = gather_size;
+			goto put;
 		}
 
 		job->addr_phys[job->num_unpins] = map->phys;
 		job->unpins[job->num_unpins].map = map;
+		job->unpins[job->num_unpins].iova_size = 0;
 		job->num_unpins++;
 
 		job->gather_addr_phys[i] = map->phys;
 	}
 
+	if (host->domain) {
+		err = map_gathers(host, job, first_gather);
+		if (err < 0)
+			goto unpin;
+	}
+
 	return 0;
 
 put:
@@ -609,6 +740,7 @@ int host1x_job_pin(struct host1x_job *job, struct device *dev)
 	int err;
 	unsigned int i, j;
 	struct host1x *host = dev_get_drvdata(dev->parent);
+	u64 start = ktime_get_ns();
 
 	/* pin memory */
 	err = pin_job(host, job);
@@ -655,6 +787,12 @@ out:
 		host1x_job_unpin(job);
 	wmb();
 
+	if (!err) {
+		atomic64_inc(&host->job_stats.pins);
+		atomic64_add(job->num_unpins, &host->job_stats.pinned_bos);
+		atomic64_add(ktime_get_ns() - start, &host->job_stats.pin_ns);
+	}
+
 	return err;
 }
 EXPORT_SYMBOL(host1x_job_pin);
@@ -662,21 +800,42 @@ EXPORT_SYMBOL(host1x_job_pin);
 void host1x_job_unpin(struct host1x_job *job)
 {
 	struct host1x *host = dev_get_drvdata(job->channel->dev->parent);
+	u64 start = ktime_get_ns();
 	unsigned int i;
 
+	if (job->gather_iova_size) {
+		iommu_unmap(host->domain, job->gather_iova, job->gather_iova_size);
+		free_iova(&host->iova, iova_pfn(&host->iova, job->gather_iova));
+		job->gather_iova_size = 0;
+	}
+
 	for (i = 0; i < job->num_unpins; i++) {
 		struct host1x_bo_mapping *map = job->unpins[i].map;
+		size_t iova_size = job->unpins[i].iova_size;
 		struct host1x_bo *bo = map->bo;
 
-		if (!job->enable_firewall && map->size && host->domain) {
-			iommu_unmap(host->domain, job->addr_phys[i], map->size);
+		if (iova_size) {
+			iommu_unmap(host->domain, job->addr_phys[i], iova_size);
 			free_iova(&host->iova, iova_pfn(&host->iova, job->addr_phys[i]));
 		}
 
+		/*
+		 * Cached mappings are not unmapped here, so make the device's
+		 * writes visible to the CPU explicitly.
+		 */
+		if (map->cache && map->sgt && map->direction != DMA_TO_DEVICE)
+			dma_sync_sgtable_for_cpu(map->dev, map->sgt,
+						 map->direction);
+
 		host1x_bo_unpin(map);
 		host1x_bo_put(bo);
 	}
 
+	if (job->num_unpins) {
+		atomic64_inc(&host->job_stats.unpins);
+		atomic64_add(ktime_get_ns() - start, &host->job_stats.unpin_ns);
+	}
+
 	job->num_unpins = 0;
 
 	if (job->gather_copy_size)
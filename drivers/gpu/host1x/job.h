@@ -36,6 +36,8 @@ struct host1x_job_cmd {
 
 struct host1x_job_unpin_data {
 	struct host1x_bo_mapping *map;
+	/* size of a gather mapped into host1x's domain on its own */
+	size_t iova_size;
 };
 
 /*
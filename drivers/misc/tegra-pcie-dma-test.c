@@ -10,12 +10,14 @@
 #include <linux/crc32.h>
 #include <linux/debugfs.h>
 #include <linux/device.h>
+#include <linux/dma-mapping.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/pci.h>
 #include <linux/pcie_dma.h>
+#include <linux/platform_device.h>
 #include <linux/random.h>
 #include <linux/types.h>
 #include <linux/tegra-pcie-edma-test-common.h>
@@ -24,6 +26,13 @@
 
 #define EDMA_LIB_TEST 1
 
+/* Memory of the software engine: src in the first half, dst in the second */
+#define EDMA_SW_WINDOW_SIZE	SZ_32M
+
+static bool sw_engine = true;
+module_param(sw_engine, bool, 0444);
+MODULE_PARM_DESC(sw_engine, "Create a software eDMA engine to run edmalib_loopback without HW");
+
 struct ep_pvt {
 	struct pci_dev *pdev;
 	void __iomem *bar0_virt;
@@ -47,6 +56,16 @@ struct ep_pvt {
 	struct edmalib_common edma;
 };
 
+struct edma_sw_pvt {
+	struct platform_device *pdev;
+	void *virt;
+	dma_addr_t phy;
+	struct dentry *debugfs;
+	struct edmalib_common edma;
+};
+
+static struct edma_sw_pvt *edma_sw;
+
 static irqreturn_t ep_isr(int irq, void *arg)
 {
 #ifndef EDMA_LIB_TEST
@@ -116,10 +135,8 @@ static void  tegra_pci_dma_put_host_bridge_device(struct device *dev)
 	kobject_put(&dev->kobj);
 }
 
-/* debugfs to perform eDMA lib transfers */
-static int edmalib_test(struct seq_file *s, void *data)
+static void edmalib_setup(struct ep_pvt *ep, bool remote)
 {
-	struct ep_pvt *ep = (struct ep_pvt *)dev_get_drvdata(s->private);
 	struct pcie_epf_bar0 *epf_bar0 = (struct pcie_epf_bar0 *)ep->bar0_virt;
 	 /* RP uses 128M(used by EP) + 1M(reserved) offset for source and dest data transfers */
 	dma_addr_t ep_dma_addr = epf_bar0->ep_phy_addr + SZ_128M + SZ_1M;
@@ -127,7 +144,6 @@ static int edmalib_test(struct seq_file *s, void *data)
 	dma_addr_t rp_dma_addr = ep->dma_phy + SZ_128M + SZ_1M;
 	struct pci_dev *pdev = ep->pdev;
 	struct device *bridge, *rdev;
-	struct edmalib_common *edma = &ep->edma;
 
 	ep->edma.src_dma_addr = rp_dma_addr;
 	ep->edma.src_virt = ep->dma_virt + SZ_128M + SZ_1M;
@@ -136,7 +152,7 @@ static int edmalib_test(struct seq_file *s, void *data)
 	ep->edma.bar0_phy = ep->bar0_phy;
 	ep->edma.dma_base = ep->dma_base;
 
-	if (REMOTE_EDMA_TEST_EN) {
+	if (remote) {
 		ep->edma.dst_dma_addr = ep_dma_addr;
 		ep->edma.edma_remote.msi_addr = ep->msi_addr;
 		ep->edma.edma_remote.msi_data = ep->msi_data;
@@ -151,13 +167,34 @@ static int edmalib_test(struct seq_file *s, void *data)
 		ep->edma.of_node = rdev->of_node;
 		ep->edma.dst_dma_addr = bar0_dma_addr;
 	}
+}
+
+/* debugfs to perform eDMA lib transfers */
+static int edmalib_test(struct seq_file *s, void *data)
+{
+	struct ep_pvt *ep = (struct ep_pvt *)dev_get_drvdata(s->private);
+	struct edmalib_common *edma = &ep->edma;
+
+	edmalib_setup(ep, REMOTE_EDMA_TEST_EN);
 
 	return edmalib_common_test(&ep->edma);
 }
 
+/* debugfs to measure local WR channel throughput, edma_ch remote bit is ignored */
+static int edmalib_loopback(struct seq_file *s, void *data)
+{
+	struct ep_pvt *ep = (struct ep_pvt *)dev_get_drvdata(s->private);
+
+	edmalib_setup(ep, false);
+
+	return edmalib_common_loopback(&ep->edma, s);
+}
+
 static void init_debugfs(struct ep_pvt *ep)
 {
 	debugfs_create_devm_seqfile(&ep->pdev->dev, "edmalib_test", ep->debugfs, edmalib_test);
+	debugfs_create_devm_seqfile(&ep->pdev->dev, "edmalib_loopback", ep->debugfs,
+				    edmalib_loopback);
 
 	debugfs_create_u32("edma_ch", 0644, ep->debugfs, &ep->edma.edma_ch);
 	/* Enable remote dma ASYNC for ch 0 as default */
@@ -369,7 +406,136 @@ static struct pci_driver ep_pci_driver = {
 	.remove		= ep_test_dma_remove,
 };
 
-module_pci_driver(ep_pci_driver);
+/* debugfs to run the loopback on the software engine */
+static int edmalib_sw_loopback(struct seq_file *s, void *data)
+{
+	struct edma_sw_pvt *sw = (struct edma_sw_pvt *)dev_get_drvdata(s->private);
+
+	return edmalib_common_loopback(&sw->edma, s);
+}
+
+static void edma_sw_deinit(void)
+{
+	struct edma_sw_pvt *sw = edma_sw;
+
+	if (!sw)
+		return;
+
+	debugfs_remove_recursive(sw->debugfs);
+	dma_free_coherent(&sw->pdev->dev, EDMA_SW_WINDOW_SIZE, sw->virt, sw->phy);
+	kfree(sw->edma.ll_desc);
+	platform_device_unregister(sw->pdev);
+	kfree(sw);
+	edma_sw = NULL;
+}
+
+/* Device with CPU copies in place of eDMA HW, so the loopback runs anywhere */
+static int edma_sw_init(void)
+{
+	struct platform_device_info pdevinfo = {
+		.name = MODULENAME "_sw",
+		.id = PLATFORM_DEVID_NONE,
+		.dma_mask = DMA_BIT_MASK(64),
+	};
+	struct edmalib_common *edma;
+	struct edma_sw_pvt *sw;
+	int ret, i;
+
+	sw = kzalloc(sizeof(*sw), GFP_KERNEL);
+	if (!sw)
+		return -ENOMEM;
+
+	sw->pdev = platform_device_register_full(&pdevinfo);
+	if (IS_ERR(sw->pdev)) {
+		ret = PTR_ERR(sw->pdev);
+		goto fail_register;
+	}
+	platform_set_drvdata(sw->pdev, sw);
+
+	edma = &sw->edma;
+	edma->fdev = &sw->pdev->dev;
+	edma->ll_desc = kcalloc(NUM_EDMA_DESC, sizeof(*edma->ll_desc), GFP_KERNEL);
+	if (!edma->ll_desc) {
+		ret = -ENOMEM;
+		goto fail_ll_desc;
+	}
+
+	sw->virt = dma_alloc_coherent(edma->fdev, EDMA_SW_WINDOW_SIZE, &sw->phy, GFP_KERNEL);
+	if (!sw->virt) {
+		ret = -ENOMEM;
+		goto fail_dma_alloc;
+	}
+
+	edma->sw.dev = edma->fdev;
+	edma->sw.base = sw->phy;
+	edma->sw.virt = sw->virt;
+	edma->sw.size = EDMA_SW_WINDOW_SIZE;
+	edma->src_dma_addr = sw->phy;
+	edma->src_virt = sw->virt;
+	edma->dst_dma_addr = sw->phy + EDMA_SW_WINDOW_SIZE / 2;
+	edma->dst_virt = sw->virt + EDMA_SW_WINDOW_SIZE / 2;
+
+	for (i = 0; i < DMA_WR_CHNL_NUM; i++)
+		init_waitqueue_head(&edma->wr_wq[i]);
+
+	for (i = 0; i < DMA_RD_CHNL_NUM; i++)
+		init_waitqueue_head(&edma->rd_wq[i]);
+
+	sw->debugfs = debugfs_create_dir(MODULENAME "_sw", NULL);
+	debugfs_create_devm_seqfile(edma->fdev, "edmalib_loopback", sw->debugfs,
+				    edmalib_sw_loopback);
+
+	debugfs_create_u32("edma_ch", 0644, sw->debugfs, &edma->edma_ch);
+	/* All WR channels, loopback always runs them ASYNC */
+	edma->edma_ch = 0xF0;
+
+	debugfs_create_u32("stress_count", 0644, sw->debugfs, &edma->stress_count);
+	edma->stress_count = 1000;
+
+	debugfs_create_u32("dma_size", 0644, sw->debugfs, &edma->dma_size);
+	edma->dma_size = SZ_64K;
+
+	debugfs_create_u32("nents", 0644, sw->debugfs, &edma->nents);
+	edma->nents = DMA_LL_DEFAULT_SIZE;
+
+	edma_sw = sw;
+
+	return 0;
+
+fail_dma_alloc:
+	kfree(edma->ll_desc);
+fail_ll_desc:
+	platform_device_unregister(sw->pdev);
+fail_register:
+	kfree(sw);
+
+	return ret;
+}
+
+static int __init ep_test_dma_init(void)
+{
+	int ret;
+
+	if (sw_engine) {
+		ret = edma_sw_init();
+		if (ret < 0)
+			pr_warn("%s: software eDMA engine not available: %d\n", MODULENAME, ret);
+	}
+
+	ret = pci_register_driver(&ep_pci_driver);
+	if (ret < 0)
+		edma_sw_deinit();
+
+	return ret;
+}
+module_init(ep_test_dma_init);
+
+static void __exit ep_test_dma_exit(void)
+{
+	pci_unregister_driver(&ep_pci_driver);
+	edma_sw_deinit();
+}
+module_exit(ep_test_dma_exit);
 
 MODULE_DESCRIPTION("Tegra PCIe client driver for endpoint DMA test func");
 MODULE_LICENSE("GPL");
@@ -456,6 +456,11 @@ void ttcan_tx_trigger_msg_transmit(struct ttcan_controller *ttcan, u8 index)
 	ttcan_write32(ttcan, ADR_MTTCAN_TXBAR, (1 << index));
 }
 
+void ttcan_tx_trigger_msgs_transmit(struct ttcan_controller *ttcan, u32 mask)
+{
+	ttcan_write32(ttcan, ADR_MTTCAN_TXBAR, mask);
+}
+
 int ttcan_tx_msg_buffer_write(struct ttcan_controller *ttcan,
 			      struct ttcanfd_frame *ttcanfd)
 {
@@ -568,7 +573,7 @@ static int process_rx_mesg(struct ttcan_controller *ttcan, u32 addr)
 {
 	struct ttcanfd_frame ttcanfd = {0};
 	ttcan_read_rx_msg_ram(ttcan, addr, &ttcanfd);
-	return add_msg_controller_list(ttcan, &ttcanfd, &ttcan->rx_b, BUFFER);
+	return add_msg_controller_list(ttcan, &ttcanfd, &ttcan->rx_b);
 }
 
 int ttcan_read_rx_buffer(struct ttcan_controller *ttcan)
@@ -640,7 +645,7 @@ unsigned int ttcan_read_txevt_fifo(struct ttcan_controller *ttcan)
 		ttcan_read_txevt_ram(ttcan, read_addr, &txevt);
 		if (add_event_controller_list(ttcan, &txevt,
 					      &ttcan->tx_evt) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
+			pr_debug("%s: tx event ring full\n", __func__);
 			return msgs_read;
 		}
 		ttcan_write32(ttcan, ADR_MTTCAN_TXEFA, get_idx);
@@ -688,8 +693,8 @@ unsigned int ttcan_read_rx_fifo0(struct ttcan_controller *ttcan)
 
 		ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
 		if (add_msg_controller_list(ttcan, &ttcanfd,
-					    &ttcan->rx_q0, FIFO_0) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
+					    &ttcan->rx_q0) < 0) {
+			pr_debug("%s: rx ring full\n", __func__);
 			return msgs_read;
 		}
 		ttcan_write32(ttcan, ADR_MTTCAN_RXF0A, get_idx);
@@ -734,8 +739,8 @@ unsigned int ttcan_read_rx_fifo1(struct ttcan_controller *ttcan)
 
 		ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
 		if (add_msg_controller_list(ttcan, &ttcanfd,
-					    &ttcan->rx_q1, FIFO_1) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
+					    &ttcan->rx_q1) < 0) {
+			pr_debug("%s: rx ring full\n", __func__);
 			return msgs_read;
 		}
 		ttcan_write32(ttcan, ADR_MTTCAN_RXF1A, get_idx);
@@ -16,98 +16,83 @@
 
 #include "m_ttcan.h"
 
-#define TTCAN_MAX_LIST_MEMBERS 128
-
-inline int is_msg_list_full(struct ttcan_controller *ttcan,
-		enum ttcan_rx_type rxtype)
-{
-	return ttcan->list_status & rxtype & 0xFF;
-}
+#define TTCAN_RING_MASK (TTCAN_RX_RING_SIZE - 1)
 
+/*
+ * Rings are filled by the message RAM readers and drained by the netdev
+ * side. Both run from the NAPI poll (native) or the mbox rx callback (IVC),
+ * not from the hard IRQ: the ISR masks all interrupts until the poll
+ * completes, so reading MRAM there would not pick up more frames. The ring
+ * holds what was read from MRAM but not yet delivered when the NAPI quota
+ * runs out. There is a single producer and a single consumer per ring, so
+ * slots are published with release/acquire on head and tail only.
+ */
 int add_msg_controller_list(struct ttcan_controller *ttcan,
 			    struct ttcanfd_frame *ttcanfd,
-			    struct list_head *rx_q,
-			    enum ttcan_rx_type rxtype)
+			    struct ttcan_rx_ring *rx_q)
 {
+	unsigned int head = rx_q->head;
+	unsigned int tail = smp_load_acquire(&rx_q->tail);
 
-	struct ttcan_rx_msg_list *msg_list;
-
-	msg_list = (struct ttcan_rx_msg_list *)
-		kzalloc(sizeof(struct ttcan_rx_msg_list), GFP_ATOMIC);
-	if (msg_list == NULL) {
-		pr_err("%s: memory allocation failed\n", __func__);
+	if (head - tail >= TTCAN_RX_RING_SIZE) {
+		/* Frame stays in message RAM and is read on next poll */
+		rx_q->overruns++;
 		return -ENOMEM;
 	}
 
-	INIT_LIST_HEAD(&msg_list->recv_list);
+	memcpy(&rx_q->msg[head & TTCAN_RING_MASK], ttcanfd,
+	       sizeof(struct ttcanfd_frame));
+	smp_store_release(&rx_q->head, head + 1);
 
-	memcpy(&msg_list->msg, ttcanfd, sizeof(struct ttcanfd_frame));
+	return 0;
+}
 
-	spin_lock(&ttcan->lock);
+struct ttcanfd_frame *ttcan_rx_ring_peek(struct ttcan_rx_ring *rx_q)
+{
+	unsigned int tail = rx_q->tail;
 
-	if (is_msg_list_full(ttcan, rxtype)) {
-		pr_err("%s: mesg list is full\n", __func__);
-		kfree(msg_list);
-		spin_unlock(&ttcan->lock);
-		return -ENOMEM;
-	}
+	if (smp_load_acquire(&rx_q->head) == tail)
+		return NULL;
 
-	list_add_tail(&msg_list->recv_list, rx_q);
-
-	switch (rxtype) {
-	case BUFFER:
-		if (++ttcan->rxb_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= BUFFER;
-		break;
-	case FIFO_0:
-		if (++ttcan->rxq0_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= FIFO_0;
-		break;
-	case FIFO_1:
-		if (++ttcan->rxq1_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= FIFO_1;
-	default:
-		break;
-	}
-	spin_unlock(&ttcan->lock);
+	return &rx_q->msg[tail & TTCAN_RING_MASK];
+}
 
-	return 0;
+void ttcan_rx_ring_consume(struct ttcan_rx_ring *rx_q)
+{
+	smp_store_release(&rx_q->tail, rx_q->tail + 1);
 }
 
 int add_event_controller_list(struct ttcan_controller *ttcan,
 			    struct mttcan_tx_evt_element *txevt,
-			    struct list_head *evt_q)
+			    struct ttcan_txevt_ring *evt_q)
 {
+	unsigned int head = evt_q->head;
+	unsigned int tail = smp_load_acquire(&evt_q->tail);
 
-	struct ttcan_txevt_msg_list *evt_list;
-
-	evt_list =
-	    (struct ttcan_txevt_msg_list *)
-	    kzalloc(sizeof(struct ttcan_txevt_msg_list), GFP_ATOMIC);
-	if (evt_list == NULL) {
-		pr_err("%s: memory allocation failed\n", __func__);
+	if (head - tail >= TTCAN_RX_RING_SIZE) {
+		evt_q->overruns++;
 		return -ENOMEM;
 	}
 
-	INIT_LIST_HEAD(&evt_list->txevt_list);
+	memcpy(&evt_q->txevt[head & TTCAN_RING_MASK], txevt,
+	       sizeof(struct mttcan_tx_evt_element));
+	smp_store_release(&evt_q->head, head + 1);
 
-	memcpy(&evt_list->txevt, txevt, sizeof(struct mttcan_tx_evt_element));
-
-	spin_lock(&ttcan->lock);
-
-	if (is_msg_list_full(ttcan, TX_EVT)) {
-		pr_err("%s: mesg list is full\n", __func__);
-		kfree(evt_list);
-		spin_unlock(&ttcan->lock);
-		return -1;
-	}
+	return 0;
+}
 
-	list_add_tail(&evt_list->txevt_list, evt_q);
+struct mttcan_tx_evt_element *ttcan_txevt_ring_peek(
+	struct ttcan_txevt_ring *evt_q)
+{
+	unsigned int tail = evt_q->tail;
 
-	if (++ttcan->evt_mem >= TTCAN_MAX_LIST_MEMBERS)
-		ttcan->list_status |= TX_EVT;
+	if (smp_load_acquire(&evt_q->head) == tail)
+		return NULL;
 
-	spin_unlock(&ttcan->lock);
+	return &evt_q->txevt[tail & TTCAN_RING_MASK];
+}
 
-	return 0;
+void ttcan_txevt_ring_consume(struct ttcan_txevt_ring *evt_q)
+{
+	smp_store_release(&evt_q->tail, evt_q->tail + 1);
 }
@@ -141,13 +141,6 @@ enum ttcan_timestamp_source {
 	TS_DISABLE2 = 3
 };
 
-enum ttcan_rx_type {
-	BUFFER = 1,
-	FIFO_0 = 2,
-	FIFO_1 = 4,
-	TX_EVT = 8
-};
-
 
 enum ttcan_mram_item {
 	MRAM_SIDF = 0,
@@ -276,14 +269,26 @@ struct ttcan_filter_config {
 	u32 xtd_fltr_size;
 };
 
-struct ttcan_rx_msg_list {
-	struct ttcanfd_frame msg;
-	struct list_head recv_list;
+/* Must be a power of 2 */
+#define TTCAN_RX_RING_SIZE 128
+
+/*
+ * Preallocated single producer / single consumer rings between the
+ * message RAM readers and the netdev side. Frames left over when the NAPI
+ * quota runs out stay here for the next poll. head and tail are free running.
+ */
+struct ttcan_rx_ring {
+	struct ttcanfd_frame msg[TTCAN_RX_RING_SIZE];
+	unsigned int head;	/* producer */
+	unsigned int tail;	/* consumer */
+	u32 overruns;		/* frames left in MRAM because ring was full */
 };
 
-struct ttcan_txevt_msg_list {
-	struct mttcan_tx_evt_element txevt;
-	struct list_head txevt_list;
+struct ttcan_txevt_ring {
+	struct mttcan_tx_evt_element txevt[TTCAN_RX_RING_SIZE];
+	unsigned int head;	/* producer */
+	unsigned int tail;	/* consumer */
+	u32 overruns;
 };
 
 struct ttcan_controller {
@@ -294,10 +299,10 @@ struct ttcan_controller {
 	struct ttcan_rxbuff_config rx_config;
 	struct ttcan_filter_config fltr_config;
 	struct ttcan_mram_elem mram_cfg[MRAM_ELEMS];
-	struct list_head rx_q0;
-	struct list_head rx_q1;
-	struct list_head rx_b;
-	struct list_head tx_evt;
+	struct ttcan_rx_ring rx_q0;
+	struct ttcan_rx_ring rx_q1;
+	struct ttcan_rx_ring rx_b;
+	struct ttcan_txevt_ring tx_evt;
 	void __iomem *base;	/* controller regs space should be remapped. */
 	void __iomem *xbase;    /* extra registers are mapped */
 	void __iomem *mram_vbase;
@@ -314,12 +319,6 @@ struct ttcan_controller {
 	u32 tdc_offset;
 	unsigned long tx_object;
 	unsigned long tx_obj_cancelled;
-	int rxq0_mem;
-	int rxq1_mem;
-	int rxb_mem;
-	int evt_mem;
-	u16 list_status;	/* bit 0: 1=Full; */
-	u16 resv0;
 };
 
 struct ttcan_ivc_msg {
@@ -463,6 +462,7 @@ void ttcan_tx_ded_msg_write(struct ttcan_controller *ttcan,
 			    struct ttcanfd_frame *ttcanfd,
 			    u8 index);
 void ttcan_tx_trigger_msg_transmit(struct ttcan_controller *ttcan, u8 index);
+void ttcan_tx_trigger_msgs_transmit(struct ttcan_controller *ttcan, u32 mask);
 int ttcan_tx_msg_buffer_write(struct ttcan_controller *ttcan,
 				struct ttcanfd_frame *ttcanfd);
 
@@ -561,14 +561,18 @@ int ttcan_set_tur_config(struct ttcan_controller *ttcan, u16 denominator,
 
 void ttcan_prog_trigger_mem(struct ttcan_controller *ttcan, void *tmc_shadow);
 
-/* list APIs */
+/* ring APIs */
 int add_msg_controller_list(struct ttcan_controller *ttcan,
-	struct ttcanfd_frame *ttcanfd, struct list_head *rx_q,
-	enum ttcan_rx_type rxtype);
+	struct ttcanfd_frame *ttcanfd, struct ttcan_rx_ring *rx_q);
+struct ttcanfd_frame *ttcan_rx_ring_peek(struct ttcan_rx_ring *rx_q);
+void ttcan_rx_ring_consume(struct ttcan_rx_ring *rx_q);
 
 int add_event_controller_list(struct ttcan_controller *ttcan,
 				struct mttcan_tx_evt_element *txevt,
-				struct list_head *evt_q);
+				struct ttcan_txevt_ring *evt_q);
+struct mttcan_tx_evt_element *ttcan_txevt_ring_peek(
+	struct ttcan_txevt_ring *evt_q);
+void ttcan_txevt_ring_consume(struct ttcan_txevt_ring *evt_q);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
 u64 ttcan_read_ts_cntr(const struct cyclecounter *ccnt);
 #else
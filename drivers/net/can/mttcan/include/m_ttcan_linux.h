@@ -87,6 +87,11 @@ struct can_gpio {
 	int active_low;
 };
 
+/* Tx latency histogram: [0] dedicated buffer first, [1] FIFO/queue first */
+#define MTTCAN_TX_LAT_CLASSES	2
+/* bucket n counts completions in [2^(n-1), 2^n) us, last one is open */
+#define MTTCAN_TX_LAT_BUCKETS	16
+
 struct mttcan_priv {
 	struct can_priv can;
 	struct ttcan_controller *ttcan;
@@ -129,6 +134,12 @@ struct mttcan_priv {
 	bool poll;
 	bool hwts_rx_en;
 	u32 resp;
+	u32 tx_pending_bar; /* Tx buffers written but not yet requested */
+	u32 tx_prio_id; /* IDs below this prefer dedicated Tx buffers */
+	bool tx_lat_en;
+	u8 tx_lat_class[MTT_CAN_TX_OBJ_NUM];
+	u64 tx_lat_start[MTT_CAN_TX_OBJ_NUM];
+	u32 tx_lat_hist[MTTCAN_TX_LAT_CLASSES][MTTCAN_TX_LAT_BUCKETS];
 };
 
 int mttcan_create_sys_files(struct device *dev);
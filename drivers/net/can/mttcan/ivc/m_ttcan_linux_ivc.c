@@ -67,54 +67,40 @@ static const struct of_device_id mttcan_of_table[] = {
 MODULE_DEVICE_TABLE(of, mttcan_of_table);
 
 static int mttcan_read_rcv_list(struct net_device *dev,
-				struct list_head *rcv)
+				struct ttcan_rx_ring *rcv)
 {
 	int rec_msgs = 0;
-	unsigned long flags;
-	struct mttcan_priv *priv = netdev_priv(dev);
-	struct ttcan_rx_msg_list *rx;
+	struct ttcanfd_frame *msg;
 	struct net_device_stats *stats = &dev->stats;
-	struct list_head *cur, *next, rx_q;
-
-	if (list_empty(rcv))
-		return 0;
-
-	INIT_LIST_HEAD(&rx_q);
-
-	spin_lock_irqsave(&priv->ttcan->lock, flags);
-	priv->ttcan->rxb_mem = 0;
-	priv->ttcan->list_status &= ~(BUFFER & 0xFF);
-	list_splice_init(rcv, &rx_q);
-	spin_unlock_irqrestore(&priv->ttcan->lock, flags);
 
-	list_for_each_safe(cur, next, &rx_q) {
+	while ((msg = ttcan_rx_ring_peek(rcv))) {
 		struct sk_buff *skb;
 		struct canfd_frame *fd_frame;
 		struct can_frame *frame;
-		list_del_init(cur);
 
-		rx = list_entry(cur, struct ttcan_rx_msg_list, recv_list);
-		if (rx->msg.flags & CAN_FD_FLAG) {
+		if (msg->flags & CAN_FD_FLAG) {
 			skb = alloc_canfd_skb(dev, &fd_frame);
 			if (!skb) {
 				stats->rx_dropped++;
-				return 0;
+				ttcan_rx_ring_consume(rcv);
+				continue;
 			}
-			memcpy(fd_frame, &rx->msg, sizeof(struct canfd_frame));
+			memcpy(fd_frame, msg, sizeof(struct canfd_frame));
 			stats->rx_bytes += fd_frame->len;
 		} else {
 			skb = alloc_can_skb(dev, &frame);
 			if (!skb) {
 				stats->rx_dropped++;
-				return 0;
+				ttcan_rx_ring_consume(rcv);
+				continue;
 			}
-			frame->can_id =  rx->msg.can_id;
-			frame->can_dlc = rx->msg.d_len;
-			memcpy(frame->data, &rx->msg.data, frame->can_dlc);
+			frame->can_id =  msg->can_id;
+			frame->can_dlc = msg->d_len;
+			memcpy(frame->data, &msg->data, frame->can_dlc);
 			stats->rx_bytes += frame->can_dlc;
 		}
 
-		kfree(rx);
+		ttcan_rx_ring_consume(rcv);
 		netif_receive_skb(skb);
 		stats->rx_packets++;
 		rec_msgs++;
@@ -349,7 +335,7 @@ static int process_rx_mesg_ivc(struct ttcan_controller *ttcan, u32 *addr)
 {
 	struct ttcanfd_frame ttcanfd;
 	ttcan_read_rx_msg_ram(ttcan, (u64)addr, &ttcanfd);
-	return add_msg_controller_list(ttcan, &ttcanfd, &ttcan->rx_b, BUFFER);
+	return add_msg_controller_list(ttcan, &ttcanfd, &ttcan->rx_b);
 }
 
 static void mttcan_ivc_rcv_msg(struct mbox_client *cl, void *mssg)
@@ -574,7 +560,6 @@ static int mttcan_probe(struct platform_device *pdev)
 	}
 	memset(priv->ttcan, 0, sizeof(struct ttcan_controller));
 	priv->ttcan->id = priv->instance;
-	INIT_LIST_HEAD(&priv->ttcan->rx_b);
 
 	platform_set_drvdata(pdev, dev);
 	SET_NETDEV_DEV(dev, &pdev->dev);
@@ -360,79 +360,53 @@ static int mttcan_hpm_do_receive(struct net_device *dev,
 }
 
 static int mttcan_read_rcv_list(struct net_device *dev,
-				struct list_head *rcv,
-				enum ttcan_rx_type rx_type,
-				int rec_msgs, int quota)
+				struct ttcan_rx_ring *rcv, int quota)
 {
-	unsigned int pushed;
-	unsigned long flags;
+	int pushed = 0;
 	struct mttcan_priv *priv = netdev_priv(dev);
-	struct ttcan_rx_msg_list *rx;
+	struct ttcanfd_frame *msg;
 	struct net_device_stats *stats = &dev->stats;
-	struct list_head *cur, *next, rx_q;
-
-	if (list_empty(rcv))
-		return 0;
-
-	INIT_LIST_HEAD(&rx_q);
-
-	spin_lock_irqsave(&priv->ttcan->lock, flags);
-	switch (rx_type) {
-	case BUFFER:
-		priv->ttcan->rxb_mem = 0;
-		priv->ttcan->list_status &= ~(BUFFER & 0xFF);
-		break;
-	case FIFO_0:
-		priv->ttcan->rxq0_mem = 0;
-		priv->ttcan->list_status &= ~(FIFO_0 & 0xFF);
-		break;
-	case FIFO_1:
-		priv->ttcan->rxq1_mem = 0;
-		priv->ttcan->list_status &= ~(FIFO_1 & 0xFF);
-	default:
-		break;
-	}
-	list_splice_init(rcv, &rx_q);
-	spin_unlock_irqrestore(&priv->ttcan->lock, flags);
 
-	pushed = rec_msgs;
-	list_for_each_safe(cur, next, &rx_q) {
+	while (pushed < quota) {
 		struct sk_buff *skb;
 		struct canfd_frame *fd_frame;
 		struct can_frame *frame;
-		if (!quota--)
+
+		msg = ttcan_rx_ring_peek(rcv);
+		if (!msg)
 			break;
-		list_del_init(cur);
+		pushed++;
 
-		rx = list_entry(cur, struct ttcan_rx_msg_list, recv_list);
-		if (rx->msg.flags & CAN_FD_FLAG) {
+		if (msg->flags & CAN_FD_FLAG) {
 			skb = alloc_canfd_skb(dev, &fd_frame);
 			if (!skb) {
-				stats->rx_dropped += pushed;
-				return 0;
+				stats->rx_dropped++;
+				ttcan_rx_ring_consume(rcv);
+				continue;
 			}
-			memcpy(fd_frame, &rx->msg, sizeof(struct canfd_frame));
+			memcpy(fd_frame, msg, sizeof(struct canfd_frame));
 			stats->rx_bytes += fd_frame->len;
 		} else {
 			skb = alloc_can_skb(dev, &frame);
 			if (!skb) {
-				stats->rx_dropped += pushed;
-				return 0;
+				stats->rx_dropped++;
+				ttcan_rx_ring_consume(rcv);
+				continue;
 			}
-			frame->can_id =  rx->msg.can_id;
-			frame->can_dlc = rx->msg.d_len;
-			memcpy(frame->data, &rx->msg.data, frame->can_dlc);
+			frame->can_id =  msg->can_id;
+			frame->can_dlc = msg->d_len;
+			memcpy(frame->data, &msg->data, frame->can_dlc);
 			stats->rx_bytes += frame->can_dlc;
 		}
 
 		if (priv->hwts_rx_en)
-			mttcan_rx_hwtstamp(priv, skb, &rx->msg);
-		kfree(rx);
+			mttcan_rx_hwtstamp(priv, skb, msg);
+		/* Slot can be reused once the frame is copied out */
+		ttcan_rx_ring_consume(rcv);
 		netif_receive_skb(skb);
 		stats->rx_packets++;
-		pushed--;
 	}
-	return rec_msgs - pushed;
+	return pushed;
 }
 
 static int mttcan_state_change(struct net_device *dev,
@@ -569,33 +543,13 @@ static int mttcan_handle_bus_err(struct net_device *dev,
 static void mttcan_tx_event(struct net_device *dev)
 {
 	struct mttcan_priv *priv = netdev_priv(dev);
-	struct ttcan_txevt_msg_list *evt;
-	struct list_head *cur, *next, evt_q;
+	struct mttcan_tx_evt_element *evt;
 	struct mttcan_tx_evt_element txevt;
 	u32 xtd, id;
-	unsigned long flags;
-
-	INIT_LIST_HEAD(&evt_q);
-
-	spin_lock_irqsave(&priv->ttcan->lock, flags);
 
-	if (list_empty(&priv->ttcan->tx_evt)) {
-		spin_unlock_irqrestore(&priv->ttcan->lock, flags);
-		return;
-	}
-
-	priv->ttcan->evt_mem = 0;
-	priv->ttcan->list_status &= ~(TX_EVT & 0xFF);
-	list_splice_init(&priv->ttcan->tx_evt, &evt_q);
-	spin_unlock_irqrestore(&priv->ttcan->lock, flags);
-
-	list_for_each_safe(cur, next, &evt_q) {
-		list_del_init(cur);
-
-		evt = list_entry(cur, struct ttcan_txevt_msg_list, txevt_list);
-		memcpy(&txevt, &evt->txevt,
-			sizeof(struct mttcan_tx_evt_element));
-		kfree(evt);
+	while ((evt = ttcan_txevt_ring_peek(&priv->ttcan->tx_evt))) {
+		memcpy(&txevt, evt, sizeof(struct mttcan_tx_evt_element));
+		ttcan_txevt_ring_consume(&priv->ttcan->tx_evt);
 		xtd = (txevt.f0 & MTT_TXEVT_ELE_F0_XTD_MASK) >>
 			MTT_TXEVT_ELE_F0_XTD_SHIFT;
 		id = (txevt.f0 & MTT_TXEVT_ELE_F0_ID_MASK) >>
@@ -612,6 +566,15 @@ static void mttcan_tx_event(struct net_device *dev)
 	}
 }
 
+static void mttcan_tx_lat_account(struct mttcan_priv *priv, int msg_no)
+{
+	u64 us = div_u64(ktime_get_ns() - priv->tx_lat_start[msg_no],
+			 NSEC_PER_USEC);
+	int bucket = us ? min_t(int, fls64(us), MTTCAN_TX_LAT_BUCKETS - 1) : 0;
+
+	priv->tx_lat_hist[priv->tx_lat_class[msg_no]][bucket]++;
+}
+
 static void mttcan_tx_complete(struct net_device *dev)
 {
 	struct mttcan_priv *priv = netdev_priv(dev);
@@ -628,6 +591,8 @@ static void mttcan_tx_complete(struct net_device *dev)
 
 	while (completed_tx) {
 		msg_no = ffs(completed_tx) - 1;
+		if (priv->tx_lat_en)
+			mttcan_tx_lat_account(priv, msg_no);
 		can_get_echo_skb(dev, msg_no);
 		can_led_event(dev, CAN_LED_EVENT_TX);
 		clear_bit(msg_no, &ttcan->tx_object);
@@ -679,7 +644,6 @@ static void mttcan_tx_cancelled(struct net_device *dev)
 static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 {
 	int work_done = 0;
-	int rec_msgs = 0;
 	struct net_device *dev = napi->dev;
 	struct mttcan_priv *priv = netdev_priv(dev);
 	u32 ir, ack, ttir, ttack, psr;
@@ -784,10 +748,9 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 		if (ir & MTT_IR_DRX_MASK) {
 			ack = MTT_IR_DRX_MASK;
 			ttcan_ir_write(priv->ttcan, ack);
-			rec_msgs = ttcan_read_rx_buffer(priv->ttcan);
+			ttcan_read_rx_buffer(priv->ttcan);
 			work_done +=
 			    mttcan_read_rcv_list(dev, &priv->ttcan->rx_b,
-						 BUFFER, rec_msgs,
 						 quota - work_done);
 			pr_debug("%s: buffer mesg received\n", __func__);
 
@@ -819,11 +782,10 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 					MTT_IR_RF1N_MASK);
 				ttcan_ir_write(priv->ttcan, ack);
 
-				rec_msgs = ttcan_read_rx_fifo1(priv->ttcan);
+				ttcan_read_rx_fifo1(priv->ttcan);
 				work_done +=
 				    mttcan_read_rcv_list(dev,
 							 &priv->ttcan->rx_q1,
-							 FIFO_1, rec_msgs,
 							 quota - work_done);
 				pr_debug("%s: msg received in Q1\n", __func__);
 			}
@@ -833,11 +795,10 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 					MTT_IR_RF0W_MASK |
 					MTT_IR_RF0N_MASK);
 				ttcan_ir_write(priv->ttcan, ack);
-				rec_msgs = ttcan_read_rx_fifo0(priv->ttcan);
+				ttcan_read_rx_fifo0(priv->ttcan);
 				work_done +=
 				    mttcan_read_rcv_list(dev,
 							 &priv->ttcan->rx_q0,
-							 FIFO_0, rec_msgs,
 							 quota - work_done);
 				pr_debug("%s: msg received in Q0\n", __func__);
 			}
@@ -1157,6 +1118,11 @@ static void mttcan_stop(struct mttcan_priv *priv)
 	priv->can.state = CAN_STATE_STOPPED;
 	priv->ttcan->proto_state = 0;
 
+	/* Drop requests collected by a start_xmit still running */
+	spin_lock_bh(&priv->tx_lock);
+	priv->tx_pending_bar = 0;
+	spin_unlock_bh(&priv->tx_lock);
+
 	ttcan_set_config_change_enable(priv->ttcan);
 }
 
@@ -1347,38 +1313,93 @@ static int mttcan_close(struct net_device *dev)
 	return 0;
 }
 
+/* Frames with an arbitration ID below tx_prio_id go to the dedicated Tx
+ * buffers first and the rest to the FIFO/queue first, so bulk traffic does
+ * not use up the buffers that urgent frames need. The controller arbitrates
+ * between all pending elements by ID. A tx_prio_id of 0 keeps the old
+ * buffers-first order for every frame.
+ */
+static bool mttcan_tx_prefer_buffer(struct mttcan_priv *priv,
+				    struct canfd_frame *frame)
+{
+	u32 id;
+
+	if (!priv->tx_prio_id)
+		return true;
+
+	if (frame->can_id & CAN_EFF_FLAG)
+		id = (frame->can_id & CAN_EFF_MASK) >> 18;
+	else
+		id = frame->can_id & CAN_SFF_MASK;
+
+	return id < priv->tx_prio_id;
+}
+
+static void mttcan_tx_flush(struct mttcan_priv *priv)
+{
+	if (priv->tx_pending_bar) {
+		ttcan_tx_trigger_msgs_transmit(priv->ttcan,
+					       priv->tx_pending_bar);
+		priv->tx_pending_bar = 0;
+	}
+}
+
 static netdev_tx_t mttcan_start_xmit(struct sk_buff *skb,
 				     struct net_device *dev)
 {
 	int msg_no = -1;
+	bool buffer_first, fifo = false, more;
 	struct mttcan_priv *priv = netdev_priv(dev);
 	struct canfd_frame *frame = (struct canfd_frame *)skb->data;
 
-	if (can_dropped_invalid_skb(dev, skb))
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+	more = netdev_xmit_more();
+#else
+	more = skb->xmit_more;
+#endif
+
+	if (can_dropped_invalid_skb(dev, skb)) {
+		/* Last frame of a batch, request what was collected so far */
+		if (!more) {
+			spin_lock_bh(&priv->tx_lock);
+			mttcan_tx_flush(priv);
+			spin_unlock_bh(&priv->tx_lock);
+		}
 		return NETDEV_TX_OK;
+	}
 
 	if (can_is_canfd_skb(skb))
 		frame->flags |= CAN_FD_FLAG;
 
+	buffer_first = mttcan_tx_prefer_buffer(priv, frame);
+
 	spin_lock_bh(&priv->tx_lock);
 
 	/* Write Tx message to controller */
-	msg_no = ttcan_tx_msg_buffer_write(priv->ttcan,
-			(struct ttcanfd_frame *)frame);
-	if (msg_no < 0)
+	if (buffer_first)
+		msg_no = ttcan_tx_msg_buffer_write(priv->ttcan,
+				(struct ttcanfd_frame *)frame);
+	if (msg_no < 0) {
 		msg_no = ttcan_tx_fifo_queue_msg(priv->ttcan,
 				(struct ttcanfd_frame *)frame);
+		fifo = msg_no >= 0;
+	}
+	if (msg_no < 0 && !buffer_first)
+		msg_no = ttcan_tx_msg_buffer_write(priv->ttcan,
+				(struct ttcanfd_frame *)frame);
 
 	if (msg_no < 0) {
+		mttcan_tx_flush(priv);
 		netif_stop_queue(dev);
 		spin_unlock_bh(&priv->tx_lock);
 		return NETDEV_TX_BUSY;
 	}
 	can_put_echo_skb(skb, dev, msg_no);
 
-	/* Set go bit for non-TTCAN messages */
-	if (!priv->tt_param[0])
-		ttcan_tx_trigger_msg_transmit(priv->ttcan, msg_no);
+	if (priv->tx_lat_en) {
+		priv->tx_lat_class[msg_no] = buffer_first ? 0 : 1;
+		priv->tx_lat_start[msg_no] = ktime_get_ns();
+	}
 
 	/* State management for Tx complete/cancel processing */
 	if (test_and_set_bit(msg_no, &priv->ttcan->tx_object) &&
@@ -1386,6 +1407,17 @@ static netdev_tx_t mttcan_start_xmit(struct sk_buff *skb,
 		netdev_err(dev, "Writing to occupied echo_skb buffer\n");
 	clear_bit(msg_no, &priv->ttcan->tx_obj_cancelled);
 
+	/* Set go bit for non-TTCAN messages. Dedicated buffers are collected
+	 * while the stack has more frames queued and requested with a single
+	 * TXBAR write. The FIFO put index only advances on the add request,
+	 * so a FIFO/queue element flushes straight away.
+	 */
+	if (!priv->tt_param[0]) {
+		priv->tx_pending_bar |= 1U << msg_no;
+		if (fifo || !more)
+			mttcan_tx_flush(priv);
+	}
+
 	spin_unlock_bh(&priv->tx_lock);
 
 	return NETDEV_TX_OK;
@@ -1832,10 +1864,6 @@ static int mttcan_probe(struct platform_device *pdev)
 	priv->ttcan->mram_size = mesg_ram->end - mesg_ram->start + 1;
 	priv->ttcan->id = priv->instance;
 	priv->ttcan->mram_vbase = mram_addr;
-	INIT_LIST_HEAD(&priv->ttcan->rx_q0);
-	INIT_LIST_HEAD(&priv->ttcan->rx_q1);
-	INIT_LIST_HEAD(&priv->ttcan->rx_b);
-	INIT_LIST_HEAD(&priv->ttcan->tx_evt);
 
 	platform_set_drvdata(pdev, dev);
 	SET_NETDEV_DEV(dev, &pdev->dev);
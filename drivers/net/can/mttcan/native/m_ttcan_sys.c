@@ -695,6 +695,86 @@ static ssize_t store_tdc_offset(struct device *dev,
 	return count;
 }
 
+static ssize_t show_rx_ring_overruns(struct device *dev,
+	struct device_attribute *devattr, char *buf)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+	struct ttcan_controller *ttcan = priv->ttcan;
+
+	return sprintf(buf, "rx_fifo0=%u\nrx_fifo1=%u\nrx_buffer=%u\n"
+		"tx_event=%u\n", READ_ONCE(ttcan->rx_q0.overruns),
+		READ_ONCE(ttcan->rx_q1.overruns),
+		READ_ONCE(ttcan->rx_b.overruns),
+		READ_ONCE(ttcan->tx_evt.overruns));
+}
+
+static ssize_t show_tx_prio_id(struct device *dev,
+	struct device_attribute *devattr, char *buf)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+
+	return sprintf(buf, "0x%x\n", priv->tx_prio_id);
+}
+
+static ssize_t store_tx_prio_id(struct device *dev,
+	struct device_attribute *devattr, const char *buf, size_t count)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+	unsigned int prio_id = 0;
+
+	if (kstrtouint(buf, 0, &prio_id) || prio_id > CAN_SFF_MASK + 1) {
+		dev_err(dev, "wrong tx_prio_id\n");
+		return -EINVAL;
+	}
+
+	WRITE_ONCE(priv->tx_prio_id, prio_id);
+
+	return count;
+}
+
+static ssize_t show_tx_latency(struct device *dev,
+	struct device_attribute *devattr, char *buf)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+	ssize_t ret;
+	int i;
+
+	ret = sprintf(buf, "enabled=%d\n<us\tbuffer\tfifo\n",
+		      priv->tx_lat_en);
+	for (i = 0; i < MTTCAN_TX_LAT_BUCKETS; i++) {
+		if (i == MTTCAN_TX_LAT_BUCKETS - 1)
+			ret += sprintf(buf + ret, "inf");
+		else
+			ret += sprintf(buf + ret, "%u", 1U << i);
+		ret += sprintf(buf + ret, "\t%u\t%u\n",
+			       READ_ONCE(priv->tx_lat_hist[0][i]),
+			       READ_ONCE(priv->tx_lat_hist[1][i]));
+	}
+
+	return ret;
+}
+
+static ssize_t store_tx_latency(struct device *dev,
+	struct device_attribute *devattr, const char *buf, size_t count)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+	bool enable;
+
+	if (kstrtobool(buf, &enable)) {
+		dev_err(dev, "wrong tx_latency, expect 0/1\n");
+		return -EINVAL;
+	}
+
+	/* writing either value clears the histogram */
+	spin_lock_bh(&priv->tx_lock);
+	priv->tx_lat_en = false;
+	memset(priv->tx_lat_hist, 0, sizeof(priv->tx_lat_hist));
+	priv->tx_lat_en = enable;
+	spin_unlock_bh(&priv->tx_lock);
+
+	return count;
+}
+
 static DEVICE_ATTR(std_filter, S_IRUGO | S_IWUSR, show_std_fltr,
 	store_std_fltr);
 static DEVICE_ATTR(xtd_filter, S_IRUGO | S_IWUSR, show_xtd_fltr,
@@ -715,6 +795,11 @@ static DEVICE_ATTR(trigger_mem, S_IRUGO | S_IWUSR, show_trigger_mem,
 		store_trigger_mem);
 static DEVICE_ATTR(tdc_offset, S_IRUGO | S_IWUSR, show_tdc_offset,
 		store_tdc_offset);
+static DEVICE_ATTR(rx_ring_overruns, S_IRUGO, show_rx_ring_overruns, NULL);
+static DEVICE_ATTR(tx_prio_id, S_IRUGO | S_IWUSR, show_tx_prio_id,
+	store_tx_prio_id);
+static DEVICE_ATTR(tx_latency, S_IRUGO | S_IWUSR, show_tx_latency,
+	store_tx_latency);
 
 static struct attribute *mttcan_attr[] = {
 	&dev_attr_std_filter.attr,
@@ -730,6 +815,9 @@ static struct attribute *mttcan_attr[] = {
 	&dev_attr_cccr_init_txbar.attr,
 	&dev_attr_trigger_mem.attr,
 	&dev_attr_tdc_offset.attr,
+	&dev_attr_rx_ring_overruns.attr,
+	&dev_attr_tx_prio_id.attr,
+	&dev_attr_tx_latency.attr,
 	NULL
 };
 
@@ -18,9 +18,34 @@
 #include <linux/pci.h>
 #include <linux/tegra_vnet.h>
 
+struct tvnet_priv;
+
+/* Data queue pair, Tx uses EP DMA read channel of same index */
+struct tvnet_queue {
+	struct tvnet_priv *tvnet;
+	struct napi_struct napi;
+	u32 idx;
+	u32 dma_ch;
+	/* Only data msg rings and counters are used, ctrl ones are in priv */
+	struct ep_ring_buf ep_mem;
+	struct host_ring_buf host_mem;
+	struct list_head ep2h_empty_list;
+	/* To protect ep2h empty list */
+	spinlock_t ep2h_empty_lock;
+	struct tvnet_dma_desc *dma_desc;
+	struct dma_desc_cnt desc_cnt;
+	/* Tx packets queued to DMA, doorbell rung once per batch */
+	struct tvnet_tx_buf tx_pending[TVNET_TX_BATCH];
+	u32 tx_pending_cnt;
+
+	struct tvnet_counter h2ep_empty;
+	struct tvnet_counter h2ep_full;
+	struct tvnet_counter ep2h_empty;
+	struct tvnet_counter ep2h_full;
+};
+
 struct tvnet_priv {
 	struct net_device *ndev;
-	struct napi_struct napi;
 	struct pci_dev *pdev;
 	void __iomem *mmio_base;
 	void __iomem *msix_tbl;
@@ -28,13 +53,10 @@ struct tvnet_priv {
 	struct bar_md *bar_md;
 	struct ep_ring_buf ep_mem;
 	struct host_ring_buf host_mem;
-	struct list_head ep2h_empty_list;
-	/* To protect ep2h empty list */
-	spinlock_t ep2h_empty_lock;
-	struct tvnet_dma_desc *dma_desc;
-#if ENABLE_DMA
-	struct dma_desc_cnt desc_cnt;
-#endif
+	/* EP exposes version 2 bar_md fields */
+	bool ep_v2;
+	u32 num_queues;
+	struct tvnet_queue queues[TVNET_MAX_QUEUES];
 	enum dir_link_state tx_link_state;
 	enum dir_link_state rx_link_state;
 	enum os_link_state os_link_state;
@@ -48,17 +70,12 @@ struct tvnet_priv {
 
 	struct tvnet_counter h2ep_ctrl;
 	struct tvnet_counter ep2h_ctrl;
-	struct tvnet_counter h2ep_empty;
-	struct tvnet_counter h2ep_full;
-	struct tvnet_counter ep2h_empty;
-	struct tvnet_counter ep2h_full;
 };
 
-#if ENABLE_DMA
 /* Program MSI settings in EP DMA for interrupts from EP DMA */
 static void tvnet_host_write_dma_msix_settings(struct tvnet_priv *tvnet)
 {
-	u32 val;
+	u32 val, ch;
 	u16 val16;
 
 	val = readl(tvnet->msix_tbl + PCI_MSIX_ENTRY_LOWER_ADDR);
@@ -69,10 +86,12 @@ static void tvnet_host_write_dma_msix_settings(struct tvnet_priv *tvnet)
 	dma_common_wr(tvnet->dma_base, val, DMA_READ_DONE_IMWR_HIGH_OFF);
 	dma_common_wr(tvnet->dma_base, val, DMA_READ_ABORT_IMWR_HIGH_OFF);
 
+	/* IMWR data is 16 bits per read channel */
 	val16 = readw(tvnet->msix_tbl + PCI_MSIX_ENTRY_DATA);
-	dma_common_wr16(tvnet->dma_base, val16, DMA_READ_IMWR_DATA_OFF_BASE);
+	for (ch = 0; ch < DMA_RD_CHNL_NUM; ch++)
+		dma_common_wr16(tvnet->dma_base, val16,
+				DMA_READ_IMWR_DATA_OFF_BASE + (ch * 2));
 }
-#endif
 
 static void tvnet_host_raise_ep_ctrl_irq(struct tvnet_priv *tvnet)
 {
@@ -150,19 +169,20 @@ static int tvnet_host_write_ctrl_msg(struct tvnet_priv *tvnet,
 	return 0;
 }
 
-static void tvnet_host_alloc_empty_buffers(struct tvnet_priv *tvnet)
+static void tvnet_host_alloc_empty_buffers(struct tvnet_queue *q)
 {
+	struct tvnet_priv *tvnet = q->tvnet;
 	struct net_device *ndev = tvnet->ndev;
-	struct host_ring_buf *host_mem = &tvnet->host_mem;
+	struct host_ring_buf *host_mem = &q->host_mem;
 	struct data_msg *ep2h_empty_msg = host_mem->ep2h_empty_msgs;
 	struct ep2h_empty_list *ep2h_empty_ptr;
 	struct device *d = &tvnet->pdev->dev;
 	unsigned long flags;
 
-	while (!tvnet_ivc_full(&tvnet->ep2h_empty)) {
+	while (!tvnet_ivc_full(&q->ep2h_empty)) {
 		struct sk_buff *skb;
 		dma_addr_t iova;
-		int len = ndev->mtu + ETH_HLEN;
+		int len = TVNET_RX_BUF_LEN(ndev->mtu);
 		u32 idx;
 
 		skb = netdev_alloc_skb(ndev, len);
@@ -186,11 +206,11 @@ static void tvnet_host_alloc_empty_buffers(struct tvnet_priv *tvnet)
 		ep2h_empty_ptr->skb = skb;
 		ep2h_empty_ptr->iova = iova;
 		ep2h_empty_ptr->len = len;
-		spin_lock_irqsave(&tvnet->ep2h_empty_lock, flags);
-		list_add_tail(&ep2h_empty_ptr->list, &tvnet->ep2h_empty_list);
-		spin_unlock_irqrestore(&tvnet->ep2h_empty_lock, flags);
+		spin_lock_irqsave(&q->ep2h_empty_lock, flags);
+		list_add_tail(&ep2h_empty_ptr->list, &q->ep2h_empty_list);
+		spin_unlock_irqrestore(&q->ep2h_empty_lock, flags);
 
-		idx = tvnet_ivc_get_wr_cnt(&tvnet->ep2h_empty) %
+		idx = tvnet_ivc_get_wr_cnt(&q->ep2h_empty) %
 					RING_COUNT;
 		ep2h_empty_msg[idx].u.empty_buffer.pcie_address = iova;
 		ep2h_empty_msg[idx].u.empty_buffer.buffer_len = len;
@@ -198,20 +218,20 @@ static void tvnet_host_alloc_empty_buffers(struct tvnet_priv *tvnet)
 		 * buffers are updated before updating counters.
 		 */
 		mb();
-		tvnet_ivc_advance_wr(&tvnet->ep2h_empty);
+		tvnet_ivc_advance_wr(&q->ep2h_empty);
 
 		tvnet_host_raise_ep_ctrl_irq(tvnet);
 	}
 }
 
-static void tvnet_host_free_empty_buffers(struct tvnet_priv *tvnet)
+static void tvnet_host_free_empty_buffers(struct tvnet_queue *q)
 {
 	struct ep2h_empty_list *ep2h_empty_ptr, *temp;
-	struct device *d = &tvnet->pdev->dev;
+	struct device *d = &q->tvnet->pdev->dev;
 	unsigned long flags;
 
-	spin_lock_irqsave(&tvnet->ep2h_empty_lock, flags);
-	list_for_each_entry_safe(ep2h_empty_ptr, temp, &tvnet->ep2h_empty_list,
+	spin_lock_irqsave(&q->ep2h_empty_lock, flags);
+	list_for_each_entry_safe(ep2h_empty_ptr, temp, &q->ep2h_empty_list,
 				 list) {
 		list_del(&ep2h_empty_ptr->list);
 		dma_unmap_single(d, ep2h_empty_ptr->iova, ep2h_empty_ptr->len,
@@ -219,14 +239,14 @@ static void tvnet_host_free_empty_buffers(struct tvnet_priv *tvnet)
 		dev_kfree_skb_any(ep2h_empty_ptr->skb);
 		kfree(ep2h_empty_ptr);
 	}
-	spin_unlock_irqrestore(&tvnet->ep2h_empty_lock, flags);
+	spin_unlock_irqrestore(&q->ep2h_empty_lock, flags);
 }
 
 static void tvnet_host_stop_tx_queue(struct tvnet_priv *tvnet)
 {
 	struct net_device *ndev = tvnet->ndev;
 
-	netif_stop_queue(ndev);
+	netif_tx_stop_all_queues(ndev);
 	/* Get tx lock to make sure that there is no ongoing xmit */
 	netif_tx_lock(ndev);
 	netif_tx_unlock(ndev);
@@ -240,26 +260,30 @@ static void tvnet_host_stop_rx_work(struct tvnet_priv *tvnet)
 
 static void tvnet_host_clear_data_msg_counters(struct tvnet_priv *tvnet)
 {
-	struct host_ring_buf *host_mem = &tvnet->host_mem;
-	struct host_own_cnt *host_cnt = host_mem->host_cnt;
-	struct ep_ring_buf *ep_mem = &tvnet->ep_mem;
-	struct ep_own_cnt *ep_cnt = ep_mem->ep_cnt;
-
-	host_cnt->ep2h_empty_wr_cnt = 0;
-	ep_cnt->ep2h_empty_rd_cnt = 0;
-	host_cnt->h2ep_full_wr_cnt = 0;
-	ep_cnt->h2ep_full_rd_cnt = 0;
+	struct host_own_cnt *host_cnt;
+	struct ep_own_cnt *ep_cnt;
+	u32 i;
+
+	for (i = 0; i < tvnet->num_queues; i++) {
+		host_cnt = tvnet->queues[i].host_mem.host_cnt;
+		ep_cnt = tvnet->queues[i].ep_mem.ep_cnt;
+
+		host_cnt->ep2h_empty_wr_cnt = 0;
+		ep_cnt->ep2h_empty_rd_cnt = 0;
+		host_cnt->h2ep_full_wr_cnt = 0;
+		ep_cnt->h2ep_full_rd_cnt = 0;
+	}
 }
 
 static void tvnet_host_update_link_state(struct net_device *ndev,
 					 enum os_link_state state)
 {
 	if (state == OS_LINK_STATE_UP) {
-		netif_start_queue(ndev);
+		netif_tx_start_all_queues(ndev);
 		netif_carrier_on(ndev);
 	} else if (state == OS_LINK_STATE_DOWN) {
 		netif_carrier_off(ndev);
-		netif_stop_queue(ndev);
+		netif_tx_stop_all_queues(ndev);
 	} else {
 		pr_err("%s: invalid sate: %d\n", __func__, state);
 	}
@@ -285,9 +309,17 @@ static void tvnet_host_update_link_sm(struct tvnet_priv *tvnet)
 static void tvnet_host_user_link_up_req(struct tvnet_priv *tvnet)
 {
 	struct ctrl_msg msg;
+	u32 i;
 
 	tvnet_host_clear_data_msg_counters(tvnet);
-	tvnet_host_alloc_empty_buffers(tvnet);
+	for (i = 0; i < tvnet->num_queues; i++)
+		tvnet_host_alloc_empty_buffers(&tvnet->queues[i]);
+	/* EP picks up the queue count when it gets CTRL_MSG_LINK_UP */
+	if (tvnet->ep_v2) {
+		WRITE_ONCE(tvnet->bar_md->host_num_queues, tvnet->num_queues);
+		mb();
+	}
+	memset(&msg, 0, sizeof(msg));
 	msg.msg_id = CTRL_MSG_LINK_UP;
 	tvnet_host_write_ctrl_msg(tvnet, &msg);
 	tvnet->rx_link_state = DIR_LINK_STATE_UP;
@@ -299,6 +331,7 @@ static void tvnet_host_user_link_down_req(struct tvnet_priv *tvnet)
 	struct ctrl_msg msg;
 
 	tvnet->rx_link_state = DIR_LINK_STATE_SENT_DOWN;
+	memset(&msg, 0, sizeof(msg));
 	msg.msg_id = CTRL_MSG_LINK_DOWN;
 	tvnet_host_write_ctrl_msg(tvnet, &msg);
 	tvnet_host_update_link_sm(tvnet);
@@ -316,6 +349,7 @@ static void tvnet_host_rcv_link_down_msg(struct tvnet_priv *tvnet)
 
 	/* Stop using empty buffers of remote system */
 	tvnet_host_stop_tx_queue(tvnet);
+	memset(&msg, 0, sizeof(msg));
 	msg.msg_id = CTRL_MSG_LINK_DOWN_ACK;
 	tvnet_host_write_ctrl_msg(tvnet, &msg);
 	tvnet->tx_link_state = DIR_LINK_STATE_DOWN;
@@ -324,9 +358,12 @@ static void tvnet_host_rcv_link_down_msg(struct tvnet_priv *tvnet)
 
 static void tvnet_host_rcv_link_down_ack(struct tvnet_priv *tvnet)
 {
+	u32 i;
+
 	/* Stop using empty buffers(which are full in rx) of local system */
 	tvnet_host_stop_rx_work(tvnet);
-	tvnet_host_free_empty_buffers(tvnet);
+	for (i = 0; i < tvnet->num_queues; i++)
+		tvnet_host_free_empty_buffers(&tvnet->queues[i]);
 	tvnet->rx_link_state = DIR_LINK_STATE_DOWN;
 	wake_up_interruptible(&tvnet->link_state_wq);
 	tvnet_host_update_link_sm(tvnet);
@@ -335,11 +372,13 @@ static void tvnet_host_rcv_link_down_ack(struct tvnet_priv *tvnet)
 static int tvnet_host_open(struct net_device *ndev)
 {
 	struct tvnet_priv *tvnet = netdev_priv(ndev);
+	u32 i;
 
 	mutex_lock(&tvnet->link_state_lock);
 	if (tvnet->rx_link_state == DIR_LINK_STATE_DOWN)
 		tvnet_host_user_link_up_req(tvnet);
-	napi_enable(&tvnet->napi);
+	for (i = 0; i < tvnet->num_queues; i++)
+		napi_enable(&tvnet->queues[i].napi);
 	mutex_unlock(&tvnet->link_state_lock);
 
 	return 0;
@@ -349,9 +388,11 @@ static int tvnet_host_close(struct net_device *ndev)
 {
 	struct tvnet_priv *tvnet = netdev_priv(ndev);
 	int ret = 0;
+	u32 i;
 
 	mutex_lock(&tvnet->link_state_lock);
-	napi_disable(&tvnet->napi);
+	for (i = 0; i < tvnet->num_queues; i++)
+		napi_disable(&tvnet->queues[i].napi);
 	if (tvnet->rx_link_state == DIR_LINK_STATE_UP)
 		tvnet_host_user_link_down_req(tvnet);
 
@@ -395,163 +436,219 @@ static int tvnet_host_change_mtu(struct net_device *ndev, int new_mtu)
 	return 0;
 }
 
+/*
+ * Ring EP DMA read doorbell once for all queued packets, wait for the batch
+ * to complete and push them to H2EP full ring.
+ */
+static void tvnet_host_tx_flush(struct tvnet_queue *q)
+{
+	struct tvnet_priv *tvnet = q->tvnet;
+	struct host_ring_buf *host_mem = &q->host_mem;
+	struct data_msg *h2ep_full_msg = host_mem->h2ep_full_msgs;
+	struct device *d = &tvnet->pdev->dev;
+	struct tvnet_dma_desc *dma_desc = q->dma_desc;
+	struct dma_desc_cnt *desc_cnt = &q->desc_cnt;
+	struct tvnet_tx_buf *tx_buf;
+	unsigned long timeout;
+	bool dma_err = false;
+	u32 i, val, wr_idx, ctrl_d, desc_idx;
+
+	if (!q->tx_pending_cnt)
+		return;
+
+	/* Let EP populate H2EP_EMPTY_BUF ring consumed by this batch */
+	tvnet_host_raise_ep_ctrl_irq(tvnet);
+
+	/* Only last desc of the batch raises done irq */
+	desc_idx = (desc_cnt->wr_cnt - 1) % DMA_DESC_COUNT;
+	ctrl_d = DMA_CH_CONTROL1_OFF_RDCH_RIE;
+	ctrl_d |= DMA_CH_CONTROL1_OFF_RDCH_LIE;
+	ctrl_d |= DMA_CH_CONTROL1_OFF_RDCH_CB;
+	dma_desc[desc_idx].ctrl_reg.ctrl_d = ctrl_d;
+	/*
+	 * Read after write to avoid EP DMA reading LLE before CB is written to
+	 * EP's system memory.
+	 */
+	ctrl_d = dma_desc[desc_idx].ctrl_reg.ctrl_d;
+
+	/* DMA write should not go out of order wrt CB bit set */
+	mb();
+
+	timeout = jiffies + msecs_to_jiffies(1000);
+	dma_common_wr(tvnet->dma_base, q->dma_ch, DMA_READ_DOORBELL_OFF);
+
+	/* Other queues share the status register, only touch own bits */
+	while (true) {
+		val = dma_common_rd(tvnet->dma_base, DMA_READ_INT_STATUS_OFF);
+		if (val & DMA_INT_DONE(q->dma_ch)) {
+			dma_common_wr(tvnet->dma_base, DMA_INT_DONE(q->dma_ch),
+				      DMA_READ_INT_CLEAR_OFF);
+			break;
+		}
+		if ((val & DMA_INT_ABORT(q->dma_ch)) ||
+		    time_after(jiffies, timeout)) {
+			pr_err("dma ch %u failed: 0x%x, stop channel\n",
+			       q->dma_ch, val);
+			dma_common_wr(tvnet->dma_base,
+				      DMA_READ_DOORBELL_OFF_RD_STOP | q->dma_ch,
+				      DMA_READ_DOORBELL_OFF);
+			dma_common_wr(tvnet->dma_base,
+				      DMA_INT_DONE(q->dma_ch) |
+				      DMA_INT_ABORT(q->dma_ch),
+				      DMA_READ_INT_CLEAR_OFF);
+			dma_err = true;
+			break;
+		}
+	}
+
+	/* Clear DMA cycle bit of all descs in the batch */
+	for (i = desc_cnt->rd_cnt; i != desc_cnt->wr_cnt; i++)
+		dma_desc[i % DMA_DESC_COUNT].ctrl_reg.ctrl_d = 0;
+	mb();
+
+	/* On error reuse the same descs, engine restarts from there */
+	if (dma_err)
+		desc_cnt->wr_cnt = desc_cnt->rd_cnt;
+	else
+		desc_cnt->rd_cnt = desc_cnt->wr_cnt;
+
+	for (i = 0; i < q->tx_pending_cnt; i++) {
+		tx_buf = &q->tx_pending[i];
+		if (!dma_err) {
+			/* Push dst to H2EP full ring */
+			wr_idx = tvnet_ivc_get_wr_cnt(&q->h2ep_full) %
+						RING_COUNT;
+			h2ep_full_msg[wr_idx].u.full_buffer.packet_size =
+							tx_buf->skb->len;
+			tvnet_full_msg_set_gso(&h2ep_full_msg[wr_idx],
+					       tx_buf->skb);
+			h2ep_full_msg[wr_idx].u.full_buffer.pcie_address =
+							tx_buf->dst_iova;
+			h2ep_full_msg[wr_idx].msg_id = DATA_MSG_FULL_BUF;
+			/* BAR0 mmio address is wc mem, add mb to make sure that
+			 * full buffer is written before updating counters.
+			 */
+			mb();
+			tvnet_ivc_advance_wr(&q->h2ep_full);
+		}
+
+		/* Free skb */
+		tvnet_tx_buf_unmap(d, tx_buf);
+		dev_kfree_skb_any(tx_buf->skb);
+		tx_buf->skb = NULL;
+	}
+	q->tx_pending_cnt = 0;
+
+	if (!dma_err)
+		tvnet_host_raise_ep_data_irq(tvnet);
+}
+
 static netdev_tx_t tvnet_host_start_xmit(struct sk_buff *skb,
 					 struct net_device *ndev)
 {
 	struct tvnet_priv *tvnet = netdev_priv(ndev);
-	struct host_ring_buf *host_mem = &tvnet->host_mem;
-	struct data_msg *h2ep_full_msg = host_mem->h2ep_full_msgs;
-	struct skb_shared_info *info = skb_shinfo(skb);
-	struct ep_ring_buf *ep_mem = &tvnet->ep_mem;
+	struct tvnet_queue *q = &tvnet->queues[skb_get_queue_mapping(skb)];
+	struct ep_ring_buf *ep_mem = &q->ep_mem;
 	struct data_msg *h2ep_empty_msg = ep_mem->h2ep_empty_msgs;
 	struct device *d = &tvnet->pdev->dev;
-#if ENABLE_DMA
-	struct tvnet_dma_desc *dma_desc = tvnet->dma_desc;
-	struct dma_desc_cnt *desc_cnt = &tvnet->desc_cnt;
-	u32 desc_widx, desc_ridx, val;
-	u32 ctrl_d;
-	unsigned long timeout;
-#endif
-	dma_addr_t src_iova;
+	struct tvnet_dma_desc *dma_desc = q->dma_desc;
+	struct dma_desc_cnt *desc_cnt = &q->desc_cnt;
+	struct tvnet_tx_buf *tx_buf;
+	bool xmit_more = tvnet_xmit_more(skb);
+	u32 desc_widx, nr_segs, i, ctrl_d;
+	u64 dst_off;
 	dma_addr_t dst_iova;
-	u32 rd_idx;
-	u32 wr_idx;
-	void *dst_virt;
+	u32 rd_idx, dst_len;
 	int len;
 
-	/* TODO Not expecting skb frags, remove this after testing */
-	WARN_ON(info->nr_frags);
+	nr_segs = skb_shinfo(skb)->nr_frags + 1;
+
+	/* Make room in H2EP full ring and DMA ring for this packet */
+	if (q->tx_pending_cnt &&
+	    ((tvnet_ivc_wr_available(&q->h2ep_full) <= q->tx_pending_cnt) ||
+	     ((desc_cnt->wr_cnt - desc_cnt->rd_cnt + nr_segs) > DMA_DESC_COUNT)))
+		tvnet_host_tx_flush(q);
 
 	/* Check if H2EP_EMPTY_BUF available to read */
-	if (!tvnet_ivc_rd_available(&tvnet->h2ep_empty)) {
+	if (!tvnet_ivc_rd_available(&q->h2ep_empty)) {
 		tvnet_host_raise_ep_ctrl_irq(tvnet);
 		pr_debug("%s: No H2EP empty msg, stop tx\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
+		goto stop_queue;
 	}
 
 	/* Check if H2EP_FULL_BUF available to write */
-	if (tvnet_ivc_full(&tvnet->h2ep_full)) {
+	if (tvnet_ivc_full(&q->h2ep_full)) {
 		tvnet_host_raise_ep_ctrl_irq(tvnet);
 		pr_debug("%s: No H2EP full buf, stop tx\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
+		goto stop_queue;
 	}
 
-#if ENABLE_DMA
 	/* Check if dma desc available */
-	if ((desc_cnt->wr_cnt - desc_cnt->rd_cnt) >= DMA_DESC_COUNT) {
+	if ((desc_cnt->wr_cnt - desc_cnt->rd_cnt + nr_segs) > DMA_DESC_COUNT) {
 		pr_debug("%s: dma descriptors are not available\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
+		goto stop_queue;
 	}
-#endif
-
-	len = skb_headlen(skb);
 
-	src_iova = dma_map_single(d, skb->data, len, DMA_TO_DEVICE);
-	if (dma_mapping_error(d, src_iova)) {
-		pr_err("%s: dma_map_single failed\n", __func__);
+	tx_buf = &q->tx_pending[q->tx_pending_cnt];
+	if (tvnet_tx_buf_map(d, skb, tx_buf)) {
+		pr_err("%s: skb dma map failed\n", __func__);
 		dev_kfree_skb_any(skb);
-		return NETDEV_TX_OK;
+		goto out;
 	}
+	len = skb->len;
 
 	/* Get H2EP empty msg */
-	rd_idx = tvnet_ivc_get_rd_cnt(&tvnet->h2ep_empty) %
+	rd_idx = tvnet_ivc_get_rd_cnt(&q->h2ep_empty) %
 				RING_COUNT;
 	dst_iova = h2ep_empty_msg[rd_idx].u.empty_buffer.pcie_address;
-	dst_virt = (__force void *)tvnet->mmio_base + (dst_iova - tvnet->bar_md->bar0_base_phy);
+	dst_len = h2ep_empty_msg[rd_idx].u.empty_buffer.buffer_len;
+
+	/* Drop frames EP buffer can't hold, keep the buffer for later ones */
+	if (len > dst_len) {
+		dev_err(d, "%s: pkt len %d > EP buf len %u\n", __func__,
+			len, dst_len);
+		tvnet_tx_buf_unmap(d, tx_buf);
+		dev_kfree_skb_any(skb);
+		goto out;
+	}
 	/* Advance read count after all failure cases complated, to avoid
 	 * dangling buffer at endpoint.
 	 */
-	tvnet_ivc_advance_rd(&tvnet->h2ep_empty);
-	/* Raise an interrupt to let EP populate H2EP_EMPTY_BUF ring */
-	tvnet_host_raise_ep_ctrl_irq(tvnet);
+	tvnet_ivc_advance_rd(&q->h2ep_empty);
 
-#if ENABLE_DMA
-	/* Trigger DMA write from src_iova to dst_iova */
-	desc_widx = desc_cnt->wr_cnt % DMA_DESC_COUNT;
-	dma_desc[desc_widx].size = len;
-	dma_desc[desc_widx].sar_low = lower_32_bits(src_iova);
-	dma_desc[desc_widx].sar_high = upper_32_bits(src_iova);
-	dma_desc[desc_widx].dar_low = lower_32_bits(dst_iova);
-	dma_desc[desc_widx].dar_high = upper_32_bits(dst_iova);
-	/* CB bit should be set at the end */
-	mb();
-	/* RIE is not required for polling mode */
-	ctrl_d = DMA_CH_CONTROL1_OFF_RDCH_RIE;
-	ctrl_d |= DMA_CH_CONTROL1_OFF_RDCH_LIE;
-	ctrl_d |= DMA_CH_CONTROL1_OFF_RDCH_CB;
-	dma_desc[desc_widx].ctrl_reg.ctrl_d = ctrl_d;
 	/*
-	 * Read after write to avoid EP DMA reading LLE before CB is written to
-	 * EP's system memory.
+	 * Queue EP DMA read of each skb segment straight into EP buffer.
+	 * Engine is idle until doorbell, so CB can be set per desc here.
 	 */
-	ctrl_d = dma_desc[desc_widx].ctrl_reg.ctrl_d;
-
-	/* DMA write should not go out of order wrt CB bit set */
-	mb();
-
-	timeout = jiffies + msecs_to_jiffies(1000);
-	dma_common_wr(tvnet->dma_base, DMA_RD_DATA_CH, DMA_READ_DOORBELL_OFF);
-
-	desc_cnt->wr_cnt++;
-
-	while (true) {
-		val = dma_common_rd(tvnet->dma_base, DMA_READ_INT_STATUS_OFF);
-		if (val == BIT(DMA_RD_DATA_CH)) {
-			dma_common_wr(tvnet->dma_base, val,
-				      DMA_READ_INT_CLEAR_OFF);
-			break;
-		}
-		if (time_after(jiffies, timeout)) {
-			pr_err("dma took more time, reset dma engine\n");
-			dma_common_wr(tvnet->dma_base,
-				      DMA_READ_ENGINE_EN_OFF_DISABLE,
-				      DMA_READ_ENGINE_EN_OFF);
-			mdelay(1);
-			dma_common_wr(tvnet->dma_base,
-				      DMA_READ_ENGINE_EN_OFF_ENABLE,
-				      DMA_READ_ENGINE_EN_OFF);
-			desc_cnt->wr_cnt--;
-			dma_unmap_single(d, src_iova, len, DMA_TO_DEVICE);
-			return NETDEV_TX_BUSY;
-		}
+	dst_off = 0;
+	for (i = 0; i < tx_buf->nr_segs; i++) {
+		desc_widx = desc_cnt->wr_cnt % DMA_DESC_COUNT;
+		dma_desc[desc_widx].size = tx_buf->len[i];
+		dma_desc[desc_widx].sar_low = lower_32_bits(tx_buf->iova[i]);
+		dma_desc[desc_widx].sar_high = upper_32_bits(tx_buf->iova[i]);
+		dma_desc[desc_widx].dar_low = lower_32_bits(dst_iova + dst_off);
+		dma_desc[desc_widx].dar_high = upper_32_bits(dst_iova + dst_off);
+		/* CB bit should be set at the end */
+		mb();
+		ctrl_d = DMA_CH_CONTROL1_OFF_RDCH_CB;
+		dma_desc[desc_widx].ctrl_reg.ctrl_d = ctrl_d;
+		dst_off += tx_buf->len[i];
+		desc_cnt->wr_cnt++;
 	}
+	tx_buf->dst_iova = dst_iova;
+	q->tx_pending_cnt++;
 
-	desc_ridx = tvnet->desc_cnt.rd_cnt % DMA_DESC_COUNT;
-	/* Clear DMA cycle bit and increment rd_cnt */
-	dma_desc[desc_ridx].ctrl_reg.ctrl_e.cb = 0;
-	mb();
-
-	tvnet->desc_cnt.rd_cnt++;
-#else
-	/* Copy skb->data to endpoint dst address, use CPU virt addr */
-	memcpy(dst_virt, skb->data, len);
-	/* BAR0 mmio address is wc mem, add mb to make sure that complete
-	 * skb->data is written before updating counters.
-	 */
-	mb();
-#endif
-
-	/* Push dst to H2EP full ring */
-	wr_idx = tvnet_ivc_get_wr_cnt(&tvnet->h2ep_full) %
-				RING_COUNT;
-	h2ep_full_msg[wr_idx].u.full_buffer.packet_size = len;
-	h2ep_full_msg[wr_idx].u.full_buffer.pcie_address = dst_iova;
-	h2ep_full_msg[wr_idx].msg_id = DATA_MSG_FULL_BUF;
-	/* BAR0 mmio address is wc mem, add mb to make sure that full
-	 * buffer is written before updating counters.
-	 */
-	mb();
-	tvnet_ivc_advance_wr(&tvnet->h2ep_full);
-	tvnet_host_raise_ep_data_irq(tvnet);
-
-	/* Free skb */
-	dma_unmap_single(d, src_iova, len, DMA_TO_DEVICE);
-	dev_kfree_skb_any(skb);
+out:
+	if (!xmit_more || (q->tx_pending_cnt == TVNET_TX_BATCH))
+		tvnet_host_tx_flush(q);
 
 	return NETDEV_TX_OK;
+
+stop_queue:
+	/* Queued packets must not wait for a later xmit */
+	tvnet_host_tx_flush(q);
+	netif_stop_subqueue(ndev, q->idx);
+	return NETDEV_TX_BUSY;
 }
 
 static const struct net_device_ops tvnet_host_netdev_ops = {
@@ -561,46 +658,90 @@ static const struct net_device_ops tvnet_host_netdev_ops = {
 	.ndo_change_mtu = tvnet_host_change_mtu,
 };
 
+static void tvnet_host_setup_queue(struct tvnet_priv *tvnet, u32 idx,
+				   const struct tvnet_queue_md *md)
+{
+	struct tvnet_queue *q = &tvnet->queues[idx];
+	struct ep_ring_buf *ep_mem = &q->ep_mem;
+	struct host_ring_buf *host_mem = &q->host_mem;
+
+	q->tvnet = tvnet;
+	q->idx = idx;
+	q->dma_ch = DMA_RD_DATA_CH + idx;
+	INIT_LIST_HEAD(&q->ep2h_empty_list);
+	spin_lock_init(&q->ep2h_empty_lock);
+
+	ep_mem->ep_cnt = (__force struct ep_own_cnt *)(tvnet->mmio_base +
+					md->ep_own_cnt_offset);
+	ep_mem->ep2h_full_msgs = (__force struct data_msg *)(tvnet->mmio_base +
+					md->ep2h_md.ep2h_offset);
+	ep_mem->h2ep_empty_msgs = (__force struct data_msg *)(tvnet->mmio_base +
+					md->h2ep_md.ep2h_offset);
+
+	host_mem->host_cnt = (__force struct host_own_cnt *)(tvnet->mmio_base +
+					md->host_own_cnt_offset);
+	host_mem->ep2h_empty_msgs = (__force struct data_msg *)(tvnet->mmio_base +
+					md->ep2h_md.h2ep_offset);
+	host_mem->h2ep_full_msgs = (__force struct data_msg *)(tvnet->mmio_base +
+					md->h2ep_md.h2ep_offset);
+
+	q->dma_desc = (__force struct tvnet_dma_desc *)(tvnet->mmio_base +
+					md->host_dma_offset);
+
+	q->h2ep_empty.rd = &host_mem->host_cnt->h2ep_empty_rd_cnt;
+	q->h2ep_empty.wr = &ep_mem->ep_cnt->h2ep_empty_wr_cnt;
+	q->h2ep_full.rd = &ep_mem->ep_cnt->h2ep_full_rd_cnt;
+	q->h2ep_full.wr = &host_mem->host_cnt->h2ep_full_wr_cnt;
+	q->ep2h_empty.rd = &ep_mem->ep_cnt->ep2h_empty_rd_cnt;
+	q->ep2h_empty.wr = &host_mem->host_cnt->ep2h_empty_wr_cnt;
+	q->ep2h_full.rd = &host_mem->host_cnt->ep2h_full_rd_cnt;
+	q->ep2h_full.wr = &ep_mem->ep_cnt->ep2h_full_wr_cnt;
+}
+
 static void tvnet_host_setup_bar0_md(struct tvnet_priv *tvnet)
 {
 	struct ep_ring_buf *ep_mem = &tvnet->ep_mem;
 	struct host_ring_buf *host_mem = &tvnet->host_mem;
+	struct tvnet_queue_md md;
+	struct bar_md *bar_md;
+	u32 i;
 
 	tvnet->bar_md = (__force struct bar_md *)tvnet->mmio_base;
+	bar_md = tvnet->bar_md;
 
 	ep_mem->ep_cnt = (__force struct ep_own_cnt *)(tvnet->mmio_base +
-					tvnet->bar_md->ep_own_cnt_offset);
+					bar_md->ep_own_cnt_offset);
 	ep_mem->ep2h_ctrl_msgs = (__force struct ctrl_msg *)(tvnet->mmio_base +
-					tvnet->bar_md->ctrl_md.ep2h_offset);
-	ep_mem->ep2h_full_msgs = (__force struct data_msg *)(tvnet->mmio_base +
-					tvnet->bar_md->ep2h_md.ep2h_offset);
-	ep_mem->h2ep_empty_msgs = (__force struct data_msg *)(tvnet->mmio_base +
-					tvnet->bar_md->h2ep_md.ep2h_offset);
+					bar_md->ctrl_md.ep2h_offset);
 
 	host_mem->host_cnt = (__force struct host_own_cnt *)(tvnet->mmio_base +
-					tvnet->bar_md->host_own_cnt_offset);
+					bar_md->host_own_cnt_offset);
 	host_mem->h2ep_ctrl_msgs = (__force struct ctrl_msg *)(tvnet->mmio_base +
-					tvnet->bar_md->ctrl_md.h2ep_offset);
-	host_mem->ep2h_empty_msgs = (__force struct data_msg *)(tvnet->mmio_base +
-					tvnet->bar_md->ep2h_md.h2ep_offset);
-	host_mem->h2ep_full_msgs = (__force struct data_msg *)(tvnet->mmio_base +
-					tvnet->bar_md->h2ep_md.h2ep_offset);
-
-	tvnet->dma_desc = (__force struct tvnet_dma_desc *)(tvnet->mmio_base +
-					tvnet->bar_md->host_dma_offset);
+					bar_md->ctrl_md.h2ep_offset);
 
 	tvnet->h2ep_ctrl.rd = &ep_mem->ep_cnt->h2ep_ctrl_rd_cnt;
 	tvnet->h2ep_ctrl.wr = &host_mem->host_cnt->h2ep_ctrl_wr_cnt;
 	tvnet->ep2h_ctrl.rd = &host_mem->host_cnt->ep2h_ctrl_rd_cnt;
 	tvnet->ep2h_ctrl.wr = &ep_mem->ep_cnt->ep2h_ctrl_wr_cnt;
-	tvnet->h2ep_empty.rd = &host_mem->host_cnt->h2ep_empty_rd_cnt;
-	tvnet->h2ep_empty.wr = &ep_mem->ep_cnt->h2ep_empty_wr_cnt;
-	tvnet->h2ep_full.rd = &ep_mem->ep_cnt->h2ep_full_rd_cnt;
-	tvnet->h2ep_full.wr = &host_mem->host_cnt->h2ep_full_wr_cnt;
-	tvnet->ep2h_empty.rd = &ep_mem->ep_cnt->ep2h_empty_rd_cnt;
-	tvnet->ep2h_empty.wr = &host_mem->host_cnt->ep2h_empty_wr_cnt;
-	tvnet->ep2h_full.rd = &host_mem->host_cnt->ep2h_full_rd_cnt;
-	tvnet->ep2h_full.wr = &ep_mem->ep_cnt->ep2h_full_wr_cnt;
+
+	/* Rest of the metadata page is not cleared by older EP drivers */
+	tvnet->ep_v2 = (bar_md->magic == TVNET_BAR_MD_MAGIC) &&
+		       (bar_md->version >= TVNET_BAR_MD_VERSION);
+	if (tvnet->ep_v2) {
+		tvnet->num_queues = clamp_t(u32, bar_md->num_queues, 1,
+					    TVNET_MAX_QUEUES);
+		for (i = 0; i < tvnet->num_queues; i++)
+			tvnet_host_setup_queue(tvnet, i, &bar_md->queue_md[i]);
+	} else {
+		tvnet->num_queues = 1;
+		md.ep_own_cnt_offset = bar_md->ep_own_cnt_offset;
+		md.host_own_cnt_offset = bar_md->host_own_cnt_offset;
+		md.ep2h_md = bar_md->ep2h_md;
+		md.h2ep_md = bar_md->h2ep_md;
+		md.host_dma_offset = bar_md->host_dma_offset;
+		md.host_dma_size = bar_md->host_dma_size;
+		tvnet_host_setup_queue(tvnet, 0, &md);
+	}
 }
 
 static void tvnet_host_process_ctrl_msg(struct tvnet_priv *tvnet)
@@ -618,31 +759,34 @@ static void tvnet_host_process_ctrl_msg(struct tvnet_priv *tvnet)
 	}
 }
 
-static int tvnet_host_process_ep2h_msg(struct tvnet_priv *tvnet)
+static int tvnet_host_process_ep2h_msg(struct tvnet_queue *q, int budget)
 {
-	struct ep_ring_buf *ep_mem = &tvnet->ep_mem;
+	struct tvnet_priv *tvnet = q->tvnet;
+	struct ep_ring_buf *ep_mem = &q->ep_mem;
 	struct data_msg *data_msg = ep_mem->ep2h_full_msgs;
 	struct device *d = &tvnet->pdev->dev;
 	struct ep2h_empty_list *ep2h_empty_ptr;
 	struct net_device *ndev = tvnet->ndev;
 	int count = 0;
 
-	while ((count < TVNET_NAPI_WEIGHT) &&
-	       tvnet_ivc_rd_available(&tvnet->ep2h_full)) {
+	while ((count < budget) &&
+	       tvnet_ivc_rd_available(&q->ep2h_full)) {
 		struct sk_buff *skb;
+		struct data_msg msg;
 		u64 pcie_address;
 		u32 len;
 		int idx, found = 0;
 		unsigned long flags;
 
-		/* Read EP2H full msg */
-		idx = tvnet_ivc_get_rd_cnt(&tvnet->ep2h_full) %
+		/* Read EP2H full msg, EP reuses the slot once rd advances */
+		idx = tvnet_ivc_get_rd_cnt(&q->ep2h_full) %
 					RING_COUNT;
-		len = data_msg[idx].u.full_buffer.packet_size;
-		pcie_address = data_msg[idx].u.full_buffer.pcie_address;
+		memcpy(&msg, &data_msg[idx], sizeof(msg));
+		len = msg.u.full_buffer.packet_size;
+		pcie_address = msg.u.full_buffer.pcie_address;
 
-		spin_lock_irqsave(&tvnet->ep2h_empty_lock, flags);
-		list_for_each_entry(ep2h_empty_ptr, &tvnet->ep2h_empty_list,
+		spin_lock_irqsave(&q->ep2h_empty_lock, flags);
+		list_for_each_entry(ep2h_empty_ptr, &q->ep2h_empty_list,
 				    list) {
 			if (ep2h_empty_ptr->iova == pcie_address) {
 				found = 1;
@@ -651,20 +795,37 @@ static int tvnet_host_process_ep2h_msg(struct tvnet_priv *tvnet)
 		}
 		WARN_ON(!found);
 		list_del(&ep2h_empty_ptr->list);
-		spin_unlock_irqrestore(&tvnet->ep2h_empty_lock, flags);
+		spin_unlock_irqrestore(&q->ep2h_empty_lock, flags);
 
 		/* Advance H2EP full buffer after search in local list */
-		tvnet_ivc_advance_rd(&tvnet->ep2h_full);
+		tvnet_ivc_advance_rd(&q->ep2h_full);
 		/* If EP2H network queue is stopped due to lack of EP2H_FULL
 		 * queue, raising ctrl irq will help.
 		 */
 		tvnet_host_raise_ep_ctrl_irq(tvnet);
 
-		dma_unmap_single(d, pcie_address, ndev->mtu + ETH_HLEN, DMA_FROM_DEVICE);
+		dma_unmap_single(d, pcie_address, ep2h_empty_ptr->len,
+				 DMA_FROM_DEVICE);
 		skb = ep2h_empty_ptr->skb;
-		skb_put(skb, len);
-		skb->protocol = eth_type_trans(skb, ndev);
-		napi_gro_receive(&tvnet->napi, skb);
+		if (len > ep2h_empty_ptr->len) {
+			pr_err("%s: pkt len %u > buf len %d\n", __func__, len,
+			       ep2h_empty_ptr->len);
+			dev_kfree_skb_any(skb);
+			ndev->stats.rx_dropped++;
+		} else {
+			skb_put(skb, len);
+			if (tvnet->ep_v2 && tvnet_rx_set_gso(skb, &msg)) {
+				pr_err("%s: bad gso type %u size %u\n",
+				       __func__, msg.u.full_buffer.gso_type,
+				       msg.u.full_buffer.gso_size);
+				dev_kfree_skb_any(skb);
+				ndev->stats.rx_dropped++;
+			} else {
+				skb->protocol = eth_type_trans(skb, ndev);
+				skb_record_rx_queue(skb, q->idx);
+				napi_gro_receive(&q->napi, skb);
+			}
+		}
 
 		/* Free EP2H empty list element */
 		kfree(ep2h_empty_ptr);
@@ -678,34 +839,43 @@ static irqreturn_t tvnet_irq_ctrl(int irq, void *data)
 {
 	struct net_device *ndev = data;
 	struct tvnet_priv *tvnet = netdev_priv(ndev);
-
-	if (netif_queue_stopped(ndev)) {
-		if ((tvnet->os_link_state == OS_LINK_STATE_UP) &&
-		    tvnet_ivc_rd_available(&tvnet->h2ep_empty) &&
-		    !tvnet_ivc_full(&tvnet->h2ep_full)) {
-			pr_debug("%s: wake net tx queue\n", __func__);
-			netif_wake_queue(ndev);
+	struct tvnet_queue *q;
+	u32 i;
+
+	for (i = 0; i < tvnet->num_queues; i++) {
+		q = &tvnet->queues[i];
+		if (__netif_subqueue_stopped(ndev, i) &&
+		    (tvnet->os_link_state == OS_LINK_STATE_UP) &&
+		    tvnet_ivc_rd_available(&q->h2ep_empty) &&
+		    !tvnet_ivc_full(&q->h2ep_full)) {
+			pr_debug("%s: wake net tx queue %u\n", __func__, i);
+			netif_wake_subqueue(ndev, i);
 		}
 	}
 
 	if (tvnet_ivc_rd_available(&tvnet->ep2h_ctrl))
 		tvnet_host_process_ctrl_msg(tvnet);
 
-	if (!tvnet_ivc_full(&tvnet->ep2h_empty) &&
-	    (tvnet->os_link_state == OS_LINK_STATE_UP))
-		tvnet_host_alloc_empty_buffers(tvnet);
+	for (i = 0; i < tvnet->num_queues; i++) {
+		q = &tvnet->queues[i];
+		if (!tvnet_ivc_full(&q->ep2h_empty) &&
+		    (tvnet->os_link_state == OS_LINK_STATE_UP))
+			tvnet_host_alloc_empty_buffers(q);
+	}
 
 	return IRQ_HANDLED;
 }
 
+/* EP has one data vector for all queues, poll each queue with Rx work */
 static irqreturn_t tvnet_irq_data(int irq, void *data)
 {
 	struct net_device *ndev = data;
 	struct tvnet_priv *tvnet = netdev_priv(ndev);
+	u32 i;
 
-	if (tvnet_ivc_rd_available(&tvnet->ep2h_full)) {
-		disable_irq_nosync(pci_irq_vector(tvnet->pdev, 1));
-		napi_schedule(&tvnet->napi);
+	for (i = 0; i < tvnet->num_queues; i++) {
+		if (tvnet_ivc_rd_available(&tvnet->queues[i].ep2h_full))
+			napi_schedule(&tvnet->queues[i].napi);
 	}
 
 	return IRQ_HANDLED;
@@ -713,13 +883,15 @@ static irqreturn_t tvnet_irq_data(int irq, void *data)
 
 static int tvnet_host_poll(struct napi_struct *napi, int budget)
 {
-	struct tvnet_priv *tvnet = container_of(napi, struct tvnet_priv, napi);
+	struct tvnet_queue *q = container_of(napi, struct tvnet_queue, napi);
 	int work_done;
 
-	work_done = tvnet_host_process_ep2h_msg(tvnet);
+	work_done = tvnet_host_process_ep2h_msg(q, budget);
 	if (work_done < budget) {
-		napi_complete(napi);
-		enable_irq(pci_irq_vector(tvnet->pdev, 1));
+		napi_complete_done(napi, work_done);
+		/* Data irq is shared, it may have come before complete */
+		if (tvnet_ivc_rd_available(&q->ep2h_full))
+			napi_schedule(napi);
 	}
 
 	return work_done;
@@ -731,13 +903,14 @@ static int tvnet_host_probe(struct pci_dev *pdev,
 	struct tvnet_priv *tvnet;
 	struct net_device *ndev;
 	int ret;
+	u32 i;
 
 	dev_dbg(&pdev->dev, "%s: PCIe VID: 0x%x DID: 0x%x\n", __func__,
 		pci_id->vendor, pci_id->device);
-	ndev = alloc_etherdev(sizeof(struct tvnet_priv));
+	ndev = alloc_etherdev_mq(sizeof(struct tvnet_priv), TVNET_MAX_QUEUES);
 	if (!ndev) {
 		ret = -ENOMEM;
-		dev_err(&pdev->dev, "alloc_etherdev() failed");
+		dev_err(&pdev->dev, "alloc_etherdev_mq() failed");
 		goto fail;
 	}
 
@@ -757,20 +930,10 @@ static int tvnet_host_probe(struct pci_dev *pdev,
 
 	pci_enable_pcie_error_reporting(pdev);
 
-	/*
-	 * In CPU memory write case, skb->data buffer is copied to dst in BAR.
-	 * Unaligned dword skb->data pointer comes in start_xmit, so use
-	 * write combine mapping for BAR.
-	 */
-#if ENABLE_DMA
+	/* Packet data is moved by EP DMA, BAR0 only holds rings and counters */
 	tvnet->mmio_base = devm_ioremap(&pdev->dev,
 					pci_resource_start(pdev, 0),
 					pci_resource_len(pdev, 0));
-#else
-	tvnet->mmio_base = devm_ioremap_wc(&pdev->dev,
-					   pci_resource_start(pdev, 0),
-					   pci_resource_len(pdev, 0));
-#endif
 	if (!tvnet->mmio_base) {
 		ret = -ENOMEM;
 		dev_err(&pdev->dev, "BAR0 ioremap() failed\n");
@@ -800,9 +963,24 @@ static int tvnet_host_probe(struct pci_dev *pdev,
 	/* Setup BAR0 meta data */
 	tvnet_host_setup_bar0_md(tvnet);
 
-	netif_napi_add(ndev, &tvnet->napi, tvnet_host_poll, TVNET_NAPI_WEIGHT);
+	/* Stack hashes flows over the queue pairs EP supports */
+	netif_set_real_num_tx_queues(ndev, tvnet->num_queues);
+	netif_set_real_num_rx_queues(ndev, tvnet->num_queues);
+	for (i = 0; i < tvnet->num_queues; i++)
+		netif_napi_add(ndev, &tvnet->queues[i].napi, tvnet_host_poll,
+			       TVNET_NAPI_WEIGHT);
+	dev_info(&pdev->dev, "EP bar_md v%u, %u queue pairs\n",
+		 tvnet->ep_v2 ? tvnet->bar_md->version : 1, tvnet->num_queues);
 
 	ndev->mtu = TVNET_DEFAULT_MTU;
+	/* Each skb segment is DMAed directly, see tvnet_tx_buf_map() */
+	ndev->hw_features = NETIF_F_SG | NETIF_F_HW_CSUM;
+	/* Version 2 EP takes TSO packets whole, see tvnet_rx_set_gso() */
+	if (tvnet->ep_v2) {
+		ndev->hw_features |= NETIF_F_TSO | NETIF_F_TSO6;
+		netif_set_gso_max_size(ndev, TVNET_GSO_MAX_SIZE);
+	}
+	ndev->features |= ndev->hw_features;
 
 	ret = register_netdev(ndev);
 	if (ret) {
@@ -839,12 +1017,7 @@ static int tvnet_host_probe(struct pci_dev *pdev,
 		goto fail_request_irq_ctrl;
 	}
 
-#if ENABLE_DMA
 	tvnet_host_write_dma_msix_settings(tvnet);
-#endif
-
-	INIT_LIST_HEAD(&tvnet->ep2h_empty_list);
-	spin_lock_init(&tvnet->ep2h_empty_lock);
 
 	return 0;
 
@@ -855,7 +1028,8 @@ disable_msi:
 unreg_netdev:
 	unregister_netdev(ndev);
 pci_disable:
-	netif_napi_del(&tvnet->napi);
+	for (i = 0; i < tvnet->num_queues; i++)
+		netif_napi_del(&tvnet->queues[i].napi);
 	pci_disable_device(pdev);
 free_netdev:
 	free_netdev(ndev);
@@ -866,12 +1040,14 @@ fail:
 static void tvnet_host_remove(struct pci_dev *pdev)
 {
 	struct tvnet_priv *tvnet = pci_get_drvdata(pdev);
+	u32 i;
 
 	free_irq(pci_irq_vector(pdev, 0), tvnet->ndev);
 	free_irq(pci_irq_vector(pdev, 1), tvnet->ndev);
 	pci_free_irq_vectors(pdev);
 	unregister_netdev(tvnet->ndev);
-	netif_napi_del(&tvnet->napi);
+	for (i = 0; i < tvnet->num_queues; i++)
+		netif_napi_del(&tvnet->queues[i].napi);
 	pci_disable_device(pdev);
 	free_netdev(tvnet->ndev);
 }
@@ -893,12 +1069,15 @@ static int tvnet_host_suspend(struct pci_dev *pdev, pm_message_t state)
 static int tvnet_host_resume(struct pci_dev *pdev)
 {
 	struct tvnet_priv *tvnet = pci_get_drvdata(pdev);
-#if ENABLE_DMA
-	struct dma_desc_cnt *desc_cnt = &tvnet->desc_cnt;
+	struct tvnet_queue *q;
+	u32 i;
 
-	desc_cnt->wr_cnt = desc_cnt->rd_cnt = 0;
+	for (i = 0; i < tvnet->num_queues; i++) {
+		q = &tvnet->queues[i];
+		q->desc_cnt.wr_cnt = q->desc_cnt.rd_cnt = 0;
+		q->tx_pending_cnt = 0;
+	}
 	tvnet_host_write_dma_msix_settings(tvnet);
-#endif
 
 	if (tvnet->pm_closed == true) {
 		tvnet_host_open(tvnet->ndev);
@@ -47,10 +47,20 @@
 * 0004: data
 *
 * data frame
-* 0000: [16-bit frame size][13-bit pad][Last-bit][First-bit][F_CNTRL=0]
+* 0000: [16-bit frame size][11-bit pad][Csum-bit][Packed-bit][Last-bit]
+*       [First-bit][F_CNTRL=0]
 * 0004: [packet-size 32 bit]
 * 0008: data
 *
+* packed data frame (Packed-bit, First-bit and Last-bit set)
+* 0000: flags as above, frame size covers all records
+* 0004: [number of packets 32 bit]
+* 0008: records of [packet-size 32 bit] + data padded to 4 bytes
+*
+* The Csum-bit tells the receiver the sender vouches for the checksums of
+* the packet(s) in the frame. Older receivers ignore it, but packed frames
+* must be enabled on both ends (pack-small-frames).
+*
 * control frame
 * 0000: <flags> (F_CNTRL == 1) F_CNTRL_CMD(x)
 * 0004: control frame data (deduced from F_CNTRL_CMD)
@@ -70,6 +80,8 @@
 
 #define F_DATA_FIRST		(1 << 1)	/* first chunk of a frame */
 #define F_DATA_LAST		(1 << 2)	/* last chunk of a frame */
+#define F_DATA_PACKED		(1 << 3)	/* several whole packets */
+#define F_DATA_CSUM_VALID	(1 << 4)	/* checksums already valid */
 #define F_DATA_FSIZE_SHIFT	16
 #define F_DATA_FSIZE_MASK	(~0 << F_DATA_FSIZE_SHIFT)
 #define F_DATA_FSIZE(x)	(((u32)(x) << F_DATA_FSIZE_SHIFT) & F_DATA_FSIZE_MASK)
@@ -82,6 +94,10 @@
 #define DEFAULT_LOW_WATERMARK_MULT	25
 #define DEFAULT_MAX_TX_DELAY_MSECS	10
 
+/* one IVC channel per tx/rx queue pair */
+#define MAX_QUEUES		8
+#define PACKED_REC_SIZE		4
+
 enum drop_kind {
 	dk_none,
 	/* tx */
@@ -89,6 +105,7 @@ enum drop_kind {
 	dk_full,
 	dk_wq,
 	dk_write,
+	dk_csum,
 	/* rx */
 	dk_frame,
 	dk_packet,
@@ -113,6 +130,7 @@ struct tegra_hv_net_stats {
 	u64 tx_queue_full;
 	u64 tx_wq_fail;
 	u64 tx_ivc_write_fail;
+	u64 tx_csum_fail;
 	/* internal rx stats */
 	u64 rx_bad_frame;
 	u64 rx_bad_packet;
@@ -121,63 +139,101 @@ struct tegra_hv_net_stats {
 	u64 rx_overflow;
 };
 
-struct tegra_hv_net {
-	struct platform_device *pdev;
-	struct net_device *ndev;
+struct tegra_hv_net;
+
+struct tegra_hv_net_queue {
+	struct tegra_hv_net *hvn;
 	struct tegra_hv_ivc_cookie *ivck;
-	const void *mac_address;
+	unsigned int index;
 	struct napi_struct napi;
-	struct tegra_hv_net_stats __percpu *stats;
 
 	struct sk_buff *rx_skb;
 	struct sk_buff_head tx_q;
 
+	/* packed frame left at the head of the channel when budget ran out */
+	int rx_pk_off;
+	u32 rx_pk_left;
+	/* set by the irq on a channel reset, NAPI then drops the rx state */
+	bool rx_reset;
+
 	struct work_struct xmit_work;
-	struct workqueue_struct *xmit_wq;
 	wait_queue_head_t wq;
 
 	unsigned int high_watermark;	/* mult * framesize */
 	unsigned int low_watermark;
+};
+
+struct tegra_hv_net {
+	struct platform_device *pdev;
+	struct net_device *ndev;
+	const void *mac_address;
+	struct tegra_hv_net_stats __percpu *stats;
+
+	struct workqueue_struct *xmit_wq;
+
 	unsigned int max_tx_delay;
+	bool pack;
+
+	unsigned int num_queues;
+	struct tegra_hv_net_queue queues[MAX_QUEUES];
 };
 
+/* per skb state while it sits in a tx queue */
+struct tegra_hv_net_skb_cb {
+	bool csum_valid;
+};
+
+#define HVN_SKB_CB(skb)	((struct tegra_hv_net_skb_cb *)(skb)->cb)
+
 static int tegra_hv_net_open(struct net_device *ndev)
 {
 	struct tegra_hv_net *hvn = netdev_priv(ndev);
+	struct tegra_hv_net_queue *q;
+	unsigned int i;
 
-	napi_enable(&hvn->napi);
-	netif_start_queue(ndev);
+	for (i = 0; i < hvn->num_queues; i++)
+		napi_enable(&hvn->queues[i].napi);
+	netif_tx_start_all_queues(ndev);
 
 	/*
-	 * check if there are already packets in our queue,
+	 * check if there are already packets in our queues,
 	 * and if so, we need to schedule a call to handle them
 	 */
-	if (tegra_hv_ivc_can_read(hvn->ivck))
-		napi_schedule(&hvn->napi);
+	for (i = 0; i < hvn->num_queues; i++) {
+		q = &hvn->queues[i];
+		if (tegra_hv_ivc_can_read(q->ivck))
+			napi_schedule(&q->napi);
+	}
 
 	return 0;
 }
 
 static irqreturn_t tegra_hv_net_interrupt(int irq, void *data)
 {
-	struct net_device *ndev = data;
-	struct tegra_hv_net *hvn = netdev_priv(ndev);
+	struct tegra_hv_net_queue *q = data;
 
-	/* until this function returns 0, the channel is unusable */
-	if (tegra_hv_ivc_channel_notified(hvn->ivck) != 0)
+	/*
+	 * until this function returns 0, the channel is unusable; the
+	 * counters restart from zero, so a packed frame or fragment that
+	 * was half received no longer exists
+	 */
+	if (tegra_hv_ivc_channel_notified(q->ivck) != 0) {
+		WRITE_ONCE(q->rx_reset, true);
 		return IRQ_HANDLED;
+	}
 
-	if (tegra_hv_ivc_can_write(hvn->ivck))
-		wake_up_interruptible_all(&hvn->wq);
+	if (tegra_hv_ivc_can_write(q->ivck))
+		wake_up_interruptible_all(&q->wq);
 
-	if (tegra_hv_ivc_can_read(hvn->ivck))
-		napi_schedule(&hvn->napi);
+	if (tegra_hv_ivc_can_read(q->ivck))
+		napi_schedule(&q->napi);
 
 	return IRQ_HANDLED;
 }
 
-static void *tegra_hv_net_xmit_get_buffer(struct tegra_hv_net *hvn)
+static void *tegra_hv_net_xmit_get_buffer(struct tegra_hv_net_queue *q)
 {
+	struct tegra_hv_net *hvn = q->hvn;
 	void *p;
 	int ret;
 
@@ -186,11 +242,11 @@ static void *tegra_hv_net_xmit_get_buffer(struct tegra_hv_net *hvn)
 	 * 1. the channel is full / peer is uncooperative
 	 * 2. the channel is under reset / peer has restarted
 	 */
-	p = tegra_hv_ivc_write_get_next_frame(hvn->ivck);
+	p = tegra_hv_ivc_write_get_next_frame(q->ivck);
 	if (IS_ERR(p)) {
-		ret = wait_event_interruptible_timeout(hvn->wq,
+		ret = wait_event_interruptible_timeout(q->wq,
 			!IS_ERR(p = tegra_hv_ivc_write_get_next_frame(
-				hvn->ivck)),
+				q->ivck)),
 			msecs_to_jiffies(hvn->max_tx_delay));
 		if (ret <= 0) {
 			net_warn_ratelimited(
@@ -203,30 +259,183 @@ static void *tegra_hv_net_xmit_get_buffer(struct tegra_hv_net *hvn)
 	return p;
 }
 
+static void tegra_hv_net_tx_stats(struct tegra_hv_net_stats *stats,
+				  enum drop_kind dk, int len)
+{
+	u64_stats_update_begin(&stats->tx_syncp);
+	if (dk == dk_none) {
+		stats->tx_packets++;
+		stats->tx_bytes += len;
+	} else {
+		stats->tx_drops++;
+		switch (dk) {
+		default:
+			/* never happens but gcc sometimes whines */
+			break;
+		case dk_linearize:
+			stats->tx_linearize_fail++;
+			break;
+		case dk_full:
+			stats->tx_queue_full++;
+			break;
+		case dk_wq:
+			stats->tx_wq_fail++;
+			break;
+		case dk_write:
+			stats->tx_ivc_write_fail++;
+			break;
+		case dk_csum:
+			stats->tx_csum_fail++;
+			break;
+		}
+	}
+	u64_stats_update_end(&stats->tx_syncp);
+}
+
+/*
+ * Packed frame being filled by the xmit worker. Small packets are appended
+ * while the tx queue has more of them, so a burst costs one IVC frame (and
+ * at most one peer notification) instead of one per packet.
+ */
+struct tegra_hv_net_pack {
+	u32 *p;
+	int used;
+	int count;
+	bool csum_valid;
+};
+
+static void tegra_hv_net_pack_close(struct tegra_hv_net_queue *q,
+				    struct tegra_hv_net_pack *pk)
+{
+	u32 p0;
+
+	if (pk->p == NULL)
+		return;
+
+	p0 = F_DATA_FSIZE(pk->used) | F_DATA_FIRST | F_DATA_LAST |
+		F_DATA_PACKED;
+	if (pk->csum_valid)
+		p0 |= F_DATA_CSUM_VALID;
+
+	pk->p[0] = p0;
+	pk->p[1] = pk->count;
+
+	/* advance the tx queue */
+	(void)tegra_hv_ivc_write_advance(q->ivck);
+	pk->p = NULL;
+}
+
+static enum drop_kind tegra_hv_net_pack_add(struct tegra_hv_net_queue *q,
+					    struct tegra_hv_net_pack *pk,
+					    struct sk_buff *skb)
+{
+	int max_frame = q->ivck->frame_size - HDR_SIZE;
+	int rec = PACKED_REC_SIZE + ALIGN(skb->len, 4);
+	u8 *dst;
+
+	if (pk->p != NULL && pk->used + rec > max_frame)
+		tegra_hv_net_pack_close(q, pk);
+
+	if (pk->p == NULL) {
+		/* wait up to the maximum send timeout */
+		pk->p = tegra_hv_net_xmit_get_buffer(q);
+		if (IS_ERR(pk->p)) {
+			pk->p = NULL;
+			return dk_wq;
+		}
+		pk->used = 0;
+		pk->count = 0;
+		pk->csum_valid = true;
+	}
+
+	dst = (u8 *)&pk->p[2] + pk->used;
+	*(u32 *)dst = skb->len;
+	skb_copy_from_linear_data(skb, dst + PACKED_REC_SIZE, skb->len);
+
+	pk->used += rec;
+	pk->count++;
+	pk->csum_valid &= HVN_SKB_CB(skb)->csum_valid;
+
+	return dk_none;
+}
+
+static enum drop_kind tegra_hv_net_xmit_frags(struct tegra_hv_net_queue *q,
+					      struct sk_buff *skb)
+{
+	struct net_device *ndev = q->hvn->ndev;
+	int max_frame = q->ivck->frame_size - HDR_SIZE;
+	int count, first, last, orig_len;
+	u32 *p, p0, p1;
+
+	/* copy the fragments */
+	orig_len = skb->len;
+	first = 1;
+	while (skb->len > 0) {
+		count = skb->len;
+		if (count > max_frame)
+			count = max_frame;
+
+		/* wait up to the maximum send timeout */
+		p = tegra_hv_net_xmit_get_buffer(q);
+		if (IS_ERR(p))
+			return dk_wq;
+
+		last = skb->len == count;
+
+		p0 = F_DATA_FSIZE(count);
+		if (first)
+			p0 |= F_DATA_FIRST;
+		if (last)
+			p0 |= F_DATA_LAST;
+		if (HVN_SKB_CB(skb)->csum_valid)
+			p0 |= F_DATA_CSUM_VALID;
+		p1 = orig_len;
+
+		netdev_dbg(ndev, "F: %c%c F%d P%d [%08x %08x]\n",
+				first ? 'F' : '.',
+				last ? 'L' : '.',
+				count, orig_len, p[0], p[1]);
+
+		first = 0;
+
+		p[0] = p0;
+		p[1] = p1;
+		skb_copy_from_linear_data(skb, &p[2], count);
+
+		/* advance the tx queue */
+		(void)tegra_hv_ivc_write_advance(q->ivck);
+		skb_pull(skb, count);
+	}
+
+	return dk_none;
+}
+
 static void tegra_hv_net_xmit_work(struct work_struct *work)
 {
-	struct tegra_hv_net *hvn =
-		container_of(work, struct tegra_hv_net, xmit_work);
+	struct tegra_hv_net_queue *q =
+		container_of(work, struct tegra_hv_net_queue, xmit_work);
+	struct tegra_hv_net *hvn = q->hvn;
 	struct tegra_hv_net_stats *stats = raw_cpu_ptr(hvn->stats);
 	struct net_device *ndev = hvn->ndev;
+	struct tegra_hv_net_pack pk = { .p = NULL };
 	struct sk_buff *skb;
-	int ret, max_frame, count, first, last, orig_len;
-	u32 *p, p0, p1;
+	int ret, max_frame, orig_len;
 	enum drop_kind dk;
 
-	max_frame = hvn->ivck->frame_size - HDR_SIZE;
+	max_frame = q->ivck->frame_size - HDR_SIZE;
 
-	dk = dk_none;
-	while ((skb = skb_dequeue(&hvn->tx_q)) != NULL) {
+	while ((skb = skb_dequeue(&q->tx_q)) != NULL) {
 
 		/* start the queue if it is short again */
-		if (netif_queue_stopped(ndev) &&
-				skb_queue_len(&hvn->tx_q) < hvn->low_watermark)
-			netif_start_queue(ndev);
+		if (__netif_subqueue_stopped(ndev, q->index) &&
+				skb_queue_len(&q->tx_q) < q->low_watermark)
+			netif_start_subqueue(ndev, q->index);
+
+		orig_len = skb->len;
 
 		ret = skb_linearize(skb);
 		if (ret != 0) {
-			netdev_err(hvn->ndev,
+			netdev_err(ndev,
 				"%s: skb_linearize error=%d\n",
 				__func__, ret);
 
@@ -234,80 +443,35 @@ static void tegra_hv_net_xmit_work(struct work_struct *work)
 			goto drop;
 		}
 
+		/* the peer does not compute checksums, fill them in here */
+		if (skb->ip_summed == CHECKSUM_PARTIAL &&
+		    skb_checksum_help(skb) != 0) {
+			dk = dk_csum;
+			goto drop;
+		}
+
 		/* print_hex_dump(KERN_INFO, "tx-", DUMP_PREFIX_OFFSET,
 		 * 16, 1, skb->data, skb->len, true); */
 
-		/* copy the fragments */
-		orig_len = skb->len;
-		first = 1;
-		while (skb->len > 0) {
-			count = skb->len;
-			if (count > max_frame)
-				count = max_frame;
-
-			/* wait up to the maximum send timeout */
-			p = tegra_hv_net_xmit_get_buffer(hvn);
-			if (IS_ERR(p)) {
-				dk = dk_wq;
-				goto drop;
-			}
-
-			last = skb->len == count;
-
-			p0 = F_DATA_FSIZE(count);
-			if (first)
-				p0 |= F_DATA_FIRST;
-			if (last)
-				p0 |= F_DATA_LAST;
-			p1 = orig_len;
-
-			netdev_dbg(ndev, "F: %c%c F%d P%d [%08x %08x]\n",
-					first ? 'F' : '.',
-					last ? 'L' : '.',
-					count, orig_len, p[0], p[1]);
-
-			first = 0;
-
-			p[0] = p0;
-			p[1] = p1;
-			skb_copy_from_linear_data(skb, &p[2], count);
-
-			/* advance the tx queue */
-			(void)tegra_hv_ivc_write_advance(hvn->ivck);
-			skb_pull(skb, count);
+		if (hvn->pack &&
+		    PACKED_REC_SIZE + ALIGN(skb->len, 4) <= max_frame) {
+			dk = tegra_hv_net_pack_add(q, &pk, skb);
+		} else {
+			/* keep packet order on the channel */
+			tegra_hv_net_pack_close(q, &pk);
+			dk = tegra_hv_net_xmit_frags(q, skb);
 		}
-		/* all OK */
-		dk = dk_none;
+
+		/* nothing else queued, send what has been packed so far */
+		if (skb_queue_empty(&q->tx_q))
+			tegra_hv_net_pack_close(q, &pk);
 
 drop:
 		dev_kfree_skb(skb);
-
-		u64_stats_update_begin(&stats->tx_syncp);
-		if (dk == dk_none) {
-			stats->tx_packets++;
-			stats->tx_bytes += orig_len;
-		} else {
-			stats->tx_drops++;
-			switch (dk) {
-			default:
-				/* never happens but gcc sometimes whines */
-				break;
-			case dk_linearize:
-				stats->tx_linearize_fail++;
-				break;
-			case dk_full:
-				stats->tx_queue_full++;
-				break;
-			case dk_wq:
-				stats->tx_wq_fail++;
-				break;
-			case dk_write:
-				stats->tx_ivc_write_fail++;
-				break;
-			}
-		}
-		u64_stats_update_end(&stats->tx_syncp);
+		tegra_hv_net_tx_stats(stats, dk, orig_len);
 	}
+
+	tegra_hv_net_pack_close(q, &pk);
 }
 
 /* xmit is dummy, we just add the skb to the tx_q and queue work */
@@ -315,6 +479,16 @@ static netdev_tx_t tegra_hv_net_xmit(struct sk_buff *skb,
 				     struct net_device *ndev)
 {
 	struct tegra_hv_net *hvn = netdev_priv(ndev);
+	u16 qi = skb_get_queue_mapping(skb);
+	struct tegra_hv_net_queue *q = &hvn->queues[qi];
+
+	/*
+	 * Only vouch for checksums the xmit worker fills in (CHECKSUM_PARTIAL)
+	 * or that were verified on receive. Anything else, e.g. raw and
+	 * packet socket frames or forwarded packets, is sent as is.
+	 */
+	HVN_SKB_CB(skb)->csum_valid = skb->ip_summed == CHECKSUM_PARTIAL ||
+		skb->ip_summed == CHECKSUM_UNNECESSARY;
 
 	skb_orphan(skb);
 #if LINUX_VERSION_CODE > KERNEL_VERSION(4,15,0)
@@ -322,27 +496,45 @@ static netdev_tx_t tegra_hv_net_xmit(struct sk_buff *skb,
 #else
 	nf_reset(skb);
 #endif
-	skb_queue_tail(&hvn->tx_q, skb);
-	queue_work_on(WORK_CPU_UNBOUND, hvn->xmit_wq, &hvn->xmit_work);
+	skb_queue_tail(&q->tx_q, skb);
+	queue_work_on(WORK_CPU_UNBOUND, hvn->xmit_wq, &q->xmit_work);
 
 	/* stop the queue if it gets too long */
-	if (!netif_queue_stopped(ndev) &&
-			skb_queue_len(&hvn->tx_q) >= hvn->high_watermark)
-		netif_stop_queue(ndev);
-	else if (netif_queue_stopped(ndev) &&
-			skb_queue_len(&hvn->tx_q) < hvn->low_watermark)
-		netif_start_queue(ndev);
+	if (!__netif_subqueue_stopped(ndev, qi) &&
+			skb_queue_len(&q->tx_q) >= q->high_watermark)
+		netif_stop_subqueue(ndev, qi);
+	else if (__netif_subqueue_stopped(ndev, qi) &&
+			skb_queue_len(&q->tx_q) < q->low_watermark)
+		netif_start_subqueue(ndev, qi);
 
 	return NETDEV_TX_OK;
 }
 
+/* forget a partially received frame, NAPI must not be running */
+static void tegra_hv_net_rx_reset(struct tegra_hv_net_queue *q)
+{
+	q->rx_pk_off = 0;
+	q->rx_pk_left = 0;
+	if (q->rx_skb != NULL) {
+		dev_kfree_skb(q->rx_skb);
+		q->rx_skb = NULL;
+	}
+}
+
 static int
 tegra_hv_net_stop(struct net_device *ndev)
 {
 	struct tegra_hv_net *hvn = netdev_priv(ndev);
-
-	netif_stop_queue(ndev);
-	napi_disable(&hvn->napi);
+	struct tegra_hv_net_queue *q;
+	unsigned int i;
+
+	netif_tx_stop_all_queues(ndev);
+	for (i = 0; i < hvn->num_queues; i++) {
+		q = &hvn->queues[i];
+		napi_disable(&q->napi);
+		WRITE_ONCE(q->rx_reset, false);
+		tegra_hv_net_rx_reset(q);
+	}
 
 	return 0;
 }
@@ -456,41 +648,155 @@ static const struct ethtool_ops tegra_hv_ethtool_ops = {
 	.get_link = ethtool_op_get_link,
 };
 
-static void tegra_hv_net_tx_complete(struct tegra_hv_net *hvn)
+static void tegra_hv_net_tx_complete(struct tegra_hv_net_queue *q)
 {
-	struct net_device *ndev = hvn->ndev;
+	struct net_device *ndev = q->hvn->ndev;
 
 	/* wake queue if no more tx buffers */
-	if (skb_queue_len(&hvn->tx_q) == 0)
-		netif_wake_queue(ndev);
+	if (skb_queue_len(&q->tx_q) == 0)
+		netif_wake_subqueue(ndev, q->index);
 
 }
 
-static int tegra_hv_net_rx(struct tegra_hv_net *hvn, int limit)
+static void tegra_hv_net_rx_deliver(struct tegra_hv_net_queue *q,
+				    struct sk_buff *skb, bool csum_valid)
 {
-	struct tegra_hv_net_stats *stats = this_cpu_ptr(hvn->stats);
-	struct net_device *ndev = hvn->ndev;
+	struct net_device *ndev = q->hvn->ndev;
+
+	/* print_hex_dump(KERN_INFO, "rx-", DUMP_PREFIX_OFFSET,
+	 * 16, 1, skb->data, skb->len, true); */
+
+	skb->protocol = eth_type_trans(skb, ndev);
+	if (csum_valid && (ndev->features & NETIF_F_RXCSUM))
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+	else
+		skb->ip_summed = CHECKSUM_NONE;
+	skb_record_rx_queue(skb, q->index);
+	napi_gro_receive(&q->napi, skb);
+}
+
+static void tegra_hv_net_rx_stats(struct tegra_hv_net_stats *stats,
+				  enum drop_kind dk, bool last, int count)
+{
+	u64_stats_update_begin(&stats->rx_syncp);
+	if (dk == dk_none) {
+		if (last) {
+			stats->rx_packets++;
+			stats->rx_bytes += count;
+		}
+	} else {
+		stats->rx_drops++;
+		switch (dk) {
+		default:
+			/* never happens but gcc sometimes whines */
+			break;
+		case dk_frame:
+			stats->rx_bad_frame++;
+			break;
+		case dk_packet:
+			stats->rx_bad_packet++;
+			break;
+		case dk_unexpected:
+			stats->rx_unexpected_packet++;
+			break;
+		case dk_alloc:
+			stats->rx_alloc_fail++;
+			break;
+		case dk_overflow:
+			stats->rx_overflow++;
+			break;
+		}
+	}
+	u64_stats_update_end(&stats->rx_syncp);
+}
+
+/*
+ * Split a packed frame back into packets, frame_size is already checked.
+ * At most limit packets are delivered, the position of the rest is kept
+ * in the queue and the frame is finished on the next poll. Returns the
+ * number of packets consumed.
+ */
+static int tegra_hv_net_rx_packed(struct tegra_hv_net_queue *q,
+				  struct tegra_hv_net_stats *stats,
+				  const u32 *p, int frame_size, int limit)
+{
+	struct net_device *ndev = q->hvn->ndev;
+	bool csum_valid = !!(p[0] & F_DATA_CSUM_VALID);
+	const u8 *rec = (const u8 *)&p[2];
+	int off, len, nr = 0;
+	struct sk_buff *skb;
+
+	if (q->rx_pk_left == 0) {
+		q->rx_pk_off = 0;
+		q->rx_pk_left = p[1];
+	}
+	off = q->rx_pk_off;
+
+	while (q->rx_pk_left > 0 && nr < limit) {
+		nr++;
+
+		if (off + PACKED_REC_SIZE > frame_size) {
+			netdev_err(ndev, "Bad packed frame\n");
+			tegra_hv_net_rx_stats(stats, dk_frame, false, 0);
+			q->rx_pk_left = 0;
+			break;
+		}
+
+		len = *(const u32 *)(rec + off);
+		if (len < MIN_MTU || len > MAX_MTU + MIN_MTU ||
+		    off + PACKED_REC_SIZE + len > frame_size) {
+			netdev_err(ndev, "Bad packet size %d\n", len);
+			tegra_hv_net_rx_stats(stats, dk_packet, false, 0);
+			q->rx_pk_left = 0;
+			break;
+		}
+
+		skb = napi_alloc_skb(&q->napi, len);
+		if (skb == NULL) {
+			netdev_err(ndev, "failed to allocate packet\n");
+			tegra_hv_net_rx_stats(stats, dk_alloc, false, 0);
+		} else {
+			memcpy(skb_put(skb, len), rec + off + PACKED_REC_SIZE,
+			       len);
+			tegra_hv_net_rx_deliver(q, skb, csum_valid);
+			tegra_hv_net_rx_stats(stats, dk_none, true, len);
+		}
+
+		off += PACKED_REC_SIZE + ALIGN(len, 4);
+		q->rx_pk_left--;
+	}
+
+	q->rx_pk_off = off;
+	return nr;
+}
+
+static int tegra_hv_net_rx(struct tegra_hv_net_queue *q, int limit)
+{
+	struct tegra_hv_net_stats *stats = this_cpu_ptr(q->hvn->stats);
+	struct net_device *ndev = q->hvn->ndev;
 	struct sk_buff *skb;
 	int nr, frame_size, max_frame, count, first, last;
 	u32 *p, p0;
 	enum drop_kind dk;
 
-	max_frame = hvn->ivck->frame_size - HDR_SIZE;
+	max_frame = q->ivck->frame_size - HDR_SIZE;
 
 	nr = 0;
 	dk = dk_none;
 	while (nr < limit) {
+		/* the irq saw a channel reset, the old position is stale */
+		if (xchg(&q->rx_reset, false))
+			tegra_hv_net_rx_reset(q);
+
 		/*
 		 * grabbing a frame can fail for the following reasons:
 		 * 1. the channel is empty / peer is uncooperative
 		 * 2. the channel is under reset / peer has restarted
 		 */
-		p = tegra_hv_ivc_read_get_next_frame(hvn->ivck);
+		p = tegra_hv_ivc_read_get_next_frame(q->ivck);
 		if (IS_ERR(p))
 			break;
 
-		nr++;
-
 		p0 = p[0];
 		first = !!(p0 & F_DATA_FIRST);
 		last = !!(p0 & F_DATA_LAST);
@@ -502,12 +808,34 @@ static int tegra_hv_net_rx(struct tegra_hv_net *hvn, int limit)
 				last ? 'L' : '.',
 				frame_size, count, p[0], p[1]);
 
+		/* each packet of a packed frame counts against the budget */
+		if ((p0 & F_DATA_PACKED) && frame_size <= max_frame &&
+		    q->rx_skb == NULL) {
+			/* an empty frame still costs one unit */
+			nr += max(tegra_hv_net_rx_packed(q, stats, p,
+							 frame_size,
+							 limit - nr), 1);
+			if (q->rx_pk_left == 0)
+				(void)tegra_hv_ivc_read_advance(q->ivck);
+			continue;
+		}
+
+		nr++;
+
 		if (frame_size > max_frame) {
 			netdev_err(ndev, "Bad fragment size %d\n", frame_size);
 			dk = dk_frame;
 			goto drop;
 		}
 
+		if (p0 & F_DATA_PACKED) {
+			netdev_err(ndev, "unexpected packed frame\n");
+			dev_kfree_skb(q->rx_skb);
+			q->rx_skb = NULL;
+			dk = dk_unexpected;
+			goto drop;
+		}
+
 		/* verify that packet is sane */
 		if (count < MIN_MTU || count > MAX_MTU + MIN_MTU)  {
 			netdev_err(ndev, "Bad packet size %d\n", count);
@@ -515,115 +843,152 @@ static int tegra_hv_net_rx(struct tegra_hv_net *hvn, int limit)
 			goto drop;
 		}
 		/* receive state machine */
-		if (hvn->rx_skb == NULL) {
+		if (q->rx_skb == NULL) {
 			if (!first) {
 				netdev_err(ndev, "unexpected fragment\n");
 				dk = dk_unexpected;
 				goto drop;
 			}
-			hvn->rx_skb = netdev_alloc_skb(ndev, count);
-			if (hvn->rx_skb == NULL) {
+			q->rx_skb = napi_alloc_skb(&q->napi, count);
+			if (q->rx_skb == NULL) {
 				netdev_err(ndev, "failed to allocate packet\n");
 				dk = dk_alloc;
 				goto drop;
 			}
 		}
 		/* verify that skb still can receive the data */
-		if (skb_tailroom(hvn->rx_skb) < frame_size) {
+		if (skb_tailroom(q->rx_skb) < frame_size) {
 			netdev_err(ndev, "skb overflow\n");
-			dev_kfree_skb(hvn->rx_skb);
-			hvn->rx_skb = NULL;
+			dev_kfree_skb(q->rx_skb);
+			q->rx_skb = NULL;
 			dk = dk_overflow;
 			goto drop;
 		}
 
 		/* append the data */
-		skb = hvn->rx_skb;
+		skb = q->rx_skb;
 		skb_copy_to_linear_data_offset(skb, skb->len, p + 2,
 					       frame_size);
 		skb_put(skb, frame_size);
 
 		if (last) {
-			/* print_hex_dump(KERN_INFO, "rx-", DUMP_PREFIX_OFFSET,
-			 * 16, 1, skb->data, skb->len, true); */
-
 			count = skb->len;
-
-			skb->protocol = eth_type_trans(skb, ndev);
-			skb->ip_summed = CHECKSUM_NONE;
-			netif_receive_skb(skb);
-			hvn->rx_skb = NULL;
+			tegra_hv_net_rx_deliver(q, skb,
+						!!(p0 & F_DATA_CSUM_VALID));
+			q->rx_skb = NULL;
 		}
 		dk = dk_none;
 drop:
-		(void)tegra_hv_ivc_read_advance(hvn->ivck);
-
-		u64_stats_update_begin(&stats->rx_syncp);
-		if (dk == dk_none) {
-			if (last) {
-				stats->rx_packets++;
-				stats->rx_bytes += count;
-			}
-		} else {
-			stats->rx_drops++;
-			switch (dk) {
-			default:
-				/* never happens but gcc sometimes whines */
-				break;
-			case dk_frame:
-				stats->rx_bad_frame++;
-				break;
-			case dk_packet:
-				stats->rx_bad_packet++;
-				break;
-			case dk_unexpected:
-				stats->rx_unexpected_packet++;
-				break;
-			case dk_alloc:
-				stats->rx_alloc_fail++;
-				break;
-			case dk_overflow:
-				stats->rx_overflow++;
-				break;
-			}
-		}
-		u64_stats_update_end(&stats->rx_syncp);
+		(void)tegra_hv_ivc_read_advance(q->ivck);
 
+		tegra_hv_net_rx_stats(stats, dk, last, count);
 	}
 	return nr;
 }
 
 static int tegra_hv_net_poll(struct napi_struct *napi, int budget)
 {
-	struct tegra_hv_net *hvn =
-		container_of(napi, struct tegra_hv_net, napi);
+	struct tegra_hv_net_queue *q =
+		container_of(napi, struct tegra_hv_net_queue, napi);
 	int work_done = 0;
 
-	tegra_hv_net_tx_complete(hvn);
+	tegra_hv_net_tx_complete(q);
 
-	work_done = tegra_hv_net_rx(hvn, budget);
+	work_done = tegra_hv_net_rx(q, budget);
 
 	if (work_done < budget) {
-		napi_complete(napi);
+		napi_complete_done(napi, work_done);
 
 		/*
 		 * if an interrupt occurs after tegra_hv_net_rx() but before
 		 * napi_complete(), we lose the call to napi_schedule().
 		 */
-		if (tegra_hv_ivc_can_read(hvn->ivck))
+		if (tegra_hv_ivc_can_read(q->ivck))
 			napi_reschedule(napi);
 	}
 
 	return work_done;
 }
 
+static void tegra_hv_net_unreserve_all(struct tegra_hv_net *hvn)
+{
+	unsigned int i;
+
+	for (i = 0; i < hvn->num_queues; i++) {
+		if (!IS_ERR_OR_NULL(hvn->queues[i].ivck))
+			tegra_hv_ivc_unreserve(hvn->queues[i].ivck);
+		hvn->queues[i].ivck = NULL;
+	}
+}
+
+/* the ivc property is a list of <&hv-node id> pairs, one per queue */
+static int tegra_hv_net_reserve_all(struct device *dev,
+				    struct tegra_hv_net *hvn,
+				    u32 highmark, u32 lowmark)
+{
+	struct device_node *dn = dev->of_node, *hv_dn;
+	struct tegra_hv_net_queue *q;
+	unsigned int i;
+	int ret;
+	u32 id;
+
+	for (i = 0; i < hvn->num_queues; i++) {
+		q = &hvn->queues[i];
+
+		hv_dn = of_parse_phandle(dn, "ivc", 2 * i);
+		if (hv_dn == NULL) {
+			dev_err(dev, "Failed to parse phandle of ivc prop %u\n",
+				i);
+			return -EINVAL;
+		}
+
+		ret = of_property_read_u32_index(dn, "ivc", 2 * i + 1, &id);
+		if (ret != 0) {
+			dev_err(dev, "Failed to read IVC property ID %u\n", i);
+			of_node_put(hv_dn);
+			return ret;
+		}
+
+		q->ivck = tegra_hv_ivc_reserve(hv_dn, id, NULL);
+		of_node_put(hv_dn);
+
+		if (IS_ERR_OR_NULL(q->ivck)) {
+			dev_err(dev, "Failed to reserve IVC channel %d\n", id);
+			ret = q->ivck ? PTR_ERR(q->ivck) : -ENODEV;
+			q->ivck = NULL;
+			return ret;
+		}
+
+		/* make sure the frame size is sufficient */
+		if (q->ivck->frame_size <= HDR_SIZE + 4) {
+			dev_err(dev, "frame size too small to support COMM\n");
+			return -EINVAL;
+		}
+
+		q->hvn = hvn;
+		q->index = i;
+		q->high_watermark = highmark * q->ivck->nframes;
+		q->low_watermark = lowmark * q->ivck->nframes;
+		skb_queue_head_init(&q->tx_q);
+		INIT_WORK(&q->xmit_work, tegra_hv_net_xmit_work);
+		init_waitqueue_head(&q->wq);
+
+		dev_info(dev, "Reserved IVC channel #%d - frame_size=%d\n",
+				id, q->ivck->frame_size);
+	}
+
+	return 0;
+}
+
 static int tegra_hv_net_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
-	struct device_node *dn, *hv_dn;
+	struct device_node *dn;
 	struct net_device *ndev = NULL;
 	struct tegra_hv_net *hvn = NULL;
-	int ret;
+	struct tegra_hv_net_queue *q;
+	unsigned int i, nq, nirq = 0;
+	int ret, cells;
 	u32 id;
 	u32 highmark, lowmark, txdelay;
 
@@ -638,16 +1003,17 @@ static int tegra_hv_net_probe(struct platform_device *pdev)
 		return -EINVAL;
 	}
 
-	hv_dn = of_parse_phandle(dn, "ivc", 0);
-	if (hv_dn == NULL) {
-		dev_err(dev, "Failed to parse phandle of ivc prop\n");
+	cells = of_property_count_u32_elems(dn, "ivc");
+	if (cells < 2 || (cells % 2) != 0 || cells / 2 > MAX_QUEUES) {
+		dev_err(dev, "Bad ivc property (%d cells)\n", cells);
 		return -EINVAL;
 	}
+	nq = cells / 2;
 
 	ret = of_property_read_u32_index(dn, "ivc", 1, &id);
 	if (ret != 0) {
 		dev_err(dev, "Failed to read IVC property ID\n");
-		goto out_of_put;
+		return ret;
 	}
 
 	ret = of_property_read_u32(dn, "high-watermark-mult", &highmark);
@@ -661,22 +1027,26 @@ static int tegra_hv_net_probe(struct platform_device *pdev)
 	if (highmark <= lowmark) {
 		dev_err(dev, "Bad watermark configuration (high <= low = %u < %u)\n",
 				highmark, lowmark);
-		goto out_of_put;
+		return -EINVAL;
 	}
 
 	ret = of_property_read_u32(dn, "max-tx-delay-msecs", &txdelay);
 	if (ret != 0)
 		txdelay = DEFAULT_MAX_TX_DELAY_MSECS;
 
-	ndev = alloc_netdev(sizeof(*hvn), "hv%d", NET_NAME_UNKNOWN,
-			    ether_setup);
+	ndev = alloc_netdev_mqs(sizeof(*hvn), "hv%d", NET_NAME_UNKNOWN,
+				ether_setup, nq, nq);
 	if (ndev == NULL) {
 		dev_err(dev, "Failed to allocate netdev\n");
-		ret = -ENOMEM;
-		goto out_of_put;
+		return -ENOMEM;
 	}
 
 	hvn = netdev_priv(ndev);
+	hvn->pdev = pdev;
+	hvn->ndev = ndev;
+	hvn->num_queues = nq;
+	hvn->max_tx_delay = txdelay;
+	hvn->pack = of_property_read_bool(dn, "pack-small-frames");
 
 	hvn->stats = alloc_percpu(struct tegra_hv_net_stats);
 	if (hvn->stats == NULL) {
@@ -685,30 +1055,9 @@ static int tegra_hv_net_probe(struct platform_device *pdev)
 		goto out_free_ndev;
 	}
 
-	hvn->ivck = tegra_hv_ivc_reserve(hv_dn, id, NULL);
-	of_node_put(hv_dn);
-	hv_dn = NULL;
-
-	if (IS_ERR_OR_NULL(hvn->ivck)) {
-		dev_err(dev, "Failed to reserve IVC channel %d\n", id);
-		ret = PTR_ERR(hvn->ivck);
-		hvn->ivck = NULL;
-		goto out_free_stats;
-	}
-
-	hvn->high_watermark = highmark * hvn->ivck->nframes;
-	hvn->low_watermark = lowmark * hvn->ivck->nframes;
-	hvn->max_tx_delay = txdelay;
-
-	/* make sure the frame size is sufficient */
-	if (hvn->ivck->frame_size <= HDR_SIZE + 4) {
-		dev_err(dev, "frame size too small to support COMM\n");
-		ret = -EINVAL;
+	ret = tegra_hv_net_reserve_all(dev, hvn, highmark, lowmark);
+	if (ret != 0)
 		goto out_unreserve;
-	}
-
-	dev_info(dev, "Reserved IVC channel #%d - frame_size=%d\n",
-			id, hvn->ivck->frame_size);
 
 	SET_NETDEV_DEV(ndev, dev);
 	platform_set_drvdata(pdev, ndev);
@@ -719,17 +1068,16 @@ static int tegra_hv_net_probe(struct platform_device *pdev)
 #endif
 	ndev->netdev_ops = &tegra_hv_netdev_ops;
 	ndev->ethtool_ops = &tegra_hv_ethtool_ops;
-	skb_queue_head_init(&hvn->tx_q);
-	INIT_WORK(&hvn->xmit_work, tegra_hv_net_xmit_work);
 
-	hvn->pdev = pdev;
-	hvn->ndev = ndev;
-	ndev->irq = hvn->ivck->irq;
-
-	init_waitqueue_head(&hvn->wq);
+	/* the first channel's irq is what userspace sees */
+	ndev->irq = hvn->queues[0].ivck->irq;
 
 	ndev->priv_flags |= IFF_UNICAST_FLT | IFF_LIVE_ADDR_CHANGE;
-	ndev->hw_features = 0;	/* we're a really dumb device for now */
+	/*
+	 * The peer may tell us checksums were already verified. Tx checksums
+	 * are filled in by the xmit worker so that it can vouch for them.
+	 */
+	ndev->hw_features = NETIF_F_RXCSUM | NETIF_F_HW_CSUM;
 	ndev->features |= ndev->hw_features;
 	/* get mac address from the DT */
 
@@ -764,9 +1112,10 @@ static int tegra_hv_net_probe(struct platform_device *pdev)
 		ether_addr_copy(ndev->dev_addr, hvn->mac_address);
 	}
 
+	/* one xmit worker per queue may run concurrently */
 	hvn->xmit_wq = alloc_workqueue("tgvnet-wq-%d",
 			WQ_UNBOUND | WQ_MEM_RECLAIM,
-			1,	/* FIXME: from DT? */
+			nq,
 			pdev->id);
 	if (hvn->xmit_wq == NULL) {
 		dev_err(dev, "Failed to allocate workqueue\n");
@@ -774,7 +1123,9 @@ static int tegra_hv_net_probe(struct platform_device *pdev)
 		goto out_unreserve;
 	}
 
-	netif_napi_add(ndev, &hvn->napi, tegra_hv_net_poll, 64);
+	for (i = 0; i < nq; i++)
+		netif_napi_add(ndev, &hvn->queues[i].napi, tegra_hv_net_poll,
+			       64);
 	ret = register_netdev(ndev);
 	if (ret) {
 		dev_err(dev, "Failed to register netdev\n");
@@ -786,39 +1137,45 @@ static int tegra_hv_net_probe(struct platform_device *pdev)
 	 * process completes, any attempt to use the ivc channel will return
 	 * an error (e.g., all transmits will fail).
 	 */
-	tegra_hv_ivc_channel_reset(hvn->ivck);
-
-	/* the interrupt request must be the last action */
-	ret = devm_request_irq(dev, ndev->irq, tegra_hv_net_interrupt, 0,
-			dev_name(dev), ndev);
-	if (ret != 0) {
-		dev_err(dev, "Could not request irq #%d\n", ndev->irq);
-		goto out_unreg_netdev;
+	for (i = 0; i < nq; i++)
+		tegra_hv_ivc_channel_reset(hvn->queues[i].ivck);
+
+	/* the interrupt requests must be the last action */
+	for (nirq = 0; nirq < nq; nirq++) {
+		q = &hvn->queues[nirq];
+		ret = devm_request_irq(dev, q->ivck->irq,
+				tegra_hv_net_interrupt, 0, dev_name(dev), q);
+		if (ret != 0) {
+			dev_err(dev, "Could not request irq #%d\n",
+				q->ivck->irq);
+			goto out_free_irq;
+		}
 	}
 
-	dev_info(dev, "ready\n");
+	dev_info(dev, "ready, %u queue(s)%s\n", nq,
+		 hvn->pack ? ", packing small frames" : "");
 
 	return 0;
 
-out_unreg_netdev:
+out_free_irq:
+	while (nirq--) {
+		q = &hvn->queues[nirq];
+		devm_free_irq(dev, q->ivck->irq, q);
+	}
 	unregister_netdev(ndev);
 
 out_free_wq:
-	netif_napi_del(&hvn->napi);
+	for (i = 0; i < nq; i++)
+		netif_napi_del(&hvn->queues[i].napi);
 	destroy_workqueue(hvn->xmit_wq);
 
 out_unreserve:
-	tegra_hv_ivc_unreserve(hvn->ivck);
-
-out_free_stats:
+	tegra_hv_net_unreserve_all(hvn);
 	free_percpu(hvn->stats);
 
 out_free_ndev:
 	free_netdev(ndev);
 
-out_of_put:
-	of_node_put(hv_dn);
-
 	return ret;
 }
 
@@ -827,13 +1184,23 @@ static int tegra_hv_net_remove(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	struct net_device *ndev = platform_get_drvdata(pdev);
 	struct tegra_hv_net *hvn = netdev_priv(ndev);
+	struct tegra_hv_net_queue *q;
+	unsigned int i;
 
 	platform_set_drvdata(pdev, NULL);
-	devm_free_irq(dev, ndev->irq, dev);
+	for (i = 0; i < hvn->num_queues; i++) {
+		q = &hvn->queues[i];
+		devm_free_irq(dev, q->ivck->irq, q);
+	}
 	unregister_netdev(ndev);
-	netif_napi_del(&hvn->napi);
+	for (i = 0; i < hvn->num_queues; i++) {
+		q = &hvn->queues[i];
+		netif_napi_del(&q->napi);
+		skb_queue_purge(&q->tx_q);
+		tegra_hv_net_rx_reset(q);
+	}
 	destroy_workqueue(hvn->xmit_wq);
-	tegra_hv_ivc_unreserve(hvn->ivck);
+	tegra_hv_net_unreserve_all(hvn);
 	free_percpu(hvn->stats);
 	free_netdev(ndev);
 
@@ -846,6 +1213,7 @@ static int tegra_hv_net_suspend(struct platform_device *pdev,
 {
 	struct net_device *ndev = platform_get_drvdata(pdev);
 	struct tegra_hv_net *hvn = netdev_priv(ndev);
+	unsigned int i;
 
 	/* If the netdev is not even running, no action */
 	if (!netif_running(ndev))
@@ -860,8 +1228,8 @@ static int tegra_hv_net_suspend(struct platform_device *pdev,
 
 	ndev->netdev_ops->ndo_stop(ndev);
 
-	/* tegra_hv_net_stop uses netif_stop_queue to disable the queue.
-	 * netif_stop_queue doesn't prevent xmit_transfer running on another
+	/* tegra_hv_net_stop uses netif_tx_stop_all_queues to disable the
+	 * queues. That doesn't prevent xmit_transfer running on another
 	 * cpu, so additionally we need netif_tx_disable
 	 */
 	netif_tx_disable(ndev);
@@ -870,12 +1238,14 @@ static int tegra_hv_net_suspend(struct platform_device *pdev,
 	 * there could be one queued or running already.
 	 * Cancel or wait for such a job
 	 */
-	cancel_work_sync(&hvn->xmit_work);
+	for (i = 0; i < hvn->num_queues; i++)
+		cancel_work_sync(&hvn->queues[i].xmit_work);
 
 	/* Workqueue should not be running at this point,
 	 * so disable irq
 	 */
-	disable_irq(ndev->irq);
+	for (i = 0; i < hvn->num_queues; i++)
+		disable_irq(hvn->queues[i].ivck->irq);
 
 	return 0;
 }
@@ -884,23 +1254,27 @@ static int tegra_hv_net_resume(struct platform_device *pdev)
 {
 	struct net_device *ndev = platform_get_drvdata(pdev);
 	struct tegra_hv_net *hvn = netdev_priv(ndev);
+	unsigned int i;
 
 	if (!netif_running(ndev))
 		return 0;
 
-	enable_irq(ndev->irq);
+	for (i = 0; i < hvn->num_queues; i++)
+		enable_irq(hvn->queues[i].ivck->irq);
 
 	ndev->netdev_ops->ndo_open(ndev);
 
 	/* Would wake the queue and mark the link enabled */
 	netif_device_attach(ndev);
 
-	 /* Start the queue blindly, in case the previous
+	 /* Start the queues blindly, in case the previous
 	  * work was cancelled during suspend
 	  * If there is no pending xmit,
 	  * the workqueue will wake up then exit gracefully
 	  */
-	queue_work_on(WORK_CPU_UNBOUND, hvn->xmit_wq, &hvn->xmit_work);
+	for (i = 0; i < hvn->num_queues; i++)
+		queue_work_on(WORK_CPU_UNBOUND, hvn->xmit_wq,
+			      &hvn->queues[i].xmit_work);
 
 	return 0;
 }
@@ -12,6 +12,9 @@
 #include <linux/of_platform.h>
 #include <linux/slab.h>
 #include <linux/interrupt.h>
+#include <linux/completion.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/tegra-pcie-edma.h>
 #include <linux/limits.h>
 #include "tegra-pcie-dma-osi.h"
@@ -31,6 +34,11 @@
 
 #define INCR_DESC(idx, i) ((idx) = ((idx) + (i)) % (ch->desc_sz))
 
+/** Register space emulated by the software engine */
+#define EDMA_SW_REGS_SIZE	SZ_4K
+/** Descriptors the software engine handles per channel and pass */
+#define EDMA_SW_BUDGET		64
+
 struct edma_chan {
 	void *desc;
 	void __iomem *remap_desc;
@@ -39,20 +47,31 @@ struct edma_chan {
 	uint32_t desc_sz;
 	/** Index from where cleanup needs to be done */
 	volatile uint32_t r_idx;
-	/** Index from where descriptor update is needed */
-	volatile uint32_t w_idx;
-	struct mutex lock;
-	wait_queue_head_t wq;
-	edma_chan_type_t type;
-	u64 wcount;
+	/**
+	 * Free running descriptor counts. Submitters reserve a range by
+	 * advancing reserve, fill it and then advance commit in reservation
+	 * order. rcount counts descriptors reclaimed by the IRQ thread.
+	 */
+	atomic_t reserve;
+	atomic_t commit;
 	u64 rcount;
-	bool busy;
-	bool pcs;
-	bool db_pos;
+	/** Number of submitters between reserve and commit */
+	atomic_t submitters;
+	/** Protects ring[] callbacks against sync submit timeout */
+	spinlock_t ring_lock;
+	/** Software engine: free running position of the next descriptor */
+	u32 sw_pos;
+	edma_chan_type_t type;
 	/** This field is updated to abort or de-init to stop further xfer submits */
 	edma_xfer_status_t st;
 };
 
+/** Completion used by sync channel submitters */
+struct edma_sync_waiter {
+	struct completion done;
+	edma_xfer_status_t st;
+};
+
 struct edma_prv {
 	u32 edma_desc_size;
 	int irq;
@@ -69,6 +88,10 @@ struct edma_prv {
 	struct edma_chan rx[DMA_RD_CHNL_NUM];
 	/* BIT(0) - Write initialized, BIT(1) - Read initialized */
 	uint32_t ch_init;
+	/** Software stand-in for the engine, edma_base is then plain memory */
+	bool is_sw_dma;
+	struct tegra_pcie_edma_sw_info sw;
+	struct work_struct sw_work;
 };
 
 /** TODO: Define osi_ll_init strcuture and make this as OSI */
@@ -189,11 +212,11 @@ static inline int edma_ch_init(struct edma_prv *prv, struct edma_chan *ch)
 		db->llp.sar_high = upper_32_bits(addr);
 		db->llp.ctrl_reg.ctrl_e.llp = 1;
 	}
-	ch->wcount = 0;
+	atomic_set(&ch->reserve, 0);
+	atomic_set(&ch->commit, 0);
 	ch->rcount = 0;
-	ch->w_idx = 0;
 	ch->r_idx = 0;
-	ch->pcs = 1;
+	ch->sw_pos = 0;
 	ch->st = EDMA_XFER_SUCCESS;
 
 	if (!ch->ring) {
@@ -254,59 +277,85 @@ static inline u32 get_dma_idx_from_llp(struct edma_prv *prv, u32 chan, struct ed
 	return cur_idx % (ch->desc_sz);
 }
 
-static inline void process_r_idx(struct edma_chan *ch, edma_xfer_status_t st, u32 idx)
+static inline u32 edma_w_idx(struct edma_chan *ch)
+{
+	return (u32)atomic_read(&ch->commit) & (ch->desc_sz - 1U);
+}
+
+/** Producer cycle state of descriptor at free running position pos */
+static inline bool edma_pos_pcs(struct edma_chan *ch, u32 pos)
+{
+	return !((pos / ch->desc_sz) & 1U);
+}
+
+/** Reclaim up to budget descriptors from r_idx to idx, returns count */
+static inline u32 process_r_idx(struct edma_chan *ch, edma_xfer_status_t st, u32 idx,
+				u32 budget)
 {
 	u32 count = 0;
 	struct edma_hw_desc *dma_ll_virt;
 	struct edma_dblock *db;
 	struct tegra_pcie_edma_xfer_info *ring;
+	edma_complete_t *complete;
+	void *priv;
 
-	while ((ch->r_idx != idx) && (count < ch->desc_sz)) {
+	while ((ch->r_idx != idx) && (count < budget)) {
 		count++;
 		ring = &ch->ring[ch->r_idx];
 		db = (struct edma_dblock *)ch->desc + ch->r_idx / 2;
 		dma_ll_virt = &db->desc[ch->r_idx % 2];
-		INCR_DESC(ch->r_idx, 1);
-		ch->rcount++;
 		/* clear lie and rie if any set */
 		dma_ll_virt->ctrl_reg.ctrl_e.lie = 0;
 		dma_ll_virt->ctrl_reg.ctrl_e.rie = 0;
-		if (ch->type == EDMA_CHAN_XFER_ASYNC && ring->complete) {
-			ring->complete(ring->priv, st, NULL);
-			/* Clear ring callback */
-			ring->complete = NULL;
-		}
+
+		spin_lock(&ch->ring_lock);
+		complete = ring->complete;
+		priv = ring->priv;
+		/* Clear ring callback */
+		ring->complete = NULL;
+		spin_unlock(&ch->ring_lock);
+
+		/* Slot may be reserved again once rcount moves past it */
+		INCR_DESC(ch->r_idx, 1);
+		smp_store_release(&ch->rcount, ch->rcount + 1);
+
+		if (complete)
+			complete(priv, st, NULL);
 	}
+
+	return count;
 }
 
-static inline void process_ch_irq(struct edma_prv *prv, u32 chan, struct edma_chan *ch,
-				  u32 type)
+static inline u32 process_ch_irq(struct edma_prv *prv, u32 chan, struct edma_chan *ch,
+				 u32 type, u32 budget)
 {
-	u32 idx;
+	u32 idx, count = 0;
 
 	idx = get_dma_idx_from_llp(prv, chan, ch, type);
 
-	if (ch->type == EDMA_CHAN_XFER_SYNC) {
-		if (ch->busy) {
-			ch->busy = false;
-			wake_up(&ch->wq);
-		} else
-			dev_info(prv->dev, "SYNC mode with chan %d busy not set r_idx %d, cur_idx %d, w_idx is %d\n",
-				 chan, ch->r_idx, idx, ch->w_idx);
-	}
-
 	if (ch->st == EDMA_XFER_ABORT) {
 		dev_info(prv->dev, "Abort: ch %d at r_idx %d->idx %d, w_idx is %d\n", chan,
-			 ch->r_idx, idx, ch->w_idx);
+			 ch->r_idx, idx, edma_w_idx(ch));
 		if (ch->r_idx == idx)
 			goto process_abort;
 	}
 
-	process_r_idx(ch, EDMA_XFER_SUCCESS, idx);
+	count = process_r_idx(ch, EDMA_XFER_SUCCESS, idx, budget);
 
 process_abort:
 	if (ch->st == EDMA_XFER_ABORT)
-		process_r_idx(ch, EDMA_XFER_ABORT, ch->w_idx);
+		count += process_r_idx(ch, EDMA_XFER_ABORT, edma_w_idx(ch), ch->desc_sz);
+
+	return count;
+}
+
+/** Wait for submitters that already passed the channel status check */
+static inline void edma_wait_submitters(struct edma_chan *ch)
+{
+	/* Pairs with smp_mb__after_atomic() in tegra_pcie_edma_submit_xfer() */
+	smp_mb();
+	while (atomic_read(&ch->submitters))
+		cpu_relax();
 }
 
 static irqreturn_t edma_irq(int irq, void *cookie)
@@ -317,11 +366,10 @@ static irqreturn_t edma_irq(int irq, void *cookie)
 	return IRQ_WAKE_THREAD;
 }
 
-static irqreturn_t edma_irq_handler(int irq, void *cookie)
+static void edma_process_irq(struct edma_prv *prv)
 {
-	struct edma_prv *prv = (struct edma_prv *)cookie;
 	int bit = 0;
-	u32 val, i = 0;
+	u32 val, i = 0, budget, done;
 	struct edma_chan *chan[2] = {&prv->tx[0], &prv->rx[0]};
 	struct edma_chan *ch;
 	u32 int_status_off[2] = {DMA_WRITE_INT_STATUS_OFF, DMA_READ_INT_STATUS_OFF};
@@ -356,10 +404,9 @@ static irqreturn_t edma_irq_handler(int irq, void *cookie)
 				dma_common_wr(prv->edma_base, OSI_BIT(16 + bit) | OSI_BIT(bit),
 					      int_clear_off[i]);
 				/** wait until exisitng xfer submit completed */
-				mutex_lock(&ch->lock);
-				mutex_unlock(&ch->lock);
+				edma_wait_submitters(ch);
 
-				process_ch_irq(prv, bit, ch, i);
+				process_ch_irq(prv, bit, ch, i, ch->desc_sz);
 
 				edma_ch_init(prv, ch);
 				edma_ll_ch_init(prv->edma_base, bit, ch->dma_iova, (i == 0),
@@ -370,20 +417,153 @@ static irqreturn_t edma_irq_handler(int irq, void *cookie)
 		} else {
 			for (bit = 0; bit < mode_cnt[i]; bit++) {
 				ch = chan[i] + bit;
-				if (OSI_BIT(bit) & val) {
+				if (!(OSI_BIT(bit) & val))
+					continue;
+				/*
+				 * Poll until no more progress, up to one ring worth of
+				 * descriptors. Status is cleared before every LLP read, so
+				 * completions racing with the last pass raise a new IRQ
+				 * while those seen in between are reaped without one.
+				 */
+				budget = ch->desc_sz;
+				do {
 					dma_common_wr(prv->edma_base, OSI_BIT(bit),
 						      int_clear_off[i]);
-					process_ch_irq(prv, bit, ch, i);
-				}
+					done = process_ch_irq(prv, bit, ch, i, budget);
+					budget -= done;
+				} while (done && budget);
 			}
 		}
 	}
+}
+
+static irqreturn_t edma_irq_handler(int irq, void *cookie)
+{
+	struct edma_prv *prv = (struct edma_prv *)cookie;
+
+	edma_process_irq(prv);
 
 	/* Must enable before exit */
 	enable_irq(irq);
 	return IRQ_HANDLED;
 }
 
+static void *edma_sw_xlate(struct edma_prv *prv, u32 low, u32 high, u32 sz)
+{
+	dma_addr_t addr = ((u64)high << 32) | low;
+
+	if (addr < prv->sw.base || sz > prv->sw.size ||
+	    addr - prv->sw.base > prv->sw.size - sz)
+		return NULL;
+
+	return prv->sw.virt + (addr - prv->sw.base);
+}
+
+/**
+ * Software engine: copy descriptors the producer handed over, the same way HW
+ * walks the linked list, and move LLP past them. Returns INT_STATUS bits.
+ */
+static u32 edma_sw_run_ch(struct edma_prv *prv, struct edma_chan *ch, u32 chan, u32 type)
+{
+	u32 llp_low_off[2] = {DMA_LLP_LOW_OFF_WRCH, DMA_LLP_LOW_OFF_RDCH};
+	u32 llp_high_off[2] = {DMA_LLP_HIGH_OFF_WRCH, DMA_LLP_HIGH_OFF_RDCH};
+	u32 i, idx, mask = ch->desc_sz - 1U, status = 0;
+	struct edma_hw_desc *dma_ll_virt;
+	struct edma_dblock *db;
+	void *src, *dst;
+	dma_addr_t llp;
+
+	for (i = 0; i < EDMA_SW_BUDGET; i++) {
+		idx = ch->sw_pos & mask;
+		db = (struct edma_dblock *)ch->desc + (idx / 2);
+		dma_ll_virt = &db->desc[idx % 2];
+		/* HW stops at the first descriptor whose CB does not match CCS */
+		if (dma_ll_virt->ctrl_reg.ctrl_e.cb != edma_pos_pcs(ch, ch->sw_pos))
+			break;
+		dma_rmb();
+
+		src = edma_sw_xlate(prv, dma_ll_virt->sar_low, dma_ll_virt->sar_high,
+				    dma_ll_virt->size);
+		dst = edma_sw_xlate(prv, dma_ll_virt->dar_low, dma_ll_virt->dar_high,
+				    dma_ll_virt->size);
+		if (!src || !dst) {
+			dev_err_ratelimited(prv->dev, "sw engine: ch %d desc %d outside window\n",
+					    chan, idx);
+			return OSI_BIT(16 + chan);
+		}
+		memcpy(dst, src, dma_ll_virt->size);
+		if (dma_ll_virt->ctrl_reg.ctrl_e.lie)
+			status |= OSI_BIT(chan);
+
+		ch->sw_pos++;
+		idx = ch->sw_pos & mask;
+		llp = ch->dma_iova + (idx / 2) * sizeof(struct edma_dblock) +
+		      (idx % 2) * sizeof(struct edma_hw_desc);
+		dma_channel_wr(prv->edma_base, chan, lower_32_bits(llp), llp_low_off[type]);
+		dma_channel_wr(prv->edma_base, chan, upper_32_bits(llp), llp_high_off[type]);
+	}
+
+	return status;
+}
+
+/** Software engine pass over all channels, followed by the IRQ processing */
+static void edma_sw_work(struct work_struct *work)
+{
+	struct edma_prv *prv = container_of(work, struct edma_prv, sw_work);
+	struct edma_chan *chan[2] = {&prv->tx[0], &prv->rx[0]};
+	u32 eng_off[2] = {DMA_WRITE_ENGINE_EN_OFF, DMA_READ_ENGINE_EN_OFF};
+	u32 int_status_off[2] = {DMA_WRITE_INT_STATUS_OFF, DMA_READ_INT_STATUS_OFF};
+	u32 mode_cnt[2] = {DMA_WR_CHNL_NUM, DMA_RD_CHNL_NUM};
+	u32 i, bit, pos, status, raised = 0;
+	struct edma_chan *ch;
+	bool more = false;
+
+	for (i = 0; i < 2; i++) {
+		if (!(dma_common_rd(prv->edma_base, eng_off[i]) & WRITE_ENABLE))
+			continue;
+
+		status = 0;
+		for (bit = 0; bit < mode_cnt[i]; bit++) {
+			ch = chan[i] + bit;
+			if (!ch->ring)
+				continue;
+			pos = ch->sw_pos;
+			status |= edma_sw_run_ch(prv, ch, bit, i);
+			if (ch->sw_pos - pos == EDMA_SW_BUDGET)
+				more = true;
+		}
+		dma_common_wr(prv->edma_base, status, int_status_off[i]);
+		raised |= status;
+	}
+
+	if (raised) {
+		edma_process_irq(prv);
+		/* INT_CLEAR is not wired to INT_STATUS in memory */
+		dma_common_wr(prv->edma_base, 0, int_status_off[0]);
+		dma_common_wr(prv->edma_base, 0, int_status_off[1]);
+	}
+
+	if (more)
+		queue_work(system_unbound_wq, &prv->sw_work);
+}
+
+static inline void edma_ring_doorbell(struct edma_prv *prv, u32 chan, edma_xfer_type_t type)
+{
+	u32 doorbell_off[2] = {DMA_WRITE_DOORBELL_OFF, DMA_READ_DOORBELL_OFF};
+
+	dma_common_wr(prv->edma_base, chan, doorbell_off[type]);
+	if (prv->is_sw_dma)
+		queue_work(system_unbound_wq, &prv->sw_work);
+}
+
+static void edma_unmap_base(struct edma_prv *prv)
+{
+	if (prv->is_sw_dma)
+		kfree((__force void *)prv->edma_base);
+	else
+		devm_iounmap(prv->dev, prv->edma_base);
+}
+
 void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info)
 {
 	struct edma_prv *prv;
@@ -458,6 +638,20 @@ void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info)
 			dev_err(prv->dev, "failed to get intr interrupt\n");
 			goto put_dev;
 		};
+	} else if (info->sw != NULL) {
+		if (!info->sw->dev || !info->sw->virt || !info->sw->size) {
+			pr_err("%s: incomplete sw engine info\n", __func__);
+			goto free_priv;
+		}
+
+		prv->dev = info->sw->dev;
+		prv->sw = *info->sw;
+		prv->is_sw_dma = true;
+		prv->edma_base = (__force void __iomem *)kzalloc(EDMA_SW_REGS_SIZE, GFP_KERNEL);
+		if (!prv->edma_base)
+			goto free_priv;
+		INIT_WORK(&prv->sw_work, edma_sw_work);
+		dev_info(prv->dev, "%s: using software engine\n", __func__);
 	} else {
 		pr_err("Neither device node nor edma remote available");
 		goto free_priv;
@@ -500,6 +694,7 @@ void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info)
 
 			prv->ch_init |= OSI_BIT(j);
 
+			spin_lock_init(&ch->ring_lock);
 			if (edma_ch_init(prv, ch) < 0)
 				goto free_dma_desc;
 
@@ -508,6 +703,10 @@ void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info)
 		}
 	}
 
+	/* Software engine runs the IRQ processing from its own work */
+	if (prv->is_sw_dma)
+		goto hw_init;
+
 	prv->irq_name = kasprintf(GFP_KERNEL, "%s_edma_lib", dev_name(prv->dev));
 	if (!prv->irq_name)
 		goto free_ring;
@@ -520,16 +719,7 @@ void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info)
 		goto free_irq_name;
 	}
 
-	for (i = 0; i < DMA_WR_CHNL_NUM; i++) {
-		mutex_init(&prv->tx[i].lock);
-		init_waitqueue_head(&prv->tx[i].wq);
-	}
-
-	for (i = 0; i < DMA_RD_CHNL_NUM; i++) {
-		mutex_init(&prv->rx[i].lock);
-		init_waitqueue_head(&prv->rx[i].wq);
-	}
-
+hw_init:
 	edma_hw_init(prv, false);
 	edma_hw_init(prv, true);
 	dev_info(prv->dev, "%s: success", __func__);
@@ -558,9 +748,9 @@ free_dma_desc:
 		}
 	}
 dma_iounmap:
-	devm_iounmap(prv->dev, prv->edma_base);
+	edma_unmap_base(prv);
 put_dev:
-	if (!prv->is_remote_dma)
+	if (!prv->is_remote_dma && !prv->is_sw_dma)
 		put_device(prv->dev);
 free_priv:
 	kfree(prv);
@@ -568,22 +758,84 @@ free_priv:
 }
 EXPORT_SYMBOL(tegra_pcie_edma_initialize);
 
+static void edma_sync_complete(void *priv, edma_xfer_status_t status,
+			       struct tegra_pcie_edma_desc *desc)
+{
+	struct edma_sync_waiter *waiter = priv;
+
+	waiter->st = status;
+	complete(&waiter->done);
+}
+
+/**
+ * Fill reserved descriptors starting at free running position pos. Payload of
+ * all descriptors is written before any CB so that HW stops at the first
+ * descriptor of this range until it is complete.
+ */
+static u64 edma_fill_desc(struct edma_prv *prv, struct edma_chan *ch, u32 pos,
+			  struct tegra_pcie_edma_xfer_info *tx_info)
+{
+	struct edma_hw_desc *dma_ll_virt;
+	struct edma_dblock *db;
+	u32 i, idx, mask = ch->desc_sz - 1U;
+	u64 total_sz = 0;
+	bool pcs;
+
+	for (i = 0; i < tx_info->nents; i++) {
+		idx = (pos + i) & mask;
+		db = (struct edma_dblock *)ch->desc + (idx / 2);
+		dma_ll_virt = &db->desc[idx % 2];
+		dma_ll_virt->size = tx_info->desc[i].sz;
+		/* calculate number of packets and add those many headers */
+		total_sz += ((tx_info->desc[i].sz / ch->desc_sz) + 1) * 30;
+		total_sz += tx_info->desc[i].sz;
+		dma_ll_virt->sar_low = lower_32_bits(tx_info->desc[i].src);
+		dma_ll_virt->sar_high = upper_32_bits(tx_info->desc[i].src);
+		dma_ll_virt->dar_low = lower_32_bits(tx_info->desc[i].dst);
+		dma_ll_virt->dar_high = upper_32_bits(tx_info->desc[i].dst);
+		/* Set LIE or RIE in last element */
+		if (i == tx_info->nents - 1) {
+			dma_ll_virt->ctrl_reg.ctrl_e.lie = 1;
+			dma_ll_virt->ctrl_reg.ctrl_e.rie = !!prv->is_remote_dma;
+		}
+	}
+
+	/* CB should be updated last in the descriptor */
+	dma_wmb();
+
+	for (i = 0; i < tx_info->nents; i++) {
+		idx = (pos + i) & mask;
+		pcs = edma_pos_pcs(ch, pos + i);
+		db = (struct edma_dblock *)ch->desc + (idx / 2);
+		dma_ll_virt = &db->desc[idx % 2];
+		dma_ll_virt->ctrl_reg.ctrl_e.cb = pcs;
+		if (idx % 2) {
+			/* Link element of the last block toggles the cycle */
+			db->llp.ctrl_reg.ctrl_e.cb = (idx == mask) ? !pcs : pcs;
+		}
+	}
+
+	/* Read back CB to avoid OOO in case of remote dma. */
+	pcs = dma_ll_virt->ctrl_reg.ctrl_e.cb;
+	dev_dbg(prv->dev, "filled %d nents at %d, pcs %d\n", tx_info->nents, pos & mask, pcs);
+
+	return total_sz;
+}
+
 edma_xfer_status_t tegra_pcie_edma_submit_xfer(void *cookie,
 						struct tegra_pcie_edma_xfer_info *tx_info)
 {
 	struct edma_prv *prv = (struct edma_prv *)cookie;
 	struct edma_chan *ch;
-	struct edma_hw_desc *dma_ll_virt;
-	struct edma_dblock *db;
-	int i, ret;
+	struct edma_sync_waiter waiter;
+	long ret;
 	u64 total_sz = 0;
 	edma_xfer_status_t st = EDMA_XFER_SUCCESS;
-	u32 avail;
-	struct tegra_pcie_edma_xfer_info *ring;
+	u32 start, end, used, mask;
+	bool cleared = false;
+	struct tegra_pcie_edma_xfer_info *ring = NULL;
 	u32 int_status_off[2] = {DMA_WRITE_INT_STATUS_OFF, DMA_READ_INT_STATUS_OFF};
-	u32 doorbell_off[2] = {DMA_WRITE_DOORBELL_OFF, DMA_READ_DOORBELL_OFF};
 	u32 mode_cnt[2] = {DMA_WR_CHNL_NUM, DMA_RD_CHNL_NUM};
-	bool pcs;
 
 	if (!prv || !tx_info || tx_info->nents == 0 || !tx_info->desc ||
 	    tx_info->channel_num >= mode_cnt[tx_info->type])
@@ -598,99 +850,103 @@ edma_xfer_status_t tegra_pcie_edma_submit_xfer(void *cookie,
 	if ((tx_info->complete == NULL) && (ch->type == EDMA_CHAN_XFER_ASYNC))
 		return EDMA_XFER_FAIL_INVAL_INPUTS;
 
-	/* Get hold of the hardware - locking */
-	mutex_lock(&ch->lock);
+	mask = ch->desc_sz - 1U;
 
-	/* Channel busy flag should be updated before channel status check */
-	ch->busy = true;
+	/*
+	 * Reserve to commit window does not sleep and is kept short, since
+	 * later submitters spin until earlier ones commit.
+	 */
+	local_bh_disable();
+	atomic_inc(&ch->submitters);
+	/* Submitter count should be updated before channel status check */
+	smp_mb__after_atomic();
 
-	if (ch->st != EDMA_XFER_SUCCESS) {
+	if (READ_ONCE(ch->st) != EDMA_XFER_SUCCESS) {
 		st = ch->st;
-		goto unlock;
+		goto out;
 	}
 
-	avail = (ch->r_idx - ch->w_idx - 1U) & (ch->desc_sz - 1U);
-	if (tx_info->nents > avail) {
-		dev_dbg(prv->dev, "Descriptors full. w_idx %d. r_idx %d, avail %d, req %d\n",
-			ch->w_idx, ch->r_idx, avail, tx_info->nents);
-		st = EDMA_XFER_FAIL_NOMEM;
-		goto unlock;
-	}
+	do {
+		start = (u32)atomic_read(&ch->reserve);
+		used = start - (u32)smp_load_acquire(&ch->rcount);
+		if (tx_info->nents > (mask - used)) {
+			dev_dbg(prv->dev, "Descriptors full. w_idx %d. r_idx %d, avail %d, req %d\n",
+				start & mask, ch->r_idx, mask - used, tx_info->nents);
+			st = EDMA_XFER_FAIL_NOMEM;
+			goto out;
+		}
+		end = start + tx_info->nents;
+	} while ((u32)atomic_cmpxchg(&ch->reserve, start, end) != start);
 
 	dev_dbg(prv->dev, "xmit for %d nents at %d widx and %d ridx\n",
-		tx_info->nents, ch->w_idx, ch->r_idx);
-	db = (struct edma_dblock *)ch->desc + (ch->w_idx/2);
-	for (i = 0; i < tx_info->nents; i++) {
-		dma_ll_virt = &db->desc[ch->db_pos];
-		dma_ll_virt->size = tx_info->desc[i].sz;
-		/* calculate number of packets and add those many headers */
-		total_sz += ((tx_info->desc[i].sz / ch->desc_sz) + 1) * 30;
-		total_sz += tx_info->desc[i].sz;
-		dma_ll_virt->sar_low = lower_32_bits(tx_info->desc[i].src);
-		dma_ll_virt->sar_high = upper_32_bits(tx_info->desc[i].src);
-		dma_ll_virt->dar_low = lower_32_bits(tx_info->desc[i].dst);
-		dma_ll_virt->dar_high = upper_32_bits(tx_info->desc[i].dst);
-		/* Set LIE or RIE in last element */
-		if (i == tx_info->nents - 1) {
-			dma_ll_virt->ctrl_reg.ctrl_e.lie = 1;
-			dma_ll_virt->ctrl_reg.ctrl_e.rie = !!prv->is_remote_dma;
-		}
-		/* CB should be updated last in the descriptor */
-		dma_ll_virt->ctrl_reg.ctrl_e.cb = ch->pcs;
-		ch->db_pos = !ch->db_pos;
-		avail = ch->w_idx;
-		ch->w_idx++;
-		if (!ch->db_pos) {
-			ch->wcount = 0;
-			db->llp.ctrl_reg.ctrl_e.cb = ch->pcs;
-			if (ch->w_idx == ch->desc_sz) {
-				ch->pcs = !ch->pcs;
-				db->llp.ctrl_reg.ctrl_e.cb = ch->pcs;
-				dev_dbg(prv->dev, "Toggled pcs at w_idx %d\n", ch->w_idx);
-				ch->w_idx = 0;
-			}
-			db = (struct edma_dblock *)ch->desc + (ch->w_idx/2);
-		}
-	}
+		tx_info->nents, start & mask, ch->r_idx);
 
-	ring = &ch->ring[avail];
-	ring->complete = tx_info->complete;
-	ring->priv = tx_info->priv;
+	/* Callback is set before HW can complete the last descriptor */
+	ring = &ch->ring[(end - 1U) & mask];
+	if (ch->type == EDMA_CHAN_XFER_SYNC) {
+		init_completion(&waiter.done);
+		waiter.st = EDMA_XFER_SUCCESS;
+		ring->complete = edma_sync_complete;
+		ring->priv = &waiter;
+	} else {
+		ring->complete = tx_info->complete;
+		ring->priv = tx_info->priv;
+	}
 	ring->nents = tx_info->nents;
 	ring->desc = tx_info->desc;
 
-	/* Read back CB to avoid OOO in case of remote dma. */
-	pcs = dma_ll_virt->ctrl_reg.ctrl_e.cb;
+	total_sz = edma_fill_desc(prv, ch, start, tx_info);
+
+	/* Commit in reservation order */
+	while ((u32)atomic_read(&ch->commit) != start)
+		cpu_relax();
 
 	/* desc write should not go OOO wrt DMA DB ring */
 	wmb();
 
-	dma_common_wr(prv->edma_base, tx_info->channel_num, doorbell_off[tx_info->type]);
+	atomic_set(&ch->commit, end);
+	smp_mb();
+	/*
+	 * Coalesce doorbells: if another submitter already reserved after us it
+	 * is bound to commit and ring for both ranges.
+	 */
+	if ((u32)atomic_read(&ch->reserve) == end)
+		edma_ring_doorbell(prv, tx_info->channel_num, tx_info->type);
+
+out:
+	atomic_dec(&ch->submitters);
+	local_bh_enable();
+
+	if (st != EDMA_XFER_SUCCESS || ch->type != EDMA_CHAN_XFER_SYNC)
+		return st;
+
+	ret = wait_for_completion_timeout(&waiter.done,
+					  msecs_to_jiffies((uint32_t)(GET_SYNC_TIMEOUT(total_sz))));
+	if (ret == 0) {
+		/* Detach waiter unless the IRQ thread already picked it up */
+		spin_lock(&ch->ring_lock);
+		if (ring->priv == &waiter) {
+			ring->complete = NULL;
+			ring->priv = NULL;
+			cleared = true;
+		}
+		spin_unlock(&ch->ring_lock);
 
-	if (ch->type == EDMA_CHAN_XFER_SYNC) {
-		ret = wait_event_timeout(ch->wq, !ch->busy,
-					 msecs_to_jiffies((uint32_t)(GET_SYNC_TIMEOUT(total_sz))));
-		if (ret == 0) {
-			/* dummy print to avoid misra-c voilations */
-			dev_dbg(prv->dev, "read back pcs: %d\n", pcs);
+		if (cleared) {
 			dev_err(prv->dev, "%s: timeout at %d ch, w_idx(%d), r_idx(%d)\n",
-				__func__, tx_info->channel_num, ch->w_idx,
+				__func__, tx_info->channel_num, edma_w_idx(ch),
 				ch->r_idx);
 			dev_err(prv->dev, "%s: int status 0x%x", __func__,
 				dma_common_rd(prv->edma_base, int_status_off[tx_info->type]));
-			st = EDMA_XFER_FAIL_TIMEOUT;
-			goto unlock;
-		} else {
-			st = ch->st;
+			return EDMA_XFER_FAIL_TIMEOUT;
 		}
-		dev_dbg(prv->dev, "xmit done for %d nents at %d widx and %d ridx\n",
-			tx_info->nents, ch->w_idx, ch->r_idx);
+		wait_for_completion(&waiter.done);
 	}
-unlock:
-	/* release hardware - unlocking */
-	mutex_unlock(&ch->lock);
 
-	return st;
+	dev_dbg(prv->dev, "xmit done for %d nents at %d widx and %d ridx\n",
+		tx_info->nents, edma_w_idx(ch), ch->r_idx);
+
+	return waiter.st;
 }
 EXPORT_SYMBOL(tegra_pcie_edma_submit_xfer);
 
@@ -707,34 +963,33 @@ void tegra_pcie_edma_deinit(void *cookie)
 	chan[0] = &prv->tx[0];
 	chan[1] = &prv->rx[0];
 
-	/* wake up xfer function waiting on dma completion in sync mode */
+	/* stop further xfer submits, sync waiters are woken by DEINIT below */
 	for (j = 0; j < 2; j++) {
 		for (i = 0; i < mode_cnt[j]; i++) {
 			ch = chan[j] + i;
 			ch->st = EDMA_XFER_DEINIT;
-			if ((ch->type == EDMA_CHAN_XFER_SYNC) && ch->busy) {
-				ch->busy = false;
-				wake_up(&ch->wq);
-			}
 			/** wait until exisitng xfer submit completed */
-			mutex_lock(&ch->lock);
-			mutex_unlock(&ch->lock);
+			edma_wait_submitters(ch);
 		}
 	}
 
 	edma_hw_deinit(cookie, false);
 	edma_hw_deinit(cookie, true);
 
-	synchronize_irq(prv->irq);
-	free_irq(prv->irq, prv);
-	kfree(prv->irq_name);
+	if (prv->is_sw_dma) {
+		cancel_work_sync(&prv->sw_work);
+	} else {
+		synchronize_irq(prv->irq);
+		free_irq(prv->irq, prv);
+		kfree(prv->irq_name);
+	}
 
 	for (j = 0; j < 2; j++) {
 		for (i = 0; i < mode_cnt[j]; i++) {
 			ch = chan[j] + i;
 
 			if (prv->ch_init & OSI_BIT(i))
-				process_r_idx(ch, EDMA_XFER_DEINIT, ch->w_idx);
+				process_r_idx(ch, EDMA_XFER_DEINIT, edma_w_idx(ch), ch->desc_sz);
 
 			if (prv->is_remote_dma && ch->desc)
 				devm_iounmap(prv->dev, ch->remap_desc);
@@ -746,8 +1001,8 @@ void tegra_pcie_edma_deinit(void *cookie)
 		}
 	}
 
-	devm_iounmap(prv->dev, prv->edma_base);
-	if (!prv->is_remote_dma)
+	edma_unmap_base(prv);
+	if (!prv->is_remote_dma && !prv->is_sw_dma)
 		put_device(prv->dev);
 	kfree(prv);
 }
@@ -62,6 +62,8 @@ struct pcie_epf_dma {
 	u32 nents;
 	struct tegra_pcie_edma_desc *ll_desc;
 	struct edmalib_common edma;
+	/* Run edmalib_loopback on the software engine instead of the EP eDMA */
+	bool edma_sw;
 };
 
 struct edma_desc {
@@ -908,6 +910,47 @@ static int edmalib_test(struct seq_file *s, void *data)
 	return edmalib_common_test(&epfnv->edma);
 }
 
+/* debugfs to measure local WR channel throughput, on HW or on the software engine */
+static int edmalib_loopback(struct seq_file *s, void *data)
+{
+	struct pcie_epf_dma *epfnv = (struct pcie_epf_dma *)
+						dev_get_drvdata(s->private);
+	struct pcie_epf_bar0 *epf_bar0 = (struct pcie_epf_bar0 *)
+						epfnv->bar0_virt;
+	struct edmalib_common *edma = &epfnv->edma;
+
+	edma->fdev = epfnv->fdev;
+	edma->bar0_virt = epfnv->bar0_virt;
+	edma->src_dma_addr = epf_bar0->ep_phy_addr + BAR0_DMA_BUF_OFFSET;
+	edma->src_virt = epfnv->bar0_virt + BAR0_DMA_BUF_OFFSET;
+	edma->dma_base = epfnv->dma_base;
+	edma->dma_size = epfnv->dma_size;
+	edma->stress_count = epfnv->stress_count;
+	edma->edma_ch = epfnv->edma_ch;
+	edma->nents = epfnv->nents;
+	edma->of_node = epfnv->cdev->of_node;
+
+	if (epfnv->edma_sw) {
+		/* Copy within the BAR0 DMA buffer, which the CPU can check */
+		edma->sw.dev = epfnv->cdev;
+		edma->sw.base = edma->src_dma_addr;
+		edma->sw.virt = edma->src_virt;
+		edma->sw.size = BAR0_DMA_BUF_SIZE;
+		edma->dst_dma_addr = edma->src_dma_addr + BAR0_DMA_BUF_SIZE / 2;
+		edma->dst_virt = edma->src_virt + BAR0_DMA_BUF_SIZE / 2;
+	} else {
+		if (!epf_bar0->rp_phy_addr) {
+			dev_err(epfnv->fdev, "RP DMA address is null\n");
+			return -1;
+		}
+		memset(&edma->sw, 0, sizeof(edma->sw));
+		edma->dst_dma_addr = epf_bar0->rp_phy_addr + BAR0_DMA_BUF_OFFSET;
+		edma->dst_virt = NULL;
+	}
+
+	return edmalib_common_loopback(edma, s);
+}
+
 /* debugfs to perform direct & LL DMA and do CRC check */
 static int sanity_test(struct seq_file *s, void *data)
 {
@@ -1354,6 +1397,10 @@ static void init_debugfs(struct pcie_epf_dma *epfnv)
 				    epfnv->debugfs, async_dma_test);
 	debugfs_create_devm_seqfile(epfnv->fdev, "edmalib_test", epfnv->debugfs,
 				    edmalib_test);
+	debugfs_create_devm_seqfile(epfnv->fdev, "edmalib_loopback", epfnv->debugfs,
+				    edmalib_loopback);
+
+	debugfs_create_bool("edma_sw", 0644, epfnv->debugfs, &epfnv->edma_sw);
 
 	debugfs_create_u32("dma_size", 0644, epfnv->debugfs, &epfnv->dma_size);
 	epfnv->dma_size = SZ_1M;
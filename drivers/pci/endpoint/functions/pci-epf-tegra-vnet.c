@@ -28,6 +28,10 @@
 
 #define BAR0_SIZE SZ_4M
 
+/* EP_MEM/HOST_MEM space of queue 1 onwards: counters, full & empty rings */
+#define TVNET_QUEUE_MEM_SIZE(cnt) \
+	(sizeof(cnt) + (2 * RING_COUNT * sizeof(struct data_msg)))
+
 enum bar0_amap_type {
 	META_DATA,
 	SIMPLE_IRQ,
@@ -53,6 +57,36 @@ struct irqsp_data {
 	struct device *dev;
 };
 
+struct pci_epf_tvnet;
+
+/*
+ * Data queue pair, Tx uses DMA write channel and Rx the DMA read channel
+ * (programmed by host) of same index.
+ */
+struct tvnet_queue {
+	struct pci_epf_tvnet *tvnet;
+	struct napi_struct napi;
+	u32 idx;
+	u32 dma_ch;
+	/* Only data msg rings and counters are used, ctrl ones are in tvnet */
+	struct ep_ring_buf ep_ring_buf;
+	struct host_ring_buf host_ring_buf;
+	struct list_head h2ep_empty_list;
+	/* To protect h2ep empty list */
+	spinlock_t h2ep_empty_lock;
+	struct tvnet_dma_desc *ep_dma_virt;
+	dma_addr_t ep_dma_iova;
+	struct dma_desc_cnt desc_cnt;
+	/* Tx packets queued to DMA, doorbell rung once per batch */
+	struct tvnet_tx_buf tx_pending[TVNET_TX_BATCH];
+	u32 tx_pending_cnt;
+
+	struct tvnet_counter h2ep_empty;
+	struct tvnet_counter h2ep_full;
+	struct tvnet_counter ep2h_empty;
+	struct tvnet_counter ep2h_full;
+};
+
 struct pci_epf_tvnet {
 	struct pci_epf *epf;
 	struct device *fdev;
@@ -62,7 +96,6 @@ struct pci_epf_tvnet {
 	struct bar_md *bar_md;
 	dma_addr_t bar0_iova;
 	struct net_device *ndev;
-	struct napi_struct napi;
 	bool pcie_link_status;
 	struct ep_ring_buf ep_ring_buf;
 	struct host_ring_buf host_ring_buf;
@@ -72,29 +105,21 @@ struct pci_epf_tvnet {
 	/* To synchronize network link state machine*/
 	struct mutex link_state_lock;
 	wait_queue_head_t link_state_wq;
-	struct list_head h2ep_empty_list;
-#if ENABLE_DMA
-	struct dma_desc_cnt desc_cnt;
-#endif
-	/* To protect h2ep empty list */
-	spinlock_t h2ep_empty_lock;
-	dma_addr_t rx_buf_iova;
-	unsigned long *rx_buf_bitmap;
-	int rx_num_pages;
-	void __iomem *tx_dst_va;
-	phys_addr_t tx_dst_pci_addr;
+	/* DMA write desc rings of all queues */
 	void *ep_dma_virt;
 	dma_addr_t ep_dma_iova;
 	struct irqsp_data *ctrl_irqsp;
 	struct irqsp_data *data_irqsp;
 	struct work_struct raise_irq_work;
 
+	/* Queue pairs in use, host sets it in bar_md before CTRL_MSG_LINK_UP */
+	u32 num_active;
+	/* Host knows version 2 bar_md fields */
+	bool host_v2;
+	struct tvnet_queue queues[TVNET_MAX_QUEUES];
+
 	struct tvnet_counter h2ep_ctrl;
 	struct tvnet_counter ep2h_ctrl;
-	struct tvnet_counter h2ep_empty;
-	struct tvnet_counter h2ep_full;
-	struct tvnet_counter ep2h_empty;
-	struct tvnet_counter ep2h_full;
 };
 
 static void tvnet_ep_raise_irq_work_function(struct work_struct *work)
@@ -169,36 +194,10 @@ static int tvnet_ep_write_ctrl_msg(struct pci_epf_tvnet *tvnet,
 	return 0;
 }
 
-#if !ENABLE_DMA
-static dma_addr_t tvnet_ivoa_alloc(struct pci_epf_tvnet *tvnet)
-{
-	dma_addr_t iova;
-	int pageno;
-
-	pageno = bitmap_find_free_region(tvnet->rx_buf_bitmap,
-					 tvnet->rx_num_pages, 0);
-	if (pageno < 0) {
-		dev_err(tvnet->fdev, "%s: Rx iova alloc fail, page: %d\n",
-			__func__, pageno);
-		return DMA_ERROR_CODE;
-	}
-	iova = tvnet->rx_buf_iova + (pageno << PAGE_SHIFT);
-
-	return iova;
-}
-
-static void tvnet_ep_iova_dealloc(struct pci_epf_tvnet *tvnet, dma_addr_t iova)
+static void tvnet_ep_alloc_empty_buffers(struct tvnet_queue *q)
 {
-	int pageno;
-
-	pageno = (iova - tvnet->rx_buf_iova) >> PAGE_SHIFT;
-	bitmap_release_region(tvnet->rx_buf_bitmap, pageno, 0);
-}
-#endif
-
-static void tvnet_ep_alloc_empty_buffers(struct pci_epf_tvnet *tvnet)
-{
-	struct ep_ring_buf *ep_ring_buf = &tvnet->ep_ring_buf;
+	struct pci_epf_tvnet *tvnet = q->tvnet;
+	struct ep_ring_buf *ep_ring_buf = &q->ep_ring_buf;
 	struct pci_epc *epc = tvnet->epf->epc;
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0))
 	struct pci_epf *epf = tvnet->epf;
@@ -206,26 +205,15 @@ static void tvnet_ep_alloc_empty_buffers(struct pci_epf_tvnet *tvnet)
 	struct device *cdev = epc->dev.parent;
 	struct data_msg *h2ep_empty_msg = ep_ring_buf->h2ep_empty_msgs;
 	struct h2ep_empty_list *h2ep_empty_ptr;
-#if ENABLE_DMA
 	struct net_device *ndev = tvnet->ndev;
-#else
-	struct iommu_domain *domain = iommu_get_domain_for_dev(cdev);
-	int ret = 0;
-#endif
 
-	while (!tvnet_ivc_full(&tvnet->h2ep_empty)) {
+	while (!tvnet_ivc_full(&q->h2ep_empty)) {
 		dma_addr_t iova;
-#if ENABLE_DMA
 		struct sk_buff *skb;
-		int len = ndev->mtu + ETH_HLEN;
-#else
-		struct page *page;
-		void *virt;
-#endif
+		int len = TVNET_RX_BUF_LEN(ndev->mtu);
 		u32 idx;
 		unsigned long flags;
 
-#if ENABLE_DMA
 		skb = netdev_alloc_skb(ndev, len);
 		if (!skb) {
 			pr_err("%s: alloc skb failed\n", __func__);
@@ -239,73 +227,25 @@ static void tvnet_ep_alloc_empty_buffers(struct pci_epf_tvnet *tvnet)
 			break;
 		}
 
-#else
-		iova = tvnet_ivoa_alloc(tvnet);
-		if (iova == DMA_ERROR_CODE) {
-			dev_err(tvnet->fdev, "%s: iova alloc failed\n",
-				__func__);
-			break;
-		}
-
-		page = alloc_pages(GFP_KERNEL, 1);
-		if (!page) {
-			dev_err(tvnet->fdev, "%s: alloc_pages() failed\n",
-				__func__);
-			tvnet_ep_iova_dealloc(tvnet, iova);
-			break;
-		}
-
-		ret = iommu_map(domain, iova, page_to_phys(page), PAGE_SIZE,
-				IOMMU_CACHE | IOMMU_READ | IOMMU_WRITE);
-		if (ret < 0) {
-			dev_err(tvnet->fdev, "%s: iommu_map(RAM) failed: %d\n",
-				__func__, ret);
-			__free_pages(page, 1);
-			tvnet_ep_iova_dealloc(tvnet, iova);
-			break;
-		}
-
-		virt = vmap(&page, 1, VM_MAP, PAGE_KERNEL);
-		if (!virt) {
-			dev_err(tvnet->fdev, "%s: vmap() failed\n", __func__);
-			iommu_unmap(domain, iova, PAGE_SIZE);
-			__free_pages(page, 1);
-			tvnet_ep_iova_dealloc(tvnet, iova);
-			break;
-		}
-#endif
-
 		h2ep_empty_ptr = kmalloc(sizeof(*h2ep_empty_ptr), GFP_KERNEL);
 		if (!h2ep_empty_ptr) {
-#if ENABLE_DMA
 			dma_unmap_single(cdev, iova, len, DMA_FROM_DEVICE);
 			dev_kfree_skb_any(skb);
-#else
-			vunmap(virt);
-			iommu_unmap(domain, iova, PAGE_SIZE);
-			__free_pages(page, 1);
-			tvnet_ep_iova_dealloc(tvnet, iova);
-#endif
 			break;
 		}
 
-#if ENABLE_DMA
 		h2ep_empty_ptr->skb = skb;
 		h2ep_empty_ptr->size = len;
-#else
-		h2ep_empty_ptr->page = page;
-		h2ep_empty_ptr->virt = virt;
-		h2ep_empty_ptr->size = PAGE_SIZE;
-#endif
 		h2ep_empty_ptr->iova = iova;
-		spin_lock_irqsave(&tvnet->h2ep_empty_lock, flags);
-		list_add_tail(&h2ep_empty_ptr->list, &tvnet->h2ep_empty_list);
-		spin_unlock_irqrestore(&tvnet->h2ep_empty_lock, flags);
+		spin_lock_irqsave(&q->h2ep_empty_lock, flags);
+		list_add_tail(&h2ep_empty_ptr->list, &q->h2ep_empty_list);
+		spin_unlock_irqrestore(&q->h2ep_empty_lock, flags);
 
-		idx = tvnet_ivc_get_wr_cnt(&tvnet->h2ep_empty) % RING_COUNT;
+		idx = tvnet_ivc_get_wr_cnt(&q->h2ep_empty) % RING_COUNT;
 		h2ep_empty_msg[idx].u.empty_buffer.pcie_address = iova;
-		h2ep_empty_msg[idx].u.empty_buffer.buffer_len = PAGE_SIZE;
-		tvnet_ivc_advance_wr(&tvnet->h2ep_empty);
+		h2ep_empty_msg[idx].u.empty_buffer.buffer_len =
+							h2ep_empty_ptr->size;
+		tvnet_ivc_advance_wr(&q->h2ep_empty);
 
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0))
 		pci_epc_raise_irq(epc, epf->func_no, PCI_EPC_IRQ_MSIX, 0);
@@ -315,41 +255,31 @@ static void tvnet_ep_alloc_empty_buffers(struct pci_epf_tvnet *tvnet)
 	}
 }
 
-static void tvnet_ep_free_empty_buffers(struct pci_epf_tvnet *tvnet)
+static void tvnet_ep_free_empty_buffers(struct tvnet_queue *q)
 {
-	struct pci_epf *epf = tvnet->epf;
+	struct pci_epf *epf = q->tvnet->epf;
 	struct pci_epc *epc = epf->epc;
 	struct device *cdev = epc->dev.parent;
-#if !ENABLE_DMA
-	struct iommu_domain *domain = iommu_get_domain_for_dev(cdev);
-#endif
 	struct h2ep_empty_list *h2ep_empty_ptr, *temp;
 	unsigned long flags;
 
-	spin_lock_irqsave(&tvnet->h2ep_empty_lock, flags);
-	list_for_each_entry_safe(h2ep_empty_ptr, temp, &tvnet->h2ep_empty_list,
+	spin_lock_irqsave(&q->h2ep_empty_lock, flags);
+	list_for_each_entry_safe(h2ep_empty_ptr, temp, &q->h2ep_empty_list,
 				 list) {
 		list_del(&h2ep_empty_ptr->list);
-#if ENABLE_DMA
 		dma_unmap_single(cdev, h2ep_empty_ptr->iova,
 				 h2ep_empty_ptr->size, DMA_FROM_DEVICE);
 		dev_kfree_skb_any(h2ep_empty_ptr->skb);
-#else
-		vunmap(h2ep_empty_ptr->virt);
-		iommu_unmap(domain, h2ep_empty_ptr->iova, PAGE_SIZE);
-		__free_pages(h2ep_empty_ptr->page, 1);
-		tvnet_ep_iova_dealloc(tvnet, h2ep_empty_ptr->iova);
-#endif
 		kfree(h2ep_empty_ptr);
 	}
-	spin_unlock_irqrestore(&tvnet->h2ep_empty_lock, flags);
+	spin_unlock_irqrestore(&q->h2ep_empty_lock, flags);
 }
 
 static void tvnet_ep_stop_tx_queue(struct pci_epf_tvnet *tvnet)
 {
 	struct net_device *ndev = tvnet->ndev;
 
-	netif_stop_queue(ndev);
+	netif_tx_stop_all_queues(ndev);
 	/* Get tx lock to make sure that there is no ongoing xmit */
 	netif_tx_lock(ndev);
 	netif_tx_unlock(ndev);
@@ -362,26 +292,30 @@ static void tvnet_ep_stop_rx_work(struct pci_epf_tvnet *tvnet)
 
 static void tvnet_ep_clear_data_msg_counters(struct pci_epf_tvnet *tvnet)
 {
-	struct host_ring_buf *host_ring_buf = &tvnet->host_ring_buf;
-	struct host_own_cnt *host_cnt = host_ring_buf->host_cnt;
-	struct ep_ring_buf *ep_ring_buf = &tvnet->ep_ring_buf;
-	struct ep_own_cnt *ep_cnt = ep_ring_buf->ep_cnt;
-
-	host_cnt->h2ep_empty_rd_cnt = 0;
-	ep_cnt->h2ep_empty_wr_cnt = 0;
-	ep_cnt->ep2h_full_wr_cnt = 0;
-	host_cnt->ep2h_full_rd_cnt = 0;
+	struct host_own_cnt *host_cnt;
+	struct ep_own_cnt *ep_cnt;
+	u32 i;
+
+	for (i = 0; i < TVNET_MAX_QUEUES; i++) {
+		host_cnt = tvnet->queues[i].host_ring_buf.host_cnt;
+		ep_cnt = tvnet->queues[i].ep_ring_buf.ep_cnt;
+
+		host_cnt->h2ep_empty_rd_cnt = 0;
+		ep_cnt->h2ep_empty_wr_cnt = 0;
+		ep_cnt->ep2h_full_wr_cnt = 0;
+		host_cnt->ep2h_full_rd_cnt = 0;
+	}
 }
 
 static void tvnet_ep_update_link_state(struct net_device *ndev,
 				    enum os_link_state state)
 {
 	if (state == OS_LINK_STATE_UP) {
-		netif_start_queue(ndev);
+		netif_tx_start_all_queues(ndev);
 		netif_carrier_on(ndev);
 	} else if (state == OS_LINK_STATE_DOWN) {
 		netif_carrier_off(ndev);
-		netif_stop_queue(ndev);
+		netif_tx_stop_all_queues(ndev);
 	} else {
 		pr_err("%s: invalid sate: %d\n", __func__, state);
 	}
@@ -407,9 +341,12 @@ static void tvnet_ep_update_link_sm(struct pci_epf_tvnet *tvnet)
 static void tvnet_ep_user_link_up_req(struct pci_epf_tvnet *tvnet)
 {
 	struct ctrl_msg msg;
+	u32 i;
 
 	tvnet_ep_clear_data_msg_counters(tvnet);
-	tvnet_ep_alloc_empty_buffers(tvnet);
+	for (i = 0; i < tvnet->num_active; i++)
+		tvnet_ep_alloc_empty_buffers(&tvnet->queues[i]);
+	memset(&msg, 0, sizeof(msg));
 	msg.msg_id = CTRL_MSG_LINK_UP;
 	tvnet_ep_write_ctrl_msg(tvnet, &msg);
 	tvnet->rx_link_state = DIR_LINK_STATE_UP;
@@ -421,6 +358,7 @@ static void tvnet_ep_user_link_down_req(struct pci_epf_tvnet *tvnet)
 	struct ctrl_msg msg;
 
 	tvnet->rx_link_state = DIR_LINK_STATE_SENT_DOWN;
+	memset(&msg, 0, sizeof(msg));
 	msg.msg_id = CTRL_MSG_LINK_DOWN;
 	tvnet_ep_write_ctrl_msg(tvnet, &msg);
 	tvnet_ep_update_link_sm(tvnet);
@@ -428,6 +366,14 @@ static void tvnet_ep_user_link_down_req(struct pci_epf_tvnet *tvnet)
 
 static void tvnet_ep_rcv_link_up_msg(struct pci_epf_tvnet *tvnet)
 {
+	u32 num = READ_ONCE(tvnet->bar_md->host_num_queues);
+
+	/* Older host drivers never write host_num_queues and use queue 0 */
+	tvnet->host_v2 = (num != 0);
+	tvnet->num_active = clamp_t(u32, num, 1, TVNET_MAX_QUEUES);
+	dev_dbg(tvnet->fdev, "%s: host uses %u queue pairs\n", __func__,
+		tvnet->num_active);
+
 	tvnet->tx_link_state = DIR_LINK_STATE_UP;
 	tvnet_ep_update_link_sm(tvnet);
 }
@@ -438,6 +384,9 @@ static void tvnet_ep_rcv_link_down_msg(struct pci_epf_tvnet *tvnet)
 
 	/* Stop using empty buffers of remote system */
 	tvnet_ep_stop_tx_queue(tvnet);
+	/* Host rewrites it before next CTRL_MSG_LINK_UP */
+	WRITE_ONCE(tvnet->bar_md->host_num_queues, 0);
+	memset(&msg, 0, sizeof(msg));
 	msg.msg_id = CTRL_MSG_LINK_DOWN_ACK;
 	tvnet_ep_write_ctrl_msg(tvnet, &msg);
 	tvnet->tx_link_state = DIR_LINK_STATE_DOWN;
@@ -446,9 +395,12 @@ static void tvnet_ep_rcv_link_down_msg(struct pci_epf_tvnet *tvnet)
 
 static void tvnet_ep_rcv_link_down_ack(struct pci_epf_tvnet *tvnet)
 {
+	u32 i;
+
 	/* Stop using empty buffers(which are full in rx) of local system */
 	tvnet_ep_stop_rx_work(tvnet);
-	tvnet_ep_free_empty_buffers(tvnet);
+	for (i = 0; i < TVNET_MAX_QUEUES; i++)
+		tvnet_ep_free_empty_buffers(&tvnet->queues[i]);
 	tvnet->rx_link_state = DIR_LINK_STATE_DOWN;
 	wake_up_interruptible(&tvnet->link_state_wq);
 	tvnet_ep_update_link_sm(tvnet);
@@ -458,6 +410,7 @@ static int tvnet_ep_open(struct net_device *ndev)
 {
 	struct device *fdev = ndev->dev.parent;
 	struct pci_epf_tvnet *tvnet = dev_get_drvdata(fdev);
+	u32 i;
 
 	if (!tvnet->pcie_link_status) {
 		dev_err(fdev, "%s: PCIe link is not up\n", __func__);
@@ -467,7 +420,8 @@ static int tvnet_ep_open(struct net_device *ndev)
 	mutex_lock(&tvnet->link_state_lock);
 	if (tvnet->rx_link_state == DIR_LINK_STATE_DOWN)
 		tvnet_ep_user_link_up_req(tvnet);
-	napi_enable(&tvnet->napi);
+	for (i = 0; i < TVNET_MAX_QUEUES; i++)
+		napi_enable(&tvnet->queues[i].napi);
 	mutex_unlock(&tvnet->link_state_lock);
 
 	return 0;
@@ -478,9 +432,11 @@ static int tvnet_ep_close(struct net_device *ndev)
 	struct device *fdev = ndev->dev.parent;
 	struct pci_epf_tvnet *tvnet = dev_get_drvdata(fdev);
 	int ret = 0;
+	u32 i;
 
 	mutex_lock(&tvnet->link_state_lock);
-	napi_disable(&tvnet->napi);
+	for (i = 0; i < TVNET_MAX_QUEUES; i++)
+		napi_disable(&tvnet->queues[i].napi);
 	if (tvnet->rx_link_state == DIR_LINK_STATE_UP)
 		tvnet_ep_user_link_down_req(tvnet);
 
@@ -524,200 +480,253 @@ static int tvnet_ep_change_mtu(struct net_device *ndev, int new_mtu)
 	return 0;
 }
 
+/*
+ * Ring DMA doorbell once for all queued packets, wait for the batch to
+ * complete and push them to EP2H full ring.
+ */
+static void tvnet_ep_tx_flush(struct tvnet_queue *q)
+{
+	struct pci_epf_tvnet *tvnet = q->tvnet;
+	struct device *fdev = tvnet->fdev;
+	struct ep_ring_buf *ep_ring_buf = &q->ep_ring_buf;
+	struct data_msg *ep2h_full_msg = ep_ring_buf->ep2h_full_msgs;
+	struct pci_epc *epc = tvnet->epf->epc;
+	struct device *cdev = epc->dev.parent;
+	struct dma_desc_cnt *desc_cnt = &q->desc_cnt;
+	struct tvnet_dma_desc *ep_dma_virt = q->ep_dma_virt;
+	struct tvnet_tx_buf *tx_buf;
+	unsigned long timeout;
+	bool dma_err = false;
+	u32 i, val, wr_idx, desc_idx;
+
+	if (!q->tx_pending_cnt)
+		return;
+
+	/* Only last desc of the batch raises done irq */
+	desc_idx = (desc_cnt->wr_cnt - 1) % DMA_DESC_COUNT;
+	ep_dma_virt[desc_idx].ctrl_reg.ctrl_d |= DMA_CH_CONTROL1_OFF_WRCH_LIE;
+
+	/* DMA write should not go out of order wrt CB bit set */
+	mb();
+
+	timeout = jiffies + msecs_to_jiffies(1000);
+	dma_common_wr8(tvnet->dma_base, q->dma_ch, DMA_WRITE_DOORBELL_OFF);
+
+	/* Other queues share the status register, only touch own bits */
+	while (true) {
+		val = dma_common_rd(tvnet->dma_base, DMA_WRITE_INT_STATUS_OFF);
+		if (val & DMA_INT_DONE(q->dma_ch)) {
+			dma_common_wr(tvnet->dma_base, DMA_INT_DONE(q->dma_ch),
+				      DMA_WRITE_INT_CLEAR_OFF);
+			break;
+		}
+		if ((val & DMA_INT_ABORT(q->dma_ch)) ||
+		    time_after(jiffies, timeout)) {
+			dev_err(fdev, "dma ch %u failed: 0x%x, stop channel\n",
+				q->dma_ch, val);
+			dma_common_wr(tvnet->dma_base,
+				      DMA_WRITE_DOORBELL_OFF_WR_STOP | q->dma_ch,
+				      DMA_WRITE_DOORBELL_OFF);
+			dma_common_wr(tvnet->dma_base,
+				      DMA_INT_DONE(q->dma_ch) |
+				      DMA_INT_ABORT(q->dma_ch),
+				      DMA_WRITE_INT_CLEAR_OFF);
+			dma_err = true;
+			break;
+		}
+	}
+
+	/* Clear DMA cycle bit of all descs in the batch */
+	for (i = desc_cnt->rd_cnt; i != desc_cnt->wr_cnt; i++)
+		ep_dma_virt[i % DMA_DESC_COUNT].ctrl_reg.ctrl_d = 0;
+	mb();
+
+	/* On error reuse the same descs, engine restarts from there */
+	if (dma_err)
+		desc_cnt->wr_cnt = desc_cnt->rd_cnt;
+	else
+		desc_cnt->rd_cnt = desc_cnt->wr_cnt;
+
+	for (i = 0; i < q->tx_pending_cnt; i++) {
+		tx_buf = &q->tx_pending[i];
+		if (!dma_err) {
+			/* Push dst to EP2H full ring */
+			wr_idx = tvnet_ivc_get_wr_cnt(&q->ep2h_full) %
+								RING_COUNT;
+			ep2h_full_msg[wr_idx].u.full_buffer.packet_size =
+							tx_buf->skb->len;
+			tvnet_full_msg_set_gso(&ep2h_full_msg[wr_idx],
+					       tx_buf->skb);
+			ep2h_full_msg[wr_idx].u.full_buffer.pcie_address =
+							tx_buf->dst_iova;
+			tvnet_ivc_advance_wr(&q->ep2h_full);
+		}
+
+		/* Free temp src and skb */
+		tvnet_tx_buf_unmap(cdev, tx_buf);
+		dev_kfree_skb_any(tx_buf->skb);
+		tx_buf->skb = NULL;
+	}
+	q->tx_pending_cnt = 0;
+
+	if (!dma_err)
+		schedule_work(&tvnet->raise_irq_work);
+}
+
 static netdev_tx_t tvnet_ep_start_xmit(struct sk_buff *skb,
 				    struct net_device *ndev)
 {
 	struct device *fdev = ndev->dev.parent;
 	struct pci_epf_tvnet *tvnet = dev_get_drvdata(fdev);
-	struct host_ring_buf *host_ring_buf = &tvnet->host_ring_buf;
-	struct ep_ring_buf *ep_ring_buf = &tvnet->ep_ring_buf;
-	struct data_msg *ep2h_full_msg = ep_ring_buf->ep2h_full_msgs;
-	struct skb_shared_info *info = skb_shinfo(skb);
+	struct tvnet_queue *q = &tvnet->queues[skb_get_queue_mapping(skb)];
+	struct host_ring_buf *host_ring_buf = &q->host_ring_buf;
 	struct data_msg *ep2h_empty_msg = host_ring_buf->ep2h_empty_msgs;
 	struct pci_epf *epf = tvnet->epf;
 	struct pci_epc *epc = epf->epc;
 	struct device *cdev = epc->dev.parent;
-#if ENABLE_DMA
-	struct dma_desc_cnt *desc_cnt = &tvnet->desc_cnt;
-	struct tvnet_dma_desc *ep_dma_virt =
-				(struct tvnet_dma_desc *)tvnet->ep_dma_virt;
-	u32 desc_widx, desc_ridx, val, ctrl_d;
-	unsigned long timeout;
-#else
-	int ret;
-#endif
-	dma_addr_t src_iova;
-	u32 rd_idx, wr_idx;
-	u64 dst_masked, dst_off, dst_iova;
+	struct dma_desc_cnt *desc_cnt = &q->desc_cnt;
+	struct tvnet_dma_desc *ep_dma_virt = q->ep_dma_virt;
+	struct tvnet_tx_buf *tx_buf;
+	bool xmit_more = tvnet_xmit_more(skb);
+	u32 desc_widx, nr_segs, i;
+	u32 rd_idx;
+	u64 dst_off, dst_iova;
 	int dst_len, len;
 
-	/*TODO Not expecting skb frags, remove this after testing */
-	WARN_ON(info->nr_frags);
+	nr_segs = skb_shinfo(skb)->nr_frags + 1;
+
+	/* Make room in EP2H full ring and DMA ring for this packet */
+	if (q->tx_pending_cnt &&
+	    ((tvnet_ivc_wr_available(&q->ep2h_full) <= q->tx_pending_cnt) ||
+	     ((desc_cnt->wr_cnt - desc_cnt->rd_cnt + nr_segs) > DMA_DESC_COUNT)))
+		tvnet_ep_tx_flush(q);
 
 	/* Check if EP2H_EMPTY_BUF available to read */
-	if (!tvnet_ivc_rd_available(&tvnet->ep2h_empty)) {
+	if (!tvnet_ivc_rd_available(&q->ep2h_empty)) {
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0))
 		pci_epc_raise_irq(epc, epf->func_no, PCI_EPC_IRQ_MSIX, 0);
 #else
 		pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
 #endif
 		dev_dbg(fdev, "%s: No EP2H empty msg, stop tx\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
+		goto stop_queue;
 	}
 
 	/* Check if EP2H_FULL_BUF available to write */
-	if (tvnet_ivc_full(&tvnet->ep2h_full)) {
+	if (tvnet_ivc_full(&q->ep2h_full)) {
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0))
 		pci_epc_raise_irq(epc, epf->func_no, PCI_EPC_IRQ_MSIX, 1);
 #else
 		pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 1);
 #endif
 		dev_dbg(fdev, "%s: No EP2H full buf, stop tx\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
+		goto stop_queue;
 	}
 
-#if ENABLE_DMA
 	/* Check if dma desc available */
-	if ((desc_cnt->wr_cnt - desc_cnt->rd_cnt) >= DMA_DESC_COUNT) {
+	if ((desc_cnt->wr_cnt - desc_cnt->rd_cnt + nr_segs) > DMA_DESC_COUNT) {
 		dev_dbg(fdev, "%s: dma descs are not available\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
+		goto stop_queue;
 	}
-#endif
 
-	len = skb_headlen(skb);
-
-	src_iova = dma_map_single(cdev, skb->data, len, DMA_TO_DEVICE);
-	if (dma_mapping_error(cdev, src_iova)) {
-		dev_err(fdev, "%s: dma_map_single failed\n", __func__);
+	tx_buf = &q->tx_pending[q->tx_pending_cnt];
+	if (tvnet_tx_buf_map(cdev, skb, tx_buf)) {
+		dev_err(fdev, "%s: skb dma map failed\n", __func__);
 		dev_kfree_skb_any(skb);
-		return NETDEV_TX_OK;
+		goto out;
 	}
+	len = skb->len;
 
 	/* Get EP2H empty msg */
-	rd_idx = tvnet_ivc_get_rd_cnt(&tvnet->ep2h_empty) % RING_COUNT;
+	rd_idx = tvnet_ivc_get_rd_cnt(&q->ep2h_empty) % RING_COUNT;
 	dst_iova = ep2h_empty_msg[rd_idx].u.empty_buffer.pcie_address;
 	dst_len = ep2h_empty_msg[rd_idx].u.empty_buffer.buffer_len;
 
-	/*
-	 * Map host dst mem to local PCIe address range.
-	 * PCIe address range is SZ_64K aligned.
-	 */
-	dst_masked = (dst_iova & ~(SZ_64K - 1));
-	dst_off = (dst_iova & (SZ_64K - 1));
-
-#if !ENABLE_DMA
-#if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0))
-	ret = pci_epc_map_addr(epc, epf->func_no, tvnet->tx_dst_pci_addr,
-			       dst_masked, dst_len);
-#else
-	ret = pci_epc_map_addr(epc, tvnet->tx_dst_pci_addr, dst_masked,
-			       dst_len);
-#endif
-	if (ret < 0) {
-		dev_err(fdev, "failed to map dst addr to PCIe addr range\n");
-		dma_unmap_single(cdev, src_iova, len, DMA_TO_DEVICE);
+	if (len > dst_len) {
+		dev_err(fdev, "%s: pkt len %d > host buf len %d\n", __func__,
+			len, dst_len);
+		tvnet_tx_buf_unmap(cdev, tx_buf);
 		dev_kfree_skb_any(skb);
-		return NETDEV_TX_OK;
+		goto out;
 	}
-#endif
+
 	/*
 	 * Advance read count after all failure cases completed, to avoid
 	 * dangling buffer at host.
 	 */
-	tvnet_ivc_advance_rd(&tvnet->ep2h_empty);
-
-#if ENABLE_DMA
-	/* Trigger DMA write from src_iova to dst_iova */
-	desc_widx = desc_cnt->wr_cnt % DMA_DESC_COUNT;
-	ep_dma_virt[desc_widx].size = len;
-	ep_dma_virt[desc_widx].sar_low = lower_32_bits(src_iova);
-	ep_dma_virt[desc_widx].sar_high = upper_32_bits(src_iova);
-	ep_dma_virt[desc_widx].dar_low = lower_32_bits(dst_iova);
-	ep_dma_virt[desc_widx].dar_high = upper_32_bits(dst_iova);
-	/* CB bit should be set at the end */
-	mb();
-	ctrl_d = DMA_CH_CONTROL1_OFF_WRCH_LIE;
-	ctrl_d |= DMA_CH_CONTROL1_OFF_WRCH_CB;
-	ep_dma_virt[desc_widx].ctrl_reg.ctrl_d = ctrl_d;
+	tvnet_ivc_advance_rd(&q->ep2h_empty);
 
-	/* DMA write should not go out of order wrt CB bit set */
-	mb();
+	/*
+	 * Queue DMA write of each skb segment straight into host buffer.
+	 * Engine is idle until doorbell, so CB can be set per desc here.
+	 */
+	dst_off = 0;
+	for (i = 0; i < tx_buf->nr_segs; i++) {
+		desc_widx = desc_cnt->wr_cnt % DMA_DESC_COUNT;
+		ep_dma_virt[desc_widx].size = tx_buf->len[i];
+		ep_dma_virt[desc_widx].sar_low = lower_32_bits(tx_buf->iova[i]);
+		ep_dma_virt[desc_widx].sar_high = upper_32_bits(tx_buf->iova[i]);
+		ep_dma_virt[desc_widx].dar_low = lower_32_bits(dst_iova + dst_off);
+		ep_dma_virt[desc_widx].dar_high = upper_32_bits(dst_iova + dst_off);
+		/* CB bit should be set at the end */
+		wmb();
+		ep_dma_virt[desc_widx].ctrl_reg.ctrl_d =
+					DMA_CH_CONTROL1_OFF_WRCH_CB;
+		dst_off += tx_buf->len[i];
+		desc_cnt->wr_cnt++;
+	}
+	tx_buf->dst_iova = dst_iova;
+	q->tx_pending_cnt++;
 
-	timeout = jiffies + msecs_to_jiffies(1000);
-	dma_common_wr8(tvnet->dma_base, DMA_WR_DATA_CH, DMA_WRITE_DOORBELL_OFF);
-	desc_cnt->wr_cnt++;
+out:
+	if (!xmit_more || (q->tx_pending_cnt == TVNET_TX_BATCH))
+		tvnet_ep_tx_flush(q);
 
-	while (true) {
-		val = dma_common_rd(tvnet->dma_base, DMA_WRITE_INT_STATUS_OFF);
-		if (val == BIT(DMA_WR_DATA_CH)) {
-			dma_common_wr(tvnet->dma_base, val,
-				      DMA_WRITE_INT_CLEAR_OFF);
-			break;
-		}
-		if (time_after(jiffies, timeout)) {
-			dev_err(fdev, "dma took more time, reset dma engine\n");
-			dma_common_wr(tvnet->dma_base,
-				      DMA_WRITE_ENGINE_EN_OFF_DISABLE,
-				      DMA_WRITE_ENGINE_EN_OFF);
-			mdelay(1);
-			dma_common_wr(tvnet->dma_base,
-				      DMA_WRITE_ENGINE_EN_OFF_ENABLE,
-				      DMA_WRITE_ENGINE_EN_OFF);
-			desc_cnt->wr_cnt--;
-#if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0))
-			pci_epc_unmap_addr(epc, epf->func_no, tvnet->tx_dst_pci_addr);
-#else
-			pci_epc_unmap_addr(epc, tvnet->tx_dst_pci_addr);
-#endif
-			dma_unmap_single(cdev, src_iova, len, DMA_TO_DEVICE);
-			return NETDEV_TX_BUSY;
-		}
-	}
+	return NETDEV_TX_OK;
 
-	desc_ridx = tvnet->desc_cnt.rd_cnt % DMA_DESC_COUNT;
-	/* Clear DMA cycle bit and increment rd_cnt */
-	ep_dma_virt[desc_ridx].ctrl_reg.ctrl_e.cb = 0;
-	mb();
+stop_queue:
+	/* Queued packets must not wait for a later xmit */
+	tvnet_ep_tx_flush(q);
+	netif_stop_subqueue(ndev, q->idx);
+	return NETDEV_TX_BUSY;
+}
 
-	tvnet->desc_cnt.rd_cnt++;
+/*
+ * Queue pairs in use are only known once host sends CTRL_MSG_LINK_UP, so
+ * hash flows over them here instead of changing real_num_tx_queues.
+ */
+static u16 tvnet_ep_select_queue(struct net_device *ndev, struct sk_buff *skb,
+#if (KERNEL_VERSION(5, 4, 0) > LINUX_VERSION_CODE)
+				 void *accel_priv,
+				 select_queue_fallback_t fallback)
 #else
-	/* Copy skb->data to host dst address, use CPU virt addr */
-	memcpy((void *)(tvnet->tx_dst_va + dst_off), skb->data, len);
-	/*
-	 * tx_dst_va is ioremap_wc() mem, add mb to make sure complete skb->data
-	 * written to dst before adding it to full buffer
-	 */
-	mb();
+				 struct net_device *sb_dev)
 #endif
+{
+	struct pci_epf_tvnet *tvnet = dev_get_drvdata(ndev->dev.parent);
 
-	/* Push dst to EP2H full ring */
-	wr_idx = tvnet_ivc_get_wr_cnt(&tvnet->ep2h_full) % RING_COUNT;
-	ep2h_full_msg[wr_idx].u.full_buffer.packet_size = len;
-	ep2h_full_msg[wr_idx].u.full_buffer.pcie_address = dst_iova;
-	tvnet_ivc_advance_wr(&tvnet->ep2h_full);
+	return reciprocal_scale(skb_get_hash(skb), tvnet->num_active);
+}
 
-	/* Free temp src and skb */
-#if !ENABLE_DMA
-#if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0))
-	pci_epc_unmap_addr(epc, epf->func_no, tvnet->tx_dst_pci_addr);
-#else
-	pci_epc_unmap_addr(epc, tvnet->tx_dst_pci_addr);
-#endif
-#endif
-	dma_unmap_single(cdev, src_iova, len, DMA_TO_DEVICE);
-	dev_kfree_skb_any(skb);
-	schedule_work(&tvnet->raise_irq_work);
+/* Older host drivers take only packets that fit one Rx buffer */
+static netdev_features_t tvnet_ep_features_check(struct sk_buff *skb,
+						 struct net_device *ndev,
+						 netdev_features_t features)
+{
+	struct pci_epf_tvnet *tvnet = dev_get_drvdata(ndev->dev.parent);
 
-	return NETDEV_TX_OK;
+	if (!tvnet->host_v2)
+		features &= ~NETIF_F_GSO_MASK;
+
+	return features;
 }
 
 static const struct net_device_ops tvnet_netdev_ops = {
 	.ndo_open = tvnet_ep_open,
 	.ndo_stop = tvnet_ep_close,
 	.ndo_start_xmit = tvnet_ep_start_xmit,
+	.ndo_select_queue = tvnet_ep_select_queue,
+	.ndo_features_check = tvnet_ep_features_check,
 	.ndo_change_mtu = tvnet_ep_change_mtu,
 };
 
@@ -736,36 +745,36 @@ static void tvnet_ep_process_ctrl_msg(struct pci_epf_tvnet *tvnet)
 	}
 }
 
-static int tvnet_ep_process_h2ep_msg(struct pci_epf_tvnet *tvnet)
+static int tvnet_ep_process_h2ep_msg(struct tvnet_queue *q, int budget)
 {
-	struct host_ring_buf *host_ring_buf = &tvnet->host_ring_buf;
+	struct pci_epf_tvnet *tvnet = q->tvnet;
+	struct host_ring_buf *host_ring_buf = &q->host_ring_buf;
 	struct data_msg *data_msg = host_ring_buf->h2ep_full_msgs;
 	struct pci_epf *epf = tvnet->epf;
 	struct pci_epc *epc = epf->epc;
 	struct device *cdev = epc->dev.parent;
 	struct h2ep_empty_list *h2ep_empty_ptr;
 	struct net_device *ndev = tvnet->ndev;
-#if !ENABLE_DMA
-	struct iommu_domain *domain = iommu_get_domain_for_dev(cdev);
-#endif
 	int count = 0;
 
-	while ((count < TVNET_NAPI_WEIGHT) &&
-	       tvnet_ivc_rd_available(&tvnet->h2ep_full)) {
+	while ((count < budget) &&
+	       tvnet_ivc_rd_available(&q->h2ep_full)) {
 		struct sk_buff *skb;
+		struct data_msg msg;
 		int idx, found = 0;
 		u32 len;
 		u64 pcie_address;
 		unsigned long flags;
 
-		/* Read H2EP full msg */
-		idx = tvnet_ivc_get_rd_cnt(&tvnet->h2ep_full) % RING_COUNT;
-		len = data_msg[idx].u.full_buffer.packet_size;
-		pcie_address = data_msg[idx].u.full_buffer.pcie_address;
+		/* Read H2EP full msg, host reuses the slot once rd advances */
+		idx = tvnet_ivc_get_rd_cnt(&q->h2ep_full) % RING_COUNT;
+		memcpy(&msg, &data_msg[idx], sizeof(msg));
+		len = msg.u.full_buffer.packet_size;
+		pcie_address = msg.u.full_buffer.pcie_address;
 
 		/* Get H2EP msg pointer from saved list */
-		spin_lock_irqsave(&tvnet->h2ep_empty_lock, flags);
-		list_for_each_entry(h2ep_empty_ptr, &tvnet->h2ep_empty_list,
+		spin_lock_irqsave(&q->h2ep_empty_lock, flags);
+		list_for_each_entry(h2ep_empty_ptr, &q->h2ep_empty_list,
 				    list) {
 			if (h2ep_empty_ptr->iova == pcie_address) {
 				found = 1;
@@ -774,31 +783,33 @@ static int tvnet_ep_process_h2ep_msg(struct pci_epf_tvnet *tvnet)
 		}
 		WARN_ON(!found);
 		list_del(&h2ep_empty_ptr->list);
-		spin_unlock_irqrestore(&tvnet->h2ep_empty_lock, flags);
+		spin_unlock_irqrestore(&q->h2ep_empty_lock, flags);
 
 		/* Advance H2EP full buffer after search in local list */
-		tvnet_ivc_advance_rd(&tvnet->h2ep_full);
-#if ENABLE_DMA
-		dma_unmap_single(cdev, pcie_address, ndev->mtu,
+		tvnet_ivc_advance_rd(&q->h2ep_full);
+		dma_unmap_single(cdev, pcie_address, h2ep_empty_ptr->size,
 				 DMA_FROM_DEVICE);
 		skb = h2ep_empty_ptr->skb;
-		skb_put(skb, len);
-		skb->protocol = eth_type_trans(skb, ndev);
-		napi_gro_receive(&tvnet->napi, skb);
-#else
-		/* Alloc new skb and copy data from full buffer */
-		skb = netdev_alloc_skb(ndev, len);
-		memcpy(skb->data, h2ep_empty_ptr->virt, len);
-		skb_put(skb, len);
-		skb->protocol = eth_type_trans(skb, ndev);
-		napi_gro_receive(&tvnet->napi, skb);
-
-		/* Free H2EP dst msg */
-		vunmap(h2ep_empty_ptr->virt);
-		iommu_unmap(domain, h2ep_empty_ptr->iova, PAGE_SIZE);
-		__free_pages(h2ep_empty_ptr->page, 1);
-		tvnet_ep_iova_dealloc(tvnet, h2ep_empty_ptr->iova);
-#endif
+		if (len > h2ep_empty_ptr->size) {
+			dev_err(tvnet->fdev, "%s: pkt len %u > buf len %d\n",
+				__func__, len, h2ep_empty_ptr->size);
+			dev_kfree_skb_any(skb);
+			ndev->stats.rx_dropped++;
+		} else {
+			skb_put(skb, len);
+			if (tvnet->host_v2 && tvnet_rx_set_gso(skb, &msg)) {
+				dev_err(tvnet->fdev,
+					"%s: bad gso type %u size %u\n", __func__,
+					msg.u.full_buffer.gso_type,
+					msg.u.full_buffer.gso_size);
+				dev_kfree_skb_any(skb);
+				ndev->stats.rx_dropped++;
+			} else {
+				skb->protocol = eth_type_trans(skb, ndev);
+				skb_record_rx_queue(skb, q->idx);
+				napi_gro_receive(&q->napi, skb);
+			}
+		}
 
 		kfree(h2ep_empty_ptr);
 		count++;
@@ -807,74 +818,85 @@ static int tvnet_ep_process_h2ep_msg(struct pci_epf_tvnet *tvnet)
 	return count;
 }
 
-#if ENABLE_DMA
 static void tvnet_ep_setup_dma(struct pci_epf_tvnet *tvnet)
 {
-	dma_addr_t iova = tvnet->bar0_amap[HOST_DMA].iova;
-	struct dma_desc_cnt *desc_cnt = &tvnet->desc_cnt;
-	u32 val;
-
-	desc_cnt->rd_cnt = desc_cnt->wr_cnt = 0;
-
-	/* Enable linked list mode and set CCS for write channel-0 */
-	val = dma_channel_rd(tvnet->dma_base, DMA_WR_DATA_CH,
-			     DMA_CH_CONTROL1_OFF_WRCH);
-	val |= DMA_CH_CONTROL1_OFF_WRCH_LLE;
-	val |= DMA_CH_CONTROL1_OFF_WRCH_CCS;
-	dma_channel_wr(tvnet->dma_base, DMA_WR_DATA_CH, val,
-		       DMA_CH_CONTROL1_OFF_WRCH);
-
-	/* Unmask write channel-0 done irq to enable LIE */
-	val = dma_common_rd(tvnet->dma_base, DMA_WRITE_INT_MASK_OFF);
-	val &= ~0x1;
-	dma_common_wr(tvnet->dma_base, val, DMA_WRITE_INT_MASK_OFF);
-
-	/* Enable write channel-0 local abort irq */
-	val = dma_common_rd(tvnet->dma_base, DMA_WRITE_LINKED_LIST_ERR_EN_OFF);
-	val |= (0x1 << 16);
-	dma_common_wr(tvnet->dma_base, val, DMA_WRITE_LINKED_LIST_ERR_EN_OFF);
-
-	/* Program DMA write linked list base address to DMA LLP register */
-	dma_channel_wr(tvnet->dma_base, DMA_WR_DATA_CH,
-		       lower_32_bits(tvnet->ep_dma_iova),
-		       DMA_LLP_LOW_OFF_WRCH);
-	dma_channel_wr(tvnet->dma_base, DMA_WR_DATA_CH,
-		       upper_32_bits(tvnet->ep_dma_iova),
-		       DMA_LLP_HIGH_OFF_WRCH);
+	struct tvnet_queue *q;
+	dma_addr_t iova;
+	u32 val, i, rd_ch;
+
+	for (i = 0; i < TVNET_MAX_QUEUES; i++) {
+		q = &tvnet->queues[i];
+		q->desc_cnt.rd_cnt = q->desc_cnt.wr_cnt = 0;
+		q->tx_pending_cnt = 0;
+
+		/* Enable linked list mode and set CCS for write channel */
+		val = dma_channel_rd(tvnet->dma_base, q->dma_ch,
+				     DMA_CH_CONTROL1_OFF_WRCH);
+		val |= DMA_CH_CONTROL1_OFF_WRCH_LLE;
+		val |= DMA_CH_CONTROL1_OFF_WRCH_CCS;
+		dma_channel_wr(tvnet->dma_base, q->dma_ch, val,
+			       DMA_CH_CONTROL1_OFF_WRCH);
+
+		/* Unmask write channel done irq to enable LIE */
+		val = dma_common_rd(tvnet->dma_base, DMA_WRITE_INT_MASK_OFF);
+		val &= ~DMA_INT_DONE(q->dma_ch);
+		dma_common_wr(tvnet->dma_base, val, DMA_WRITE_INT_MASK_OFF);
+
+		/* Enable write channel local abort irq */
+		val = dma_common_rd(tvnet->dma_base,
+				    DMA_WRITE_LINKED_LIST_ERR_EN_OFF);
+		val |= DMA_INT_ABORT(q->dma_ch);
+		dma_common_wr(tvnet->dma_base, val,
+			      DMA_WRITE_LINKED_LIST_ERR_EN_OFF);
+
+		/* Program DMA write linked list base address to LLP register */
+		dma_channel_wr(tvnet->dma_base, q->dma_ch,
+			       lower_32_bits(q->ep_dma_iova),
+			       DMA_LLP_LOW_OFF_WRCH);
+		dma_channel_wr(tvnet->dma_base, q->dma_ch,
+			       upper_32_bits(q->ep_dma_iova),
+			       DMA_LLP_HIGH_OFF_WRCH);
+
+		/* Host programs read channel of same index for its Tx */
+		rd_ch = DMA_RD_DATA_CH + i;
+
+		/* Enable linked list mode and set CCS for read channel */
+		val = dma_channel_rd(tvnet->dma_base, rd_ch,
+				     DMA_CH_CONTROL1_OFF_RDCH);
+		val |= DMA_CH_CONTROL1_OFF_RDCH_LLE;
+		val |= DMA_CH_CONTROL1_OFF_RDCH_CCS;
+		dma_channel_wr(tvnet->dma_base, rd_ch, val,
+			       DMA_CH_CONTROL1_OFF_RDCH);
+
+		/* Mask read channel done irq to enable RIE */
+		val = dma_common_rd(tvnet->dma_base, DMA_READ_INT_MASK_OFF);
+		val |= DMA_INT_DONE(rd_ch);
+		dma_common_wr(tvnet->dma_base, val, DMA_READ_INT_MASK_OFF);
+
+		/* Enable read channel remote abort irq */
+		val = dma_common_rd(tvnet->dma_base,
+				    DMA_READ_LINKED_LIST_ERR_EN_OFF);
+		val |= BIT(rd_ch);
+		dma_common_wr(tvnet->dma_base, val,
+			      DMA_READ_LINKED_LIST_ERR_EN_OFF);
+
+		/* Program DMA read linked list base address to LLP register */
+		iova = tvnet->bar0_amap[HOST_DMA].iova +
+			(i * TVNET_DMA_RING_SIZE);
+		dma_channel_wr(tvnet->dma_base, rd_ch,
+			       lower_32_bits(iova), DMA_LLP_LOW_OFF_RDCH);
+		dma_channel_wr(tvnet->dma_base, rd_ch,
+			       upper_32_bits(iova), DMA_LLP_HIGH_OFF_RDCH);
+	}
 
 	/* Enable DMA write engine */
-        dma_common_wr(tvnet->dma_base, DMA_WRITE_ENGINE_EN_OFF_ENABLE,
-                        DMA_WRITE_ENGINE_EN_OFF);
-
-	/* Enable linked list mode and set CCS for read channel-0 */
-	val = dma_channel_rd(tvnet->dma_base, DMA_RD_DATA_CH,
-			     DMA_CH_CONTROL1_OFF_RDCH);
-	val |= DMA_CH_CONTROL1_OFF_RDCH_LLE;
-	val |= DMA_CH_CONTROL1_OFF_RDCH_CCS;
-	dma_channel_wr(tvnet->dma_base, DMA_RD_DATA_CH, val,
-		       DMA_CH_CONTROL1_OFF_RDCH);
-
-	/* Mask read channel-0 done irq to enable RIE */
-	val = dma_common_rd(tvnet->dma_base, DMA_READ_INT_MASK_OFF);
-	val |= 0x1;
-	dma_common_wr(tvnet->dma_base, val, DMA_READ_INT_MASK_OFF);
-
-	val = dma_common_rd(tvnet->dma_base, DMA_READ_LINKED_LIST_ERR_EN_OFF);
-	/* Enable read channel-0 remote abort irq */
-	val |= 0x1;
-	dma_common_wr(tvnet->dma_base, val, DMA_READ_LINKED_LIST_ERR_EN_OFF);
-
-	/* Program DMA read linked list base address to DMA LLP register */
-	dma_channel_wr(tvnet->dma_base, DMA_RD_DATA_CH,
-		       lower_32_bits(iova), DMA_LLP_LOW_OFF_RDCH);
-	dma_channel_wr(tvnet->dma_base, DMA_RD_DATA_CH,
-		       upper_32_bits(iova), DMA_LLP_HIGH_OFF_RDCH);
+	dma_common_wr(tvnet->dma_base, DMA_WRITE_ENGINE_EN_OFF_ENABLE,
+		      DMA_WRITE_ENGINE_EN_OFF);
 
 	/* Enable DMA read engine */
-        dma_common_wr(tvnet->dma_base, DMA_READ_ENGINE_EN_OFF_ENABLE,
-                        DMA_READ_ENGINE_EN_OFF);
+	dma_common_wr(tvnet->dma_base, DMA_READ_ENGINE_EN_OFF_ENABLE,
+		      DMA_READ_ENGINE_EN_OFF);
 }
-#endif
 
 static void tvnet_ep_ctrl_irqsp_reprime_work(struct work_struct *work)
 {
@@ -889,21 +911,27 @@ static void tvnet_ep_ctrl_irqsp_callback(void *private_data)
 	struct irqsp_data *data_irqsp = private_data;
 	struct pci_epf_tvnet *tvnet = dev_get_drvdata(data_irqsp->dev);
 	struct net_device *ndev = tvnet->ndev;
-
-	if (netif_queue_stopped(ndev)) {
-		if ((tvnet->os_link_state == OS_LINK_STATE_UP) &&
-		    tvnet_ivc_rd_available(&tvnet->ep2h_empty) &&
-		    !tvnet_ivc_full(&tvnet->ep2h_full)) {
-			netif_wake_queue(ndev);
-		}
+	struct tvnet_queue *q;
+	u32 i;
+
+	for (i = 0; i < tvnet->num_active; i++) {
+		q = &tvnet->queues[i];
+		if (__netif_subqueue_stopped(ndev, i) &&
+		    (tvnet->os_link_state == OS_LINK_STATE_UP) &&
+		    tvnet_ivc_rd_available(&q->ep2h_empty) &&
+		    !tvnet_ivc_full(&q->ep2h_full))
+			netif_wake_subqueue(ndev, i);
 	}
 
 	if (tvnet_ivc_rd_available(&tvnet->h2ep_ctrl))
 		tvnet_ep_process_ctrl_msg(tvnet);
 
-	if (!tvnet_ivc_full(&tvnet->h2ep_empty) &&
-	    (tvnet->os_link_state == OS_LINK_STATE_UP))
-		tvnet_ep_alloc_empty_buffers(tvnet);
+	for (i = 0; i < tvnet->num_active; i++) {
+		q = &tvnet->queues[i];
+		if (!tvnet_ivc_full(&q->h2ep_empty) &&
+		    (tvnet->os_link_state == OS_LINK_STATE_UP))
+			tvnet_ep_alloc_empty_buffers(q);
+	}
 	schedule_work(&data_irqsp->reprime_work);
 }
 
@@ -915,28 +943,33 @@ static void tvnet_ep_data_irqsp_reprime_work(struct work_struct *work)
 	nvhost_interrupt_syncpt_prime(data_irqsp->is);
 }
 
+/*
+ * Host has one data syncpoint for all queues. Reprime it right away, each
+ * poll checks its ring again after completing.
+ */
 static void tvnet_ep_data_irqsp_callback(void *private_data)
 {
 	struct irqsp_data *data_irqsp = private_data;
 	struct pci_epf_tvnet *tvnet = dev_get_drvdata(data_irqsp->dev);
+	u32 i;
 
-	if (tvnet_ivc_rd_available(&tvnet->h2ep_full))
-		napi_schedule(&tvnet->napi);
-	else
-		schedule_work(&data_irqsp->reprime_work);
+	for (i = 0; i < TVNET_MAX_QUEUES; i++) {
+		if (tvnet_ivc_rd_available(&tvnet->queues[i].h2ep_full))
+			napi_schedule(&tvnet->queues[i].napi);
+	}
+	schedule_work(&data_irqsp->reprime_work);
 }
 
 static int tvnet_ep_poll(struct napi_struct *napi, int budget)
 {
-	struct pci_epf_tvnet *tvnet = container_of(napi, struct pci_epf_tvnet,
-						   napi);
-	struct irqsp_data *data_irqsp = tvnet->data_irqsp;
+	struct tvnet_queue *q = container_of(napi, struct tvnet_queue, napi);
 	int work_done;
 
-	work_done = tvnet_ep_process_h2ep_msg(tvnet);
+	work_done = tvnet_ep_process_h2ep_msg(q, budget);
 	if (work_done < budget) {
-		napi_complete(napi);
-		schedule_work(&data_irqsp->reprime_work);
+		napi_complete_done(napi, work_done);
+		if (tvnet_ivc_rd_available(&q->h2ep_full))
+			napi_schedule(napi);
 	}
 
 	return work_done;
@@ -1179,6 +1212,75 @@ static void tvnet_ep_free_multi_page_bar0_mem(struct pci_epf *epf,
 	vfree(amap->virt);
 }
 
+/* Place rings of queue idx in EP/HOST mem and describe them in bar_md */
+static void tvnet_ep_setup_queue(struct pci_epf_tvnet *tvnet, u32 idx)
+{
+	struct bar_md *bar_md = tvnet->bar_md;
+	struct tvnet_queue_md *md = &bar_md->queue_md[idx];
+	struct tvnet_queue *q = &tvnet->queues[idx];
+	struct ep_ring_buf *ep_ring_buf = &q->ep_ring_buf;
+	struct host_ring_buf *host_ring_buf = &q->host_ring_buf;
+	void *ep_mem = tvnet->bar0_amap[EP_MEM].virt;
+	void *host_mem = tvnet->bar0_amap[HOST_MEM].virt;
+	u32 ring_size = RING_COUNT * sizeof(struct data_msg);
+	u32 off;
+
+	if (idx == 0) {
+		md->ep_own_cnt_offset = bar_md->ep_own_cnt_offset;
+		md->host_own_cnt_offset = bar_md->host_own_cnt_offset;
+		md->ep2h_md = bar_md->ep2h_md;
+		md->h2ep_md = bar_md->h2ep_md;
+	} else {
+		/* Queue 1 onwards follow the data rings of queue 0 */
+		off = bar_md->h2ep_md.ep2h_offset + ring_size +
+			((idx - 1) * TVNET_QUEUE_MEM_SIZE(struct ep_own_cnt));
+		md->ep_own_cnt_offset = off;
+		md->ep2h_md.ep2h_offset = off + sizeof(struct ep_own_cnt);
+		md->ep2h_md.ep2h_size = RING_COUNT;
+		md->h2ep_md.ep2h_offset = md->ep2h_md.ep2h_offset + ring_size;
+		md->h2ep_md.ep2h_size = RING_COUNT;
+
+		off = bar_md->h2ep_md.h2ep_offset + ring_size +
+			((idx - 1) * TVNET_QUEUE_MEM_SIZE(struct host_own_cnt));
+		md->host_own_cnt_offset = off;
+		md->ep2h_md.h2ep_offset = off + sizeof(struct host_own_cnt);
+		md->ep2h_md.h2ep_size = RING_COUNT;
+		md->h2ep_md.h2ep_offset = md->ep2h_md.h2ep_offset + ring_size;
+		md->h2ep_md.h2ep_size = RING_COUNT;
+	}
+	md->host_dma_offset = bar_md->host_dma_offset +
+				(idx * TVNET_DMA_RING_SIZE);
+	md->host_dma_size = TVNET_DMA_RING_SIZE;
+
+	/* EP_MEM and HOST_MEM start at own_cnt_offset of queue 0 in BAR0 */
+	off = bar_md->ep_own_cnt_offset;
+	ep_ring_buf->ep_cnt = ep_mem + (md->ep_own_cnt_offset - off);
+	ep_ring_buf->ep2h_full_msgs = ep_mem + (md->ep2h_md.ep2h_offset - off);
+	ep_ring_buf->h2ep_empty_msgs = ep_mem + (md->h2ep_md.ep2h_offset - off);
+
+	off = bar_md->host_own_cnt_offset;
+	host_ring_buf->host_cnt = host_mem + (md->host_own_cnt_offset - off);
+	host_ring_buf->ep2h_empty_msgs = host_mem +
+					(md->ep2h_md.h2ep_offset - off);
+	host_ring_buf->h2ep_full_msgs = host_mem +
+					(md->h2ep_md.h2ep_offset - off);
+
+	q->tvnet = tvnet;
+	q->idx = idx;
+	q->dma_ch = DMA_WR_DATA_CH + idx;
+	INIT_LIST_HEAD(&q->h2ep_empty_list);
+	spin_lock_init(&q->h2ep_empty_lock);
+
+	q->h2ep_empty.rd = &host_ring_buf->host_cnt->h2ep_empty_rd_cnt;
+	q->h2ep_empty.wr = &ep_ring_buf->ep_cnt->h2ep_empty_wr_cnt;
+	q->h2ep_full.rd = &ep_ring_buf->ep_cnt->h2ep_full_rd_cnt;
+	q->h2ep_full.wr = &host_ring_buf->host_cnt->h2ep_full_wr_cnt;
+	q->ep2h_empty.rd = &ep_ring_buf->ep_cnt->ep2h_empty_rd_cnt;
+	q->ep2h_empty.wr = &host_ring_buf->host_cnt->ep2h_empty_wr_cnt;
+	q->ep2h_full.rd = &host_ring_buf->host_cnt->ep2h_full_rd_cnt;
+	q->ep2h_full.wr = &ep_ring_buf->ep_cnt->ep2h_full_wr_cnt;
+}
+
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0))
 static int tvnet_ep_pci_epf_core_init(struct pci_epf *epf)
 {
@@ -1223,7 +1325,9 @@ static int tvnet_ep_pci_epf_notifier(struct notifier_block *nb,
 {
 	struct pci_epf *epf = container_of(nb, struct pci_epf, nb);
 	struct pci_epf_tvnet *tvnet = epf_get_drvdata(epf);
+	struct tvnet_queue *q;
 	int ret;
+	u32 i;
 
 	switch (val) {
 	case CORE_INIT:
@@ -1233,17 +1337,18 @@ static int tvnet_ep_pci_epf_notifier(struct notifier_block *nb,
 		break;
 
 	case LINK_UP:
-#if ENABLE_DMA
 		tvnet_ep_setup_dma(tvnet);
-#endif
 
 		/*
 		 * If host goes through a suspend resume, it recycles EP2H
 		 * empty buffer. Clear any pending EP2H full buffer by setting
 		 * "wr_cnt = rd_cnt".
 		 */
-		tvnet_ivc_set_wr(&tvnet->ep2h_full,
-				 tvnet_ivc_get_rd_cnt(&tvnet->ep2h_full));
+		for (i = 0; i < TVNET_MAX_QUEUES; i++) {
+			q = &tvnet->queues[i];
+			tvnet_ivc_set_wr(&q->ep2h_full,
+					 tvnet_ivc_get_rd_cnt(&q->ep2h_full));
+		}
 
 		tvnet->pcie_link_status = true;
 		break;
@@ -1259,17 +1364,20 @@ static int tvnet_ep_pci_epf_notifier(struct notifier_block *nb,
 static void tvnet_ep_pci_epf_linkup(struct pci_epf *epf)
 {
 	struct pci_epf_tvnet *tvnet = epf_get_drvdata(epf);
+	struct tvnet_queue *q;
+	u32 i;
 
-#if ENABLE_DMA
 	tvnet_ep_setup_dma(tvnet);
-#endif
 
 	/*
 	 * If host goes through a suspend resume, it recycles EP2H empty buffer.
 	 * Clear any pending EP2H full buffer by setting "wr_cnt = rd_cnt".
 	 */
-	tvnet_ivc_set_wr(&tvnet->ep2h_full,
-			 tvnet_ivc_get_rd_cnt(&tvnet->ep2h_full));
+	for (i = 0; i < TVNET_MAX_QUEUES; i++) {
+		q = &tvnet->queues[i];
+		tvnet_ivc_set_wr(&q->ep2h_full,
+				 tvnet_ivc_get_rd_cnt(&q->ep2h_full));
+	}
 
 	tvnet->pcie_link_status = true;
 }
@@ -1293,7 +1401,9 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 	struct resource *res;
 	struct bar0_amap *amap;
 	struct tvnet_dma_desc *dma_desc;
-	int ret, size, bitmap_size;
+	dma_addr_t iova;
+	int ret, size;
+	u32 i;
 
 	if (!domain) {
 		dev_err(fdev, "IOMMU domain not found\n");
@@ -1345,6 +1455,8 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 
 	tvnet->bar_md = (struct bar_md *)tvnet->bar0_amap[META_DATA].virt;
 	bar_md = tvnet->bar_md;
+	/* Host checks magic, so don't leave stale data from alloc_pages() */
+	memset(bar_md, 0, sizeof(*bar_md));
 
 	/* BAR0 SIMPLE_IRQ setup: two interrupts required two pages */
 	amap = &tvnet->bar0_amap[SIMPLE_IRQ];
@@ -1363,6 +1475,8 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 		tvnet->bar0_amap[SIMPLE_IRQ].size;
 	size = sizeof(struct ep_own_cnt) + (RING_COUNT *
 		(sizeof(struct ctrl_msg) + 2 * sizeof(struct data_msg)));
+	size += (TVNET_MAX_QUEUES - 1) *
+		TVNET_QUEUE_MEM_SIZE(struct ep_own_cnt);
 	amap->size = PAGE_ALIGN(size);
 	ret = tvnet_ep_alloc_multi_page_bar0_mem(epf, EP_MEM);
 	if (ret < 0) {
@@ -1370,15 +1484,11 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 		goto free_irqsp;
 	}
 
+	/* Clear EP counters of all queues */
+	memset(amap->virt, 0, amap->size);
 	ep_ring_buf->ep_cnt = (struct ep_own_cnt *)amap->virt;
 	ep_ring_buf->ep2h_ctrl_msgs = (struct ctrl_msg *)
 				(ep_ring_buf->ep_cnt + 1);
-	ep_ring_buf->ep2h_full_msgs = (struct data_msg *)
-				(ep_ring_buf->ep2h_ctrl_msgs + RING_COUNT);
-	ep_ring_buf->h2ep_empty_msgs = (struct data_msg *)
-				(ep_ring_buf->ep2h_full_msgs + RING_COUNT);
-	/* Clear EP counters */
-	memset(ep_ring_buf->ep_cnt, 0, sizeof(struct ep_own_cnt));
 
 	/* BAR0 host memory allocation */
 	amap = &tvnet->bar0_amap[HOST_MEM];
@@ -1386,6 +1496,8 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 					tvnet->bar0_amap[EP_MEM].size;
 	size = (sizeof(struct host_own_cnt)) + (RING_COUNT *
 		(sizeof(struct ctrl_msg) + 2 * sizeof(struct data_msg)));
+	size += (TVNET_MAX_QUEUES - 1) *
+		TVNET_QUEUE_MEM_SIZE(struct host_own_cnt);
 	amap->size = PAGE_ALIGN(size);
 	ret = tvnet_ep_alloc_multi_page_bar0_mem(epf, HOST_MEM);
 	if (ret < 0) {
@@ -1393,37 +1505,36 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 		goto free_ep_mem;
 	}
 
+	/* Clear host counters of all queues */
+	memset(amap->virt, 0, amap->size);
 	host_ring_buf->host_cnt = (struct host_own_cnt *)amap->virt;
 	host_ring_buf->h2ep_ctrl_msgs = (struct ctrl_msg *)
 				(host_ring_buf->host_cnt + 1);
-	host_ring_buf->ep2h_empty_msgs = (struct data_msg *)
-				(host_ring_buf->h2ep_ctrl_msgs + RING_COUNT);
-	host_ring_buf->h2ep_full_msgs = (struct data_msg *)
-				(host_ring_buf->ep2h_empty_msgs + RING_COUNT);
-	/* Clear host counters */
-	memset(host_ring_buf->host_cnt, 0, sizeof(struct host_own_cnt));
 
 	/*
-	 * Allocate local memory for DMA read link list elements.
-	 * This is exposed through BAR0 to initiate DMA read from host.
+	 * Allocate local memory for DMA read link list elements, one desc
+	 * ring per queue. This is exposed through BAR0 to initiate DMA read
+	 * from host.
 	 */
 	amap = &tvnet->bar0_amap[HOST_DMA];
 	amap->iova = tvnet->bar0_amap[HOST_MEM].iova +
 					tvnet->bar0_amap[HOST_MEM].size;
-	size = ((DMA_DESC_COUNT + 1) * sizeof(struct tvnet_dma_desc));
-	amap->size = PAGE_ALIGN(size);
+	amap->size = TVNET_MAX_QUEUES * TVNET_DMA_RING_SIZE;
 	ret = tvnet_ep_alloc_multi_page_bar0_mem(epf, HOST_DMA);
 	if (ret < 0) {
 		dev_err(fdev, "BAR0 host dma mem alloc failed: %d\n", ret);
 		goto free_host_mem;
 	}
 
-	/* Set link list pointer to create a dma desc ring */
+	/* Set link list pointer to create a dma desc ring per queue */
 	memset(amap->virt, 0, amap->size);
-	dma_desc = (struct tvnet_dma_desc *)amap->virt;
-	dma_desc[DMA_DESC_COUNT].sar_low = (amap->iova & 0xffffffff);
-	dma_desc[DMA_DESC_COUNT].sar_high = ((amap->iova >> 32) & 0xffffffff);
-	dma_desc[DMA_DESC_COUNT].ctrl_reg.ctrl_e.llp = 1;
+	for (i = 0; i < TVNET_MAX_QUEUES; i++) {
+		iova = amap->iova + (i * TVNET_DMA_RING_SIZE);
+		dma_desc = amap->virt + (i * TVNET_DMA_RING_SIZE);
+		dma_desc[DMA_DESC_COUNT].sar_low = lower_32_bits(iova);
+		dma_desc[DMA_DESC_COUNT].sar_high = upper_32_bits(iova);
+		dma_desc[DMA_DESC_COUNT].ctrl_reg.ctrl_e.llp = 1;
+	}
 
 	/* Update BAR metadata region with offsets */
 	/* EP owned memory */
@@ -1456,23 +1567,13 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 	tvnet->h2ep_ctrl.wr = &host_ring_buf->host_cnt->h2ep_ctrl_wr_cnt;
 	tvnet->ep2h_ctrl.rd = &host_ring_buf->host_cnt->ep2h_ctrl_rd_cnt;
 	tvnet->ep2h_ctrl.wr = &ep_ring_buf->ep_cnt->ep2h_ctrl_wr_cnt;
-	tvnet->h2ep_empty.rd = &host_ring_buf->host_cnt->h2ep_empty_rd_cnt;
-	tvnet->h2ep_empty.wr = &ep_ring_buf->ep_cnt->h2ep_empty_wr_cnt;
-	tvnet->h2ep_full.rd = &ep_ring_buf->ep_cnt->h2ep_full_rd_cnt;
-	tvnet->h2ep_full.wr = &host_ring_buf->host_cnt->h2ep_full_wr_cnt;
-	tvnet->ep2h_empty.rd = &ep_ring_buf->ep_cnt->ep2h_empty_rd_cnt;
-	tvnet->ep2h_empty.wr = &host_ring_buf->host_cnt->ep2h_empty_wr_cnt;
-	tvnet->ep2h_full.rd = &host_ring_buf->host_cnt->ep2h_full_rd_cnt;
-	tvnet->ep2h_full.wr = &ep_ring_buf->ep_cnt->ep2h_full_wr_cnt;
 
 	/* RAM region for use by host when programming EP DMA controller */
 	bar_md->host_dma_offset = bar_md->host_own_cnt_offset +
 					tvnet->bar0_amap[HOST_MEM].size;
-	bar_md->host_dma_size = tvnet->bar0_amap[HOST_DMA].size;
+	bar_md->host_dma_size = TVNET_DMA_RING_SIZE;
 
 	/* EP Rx pkt IOVA range */
-	tvnet->rx_buf_iova = tvnet->bar0_amap[HOST_DMA].iova +
-					tvnet->bar0_amap[HOST_DMA].size;
 	bar_md->bar0_base_phy = tvnet->bar0_iova;
 	bar_md->ep_rx_pkt_offset = bar_md->host_dma_offset +
 					tvnet->bar0_amap[HOST_DMA].size;
@@ -1483,41 +1584,39 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 					tvnet->bar0_amap[HOST_MEM].size -
 					tvnet->bar0_amap[HOST_DMA].size;
 
-	/* Create bitmap for allocating RX buffers */
-	tvnet->rx_num_pages = (bar_md->ep_rx_pkt_size >> PAGE_SHIFT);
-	bitmap_size = BITS_TO_LONGS(tvnet->rx_num_pages) * sizeof(long);
-	tvnet->rx_buf_bitmap = devm_kzalloc(fdev, bitmap_size, GFP_KERNEL);
-	if (!tvnet->rx_buf_bitmap) {
-		dev_err(fdev, "rx_bitmap mem alloc failed\n");
-		ret = -ENOMEM;
-		goto free_host_dma;
-	}
-
-	/* Allocate PCIe memory for RP's dst address during xmit */
-	tvnet->tx_dst_va = pci_epc_wc_mem_alloc_addr(epc,
-						     &tvnet->tx_dst_pci_addr,
-						     SZ_64K);
-	if (!tvnet->tx_dst_va) {
-		dev_err(fdev, "failed to allocate dst PCIe address\n");
-		ret = -ENOMEM;
-		goto free_host_dma;
-	}
+	/* Queue pairs, queue 0 is the one described by the fields above */
+	for (i = 0; i < TVNET_MAX_QUEUES; i++)
+		tvnet_ep_setup_queue(tvnet, i);
+	tvnet->num_active = 1;
+	bar_md->num_queues = TVNET_MAX_QUEUES;
+	bar_md->version = TVNET_BAR_MD_VERSION;
+	/* Host may only look at v2 fields once they are all written */
+	wmb();
+	bar_md->magic = TVNET_BAR_MD_MAGIC;
 
 	/* Register network device */
-	ndev = alloc_etherdev(0);
+	ndev = alloc_etherdev_mq(0, TVNET_MAX_QUEUES);
 	if (!ndev) {
-		dev_err(fdev, "alloc_etherdev() failed\n");
+		dev_err(fdev, "alloc_etherdev_mq() failed\n");
 		ret = -ENOMEM;
-		goto free_pci_mem;
+		goto free_host_dma;
 	}
 
 	eth_hw_addr_random(ndev);
 	tvnet->ndev = ndev;
 	SET_NETDEV_DEV(ndev, fdev);
 	ndev->netdev_ops = &tvnet_netdev_ops;
-	netif_napi_add(ndev, &tvnet->napi, tvnet_ep_poll, TVNET_NAPI_WEIGHT);
+	for (i = 0; i < TVNET_MAX_QUEUES; i++)
+		netif_napi_add(ndev, &tvnet->queues[i].napi, tvnet_ep_poll,
+			       TVNET_NAPI_WEIGHT);
 
 	ndev->mtu = TVNET_DEFAULT_MTU;
+	/* Each skb segment is DMAed directly, see tvnet_tx_buf_map() */
+	/* TSO only to version 2 host, see tvnet_ep_features_check() */
+	ndev->hw_features = NETIF_F_SG | NETIF_F_HW_CSUM | NETIF_F_TSO |
+				NETIF_F_TSO6;
+	netif_set_gso_max_size(ndev, TVNET_GSO_MAX_SIZE);
+	ndev->features |= ndev->hw_features;
 
 	ret = register_netdev(ndev);
 	if (ret < 0) {
@@ -1532,9 +1631,6 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 	mutex_init(&tvnet->link_state_lock);
 	init_waitqueue_head(&tvnet->link_state_wq);
 
-	INIT_LIST_HEAD(&tvnet->h2ep_empty_list);
-	spin_lock_init(&tvnet->h2ep_empty_lock);
-
 	INIT_WORK(&tvnet->raise_irq_work, tvnet_ep_raise_irq_work_function);
 
 #if (LINUX_VERSION_CODE <= KERNEL_VERSION(4, 15, 0))
@@ -1557,7 +1653,7 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 #endif
 
 	/* Allocate local memory for DMA write link list elements */
-	size = ((DMA_DESC_COUNT + 1) * sizeof(struct tvnet_dma_desc));
+	size = TVNET_MAX_QUEUES * TVNET_DMA_RING_SIZE;
 	tvnet->ep_dma_virt = dma_alloc_coherent(cdev, size,
 						&tvnet->ep_dma_iova,
 						GFP_KERNEL);
@@ -1567,13 +1663,19 @@ static int tvnet_ep_pci_epf_bind(struct pci_epf *epf)
 		goto fail_clear_bar;
 	}
 
-	/* Set link list pointer to create a dma desc ring */
+	/* Set link list pointer to create a dma desc ring per queue */
 	memset(tvnet->ep_dma_virt, 0, size);
-	dma_desc = (struct tvnet_dma_desc *)tvnet->ep_dma_virt;
-	dma_desc[DMA_DESC_COUNT].sar_low = (tvnet->ep_dma_iova & 0xffffffff);
-	dma_desc[DMA_DESC_COUNT].sar_high = ((tvnet->ep_dma_iova >> 32) &
-					     0xffffffff);
-	dma_desc[DMA_DESC_COUNT].ctrl_reg.ctrl_e.llp = 1;
+	for (i = 0; i < TVNET_MAX_QUEUES; i++) {
+		struct tvnet_queue *q = &tvnet->queues[i];
+
+		q->ep_dma_virt = tvnet->ep_dma_virt + (i * TVNET_DMA_RING_SIZE);
+		q->ep_dma_iova = tvnet->ep_dma_iova + (i * TVNET_DMA_RING_SIZE);
+		dma_desc = q->ep_dma_virt;
+		dma_desc[DMA_DESC_COUNT].sar_low = lower_32_bits(q->ep_dma_iova);
+		dma_desc[DMA_DESC_COUNT].sar_high =
+						upper_32_bits(q->ep_dma_iova);
+		dma_desc[DMA_DESC_COUNT].ctrl_reg.ctrl_e.llp = 1;
+	}
 
 	nvhost_interrupt_syncpt_prime(tvnet->ctrl_irqsp->is);
 	nvhost_interrupt_syncpt_prime(tvnet->data_irqsp->is);
@@ -1592,11 +1694,9 @@ fail_unreg_netdev:
 #endif
 	unregister_netdev(ndev);
 fail_free_netdev:
-	netif_napi_del(&tvnet->napi);
+	for (i = 0; i < TVNET_MAX_QUEUES; i++)
+		netif_napi_del(&tvnet->queues[i].napi);
 	free_netdev(ndev);
-free_pci_mem:
-	pci_epc_mem_free_addr(epc, tvnet->tx_dst_pci_addr, tvnet->tx_dst_va,
-			      SZ_64K);
 free_host_dma:
 	tvnet_ep_free_multi_page_bar0_mem(epf, HOST_DMA);
 free_host_mem:
@@ -1621,6 +1721,7 @@ static void tvnet_ep_pci_epf_unbind(struct pci_epf *epf)
 #endif
 	struct pci_epc *epc = epf->epc;
 	struct device *cdev = epc->dev.parent;
+	u32 i;
 
 	cancel_work_sync(&tvnet->ctrl_irqsp->reprime_work);
 	cancel_work_sync(&tvnet->data_irqsp->reprime_work);
@@ -1630,14 +1731,12 @@ static void tvnet_ep_pci_epf_unbind(struct pci_epf *epf)
 #else
 	pci_epc_clear_bar(epc, BAR_0);
 #endif
-	dma_free_coherent(cdev,
-			  ((RING_COUNT + 1) * sizeof(struct tvnet_dma_desc)),
+	dma_free_coherent(cdev, TVNET_MAX_QUEUES * TVNET_DMA_RING_SIZE,
 			  tvnet->ep_dma_virt, tvnet->ep_dma_iova);
 	unregister_netdev(tvnet->ndev);
-	netif_napi_del(&tvnet->napi);
+	for (i = 0; i < TVNET_MAX_QUEUES; i++)
+		netif_napi_del(&tvnet->queues[i].napi);
 	free_netdev(tvnet->ndev);
-	pci_epc_mem_free_addr(epc, tvnet->tx_dst_pci_addr, tvnet->tx_dst_va,
-			      SZ_64K);
 	tvnet_ep_free_multi_page_bar0_mem(epf, HOST_DMA);
 	tvnet_ep_free_multi_page_bar0_mem(epf, HOST_MEM);
 	tvnet_ep_free_multi_page_bar0_mem(epf, EP_MEM);
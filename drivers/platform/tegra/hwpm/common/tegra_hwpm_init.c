@@ -110,6 +110,21 @@ int tegra_hwpm_init_sw_components(struct tegra_soc_hwpm *hwpm)
 		return err;
 	}
 
+	idr_init(&hwpm->reg_ops_progs);
+	mutex_init(&hwpm->reg_ops_prog_lock);
+
+	err = tegra_hwpm_init_addr_map(hwpm);
+	if (err != 0) {
+		tegra_hwpm_err(hwpm, "Unable to initialize address map");
+		return err;
+	}
+
+	err = tegra_hwpm_init_stream_notify(hwpm);
+	if (err != 0) {
+		tegra_hwpm_err(hwpm, "Unable to initialize stream notify");
+		return err;
+	}
+
 	return 0;
 }
 
@@ -120,6 +135,11 @@ void tegra_hwpm_release_sw_components(struct tegra_soc_hwpm *hwpm)
 
 	tegra_hwpm_fn(hwpm, " ");
 
+	tegra_hwpm_release_regops_progs(hwpm);
+	idr_destroy(&hwpm->reg_ops_progs);
+	tegra_hwpm_release_addr_map(hwpm);
+	tegra_hwpm_release_stream_notify(hwpm);
+
 	hwpm->active_chip->release_sw_setup(hwpm);
 
 	while (node != NULL) {
@@ -19,6 +19,8 @@
 #include <linux/string.h>
 #include <linux/of_address.h>
 #include <linux/dma-buf.h>
+#include <linux/jiffies.h>
+#include <linux/gfp.h>
 #include <soc/tegra/fuse.h>
 #include <uapi/linux/tegra-soc-hwpm-uapi.h>
 
@@ -27,6 +29,171 @@
 #include <tegra_hwpm_common.h>
 #include <tegra_hwpm_static_analysis.h>
 
+/* Default MEM_BYTES sampling interval for stream notification */
+#define TEGRA_HWPM_STREAM_NOTIFY_PERIOD_US	1000U
+
+/*
+ * Sample PMA stream state into the status page.
+ * Caller must hold stream_lock.
+ */
+static void tegra_hwpm_stream_sample(struct tegra_soc_hwpm *hwpm,
+	u64 mem_bump)
+{
+	struct tegra_soc_hwpm_stream_status *status = hwpm->stream_status;
+	u32 mem_bytes = TEGRA_SOC_HWPM_MEM_BYTES_INVALID;
+	u64 mem_head = 0ULL;
+	bool overflowed = false;
+
+	/* A value streamed before the last bump does not reflect it */
+	if ((hwpm->mem_bytes_kernel != NULL) &&
+		!hwpm->stream_mem_bytes_stale) {
+		mem_bytes = READ_ONCE(*(u32 *)(hwpm->mem_bytes_kernel));
+	}
+	mem_head = hwpm->active_chip->get_mem_bytes_put_ptr(hwpm);
+	overflowed = hwpm->active_chip->membuf_overflow_status(hwpm);
+
+	/* Odd seq tells mmap readers an update is in progress */
+	WRITE_ONCE(status->seq, status->seq + 1ULL);
+	smp_wmb();
+
+	if (mem_bytes != TEGRA_SOC_HWPM_MEM_BYTES_INVALID) {
+		status->mem_bytes = mem_bytes;
+	}
+	status->mem_bytes -= min(mem_bump, status->mem_bytes);
+	status->mem_bumped += mem_bump;
+	status->mem_head = mem_head;
+	if (overflowed && (status->b_overflowed == 0U)) {
+		status->overflow_count++;
+	}
+	status->b_overflowed = (u8)overflowed;
+
+	smp_wmb();
+	WRITE_ONCE(status->seq, status->seq + 1ULL);
+}
+
+static void tegra_hwpm_stream_notify_work_fn(struct work_struct *work)
+{
+	struct tegra_soc_hwpm *hwpm = container_of(to_delayed_work(work),
+		struct tegra_soc_hwpm, stream_notify_work);
+	bool wake = false;
+	int err = 0;
+
+	mutex_lock(&hwpm->stream_lock);
+
+	if ((hwpm->stream_fill_threshold == 0ULL) ||
+		(hwpm->mem_bytes_kernel == NULL)) {
+		mutex_unlock(&hwpm->stream_lock);
+		return;
+	}
+
+	tegra_hwpm_stream_sample(hwpm, 0ULL);
+	wake = tegra_hwpm_stream_fill_reached(hwpm);
+
+	/* Request a fresh MEM_BYTES value for the next sample */
+	err = hwpm->active_chip->stream_mem_bytes(hwpm);
+	if (err != 0) {
+		tegra_hwpm_err(hwpm, "Failed to trigger mem_bytes streaming");
+	} else {
+		hwpm->stream_mem_bytes_stale = false;
+	}
+
+	mutex_unlock(&hwpm->stream_lock);
+
+	if (wake) {
+		wake_up_interruptible(&hwpm->stream_wq);
+	}
+
+	if (err == 0) {
+		schedule_delayed_work(&hwpm->stream_notify_work,
+			usecs_to_jiffies(hwpm->stream_period_us));
+	}
+}
+
+void tegra_hwpm_stop_stream_notify(struct tegra_soc_hwpm *hwpm)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	mutex_lock(&hwpm->stream_lock);
+	hwpm->stream_fill_threshold = 0ULL;
+	mutex_unlock(&hwpm->stream_lock);
+
+	cancel_delayed_work_sync(&hwpm->stream_notify_work);
+	wake_up_interruptible(&hwpm->stream_wq);
+}
+
+int tegra_hwpm_init_stream_notify(struct tegra_soc_hwpm *hwpm)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	hwpm->stream_status = (struct tegra_soc_hwpm_stream_status *)
+		get_zeroed_page(GFP_KERNEL);
+	if (hwpm->stream_status == NULL) {
+		tegra_hwpm_err(hwpm, "stream status page alloc failed");
+		return -ENOMEM;
+	}
+
+	mutex_init(&hwpm->stream_lock);
+	init_waitqueue_head(&hwpm->stream_wq);
+	INIT_DELAYED_WORK(&hwpm->stream_notify_work,
+		tegra_hwpm_stream_notify_work_fn);
+	hwpm->stream_fill_threshold = 0ULL;
+	hwpm->stream_period_us = TEGRA_HWPM_STREAM_NOTIFY_PERIOD_US;
+
+	return 0;
+}
+
+void tegra_hwpm_release_stream_notify(struct tegra_soc_hwpm *hwpm)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (hwpm->stream_status == NULL) {
+		return;
+	}
+
+	tegra_hwpm_stop_stream_notify(hwpm);
+	free_page((unsigned long)hwpm->stream_status);
+	hwpm->stream_status = NULL;
+}
+
+int tegra_hwpm_set_stream_notify(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_stream_notify *stream_notify)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (stream_notify->fill_threshold == 0ULL) {
+		tegra_hwpm_stop_stream_notify(hwpm);
+		return 0;
+	}
+
+	mutex_lock(&hwpm->stream_lock);
+	hwpm->stream_fill_threshold = stream_notify->fill_threshold;
+	hwpm->stream_period_us = (stream_notify->period_us != 0U) ?
+		stream_notify->period_us : TEGRA_HWPM_STREAM_NOTIFY_PERIOD_US;
+	mutex_unlock(&hwpm->stream_lock);
+
+	tegra_hwpm_dbg(hwpm, hwpm_dbg_update_get_put,
+		"stream notify threshold 0x%llx period %u us",
+		stream_notify->fill_threshold, hwpm->stream_period_us);
+
+	mod_delayed_work(system_wq, &hwpm->stream_notify_work, 0);
+
+	return 0;
+}
+
+/* True if poll() waiters should be woken up */
+bool tegra_hwpm_stream_fill_reached(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_soc_hwpm_stream_status *status = hwpm->stream_status;
+	u64 threshold = READ_ONCE(hwpm->stream_fill_threshold);
+
+	if (threshold == 0ULL) {
+		return false;
+	}
+
+	return (READ_ONCE(status->mem_bytes) >= threshold) ||
+		(READ_ONCE(status->b_overflowed) != 0U);
+}
+
 static int tegra_hwpm_dma_map_stream_buffer(struct tegra_soc_hwpm *hwpm,
 	struct tegra_soc_hwpm_alloc_pma_stream *alloc_pma_stream)
 {
@@ -176,6 +343,13 @@ int tegra_hwpm_map_stream_buffer(struct tegra_soc_hwpm *hwpm,
 		goto fail;
 	}
 
+	mutex_lock(&hwpm->stream_lock);
+	memset(hwpm->stream_status, 0, sizeof(*hwpm->stream_status));
+	hwpm->stream_status->stream_buf_size =
+		alloc_pma_stream->stream_buf_size;
+	hwpm->stream_mem_bytes_stale = false;
+	mutex_unlock(&hwpm->stream_lock);
+
 	return 0;
 
 fail:
@@ -208,6 +382,8 @@ int tegra_hwpm_clear_mem_pipeline(struct tegra_soc_hwpm *hwpm)
 
 	tegra_hwpm_fn(hwpm, " ");
 
+	tegra_hwpm_stop_stream_notify(hwpm);
+
 	/* Stream MEM_BYTES to clear pipeline */
 	if (hwpm->mem_bytes_kernel) {
 		s32 timeout_msecs = 1000;
@@ -264,27 +440,43 @@ int tegra_hwpm_update_mem_bytes(struct tegra_soc_hwpm *hwpm,
 
 	tegra_hwpm_fn(hwpm, " ");
 
+	mutex_lock(&hwpm->stream_lock);
+
 	/* Update SW get pointer */
 	ret = hwpm->active_chip->update_mem_bytes_get_ptr(hwpm,
 		update_get_put->mem_bump);
 	if (ret != 0) {
 		tegra_hwpm_err(hwpm, "Failed to update mem_bytes get ptr");
+		mutex_unlock(&hwpm->stream_lock);
 		return -EINVAL;
 	}
 
-	/* Stream MEM_BYTES value to MEM_BYTES buffer */
-	if (update_get_put->b_stream_mem_bytes) {
+	/* Refresh status page, this also reads HW put and overflow status */
+	tegra_hwpm_stream_sample(hwpm, update_get_put->mem_bump);
+	if (update_get_put->mem_bump != 0ULL) {
+		hwpm->stream_mem_bytes_stale = true;
+	}
+
+	/*
+	 * Stream MEM_BYTES value to MEM_BYTES buffer.
+	 * Always do this while stream notification is enabled so that the
+	 * next sample reflects the bump.
+	 */
+	if (update_get_put->b_stream_mem_bytes ||
+		(hwpm->stream_fill_threshold != 0ULL)) {
 		ret = hwpm->active_chip->stream_mem_bytes(hwpm);
 		if (ret != 0) {
 			tegra_hwpm_err(hwpm,
 				"Failed to trigger mem_bytes streaming");
+		} else {
+			/* Buffer reads INVALID until the new value lands */
+			hwpm->stream_mem_bytes_stale = false;
 		}
 	}
 
 	/* Read HW put pointer */
 	if (update_get_put->b_read_mem_head) {
-		update_get_put->mem_head =
-			hwpm->active_chip->get_mem_bytes_put_ptr(hwpm);
+		update_get_put->mem_head = hwpm->stream_status->mem_head;
 		tegra_hwpm_dbg(hwpm, hwpm_dbg_update_get_put,
 			"MEM_HEAD = 0x%llx", update_get_put->mem_head);
 	}
@@ -292,10 +484,12 @@ int tegra_hwpm_update_mem_bytes(struct tegra_soc_hwpm *hwpm,
 	/* Check overflow error status */
 	if (update_get_put->b_check_overflow) {
 		update_get_put->b_overflowed =
-			(u8) hwpm->active_chip->membuf_overflow_status(hwpm);
+			hwpm->stream_status->b_overflowed;
 		tegra_hwpm_dbg(hwpm, hwpm_dbg_update_get_put, "OVERFLOWED = %u",
 			update_get_put->b_overflowed);
 	}
 
+	mutex_unlock(&hwpm->stream_lock);
+
 	return 0;
 }
@@ -11,6 +11,9 @@
  * more details.
  */
 
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 #include <soc/tegra/fuse.h>
 
 #include <uapi/linux/tegra-soc-hwpm-uapi.h>
@@ -21,31 +24,259 @@
 #include <tegra_hwpm_common.h>
 #include <tegra_hwpm_static_analysis.h>
 
-static int tegra_hwpm_exec_reg_ops(struct tegra_soc_hwpm *hwpm,
-	struct tegra_soc_hwpm_reg_op *reg_op)
+struct tegra_hwpm_addr_range {
+	u64 start_abs_pa;
+	u64 end_abs_pa;
+	/* Highest end_abs_pa of this and all lower sorted ranges */
+	u64 max_end_abs_pa;
+	u32 ip_idx;
+	struct hwpm_ip *chip_ip;
+	struct hwpm_ip_inst *ip_inst;
+	struct hwpm_ip_aperture *element;
+};
+
+struct tegra_hwpm_reg_ops_prog {
+	u32 mode;
+	u32 op_count;
+	struct tegra_soc_hwpm_reg_op *ops;
+	/* Resolved element of each op, NULL if the op failed validation */
+	struct tegra_hwpm_addr_range **ranges;
+};
+
+/* Max number of reg ops programs alive at a time */
+#define TEGRA_HWPM_REG_OPS_PROGS_MAX	64
+
+static int tegra_hwpm_addr_range_cmp(const void *a, const void *b)
+{
+	const struct tegra_hwpm_addr_range *ra = a;
+	const struct tegra_hwpm_addr_range *rb = b;
+
+	if (ra->start_abs_pa < rb->start_abs_pa) {
+		return -1;
+	}
+	if (ra->start_abs_pa > rb->start_abs_pa) {
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Walk all populated elements of all IPs, either to count them
+ * (addr_map == NULL) or to record their address ranges in addr_map.
+ * Only elements set in element_arr are recorded, the same slots the
+ * FIND_GIVEN_ADDRESS aperture walk looks at.
+ */
+static u32 tegra_hwpm_walk_elements(struct tegra_soc_hwpm *hwpm,
+	struct tegra_hwpm_addr_range *addr_map)
 {
-	bool found = false;
-	u32 ip_idx = TEGRA_SOC_HWPM_IP_INACTIVE;
-	u32 inst_idx = 0U, element_idx = 0U;
-	u32 a_type = 0U;
-	u32 reg_val = 0U;
-	u64 addr_hi = 0ULL;
-	int err = 0;
-	enum tegra_hwpm_element_type element_type = HWPM_ELEMENT_INVALID;
 	struct tegra_soc_hwpm_chip *active_chip = hwpm->active_chip;
+	struct tegra_hwpm_addr_range *range = NULL;
 	struct hwpm_ip *chip_ip = NULL;
-	struct hwpm_ip_inst_per_aperture_info *inst_a_info = NULL;
 	struct hwpm_ip_inst *ip_inst = NULL;
 	struct hwpm_ip_element_info *e_info = NULL;
 	struct hwpm_ip_aperture *element = NULL;
+	u32 ip_idx, inst_idx, a_type, element_idx;
+	u32 count = 0U;
+
+	for (ip_idx = 0U; ip_idx < active_chip->get_ip_max_idx(hwpm);
+		ip_idx++) {
+		chip_ip = active_chip->chip_ips[ip_idx];
+		if (chip_ip == NULL) {
+			continue;
+		}
+
+		for (inst_idx = 0U; inst_idx < chip_ip->num_instances;
+			inst_idx++) {
+			ip_inst = &chip_ip->ip_inst_static_array[inst_idx];
+
+			for (a_type = 0U; a_type < TEGRA_HWPM_APERTURE_TYPE_MAX;
+				a_type++) {
+				e_info = &ip_inst->element_info[a_type];
+				if (e_info->element_arr == NULL) {
+					continue;
+				}
+
+				for (element_idx = 0U;
+					element_idx < e_info->element_slots;
+					element_idx++) {
+					element =
+						e_info->element_arr[element_idx];
+					if (element == NULL) {
+						continue;
+					}
+
+					if (addr_map != NULL) {
+						range = &addr_map[count];
+						range->element = element;
+						range->start_abs_pa =
+							element->start_abs_pa;
+						range->end_abs_pa =
+							element->end_abs_pa;
+						range->ip_idx = ip_idx;
+						range->chip_ip = chip_ip;
+						range->ip_inst = ip_inst;
+					}
+					count++;
+				}
+			}
+		}
+	}
 
+	return count;
+}
+
+/*
+ * Build a table of all element address ranges sorted by start address,
+ * so that reg ops can find their element with a binary search instead of
+ * walking every IP, aperture type and instance.
+ * Element ranges are static after IP structures are initialized; only
+ * availability (reservation and floorsweeping) changes at runtime and is
+ * checked on every lookup.
+ * Ranges may overlap, e.g. MC broadcast apertures sit inside the perfmux
+ * range, so every entry also keeps the highest end address below it.
+ */
+int tegra_hwpm_init_addr_map(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_hwpm_addr_range *range = NULL;
+	u64 max_end = 0ULL;
+	u32 count = 0U;
+	u32 idx;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	count = tegra_hwpm_walk_elements(hwpm, NULL);
+	if (count == 0U) {
+		return 0;
+	}
+
+	hwpm->addr_map = kcalloc(count,
+		sizeof(struct tegra_hwpm_addr_range), GFP_KERNEL);
+	if (hwpm->addr_map == NULL) {
+		tegra_hwpm_err(hwpm, "addr map alloc failed");
+		return -ENOMEM;
+	}
+
+	hwpm->addr_map_size = tegra_hwpm_walk_elements(hwpm, hwpm->addr_map);
+	sort(hwpm->addr_map, hwpm->addr_map_size,
+		sizeof(struct tegra_hwpm_addr_range),
+		tegra_hwpm_addr_range_cmp, NULL);
+
+	for (idx = 0U; idx < hwpm->addr_map_size; idx++) {
+		range = &hwpm->addr_map[idx];
+		if (range->end_abs_pa > max_end) {
+			max_end = range->end_abs_pa;
+		}
+		range->max_end_abs_pa = max_end;
+	}
+
+	tegra_hwpm_dbg(hwpm, hwpm_dbg_driver_init,
+		"addr map: %d element ranges", hwpm->addr_map_size);
+
+	return 0;
+}
+
+void tegra_hwpm_release_addr_map(struct tegra_soc_hwpm *hwpm)
+{
 	tegra_hwpm_fn(hwpm, " ");
 
+	kfree(hwpm->addr_map);
+	hwpm->addr_map = NULL;
+	hwpm->addr_map_size = 0U;
+}
+
+/*
+ * Find the next range containing phys_addr, going down from the range
+ * with the highest start address. Pass prev = NULL to start the search
+ * and the previous result to get the next enclosing range.
+ */
+static struct tegra_hwpm_addr_range *tegra_hwpm_addr_map_find(
+	struct tegra_soc_hwpm *hwpm, u64 phys_addr,
+	struct tegra_hwpm_addr_range *prev)
+{
+	struct tegra_hwpm_addr_range *range = NULL;
+	u32 lo = 0U, hi = hwpm->addr_map_size, mid;
+
+	if (prev != NULL) {
+		lo = (u32)(prev - hwpm->addr_map);
+	} else {
+		/* Find the last range starting at or below phys_addr */
+		while (lo < hi) {
+			mid = lo + ((hi - lo) / 2U);
+			if (hwpm->addr_map[mid].start_abs_pa <= phys_addr) {
+				lo = mid + 1U;
+			} else {
+				hi = mid;
+			}
+		}
+	}
+
+	/* No lower range reaches phys_addr once max_end is below it */
+	while (lo > 0U) {
+		range = &hwpm->addr_map[lo - 1U];
+		if (range->max_end_abs_pa < phys_addr) {
+			break;
+		}
+		if (phys_addr <= range->end_abs_pa) {
+			return range;
+		}
+		lo--;
+	}
+
+	return NULL;
+}
+
+/* Same availability checks as the FIND_GIVEN_ADDRESS aperture walk */
+static bool tegra_hwpm_addr_range_available(struct tegra_soc_hwpm *hwpm,
+	struct tegra_hwpm_addr_range *range)
+{
+	if (range->chip_ip->override_enable) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
+			"IP %d override enabled", range->ip_idx);
+		return false;
+	}
+
+	if (!range->chip_ip->reserved) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
+			"IP %d not reserved", range->ip_idx);
+		return false;
+	}
+
+	if ((range->chip_ip->inst_fs_mask &
+		range->ip_inst->hw_inst_mask) == 0U) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
+			"IP %d inst mask 0x%x not available",
+			range->ip_idx, range->ip_inst->hw_inst_mask);
+		return false;
+	}
+
+	if ((range->element->element_index_mask &
+		range->ip_inst->element_fs_mask) == 0U) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
+			"IP %d element %s not available",
+			range->ip_idx, range->element->name);
+		return false;
+	}
+
+	return true;
+}
+
+static int tegra_hwpm_resolve_reg_op(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_op *reg_op,
+	struct tegra_hwpm_addr_range **range_out)
+{
+	struct tegra_hwpm_addr_range *range = NULL;
+
 	/* Find IP aperture containing phys_addr in allowlist */
-	found = tegra_hwpm_aperture_for_address(hwpm,
-		TEGRA_HWPM_FIND_GIVEN_ADDRESS, reg_op->phys_addr,
-		&ip_idx, &inst_idx, &element_idx, &element_type);
-	if (!found) {
+	range = tegra_hwpm_addr_map_find(hwpm, reg_op->phys_addr, NULL);
+	while ((range != NULL) &&
+		(!tegra_hwpm_addr_range_available(hwpm, range) ||
+		!hwpm->active_chip->check_alist(hwpm,
+			range->element, reg_op->phys_addr))) {
+		/* Try enclosing ranges, the address can be in more than one */
+		range = tegra_hwpm_addr_map_find(hwpm,
+			reg_op->phys_addr, range);
+	}
+	if (range == NULL) {
 		/* Silent failure as regops can continue on error */
 		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
 			"Phys addr 0x%llx not available in any IP",
@@ -55,31 +286,21 @@ static int tegra_hwpm_exec_reg_ops(struct tegra_soc_hwpm *hwpm,
 	}
 
 	tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
-		"Found addr 0x%llx IP %d inst_idx %d element_idx %d e_type %d",
-		reg_op->phys_addr, ip_idx, inst_idx, element_idx, element_type);
+		"Found addr 0x%llx IP %d element %s e_type %d",
+		reg_op->phys_addr, range->ip_idx, range->element->name,
+		range->element->element_type);
 
-	switch (element_type) {
-	case HWPM_ELEMENT_PERFMON:
-		a_type = TEGRA_HWPM_APERTURE_TYPE_PERFMON;
-		break;
-	case HWPM_ELEMENT_PERFMUX:
-	case IP_ELEMENT_PERFMUX:
-		a_type = TEGRA_HWPM_APERTURE_TYPE_PERFMUX;
-		break;
-	case IP_ELEMENT_BROADCAST:
-		a_type = TEGRA_HWPM_APERTURE_TYPE_BROADCAST;
-		break;
-	case HWPM_ELEMENT_INVALID:
-	default:
-		tegra_hwpm_err(hwpm, "Invalid element type %d", element_type);
-		return -EINVAL;
-	}
+	*range_out = range;
+	return 0;
+}
 
-	chip_ip = active_chip->chip_ips[ip_idx];
-	inst_a_info = &chip_ip->inst_aperture_info[a_type];
-	ip_inst = inst_a_info->inst_arr[inst_idx];
-	e_info = &ip_inst->element_info[a_type];
-	element = e_info->element_arr[element_idx];
+static int tegra_hwpm_do_reg_op(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_op *reg_op,
+	struct hwpm_ip_inst *ip_inst, struct hwpm_ip_aperture *element)
+{
+	u32 reg_val = 0U;
+	u64 addr_hi = 0ULL;
+	int err = 0;
 
 	switch (reg_op->cmd) {
 	case TEGRA_SOC_HWPM_REG_OP_CMD_RD32:
@@ -176,6 +397,23 @@ static int tegra_hwpm_exec_reg_ops(struct tegra_soc_hwpm *hwpm,
 	return 0;
 }
 
+static int tegra_hwpm_exec_reg_ops(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_op *reg_op)
+{
+	struct tegra_hwpm_addr_range *range = NULL;
+	int err = 0;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	err = tegra_hwpm_resolve_reg_op(hwpm, reg_op, &range);
+	if (err != 0) {
+		return err;
+	}
+
+	return tegra_hwpm_do_reg_op(hwpm, reg_op,
+		range->ip_inst, range->element);
+}
+
 int tegra_hwpm_exec_regops(struct tegra_soc_hwpm *hwpm,
 	struct tegra_soc_hwpm_exec_reg_ops *exec_reg_ops)
 {
@@ -227,3 +465,237 @@ int tegra_hwpm_exec_regops(struct tegra_soc_hwpm *hwpm,
 
 	return 0;
 }
+
+static bool tegra_hwpm_reg_op_cmd_valid(u8 cmd)
+{
+	switch (cmd) {
+	case TEGRA_SOC_HWPM_REG_OP_CMD_RD32:
+	case TEGRA_SOC_HWPM_REG_OP_CMD_RD64:
+	case TEGRA_SOC_HWPM_REG_OP_CMD_WR32:
+	case TEGRA_SOC_HWPM_REG_OP_CMD_WR64:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void tegra_hwpm_free_regops_prog(struct tegra_hwpm_reg_ops_prog *prog)
+{
+	vfree(prog->ranges);
+	vfree(prog->ops);
+	kfree(prog);
+}
+
+/*
+ * Validate a reg ops program once and keep the resolved element of each op,
+ * so that executing the program only needs to recheck element availability.
+ * ops is a kernel copy of the user array, statuses are updated in place.
+ */
+int tegra_hwpm_create_regops_prog(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_ops_prog *prog_args,
+	struct tegra_soc_hwpm_reg_op *ops)
+{
+	struct tegra_hwpm_reg_ops_prog *prog = NULL;
+	struct tegra_soc_hwpm_reg_op *reg_op = NULL;
+	u32 op_idx;
+	int id = 0;
+	int err = 0;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	switch (prog_args->mode) {
+	case TEGRA_SOC_HWPM_REG_OP_MODE_FAIL_ON_FIRST:
+	case TEGRA_SOC_HWPM_REG_OP_MODE_CONT_ON_ERR:
+		break;
+
+	default:
+		tegra_hwpm_err(hwpm, "Invalid reg ops mode(%u)",
+				   prog_args->mode);
+		return -EINVAL;
+	}
+
+	if ((prog_args->op_count == 0U) ||
+		(prog_args->op_count > TEGRA_SOC_HWPM_REG_OPS_PROG_SIZE)) {
+		tegra_hwpm_err(hwpm, "Reg_op count=%d invalid",
+				   prog_args->op_count);
+		return -EINVAL;
+	}
+
+	prog = kzalloc(sizeof(*prog), GFP_KERNEL);
+	if (prog == NULL) {
+		tegra_hwpm_err(hwpm, "reg ops prog alloc failed");
+		return -ENOMEM;
+	}
+
+	prog->mode = prog_args->mode;
+	prog->op_count = prog_args->op_count;
+	prog->ops = vmalloc(prog->op_count * sizeof(*prog->ops));
+	prog->ranges = vzalloc(prog->op_count * sizeof(*prog->ranges));
+	if ((prog->ops == NULL) || (prog->ranges == NULL)) {
+		tegra_hwpm_err(hwpm, "reg ops prog arrays alloc failed");
+		err = -ENOMEM;
+		goto fail;
+	}
+
+	prog_args->b_all_reg_ops_passed = true;
+
+	for (op_idx = 0U; op_idx < prog->op_count; op_idx++) {
+		reg_op = &ops[op_idx];
+
+		if (!tegra_hwpm_reg_op_cmd_valid(reg_op->cmd)) {
+			tegra_hwpm_err(hwpm, "Invalid reg op command(%u)",
+				reg_op->cmd);
+			reg_op->status = TEGRA_SOC_HWPM_REG_OP_STATUS_INVALID_CMD;
+			err = -EINVAL;
+		} else {
+			reg_op->status = TEGRA_SOC_HWPM_REG_OP_STATUS_SUCCESS;
+			err = tegra_hwpm_resolve_reg_op(hwpm, reg_op,
+				&prog->ranges[op_idx]);
+		}
+
+		if (err != 0) {
+			tegra_hwpm_err(hwpm, "reg op %d failed validation",
+				op_idx);
+			prog_args->b_all_reg_ops_passed = false;
+			if (prog_args->mode ==
+				TEGRA_SOC_HWPM_REG_OP_MODE_FAIL_ON_FIRST) {
+				err = -EINVAL;
+				goto fail;
+			}
+		}
+	}
+	memcpy(prog->ops, ops, prog->op_count * sizeof(*prog->ops));
+
+	mutex_lock(&hwpm->reg_ops_prog_lock);
+	id = idr_alloc(&hwpm->reg_ops_progs, prog, 1,
+		TEGRA_HWPM_REG_OPS_PROGS_MAX + 1, GFP_KERNEL);
+	mutex_unlock(&hwpm->reg_ops_prog_lock);
+	if (id < 0) {
+		tegra_hwpm_err(hwpm, "reg ops prog handle alloc failed(%d)", id);
+		err = id;
+		goto fail;
+	}
+
+	prog_args->handle = (u32)id;
+	tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
+		"reg ops prog %d created with %d ops", id, prog->op_count);
+
+	return 0;
+
+fail:
+	tegra_hwpm_free_regops_prog(prog);
+	return err;
+}
+
+/*
+ * Execute a validated reg ops program. If ops is not NULL, it receives
+ * the status and read values of every op. In FAIL_ON_FIRST mode the
+ * program stops at the first failing op and -EINVAL is returned.
+ */
+int tegra_hwpm_exec_regops_prog(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_ops_prog *prog_args,
+	struct tegra_soc_hwpm_reg_op *ops)
+{
+	struct tegra_hwpm_reg_ops_prog *prog = NULL;
+	struct tegra_hwpm_addr_range *range = NULL;
+	struct tegra_soc_hwpm_reg_op *reg_op = NULL;
+	u32 op_idx;
+	int err = 0;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	mutex_lock(&hwpm->reg_ops_prog_lock);
+
+	prog = idr_find(&hwpm->reg_ops_progs, prog_args->handle);
+	if (prog == NULL) {
+		tegra_hwpm_err(hwpm, "Invalid reg ops prog handle %d",
+			prog_args->handle);
+		err = -EINVAL;
+		goto done;
+	}
+
+	if ((ops != NULL) && (prog_args->op_count != prog->op_count)) {
+		tegra_hwpm_err(hwpm, "reg ops prog %d has %d ops, not %d",
+			prog_args->handle, prog->op_count,
+			prog_args->op_count);
+		err = -EINVAL;
+		goto done;
+	}
+
+	prog_args->b_all_reg_ops_passed = true;
+
+	for (op_idx = 0U; op_idx < prog->op_count; op_idx++) {
+		reg_op = &prog->ops[op_idx];
+		range = prog->ranges[op_idx];
+
+		if (range == NULL) {
+			/* Failed validation, status was set on create */
+			prog_args->b_all_reg_ops_passed = false;
+			continue;
+		}
+
+		/* Reservation or floorsweeping may have changed since create */
+		if (!tegra_hwpm_addr_range_available(hwpm, range)) {
+			reg_op->status =
+				TEGRA_SOC_HWPM_REG_OP_STATUS_INVALID_ADDR;
+		} else {
+			tegra_hwpm_do_reg_op(hwpm, reg_op,
+				range->ip_inst, range->element);
+		}
+
+		if (reg_op->status != TEGRA_SOC_HWPM_REG_OP_STATUS_SUCCESS) {
+			tegra_hwpm_err(hwpm, "reg ops prog %d op %d failed",
+				prog_args->handle, op_idx);
+			prog_args->b_all_reg_ops_passed = false;
+			if (prog->mode ==
+				TEGRA_SOC_HWPM_REG_OP_MODE_FAIL_ON_FIRST) {
+				err = -EINVAL;
+				break;
+			}
+		}
+	}
+
+	if (ops != NULL) {
+		memcpy(ops, prog->ops, prog->op_count * sizeof(*ops));
+	}
+
+done:
+	mutex_unlock(&hwpm->reg_ops_prog_lock);
+	return err;
+}
+
+int tegra_hwpm_destroy_regops_prog(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_ops_prog *prog_args)
+{
+	struct tegra_hwpm_reg_ops_prog *prog = NULL;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	mutex_lock(&hwpm->reg_ops_prog_lock);
+	prog = idr_remove(&hwpm->reg_ops_progs, prog_args->handle);
+	mutex_unlock(&hwpm->reg_ops_prog_lock);
+
+	if (prog == NULL) {
+		tegra_hwpm_err(hwpm, "Invalid reg ops prog handle %d",
+			prog_args->handle);
+		return -EINVAL;
+	}
+
+	tegra_hwpm_free_regops_prog(prog);
+	return 0;
+}
+
+void tegra_hwpm_release_regops_progs(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_hwpm_reg_ops_prog *prog = NULL;
+	int id;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	mutex_lock(&hwpm->reg_ops_prog_lock);
+	idr_for_each_entry(&hwpm->reg_ops_progs, prog, id) {
+		idr_remove(&hwpm->reg_ops_progs, id);
+		tegra_hwpm_free_regops_prog(prog);
+	}
+	mutex_unlock(&hwpm->reg_ops_prog_lock);
+}
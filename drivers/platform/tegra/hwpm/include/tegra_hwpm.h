@@ -18,6 +18,10 @@
 #include <linux/device.h>
 #include <linux/cdev.h>
 #include <linux/delay.h>
+#include <linux/idr.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <soc/tegra/fuse.h>
 
 #include <uapi/linux/tegra-soc-hwpm-uapi.h>
@@ -401,6 +405,7 @@ struct tegra_soc_hwpm_chip {
 };
 
 struct allowlist;
+struct tegra_hwpm_addr_range;
 extern struct platform_device *tegra_soc_hwpm_pdev;
 extern const struct file_operations tegra_soc_hwpm_ops;
 
@@ -435,6 +440,16 @@ struct tegra_soc_hwpm {
 	struct sg_table *mem_bytes_sgt;
 	void *mem_bytes_kernel;
 
+	/* PMA stream status page and fill level notification */
+	struct tegra_soc_hwpm_stream_status *stream_status;
+	struct mutex stream_lock;
+	struct delayed_work stream_notify_work;
+	wait_queue_head_t stream_wq;
+	u64 stream_fill_threshold;
+	u32 stream_period_us;
+	/* MEM_BYTES buffer predates the last bump, do not sample it */
+	bool stream_mem_bytes_stale;
+
 	/* SW State */
 	bool bind_completed;
 	bool device_opened;
@@ -442,6 +457,14 @@ struct tegra_soc_hwpm {
 
 	atomic_t hwpm_in_use;
 
+	/* Element address ranges sorted by start address, for reg ops */
+	struct tegra_hwpm_addr_range *addr_map;
+	u32 addr_map_size;
+
+	/* Validated reg ops programs, indexed by handle */
+	struct idr reg_ops_progs;
+	struct mutex reg_ops_prog_lock;
+
 	u32 dbg_mask;
 
 	/* Debugging */
@@ -20,10 +20,13 @@ enum tegra_hwpm_element_type;
 struct tegra_hwpm_func_args;
 struct tegra_soc_hwpm;
 struct tegra_soc_hwpm_exec_reg_ops;
+struct tegra_soc_hwpm_reg_ops_prog;
+struct tegra_soc_hwpm_reg_op;
 struct tegra_soc_hwpm_ip_floorsweep_info;
 struct tegra_soc_hwpm_resource_info;
 struct tegra_soc_hwpm_alloc_pma_stream;
 struct tegra_soc_hwpm_update_get_put;
+struct tegra_soc_hwpm_stream_notify;
 struct hwpm_ip;
 struct tegra_soc_hwpm_ip_ops;
 struct hwpm_ip_inst;
@@ -66,8 +69,19 @@ int tegra_hwpm_ip_handle_power_mgmt(struct tegra_soc_hwpm *hwpm,
 int tegra_hwpm_get_allowlist_size(struct tegra_soc_hwpm *hwpm);
 int tegra_hwpm_update_allowlist(struct tegra_soc_hwpm *hwpm,
 	void *ioctl_struct);
+int tegra_hwpm_init_addr_map(struct tegra_soc_hwpm *hwpm);
+void tegra_hwpm_release_addr_map(struct tegra_soc_hwpm *hwpm);
 int tegra_hwpm_exec_regops(struct tegra_soc_hwpm *hwpm,
 	struct tegra_soc_hwpm_exec_reg_ops *exec_reg_ops);
+int tegra_hwpm_create_regops_prog(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_ops_prog *prog_args,
+	struct tegra_soc_hwpm_reg_op *ops);
+int tegra_hwpm_exec_regops_prog(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_ops_prog *prog_args,
+	struct tegra_soc_hwpm_reg_op *ops);
+int tegra_hwpm_destroy_regops_prog(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_ops_prog *prog_args);
+void tegra_hwpm_release_regops_progs(struct tegra_soc_hwpm *hwpm);
 
 int tegra_hwpm_setup_hw(struct tegra_soc_hwpm *hwpm);
 int tegra_hwpm_setup_sw(struct tegra_soc_hwpm *hwpm);
@@ -85,5 +99,11 @@ int tegra_hwpm_map_stream_buffer(struct tegra_soc_hwpm *hwpm,
 int tegra_hwpm_clear_mem_pipeline(struct tegra_soc_hwpm *hwpm);
 int tegra_hwpm_update_mem_bytes(struct tegra_soc_hwpm *hwpm,
 	struct tegra_soc_hwpm_update_get_put *update_get_put);
+int tegra_hwpm_init_stream_notify(struct tegra_soc_hwpm *hwpm);
+void tegra_hwpm_release_stream_notify(struct tegra_soc_hwpm *hwpm);
+int tegra_hwpm_set_stream_notify(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_stream_notify *stream_notify);
+void tegra_hwpm_stop_stream_notify(struct tegra_soc_hwpm *hwpm);
+bool tegra_hwpm_stream_fill_reached(struct tegra_soc_hwpm *hwpm);
 
 #endif /* TEGRA_HWPM_COMMON_H */
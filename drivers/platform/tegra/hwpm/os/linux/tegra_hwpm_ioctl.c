@@ -22,6 +22,7 @@
 #include <linux/string.h>
 #include <linux/of_address.h>
 #include <linux/dma-buf.h>
+#include <linux/poll.h>
 #include <soc/tegra/fuse.h>
 #include <uapi/linux/tegra-soc-hwpm-uapi.h>
 
@@ -56,6 +57,14 @@ static int exec_reg_ops_ioctl(struct tegra_soc_hwpm *hwpm,
 			      void *ioctl_struct);
 static int update_get_put_ioctl(struct tegra_soc_hwpm *hwpm,
 				void *ioctl_struct);
+static int create_reg_ops_prog_ioctl(struct tegra_soc_hwpm *hwpm,
+				     void *ioctl_struct);
+static int exec_reg_ops_prog_ioctl(struct tegra_soc_hwpm *hwpm,
+				   void *ioctl_struct);
+static int destroy_reg_ops_prog_ioctl(struct tegra_soc_hwpm *hwpm,
+				      void *ioctl_struct);
+static int stream_notify_ioctl(struct tegra_soc_hwpm *hwpm,
+			       void *ioctl_struct);
 
 static const struct tegra_soc_hwpm_ioctl ioctls[] = {
 	[TEGRA_SOC_HWPM_IOCTL_DEVICE_INFO] = {
@@ -103,6 +112,26 @@ static const struct tegra_soc_hwpm_ioctl ioctls[] = {
 		.struct_size		= sizeof(struct tegra_soc_hwpm_update_get_put),
 		.handler		= update_get_put_ioctl,
 	},
+	[TEGRA_SOC_HWPM_IOCTL_CREATE_REG_OPS_PROG] = {
+		.name			= "create_reg_ops_prog",
+		.struct_size		= sizeof(struct tegra_soc_hwpm_reg_ops_prog),
+		.handler		= create_reg_ops_prog_ioctl,
+	},
+	[TEGRA_SOC_HWPM_IOCTL_EXEC_REG_OPS_PROG] = {
+		.name			= "exec_reg_ops_prog",
+		.struct_size		= sizeof(struct tegra_soc_hwpm_reg_ops_prog),
+		.handler		= exec_reg_ops_prog_ioctl,
+	},
+	[TEGRA_SOC_HWPM_IOCTL_DESTROY_REG_OPS_PROG] = {
+		.name			= "destroy_reg_ops_prog",
+		.struct_size		= sizeof(struct tegra_soc_hwpm_reg_ops_prog),
+		.handler		= destroy_reg_ops_prog_ioctl,
+	},
+	[TEGRA_SOC_HWPM_IOCTL_STREAM_NOTIFY] = {
+		.name			= "stream_notify",
+		.struct_size		= sizeof(struct tegra_soc_hwpm_stream_notify),
+		.handler		= stream_notify_ioctl,
+	},
 };
 
 static int device_info_ioctl(struct tegra_soc_hwpm *hwpm,
@@ -325,6 +354,144 @@ static int update_get_put_ioctl(struct tegra_soc_hwpm *hwpm,
 	return tegra_hwpm_update_mem_bytes(hwpm, update_get_put);
 }
 
+static int create_reg_ops_prog_ioctl(struct tegra_soc_hwpm *hwpm,
+				     void *ioctl_struct)
+{
+	struct tegra_soc_hwpm_reg_ops_prog *prog_args =
+		(struct tegra_soc_hwpm_reg_ops_prog *)ioctl_struct;
+	struct tegra_soc_hwpm_reg_op *ops = NULL;
+	size_t ops_size = 0;
+	int ret = 0;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (!hwpm->bind_completed) {
+		tegra_hwpm_err(hwpm,
+			"The CREATE_REG_OPS_PROG IOCTL can only be called"
+			" after the BIND IOCTL.");
+		return -EPERM;
+	}
+
+	if ((prog_args->ops == 0ULL) || (prog_args->op_count == 0U) ||
+		(prog_args->op_count > TEGRA_SOC_HWPM_REG_OPS_PROG_SIZE)) {
+		tegra_hwpm_err(hwpm, "Invalid reg ops program");
+		return -EINVAL;
+	}
+
+	ops_size = prog_args->op_count * sizeof(*ops);
+	ops = vmalloc(ops_size);
+	if (!ops) {
+		tegra_hwpm_err(hwpm, "Can't allocate memory for reg ops");
+		return -ENOMEM;
+	}
+
+	if (copy_from_user(ops, u64_to_user_ptr(prog_args->ops), ops_size)) {
+		tegra_hwpm_err(hwpm, "Failed to copy reg ops from userspace");
+		ret = -EFAULT;
+		goto done;
+	}
+
+	ret = tegra_hwpm_create_regops_prog(hwpm, prog_args, ops);
+
+	/* Pass back validation status of each op, even on failure */
+	if (copy_to_user(u64_to_user_ptr(prog_args->ops), ops, ops_size)) {
+		tegra_hwpm_err(hwpm, "Failed to copy reg ops to userspace");
+		if (ret == 0) {
+			tegra_hwpm_destroy_regops_prog(hwpm, prog_args);
+		}
+		ret = -EFAULT;
+	}
+
+done:
+	vfree(ops);
+	return ret;
+}
+
+static int exec_reg_ops_prog_ioctl(struct tegra_soc_hwpm *hwpm,
+				   void *ioctl_struct)
+{
+	struct tegra_soc_hwpm_reg_ops_prog *prog_args =
+		(struct tegra_soc_hwpm_reg_ops_prog *)ioctl_struct;
+	struct tegra_soc_hwpm_reg_op *ops = NULL;
+	size_t ops_size = 0;
+	int ret = 0;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (!hwpm->bind_completed) {
+		tegra_hwpm_err(hwpm,
+			"The EXEC_REG_OPS_PROG IOCTL can only be called"
+			" after the BIND IOCTL.");
+		return -EPERM;
+	}
+
+	if (prog_args->ops == 0ULL) {
+		/* Userspace doesn't need per op results */
+		return tegra_hwpm_exec_regops_prog(hwpm, prog_args, NULL);
+	}
+
+	if ((prog_args->op_count == 0U) ||
+		(prog_args->op_count > TEGRA_SOC_HWPM_REG_OPS_PROG_SIZE)) {
+		tegra_hwpm_err(hwpm, "Reg_op count=%d invalid",
+			prog_args->op_count);
+		return -EINVAL;
+	}
+
+	ops_size = prog_args->op_count * sizeof(*ops);
+	ops = vmalloc(ops_size);
+	if (!ops) {
+		tegra_hwpm_err(hwpm, "Can't allocate memory for reg ops");
+		return -ENOMEM;
+	}
+
+	/* Stays true if the program could not be run at all */
+	prog_args->b_all_reg_ops_passed = true;
+	ret = tegra_hwpm_exec_regops_prog(hwpm, prog_args, ops);
+
+	/* Pass back status of each op, also when FAIL_ON_FIRST stopped it */
+	if ((ret == 0) || !prog_args->b_all_reg_ops_passed) {
+		if (copy_to_user(u64_to_user_ptr(prog_args->ops),
+			ops, ops_size)) {
+			tegra_hwpm_err(hwpm,
+				"Failed to copy reg ops to userspace");
+			ret = -EFAULT;
+		}
+	}
+
+	vfree(ops);
+	return ret;
+}
+
+static int destroy_reg_ops_prog_ioctl(struct tegra_soc_hwpm *hwpm,
+				      void *ioctl_struct)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	return tegra_hwpm_destroy_regops_prog(hwpm,
+		(struct tegra_soc_hwpm_reg_ops_prog *)ioctl_struct);
+}
+
+static int stream_notify_ioctl(struct tegra_soc_hwpm *hwpm,
+			       void *ioctl_struct)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (!hwpm->bind_completed) {
+		tegra_hwpm_err(hwpm,
+			"The STREAM_NOTIFY IOCTL can only be called"
+			" after the BIND IOCTL.");
+		return -EPERM;
+	}
+	if (!hwpm->mem_bytes_kernel) {
+		tegra_hwpm_err(hwpm,
+			"mem_bytes buffer is not mapped in the driver");
+		return -ENXIO;
+	}
+
+	return tegra_hwpm_set_stream_notify(hwpm,
+		(struct tegra_soc_hwpm_stream_notify *)ioctl_struct);
+}
+
 static long tegra_hwpm_ioctl(struct file *file,
 				 unsigned int cmd,
 				 unsigned long arg)
@@ -537,6 +704,55 @@ static ssize_t tegra_hwpm_read(struct file *file,
 	return 0;
 }
 
+static __poll_t tegra_hwpm_poll(struct file *file, poll_table *wait)
+{
+	struct tegra_soc_hwpm *hwpm = file->private_data;
+	__poll_t mask = 0;
+
+	if (!hwpm) {
+		return EPOLLERR;
+	}
+
+	poll_wait(file, &hwpm->stream_wq, wait);
+
+	if (tegra_hwpm_stream_fill_reached(hwpm)) {
+		mask |= EPOLLIN | EPOLLRDNORM;
+		if (READ_ONCE(hwpm->stream_status->b_overflowed) != 0U) {
+			mask |= EPOLLERR;
+		}
+	}
+
+	return mask;
+}
+
+/* Map the read-only stream status page */
+static int tegra_hwpm_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct tegra_soc_hwpm *hwpm = file->private_data;
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (!hwpm) {
+		return -ENODEV;
+	}
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	if ((vma->vm_pgoff != 0UL) || (size > PAGE_SIZE)) {
+		tegra_hwpm_err(hwpm, "Invalid stream status mapping");
+		return -EINVAL;
+	}
+	if ((vma->vm_flags & VM_WRITE) != 0UL) {
+		tegra_hwpm_err(hwpm, "Stream status page is read-only");
+		return -EPERM;
+	}
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+	return remap_pfn_range(vma, vma->vm_start,
+		virt_to_phys(hwpm->stream_status) >> PAGE_SHIFT,
+		size, vma->vm_page_prot);
+}
+
 /* FIXME: Fix double release bug */
 static int tegra_hwpm_release(struct inode *inode, struct file *filp)
 {
@@ -560,11 +776,16 @@ static int tegra_hwpm_release(struct inode *inode, struct file *filp)
 
 	tegra_hwpm_fn(hwpm, " ");
 
+	/* Notify work samples PMA registers, stop it before anything else */
+	tegra_hwpm_stop_stream_notify(hwpm);
+
 	if (hwpm->device_opened == false) {
 		/* Device was not opened, do nothing */
 		return 0;
 	}
 
+	tegra_hwpm_release_regops_progs(hwpm);
+
 	ret = tegra_hwpm_disable_triggers(hwpm);
 	if (ret < 0) {
 		tegra_hwpm_err(hwpm, "Failed to disable PMA triggers");
@@ -576,7 +797,7 @@ static int tegra_hwpm_release(struct inode *inode, struct file *filp)
 	if (ret < 0) {
 		tegra_hwpm_err(hwpm, "Failed to release IP apertures");
 		err = ret;
-		goto fail;
+		/* Still drain the PMA pipeline before releasing HW */
 	}
 
 	/* Clear MEM_BYTES pipeline */
@@ -626,6 +847,8 @@ const struct file_operations tegra_soc_hwpm_ops = {
 	.open = tegra_hwpm_open,
 	.read = tegra_hwpm_read,
 	.release = tegra_hwpm_release,
+	.poll = tegra_hwpm_poll,
+	.mmap = tegra_hwpm_mmap,
 	.unlocked_ioctl = tegra_hwpm_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = tegra_hwpm_ioctl,
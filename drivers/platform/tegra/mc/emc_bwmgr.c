@@ -23,6 +23,7 @@
 #include <linux/debugfs.h>
 #include <linux/thermal.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
 #if KERNEL_VERSION(4, 15, 0) > LINUX_VERSION_CODE
 #include <soc/tegra/chip-id.h>
 #include <soc/tegra/tegra_bpmp.h>
@@ -83,8 +84,44 @@ static struct {
 	bool status;
 	struct bwmgr_ops *ops;
 	bool override;
+	/* last request programmed into emc_clk */
+	bool clk_valid;
+	unsigned long cap_req;
+	unsigned long rate_req;
+	struct delayed_work coalesce_work;
 } bwmgr;
 
+/*
+ * Aggregates over all clients, kept up to date on every request. Sums hold
+ * contributions clamped to emc_max_rate. Raising a cap or lowering a floor
+ * that set the aggregate only marks it dirty, and the next clock update
+ * rescans the clients.
+ */
+static struct {
+	u64 bw;
+	u64 iso_bw_nvdis;
+	u64 iso_bw_vi;
+	u64 iso_bw_other;
+	u64 iso_client_flags;
+	unsigned long non_iso_cap;
+	unsigned long iso_cap;
+	unsigned long floor;
+	bool dirty;
+} bwmgr_agg;
+
+static struct {
+	u64 requests;
+	u64 unchanged;
+	u64 rescans;
+	u64 clk_updates;
+	u64 clk_skipped;
+	u64 deferred;
+	u64 coalesced;
+} bwmgr_stats;
+
+/* window in which relaxing requests are merged into one clock update */
+static u32 bwmgr_coalesce_us = 1000;
+
 static struct dram_refresh_alrt {
 	unsigned long cur_state;
 	u32 max_cooling_state;
@@ -220,6 +257,100 @@ static void purge_client(struct tegra_bwmgr_client *handle)
 	handle->iso_cap = bwmgr.emc_max_rate;
 	handle->floor = 0;
 	handle->refcount = 0;
+	bwmgr_agg.dirty = true;
+}
+
+static u64 *bwmgr_iso_bucket(int i)
+{
+	if ((i == TEGRA_BWMGR_CLIENT_DISP0) ||
+			(i == TEGRA_BWMGR_CLIENT_DISP1) ||
+			(i == TEGRA_BWMGR_CLIENT_DISP2))
+		return &bwmgr_agg.iso_bw_nvdis;
+	else if (i == TEGRA_BWMGR_CLIENT_CAMERA)
+		return &bwmgr_agg.iso_bw_vi;
+
+	return &bwmgr_agg.iso_bw_other;
+}
+
+/* call with bwmgr lock held except during init */
+static void bwmgr_agg_rescan(void)
+{
+	int i;
+	struct tegra_bwmgr_client *c;
+
+	bwmgr_agg.bw = 0;
+	bwmgr_agg.iso_bw_nvdis = 0;
+	bwmgr_agg.iso_bw_vi = 0;
+	bwmgr_agg.iso_bw_other = 0;
+	bwmgr_agg.iso_client_flags = 0;
+	bwmgr_agg.non_iso_cap = bwmgr.emc_max_rate;
+	bwmgr_agg.iso_cap = bwmgr.emc_max_rate;
+	bwmgr_agg.floor = 0;
+
+	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
+		c = bwmgr.bwmgr_client + i;
+
+		bwmgr_agg.bw += min(c->bw, bwmgr.emc_max_rate);
+		if (c->iso_bw > 0) {
+			bwmgr_agg.iso_client_flags |= BIT_ULL(i);
+			*bwmgr_iso_bucket(i) +=
+				min(c->iso_bw, bwmgr.emc_max_rate);
+		}
+
+		bwmgr_agg.non_iso_cap = min(bwmgr_agg.non_iso_cap, c->cap);
+		bwmgr_agg.iso_cap = min(bwmgr_agg.iso_cap, c->iso_cap);
+		bwmgr_agg.floor = max(bwmgr_agg.floor, c->floor);
+	}
+
+	bwmgr_agg.dirty = false;
+	bwmgr_stats.rescans++;
+}
+
+/* call with bwmgr lock held */
+static int bwmgr_apply_clk(unsigned long cap_req, unsigned long rate)
+{
+	unsigned long clk_cap;
+	bool cap_changed = !bwmgr.clk_valid || cap_req != bwmgr.cap_req;
+	int ret;
+
+	if (!cap_changed && rate == bwmgr.rate_req) {
+		bwmgr_stats.clk_skipped++;
+		return 0;
+	}
+
+	bwmgr.clk_valid = false;
+	bwmgr_stats.clk_updates++;
+
+	if (cap_changed) {
+		ret = clk_set_max_rate(bwmgr.emc_clk, ULONG_MAX);
+		if (ret) {
+			pr_err("bwmgr: clk_set_max_rate failed for freq %lu Hz with errno %d\n",
+			       ULONG_MAX, ret);
+			return ret;
+		}
+
+		clk_cap = clk_round_rate(bwmgr.emc_clk, cap_req);
+		ret = clk_set_max_rate(bwmgr.emc_clk, clk_cap);
+		if (ret) {
+			pr_err("bwmgr: clk_set_max_rate failed for freq %lu Hz with errno %d\n",
+			       clk_cap, ret);
+			return ret;
+		}
+	}
+
+	ret = clk_set_rate(bwmgr.emc_clk, rate);
+	if (ret) {
+		pr_err
+		("bwmgr: clk_set_rate failed for freq %lu Hz with errno %d\n",
+				rate, ret);
+		return ret;
+	}
+
+	bwmgr.cap_req = cap_req;
+	bwmgr.rate_req = rate;
+	bwmgr.clk_valid = true;
+
+	return 0;
 }
 
 static unsigned long tegra_bwmgr_apply_efficiency(
@@ -233,22 +364,25 @@ static unsigned long tegra_bwmgr_apply_efficiency(
 			iso_bw_nvdis, iso_bw_vi);
 }
 
-/* call with bwmgr lock held */
-static int bwmgr_update_clk(void)
+/*
+ * call with bwmgr lock held
+ *
+ * Requests that only relax the clock (lower rate, higher cap) are deferred
+ * by bwmgr_coalesce_us so that a burst of them costs one clock update.
+ * Anything that needs more bandwidth or a tighter cap is applied right away.
+ */
+static int bwmgr_update_clk(bool sync)
 {
-	int i;
-	unsigned long bw = 0;
-	unsigned long iso_bw = 0; // iso_bw_guarantee
-	unsigned long iso_bw_nvdis = 0; //DISP0 + DISP1 + DISP2
-	unsigned long iso_bw_vi = 0; //CAMERA
-	unsigned long iso_bw_other_clients = 0; //Other ISO clients
-	unsigned long non_iso_cap = bwmgr.emc_max_rate;
-	unsigned long iso_cap = bwmgr.emc_max_rate;
-	unsigned long clk_cap = bwmgr.emc_max_rate;
-	unsigned long floor = 0;
+	unsigned long bw;
+	unsigned long iso_bw; // iso_bw_guarantee
+	unsigned long iso_bw_nvdis; //DISP0 + DISP1 + DISP2
+	unsigned long iso_bw_vi; //CAMERA
+	unsigned long iso_bw_other_clients; //Other ISO clients
+	unsigned long non_iso_cap;
+	unsigned long iso_cap;
+	unsigned long cap_req;
+	unsigned long floor;
 	unsigned long iso_bw_min;
-	u64 iso_client_flags = 0;
-	int ret = 0;
 
 	/* sizeof(iso_client_flags) */
 	BUILD_BUG_ON(TEGRA_BWMGR_CLIENT_COUNT > 64);
@@ -261,53 +395,20 @@ static int bwmgr_update_clk(void)
 	if (bwmgr.override)
 		return 0;
 
-	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
-		bw += bwmgr.bwmgr_client[i].bw;
-		bw = min(bw, bwmgr.emc_max_rate);
-
-		if (bwmgr.bwmgr_client[i].iso_bw > 0) {
-			iso_client_flags |= BIT(i);
-
-			if ((i == TEGRA_BWMGR_CLIENT_DISP0) ||
-					(i == TEGRA_BWMGR_CLIENT_DISP1) ||
-					(i == TEGRA_BWMGR_CLIENT_DISP2)) {
-				iso_bw_nvdis += bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_nvdis = min(iso_bw_nvdis,
-							bwmgr.emc_max_rate);
-			} else if (i == TEGRA_BWMGR_CLIENT_CAMERA) {
-				iso_bw_vi += bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_vi = min(iso_bw_vi, bwmgr.emc_max_rate);
-			} else {
-				iso_bw_other_clients +=
-						bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_other_clients = min(iso_bw_other_clients,
-							bwmgr.emc_max_rate);
-			}
-
-			iso_bw = iso_bw_nvdis + iso_bw_vi +
-						iso_bw_other_clients;
-			iso_bw = min(iso_bw, bwmgr.emc_max_rate);
-		}
-
-		non_iso_cap = min(non_iso_cap, bwmgr.bwmgr_client[i].cap);
-		iso_cap = min(iso_cap, bwmgr.bwmgr_client[i].iso_cap);
-		floor = max(floor, bwmgr.bwmgr_client[i].floor);
-	}
-
-	ret = clk_set_max_rate(bwmgr.emc_clk, ULONG_MAX);
-	if (ret) {
-		pr_err("bwmgr: clk_set_max_rate failed for freq %lu Hz with errno %d\n",
-		       ULONG_MAX, ret);
-		return ret;
-	}
-
-	clk_cap = clk_round_rate(bwmgr.emc_clk, min(iso_cap, non_iso_cap));
-	ret = clk_set_max_rate(bwmgr.emc_clk, clk_cap);
-	if (ret) {
-		pr_err("bwmgr: clk_set_max_rate failed for freq %lu Hz with errno %d\n",
-		       clk_cap, ret);
-		return ret;
-	}
+	if (bwmgr_agg.dirty)
+		bwmgr_agg_rescan();
+
+	bw = min_t(u64, bwmgr_agg.bw, bwmgr.emc_max_rate);
+	iso_bw_nvdis = min_t(u64, bwmgr_agg.iso_bw_nvdis, bwmgr.emc_max_rate);
+	iso_bw_vi = min_t(u64, bwmgr_agg.iso_bw_vi, bwmgr.emc_max_rate);
+	iso_bw_other_clients = min_t(u64, bwmgr_agg.iso_bw_other,
+				     bwmgr.emc_max_rate);
+	iso_bw = min(iso_bw_nvdis + iso_bw_vi + iso_bw_other_clients,
+		     bwmgr.emc_max_rate);
+	non_iso_cap = bwmgr_agg.non_iso_cap;
+	iso_cap = bwmgr_agg.iso_cap;
+	floor = bwmgr_agg.floor;
+	cap_req = min(iso_cap, non_iso_cap);
 
 	debug_info.bw = bw;
 	debug_info.iso_bw = iso_bw;
@@ -317,7 +418,7 @@ static int bwmgr_update_clk(void)
 	bw += iso_bw;
 	bw = tegra_bwmgr_apply_efficiency(
 			bw, iso_bw, bwmgr.emc_max_rate,
-			iso_client_flags, &iso_bw_min,
+			bwmgr_agg.iso_client_flags, &iso_bw_min,
 			iso_bw_nvdis, iso_bw_vi);
 	debug_info.total_bw_aftr_eff = bw;
 	debug_info.iso_bw_aftr_eff = iso_bw_min;
@@ -327,13 +428,32 @@ static int bwmgr_update_clk(void)
 	debug_info.calc_freq = bw;
 	debug_info.req_freq = bw;
 
-	ret = clk_set_rate(bwmgr.emc_clk, bw);
-	if (ret)
-		pr_err
-		("bwmgr: clk_set_rate failed for freq %lu Hz with errno %d\n",
-				bw, ret);
+	if (!sync && bwmgr_coalesce_us && bwmgr.clk_valid &&
+	    cap_req >= bwmgr.cap_req && bw <= bwmgr.rate_req &&
+	    (cap_req != bwmgr.cap_req || bw != bwmgr.rate_req)) {
+		if (schedule_delayed_work(&bwmgr.coalesce_work,
+				usecs_to_jiffies(bwmgr_coalesce_us)))
+			bwmgr_stats.deferred++;
+		else
+			bwmgr_stats.coalesced++;
+		return 0;
+	}
 
-	return ret;
+	return bwmgr_apply_clk(cap_req, bw);
+}
+
+static void bwmgr_coalesce_work_fn(struct work_struct *work)
+{
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return;
+	}
+
+	if (!clk_update_disabled)
+		bwmgr_update_clk(true);
+
+	if (!bwmgr_unlock())
+		pr_err("bwmgr: %s failed\n", __func__);
 }
 
 struct tegra_bwmgr_client *tegra_bwmgr_register(
@@ -511,6 +631,10 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 	switch (req) {
 	case TEGRA_BWMGR_SET_EMC_FLOOR:
 		if (handle->floor != val) {
+			if (val >= bwmgr_agg.floor)
+				bwmgr_agg.floor = val;
+			else if (handle->floor == bwmgr_agg.floor)
+				bwmgr_agg.dirty = true;
 			handle->floor = val;
 			update_clk = true;
 		}
@@ -521,6 +645,10 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val = bwmgr.emc_max_rate;
 
 		if (handle->cap != val) {
+			if (val <= bwmgr_agg.non_iso_cap)
+				bwmgr_agg.non_iso_cap = val;
+			else if (handle->cap == bwmgr_agg.non_iso_cap)
+				bwmgr_agg.dirty = true;
 			handle->cap = val;
 			update_clk = true;
 		}
@@ -531,6 +659,10 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val = bwmgr.emc_max_rate;
 
 		if (handle->iso_cap != val) {
+			if (val <= bwmgr_agg.iso_cap)
+				bwmgr_agg.iso_cap = val;
+			else if (handle->iso_cap == bwmgr_agg.iso_cap)
+				bwmgr_agg.dirty = true;
 			handle->iso_cap = val;
 			update_clk = true;
 		}
@@ -538,6 +670,8 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 
 	case TEGRA_BWMGR_SET_EMC_SHARED_BW:
 		if (handle->bw != val) {
+			bwmgr_agg.bw -= min(handle->bw, bwmgr.emc_max_rate);
+			bwmgr_agg.bw += min(val, bwmgr.emc_max_rate);
 			handle->bw = val;
 			update_clk = true;
 		}
@@ -545,6 +679,17 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 
 	case TEGRA_BWMGR_SET_EMC_SHARED_BW_ISO:
 		if (handle->iso_bw != val) {
+			u64 *bucket = bwmgr_iso_bucket(
+					handle - bwmgr.bwmgr_client);
+
+			*bucket -= min(handle->iso_bw, bwmgr.emc_max_rate);
+			*bucket += min(val, bwmgr.emc_max_rate);
+			if (val)
+				bwmgr_agg.iso_client_flags |=
+					BIT_ULL(handle - bwmgr.bwmgr_client);
+			else
+				bwmgr_agg.iso_client_flags &=
+					~BIT_ULL(handle - bwmgr.bwmgr_client);
 			handle->iso_bw = val;
 			update_clk = true;
 		}
@@ -561,8 +706,12 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 		return -EINVAL;
 	}
 
+	bwmgr_stats.requests++;
+	if (!update_clk)
+		bwmgr_stats.unchanged++;
+
 	if (update_clk && !clk_update_disabled)
-		ret = bwmgr_update_clk();
+		ret = bwmgr_update_clk(false);
 
 	if (!bwmgr_unlock()) {
 		pr_err("bwmgr: %s failed for client %s\n",
@@ -818,7 +967,7 @@ static int tegra_bwmgr_update_efficiency(unsigned long cur_state,
 		bwmgr.ops->update_efficiency(cur_state);
 
 	if (!clk_update_disabled)
-		ret = bwmgr_update_clk();
+		ret = bwmgr_update_clk(false);
 
 	if (!bwmgr_unlock()) {
 		pr_err("bwmgr: %s failed.\n", __func__);
@@ -870,6 +1019,7 @@ int __init bwmgr_init(void)
 #endif
 
 	mutex_init(&bwmgr.lock);
+	INIT_DELAYED_WORK(&bwmgr.coalesce_work, bwmgr_coalesce_work_fn);
 
 	if (tegra_get_chip_id() == TEGRA210)
 		bwmgr.ops = bwmgr_eff_init_t21x();
@@ -965,6 +1115,7 @@ bpmp_skip:
 
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
 		purge_client(bwmgr.bwmgr_client + i);
+	bwmgr_agg_rescan();
 
 	bwmgr_debugfs_init();
 
@@ -989,6 +1140,8 @@ void __exit bwmgr_exit(void)
 	if (bwmgr_disable)
 		return;
 
+	cancel_delayed_work_sync(&bwmgr.coalesce_work);
+
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
 		purge_client(bwmgr.bwmgr_client + i);
 
@@ -1081,9 +1234,10 @@ static int bwmgr_debugfs_emc_rate_set(void *data, u64 val)
 
 	if (val == 0) {
 		bwmgr.override = false;
-		bwmgr_update_clk();
+		bwmgr_update_clk(true);
 	} else if (bwmgr.emc_clk) {
 		bwmgr.override = true;
+		bwmgr.clk_valid = false;
 		ret = clk_set_rate(bwmgr.emc_clk, val);
 	}
 
@@ -1261,6 +1415,38 @@ static const struct file_operations fops_bwmgr_clients_info = {
 	.release = single_release,
 };
 
+static int bwmgr_stats_show(struct seq_file *s, void *data)
+{
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	seq_printf(s, "requests          : %llu\n", bwmgr_stats.requests);
+	seq_printf(s, "unchanged requests: %llu\n", bwmgr_stats.unchanged);
+	seq_printf(s, "aggregate rescans : %llu\n", bwmgr_stats.rescans);
+	seq_printf(s, "clock updates     : %llu\n", bwmgr_stats.clk_updates);
+	seq_printf(s, "identical skipped : %llu\n", bwmgr_stats.clk_skipped);
+	seq_printf(s, "deferred          : %llu\n", bwmgr_stats.deferred);
+	seq_printf(s, "coalesced         : %llu\n", bwmgr_stats.coalesced);
+	if (!bwmgr_unlock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int bwmgr_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bwmgr_stats_show, inode->i_private);
+}
+
+static const struct file_operations fops_bwmgr_stats = {
+	.open = bwmgr_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void bwmgr_debugfs_init(void)
 {
 	bwmgr_debugfs_client_handle =
@@ -1308,6 +1494,10 @@ static void bwmgr_debugfs_init(void)
 		debugfs_node_dram_channels = debugfs_create_file(
 			"num_dram_channels", S_IRUSR, debugfs_dir, NULL,
 			 &fops_debugfs_dram_channels);
+		debugfs_create_file("bwmgr_stats", S_IRUGO, debugfs_dir,
+			NULL, &fops_bwmgr_stats);
+		debugfs_create_u32("coalesce_us", S_IRUSR | S_IWUSR,
+			debugfs_dir, &bwmgr_coalesce_us);
 	} else
 		pr_err("bwmgr: error creating bwmgr debugfs dir.\n");
 
@@ -372,7 +372,7 @@ static void pre_t19x_iso_plat_unregister(struct isomgr_client *cp)
 }
 
 static bool pre_t19x_iso_plat_reserve(struct isomgr_client *cp, u32 bw,
-					enum tegra_iso_client client)
+					u32 mf, enum tegra_iso_client client)
 {
 	u64 bw_check;
 	u32 max_emc_bw;
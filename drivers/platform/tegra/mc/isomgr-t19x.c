@@ -198,8 +198,16 @@ static void t19x_iso_plat_unregister(struct isomgr_client *cp)
 }
 
 static bool t19x_iso_plat_reserve(struct isomgr_client *cp, u32 bw,
-					enum tegra_iso_client client)
+					u32 mf, enum tegra_iso_client client)
 {
+	/* Every admission since this client's last reserve counted it at
+	 * max(rsvd_mf, real_mf), so a request whose min freq, latency
+	 * floor included, is within that headroom is known to fit without
+	 * walking the DRAM frequency table again.
+	 */
+	if (mf <= max(cp->rsvd_mf, cp->real_mf))
+		return true;
+
 	if (is_isomgr_request_possible(1, 0, bw, 0, client))
 		return true;
 	else
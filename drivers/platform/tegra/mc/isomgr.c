@@ -127,6 +127,10 @@ struct isomgr isomgr = {
 static inline u32 mc_min_freq(u32 ubw, u32 ult) /* in KB/sec and usec */
 {
 	unsigned int min_freq = 0;
+#ifdef CONFIG_COMMON_CLK
+	u32 floor = 0;
+	unsigned int i;
+#endif
 
 	/* ult==0 means ignore LT (effectively infinite) */
 	if (ubw == 0)
@@ -134,6 +138,17 @@ static inline u32 mc_min_freq(u32 ubw, u32 ult) /* in KB/sec and usec */
 
 #ifdef CONFIG_COMMON_CLK
 	min_freq = bwmgr_bw_to_freq(ubw);
+
+	/* latency floor: stay above DVFS points that switch slower than ult */
+	for (i = 0; ult && i < bwmgr_emc_dvfs.num_pairs; i++) {
+		if (bwmgr_emc_dvfs.pairs[i].freq < min_freq)
+			continue;
+		if (bwmgr_emc_dvfs.pairs[i].latency / 1000 <= ult) {
+			min_freq = max(min_freq, floor);
+			break;
+		}
+		floor = bwmgr_emc_dvfs.pairs[i].freq + 1;
+	}
 #else
 	min_freq = tegra_emc_bw_to_freq_req(ubw);
 #endif
@@ -217,9 +232,13 @@ static void update_mc_clock(void)
 
 	for (i = 0; i < TEGRA_ISO_CLIENT_COUNT; i++) {
 
-		/*max emc floor req when camera is active for t194 */
-		if (i == TEGRA_ISO_CLIENT_TEGRA_CAMERA) {
-			if (isomgr_camera_max_floor_req) {
+		if (isomgr_clients[i].real_mf != isomgr_clients[i].real_mf_rq) {
+			/* max emc floor req when camera is active for t194.
+			 * camera going active or idle always changes real_mf,
+			 * so the floor only needs updating here.
+			 */
+			if (i == TEGRA_ISO_CLIENT_TEGRA_CAMERA &&
+			    isomgr_camera_max_floor_req) {
 				if (isomgr_clients[i].real_mf)
 					tegra_bwmgr_set_emc(
 						isomgr_clients[i].bwmgr_handle,
@@ -231,9 +250,7 @@ static void update_mc_clock(void)
 						0,
 						TEGRA_BWMGR_SET_EMC_FLOOR);
 			}
-		}
 
-		if (isomgr_clients[i].real_mf != isomgr_clients[i].real_mf_rq) {
 			/* Ignore clocks for clients that are non-existent. */
 #ifdef CONFIG_COMMON_CLK
 			if (!isomgr_clients[i].bwmgr_handle)
@@ -529,17 +546,21 @@ static u32 __tegra_isomgr_reserve(tegra_isomgr_handle handle,
 	if (unlikely(!cp->renegotiate && bw > cp->dedi_bw))
 		goto out;
 
+	/* Look up MC's min freq that could satisfy requested BW and LT */
+	mf = mc_min_freq(ubw, ult);
+
 	if (isomgr.ops->isomgr_plat_reserve) {
-		ret = isomgr.ops->isomgr_plat_reserve(cp, bw,
+		ret = isomgr.ops->isomgr_plat_reserve(cp, bw, mf,
 				(enum tegra_iso_client)client);
 		if (!ret)
 			goto out;
 	}
 
-	/* Look up MC's min freq that could satisfy requested BW and LT */
-	mf = mc_min_freq(ubw, ult);
-	/* Look up MC's dvfs latency at min freq */
-	dvfs_latency = mc_dvfs_latency(mf);
+	/* Look up MC's dvfs latency at min freq, unless it is already known */
+	if (cp->lto && mf == cp->rsvd_mf)
+		dvfs_latency = cp->lto;
+	else
+		dvfs_latency = mc_dvfs_latency(mf);
 
 	cp->lti = ult;		/* remember client spec'd LT (usec) */
 	cp->lto = dvfs_latency;	/* remember MC calculated LT (usec) */
@@ -590,34 +611,28 @@ u32 tegra_isomgr_reserve(tegra_isomgr_handle handle,
 }
 EXPORT_SYMBOL(tegra_isomgr_reserve);
 
-static u32 __tegra_isomgr_realize(tegra_isomgr_handle handle)
+/*
+ * call with isomgr_lock held. Sets *update if update_mc_clock() is needed
+ * to apply the realized bw.
+ */
+static u32 isomgr_realize_locked(struct isomgr_client *cp, bool *update)
 {
 	u32 dvfs_latency = 0;
 	bool ret = 0;
-	struct isomgr_client *cp = (struct isomgr_client *) handle;
 	int client = cp - &isomgr_clients[0];
 
-	VALIDATE_HANDLE();
-
-	if (!isomgr_lock()) {
-		pr_err("isomgr: %s failed for %s\n",
-			__func__, cname[client]);
-		goto validation_fail;
+	if (unlikely(!OBJ_REF_INC_NOT_ZERO(&cp->kref.refcount))) {
+		trace_tegra_isomgr_realize(cp, cname[client],
+			"inv_handle_exit");
+		return dvfs_latency;
 	}
-	if (unlikely(!OBJ_REF_INC_NOT_ZERO(&cp->kref.refcount)))
-		goto handle_unregistered;
 
 	if (cp->rsvd_bw == cp->real_bw && cp->rsvd_mf == cp->real_mf) {
 		kref_put(&cp->kref, unregister_iso_client);
-		if (!isomgr_unlock()) {
-			pr_err("isomgr: %s failed for %s\n",
-				__func__, cname[client]);
-			goto validation_fail;
-		}
 		return cp->lto;
 	}
 
-	trace_tegra_isomgr_realize(handle, cname[client], "enter");
+	trace_tegra_isomgr_realize(cp, cname[client], "enter");
 
 	if (isomgr.ops->isomgr_plat_realize) {
 		ret = isomgr.ops->isomgr_plat_realize(cp);
@@ -627,28 +642,65 @@ static u32 __tegra_isomgr_realize(tegra_isomgr_handle handle)
 
 	dvfs_latency = (u32)cp->lto;
 	cp->realize = false;
-	update_mc_clock();
+	*update = true;
 
 out:
 	kref_put(&cp->kref, unregister_iso_client);
-	if (!isomgr_unlock()) {
-		pr_err("isomgr: %s failed for %s\n",
-			__func__, cname[client]);
-		goto validation_fail;
-	}
-	trace_tegra_isomgr_realize(handle, cname[client],
+	trace_tegra_isomgr_realize(cp, cname[client],
 		dvfs_latency ? "exit" : "real_fail_exit");
 	return dvfs_latency;
-handle_unregistered:
+}
+
+static int __tegra_isomgr_realize_batch(tegra_isomgr_handle *handles,
+					u32 *dvfs_latency, int count)
+{
+	struct isomgr_client *cp;
+	bool update = false;
+	int client, i, ret = 0;
+
+	for (i = 0; i < count; i++) {
+		cp = (struct isomgr_client *)handles[i];
+		client = cp - &isomgr_clients[0];
+		if (unlikely(!cp || !is_client_valid(client) ||
+			     cp->magic != ISOMGR_MAGIC)) {
+			pr_err("bad handle %p\n", handles[i]);
+			trace_tegra_isomgr_realize(handles[i], "unk",
+				"inv_handle_exit");
+			return -EINVAL;
+		}
+	}
+
+	if (!isomgr_lock()) {
+		pr_err("isomgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < count; i++) {
+		dvfs_latency[i] = isomgr_realize_locked(
+				(struct isomgr_client *)handles[i], &update);
+		if (!dvfs_latency[i])
+			ret = -ENOMEM;
+	}
+
+	/* one clock update for the whole batch */
+	if (update)
+		update_mc_clock();
+
 	if (!isomgr_unlock()) {
-		pr_err("isomgr: %s failed for %s\n",
-			__func__, cname[client]);
-		goto validation_fail;
+		pr_err("isomgr: %s failed\n", __func__);
+		return -EINVAL;
 	}
-	trace_tegra_isomgr_realize(handle, cname[client], "inv_handle_exit");
-	return dvfs_latency;
-validation_fail:
-	trace_tegra_isomgr_realize(handle, "unk", "inv_handle_exit");
+
+	return ret;
+}
+
+static u32 __tegra_isomgr_realize(tegra_isomgr_handle handle)
+{
+	u32 dvfs_latency = 0;
+
+	/* a single realize is a batch of one */
+	__tegra_isomgr_realize_batch(&handle, &dvfs_latency, 1);
+
 	return dvfs_latency;
 }
 
@@ -670,6 +722,40 @@ u32 tegra_isomgr_realize(tegra_isomgr_handle handle)
 }
 EXPORT_SYMBOL(tegra_isomgr_realize);
 
+/**
+ * tegra_isomgr_realize_batch - realize the bw reserved by several clients.
+ *
+ * @handles	handles acquired during tegra_isomgr_register.
+ * @dvfs_latency	filled with what tegra_isomgr_realize() would return
+ *		for each handle.
+ * @count	number of handles.
+ *
+ * Same as calling tegra_isomgr_realize() for each handle, but the EMC
+ * requests are updated once for the whole batch.
+ *
+ * @retval  0 all reservations realized.
+ * @retval -ENOMEM some reservation could not be realized.
+ * @retval -EINVAL invalid arguments, nothing realized.
+ */
+int tegra_isomgr_realize_batch(tegra_isomgr_handle *handles,
+			       u32 *dvfs_latency, int count)
+{
+	int i;
+
+	IS_ISOMGR_SUPPORTED(isomgr_disable, -ENOTSUPP);
+
+	if (!handles || !dvfs_latency || count <= 0)
+		return -EINVAL;
+
+	if (test_mode) {
+		for (i = 0; i < count; i++)
+			dvfs_latency[i] = 1;
+		return 0;
+	}
+	return __tegra_isomgr_realize_batch(handles, dvfs_latency, count);
+}
+EXPORT_SYMBOL(tegra_isomgr_realize_batch);
+
 static int __tegra_isomgr_set_margin(enum tegra_iso_client client,
 					u32 bw, bool wait)
 {
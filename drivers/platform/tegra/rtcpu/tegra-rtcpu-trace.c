@@ -36,7 +36,11 @@
 #include <linux/workqueue.h>
 #include <linux/platform_device.h>
 #include <linux/nvhost.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
 #include <asm/cacheflush.h>
+#include <uapi/linux/tegra-rtcpu-trace.h>
 
 #ifdef CONFIG_EVENTLIB
 #include <linux/keventlib.h>
@@ -88,6 +92,10 @@ struct tegra_rtcpu_trace {
 	struct delayed_work work;
 	unsigned long work_interval_jiffies;
 
+	/* raw mode: events are left in the ring for user-space to decode */
+	atomic_t raw_users;
+	wait_queue_head_t raw_wq;
+
 	/* statistics */
 	u32 n_exceptions;
 	u64 n_events;
@@ -166,7 +174,7 @@ static void rtcpu_trace_init_memory(struct tegra_rtcpu_trace *tracer)
 	    (tracer->trace_memory_size - CAMRTC_TRACE_EVENT_OFFSET) /
 	    CAMRTC_TRACE_EVENT_SIZE;
 	tracer->dma_handle_events = tracer->dma_handle +
-	    CAMRTC_TRACE_EXCEPTION_OFFSET;
+	    CAMRTC_TRACE_EVENT_OFFSET;
 
 	{
 		struct camrtc_trace_memory_header header = {
@@ -1116,6 +1124,19 @@ static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 	if (old_next == new_next)
 		return;
 
+	/*
+	 * A raw reader decodes the ring itself through its mmap, so only
+	 * advance the index and wake it up.
+	 */
+	if (atomic_read(&tracer->raw_users) > 0) {
+		WRITE_ONCE(tracer->n_events, tracer->n_events +
+			(new_next + tracer->event_entries - old_next) %
+			tracer->event_entries);
+		WRITE_ONCE(tracer->event_last_idx, new_next);
+		wake_up_interruptible(&tracer->raw_wq);
+		return;
+	}
+
 	rtcpu_trace_invalidate_entries(tracer,
 				tracer->dma_handle_events,
 				old_next, new_next,
@@ -1133,7 +1154,7 @@ static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 			old_next = 0;
 	}
 
-	tracer->event_last_idx = new_next;
+	WRITE_ONCE(tracer->event_last_idx, new_next);
 	tracer->copy_last_event = *last_event;
 }
 
@@ -1257,6 +1278,127 @@ static int rtcpu_trace_debugfs_last_event_read(
 DEFINE_SEQ_FOPS(rtcpu_trace_debugfs_last_event,
 	rtcpu_trace_debugfs_last_event_read);
 
+/*
+ * Raw event ring access: mmap() gives a read-only view of the whole trace
+ * memory and read() returns a struct rtcpu_trace_raw_pos (see
+ * uapi/linux/tegra-rtcpu-trace.h) with the event index the kernel has seen
+ * so far. It blocks or polls until new events arrive after the position
+ * last returned to this reader. Per-event decoding in the kernel stops
+ * while a raw reader is open.
+ */
+
+struct rtcpu_trace_raw_reader {
+	struct tegra_rtcpu_trace *tracer;
+	u64 seen_seq;
+};
+
+static int rtcpu_trace_debugfs_raw_open(struct inode *inode, struct file *file)
+{
+	struct tegra_rtcpu_trace *tracer = inode->i_private;
+	struct rtcpu_trace_raw_reader *reader;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (reader == NULL)
+		return -ENOMEM;
+
+	reader->tracer = tracer;
+	mutex_lock(&tracer->lock);
+	reader->seen_seq = tracer->n_events;
+	mutex_unlock(&tracer->lock);
+	file->private_data = reader;
+	atomic_inc(&tracer->raw_users);
+
+	return nonseekable_open(inode, file);
+}
+
+static int rtcpu_trace_debugfs_raw_release(struct inode *inode,
+	struct file *file)
+{
+	struct rtcpu_trace_raw_reader *reader = file->private_data;
+
+	atomic_dec(&reader->tracer->raw_users);
+	kfree(reader);
+
+	return 0;
+}
+
+static ssize_t rtcpu_trace_debugfs_raw_read(struct file *file,
+	char __user *buf, size_t count, loff_t *ppos)
+{
+	struct rtcpu_trace_raw_reader *reader = file->private_data;
+	struct tegra_rtcpu_trace *tracer = reader->tracer;
+	struct rtcpu_trace_raw_pos pos = { 0 };
+	int ret;
+
+	if (count < sizeof(pos))
+		return -EINVAL;
+
+	if (READ_ONCE(tracer->n_events) == reader->seen_seq) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(tracer->raw_wq,
+			READ_ONCE(tracer->n_events) != reader->seen_seq);
+		if (ret)
+			return ret;
+	}
+
+	/* idx and seq are updated together under the lock */
+	mutex_lock(&tracer->lock);
+	pos.idx = tracer->event_last_idx;
+	pos.seq = tracer->n_events;
+	mutex_unlock(&tracer->lock);
+
+	if (copy_to_user(buf, &pos, sizeof(pos)))
+		return -EFAULT;
+
+	reader->seen_seq = pos.seq;
+
+	return sizeof(pos);
+}
+
+static __poll_t rtcpu_trace_debugfs_raw_poll(struct file *file,
+	struct poll_table_struct *pt)
+{
+	struct rtcpu_trace_raw_reader *reader = file->private_data;
+	struct tegra_rtcpu_trace *tracer = reader->tracer;
+
+	poll_wait(file, &tracer->raw_wq, pt);
+
+	if (READ_ONCE(tracer->n_events) != reader->seen_seq)
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+static int rtcpu_trace_debugfs_raw_mmap(struct file *file,
+	struct vm_area_struct *vma)
+{
+	struct rtcpu_trace_raw_reader *reader = file->private_data;
+	struct tegra_rtcpu_trace *tracer = reader->tracer;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	if (vma->vm_pgoff != 0 ||
+	    vma->vm_end - vma->vm_start > PAGE_ALIGN(tracer->trace_memory_size))
+		return -EINVAL;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return dma_mmap_coherent(tracer->dev, vma, tracer->trace_memory,
+				 tracer->dma_handle, tracer->trace_memory_size);
+}
+
+static const struct file_operations rtcpu_trace_debugfs_raw = {
+	.owner = THIS_MODULE,
+	.open = rtcpu_trace_debugfs_raw_open,
+	.release = rtcpu_trace_debugfs_raw_release,
+	.read = rtcpu_trace_debugfs_raw_read,
+	.poll = rtcpu_trace_debugfs_raw_poll,
+	.mmap = rtcpu_trace_debugfs_raw_mmap,
+	.llseek = no_llseek,
+};
+
 static void rtcpu_trace_debugfs_deinit(struct tegra_rtcpu_trace *tracer)
 {
 	debugfs_remove_recursive(tracer->debugfs_root);
@@ -1285,6 +1427,11 @@ static void rtcpu_trace_debugfs_init(struct tegra_rtcpu_trace *tracer)
 	if (IS_ERR_OR_NULL(entry))
 		goto failed_create;
 
+	entry = debugfs_create_file("raw", S_IRUSR,
+	    tracer->debugfs_root, tracer, &rtcpu_trace_debugfs_raw);
+	if (IS_ERR_OR_NULL(entry))
+		goto failed_create;
+
 	return;
 
 failed_create:
@@ -1308,6 +1455,8 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 
 	tracer->dev = dev;
 	mutex_init(&tracer->lock);
+	atomic_set(&tracer->raw_users, 0);
+	init_waitqueue_head(&tracer->raw_wq);
 
 	/* Get the trace memory */
 	ret = rtcpu_trace_setup_memory(tracer);
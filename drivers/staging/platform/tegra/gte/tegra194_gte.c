@@ -32,6 +32,9 @@
 #include <linux/file.h>
 #include <linux/poll.h>
 #include <linux/kfifo.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
 #include <uapi/linux/tegra-gte-ioctl.h>
 
 #define GTE_SUSPEND	0
@@ -138,6 +141,7 @@ static LIST_HEAD(gte_devices);
 #define GTE_EVENT_UNREGISTERING		1
 
 #define GTE_EV_FIFO_EL			32
+#define GTE_USPACE_EV_FIFO_EL		256
 #define GTE_MAX_EV_NAME_SZ		9
 
 struct gte_slices {
@@ -579,8 +583,9 @@ struct tegra_gte_ev_desc *tegra_gte_register_event(struct device_node *np,
 }
 EXPORT_SYMBOL(tegra_gte_register_event);
 
-int tegra_gte_retrieve_event(const struct tegra_gte_ev_desc *data,
-			     struct tegra_gte_ev_detail *hts)
+static int __tegra_gte_retrieve_event(const struct tegra_gte_ev_desc *data,
+				      struct tegra_gte_ev_detail *hts,
+				      bool read_hw)
 {
 	int ret, ev_id;
 	unsigned long flags;
@@ -598,7 +603,8 @@ int tegra_gte_retrieve_event(const struct tegra_gte_ev_desc *data,
 	gte_dev = ev->dev;
 
 	/* test - read from HW to make sure we are not missing anything */
-	tegra_gte_read_fifo(gte_dev);
+	if (read_hw)
+		tegra_gte_read_fifo(gte_dev);
 
 	spin_lock_irqsave(&ev->lock, flags);
 
@@ -633,6 +639,12 @@ unlock:
 	spin_unlock_irqrestore(&ev->lock, flags);
 	return ret;
 }
+
+int tegra_gte_retrieve_event(const struct tegra_gte_ev_desc *data,
+			     struct tegra_gte_ev_detail *hts)
+{
+	return __tegra_gte_retrieve_event(data, hts, true);
+}
 EXPORT_SYMBOL(tegra_gte_retrieve_event);
 
 /*
@@ -648,10 +660,39 @@ struct gte_uspace_event_state {
 	char *label;
 	wait_queue_head_t wait;
 	struct mutex read_lock;
-	DECLARE_KFIFO(events, struct tegra_gte_hts_event_data, GTE_EV_FIFO_EL);
+	DECLARE_KFIFO(events, struct tegra_gte_hts_event_data,
+		      GTE_USPACE_EV_FIFO_EL);
 	struct tegra_gte_ev_desc *gte_data;
+	/* optional mmap()ed ring, the producer index is kept private */
+	struct tegra_gte_hts_event_ring *ring;
+	size_t ring_size;
+	u32 ring_head;
+	u32 ring_mask;
+	u32 ring_watermark;
 };
 
+static u32 gte_event_ring_fill(struct gte_uspace_event_state *le)
+{
+	return le->ring_head - READ_ONCE(le->ring->tail);
+}
+
+static bool gte_event_ring_put(struct gte_uspace_event_state *le,
+			       struct tegra_gte_hts_event_ring *ring,
+			       const struct tegra_gte_hts_event_data *ge)
+{
+	/* tail is written by userspace, anything beyond a full ring is full */
+	if (le->ring_head - smp_load_acquire(&ring->tail) > le->ring_mask) {
+		WRITE_ONCE(ring->dropped, ring->dropped + 1);
+		return false;
+	}
+
+	ring->ev[le->ring_head & le->ring_mask] = *ge;
+	le->ring_head++;
+	smp_store_release(&ring->head, le->ring_head);
+
+	return true;
+}
+
 static unsigned int gte_event_poll(struct file *filep,
 				   struct poll_table_struct *wait)
 {
@@ -660,8 +701,12 @@ static unsigned int gte_event_poll(struct file *filep,
 
 	poll_wait(filep, &le->wait, wait);
 
-	if (!kfifo_is_empty(&le->events))
+	if (smp_load_acquire(&le->ring)) {
+		if (gte_event_ring_fill(le) >= le->ring_watermark)
+			events = POLLIN | POLLRDNORM;
+	} else if (!kfifo_is_empty(&le->events)) {
 		events = POLLIN | POLLRDNORM;
+	}
 
 	return events;
 }
@@ -675,7 +720,8 @@ static ssize_t gte_event_read(struct file *filep, char __user *buf,
 	unsigned int copied;
 	int ret;
 
-	if (count < sizeof(struct tegra_gte_hts_event_data))
+	if (count < sizeof(struct tegra_gte_hts_event_data) ||
+	    smp_load_acquire(&le->ring))
 		return -EINVAL;
 
 	do {
@@ -718,6 +764,7 @@ static int gte_event_release(struct inode *inode, struct file *filep)
 
 	tegra_gte_unregister_event(le->gte_data);
 	free_irq(le->irq, le);
+	vfree(le->ring);
 	gpio_free(le->gpio_in);
 	kfree(le->irqname);
 	kfree(le->label);
@@ -726,33 +773,128 @@ static int gte_event_release(struct inode *inode, struct file *filep)
 	return 0;
 }
 
+static int gte_event_setup_ring(struct gte_uspace_event_state *le,
+				void __user *ip)
+{
+	struct tegra_gte_hts_event_ring_req req;
+	struct tegra_gte_hts_event_ring *ring;
+	size_t size;
+	int ret = 0;
+
+	if (copy_from_user(&req, ip, sizeof(req)))
+		return -EFAULT;
+
+	if (!req.num_events || !is_power_of_2(req.num_events) ||
+	    req.num_events > TEGRA_GTE_HTS_EVENT_RING_MAX ||
+	    req.watermark > req.num_events)
+		return -EINVAL;
+
+	size = PAGE_ALIGN(sizeof(*ring) +
+			  req.num_events * sizeof(ring->ev[0]));
+
+	mutex_lock(&le->read_lock);
+	if (le->ring) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	ring = vmalloc_user(size);
+	if (!ring) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+	ring->num_events = req.num_events;
+	le->ring_size = size;
+	le->ring_mask = req.num_events - 1;
+	le->ring_watermark = max_t(u32, req.watermark, 1);
+	le->ring_head = 0;
+	/* from here on the irq thread only produces into the ring */
+	smp_store_release(&le->ring, ring);
+
+unlock:
+	mutex_unlock(&le->read_lock);
+	return ret;
+}
+
+static long gte_event_ioctl(struct file *filep, unsigned int cmd,
+			    unsigned long arg)
+{
+	struct gte_uspace_event_state *le = filep->private_data;
+
+	if (cmd == TEGRA_GTE_HTS_SETUP_EV_RING_IOCTL)
+		return gte_event_setup_ring(le, (void __user *)arg);
+
+	return -EINVAL;
+}
+
+#ifdef CONFIG_COMPAT
+static long gte_event_ioctl_compat(struct file *filep, unsigned int cmd,
+				   unsigned long arg)
+{
+	return gte_event_ioctl(filep, cmd, (unsigned long)compat_ptr(arg));
+}
+#endif
+
+static int gte_event_mmap(struct file *filep, struct vm_area_struct *vma)
+{
+	struct gte_uspace_event_state *le = filep->private_data;
+	struct tegra_gte_hts_event_ring *ring = smp_load_acquire(&le->ring);
+
+	if (!ring)
+		return -EINVAL;
+
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start > le->ring_size)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring, 0);
+}
+
 static const struct file_operations gte_event_fileops = {
 	.release = gte_event_release,
 	.read = gte_event_read,
 	.poll = gte_event_poll,
+	.mmap = gte_event_mmap,
+	.unlocked_ioctl = gte_event_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl = gte_event_ioctl_compat,
+#endif
 	.owner = THIS_MODULE,
 	.llseek = noop_llseek,
 };
 
 static irqreturn_t gte_event_irq_thread(int irq, void *p)
 {
-	int ret;
 	struct gte_uspace_event_state *le = p;
+	struct tegra_gte_hts_event_ring *ring = smp_load_acquire(&le->ring);
 	struct tegra_gte_hts_event_data ge;
 	struct tegra_gte_ev_detail hw;
+	bool read_hw = true;
+	int queued = 0;
 
 	memset(&ge, 0, sizeof(ge));
-	ret = tegra_gte_retrieve_event(le->gte_data, &hw);
-	if (ret == 0) {
+
+	/*
+	 * Drain every timestamp the GTE holds for this line, so a burst of
+	 * edges costs one thread wakeup and one reader wakeup.
+	 */
+	while (__tegra_gte_retrieve_event(le->gte_data, &hw, read_hw) == 0) {
+		read_hw = false;
 		ge.timestamp = hw.ts_ns;
 		ge.dir = hw.dir;
-	} else {
+
+		if (ring)
+			queued += gte_event_ring_put(le, ring, &ge);
+		else
+			queued += kfifo_put(&le->events, ge);
+	}
+
+	if (read_hw) {
 		dev_dbg(le->gdev->pdev, "failed to retrieve event\n");
 		return IRQ_HANDLED;
 	}
 
-	ret = kfifo_put(&le->events, ge);
-	if (ret != 0)
+	if (queued && (!ring || gte_event_ring_fill(le) >= le->ring_watermark))
 		wake_up_poll(&le->wait, POLLIN);
 
 	return IRQ_HANDLED;
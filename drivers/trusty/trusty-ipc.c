@@ -34,6 +34,8 @@
 #include <linux/virtio.h>
 #include <linux/virtio_ids.h>
 #include <linux/virtio_config.h>
+#include <linux/virtio_ring.h>
+#include <linux/workqueue.h>
 
 #include <linux/trusty/trusty.h>
 #include <linux/trusty/trusty_ipc.h>
@@ -126,11 +128,16 @@ struct tipc_virtio_dev {
 	struct virtio_device *vdev;
 	struct virtqueue *rxvq;
 	struct virtqueue *txvq;
-	uint msg_buf_cnt;
+	atomic_t msg_buf_cnt;
 	uint msg_buf_max_cnt;
 	size_t msg_buf_max_sz;
-	uint free_msg_buf_cnt;
-	struct list_head free_buf_list;
+	/* tx buffers, pushed lock-free, pops serialized by free_buf_lock */
+	struct llist_head free_buf_list;
+	spinlock_t free_buf_lock;
+	/* rx buffers recycled between channels and rx virtqueue */
+	struct llist_head rx_buf_pool;
+	spinlock_t rx_buf_lock;
+	atomic_t rx_buf_pool_cnt;
 	wait_queue_head_t sendq;
 	struct idr addr_idr;
 	enum tipc_device_state state;
@@ -167,6 +174,16 @@ struct virtio_device *default_vdev;
 static DEFINE_IDR(tipc_devices);
 static DEFINE_MUTEX(tipc_devices_lock);
 
+static bool loopback;
+module_param(loopback, bool, 0444);
+MODULE_PARM_DESC(loopback,
+		 "Add a device that echoes messages in place of the secure OS");
+
+static inline bool tipc_enabled(void)
+{
+	return loopback || is_trusty_dev_enabled();
+}
+
 static int _match_any(int id, void *p, void *data)
 {
 	return id;
@@ -228,6 +245,28 @@ static void _free_msg_buf_list(struct list_head *list)
 	}
 }
 
+static void _free_msg_buf_llist(struct llist_head *head)
+{
+	struct tipc_msg_buf *mb, *tmp;
+	struct llist_node *first = llist_del_all(head);
+
+	llist_for_each_entry_safe(mb, tmp, first, lnode)
+		_free_msg_buf(mb);
+}
+
+static struct tipc_msg_buf *_pop_msg_buf(struct llist_head *head,
+					 spinlock_t *lock)
+{
+	struct llist_node *node;
+
+	/* llist_del_first() requires consumers to be serialized */
+	spin_lock(lock);
+	node = llist_del_first(head);
+	spin_unlock(lock);
+
+	return node ? llist_entry(node, struct tipc_msg_buf, lnode) : NULL;
+}
+
 static inline void mb_reset(struct tipc_msg_buf *mb)
 {
 	mb->wpos = 0;
@@ -238,6 +277,10 @@ static void _free_vds(struct kref *kref)
 {
 	struct tipc_virtio_dev *vds =
 		container_of(kref, struct tipc_virtio_dev, refcount);
+
+	/* buffers returned after device removal */
+	_free_msg_buf_llist(&vds->free_buf_list);
+	_free_msg_buf_llist(&vds->rx_buf_pool);
 	kfree(vds);
 }
 
@@ -254,66 +297,67 @@ static void _free_chan(struct kref *kref)
 
 static struct tipc_msg_buf *vds_alloc_msg_buf(struct tipc_virtio_dev *vds)
 {
-	return _alloc_msg_buf(vds->msg_buf_max_sz);
+	struct tipc_msg_buf *mb;
+
+	mb = _pop_msg_buf(&vds->rx_buf_pool, &vds->rx_buf_lock);
+	if (!mb)
+		return _alloc_msg_buf(vds->msg_buf_max_sz);
+
+	atomic_dec(&vds->rx_buf_pool_cnt);
+	mb_reset(mb);
+
+	return mb;
 }
 
 static void vds_free_msg_buf(struct tipc_virtio_dev *vds,
 			     struct tipc_msg_buf *mb)
 {
+	/* keep up to one vring worth of buffers for reuse */
+	if (atomic_inc_return(&vds->rx_buf_pool_cnt) <= vds->msg_buf_max_cnt) {
+		llist_add(&mb->lnode, &vds->rx_buf_pool);
+		return;
+	}
+
+	atomic_dec(&vds->rx_buf_pool_cnt);
 	_free_msg_buf(mb);
 }
 
-static bool _put_txbuf_locked(struct tipc_virtio_dev *vds,
-			      struct tipc_msg_buf *mb)
+static void _put_txbuf(struct tipc_virtio_dev *vds, struct tipc_msg_buf *mb)
 {
-	list_add_tail(&mb->node, &vds->free_buf_list);
-	return vds->free_msg_buf_cnt++ == 0;
+	llist_add(&mb->lnode, &vds->free_buf_list);
 }
 
-static struct tipc_msg_buf *_get_txbuf_locked(struct tipc_virtio_dev *vds)
+static struct tipc_msg_buf *_get_txbuf(struct tipc_virtio_dev *vds)
 {
 	struct tipc_msg_buf *mb;
 
-	if (vds->state != VDS_ONLINE)
+	if (READ_ONCE(vds->state) != VDS_ONLINE)
 		return  ERR_PTR(-ENODEV);
 
-	if (vds->free_msg_buf_cnt) {
-		/* take it out of free list */
-		mb = list_first_entry(&vds->free_buf_list,
-				      struct tipc_msg_buf, node);
-		list_del(&mb->node);
-		vds->free_msg_buf_cnt--;
-	} else {
-		if (vds->msg_buf_cnt >= vds->msg_buf_max_cnt)
-			return ERR_PTR(-EAGAIN);
+	/* take it out of free list */
+	mb = _pop_msg_buf(&vds->free_buf_list, &vds->free_buf_lock);
+	if (mb)
+		return mb;
 
-		/* try to allocate it */
-		mb = _alloc_msg_buf(vds->msg_buf_max_sz);
-		if (!mb)
-			return ERR_PTR(-ENOMEM);
+	if (!atomic_add_unless(&vds->msg_buf_cnt, 1, vds->msg_buf_max_cnt))
+		return ERR_PTR(-EAGAIN);
 
-		vds->msg_buf_cnt++;
+	/* try to allocate it */
+	mb = _alloc_msg_buf(vds->msg_buf_max_sz);
+	if (!mb) {
+		atomic_dec(&vds->msg_buf_cnt);
+		return ERR_PTR(-ENOMEM);
 	}
-	return mb;
-}
-
-static struct tipc_msg_buf *_vds_get_txbuf(struct tipc_virtio_dev *vds)
-{
-	struct tipc_msg_buf *mb;
-
-	mutex_lock(&vds->lock);
-	mb = _get_txbuf_locked(vds);
-	mutex_unlock(&vds->lock);
 
 	return mb;
 }
 
 static void vds_put_txbuf(struct tipc_virtio_dev *vds, struct tipc_msg_buf *mb)
 {
-	mutex_lock(&vds->lock);
-	_put_txbuf_locked(vds, mb);
-	wake_up_interruptible(&vds->sendq);
-	mutex_unlock(&vds->lock);
+	_put_txbuf(vds, mb);
+	/* pairs with smp_mb() in vds_get_txbuf() */
+	if (wq_has_sleeper(&vds->sendq))
+		wake_up_interruptible(&vds->sendq);
 }
 
 static struct tipc_msg_buf *vds_get_txbuf(struct tipc_virtio_dev *vds,
@@ -321,16 +365,21 @@ static struct tipc_msg_buf *vds_get_txbuf(struct tipc_virtio_dev *vds,
 {
 	struct tipc_msg_buf *mb;
 
-	mb = _vds_get_txbuf(vds);
+	mb = _get_txbuf(vds);
 
 	if ((PTR_ERR(mb) == -EAGAIN) && timeout) {
 		DEFINE_WAIT_FUNC(wait, woken_wake_function);
 
 		timeout = msecs_to_jiffies(timeout);
 		add_wait_queue(&vds->sendq, &wait);
+		/* make waiter visible before checking free list again */
+		smp_mb();
 		for (;;) {
-			timeout = wait_woken(&wait, TASK_INTERRUPTIBLE,
-					     timeout);
+			/* a put may have raced with the previous attempt */
+			mb = _get_txbuf(vds);
+			if (PTR_ERR(mb) != -EAGAIN)
+				break;
+
 			if (!timeout) {
 				mb = ERR_PTR(-ETIMEDOUT);
 				break;
@@ -341,9 +390,8 @@ static struct tipc_msg_buf *vds_get_txbuf(struct tipc_virtio_dev *vds,
 				break;
 			}
 
-			mb = _vds_get_txbuf(vds);
-			if (PTR_ERR(mb) != -EAGAIN)
-				break;
+			timeout = wait_woken(&wait, TASK_INTERRUPTIBLE,
+					     timeout);
 		}
 		remove_wait_queue(&vds->sendq, &wait);
 	}
@@ -496,7 +544,7 @@ struct tipc_chan *tipc_create_channel(struct device *dev,
 	struct tipc_chan *chan;
 	struct tipc_virtio_dev *vds;
 
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return ERR_PTR(-ENODEV);
 
 	mutex_lock(&tipc_devices_lock);
@@ -521,7 +569,7 @@ EXPORT_SYMBOL(tipc_create_channel);
 
 struct tipc_msg_buf *tipc_chan_get_rxbuf(struct tipc_chan *chan)
 {
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return ERR_PTR(-ENODEV);
 
 	return vds_alloc_msg_buf(chan->vds);
@@ -530,7 +578,7 @@ EXPORT_SYMBOL(tipc_chan_get_rxbuf);
 
 void tipc_chan_put_rxbuf(struct tipc_chan *chan, struct tipc_msg_buf *mb)
 {
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return;
 
 	vds_free_msg_buf(chan->vds, mb);
@@ -540,7 +588,7 @@ EXPORT_SYMBOL(tipc_chan_put_rxbuf);
 struct tipc_msg_buf *tipc_chan_get_txbuf_timeout(struct tipc_chan *chan,
 						 long timeout)
 {
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return ERR_PTR(-ENODEV);
 
 	return vds_get_txbuf(chan->vds, timeout);
@@ -549,7 +597,7 @@ EXPORT_SYMBOL(tipc_chan_get_txbuf_timeout);
 
 void tipc_chan_put_txbuf(struct tipc_chan *chan, struct tipc_msg_buf *mb)
 {
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return;
 
 	vds_put_txbuf(chan->vds, mb);
@@ -560,7 +608,7 @@ int tipc_chan_queue_msg(struct tipc_chan *chan, struct tipc_msg_buf *mb)
 {
 	int err;
 
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return -ENODEV;
 
 	mutex_lock(&chan->lock);
@@ -599,7 +647,7 @@ int tipc_chan_connect(struct tipc_chan *chan, const char *name)
 	struct tipc_conn_req_body *body;
 	struct tipc_msg_buf *txbuf;
 
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return -ENODEV;
 
 	txbuf = vds_get_txbuf(chan->vds, TXBUF_TIMEOUT);
@@ -671,7 +719,7 @@ int tipc_chan_shutdown(struct tipc_chan *chan)
 	struct tipc_disc_req_body *body;
 	struct tipc_msg_buf *txbuf = NULL;
 
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return -ENODEV;
 
 	/* get tx buffer */
@@ -713,7 +761,7 @@ EXPORT_SYMBOL(tipc_chan_shutdown);
 
 void tipc_chan_destroy(struct tipc_chan *chan)
 {
-	if (!is_trusty_dev_enabled())
+	if (!tipc_enabled())
 		return;
 
 	vds_del_channel(chan->vds, chan);
@@ -1527,11 +1575,13 @@ static void _txvq_cb(struct virtqueue *txvq)
 
 	/* detach all buffers */
 	mutex_lock(&vds->lock);
-	while ((mb = virtqueue_get_buf(txvq, &len)) != NULL)
-		need_wakeup |= _put_txbuf_locked(vds, mb);
+	while ((mb = virtqueue_get_buf(txvq, &len)) != NULL) {
+		_put_txbuf(vds, mb);
+		need_wakeup = true;
+	}
 	mutex_unlock(&vds->lock);
 
-	if (need_wakeup) {
+	if (need_wakeup && wq_has_sleeper(&vds->sendq)) {
 		/* wake up potential senders waiting for a tx buffer */
 		wake_up_interruptible_all(&vds->sendq);
 	}
@@ -1560,7 +1610,10 @@ static int tipc_virtio_probe(struct virtio_device *vdev)
 	mutex_init(&vds->lock);
 	kref_init(&vds->refcount);
 	init_waitqueue_head(&vds->sendq);
-	INIT_LIST_HEAD(&vds->free_buf_list);
+	init_llist_head(&vds->free_buf_list);
+	spin_lock_init(&vds->free_buf_lock);
+	init_llist_head(&vds->rx_buf_pool);
+	spin_lock_init(&vds->rx_buf_lock);
 	idr_init(&vds->addr_idr);
 
 	/* set default max message size and alignment */
@@ -1637,7 +1690,7 @@ static void tipc_virtio_remove(struct virtio_device *vdev)
 
 	_cleanup_vq(vds->rxvq);
 	_cleanup_vq(vds->txvq);
-	_free_msg_buf_list(&vds->free_buf_list);
+	_free_msg_buf_llist(&vds->free_buf_list);
 
 	vdev->config->del_vqs(vds->vdev);
 
@@ -1648,6 +1701,448 @@ static void tipc_virtio_remove(struct virtio_device *vdev)
 	kref_put(&vds->refcount, _free_vds);
 }
 
+/*
+ * Loopback stand-in for the secure side, used when loaded with loopback=1
+ * so the message path can be exercised and timed without a TEE. It plays
+ * the device side of both vrings: it accepts connections to TIPC_LB_PORT
+ * and echoes every message sent on them back to the sender.
+ */
+#define TIPC_LB_PORT			"com.nvidia.tipc.loopback"
+#define TIPC_LB_DEV_NAME		"lb0"
+#define TIPC_LB_VRING_NUM		32
+#define TIPC_LB_MAX_CHANS		64
+#define TIPC_LB_FIRST_REMOTE		128
+
+struct tipc_lb_vring {
+	void *vaddr;
+	size_t size;
+	struct vring vr;
+	u16 last_avail;
+	struct virtqueue *vq;
+};
+
+struct tipc_lb_dev {
+	struct virtio_device vdev;
+	struct tipc_dev_config config;
+	/* rx and tx, in the order tipc_virtio_probe() asks for them */
+	struct tipc_lb_vring vrings[2];
+	u8 status;
+	bool online;
+	struct work_struct work;
+	DECLARE_BITMAP(chans, TIPC_LB_MAX_CHANS);
+};
+
+#define vdev_to_lb(vd)  container_of((vd), struct tipc_lb_dev, vdev)
+
+static struct tipc_lb_dev *tipc_lb;
+
+/* Next buffer made available by the driver, NULL if there is none */
+static void *_lb_vring_peek(struct tipc_lb_dev *lb, struct tipc_lb_vring *tvr,
+			    u16 *head, u32 *len)
+{
+	struct virtio_device *vdev = &lb->vdev;
+	struct vring *vr = &tvr->vr;
+	struct vring_desc *desc;
+
+	if (tvr->last_avail == virtio16_to_cpu(vdev, READ_ONCE(vr->avail->idx)))
+		return NULL;
+
+	/* read the ring entry only after its index */
+	smp_rmb();
+	*head = virtio16_to_cpu(vdev,
+				vr->avail->ring[tvr->last_avail % vr->num]);
+	desc = &vr->desc[*head];
+	*len = virtio32_to_cpu(vdev, desc->len);
+
+	/* no features negotiated, so buffer addresses are physical */
+	return phys_to_virt(virtio64_to_cpu(vdev, desc->addr));
+}
+
+/* Return the buffer at head to the driver with len bytes written */
+static void _lb_vring_push(struct tipc_lb_dev *lb, struct tipc_lb_vring *tvr,
+			   u16 head, u32 len)
+{
+	struct virtio_device *vdev = &lb->vdev;
+	struct vring *vr = &tvr->vr;
+	u16 idx = virtio16_to_cpu(vdev, vr->used->idx);
+
+	vr->used->ring[idx % vr->num].id = cpu_to_virtio32(vdev, head);
+	vr->used->ring[idx % vr->num].len = cpu_to_virtio32(vdev, len);
+	tvr->last_avail++;
+
+	/* publish the entry before its index */
+	smp_wmb();
+	WRITE_ONCE(vr->used->idx, cpu_to_virtio16(vdev, idx + 1));
+}
+
+/* Deliver a message to the driver, -EAGAIN if it has no rx buffer queued */
+static int _lb_send(struct tipc_lb_dev *lb, u32 src, u32 dst,
+		    const void *data, u16 len)
+{
+	struct tipc_lb_vring *rx = &lb->vrings[0];
+	struct tipc_msg_hdr *hdr;
+	u32 buf_len;
+	u16 head;
+
+	hdr = _lb_vring_peek(lb, rx, &head, &buf_len);
+	if (!hdr)
+		return -EAGAIN;
+
+	if (sizeof(*hdr) + len > buf_len) {
+		dev_warn(&lb->vdev.dev, "%s: %u byte msg dropped\n",
+			 __func__, len);
+		return 0;
+	}
+
+	hdr->src = src;
+	hdr->dst = dst;
+	hdr->reserved = 0;
+	hdr->len = len;
+	hdr->flags = 0;
+	memcpy(hdr->data, data, len);
+
+	_lb_vring_push(lb, rx, head, sizeof(*hdr) + len);
+	return 0;
+}
+
+static int _lb_send_ctrl(struct tipc_lb_dev *lb, u32 type,
+			 const void *body, u32 body_len)
+{
+	u8 buf[sizeof(struct tipc_ctrl_msg) +
+	       sizeof(struct tipc_conn_rsp_body)];
+	struct tipc_ctrl_msg *msg = (struct tipc_ctrl_msg *)buf;
+
+	if (WARN_ON(body_len > sizeof(buf) - sizeof(*msg)))
+		return 0;
+
+	msg->type = type;
+	msg->body_len = body_len;
+	memcpy(msg->body, body, body_len);
+
+	return _lb_send(lb, TIPC_CTRL_ADDR, TIPC_CTRL_ADDR, buf,
+			sizeof(*msg) + body_len);
+}
+
+static int _lb_handle_conn_req(struct tipc_lb_dev *lb, u32 src,
+			       struct tipc_conn_req_body *req)
+{
+	struct tipc_conn_rsp_body rsp;
+	unsigned int chan;
+	int ret;
+
+	memset(&rsp, 0, sizeof(rsp));
+	rsp.target = src;
+
+	chan = find_first_zero_bit(lb->chans, TIPC_LB_MAX_CHANS);
+	if (strncmp(req->name, TIPC_LB_PORT, sizeof(req->name))) {
+		rsp.status = ERR_NOT_FOUND;
+	} else if (chan >= TIPC_LB_MAX_CHANS) {
+		rsp.status = ERR_GENERIC;
+	} else {
+		rsp.status = NO_ERROR;
+		rsp.remote = TIPC_LB_FIRST_REMOTE + chan;
+		rsp.max_msg_size = lb->config.msg_buf_max_size -
+					sizeof(struct tipc_msg_hdr);
+		rsp.max_msg_cnt = TIPC_LB_VRING_NUM;
+	}
+
+	ret = _lb_send_ctrl(lb, TIPC_CTRL_MSGTYPE_CONN_RSP, &rsp, sizeof(rsp));
+	if (!ret && rsp.status == NO_ERROR)
+		set_bit(chan, lb->chans);
+
+	return ret;
+}
+
+static bool _lb_chan_valid(struct tipc_lb_dev *lb, u32 remote)
+{
+	return remote >= TIPC_LB_FIRST_REMOTE &&
+	       remote < TIPC_LB_FIRST_REMOTE + TIPC_LB_MAX_CHANS &&
+	       test_bit(remote - TIPC_LB_FIRST_REMOTE, lb->chans);
+}
+
+static int _lb_handle_ctrl(struct tipc_lb_dev *lb, struct tipc_msg_hdr *hdr)
+{
+	struct tipc_ctrl_msg *msg = (struct tipc_ctrl_msg *)hdr->data;
+	struct tipc_disc_req_body *disc;
+
+	if ((hdr->len < sizeof(*msg)) ||
+	    (sizeof(*msg) + msg->body_len != hdr->len))
+		return 0;
+
+	switch (msg->type) {
+	case TIPC_CTRL_MSGTYPE_CONN_REQ:
+		if (msg->body_len != sizeof(struct tipc_conn_req_body))
+			return 0;
+		return _lb_handle_conn_req(lb, hdr->src,
+				(struct tipc_conn_req_body *)msg->body);
+
+	case TIPC_CTRL_MSGTYPE_DISC_REQ:
+		if (msg->body_len != sizeof(*disc))
+			return 0;
+		disc = (struct tipc_disc_req_body *)msg->body;
+		if (_lb_chan_valid(lb, disc->target))
+			clear_bit(disc->target - TIPC_LB_FIRST_REMOTE,
+				  lb->chans);
+		return 0;
+
+	default:
+		dev_warn(&lb->vdev.dev, "%s: unexpected ctrl msg type %d\n",
+			 __func__, msg->type);
+		return 0;
+	}
+}
+
+/* Handle one message from the driver, -EAGAIN to retry it later */
+static int _lb_handle_txbuf(struct tipc_lb_dev *lb, struct tipc_msg_hdr *hdr,
+			    u32 len)
+{
+	if ((len < sizeof(*hdr)) || (sizeof(*hdr) + hdr->len > len))
+		return 0;
+
+	if (hdr->dst == TIPC_CTRL_ADDR)
+		return _lb_handle_ctrl(lb, hdr);
+
+	/* channel was shut down meanwhile */
+	if (!_lb_chan_valid(lb, hdr->dst))
+		return 0;
+
+	return _lb_send(lb, hdr->dst, hdr->src, hdr->data, hdr->len);
+}
+
+static void _lb_work(struct work_struct *work)
+{
+	struct tipc_lb_dev *lb = container_of(work, struct tipc_lb_dev, work);
+	struct tipc_lb_vring *rx = &lb->vrings[0];
+	struct tipc_lb_vring *tx = &lb->vrings[1];
+	struct tipc_msg_hdr *hdr;
+	bool tx_done = false;
+	u16 rx_start, head;
+	u32 len;
+
+	if (!(lb->status & VIRTIO_CONFIG_S_DRIVER_OK) || !rx->vq || !tx->vq)
+		return;
+
+	rx_start = rx->last_avail;
+
+	if (!lb->online) {
+		if (_lb_send_ctrl(lb, TIPC_CTRL_MSGTYPE_GO_ONLINE, NULL, 0))
+			return;
+		lb->online = true;
+	}
+
+	/* a reply that finds no rx buffer waits for the driver's rx kick */
+	while ((hdr = _lb_vring_peek(lb, tx, &head, &len))) {
+		if (_lb_handle_txbuf(lb, hdr, len) == -EAGAIN)
+			break;
+		_lb_vring_push(lb, tx, head, 0);
+		tx_done = true;
+		cond_resched();
+	}
+
+	if (rx->last_avail != rx_start)
+		vring_interrupt(0, rx->vq);
+	if (tx_done)
+		vring_interrupt(0, tx->vq);
+}
+
+static bool _lb_notify(struct virtqueue *vq)
+{
+	struct tipc_lb_dev *lb = vdev_to_lb(vq->vdev);
+
+	schedule_work(&lb->work);
+	return true;
+}
+
+static u64 _lb_get_features(struct virtio_device *vdev)
+{
+	return 0;
+}
+
+static int _lb_finalize_features(struct virtio_device *vdev)
+{
+	return 0;
+}
+
+static void _lb_get_config(struct virtio_device *vdev, unsigned offset,
+			   void *buf, unsigned len)
+{
+	struct tipc_lb_dev *lb = vdev_to_lb(vdev);
+
+	if (offset + len <= sizeof(lb->config))
+		memcpy(buf, (u8 *)&lb->config + offset, len);
+}
+
+static void _lb_set_config(struct virtio_device *vdev, unsigned offset,
+			   const void *buf, unsigned len)
+{
+}
+
+static u8 _lb_get_status(struct virtio_device *vdev)
+{
+	return vdev_to_lb(vdev)->status;
+}
+
+static void _lb_set_status(struct virtio_device *vdev, u8 status)
+{
+	struct tipc_lb_dev *lb = vdev_to_lb(vdev);
+
+	lb->status = status;
+	/* go online once the driver has queued its rx buffers */
+	if (status & VIRTIO_CONFIG_S_DRIVER_OK)
+		schedule_work(&lb->work);
+}
+
+static void _lb_reset(struct virtio_device *vdev)
+{
+	struct tipc_lb_dev *lb = vdev_to_lb(vdev);
+
+	lb->status = 0;
+	cancel_work_sync(&lb->work);
+	lb->online = false;
+	bitmap_zero(lb->chans, TIPC_LB_MAX_CHANS);
+}
+
+static void _lb_del_vqs(struct virtio_device *vdev)
+{
+	struct tipc_lb_dev *lb = vdev_to_lb(vdev);
+	struct tipc_lb_vring *tvr;
+	uint i;
+
+	cancel_work_sync(&lb->work);
+
+	for (i = 0; i < ARRAY_SIZE(lb->vrings); i++) {
+		tvr = &lb->vrings[i];
+		if (tvr->vq) {
+			vring_del_virtqueue(tvr->vq);
+			tvr->vq = NULL;
+		}
+		if (tvr->vaddr) {
+			free_pages_exact(tvr->vaddr, tvr->size);
+			tvr->vaddr = NULL;
+		}
+	}
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
+static int _lb_find_vqs(struct virtio_device *vdev, unsigned nvqs,
+			struct virtqueue *vqs[], vq_callback_t *callbacks[],
+			const char * const names[], const bool *ctx,
+			struct irq_affinity *desc)
+#else
+static int _lb_find_vqs(struct virtio_device *vdev, unsigned nvqs,
+			struct virtqueue *vqs[], vq_callback_t *callbacks[],
+			const char * const names[])
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0) */
+{
+	struct tipc_lb_dev *lb = vdev_to_lb(vdev);
+	struct tipc_lb_vring *tvr;
+	uint i;
+
+	if (nvqs > ARRAY_SIZE(lb->vrings))
+		return -EINVAL;
+
+	for (i = 0; i < nvqs; i++) {
+		tvr = &lb->vrings[i];
+		tvr->size = PAGE_ALIGN(vring_size(TIPC_LB_VRING_NUM,
+						  PAGE_SIZE));
+		tvr->vaddr = alloc_pages_exact(tvr->size,
+					       GFP_KERNEL | __GFP_ZERO);
+		if (!tvr->vaddr)
+			goto err;
+
+		/* device side view of the same ring */
+		vring_init(&tvr->vr, TIPC_LB_VRING_NUM, tvr->vaddr, PAGE_SIZE);
+		tvr->last_avail = 0;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
+		tvr->vq = vring_new_virtqueue(i, TIPC_LB_VRING_NUM, PAGE_SIZE,
+					      vdev, true, ctx ? ctx[i] : false,
+					      tvr->vaddr, _lb_notify,
+					      callbacks[i], names[i]);
+#else
+		tvr->vq = vring_new_virtqueue(i, TIPC_LB_VRING_NUM, PAGE_SIZE,
+					      vdev, true, tvr->vaddr,
+					      _lb_notify, callbacks[i],
+					      names[i]);
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0) */
+		if (!tvr->vq)
+			goto err;
+
+		vqs[i] = tvr->vq;
+	}
+
+	return 0;
+
+err:
+	_lb_del_vqs(vdev);
+	return -ENOMEM;
+}
+
+static const char *_lb_bus_name(struct virtio_device *vdev)
+{
+	return "tipc-loopback";
+}
+
+static const struct virtio_config_ops tipc_lb_config_ops = {
+	.get_features = _lb_get_features,
+	.finalize_features = _lb_finalize_features,
+	.get = _lb_get_config,
+	.set = _lb_set_config,
+	.get_status = _lb_get_status,
+	.set_status = _lb_set_status,
+	.reset    = _lb_reset,
+	.find_vqs = _lb_find_vqs,
+	.del_vqs  = _lb_del_vqs,
+	.bus_name = _lb_bus_name,
+};
+
+static void _lb_release_dev(struct device *dev)
+{
+	kfree(vdev_to_lb(dev_to_virtio(dev)));
+}
+
+static int tipc_lb_add(void)
+{
+	struct tipc_lb_dev *lb;
+	int ret;
+
+	lb = kzalloc(sizeof(*lb), GFP_KERNEL);
+	if (!lb)
+		return -ENOMEM;
+
+	INIT_WORK(&lb->work, _lb_work);
+	lb->config.msg_buf_max_size = DEFAULT_MSG_BUF_SIZE;
+	lb->config.msg_buf_alignment = DEFAULT_MSG_BUF_ALIGN;
+	strlcpy(lb->config.dev_name, TIPC_LB_DEV_NAME,
+		sizeof(lb->config.dev_name));
+
+	lb->vdev.dev.release = _lb_release_dev;
+	lb->vdev.id.device = VIRTIO_ID_TRUSTY_IPC;
+	lb->vdev.config = &tipc_lb_config_ops;
+
+	ret = register_virtio_device(&lb->vdev);
+	if (ret) {
+		pr_err("%s: failed to register loopback device: %d\n",
+		       __func__, ret);
+		put_device(&lb->vdev.dev);
+		return ret;
+	}
+
+	tipc_lb = lb;
+	pr_info("%s: loopback on port %s of /dev/trusty-ipc-%s\n", __func__,
+		TIPC_LB_PORT, TIPC_LB_DEV_NAME);
+	return 0;
+}
+
+static void tipc_lb_remove(void)
+{
+	if (!tipc_lb)
+		return;
+
+	unregister_virtio_device(&tipc_lb->vdev);
+	tipc_lb = NULL;
+}
+
 static struct virtio_device_id tipc_virtio_id_table[] = {
 	{ VIRTIO_ID_TRUSTY_IPC, VIRTIO_DEV_ANY_ID },
 	{ 0 },
@@ -1692,8 +2187,16 @@ static int __init tipc_init(void)
 		goto err_register_virtio_drv;
 	}
 
+	if (loopback) {
+		ret = tipc_lb_add();
+		if (ret)
+			goto err_lb_add;
+	}
+
 	return 0;
 
+err_lb_add:
+	unregister_virtio_driver(&virtio_tipc_driver);
 err_register_virtio_drv:
 	class_destroy(tipc_class);
 
@@ -1704,6 +2207,7 @@ err_class_create:
 
 static void __exit tipc_exit(void)
 {
+	tipc_lb_remove();
 	unregister_virtio_driver(&virtio_tipc_driver);
 	class_destroy(tipc_class);
 	unregister_chrdev_region(MKDEV(tipc_major, 0), MAX_DEVICES);
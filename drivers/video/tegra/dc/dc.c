@@ -3168,6 +3168,10 @@ static void tegra_dc_create_debugfs(struct tegra_dc *dc)
 			retval = tegra_nvdisp_create_imp_lock_debugfs(dc);
 			if (!retval)
 				goto remove_out;
+
+			retval = tegra_nvdisp_create_bw_debugfs(dc);
+			if (!retval)
+				goto remove_out;
 		}
 	}
 
@@ -293,6 +293,7 @@ int tegra_dc_queue_imp_propose(struct tegra_dc *dc,
 			struct tegra_dc_ext_flip_user_data *flip_user_data);
 void tegra_dc_reset_imp_state(void);
 struct dentry *tegra_nvdisp_create_imp_lock_debugfs(struct tegra_dc *dc);
+struct dentry *tegra_nvdisp_create_bw_debugfs(struct tegra_dc *dc);
 
 /** Frame-Flip Lock API
  * Defined in dc.c. Used in dc_common.c
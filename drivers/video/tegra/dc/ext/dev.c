@@ -1277,6 +1277,9 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 
 	tegra_dc_scrncapt_disp_pause_unlock(dc);
 
+	/* signal captures of the previous front buffers, never blocks */
+	tegra_dc_scrncapt_retire(dc, unpin_handles, nr_unpin);
+
 	if (!skip_flip) {
 		for (i = 0; i < win_num; i++) {
 			struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
@@ -1286,6 +1289,11 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 				!test_bit(index, &dc->valid_windows))
 				continue;
 
+			/* a capture may briefly hold back the release */
+			if (tegra_dc_scrncapt_hold_syncpt(dc, index,
+					flip_win->syncpt_max))
+				continue;
+
 			tegra_dc_incr_syncpt_min(dc, index,
 					flip_win->syncpt_max);
 		}
@@ -1567,6 +1575,7 @@ static void tegra_dc_ext_unpin_window(struct tegra_dc_ext_win *win)
 	}
 	mutex_unlock(&win->lock);
 
+	tegra_dc_scrncapt_retire(win->ext->dc, unpin_handles, nr_unpin);
 	tegra_dc_ext_unpin_handles(unpin_handles, nr_unpin);
 }
 
@@ -3518,6 +3527,39 @@ free_and_ret:
 #endif
 	}
 
+	case TEGRA_DC_EXT_SCRNCAPT_EXPORT_FBUF:
+	{
+#ifdef CONFIG_TEGRA_DC_SCREEN_CAPTURE
+		struct tegra_dc_ext_scrncapt_export_fbuf  args;
+		int  ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+		ret = tegra_dc_scrncapt_export_fbuf(user, &args);
+		if (ret)
+			return ret;
+		/* fds are already installed, so the caller must see them */
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+		return 0;
+#else
+		return -EINVAL;
+#endif
+	}
+
+	case TEGRA_DC_EXT_SCRNCAPT_RELEASE_FBUF:
+	{
+#ifdef CONFIG_TEGRA_DC_SCREEN_CAPTURE
+		struct tegra_dc_ext_scrncapt_release_fbuf  args;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+		return tegra_dc_scrncapt_release_fbuf(user, &args);
+#else
+		return -EINVAL;
+#endif
+	}
+
 	case TEGRA_DC_EXT_GET_SCANLINE:
 	{
 		u32 scanln;
@@ -3691,6 +3733,8 @@ static int tegra_dc_release(struct inode *inode, struct file *filp)
 	if (ext->cursor.user == user)
 		tegra_dc_ext_put_cursor(user);
 
+	tegra_dc_scrncapt_release_user(user);
+
 	kfree(user);
 
 	open_count = atomic_dec_return(&dc_open_count);
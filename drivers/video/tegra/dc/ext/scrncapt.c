@@ -16,8 +16,11 @@
  * more details.
  */
 
+#include <linux/dma-buf.h>
+#include <linux/dma-fence.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/sync_file.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 #include <linux/workqueue.h>
@@ -35,6 +38,37 @@
 #include "tegra_dc_ext_priv.h"
 
 
+/*
+ * zero-copy capture of one window's scanned-out buffer
+ */
+struct tegra_dc_scrncapt_export {
+	struct list_head          node;
+	struct tegra_dc_ext_user  *owner;
+	u32                       id;
+	struct dma_buf            *bufs[TEGRA_DC_NUM_PLANES];
+};
+
+/*
+ * per-window zero-copy capture state
+ *  - captures: outstanding exports of the window
+ *  - fence: signalled when the window flips away from any of 'fence_bufs'
+ *  - hold_*: release of 'hold_bufs' to their producer held back until
+ *    'hold_until', see tegra_dc_scrncapt_hold_syncpt()
+ */
+struct tegra_dc_scrncapt_win {
+	struct list_head     captures;
+	unsigned int         num_captures;
+	struct dma_fence     *fence;
+	struct dma_buf       *fence_bufs[TEGRA_DC_NUM_PLANES];
+
+	bool                 holding;
+	bool                 hold_incr;
+	struct tegra_dc      *hold_dc;
+	u32                  hold_syncpt;
+	unsigned long        hold_until;
+	struct dma_buf       *hold_bufs[TEGRA_DC_NUM_PLANES];
+};
+
 /*
  * private info for
  * Tegra DC screen Capture
@@ -47,6 +81,15 @@ static struct tegra_dc_scrncapt_private  {
 	struct rw_semaphore  *rwsema_head;
 	struct timer_list    tmr_resume;
 	unsigned long        tm_resume;
+
+	/* zero-copy capture */
+	struct mutex         export_lock;
+	struct tegra_dc_scrncapt_win  *wins;
+	spinlock_t           fence_lock;
+	u64                  fence_context;
+	u64                  fence_seqno;
+	u32                  next_id;
+	struct delayed_work  hold_work;
 }  scrncapt;
 
 /*
@@ -577,6 +620,489 @@ int tegra_dc_scrncapt_dup_fbuf(struct tegra_dc_ext_user *user,
 }
 
 
+/*
+ * Zero-copy capture
+ *
+ * Exported buffers are handed to user space as dma-buf fds. The flip worker
+ * calls tegra_dc_scrncapt_retire() for the buffers it flipped away from,
+ * which signals the fences of captures of them. While such a capture is
+ * outstanding, the window's syncpoint increments that release the buffers
+ * to their producer are held back, for at most
+ * TEGRA_DC_EXT_SCRNCAPT_EXPORT_HOLD_MS. Nothing here blocks, so the display
+ * keeps flipping; only the recycling of the captured buffer is delayed.
+ */
+
+static const char *scrncapt_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "tegradc";
+}
+
+static const char *scrncapt_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "scrncapt";
+}
+
+static bool scrncapt_fence_enable_signaling(struct dma_fence *fence)
+{
+	return true;
+}
+
+static const struct dma_fence_ops scrncapt_fence_ops = {
+	.get_driver_name = scrncapt_fence_get_driver_name,
+	.get_timeline_name = scrncapt_fence_get_timeline_name,
+	.enable_signaling = scrncapt_fence_enable_signaling,
+	.wait = dma_fence_default_wait,
+};
+
+/* must be called with export_lock held */
+static void scrncapt_win_signal(struct tegra_dc_scrncapt_win *swin)
+{
+	if (!swin->fence)
+		return;
+
+	dma_fence_signal(swin->fence);
+	dma_fence_put(swin->fence);
+	swin->fence = NULL;
+	memset(swin->fence_bufs, 0, sizeof(swin->fence_bufs));
+}
+
+/* must be called with export_lock held */
+static struct dma_fence *scrncapt_win_get_fence(
+		struct tegra_dc_scrncapt_win *swin, struct dma_buf *bufs[])
+{
+	struct dma_fence *fence;
+
+	if (swin->fence && !memcmp(swin->fence_bufs, bufs,
+				sizeof(swin->fence_bufs)))
+		return dma_fence_get(swin->fence);
+
+	/* the previous buffer has left scan-out without a retire */
+	scrncapt_win_signal(swin);
+
+	fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+	if (!fence)
+		return NULL;
+
+	dma_fence_init(fence, &scrncapt_fence_ops, &scrncapt.fence_lock,
+			scrncapt.fence_context, ++scrncapt.fence_seqno);
+
+	swin->fence = fence;
+	memcpy(swin->fence_bufs, bufs, sizeof(swin->fence_bufs));
+
+	return dma_fence_get(fence);
+}
+
+/* must be called with export_lock held */
+static void scrncapt_export_free(struct tegra_dc_scrncapt_win *swin,
+		struct tegra_dc_scrncapt_export *exp)
+{
+	int p;
+
+	list_del(&exp->node);
+	swin->num_captures--;
+
+	for (p = 0; p < TEGRA_DC_NUM_PLANES; p++)
+		if (exp->bufs[p])
+			dma_buf_put(exp->bufs[p]);
+
+	kfree(exp);
+}
+
+/* true if any plane of 'bufs' is one of the released handles */
+static bool scrncapt_bufs_released(struct dma_buf *bufs[],
+		struct tegra_dc_dmabuf *handles[], int nr_handles)
+{
+	int i, p;
+
+	for (i = 0; i < nr_handles; i++) {
+		if (!handles[i])
+			continue;
+
+		for (p = 0; p < TEGRA_DC_NUM_PLANES; p++)
+			if (bufs[p] && handles[i]->buf == bufs[p])
+				return true;
+	}
+
+	return false;
+}
+
+/* true if 'exp' captured any of 'bufs' */
+static bool scrncapt_export_uses(struct tegra_dc_scrncapt_export *exp,
+		struct dma_buf *bufs[])
+{
+	int p;
+
+	for (p = 0; p < TEGRA_DC_NUM_PLANES; p++)
+		if (bufs[p] && exp->bufs[p] == bufs[p])
+			return true;
+
+	return false;
+}
+
+/*
+ * must be called with export_lock held
+ * Ends the hold of window 'i' and lets the held syncpoint increments through.
+ * Takes dc->lock, which is never held when export_lock is taken.
+ */
+static void scrncapt_win_unhold(struct tegra_dc_scrncapt_win *swin, int i)
+{
+	if (!swin->holding)
+		return;
+
+	swin->holding = false;
+	memset(swin->hold_bufs, 0, sizeof(swin->hold_bufs));
+	if (swin->hold_incr) {
+		swin->hold_incr = false;
+		if (test_bit(i, &swin->hold_dc->valid_windows))
+			tegra_dc_incr_syncpt_min(swin->hold_dc, i,
+					swin->hold_syncpt);
+	}
+}
+
+/* must be called with export_lock held */
+static void scrncapt_win_check_hold(struct tegra_dc_scrncapt_win *swin, int i)
+{
+	struct tegra_dc_scrncapt_export *exp;
+
+	if (!swin->holding)
+		return;
+
+	list_for_each_entry(exp, &swin->captures, node)
+		if (scrncapt_export_uses(exp, swin->hold_bufs))
+			return;
+
+	scrncapt_win_unhold(swin, i);
+}
+
+/* ends holds whose captures didn't finish within EXPORT_HOLD_MS */
+static void scrncapt_hold_worker(struct work_struct *work)
+{
+	struct tegra_dc_scrncapt_export *exp, *tmp;
+	unsigned long next = 0;
+	bool pending = false;
+	int i;
+
+	mutex_lock(&scrncapt.export_lock);
+	for (i = 0; i < tegra_dc_get_numof_dispwindows(); i++) {
+		struct tegra_dc_scrncapt_win *swin = &scrncapt.wins[i];
+
+		if (!swin->holding)
+			continue;
+
+		if (time_before(jiffies, swin->hold_until)) {
+			if (!pending || time_before(swin->hold_until, next))
+				next = swin->hold_until;
+			pending = true;
+			continue;
+		}
+
+		list_for_each_entry_safe(exp, tmp, &swin->captures, node) {
+			if (!scrncapt_export_uses(exp, swin->hold_bufs))
+				continue;
+
+			/* capture didn't finish in time, stop holding it */
+			pr_debug("scrncapt: capture %u on win %d timed out\n",
+				exp->id, i);
+			scrncapt_export_free(swin, exp);
+		}
+		scrncapt_win_unhold(swin, i);
+	}
+	if (pending)
+		schedule_delayed_work(&scrncapt.hold_work,
+				max_t(long, next - jiffies, 1));
+	mutex_unlock(&scrncapt.export_lock);
+}
+
+/*
+ * tegra_dc_scrncapt_retire - called for buffers that are no longer scanned
+ * out, before their release to the producer. Signals the flip-away fences of
+ * their captures and, while such a capture is outstanding, starts holding
+ * back the window's release. Never blocks.
+ */
+void tegra_dc_scrncapt_retire(struct tegra_dc *dc,
+		struct tegra_dc_dmabuf *handles[], int nr_handles)
+{
+	struct tegra_dc_scrncapt_export *exp;
+	int i;
+
+	if (!scrncapt.wins || !nr_handles)
+		return;
+
+	mutex_lock(&scrncapt.export_lock);
+	for_each_set_bit(i, &dc->valid_windows,
+			tegra_dc_get_numof_dispwindows()) {
+		struct tegra_dc_scrncapt_win *swin = &scrncapt.wins[i];
+
+		if (!swin->fence || !scrncapt_bufs_released(swin->fence_bufs,
+						handles, nr_handles))
+			continue;
+
+		/* an ongoing hold keeps its deadline */
+		if (!swin->holding) {
+			list_for_each_entry(exp, &swin->captures, node) {
+				if (!scrncapt_export_uses(exp,
+							swin->fence_bufs))
+					continue;
+
+				swin->holding = true;
+				swin->hold_dc = dc;
+				swin->hold_until = jiffies + msecs_to_jiffies(
+					TEGRA_DC_EXT_SCRNCAPT_EXPORT_HOLD_MS);
+				memcpy(swin->hold_bufs, swin->fence_bufs,
+					sizeof(swin->hold_bufs));
+				schedule_delayed_work(&scrncapt.hold_work,
+					msecs_to_jiffies(
+					TEGRA_DC_EXT_SCRNCAPT_EXPORT_HOLD_MS));
+				break;
+			}
+		}
+
+		scrncapt_win_signal(swin);
+	}
+	mutex_unlock(&scrncapt.export_lock);
+}
+
+/*
+ * tegra_dc_scrncapt_hold_syncpt - called by the flip worker instead of
+ * incrementing window 'win' to 'val'. Returns true if the window is holding
+ * and the increment was deferred to the end of the hold. Syncpoint values
+ * are monotonic, so later flips of a holding window are deferred as well,
+ * up to the same deadline.
+ */
+bool tegra_dc_scrncapt_hold_syncpt(struct tegra_dc *dc, int win, u32 val)
+{
+	struct tegra_dc_scrncapt_win *swin;
+	bool held = false;
+
+	if (!scrncapt.wins)
+		return false;
+
+	swin = &scrncapt.wins[win];
+
+	mutex_lock(&scrncapt.export_lock);
+	if (swin->holding && swin->hold_dc == dc) {
+		swin->hold_incr = true;
+		swin->hold_syncpt = val;
+		held = true;
+	}
+	mutex_unlock(&scrncapt.export_lock);
+
+	return held;
+}
+
+/* release all captures held by a dc ext user, e.g. when its fd is closed */
+void tegra_dc_scrncapt_release_user(struct tegra_dc_ext_user *user)
+{
+	struct tegra_dc_scrncapt_export *exp, *tmp;
+	int i;
+
+	if (!scrncapt.wins)
+		return;
+
+	mutex_lock(&scrncapt.export_lock);
+	for (i = 0; i < tegra_dc_get_numof_dispwindows(); i++) {
+		struct tegra_dc_scrncapt_win *swin = &scrncapt.wins[i];
+
+		list_for_each_entry_safe(exp, tmp, &swin->captures, node)
+			if (exp->owner == user)
+				scrncapt_export_free(swin, exp);
+		scrncapt_win_check_hold(swin, i);
+	}
+	mutex_unlock(&scrncapt.export_lock);
+}
+
+int tegra_dc_scrncapt_export_fbuf(struct tegra_dc_ext_user *user,
+		struct tegra_dc_ext_scrncapt_export_fbuf *args)
+{
+	struct tegra_dc_ext *ext;
+	struct tegra_dc *dc;
+	struct tegra_dc_ext_win *extwin;
+	struct tegra_dc_scrncapt_win *swin;
+	struct tegra_dc_scrncapt_export *exp;
+	struct dma_fence *fence = NULL;
+	struct sync_file *sync_file = NULL;
+	int fds[TEGRA_DC_NUM_PLANES];
+	int fence_fd = -1;
+	bool paused;
+	int err = 0;
+	int p;
+
+	if (!scrncapt.wins)
+		return -ENODEV;
+
+	/* no support of 1st implementation */
+	if (TEGRA_DC_EXT_SCRNCAPT_VER_V(args->ver) != 2)
+		return -EFAULT;
+
+	if ((args->ver ^ scrncapt.magic) & ~0xff)
+		return -EFAULT;
+	if (args->flags)
+		return -EINVAL;
+	if ((tegra_dc_get_numof_dispheads() <= (unsigned)args->head) ||
+		(tegra_dc_get_numof_dispwindows() <= (unsigned)args->win))
+		return -EINVAL;
+
+	dc = tegra_dc_get_dc(args->head);
+	if (!dc || !dc->ext)
+		return -ENODEV;
+	ext = dc->ext;
+
+	/* check valid window */
+	if (!(dc->valid_windows & (1 << args->win)))
+		return -EBUSY;
+
+	for (p = 0; p < TEGRA_DC_NUM_PLANES; p++)
+		fds[p] = -1;
+
+	exp = kzalloc(sizeof(*exp), GFP_KERNEL);
+	if (!exp)
+		return -ENOMEM;
+
+	swin = &scrncapt.wins[args->win];
+	extwin = &ext->win[args->win];
+
+	/*
+	 * Keep the head from flipping while its current buffers are latched.
+	 * A paused head can't flip, and its lock is already held by the pauser.
+	 */
+	mutex_lock(&scrncapt.lock);
+	paused = scrncapt.pause_heads & (1 << args->head);
+	if (!paused)
+		down_write(&scrncapt.rwsema_head[args->head]);
+	mutex_unlock(&scrncapt.lock);
+
+	mutex_lock(&scrncapt.export_lock);
+
+	if (swin->num_captures >= TEGRA_DC_EXT_SCRNCAPT_EXPORT_MAX) {
+		err = -EBUSY;
+		goto unlock;
+	}
+
+	for (p = 0; p < TEGRA_DC_NUM_PLANES; p++) {
+		struct tegra_dc_dmabuf *dcbuf = extwin->cur_handle[p];
+
+		if (dcbuf && dcbuf->buf) {
+			get_dma_buf(dcbuf->buf);
+			exp->bufs[p] = dcbuf->buf;
+		}
+	}
+
+	if (!exp->bufs[TEGRA_DC_Y]) {
+		err = -ENODATA;
+		goto unlock;
+	}
+
+	fence = scrncapt_win_get_fence(swin, exp->bufs);
+	if (!fence) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	sync_file = sync_file_create(fence);
+	if (!sync_file) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	fence_fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fence_fd < 0) {
+		err = fence_fd;
+		goto unlock;
+	}
+
+	for (p = 0; p < TEGRA_DC_NUM_PLANES; p++) {
+		if (!exp->bufs[p])
+			continue;
+
+		fds[p] = get_unused_fd_flags(O_CLOEXEC);
+		if (fds[p] < 0) {
+			err = fds[p];
+			goto unlock;
+		}
+	}
+
+	/* nothing can fail past this point */
+	for (p = 0; p < TEGRA_DC_NUM_PLANES; p++) {
+		args->plane_fds[p] = fds[p];
+		args->plane_sizes[p] = exp->bufs[p] ? exp->bufs[p]->size : 0;
+
+		if (!exp->bufs[p])
+			continue;
+
+		get_dma_buf(exp->bufs[p]);
+		fd_install(fds[p], exp->bufs[p]->file);
+	}
+
+	fd_install(fence_fd, sync_file->file);
+	args->release_fence_fd = fence_fd;
+
+	exp->owner = user;
+	exp->id = ++scrncapt.next_id;
+	args->capture_id = exp->id;
+
+	list_add_tail(&exp->node, &swin->captures);
+	swin->num_captures++;
+
+	mutex_unlock(&scrncapt.export_lock);
+	if (!paused)
+		up_write(&scrncapt.rwsema_head[args->head]);
+
+	dma_fence_put(fence);
+	args->ver = TEGRA_DC_EXT_SCRNCAPT_VER_2(args->ver);
+
+	return 0;
+
+unlock:
+	mutex_unlock(&scrncapt.export_lock);
+	if (!paused)
+		up_write(&scrncapt.rwsema_head[args->head]);
+
+	for (p = 0; p < TEGRA_DC_NUM_PLANES; p++) {
+		if (fds[p] >= 0)
+			put_unused_fd(fds[p]);
+		if (exp->bufs[p])
+			dma_buf_put(exp->bufs[p]);
+	}
+	if (fence_fd >= 0)
+		put_unused_fd(fence_fd);
+	if (sync_file)
+		fput(sync_file->file);
+	if (fence)
+		dma_fence_put(fence);
+	kfree(exp);
+
+	return err;
+}
+
+int tegra_dc_scrncapt_release_fbuf(struct tegra_dc_ext_user *user,
+		struct tegra_dc_ext_scrncapt_release_fbuf *args)
+{
+	struct tegra_dc_scrncapt_export *exp, *tmp;
+	struct tegra_dc_scrncapt_win *swin;
+	int err = -ENOENT;
+
+	if (!scrncapt.wins)
+		return -ENODEV;
+	if (tegra_dc_get_numof_dispwindows() <= (unsigned)args->win)
+		return -EINVAL;
+
+	swin = &scrncapt.wins[args->win];
+
+	mutex_lock(&scrncapt.export_lock);
+	list_for_each_entry_safe(exp, tmp, &swin->captures, node) {
+		if (exp->owner == user && exp->id == args->capture_id) {
+			scrncapt_export_free(swin, exp);
+			scrncapt_win_check_hold(swin, args->win);
+			err = 0;
+			break;
+		}
+	}
+	mutex_unlock(&scrncapt.export_lock);
+
+	return err;
+}
+
+
 int  tegra_dc_scrncapt_pause(struct tegra_dc_ext_control_user *ctlusr,
 		struct tegra_dc_ext_control_scrncapt_pause *args)
 {
@@ -716,6 +1242,22 @@ int  tegra_dc_scrncapt_init(void)
 
 	for (i = 0; i < nheads; i++)
 		init_rwsem(&scrncapt.rwsema_head[i]);
+
+	scrncapt.wins = kcalloc(nwins, sizeof(*scrncapt.wins), GFP_KERNEL);
+	if (!scrncapt.wins) {
+		pr_err("%s: Insufficient memory\n", __func__);
+		kfree(scrncapt.rwsema_head);
+		scrncapt.rwsema_head = NULL;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nwins; i++)
+		INIT_LIST_HEAD(&scrncapt.wins[i].captures);
+
+	mutex_init(&scrncapt.export_lock);
+	INIT_DELAYED_WORK(&scrncapt.hold_work, scrncapt_hold_worker);
+	spin_lock_init(&scrncapt.fence_lock);
+	scrncapt.fence_context = dma_fence_context_alloc(1);
 #if LINUX_VERSION_CODE > KERNEL_VERSION(4,15,0)
 	timer_setup(&scrncapt.tmr_resume, tegra_dc_scrncapt_timer_cb, 0);
 #else
@@ -731,7 +1273,28 @@ int  tegra_dc_scrncapt_init(void)
 
 int  tegra_dc_scrncapt_exit(void)
 {
+	int  i;
+
 	pr_info("scrncapt: exit\n");
+
+	if (scrncapt.wins) {
+		mutex_lock(&scrncapt.export_lock);
+		for (i = 0; i < tegra_dc_get_numof_dispwindows(); i++) {
+			struct tegra_dc_scrncapt_win *swin = &scrncapt.wins[i];
+			struct tegra_dc_scrncapt_export *exp, *tmp;
+
+			list_for_each_entry_safe(exp, tmp, &swin->captures,
+						node)
+				scrncapt_export_free(swin, exp);
+			scrncapt_win_unhold(swin, i);
+			scrncapt_win_signal(swin);
+		}
+		mutex_unlock(&scrncapt.export_lock);
+		cancel_delayed_work_sync(&scrncapt.hold_work);
+		kfree(scrncapt.wins);
+		scrncapt.wins = NULL;
+	}
+
 	kfree(scrncapt.rwsema_head);
 	return 0;
 }
@@ -196,6 +196,17 @@ extern int  tegra_dc_scrncapt_get_info(
 extern int  tegra_dc_scrncapt_dup_fbuf(
 		struct tegra_dc_ext_user *user,
 		struct tegra_dc_ext_scrncapt_dup_fbuf *args);
+extern int  tegra_dc_scrncapt_export_fbuf(
+		struct tegra_dc_ext_user *user,
+		struct tegra_dc_ext_scrncapt_export_fbuf *args);
+extern int  tegra_dc_scrncapt_release_fbuf(
+		struct tegra_dc_ext_user *user,
+		struct tegra_dc_ext_scrncapt_release_fbuf *args);
+extern void  tegra_dc_scrncapt_retire(struct tegra_dc *dc,
+		struct tegra_dc_dmabuf *handles[], int nr_handles);
+extern bool  tegra_dc_scrncapt_hold_syncpt(struct tegra_dc *dc, int win,
+		u32 val);
+extern void  tegra_dc_scrncapt_release_user(struct tegra_dc_ext_user *user);
 #else /* !CONFIG_TEGRA_DC_SCREEN_CAPTURE */
 static inline int  tegra_dc_scrncapt_init(void)
 {
@@ -209,6 +220,15 @@ static inline int  tegra_dc_scrncapt_exit(void)
 
 static inline void  tegra_dc_scrncapt_disp_pause_lock(struct tegra_dc *dc) {}
 static inline void  tegra_dc_scrncapt_disp_pause_unlock(struct tegra_dc *dc) {}
+static inline void  tegra_dc_scrncapt_retire(struct tegra_dc *dc,
+		struct tegra_dc_dmabuf *handles[], int nr_handles) {}
+static inline bool  tegra_dc_scrncapt_hold_syncpt(struct tegra_dc *dc,
+		int win, u32 val)
+{
+	return false;
+}
+static inline void  tegra_dc_scrncapt_release_user(
+		struct tegra_dc_ext_user *user) {}
 #endif
 
 extern int tegra_dc_ext_vpulse3(struct tegra_dc_ext *dc,
@@ -14,7 +14,12 @@
  *
  */
 
+#include <linux/debugfs.h>
+#include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 #include <linux/platform/tegra/bwmgr_mc.h>
 #include <linux/platform/tegra/emc_bwmgr.h>
 #include <linux/platform/tegra/isomgr.h>
@@ -33,6 +38,214 @@
 /* Global bw info shared across all heads */
 static struct nvdisp_isoclient_bw_info ihub_bw_info;
 
+/*
+ * Number of recently used bw configurations that are remembered. Workloads
+ * that toggle overlays bounce between a handful of configurations, so a
+ * small table is enough to predict that a higher configuration will be
+ * requested again shortly.
+ */
+#define NVDISP_BW_CFG_CACHE_SIZE	8
+
+/* Default time a lower configuration must be stable before bw is dropped */
+#define NVDISP_BW_LOWER_HOLD_MS		250
+
+struct nvdisp_bw_cfg_cache_entry {
+	struct nvdisp_bandwidth_config cfg;
+	unsigned long last_used;	/* jiffies, last negotiated */
+	unsigned long applied_at;	/* jiffies, valid while active */
+	unsigned long replaced_at;	/* jiffies, end of last use */
+	unsigned long in_use;		/* jiffies in use, halved per use */
+	u32 hits;
+	bool valid;
+};
+
+struct nvdisp_bw_stats {
+	u64 negotiations;
+	u64 reservations;
+	u64 negotiate_fast_path;
+	u64 program_fast_path;
+	u64 realizations;
+	u64 emc_updates;
+	u64 deferred_lowerings;
+	u64 applied_lowerings;
+	u64 cache_hits;
+	u64 cache_misses;
+	u64 reserve_ns_total;
+	u64 reserve_ns_max;
+	u64 realize_ns_total;
+	u64 realize_ns_max;
+};
+
+/* All of the below are protected by tegra_nvdisp_lock */
+static struct nvdisp_bw_cfg_cache_entry
+		nvdisp_bw_cfg_cache[NVDISP_BW_CFG_CACHE_SIZE];
+static struct nvdisp_bw_stats nvdisp_bw_stats;
+/* Entry of the configuration currently on screen, or NULL */
+static struct nvdisp_bw_cfg_cache_entry *nvdisp_bw_cfg_active;
+static u32 nvdisp_bw_lower_hold_ms = NVDISP_BW_LOWER_HOLD_MS;
+
+/* Lower configuration waiting for the hold time to expire */
+static struct nvdisp_bandwidth_config nvdisp_bw_pending_lower;
+static struct tegra_dc *nvdisp_bw_pending_dc;
+static void tegra_nvdisp_bw_lower_worker(struct work_struct *work);
+static DECLARE_DELAYED_WORK(nvdisp_bw_lower_work,
+			    tegra_nvdisp_bw_lower_worker);
+
+static bool nvdisp_bw_cfg_equal(const struct nvdisp_bandwidth_config *a,
+				const struct nvdisp_bandwidth_config *b)
+{
+	return a->iso_bw == b->iso_bw && a->total_bw == b->total_bw &&
+		a->emc_la_floor == b->emc_la_floor && a->hubclk == b->hubclk;
+}
+
+/*
+ * Record that a configuration has been requested. The least recently used
+ * entry is replaced on a miss.
+ */
+static void nvdisp_bw_cfg_cache_touch(const struct nvdisp_bandwidth_config *cfg)
+{
+	struct nvdisp_bw_cfg_cache_entry *victim = &nvdisp_bw_cfg_cache[0];
+	int i;
+
+	for (i = 0; i < NVDISP_BW_CFG_CACHE_SIZE; i++) {
+		struct nvdisp_bw_cfg_cache_entry *entry = &nvdisp_bw_cfg_cache[i];
+
+		if (entry->valid && nvdisp_bw_cfg_equal(&entry->cfg, cfg)) {
+			entry->last_used = jiffies;
+			entry->hits++;
+			nvdisp_bw_stats.cache_hits++;
+			return;
+		}
+
+		if (!entry->valid)
+			victim = entry;
+		else if (victim->valid &&
+			 time_before(entry->last_used, victim->last_used))
+			victim = entry;
+	}
+
+	nvdisp_bw_stats.cache_misses++;
+
+	if (victim == nvdisp_bw_cfg_active)
+		nvdisp_bw_cfg_active = NULL;
+
+	memset(victim, 0, sizeof(*victim));
+	victim->cfg = *cfg;
+	victim->last_used = jiffies;
+	victim->hits = 1;
+	victim->valid = true;
+}
+
+static struct nvdisp_bw_cfg_cache_entry *
+nvdisp_bw_cfg_cache_find(const struct nvdisp_bandwidth_config *cfg)
+{
+	int i;
+
+	for (i = 0; i < NVDISP_BW_CFG_CACHE_SIZE; i++) {
+		struct nvdisp_bw_cfg_cache_entry *entry = &nvdisp_bw_cfg_cache[i];
+
+		if (entry->valid && nvdisp_bw_cfg_equal(&entry->cfg, cfg))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * Record that @cfg is now on screen. The configuration it replaces gets the
+ * time it was in use added to its history; older history is halved each
+ * time so that recent use dominates.
+ */
+static void nvdisp_bw_cfg_applied(const struct nvdisp_bandwidth_config *cfg)
+{
+	struct nvdisp_bw_cfg_cache_entry *entry = nvdisp_bw_cfg_cache_find(cfg);
+	struct nvdisp_bw_cfg_cache_entry *prev = nvdisp_bw_cfg_active;
+	unsigned long now = jiffies;
+
+	if (entry && entry == prev)
+		return;
+
+	if (prev) {
+		prev->in_use = prev->in_use / 2 + (now - prev->applied_at);
+		prev->replaced_at = now;
+	}
+
+	nvdisp_bw_cfg_active = entry;
+	if (entry)
+		entry->applied_at = now;
+}
+
+/*
+ * Predict whether a configuration needing more ISO bw than @iso_bw will be
+ * put back on screen soon. Higher configurations that were replaced within
+ * the hold time are weighted by how long they were actually in use, and
+ * lowering is deferred when they have recently been on screen for longer
+ * than the lower configuration itself.
+ */
+static bool nvdisp_bw_expect_higher(const struct nvdisp_bandwidth_config *cfg)
+{
+	unsigned long hold = msecs_to_jiffies(nvdisp_bw_lower_hold_ms);
+	struct nvdisp_bw_cfg_cache_entry *lower = nvdisp_bw_cfg_cache_find(cfg);
+	unsigned long higher_use = 0;
+	int i;
+
+	for (i = 0; i < NVDISP_BW_CFG_CACHE_SIZE; i++) {
+		struct nvdisp_bw_cfg_cache_entry *entry = &nvdisp_bw_cfg_cache[i];
+
+		if (entry->valid && entry->cfg.iso_bw > cfg->iso_bw &&
+		    entry != nvdisp_bw_cfg_active &&
+		    time_before(jiffies, entry->replaced_at + hold))
+			higher_use += entry->in_use;
+	}
+
+	return higher_use > (lower ? lower->in_use : 0);
+}
+
+static void nvdisp_bw_cfg_cache_reset(void)
+{
+	memset(nvdisp_bw_cfg_cache, 0, sizeof(nvdisp_bw_cfg_cache));
+	nvdisp_bw_cfg_active = NULL;
+	nvdisp_bw_pending_dc = NULL;
+}
+
+static u32 tegra_nvdisp_isomgr_reserve(u32 iso_bw)
+{
+	u64 start = ktime_get_ns();
+	u64 delta;
+	u32 ret;
+
+	/*
+	 * Client's latency tolerance is ignored by isomgr. Pass in a dummy
+	 * value of 1000 usec.
+	 */
+	ret = tegra_isomgr_reserve(ihub_bw_info.isomgr_handle, iso_bw, 1000);
+
+	delta = ktime_get_ns() - start;
+	nvdisp_bw_stats.reservations++;
+	nvdisp_bw_stats.reserve_ns_total += delta;
+	nvdisp_bw_stats.reserve_ns_max = max(nvdisp_bw_stats.reserve_ns_max,
+					     delta);
+
+	return ret;
+}
+
+static u32 tegra_nvdisp_isomgr_realize(void)
+{
+	u64 start = ktime_get_ns();
+	u64 delta;
+	u32 ret;
+
+	ret = tegra_isomgr_realize(ihub_bw_info.isomgr_handle);
+
+	delta = ktime_get_ns() - start;
+	nvdisp_bw_stats.realizations++;
+	nvdisp_bw_stats.realize_ns_total += delta;
+	nvdisp_bw_stats.realize_ns_max = max(nvdisp_bw_stats.realize_ns_max,
+					     delta);
+
+	return ret;
+}
+
 static int tegra_nvdisp_set_latency_allowance(u32 bw, u32 emc_freq)
 {
 	struct dc_to_la_params disp_params;
@@ -77,7 +290,7 @@ static int tegra_nvdisp_program_final_bw_settings(
 	}
 
 	if (final_iso_bw != cur_config->iso_bw) {
-		if (!tegra_isomgr_realize(ihub_bw_info.isomgr_handle)) {
+		if (!tegra_nvdisp_isomgr_realize()) {
 			pr_err("%s: failed to realize %u KB/s\n", __func__,
 				final_iso_bw);
 			return -EINVAL;
@@ -105,6 +318,7 @@ static int tegra_nvdisp_program_final_bw_settings(
 		}
 
 		cur_config->emc_la_floor = final_emc;
+		nvdisp_bw_stats.emc_updates++;
 		update_la_ptsa = true;
 	}
 
@@ -137,12 +351,13 @@ static int tegra_nvdisp_program_final_bw_settings(
 	return ret;
 }
 
-int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
+static int __tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
 				u32 new_iso_bw,
 				u32 new_total_bw,
 				u32 new_emc,
 				u32 new_hubclk,
-				bool before_win_update)
+				bool before_win_update,
+				bool allow_defer)
 {
 	/*
 	 * This function is responsible for updating the ISO bw, EMC floor,
@@ -159,7 +374,9 @@ int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
 	 * B) After the window update occurs and the new state has promoted,
 	 *    display can program all the new values associated with X' as long
 	 *    as they don't violate the ISO bw requirements that are currently
-	 *    in place.
+	 *    in place. Lowering is deferred while a configuration needing more
+	 *    bw was in use within the last nvdisp_bw_lower_hold_ms, so that
+	 *    toggling overlays doesn't bounce the reservation and EMC floor.
 	 */
 
 	struct nvdisp_bandwidth_config *cur_config = &ihub_bw_info.cur_config;
@@ -181,6 +398,20 @@ int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
 	if (before_win_update) { /* Case A */
 		bool update_bw = false;
 
+		/* A new flip supersedes any lowering still on hold. */
+		nvdisp_bw_pending_dc = NULL;
+
+		/*
+		 * Fast path: the current settings already cover X', so there
+		 * is nothing to raise before the update.
+		 */
+		if (new_iso_bw <= cur_config->iso_bw &&
+		    new_emc <= cur_config->emc_la_floor &&
+		    new_hubclk <= cur_config->hubclk) {
+			nvdisp_bw_stats.program_fast_path++;
+			return 0;
+		}
+
 		/*
 		 * ISO clients can only realize exactly what they have already
 		 * reserved. The ISO bw that display has currently reserved is
@@ -202,16 +433,36 @@ int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
 			final_hubclk =
 			max(final_hubclk, ihub_bw_info.hubclk_at_res_bw);
 	} else { /* Case B */
+		struct nvdisp_bandwidth_config new_cfg = {
+			.iso_bw = new_iso_bw,
+			.total_bw = new_total_bw,
+			.emc_la_floor = new_emc,
+			.hubclk = new_hubclk,
+		};
 		u32 max_bw = tegra_nvdisp_get_max_pending_bw(dc);
+
+		/* X' has promoted, even if its bw is lowered later */
+		nvdisp_bw_cfg_applied(&new_cfg);
+
 		if (new_iso_bw >= max_bw &&
 					new_iso_bw < cur_config->iso_bw) {
-			/*
-			 * Client's latency tolerance is ignored by isomgr. Pass
-			 * in a dummy value of 1000 usec.
-			 */
-			if (!tegra_isomgr_reserve(ihub_bw_info.isomgr_handle,
-						new_iso_bw,
-						1000)) {
+			if (allow_defer && nvdisp_bw_expect_higher(&new_cfg)) {
+				nvdisp_bw_pending_lower.iso_bw = new_iso_bw;
+				nvdisp_bw_pending_lower.total_bw = new_total_bw;
+				nvdisp_bw_pending_lower.emc_la_floor = new_emc;
+				nvdisp_bw_pending_lower.hubclk = new_hubclk;
+				nvdisp_bw_pending_dc = dc;
+				nvdisp_bw_stats.deferred_lowerings++;
+
+				mod_delayed_work(system_wq, &nvdisp_bw_lower_work,
+					msecs_to_jiffies(nvdisp_bw_lower_hold_ms));
+
+				return 0;
+			}
+
+			nvdisp_bw_pending_dc = NULL;
+
+			if (!tegra_nvdisp_isomgr_reserve(new_iso_bw)) {
 				pr_err("%s: failed to reserve %u KB/s\n",
 					__func__, new_iso_bw);
 				return -EINVAL;
@@ -226,6 +477,7 @@ int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
 			final_total_bw = new_total_bw;
 			final_emc = new_emc;
 			final_hubclk = new_hubclk;
+			nvdisp_bw_stats.applied_lowerings++;
 		}
 	}
 
@@ -243,6 +495,38 @@ int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
 	return ret;
 }
 
+int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc,
+				u32 new_iso_bw,
+				u32 new_total_bw,
+				u32 new_emc,
+				u32 new_hubclk,
+				bool before_win_update)
+{
+	return __tegra_nvdisp_program_bandwidth(dc, new_iso_bw, new_total_bw,
+						new_emc, new_hubclk,
+						before_win_update, true);
+}
+
+static void tegra_nvdisp_bw_lower_worker(struct work_struct *work)
+{
+	struct nvdisp_bandwidth_config cfg;
+	struct tegra_dc *dc;
+
+	mutex_lock(&tegra_nvdisp_lock);
+
+	dc = nvdisp_bw_pending_dc;
+	nvdisp_bw_pending_dc = NULL;
+
+	if (dc && dc->enabled) {
+		cfg = nvdisp_bw_pending_lower;
+		__tegra_nvdisp_program_bandwidth(dc, cfg.iso_bw, cfg.total_bw,
+						 cfg.emc_la_floor, cfg.hubclk,
+						 false, false);
+	}
+
+	mutex_unlock(&tegra_nvdisp_lock);
+}
+
 void tegra_nvdisp_init_bandwidth(struct tegra_dc *dc)
 {
 	/*
@@ -271,6 +555,7 @@ void tegra_nvdisp_init_bandwidth(struct tegra_dc *dc)
 
 	memset(&ihub_bw_info.cur_config, 0, sizeof(ihub_bw_info.cur_config));
 	ihub_bw_info.reserved_bw = 0;
+	nvdisp_bw_cfg_cache_reset();
 
 	tegra_nvdisp_negotiate_reserved_bw(dc,
 				new_iso_bw,
@@ -296,12 +581,15 @@ void tegra_nvdisp_clear_bandwidth(struct tegra_dc *dc)
 	if (!tegra_platform_is_silicon())
 		return;
 
-	tegra_nvdisp_program_bandwidth(dc,
+	nvdisp_bw_pending_dc = NULL;
+
+	__tegra_nvdisp_program_bandwidth(dc,
 				new_iso_bw,
 				new_total_bw,
 				new_emc,
 				new_hubclk,
-				before_win_update);
+				before_win_update,
+				false);
 }
 
 /*
@@ -333,6 +621,12 @@ int tegra_nvdisp_negotiate_reserved_bw(struct tegra_dc *dc,
 	 * This function is only responsible for reserving bw, NOT realizing it.
 	 */
 
+	struct nvdisp_bandwidth_config cfg = {
+		.iso_bw = new_iso_bw,
+		.total_bw = new_total_bw,
+		.emc_la_floor = new_emc,
+		.hubclk = new_hubclk,
+	};
 	int ret = 0;
 
 	if (IS_ERR_OR_NULL(ihub_bw_info.isomgr_handle) ||
@@ -341,6 +635,9 @@ int tegra_nvdisp_negotiate_reserved_bw(struct tegra_dc *dc,
 		goto exit;
 	}
 
+	nvdisp_bw_stats.negotiations++;
+	nvdisp_bw_cfg_cache_touch(&cfg);
+
 	if (new_iso_bw > ihub_bw_info.available_bw) { /* Case A */
 		pr_err("%s: requested %u KB/s > available %u KB/s",
 			__func__, new_iso_bw, ihub_bw_info.available_bw);
@@ -349,13 +646,7 @@ int tegra_nvdisp_negotiate_reserved_bw(struct tegra_dc *dc,
 	}
 
 	if (new_iso_bw > ihub_bw_info.reserved_bw) { /* Case B */
-		/*
-		 * Client's latency tolerance is ignored by isomgr. Pass in a
-		 * dummy value of 1000 usec.
-		 */
-		if (!tegra_isomgr_reserve(ihub_bw_info.isomgr_handle,
-						new_iso_bw,
-						1000)) {
+		if (!tegra_nvdisp_isomgr_reserve(new_iso_bw)) {
 			pr_err("%s: failed to reserve %u KB/s\n", __func__,
 				new_iso_bw);
 			ret = -EINVAL;
@@ -370,6 +661,9 @@ int tegra_nvdisp_negotiate_reserved_bw(struct tegra_dc *dc,
 		trace_display_imp_bw_reserved(dc->ctrl_num, new_iso_bw,
 						new_total_bw, new_emc,
 						new_hubclk);
+	} else {
+		/* The current reservation already fits this configuration. */
+		nvdisp_bw_stats.negotiate_fast_path++;
 	}
 
 exit:
@@ -601,6 +895,8 @@ int tegra_nvdisp_bandwidth_register(enum tegra_iso_client iso_client,
 		return ret;
 
 	memset(&ihub_bw_info, 0, sizeof(ihub_bw_info));
+	memset(&nvdisp_bw_stats, 0, sizeof(nvdisp_bw_stats));
+	nvdisp_bw_cfg_cache_reset();
 
 	ihub_bw_info.bwmgr_handle = tegra_bwmgr_register(bwmgr_client);
 	if (IS_ERR_OR_NULL(ihub_bw_info.bwmgr_handle)) {
@@ -629,10 +925,17 @@ void _tegra_nvdisp_bandwidth_unregister(void)
 	if (!tegra_platform_is_silicon())
 		return;
 
+	/* The worker bails out once it sees that there is no pending dc. */
+	nvdisp_bw_pending_dc = NULL;
+	cancel_delayed_work(&nvdisp_bw_lower_work);
+
 	if (!IS_ERR_OR_NULL(ihub_bw_info.isomgr_handle))
 		tegra_isomgr_unregister(ihub_bw_info.isomgr_handle);
 	if (!IS_ERR_OR_NULL(ihub_bw_info.bwmgr_handle))
 		tegra_bwmgr_unregister(ihub_bw_info.bwmgr_handle);
+
+	ihub_bw_info.isomgr_handle = NULL;
+	ihub_bw_info.bwmgr_handle = NULL;
 }
 
 void tegra_nvdisp_bandwidth_unregister(void)
@@ -644,6 +947,81 @@ void tegra_nvdisp_bandwidth_unregister(void)
 	_tegra_nvdisp_bandwidth_unregister();
 	mutex_unlock(&tegra_nvdisp_lock);
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int dbg_nvdisp_bw_stats_show(struct seq_file *s, void *unused)
+{
+	struct nvdisp_bw_stats stats;
+	int i;
+
+	mutex_lock(&tegra_nvdisp_lock);
+
+	stats = nvdisp_bw_stats;
+
+	seq_printf(s, "negotiations: %llu\n", stats.negotiations);
+	seq_printf(s, "negotiate_fast_path: %llu\n", stats.negotiate_fast_path);
+	seq_printf(s, "program_fast_path: %llu\n", stats.program_fast_path);
+	seq_printf(s, "reservations: %llu\n", stats.reservations);
+	seq_printf(s, "realizations: %llu\n", stats.realizations);
+	seq_printf(s, "emc_updates: %llu\n", stats.emc_updates);
+	seq_printf(s, "deferred_lowerings: %llu\n", stats.deferred_lowerings);
+	seq_printf(s, "applied_lowerings: %llu\n", stats.applied_lowerings);
+	seq_printf(s, "cfg_cache_hits: %llu\n", stats.cache_hits);
+	seq_printf(s, "cfg_cache_misses: %llu\n", stats.cache_misses);
+	seq_printf(s, "reserve_ns_avg: %llu\n", stats.reservations ?
+		   div64_u64(stats.reserve_ns_total, stats.reservations) : 0);
+	seq_printf(s, "reserve_ns_max: %llu\n", stats.reserve_ns_max);
+	seq_printf(s, "realize_ns_avg: %llu\n", stats.realizations ?
+		   div64_u64(stats.realize_ns_total, stats.realizations) : 0);
+	seq_printf(s, "realize_ns_max: %llu\n", stats.realize_ns_max);
+
+	seq_puts(s,
+		 "cached configs (iso_bw total_bw emc hubclk hits in_use_ms):\n");
+	for (i = 0; i < NVDISP_BW_CFG_CACHE_SIZE; i++) {
+		struct nvdisp_bw_cfg_cache_entry *entry = &nvdisp_bw_cfg_cache[i];
+
+		if (!entry->valid)
+			continue;
+
+		seq_printf(s, "  %u %u %u %u %u %u%s\n", entry->cfg.iso_bw,
+			   entry->cfg.total_bw, entry->cfg.emc_la_floor,
+			   entry->cfg.hubclk, entry->hits,
+			   jiffies_to_msecs(entry->in_use),
+			   entry == nvdisp_bw_cfg_active ? " (active)" : "");
+	}
+
+	mutex_unlock(&tegra_nvdisp_lock);
+
+	return 0;
+}
+
+static int dbg_nvdisp_bw_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_nvdisp_bw_stats_show, inode->i_private);
+}
+
+static const struct file_operations dbg_nvdisp_bw_stats_fops = {
+	.open = dbg_nvdisp_bw_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+struct dentry *tegra_nvdisp_create_bw_debugfs(struct tegra_dc *dc)
+{
+	struct dentry *retval;
+
+	retval = debugfs_create_file("bw_stats", 0444, dc->debug_common_dir,
+				     NULL, &dbg_nvdisp_bw_stats_fops);
+	if (!retval)
+		return NULL;
+
+	debugfs_create_u32("bw_lower_hold_ms", 0644, dc->debug_common_dir,
+			   &nvdisp_bw_lower_hold_ms);
+
+	return retval;
+}
+#endif
 #else
 int tegra_nvdisp_program_bandwidth(struct tegra_dc *dc, u32 new_iso_bw,
 	u32 new_total_bw, u32 new_emc, u32 new_hubclk,
@@ -662,5 +1040,12 @@ long tegra_nvdisp_calc_min_bandwidth(struct tegra_dc *dc)
 {
 	return -ENOSYS;
 }
+#ifdef CONFIG_DEBUG_FS
+struct dentry *tegra_nvdisp_create_bw_debugfs(struct tegra_dc *dc)
+{
+	/* Nothing to report without isomgr, but don't fail debugfs setup. */
+	return dc->debug_common_dir;
+}
+#endif
 #endif /* CONFIG_TEGRA_ISOMGR */
 
@@ -118,7 +118,7 @@ struct isomgr_ops {
 			enum tegra_iso_client client);
 	void (*isomgr_plat_unregister)(struct isomgr_client *cp);
 	bool (*isomgr_plat_reserve)(struct isomgr_client *cp,
-			u32 bw, enum tegra_iso_client client);
+			u32 bw, u32 mf, enum tegra_iso_client client);
 	bool (*isomgr_plat_realize)(struct isomgr_client *cp);
 	u32 (*isomgr_max_iso_bw)(enum tegra_iso_client client);
 };
@@ -147,6 +147,10 @@ u32 tegra_isomgr_reserve(tegra_isomgr_handle handle,
 /* Realize client reservation - apply settings, rval is dvfs thresh usec */
 u32 tegra_isomgr_realize(tegra_isomgr_handle handle);
 
+/* Realize several client reservations with a single EMC update */
+int tegra_isomgr_realize_batch(tegra_isomgr_handle *handles,
+			       u32 *dvfs_latency, int count);
+
 /* This sets bw aside for the client specified. */
 int tegra_isomgr_set_margin(enum tegra_iso_client client, u32 bw, bool wait);
 
@@ -189,6 +193,16 @@ static inline u32 tegra_isomgr_realize(tegra_isomgr_handle handle)
 	return 1;
 }
 
+static inline int tegra_isomgr_realize_batch(tegra_isomgr_handle *handles,
+			       u32 *dvfs_latency, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		dvfs_latency[i] = 1;
+	return 0;
+}
+
 static inline int tegra_isomgr_set_margin(enum tegra_iso_client client, u32 bw)
 {
 	return 0;
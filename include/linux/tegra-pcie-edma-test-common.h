@@ -10,6 +10,7 @@
 
 #include <linux/pci-epf.h>
 #include <linux/pcie_dma.h>
+#include <linux/seq_file.h>
 #include <linux/tegra-pcie-edma.h>
 
 #define EDMA_ABORT_TEST_EN	(edma->edma_ch & 0x40000000)
@@ -50,6 +51,12 @@ struct edmalib_common {
 	u32 nents_per_ch;
 	u32 st_as_ch;
 	u32 ls_as_ch;
+	/* Software engine window, loopback uses it instead of of_node if virt is set */
+	struct tegra_pcie_edma_sw_info sw;
+	/* CPU address of dst_dma_addr, set only if loopback can check the data */
+	void *dst_virt;
+	atomic_t lb_pending;
+	atomic_t lb_errors;
 };
 
 static struct edmalib_common *l_edma;
@@ -288,4 +295,165 @@ fail:
 	return -1;
 }
 
+static void edma_loopback_complete(void *priv, edma_xfer_status_t status,
+				   struct tegra_pcie_edma_desc *desc)
+{
+	struct edmalib_common *edma = l_edma;
+
+	if (status != EDMA_XFER_SUCCESS)
+		atomic_inc(&edma->lb_errors);
+	atomic_dec(&edma->lb_pending);
+	wake_up(&edma->wr_wq[0]);
+}
+
+static edma_xfer_status_t edma_loopback_submit(struct edmalib_common *edma, void *cookie,
+					       struct tegra_pcie_edma_xfer_info *tx_info)
+{
+	edma_xfer_status_t ret;
+	int pending;
+
+	while (true) {
+		atomic_inc(&edma->lb_pending);
+		ret = tegra_pcie_edma_submit_xfer(cookie, tx_info);
+		if (ret == EDMA_XFER_SUCCESS)
+			return ret;
+
+		pending = atomic_dec_return(&edma->lb_pending);
+		if (ret != EDMA_XFER_FAIL_NOMEM)
+			return ret;
+
+		/* Ring is full, retry once a completion freed descriptors */
+		if (pending && !wait_event_timeout(edma->wr_wq[0],
+						   atomic_read(&edma->lb_pending) < pending,
+						   msecs_to_jiffies(1000)))
+			return EDMA_XFER_FAIL_TIMEOUT;
+	}
+}
+
+/*
+ * debugfs loopback: all enabled WR channels copy src to dst in ASYNC mode for
+ * stress_count rounds and report MB/s and descriptors/s. Runs on the software
+ * engine when edma->sw.virt is set, so it works without eDMA hardware.
+ */
+static int edmalib_common_loopback(struct edmalib_common *edma, struct seq_file *s)
+{
+	struct tegra_pcie_edma_desc *ll_desc = edma->ll_desc;
+	struct tegra_pcie_edma_init_info info = {};
+	struct tegra_pcie_edma_xfer_info tx_info = {};
+	u32 nents = edma->nents, num_chans = 0, nents_per_ch, max_size, i, j, k;
+	char *engine_str = edma->sw.virt ? "sw" : "hw";
+	edma_xfer_status_t ret = EDMA_XFER_SUCCESS;
+	u64 diff, descs, bytes;
+	ktime_t start;
+	void *cookie;
+	int err = 0;
+
+	for (i = 0; i < DMA_WR_CHNL_NUM; i++) {
+		if (!IS_EDMA_CH_ENABLED(i))
+			continue;
+		info.tx[i].ch_type = EDMA_CHAN_XFER_ASYNC;
+		info.tx[i].num_descriptors = NUM_EDMA_DESC;
+		num_chans++;
+	}
+
+	max_size = edma->sw.virt ? edma->sw.size / 2 :
+		   (BAR0_DMA_BUF_SIZE - BAR0_DMA_BUF_OFFSET) / 2;
+	if (!num_chans || !edma->stress_count || nents < num_chans || nents > NUM_EDMA_DESC ||
+	    ((u64)edma->dma_size * nents) > max_size) {
+		dev_err(edma->fdev, "%s: need WR chans in edma_ch(0x%x), stress_count(%d), chans <= nents(%d) <= %d and nents * dma_size(%d) <= 0x%x\n",
+			__func__, edma->edma_ch, edma->stress_count, nents, NUM_EDMA_DESC,
+			edma->dma_size, max_size);
+		return -EINVAL;
+	}
+	nents_per_ch = nents / num_chans;
+
+	/* Loopback owns the engine, edmalib_test re-initializes on its next run */
+	if (edma->cookie) {
+		tegra_pcie_edma_deinit(edma->cookie);
+		edma->cookie = NULL;
+		edma->prev_edma_ch = 0;
+	}
+
+	if (edma->sw.virt)
+		info.sw = &edma->sw;
+	else
+		info.np = edma->of_node;
+
+	cookie = tegra_pcie_edma_initialize(&info);
+	if (!cookie) {
+		dev_err(edma->fdev, "%s: %s edma init failed\n", __func__, engine_str);
+		return -ENODEV;
+	}
+
+	for (j = 0; j < nents_per_ch * num_chans; j++) {
+		ll_desc[j].src = edma->src_dma_addr + (j * edma->dma_size);
+		ll_desc[j].dst = edma->dst_dma_addr + (j * edma->dma_size);
+		ll_desc[j].sz = edma->dma_size;
+	}
+
+	get_random_bytes(edma->src_virt, edma->dma_size * nents_per_ch * num_chans);
+	if (edma->dst_virt)
+		memset(edma->dst_virt, 0, edma->dma_size * nents_per_ch * num_chans);
+
+	l_edma = edma;
+	atomic_set(&edma->lb_pending, 0);
+	atomic_set(&edma->lb_errors, 0);
+	tx_info.type = EDMA_XFER_WRITE;
+	tx_info.nents = nents_per_ch;
+	tx_info.complete = edma_loopback_complete;
+
+	start = ktime_get();
+	for (k = 0; k < edma->stress_count && ret == EDMA_XFER_SUCCESS; k++) {
+		for (i = 0, j = 0; i < DMA_WR_CHNL_NUM; i++) {
+			if (!info.tx[i].num_descriptors)
+				continue;
+
+			tx_info.channel_num = i;
+			tx_info.desc = &ll_desc[j++ * nents_per_ch];
+			ret = edma_loopback_submit(edma, cookie, &tx_info);
+			if (ret != EDMA_XFER_SUCCESS) {
+				dev_err(edma->fdev, "%s: CH: %d submit failed with %d at iter %d\n",
+					__func__, i, ret, k);
+				err = -EIO;
+				break;
+			}
+		}
+	}
+
+	if (!wait_event_timeout(edma->wr_wq[0], !atomic_read(&edma->lb_pending),
+				msecs_to_jiffies(5000))) {
+		dev_err(edma->fdev, "%s: %d xfers did not complete\n", __func__,
+			atomic_read(&edma->lb_pending));
+		err = -ETIMEDOUT;
+	}
+	diff = ktime_to_ns(ktime_get()) - ktime_to_ns(start);
+	/* Completes anything still pending with EDMA_XFER_DEINIT */
+	tegra_pcie_edma_deinit(cookie);
+
+	if (atomic_read(&edma->lb_errors)) {
+		dev_err(edma->fdev, "%s: %d xfers completed with error\n", __func__,
+			atomic_read(&edma->lb_errors));
+		err = -EIO;
+	}
+	if (err)
+		return err;
+
+	if (edma->dst_virt &&
+	    memcmp(edma->dst_virt, edma->src_virt, edma->dma_size * nents_per_ch * num_chans)) {
+		dev_err(edma->fdev, "%s: dst does not match src\n", __func__);
+		return -EIO;
+	}
+
+	descs = (u64)edma->stress_count * nents_per_ch * num_chans;
+	bytes = descs * edma->dma_size;
+	diff = max_t(u64, diff, 1);
+	seq_printf(s, "%s engine: %d chans, %d desc of %d Bytes, %d iter: %llu MB/s, %llu desc/s, time %llu nsec\n",
+		   engine_str, num_chans, nents_per_ch, edma->dma_size, edma->stress_count,
+		   div64_u64(bytes * 1000, diff), div64_u64(descs * NSEC_PER_SEC, diff), diff);
+	dev_info(edma->fdev, "%s: %s engine %llu MB/s, %llu desc/s\n", __func__, engine_str,
+		 div64_u64(bytes * 1000, diff), div64_u64(descs * NSEC_PER_SEC, diff));
+
+	return 0;
+}
+
 #endif /* TEGRA_PCIE_EDMA_TEST_COMMON_H */
@@ -91,6 +91,20 @@ struct tegra_pcie_edma_chans_info {
 	dma_addr_t desc_iova;
 };
 
+/** @brief Software stand-in for the EDMA engine, for self-tests without hardware.
+ *  Descriptors are processed by a kernel worker that copies data with the CPU.
+ */
+struct tegra_pcie_edma_sw_info {
+	/** device used for descriptor allocation and logging */
+	struct device *dev;
+	/** DMA address of the only memory window descriptors may point to */
+	dma_addr_t base;
+	/** CPU address of the same window */
+	void *virt;
+	/** size of the window in bytes */
+	size_t size;
+};
+
 /** @brief init data structure to be used for tegra_pcie_edma_init() API */
 struct tegra_pcie_edma_init_info {
 	/** configuration details for edma Tx channels */
@@ -104,6 +118,11 @@ struct tegra_pcie_edma_init_info {
 	 * else uses local controller EDMA engine.
 	 */
 	struct pcie_tegra_edma_remote_info *edma_remote;
+	/**
+	 * Software engine pointer: used only if edma_remote and np are NULL. Transfers are
+	 * then done by the CPU, with an abort for descriptors outside of the window.
+	 */
+	struct tegra_pcie_edma_sw_info *sw;
 };
 
 /** @brief edma descriptor for data transfer operations */
@@ -144,6 +163,10 @@ void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info);
 
 /**
  * @brief: API to perform transfer operation.
+ *         Multiple callers may submit on the same channel concurrently. For
+ *         EDMA_CHAN_XFER_ASYNC channels this can be called from process or
+ *         softirq context, EDMA_CHAN_XFER_SYNC channels sleep until completion.
+ *         Doorbell is rung once per burst of concurrent submits.
  * @param[in] tx_info: EDMA Tx data structure. Refer struct tegra_pcie_edma_xfer_info for details.
  * @param[in] coockie : cookie data returned in tegra_pcie_edma_initialize() call.
  * @retVal: Refer edma_xfer_status_t.
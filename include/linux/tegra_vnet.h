@@ -14,14 +14,25 @@
 #ifndef PCIE_EPF_TEGRA_DMA_H
 #define PCIE_EPF_TEGRA_DMA_H
 
+#include <linux/dma-mapping.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/version.h>
+
 #define DMA_RD_CHNL_NUM			2
 #define DMA_WR_CHNL_NUM			4
 
-#define ENABLE_DMA 1
-
+/* Data queue pair q uses DMA read channel q and DMA write channel q */
 #define DMA_WR_DATA_CH 0
 #define DMA_RD_DATA_CH 0
 
+/* Host Tx of each queue pair needs its own EP DMA read channel */
+#define TVNET_MAX_QUEUES		DMA_RD_CHNL_NUM
+
+/* bar_md fields after ep_rx_pkt_size are valid only with this magic */
+#define TVNET_BAR_MD_MAGIC		0x32564e54
+#define TVNET_BAR_MD_VERSION		2
+
 /* Network link timeout 5 sec */
 #define LINK_TIMEOUT 5000
 
@@ -29,12 +40,26 @@
 #define TVNET_MIN_MTU 68
 #define TVNET_MAX_MTU TVNET_DEFAULT_MTU
 
+/* Largest TSO packet sent to a version 2 peer */
+#define TVNET_GSO_MAX_SIZE TVNET_MAX_MTU
+/* Rx buffers of version 2 drivers also hold a TSO packet at small MTU */
+#define TVNET_RX_BUF_LEN(mtu) \
+	(max_t(int, (mtu), TVNET_GSO_MAX_SIZE) + ETH_HLEN)
+
 #define TVNET_NAPI_WEIGHT	64
 
 #define RING_COUNT 256
 
 /* Allocate 100% extra desc to handle the drift between empty & full buffer */
 #define DMA_DESC_COUNT (2 * RING_COUNT)
+/* Desc ring of one DMA channel, last desc links back to the first one */
+#define TVNET_DMA_RING_SIZE \
+	PAGE_ALIGN((DMA_DESC_COUNT + 1) * sizeof(struct tvnet_dma_desc))
+
+/* Max packets queued to DMA before ringing doorbell once for all of them */
+#define TVNET_TX_BATCH 16
+/* One DMA desc per skb segment, linear part and each frag */
+#define TVNET_MAX_SEGS (MAX_SKB_FRAGS + 1)
 
 
 /* DMA base offset starts at 0x20000 from ATU_DMA base */
@@ -67,6 +92,10 @@
 #define DMA_WRITE_IMWR_DATA_OFF_BASE	0x70
 
 #define DMA_WRITE_LINKED_LIST_ERR_EN_OFF	0x90
+/* Done and abort bits of a channel in DMA_{WRITE,READ}_INT_STATUS_OFF */
+#define DMA_INT_DONE(ch)		BIT(ch)
+#define DMA_INT_ABORT(ch)		BIT(16 + (ch))
+
 #define DMA_READ_INT_STATUS_OFF		0xA0
 #define DMA_READ_INT_MASK_OFF		0xA8
 #define DMA_READ_INT_CLEAR_OFF		0xAC
@@ -203,6 +232,16 @@ struct ring_buf_md {
 	u32 ep2h_size;
 };
 
+/* Data rings and host DMA desc ring of one queue pair */
+struct tvnet_queue_md {
+	u32 ep_own_cnt_offset;
+	u32 host_own_cnt_offset;
+	struct ring_buf_md ep2h_md;
+	struct ring_buf_md h2ep_md;
+	u32 host_dma_offset;
+	u32 host_dma_size;
+};
+
 struct bar_md {
 	/* IRQ generation for control packets */
 	struct irq_md irq_ctrl;
@@ -222,6 +261,17 @@ struct bar_md {
 	u64 bar0_base_phy;
 	u32 ep_rx_pkt_offset;
 	u32 ep_rx_pkt_size;
+	/*
+	 * Version 2 (multiqueue). Queue 0 is the one described above, so a
+	 * peer that does not know these fields keeps working on it.
+	 */
+	u32 magic;
+	u32 version;
+	/* Queue pairs supported by EP */
+	u32 num_queues;
+	/* Queue pairs used by host, written by host before CTRL_MSG_LINK_UP */
+	u32 host_num_queues;
+	struct tvnet_queue_md queue_md[TVNET_MAX_QUEUES];
 };
 
 enum ctrl_msg_type {
@@ -244,6 +294,12 @@ enum data_msg_type {
 	DATA_MSG_FULL_BUF,
 };
 
+enum tvnet_gso_type {
+	TVNET_GSO_NONE = 0,
+	TVNET_GSO_TCPV4,
+	TVNET_GSO_TCPV6,
+};
+
 struct data_msg {
 	u32 msg_id; /* enum data_msg_type */
 	union {
@@ -253,7 +309,13 @@ struct data_msg {
 		} empty_buffer;
 		struct {
 			u32 packet_size;
+			/* GSO fields are valid only from version 2 peers */
+			u16 gso_size;
+			u16 gso_type; /* enum tvnet_gso_type */
 			u64 pcie_address;
+			/* Partial csum of TSO packet, offsets from Ethernet hdr */
+			u16 csum_start;
+			u16 csum_offset;
 		} full_buffer;
 		u32 reserved[7];
 	} u;
@@ -307,12 +369,7 @@ struct ep2h_empty_list {
 
 struct h2ep_empty_list {
 	int size;
-#if ENABLE_DMA
 	struct sk_buff *skb;
-#else
-	struct page *page;
-	void *virt;
-#endif
 	dma_addr_t iova;
 	struct list_head list;
 };
@@ -328,12 +385,136 @@ enum os_link_state {
 	OS_LINK_STATE_DOWN,
 };
 
-#if ENABLE_DMA
 struct dma_desc_cnt {
 	u32 rd_cnt;
 	u32 wr_cnt;
 };
+
+/* Tx packet whose segments are queued to DMA, pending doorbell */
+struct tvnet_tx_buf {
+	struct sk_buff *skb;
+	u64 dst_iova;
+	u32 nr_segs;
+	dma_addr_t iova[TVNET_MAX_SEGS];
+	u32 len[TVNET_MAX_SEGS];
+};
+
+static inline bool tvnet_xmit_more(struct sk_buff *skb)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0))
+	return netdev_xmit_more();
+#else
+	return skb->xmit_more;
 #endif
+}
+
+static inline void tvnet_tx_buf_unmap(struct device *d,
+				      struct tvnet_tx_buf *tx_buf)
+{
+	u32 i;
+
+	for (i = 0; i < tx_buf->nr_segs; i++) {
+		if (i == 0)
+			dma_unmap_single(d, tx_buf->iova[i], tx_buf->len[i],
+					 DMA_TO_DEVICE);
+		else
+			dma_unmap_page(d, tx_buf->iova[i], tx_buf->len[i],
+				       DMA_TO_DEVICE);
+	}
+	tx_buf->nr_segs = 0;
+}
+
+/*
+ * Map linear part and frags of skb for DMA, no copy is made. Peer does not
+ * get csum_start/offset, so resolve CHECKSUM_PARTIAL here.
+ */
+static inline int tvnet_tx_buf_map(struct device *d, struct sk_buff *skb,
+				   struct tvnet_tx_buf *tx_buf)
+{
+	struct skb_shared_info *info = skb_shinfo(skb);
+	dma_addr_t iova;
+	u32 len;
+	int i;
+
+	tx_buf->skb = skb;
+	tx_buf->nr_segs = 0;
+
+	/* TSO packets keep partial csum, peer gets csum_start/offset */
+	if (!skb_is_gso(skb) && (skb->ip_summed == CHECKSUM_PARTIAL) &&
+	    skb_checksum_help(skb))
+		return -EINVAL;
+
+	len = skb_headlen(skb);
+	iova = dma_map_single(d, skb->data, len, DMA_TO_DEVICE);
+	if (dma_mapping_error(d, iova))
+		return -ENOMEM;
+	tx_buf->iova[0] = iova;
+	tx_buf->len[0] = len;
+	tx_buf->nr_segs = 1;
+
+	for (i = 0; i < info->nr_frags; i++) {
+		const skb_frag_t *frag = &info->frags[i];
+
+		len = skb_frag_size(frag);
+		iova = skb_frag_dma_map(d, frag, 0, len, DMA_TO_DEVICE);
+		if (dma_mapping_error(d, iova)) {
+			tvnet_tx_buf_unmap(d, tx_buf);
+			return -ENOMEM;
+		}
+		tx_buf->iova[tx_buf->nr_segs] = iova;
+		tx_buf->len[tx_buf->nr_segs] = len;
+		tx_buf->nr_segs++;
+	}
+
+	return 0;
+}
+
+/* Describe TSO of skb in its full msg, peer segments it if needed */
+static inline void tvnet_full_msg_set_gso(struct data_msg *msg,
+					  struct sk_buff *skb)
+{
+	struct skb_shared_info *info = skb_shinfo(skb);
+
+	if (!skb_is_gso(skb)) {
+		msg->u.full_buffer.gso_size = 0;
+		msg->u.full_buffer.gso_type = TVNET_GSO_NONE;
+		return;
+	}
+
+	msg->u.full_buffer.gso_size = info->gso_size;
+	msg->u.full_buffer.gso_type = (info->gso_type & SKB_GSO_TCPV6) ?
+					TVNET_GSO_TCPV6 : TVNET_GSO_TCPV4;
+	msg->u.full_buffer.csum_start = skb_checksum_start_offset(skb);
+	msg->u.full_buffer.csum_offset = skb->csum_offset;
+}
+
+/* Apply TSO info of full msg from a version 2 peer to received skb */
+static inline int tvnet_rx_set_gso(struct sk_buff *skb,
+				   const struct data_msg *msg)
+{
+	struct skb_shared_info *info = skb_shinfo(skb);
+	u16 gso_type = msg->u.full_buffer.gso_type;
+
+	if (gso_type == TVNET_GSO_NONE)
+		return 0;
+
+	if ((gso_type > TVNET_GSO_TCPV6) || !msg->u.full_buffer.gso_size)
+		return -EINVAL;
+
+	/* Must be done before eth_type_trans(), offsets are from skb->data */
+	if (!skb_partial_csum_set(skb, msg->u.full_buffer.csum_start,
+				  msg->u.full_buffer.csum_offset))
+		return -EINVAL;
+
+	info->gso_size = msg->u.full_buffer.gso_size;
+	info->gso_type = (gso_type == TVNET_GSO_TCPV6) ? SKB_GSO_TCPV6 :
+							SKB_GSO_TCPV4;
+	/* Header is from peer, let stack validate it and count segs */
+	info->gso_type |= SKB_GSO_DODGY;
+	info->gso_segs = 0;
+
+	return 0;
+}
 
 static inline bool tvnet_ivc_empty(struct tvnet_counter *counter)
 {
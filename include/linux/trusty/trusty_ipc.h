@@ -15,11 +15,14 @@
 #ifndef __LINUX_TRUSTY_TRUSTY_IPC_H
 #define __LINUX_TRUSTY_TRUSTY_IPC_H
 
+#include <linux/llist.h>
+
 /*
  * Errnos below must be in sync with the corresponding errnos
  * defined in 3rdparty/trusty/external/lk/include/err.h
  */
 #define NO_ERROR                (0)
+#define ERR_GENERIC             (-1)
 #define ERR_NOT_FOUND           (-2)
 
 struct tipc_chan;
@@ -31,6 +34,8 @@ struct tipc_msg_buf {
 	size_t wpos;
 	size_t rpos;
 	struct list_head node;
+	/* links buffer into device free lists while not in use */
+	struct llist_node lnode;
 };
 
 enum tipc_chan_event {
@@ -30,6 +30,7 @@ extern "C" {
 #define DRM_TEGRA_UDRM_DROP_MASTER_NOTIFY       0x04
 #define DRM_TEGRA_UDRM_SET_MASTER_NOTIFY        0x05
 #define DRM_TEGRA_UDRM_SEND_CONNECTOR_STATUS_EVENT 0x06
+#define DRM_TEGRA_UDRM_SEND_EVENTS              0x07
 
 struct drm_tegra_udrm_dmabuf_mmap {
 	int fd;
@@ -64,6 +65,31 @@ struct drm_tegra_udrm_connector_status_event {
 	uint32_t prop_id;
 };
 
+/* Event types accepted by DRM_IOCTL_TEGRA_UDRM_SEND_EVENTS. */
+#define DRM_TEGRA_UDRM_EVENT_VBLANK             0
+#define DRM_TEGRA_UDRM_EVENT_CONNECTOR_STATUS   1
+
+/* Maximum number of events accepted in a single SEND_EVENTS call. */
+#define DRM_TEGRA_UDRM_MAX_EVENTS               64
+
+struct drm_tegra_udrm_event {
+	uint32_t type;
+	uint32_t reserved;
+	union {
+		/* vblank.base.type selects between DRM_EVENT_VBLANK and
+		 * DRM_EVENT_FLIP_COMPLETE.
+		 */
+		struct drm_event_vblank vblank;
+		struct drm_tegra_udrm_connector_status_event connector;
+	} u;
+};
+
+struct drm_tegra_udrm_send_events {
+	uint64_t events;
+	uint32_t num_events;
+	uint32_t num_sent;
+};
+
 #define TEGRA_UDRM_IOCTL(dir, name, str) \
 	DRM_##dir(DRM_COMMAND_BASE + DRM_TEGRA_UDRM_##name, \
 		struct drm_tegra_udrm_##str)
@@ -72,6 +98,9 @@ struct drm_tegra_udrm_connector_status_event {
  * ioctl from handling of DRM_IOCTL_MODE_MAP_DUMB with dmabuf fd
  * corresponding to dumb buffer. Driver will return fake offset
  * to UMD which can be used by DRM clients in mmap(.., offset).
+ * The offset is tied to the dmabuf rather than to the fd, so calling
+ * this ioctl again for the same buffer returns the same offset until
+ * DRM_IOCTL_TEGRA_UDRM_DMABUF_DESTROY_MAPPINGS is issued.
  *
  * In parameters -
  *     fd: dmabuf fd.
@@ -138,6 +167,26 @@ struct drm_tegra_udrm_connector_status_event {
 	TEGRA_UDRM_IOCTL(IOW, SEND_CONNECTOR_STATUS_EVENT, \
 		connector_status_event)
 
+/* UMD issues this ioctl to inject several vblank/flip-complete and
+ * connector status events with a single call, e.g. one event per head
+ * at every refresh. This saves one ioctl per event, and consecutive
+ * vblank events are queued to the DRM file under a single event lock
+ * acquisition. A blocked reader is still woken up for each queued
+ * event, but all events of the batch are already queued when a read
+ * returns, so they can be consumed with a single read.
+ *
+ * In parameters -
+ *    events: user pointer to an array of struct drm_tegra_udrm_event.
+ *    num_events: number of entries in the array, at most
+ *                DRM_TEGRA_UDRM_MAX_EVENTS.
+ *
+ * Out parameters -
+ *    num_sent: number of events delivered. Events are delivered in
+ *              array order and delivery stops at the first failure.
+ */
+#define DRM_IOCTL_TEGRA_UDRM_SEND_EVENTS \
+	TEGRA_UDRM_IOCTL(IOWR, SEND_EVENTS, send_events)
+
 #if defined(__cplusplus)
 }
 #endif
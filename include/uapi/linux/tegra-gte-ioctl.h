@@ -41,7 +41,8 @@ struct tegra_gte_hts_event_req {
 };
 
 /**
- * struct hts_event_data - event data
+ * struct hts_event_data - event data, read() on the event fd returns as many
+ * of these as fit in the buffer
  * @timestamp: hardware timestamp in nanosecond
  * @dir: direction of the event
  */
@@ -51,6 +52,41 @@ struct tegra_gte_hts_event_data {
 	int dir;
 };
 
+/**
+ * Shared event ring request, issued on the event fd returned by
+ * HTS_CREATE_GPIO_EVENT_IOCTL
+ * @num_events: ring capacity in events, must be a power of two
+ * @watermark: poll() reports POLLIN once this many events are in the ring,
+ * 0 is treated as 1
+ */
+struct tegra_gte_hts_event_ring_req {
+	__u32 num_events;
+	__u32 watermark;
+};
+
+/**
+ * struct tegra_gte_hts_event_ring - header of the mmap()ed event ring
+ * @head: free running producer index, written by the kernel
+ * @tail: free running consumer index, written by userspace
+ * @num_events: ring capacity, the slot of index i is ev[i & (num_events - 1)]
+ * @dropped: events lost because the ring was full
+ * @ev: event slots
+ *
+ * Once the ring is set up, events are delivered only through it and read()
+ * on the event fd returns -EINVAL. Events still queued for read() at that
+ * point are not moved into the ring.
+ */
+struct tegra_gte_hts_event_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 num_events;
+	__u32 dropped;
+	__u32 reserved[4];
+	struct tegra_gte_hts_event_data ev[];
+};
+
+#define TEGRA_GTE_HTS_EVENT_RING_MAX	65536
+
 /**
  * Event request IOCTL command
  */
@@ -58,4 +94,11 @@ struct tegra_gte_hts_event_data {
 					_IOWR(0xB5, 0x0, \
 					      struct tegra_gte_hts_event_req)
 
+/**
+ * Switch an event fd to the shared ring, then mmap() the fd to access it
+ */
+#define TEGRA_GTE_HTS_SETUP_EV_RING_IOCTL \
+					_IOW(0xB5, 0x1, \
+					     struct tegra_gte_hts_event_ring_req)
+
 #endif
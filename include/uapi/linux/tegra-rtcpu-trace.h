@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: (GPL-2.0 WITH Linux-syscall-note)
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ */
+
+#ifndef _UAPI_TEGRA_RTCPU_TRACE_H_
+#define _UAPI_TEGRA_RTCPU_TRACE_H_
+
+#include <linux/types.h>
+
+/*
+ * Position returned by read() on the tegra_rtcpu_trace/raw debugfs file,
+ * whose mmap() gives a read-only view of the trace memory. idx is the
+ * event index the kernel has seen so far, the next entry the camera RTCPU
+ * will write.
+ *
+ * seq counts every event since the tracer was created and does not wrap,
+ * so a reader can tell how many events went by between two reads even when
+ * idx wrapped around the ring. If that is more than event_entries - 1, the
+ * oldest of them were overwritten.
+ */
+struct rtcpu_trace_raw_pos {
+	__u32 idx;
+	__u32 reserved;
+	__u64 seq;
+};
+
+#endif	/* _UAPI_TEGRA_RTCPU_TRACE_H_ */
@@ -261,6 +261,53 @@ struct tegra_soc_hwpm_exec_reg_ops {
 	__u8 b_all_reg_ops_passed;
 };
 
+/*
+ * TEGRA_CTRL_CMD_SOC_HWPM_CREATE_REG_OPS_PROG,
+ * TEGRA_CTRL_CMD_SOC_HWPM_EXEC_REG_OPS_PROG and
+ * TEGRA_CTRL_CMD_SOC_HWPM_DESTROY_REG_OPS_PROG IOCTLs
+ *
+ * A reg ops program is an array of REG_OPs which is validated against the
+ * allowlist once at CREATE time and can then be executed repeatedly by
+ * handle, without revalidating every address on each EXEC.
+ */
+struct tegra_soc_hwpm_reg_ops_prog {
+	/*
+	 * Inputs and Outputs
+	 *
+	 * CREATE: user pointer to op_count struct tegra_soc_hwpm_reg_op
+	 *         making up the program. The validation status of each
+	 *         REG_OP is written back.
+	 * EXEC:   optional user pointer to op_count struct
+	 *         tegra_soc_hwpm_reg_op receiving the status and read
+	 *         values of each REG_OP. Set to 0 if not required.
+	 * DESTROY: unused
+	 */
+	__u64 ops;
+#define TEGRA_SOC_HWPM_REG_OPS_PROG_SIZE	1024
+	__u32 op_count;
+
+	/*
+	 * CREATE: Output
+	 * EXEC, DESTROY: Input
+	 */
+	__u32 handle;
+
+	/*
+	 * CREATE: Input, one of TEGRA_SOC_HWPM_REG_OP_MODE_*
+	 * In FAIL_ON_FIRST mode, CREATE fails if any REG_OP is malformed.
+	 * In CONT_ON_ERR mode, malformed REG_OPs are skipped on EXEC.
+	 */
+	__u8 mode;
+
+	/*
+	 * CREATE, EXEC: Output
+	 */
+	__u8 b_all_reg_ops_passed;
+
+	/* Explicit padding for 8 Byte alignment */
+	__u8 reserved[6];
+};
+
 /* TEGRA_CTRL_CMD_SOC_HWPM_UPDATE_GET_PUT IOCTL */
 #define TEGRA_SOC_HWPM_MEM_BYTES_INVALID	0xffffffff
 struct tegra_soc_hwpm_update_get_put {
@@ -287,6 +334,50 @@ struct tegra_soc_hwpm_update_get_put {
 	__u8 b_overflowed;
 };
 
+/*
+ * Stream status page
+ *
+ * A read-only page which can be mmap'ed at offset 0 of the device node after
+ * ALLOC_PMA_STREAM. The driver updates it from UPDATE_GET_PUT and, while
+ * stream notification is enabled, periodically in the background.
+ *
+ * seq is odd while the driver updates the page. Readers should sample seq,
+ * read the fields and retry if seq was odd or has changed.
+ */
+struct tegra_soc_hwpm_stream_status {
+	__u64 seq;
+	__u64 stream_buf_size;	/* Size of the PMA stream buffer */
+	__u64 mem_head;		/* Last read HW put pointer */
+	__u64 mem_bytes;	/* Last streamed MEM_BYTES (unread bytes) */
+	__u64 mem_bumped;	/* Total bytes released with mem_bump */
+	__u64 overflow_count;	/* Number of membuf overflows observed */
+	__u8 b_overflowed;	/* Membuf currently in overflow state */
+
+	/* Explicit padding for 8 Byte alignment */
+	__u8 reserved[7];
+};
+
+/* TEGRA_CTRL_CMD_SOC_HWPM_STREAM_NOTIFY IOCTL */
+struct tegra_soc_hwpm_stream_notify {
+	/*
+	 * Inputs
+	 */
+	/*
+	 * poll() on the device node reports POLLIN once at least
+	 * fill_threshold bytes are unread in the stream buffer and POLLERR
+	 * on membuf overflow. 0 disables notification.
+	 */
+	__u64 fill_threshold;
+	/*
+	 * Interval at which the driver samples MEM_BYTES in the background.
+	 * 0 selects the default of 1 ms.
+	 */
+	__u32 period_us;
+
+	/* Explicit padding for 8 Byte alignment */
+	__u32 reserved;
+};
+
 /* IOCTL enum */
 enum tegra_soc_hwpm_ioctl_num {
 	TEGRA_SOC_HWPM_IOCTL_DEVICE_INFO,
@@ -298,6 +389,10 @@ enum tegra_soc_hwpm_ioctl_num {
 	TEGRA_SOC_HWPM_IOCTL_QUERY_ALLOWLIST,
 	TEGRA_SOC_HWPM_IOCTL_EXEC_REG_OPS,
 	TEGRA_SOC_HWPM_IOCTL_UPDATE_GET_PUT,
+	TEGRA_SOC_HWPM_IOCTL_CREATE_REG_OPS_PROG,
+	TEGRA_SOC_HWPM_IOCTL_EXEC_REG_OPS_PROG,
+	TEGRA_SOC_HWPM_IOCTL_DESTROY_REG_OPS_PROG,
+	TEGRA_SOC_HWPM_IOCTL_STREAM_NOTIFY,
 	TERGA_SOC_HWPM_NUM_IOCTLS
 };
 
@@ -365,6 +460,9 @@ enum tegra_soc_hwpm_ioctl_num {
  *    - QUERY_ALLOWLIST
  *    - EXEC_REG_OPS
  *    - UPDATE_GET_PUT
+ *    - CREATE_REG_OPS_PROG
+ *    - EXEC_REG_OPS_PROG
+ *    - STREAM_NOTIFY
  */
 #define TEGRA_CTRL_CMD_BIND						\
 			_IO(TEGRA_SOC_HWPM_IOC_MAGIC,			\
@@ -402,6 +500,46 @@ enum tegra_soc_hwpm_ioctl_num {
 				TEGRA_SOC_HWPM_IOCTL_UPDATE_GET_PUT,	\
 				struct tegra_soc_hwpm_update_get_put)
 
+/*
+ * IOCTL for validating a reg ops program and returning its handle
+ *
+ * This IOCTL can only be called after the BIND IOCTL
+ */
+#define	TEGRA_CTRL_CMD_SOC_HWPM_CREATE_REG_OPS_PROG			\
+			_IOWR(TEGRA_SOC_HWPM_IOC_MAGIC,			\
+				TEGRA_SOC_HWPM_IOCTL_CREATE_REG_OPS_PROG, \
+				struct tegra_soc_hwpm_reg_ops_prog)
+
+/*
+ * IOCTL for executing a previously created reg ops program
+ *
+ * This IOCTL can only be called after the BIND IOCTL
+ */
+#define	TEGRA_CTRL_CMD_SOC_HWPM_EXEC_REG_OPS_PROG			\
+			_IOWR(TEGRA_SOC_HWPM_IOC_MAGIC,			\
+				TEGRA_SOC_HWPM_IOCTL_EXEC_REG_OPS_PROG,	\
+				struct tegra_soc_hwpm_reg_ops_prog)
+
+/*
+ * IOCTL for destroying a reg ops program
+ *
+ * All programs are destroyed when the device is closed.
+ */
+#define	TEGRA_CTRL_CMD_SOC_HWPM_DESTROY_REG_OPS_PROG			\
+			_IOWR(TEGRA_SOC_HWPM_IOC_MAGIC,			\
+				TEGRA_SOC_HWPM_IOCTL_DESTROY_REG_OPS_PROG, \
+				struct tegra_soc_hwpm_reg_ops_prog)
+
+/*
+ * IOCTL for configuring poll() notification on PMA stream fill level
+ *
+ * This IOCTL can only be called after the BIND IOCTL
+ */
+#define	TEGRA_CTRL_CMD_SOC_HWPM_STREAM_NOTIFY				\
+			_IOW(TEGRA_SOC_HWPM_IOC_MAGIC,			\
+				TEGRA_SOC_HWPM_IOCTL_STREAM_NOTIFY,	\
+				struct tegra_soc_hwpm_stream_notify)
+
 
 /* Interface for IP driver communication */
 
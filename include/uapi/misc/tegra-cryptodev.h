@@ -308,4 +308,95 @@ struct tegra_sha_req_32 {
 #endif /* CONFIG_COMPAT */
 #endif /* __KERNEL__ */
 
+/*
+ * Asynchronous submission ring
+ *
+ * TEGRA_CRYPTO_IOCTL_RING_SETUP creates a submission queue (SQ) and a
+ * completion queue (CQ) shared with the kernel; mmap() the device at
+ * offset 0 with ring_size bytes to access them. Data is not passed through
+ * the ring: buffers are registered once with TEGRA_CRYPTO_IOCTL_BUF_REGISTER
+ * (the pages stay pinned) and each SQ entry refers to a registered buffer
+ * index and offset for its source and destination.
+ *
+ * User space fills SQ entries at sq_tail, publishes the new sq_tail and
+ * rings the doorbell with TEGRA_CRYPTO_IOCTL_RING_ENTER. The ioctl returns
+ * the number of entries consumed; every consumed entry produces exactly one
+ * CQ entry once the operation completes. Completions are signalled through
+ * poll()/POLLIN on the device fd and, if one was given, the eventfd. User
+ * space consumes CQ entries at cq_head and publishes the new cq_head.
+ * Head and tail indices are free running; mask them with entries - 1.
+ *
+ * Only AES (TEGRA_CRYPTO_ECB..XTS) and SHA1..SHA512 digests are accepted
+ * through the ring; everything else stays on the ioctl interface.
+ */
+#define TEGRA_CRYPTO_RING_MAX_ENTRIES	256
+#define TEGRA_CRYPTO_RING_MAX_BUFS	16
+
+enum tegra_crypto_ring_opcode {
+	TEGRA_CRYPTO_RING_OP_AES_ENCRYPT,
+	TEGRA_CRYPTO_RING_OP_AES_DECRYPT,
+	TEGRA_CRYPTO_RING_OP_SHA,
+};
+
+/* Shared ring header at offset 0 of the mapping */
+struct tegra_crypto_ring_hdr {
+	__u32 sq_head;		/* written by kernel */
+	__u32 sq_tail;		/* written by user space */
+	__u32 cq_head;		/* written by user space */
+	__u32 cq_tail;		/* written by kernel */
+	__u32 sq_entries;
+	__u32 cq_entries;
+	__u32 cq_overflow;	/* written by kernel */
+	__u32 reserved;
+};
+
+struct tegra_crypto_sqe {
+	__u64 user_data;	/* returned unchanged in the CQ entry */
+	__u8 opcode;		/* enum tegra_crypto_ring_opcode */
+	__u8 mode;		/* AES: TEGRA_CRYPTO_*, SHA: enum sha_algo */
+	__u16 keylen;
+	__u32 len;		/* bytes to process */
+	__u32 src_buf;		/* registered buffer index */
+	__u32 src_off;
+	__u32 dst_buf;		/* registered buffer index */
+	__u32 dst_off;		/* AES output or SHA digest */
+	__u8 key[TEGRA_CRYPTO_MAX_KEY_SIZE];
+	__u8 iv[TEGRA_CRYPTO_IV_SIZE];
+};
+
+struct tegra_crypto_cqe {
+	__u64 user_data;
+	__s32 result;		/* 0 or negative errno */
+	__u32 reserved;
+	__u8 iv[TEGRA_CRYPTO_IV_SIZE];	/* AES: updated IV for chaining */
+};
+
+/* pointer to this struct should be passed to TEGRA_CRYPTO_IOCTL_RING_SETUP */
+struct tegra_crypto_ring_setup {
+	__u32 entries;		/* SQ entries, power of 2 */
+	__s32 eventfd;		/* -1 for none */
+	__u32 sq_off;		/* out: offset of SQ entries in the mapping */
+	__u32 cq_off;		/* out: offset of CQ entries in the mapping */
+	__u64 ring_size;	/* out: size to mmap() */
+};
+#define TEGRA_CRYPTO_IOCTL_RING_SETUP	\
+		_IOWR(0x98, 111, struct tegra_crypto_ring_setup)
+/* ioctl arg = number of SQ entries to consume, passed by value */
+#define TEGRA_CRYPTO_IOCTL_RING_ENTER	_IO(0x98, 112)
+
+/* pointer to this struct should be passed to:
+ * TEGRA_CRYPTO_IOCTL_BUF_REGISTER
+ * TEGRA_CRYPTO_IOCTL_BUF_UNREGISTER (only index is used)
+ */
+struct tegra_crypto_buf_reg {
+	__u64 addr;
+	__u64 len;
+	__u32 index;		/* out for register, in for unregister */
+	__u32 reserved;
+};
+#define TEGRA_CRYPTO_IOCTL_BUF_REGISTER	\
+		_IOWR(0x98, 113, struct tegra_crypto_buf_reg)
+#define TEGRA_CRYPTO_IOCTL_BUF_UNREGISTER	\
+		_IOW(0x98, 114, struct tegra_crypto_buf_reg)
+
 #endif
@@ -1475,6 +1475,51 @@ struct tegra_dc_ext_scrncapt_dup_fbuf  {
 	__u32 reserved[16];
 };
 
+/*
+ * Zero-copy capture of the frame buffer a window is currently scanning out.
+ *
+ * Unlike TEGRA_DC_EXT_SCRNCAPT_DUP_FBUF this doesn't need the display to be
+ * paused and doesn't copy any data. 'ver' must carry the magic returned by
+ * TEGRA_DC_EXT_CONTROL_IOCTL_SCRNCAPT_PAUSE, and 'head' selects the head
+ * whose window 'win' is captured. Each used plane is returned as a dma-buf
+ * fd, together with a sync file fd whose fence signals once the window has
+ * flipped away from the captured buffer.
+ *
+ * While a capture is outstanding, the display keeps flipping but holds back
+ * releasing the captured buffer to its producer after it flipped away from
+ * it, for at most TEGRA_DC_EXT_SCRNCAPT_EXPORT_HOLD_MS. Later flips of the
+ * same window are released together with it. A capture that outlives the
+ * hold is dropped and its content may be overwritten from then on.
+ *
+ * The capture is finished with the IOCTL TEGRA_DC_EXT_SCRNCAPT_RELEASE_FBUF,
+ * or when the dc fd is closed. At most TEGRA_DC_EXT_SCRNCAPT_EXPORT_MAX
+ * captures can be outstanding per window. The returned fds are owned by the
+ * caller and must be closed by it.
+ */
+#define TEGRA_DC_EXT_SCRNCAPT_EXPORT_MAX	4
+#define TEGRA_DC_EXT_SCRNCAPT_EXPORT_HOLD_MS	100
+
+struct tegra_dc_ext_scrncapt_export_fbuf {
+	__u32 ver;        /* set to TEGRA_DC_EXT_SCRNCAPT_VER_2
+			   * returns TEGRA_DC_EXT_SCRNCAPT_VER_2 */
+	__u32 head;       /* head ID */
+	__u32 win;        /* window ID */
+	__u32 flags;      /* reserved, must be 0 */
+	__u32 capture_id; /* returns id to pass to RELEASE_FBUF */
+	__s32 release_fence_fd; /* returns sync file fd signalled on flip-away */
+	/* returns a dma-buf fd of each plane, -1 for plane not available */
+	__s32 plane_fds[TEGRA_DC_SCRNCAPT_DUP_FBUF_IDX_NUM];
+	/* returns length of each plane, 0 for plane not available */
+	__u32 plane_sizes[TEGRA_DC_SCRNCAPT_DUP_FBUF_IDX_NUM];
+	__u32 reserved[6];
+};
+
+struct tegra_dc_ext_scrncapt_release_fbuf {
+	__u32 win;        /* window ID */
+	__u32 capture_id; /* id returned by EXPORT_FBUF */
+	__u32 reserved[4];
+};
+
 /* Scanline sync ioctl */
 #define TEGRA_DC_EXT_SCANLINE_FLAG_ENABLE (1U << 0)
 #define TEGRA_DC_EXT_SCANLINE_FLAG_DISABLE (0U << 0)
@@ -1662,6 +1707,12 @@ struct tegra_dc_ext_scanline_info {
 #define TEGRA_DC_EXT_CRC_GET \
 	_IOWR('D', 0x28, struct tegra_dc_ext_crc_arg)
 
+#define TEGRA_DC_EXT_SCRNCAPT_EXPORT_FBUF \
+	_IOWR('D', 0x29, struct tegra_dc_ext_scrncapt_export_fbuf)
+
+#define TEGRA_DC_EXT_SCRNCAPT_RELEASE_FBUF \
+	_IOW('D', 0x2A, struct tegra_dc_ext_scrncapt_release_fbuf)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
@@ -0,0 +1,677 @@
+/*
+ * bwmgr_replay - replay EMC bandwidth manager requests through a model of
+ * the full-rescan bwmgr and of the incremental one with cached and
+ * coalesced clock updates, check that both pick the same EMC rate, and
+ * count the rescans and clock calls each one makes.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * The model follows tegra_bwmgr_set_emc(), bwmgr_update_clk(),
+ * bwmgr_agg_rescan() and bwmgr_apply_clk() in
+ * drivers/platform/tegra/mc/emc_bwmgr.c and must be kept in sync with them.
+ * The DRAM efficiency step is the T21x one with fixed percentages. No device
+ * is needed. The trace is the ftrace output of the tegra_bwmgr_set_emc
+ * event:
+ *
+ *	echo 1 > /sys/kernel/debug/tracing/events/bwmgr/tegra_bwmgr_set_emc/enable
+ *	cat /sys/kernel/debug/tracing/trace > bwmgr.txt
+ *
+ * Without a trace, a mix of CPU and GPU bandwidth votes, display and camera
+ * ISO requests and occasional floors and caps is generated.
+ *
+ * Build:
+ *	cc -O2 -o bwmgr_replay bwmgr_replay.c
+ *
+ * Example Usage:
+ *	bwmgr_replay -n 200000
+ *	bwmgr_replay -t bwmgr.txt -c 1000
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <time.h>
+
+/* from drivers/platform/tegra/mc/emc_bwmgr.c, in enum order */
+static const char * const client_names[] = {
+	"cpu_cluster_0", "cpu_cluster_1", "cpu_cluster_2", "cpu_cluster_3",
+	"disp_0", "disp_1", "disp_2", "disp1_la_emc", "disp2_la_emc",
+	"usbd", "xhci", "sdmmc1", "sdmmc2", "sdmmc3", "sdmmc4", "mon",
+	"gpu", "msenc", "nvenc1", "nvjpg", "nvdec", "nvdec1", "tsec",
+	"tsecb", "vi", "ispa", "ispb", "camera", "camera_non_iso", "camrtc",
+	"isomgr", "thermal", "vic", "adsp", "adma", "pcie", "pcie_1",
+	"pcie_2", "pcie_3", "pcie_4", "pcie_5", "bbc_0", "eqos", "se0",
+	"se1", "se2", "se3", "se4", "nvpmodel", "debug", "nvdla0", "nvdla1",
+};
+
+#define CLIENT_COUNT	(int)(sizeof(client_names) / sizeof(client_names[0]))
+#define CLIENT_CPU0	0
+#define CLIENT_DISP0	4
+#define CLIENT_DISP1	5
+#define CLIENT_DISP2	6
+#define CLIENT_GPU	16
+#define CLIENT_CAMERA	27
+#define CLIENT_THERMAL	31
+#define CLIENT_NVPMODEL	48
+
+enum req_type {
+	SET_EMC_FLOOR,
+	SET_EMC_CAP,
+	SET_EMC_ISO_CAP,
+	SET_EMC_SHARED_BW,
+	SET_EMC_SHARED_BW_ISO,
+	SET_EMC_REQ_COUNT
+};
+
+static const char * const req_names[] = {
+	"TEGRA_BWMGR_SET_EMC_FLOOR",
+	"TEGRA_BWMGR_SET_EMC_CAP",
+	"TEGRA_BWMGR_SET_EMC_ISO_CAP",
+	"TEGRA_BWMGR_SET_EMC_SHARED_BW",
+	"TEGRA_BWMGR_SET_EMC_SHARED_BW_ISO",
+};
+
+struct request {
+	int64_t time_us;
+	int client;
+	enum req_type req;
+	unsigned long val;
+};
+
+struct client {
+	unsigned long bw;
+	unsigned long iso_bw;
+	unsigned long cap;
+	unsigned long iso_cap;
+	unsigned long floor;
+};
+
+struct agg {
+	uint64_t bw;
+	uint64_t iso_bw_nvdis;
+	uint64_t iso_bw_vi;
+	uint64_t iso_bw_other;
+	unsigned long non_iso_cap;
+	unsigned long iso_cap;
+	unsigned long floor;
+	bool dirty;
+};
+
+struct bwmgr {
+	struct client clients[64];
+	struct agg agg;
+	/* last request programmed into emc_clk */
+	bool clk_valid;
+	unsigned long cap_req;
+	unsigned long rate_req;
+	/* pending coalesce work, 0 if none */
+	int64_t work_at;
+};
+
+struct stats {
+	unsigned long requests;
+	unsigned long unchanged;
+	unsigned long rescans;
+	unsigned long clk_updates;
+	unsigned long clk_calls;
+	unsigned long clk_skipped;
+	unsigned long deferred;
+	unsigned long coalesced;
+	unsigned long mismatches;
+	unsigned long underruns;
+	double excess;
+	double ns;
+};
+
+static unsigned long emc_max_rate = 2133000000UL;
+static unsigned int dram_eff = 70;
+static unsigned int iso_eff = 50;
+static unsigned int coalesce_us = 1000;
+
+static unsigned long min_ul(unsigned long a, unsigned long b)
+{
+	return a < b ? a : b;
+}
+
+static unsigned long max_ul(unsigned long a, unsigned long b)
+{
+	return a > b ? a : b;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* t21x_bwmgr_apply_efficiency() with fixed efficiencies */
+static unsigned long apply_efficiency(unsigned long total_bw,
+				      unsigned long iso_bw,
+				      unsigned long *iso_bw_min)
+{
+	if (total_bw && dram_eff && dram_eff < 100) {
+		total_bw = total_bw / dram_eff;
+		total_bw = (total_bw < emc_max_rate / 100) ?
+			(total_bw * 100) : emc_max_rate;
+	}
+
+	if (iso_bw && iso_eff && iso_eff < 100) {
+		iso_bw /= iso_eff;
+		iso_bw = (iso_bw < emc_max_rate / 100) ?
+			(iso_bw * 100) : emc_max_rate;
+	}
+
+	*iso_bw_min = iso_bw;
+
+	return max_ul(total_bw, iso_bw);
+}
+
+static uint64_t *iso_bucket(struct agg *a, int i)
+{
+	if (i == CLIENT_DISP0 || i == CLIENT_DISP1 || i == CLIENT_DISP2)
+		return &a->iso_bw_nvdis;
+	else if (i == CLIENT_CAMERA)
+		return &a->iso_bw_vi;
+
+	return &a->iso_bw_other;
+}
+
+static void agg_rescan(struct bwmgr *b, struct agg *a)
+{
+	struct client *c;
+	int i;
+
+	memset(a, 0, sizeof(*a));
+	a->non_iso_cap = emc_max_rate;
+	a->iso_cap = emc_max_rate;
+
+	for (i = 0; i < CLIENT_COUNT; i++) {
+		c = b->clients + i;
+
+		a->bw += min_ul(c->bw, emc_max_rate);
+		if (c->iso_bw > 0)
+			*iso_bucket(a, i) += min_ul(c->iso_bw, emc_max_rate);
+
+		a->non_iso_cap = min_ul(a->non_iso_cap, c->cap);
+		a->iso_cap = min_ul(a->iso_cap, c->iso_cap);
+		a->floor = max_ul(a->floor, c->floor);
+	}
+}
+
+/* rate and cap the aggregates ask for */
+static unsigned long agg_rate(const struct agg *a, unsigned long *cap_req)
+{
+	unsigned long bw, iso_bw, nvdis, vi, other, iso_bw_min, floor;
+
+	bw = min_ul(a->bw, emc_max_rate);
+	nvdis = min_ul(a->iso_bw_nvdis, emc_max_rate);
+	vi = min_ul(a->iso_bw_vi, emc_max_rate);
+	other = min_ul(a->iso_bw_other, emc_max_rate);
+	iso_bw = min_ul(nvdis + vi + other, emc_max_rate);
+	*cap_req = min_ul(a->iso_cap, a->non_iso_cap);
+
+	bw += iso_bw;
+	bw = apply_efficiency(bw, iso_bw, &iso_bw_min);
+	floor = min_ul(a->floor, emc_max_rate);
+	bw = max_ul(bw, floor);
+	bw = min_ul(bw, min_ul(a->iso_cap, max_ul(a->non_iso_cap, iso_bw_min)));
+
+	return bw;
+}
+
+static void apply_clk(struct bwmgr *b, struct stats *s,
+		      unsigned long cap_req, unsigned long rate)
+{
+	bool cap_changed = !b->clk_valid || cap_req != b->cap_req;
+
+	if (!cap_changed && rate == b->rate_req) {
+		s->clk_skipped++;
+		return;
+	}
+
+	s->clk_updates++;
+	s->clk_calls += cap_changed ? 3 : 1;
+
+	b->cap_req = cap_req;
+	b->rate_req = rate;
+	b->clk_valid = true;
+}
+
+static void update_clk(struct bwmgr *b, struct stats *s, int64_t now,
+		       bool sync)
+{
+	unsigned long cap_req, rate;
+
+	if (b->agg.dirty) {
+		agg_rescan(b, &b->agg);
+		s->rescans++;
+	}
+
+	rate = agg_rate(&b->agg, &cap_req);
+
+	if (!sync && coalesce_us && b->clk_valid &&
+	    cap_req >= b->cap_req && rate <= b->rate_req &&
+	    (cap_req != b->cap_req || rate != b->rate_req)) {
+		if (!b->work_at) {
+			b->work_at = now + coalesce_us;
+			s->deferred++;
+		} else {
+			s->coalesced++;
+		}
+		return;
+	}
+
+	apply_clk(b, s, cap_req, rate);
+}
+
+/* tegra_bwmgr_set_emc() after the request has been validated */
+static void set_emc(struct bwmgr *b, struct stats *s, const struct request *r,
+		    bool incremental)
+{
+	struct client *c = b->clients + r->client;
+	struct agg *a = &b->agg;
+	unsigned long val = r->val;
+	bool update = false;
+	uint64_t *bucket;
+
+	switch (r->req) {
+	case SET_EMC_FLOOR:
+		if (c->floor != val) {
+			if (val >= a->floor)
+				a->floor = val;
+			else if (c->floor == a->floor)
+				a->dirty = true;
+			c->floor = val;
+			update = true;
+		}
+		break;
+	case SET_EMC_CAP:
+		if (val == 0)
+			val = emc_max_rate;
+		if (c->cap != val) {
+			if (val <= a->non_iso_cap)
+				a->non_iso_cap = val;
+			else if (c->cap == a->non_iso_cap)
+				a->dirty = true;
+			c->cap = val;
+			update = true;
+		}
+		break;
+	case SET_EMC_ISO_CAP:
+		if (val == 0)
+			val = emc_max_rate;
+		if (c->iso_cap != val) {
+			if (val <= a->iso_cap)
+				a->iso_cap = val;
+			else if (c->iso_cap == a->iso_cap)
+				a->dirty = true;
+			c->iso_cap = val;
+			update = true;
+		}
+		break;
+	case SET_EMC_SHARED_BW:
+		if (c->bw != val) {
+			a->bw -= min_ul(c->bw, emc_max_rate);
+			a->bw += min_ul(val, emc_max_rate);
+			c->bw = val;
+			update = true;
+		}
+		break;
+	case SET_EMC_SHARED_BW_ISO:
+		if (c->iso_bw != val) {
+			bucket = iso_bucket(a, r->client);
+			*bucket -= min_ul(c->iso_bw, emc_max_rate);
+			*bucket += min_ul(val, emc_max_rate);
+			c->iso_bw = val;
+			update = true;
+		}
+		break;
+	default:
+		return;
+	}
+
+	s->requests++;
+	if (!update) {
+		s->unchanged++;
+		return;
+	}
+
+	if (incremental) {
+		update_clk(b, s, r->time_us, false);
+		return;
+	}
+
+	/* full rescan and three clock calls per changed request */
+	b->agg.dirty = true;
+	s->rescans++;
+	agg_rescan(b, &b->agg);
+	s->clk_updates++;
+	s->clk_calls += 3;
+	b->rate_req = agg_rate(&b->agg, &b->cap_req);
+	b->clk_valid = true;
+}
+
+static void init_bwmgr(struct bwmgr *b)
+{
+	int i;
+
+	memset(b, 0, sizeof(*b));
+	for (i = 0; i < CLIENT_COUNT; i++) {
+		b->clients[i].cap = emc_max_rate;
+		b->clients[i].iso_cap = emc_max_rate;
+	}
+	agg_rescan(b, &b->agg);
+}
+
+/* run the coalesce work if it is due by 'now' */
+static void run_work(struct bwmgr *b, struct stats *s, int64_t now)
+{
+	int64_t at = b->work_at;
+
+	if (!at || at > now)
+		return;
+
+	b->work_at = 0;
+	update_clk(b, s, at, true);
+}
+
+static void replay(const struct request *reqs, unsigned long nreqs,
+		   bool incremental, struct stats *s)
+{
+	struct bwmgr b, ref;
+	unsigned long i, cap, want;
+	int64_t t;
+	struct agg check;
+	double start;
+
+	memset(s, 0, sizeof(*s));
+	init_bwmgr(&b);
+	init_bwmgr(&ref);
+
+	start = now_ns();
+	for (i = 0; i < nreqs; i++) {
+		if (incremental)
+			run_work(&b, s, reqs[i].time_us);
+		set_emc(&b, s, reqs + i, incremental);
+	}
+	if (incremental)
+		run_work(&b, s, INT64_MAX);
+	s->ns = now_ns() - start;
+
+	/* second pass: check the rate in effect against a full rescan */
+	init_bwmgr(&b);
+	for (i = 0; i < nreqs; i++) {
+		struct stats tmp;
+
+		t = reqs[i].time_us;
+		memset(&tmp, 0, sizeof(tmp));
+		if (incremental)
+			run_work(&b, &tmp, t);
+		set_emc(&b, &tmp, reqs + i, incremental);
+
+		memcpy(ref.clients, b.clients, sizeof(ref.clients));
+		agg_rescan(&ref, &check);
+		want = agg_rate(&check, &cap);
+
+		if (!b.agg.dirty &&
+		    (check.bw != b.agg.bw ||
+		     check.iso_bw_nvdis != b.agg.iso_bw_nvdis ||
+		     check.iso_bw_vi != b.agg.iso_bw_vi ||
+		     check.iso_bw_other != b.agg.iso_bw_other ||
+		     check.non_iso_cap != b.agg.non_iso_cap ||
+		     check.iso_cap != b.agg.iso_cap ||
+		     check.floor != b.agg.floor))
+			s->mismatches++;
+
+		/* the rate must be met or exceeded, and the cap never loose */
+		if (b.rate_req < want || b.cap_req > cap)
+			s->underruns++;
+		if (b.rate_req > want && i + 1 < nreqs)
+			s->excess += (double)(b.rate_req - want) / 1e6 *
+				     (reqs[i + 1].time_us - t);
+	}
+}
+
+static void report(const char *name, const struct stats *s,
+		   unsigned long nreqs)
+{
+	fprintf(stdout, "%-12s %8lu %8lu %8lu %8lu %8lu %8lu %8lu %8.0f\n",
+		name, s->unchanged, s->rescans, s->clk_updates, s->clk_calls,
+		s->clk_skipped, s->deferred, s->coalesced,
+		nreqs ? s->ns / nreqs : 0);
+}
+
+static int parse_line(const char *line, struct request *r)
+{
+	const char *p, *ts;
+	char name[64], req[64];
+	double sec;
+	int i;
+
+	p = strstr(line, "tegra_bwmgr_set_emc:");
+	if (!p)
+		return -1;
+
+	/* "<task>-<pid> [cpu] <flags> <sec>.<usec>: tegra_bwmgr_set_emc:" */
+	ts = p - 2;
+	while (ts > line && ts[-1] != ' ')
+		ts--;
+	if (sscanf(ts, "%lf", &sec) != 1)
+		return -1;
+
+	if (sscanf(p, "tegra_bwmgr_set_emc: handle=%63[^,], val=%lu, req=%63s",
+		   name, &r->val, req) != 3)
+		return -1;
+
+	r->time_us = sec * 1e6;
+
+	for (i = 0; i < CLIENT_COUNT; i++)
+		if (!strcmp(name, client_names[i]))
+			break;
+	if (i == CLIENT_COUNT)
+		return -1;
+	r->client = i;
+
+	for (i = 0; i < SET_EMC_REQ_COUNT; i++)
+		if (!strcmp(req, req_names[i]))
+			break;
+	if (i == SET_EMC_REQ_COUNT)
+		return -1;
+	r->req = i;
+
+	return 0;
+}
+
+static struct request *load_trace(const char *path, unsigned long *nreqs)
+{
+	struct request *reqs = NULL, *tmp;
+	unsigned long n = 0, size = 0;
+	char line[512];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", path,
+			strerror(errno));
+		return NULL;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (n == size) {
+			size = size ? size * 2 : 1024;
+			tmp = realloc(reqs, size * sizeof(*reqs));
+			if (!tmp) {
+				free(reqs);
+				fclose(f);
+				return NULL;
+			}
+			reqs = tmp;
+		}
+		if (parse_line(line, reqs + n))
+			continue;
+		if (n && reqs[n].time_us < reqs[n - 1].time_us)
+			reqs[n].time_us = reqs[n - 1].time_us;
+		n++;
+	}
+
+	fclose(f);
+	*nreqs = n;
+	return reqs;
+}
+
+static struct request *gen_requests(unsigned long n, unsigned int seed)
+{
+	struct request *reqs;
+	unsigned long i;
+	int64_t t = 0;
+	int k;
+
+	reqs = calloc(n, sizeof(*reqs));
+	if (!reqs)
+		return NULL;
+
+	srand(seed);
+	for (i = 0; i < n; i++) {
+		struct request *r = reqs + i;
+
+		t += 50 + rand() % 400;
+		r->time_us = t;
+		k = rand() % 100;
+		if (k < 45) {
+			/* CPU clusters follow their frequency */
+			r->client = CLIENT_CPU0 + rand() % 4;
+			r->req = SET_EMC_SHARED_BW;
+			r->val = (rand() % 16) * 20000000UL;
+		} else if (k < 80) {
+			r->client = CLIENT_GPU;
+			r->req = SET_EMC_SHARED_BW;
+			r->val = (rand() % 12) * 60000000UL;
+		} else if (k < 90) {
+			r->client = CLIENT_DISP0 + rand() % 3;
+			r->req = SET_EMC_SHARED_BW_ISO;
+			r->val = (rand() % 4) * 100000000UL;
+		} else if (k < 95) {
+			r->client = CLIENT_CAMERA;
+			r->req = SET_EMC_SHARED_BW_ISO;
+			r->val = (rand() % 3) * 150000000UL;
+		} else if (k < 98) {
+			r->client = CLIENT_NVPMODEL;
+			r->req = SET_EMC_FLOOR;
+			r->val = (rand() % 4) * 400000000UL;
+		} else {
+			r->client = CLIENT_THERMAL;
+			r->req = SET_EMC_CAP;
+			r->val = rand() % 2 ? 0 : 1600000000UL;
+		}
+	}
+
+	return reqs;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: bwmgr_replay [options]...\n"
+		"Replay bwmgr requests through the old and new update paths\n"
+		"  -t <file>  ftrace output with tegra_bwmgr_set_emc events\n"
+		"  -n <n>     Synthetic requests (default: 100000)\n"
+		"  -S <n>     Synthetic seed (default: 1)\n"
+		"  -c <us>    coalesce_us, 0 disables (default: 1000)\n"
+		"  -M <Hz>    EMC max rate (default: 2133000000)\n"
+		"  -e <n>     DRAM efficiency percent (default: 70)\n"
+		"  -i <n>     ISO efficiency percent (default: 50)\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"bwmgr_replay -n 200000\n"
+		"bwmgr_replay -t bwmgr.txt -c 1000\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace = NULL;
+	unsigned long n = 100000, nreqs = 0;
+	unsigned int seed = 1;
+	struct stats old, inc;
+	struct request *reqs;
+	int c;
+
+	while ((c = getopt(argc, argv, "t:n:S:c:M:e:i:?")) != -1) {
+		switch (c) {
+		case 't':
+			trace = optarg;
+			break;
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			coalesce_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'M':
+			emc_max_rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			dram_eff = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iso_eff = strtoul(optarg, NULL, 0);
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (!emc_max_rate || dram_eff > 100 || iso_eff > 100) {
+		fprintf(stderr, "Bad max rate or efficiency\n");
+		return -1;
+	}
+
+	if (trace)
+		reqs = load_trace(trace, &nreqs);
+	else {
+		reqs = gen_requests(n, seed);
+		nreqs = n;
+	}
+	if (!reqs)
+		return -1;
+	if (!nreqs) {
+		fprintf(stderr, "No tegra_bwmgr_set_emc events\n");
+		free(reqs);
+		return -1;
+	}
+
+	replay(reqs, nreqs, false, &old);
+	replay(reqs, nreqs, true, &inc);
+
+	fprintf(stdout, "%lu requests over %.3f s, coalesce %u us\n", nreqs,
+		(reqs[nreqs - 1].time_us - reqs[0].time_us) / 1e6,
+		coalesce_us);
+	fprintf(stdout, "%-12s %8s %8s %8s %8s %8s %8s %8s %8s\n", "path",
+		"unchgd", "rescans", "updates", "clkcalls", "skipped",
+		"deferred", "merged", "ns/req");
+	report("full rescan", &old, nreqs);
+	report("incremental", &inc, nreqs);
+	fprintf(stdout,
+		"aggregate mismatches %lu, rate or cap not met %lu, "
+		"excess from deferral %.1f MHz*s\n",
+		inc.mismatches, inc.underruns, inc.excess / 1e6);
+
+	free(reqs);
+
+	return inc.mismatches || inc.underruns || old.underruns ? 1 : 0;
+}
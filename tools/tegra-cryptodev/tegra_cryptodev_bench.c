@@ -0,0 +1,500 @@
+/*
+ * tegra_cryptodev_bench - compare AES and SHA throughput of /dev/tegra-crypto
+ * through the per-operation ioctls and through the asynchronous submission
+ * ring.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * The ioctl path issues one blocking TEGRA_CRYPTO_IOCTL_PROCESS_REQ or
+ * TEGRA_CRYPTO_IOCTL_GET_SHA per operation. The ring path registers the
+ * source and destination buffers once, keeps up to <depth> operations in
+ * flight and reaps completions with poll(). With -c, the output of the
+ * first operation of both paths is compared.
+ *
+ * Build:
+ *	cc -O2 -I../../include/uapi -o tegra_cryptodev_bench tegra_cryptodev_bench.c
+ *
+ * Example Usage:
+ *	tegra_cryptodev_bench -a aes -m cbc -l 4096 -n 100000 -q 32
+ *	tegra_cryptodev_bench -a sha -s sha256 -l 65536 -n 10000 -p ring
+ *	tegra_cryptodev_bench -a aes -m ctr -l 512 -n 1000 -c
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+
+/* the uapi header is used as is, outside of headers_install */
+#ifndef __user
+#define __user
+#endif
+#include <misc/tegra-cryptodev.h>
+
+#define CRYPTO_DEV	"/dev/tegra-crypto"
+
+enum bench_path {
+	PATH_IOCTL = 1 << 0,
+	PATH_RING = 1 << 1,
+};
+
+struct bench_cfg {
+	bool sha;
+	unsigned int mode;	/* TEGRA_CRYPTO_* or enum sha_algo */
+	unsigned int len;
+	unsigned long ops;
+	unsigned int depth;
+	unsigned int keylen;
+	bool check;
+};
+
+static const char * const aes_modes[TEGRA_CRYPTO_MAX] = {
+	"ecb", "cbc", "ofb", "ctr", "xts",
+};
+
+static const struct {
+	const char *name;
+	unsigned int digest;
+} sha_algs[] = {
+	[SHA1] = { "sha1", 20 },
+	[SHA224] = { "sha224", 28 },
+	[SHA256] = { "sha256", 32 },
+	[SHA384] = { "sha384", 48 },
+	[SHA512] = { "sha512", 64 },
+};
+
+static double elapsed_s(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) +
+		(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void report(const char *path, const struct bench_cfg *cfg,
+		   unsigned long ops, double t)
+{
+	fprintf(stdout, "%-5s: %lu ops of %u bytes in %.3f s, %.0f ops/s, %.1f MB/s\n",
+		path, ops, cfg->len, t, ops / t, ops * (double)cfg->len / t / 1e6);
+}
+
+static void fill_key(unsigned char *key, unsigned char *iv)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_CRYPTO_MAX_KEY_SIZE; i++)
+		key[i] = 0x10 + i;
+	for (i = 0; i < TEGRA_CRYPTO_IV_SIZE; i++)
+		iv[i] = 0xa0 + i;
+}
+
+static int run_ioctl(int fd, const struct bench_cfg *cfg,
+		     unsigned char *src, unsigned char *dst)
+{
+	struct tegra_crypt_req creq;
+	struct tegra_sha_req sreq;
+	struct timespec start;
+	unsigned long i;
+
+	memset(&creq, 0, sizeof(creq));
+	memset(&sreq, 0, sizeof(sreq));
+
+	if (cfg->sha) {
+		sreq.algo = sha_algs[cfg->mode].name;
+		sreq.plaintext = src;
+		sreq.result = dst;
+		sreq.plaintext_sz = cfg->len;
+	} else {
+		creq.op = cfg->mode;
+		creq.encrypt = true;
+		creq.keylen = cfg->keylen;
+		creq.ivlen = TEGRA_CRYPTO_IV_SIZE;
+		fill_key((unsigned char *)creq.key, (unsigned char *)creq.iv);
+		creq.plaintext = src;
+		creq.result = dst;
+		creq.plaintext_sz = cfg->len;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < cfg->ops; i++) {
+		int ret;
+
+		if (cfg->sha) {
+			ret = ioctl(fd, TEGRA_CRYPTO_IOCTL_GET_SHA, &sreq);
+		} else {
+			/*
+			 * the ring carries key and IV in every entry, so set
+			 * them for every op here too; keep the tfm until the
+			 * last op
+			 */
+			creq.skip_key = false;
+			creq.skip_iv = false;
+			creq.skip_exit = i + 1 < cfg->ops;
+			ret = ioctl(fd, TEGRA_CRYPTO_IOCTL_PROCESS_REQ, &creq);
+		}
+		if (ret) {
+			fprintf(stderr, "ioctl op %lu failed: %s\n", i,
+				strerror(errno));
+			return -1;
+		}
+	}
+	report("ioctl", cfg, cfg->ops, elapsed_s(&start));
+
+	return 0;
+}
+
+struct ring {
+	struct tegra_crypto_ring_hdr *hdr;
+	struct tegra_crypto_sqe *sqes;
+	struct tegra_crypto_cqe *cqes;
+	void *map;
+	size_t map_size;
+};
+
+static int ring_setup(int fd, struct ring *r, unsigned int entries)
+{
+	struct tegra_crypto_ring_setup setup;
+
+	memset(&setup, 0, sizeof(setup));
+	setup.entries = entries;
+	setup.eventfd = -1;
+	if (ioctl(fd, TEGRA_CRYPTO_IOCTL_RING_SETUP, &setup)) {
+		fprintf(stderr, "RING_SETUP failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	r->map_size = setup.ring_size;
+	r->map = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		      fd, 0);
+	if (r->map == MAP_FAILED) {
+		fprintf(stderr, "mmap of the ring failed: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	r->hdr = r->map;
+	r->sqes = (void *)((char *)r->map + setup.sq_off);
+	r->cqes = (void *)((char *)r->map + setup.cq_off);
+
+	return 0;
+}
+
+static int buf_register(int fd, void *addr, size_t len, uint32_t *index)
+{
+	struct tegra_crypto_buf_reg reg;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.addr = (uintptr_t)addr;
+	reg.len = len;
+	if (ioctl(fd, TEGRA_CRYPTO_IOCTL_BUF_REGISTER, &reg)) {
+		fprintf(stderr, "BUF_REGISTER failed: %s\n", strerror(errno));
+		return -1;
+	}
+	*index = reg.index;
+
+	return 0;
+}
+
+static void ring_fill_sqe(const struct bench_cfg *cfg,
+			  struct tegra_crypto_sqe *sqe, unsigned long id,
+			  uint32_t src_idx, uint32_t dst_idx,
+			  unsigned int slot, unsigned int out_len)
+{
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = id;
+	sqe->opcode = cfg->sha ? TEGRA_CRYPTO_RING_OP_SHA :
+		TEGRA_CRYPTO_RING_OP_AES_ENCRYPT;
+	sqe->mode = cfg->mode;
+	sqe->len = cfg->len;
+	sqe->src_buf = src_idx;
+	sqe->src_off = 0;
+	sqe->dst_buf = dst_idx;
+	/* each in-flight op writes its own part of the destination */
+	sqe->dst_off = slot * out_len;
+	if (!cfg->sha) {
+		sqe->keylen = cfg->keylen;
+		fill_key(sqe->key, sqe->iv);
+	}
+}
+
+static int run_ring(int fd, const struct bench_cfg *cfg,
+		    unsigned char *src, unsigned char *dst)
+{
+	unsigned int out_len = cfg->sha ? sha_algs[cfg->mode].digest : cfg->len;
+	unsigned long submitted = 0, completed = 0;
+	unsigned int entries = 1, inflight = 0;
+	uint32_t src_idx = ~0U, dst_idx = ~0U;
+	unsigned int *free_slots, nfree, i;
+	struct timespec start;
+	struct ring r;
+	int ret = -1;
+
+	while (entries < cfg->depth)
+		entries <<= 1;
+
+	if (ring_setup(fd, &r, entries))
+		return -1;
+	if (buf_register(fd, src, cfg->len, &src_idx) ||
+	    buf_register(fd, dst, (size_t)out_len * cfg->depth, &dst_idx))
+		goto unmap;
+
+	free_slots = calloc(cfg->depth, sizeof(*free_slots));
+	if (!free_slots)
+		goto unmap;
+	for (nfree = 0; nfree < cfg->depth; nfree++)
+		free_slots[nfree] = cfg->depth - 1 - nfree;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (completed < cfg->ops) {
+		uint32_t tail = r.hdr->sq_tail;
+		unsigned int queued = 0;
+		uint32_t cq_head, cq_tail;
+
+		/* top up to <depth> in flight */
+		while (inflight < cfg->depth && submitted < cfg->ops) {
+			unsigned int slot = free_slots[--nfree];
+
+			/* user_data carries the op number and its slot */
+			ring_fill_sqe(cfg,
+				&r.sqes[(tail + queued) & (r.hdr->sq_entries - 1)],
+				(submitted << 16) | slot, src_idx, dst_idx,
+				slot, out_len);
+			queued++;
+			submitted++;
+			inflight++;
+		}
+
+		if (queued) {
+			int n;
+
+			__atomic_store_n(&r.hdr->sq_tail, tail + queued,
+					 __ATOMIC_RELEASE);
+			n = ioctl(fd, TEGRA_CRYPTO_IOCTL_RING_ENTER, queued);
+			if (n < 0) {
+				fprintf(stderr, "RING_ENTER failed: %s\n",
+					strerror(errno));
+				goto free;
+			}
+		}
+
+		cq_tail = __atomic_load_n(&r.hdr->cq_tail, __ATOMIC_ACQUIRE);
+		cq_head = r.hdr->cq_head;
+		if (cq_head == cq_tail) {
+			struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+			if (poll(&pfd, 1, 1000) <= 0) {
+				fprintf(stderr, "No completion within 1 s\n");
+				goto free;
+			}
+			continue;
+		}
+
+		for (; cq_head != cq_tail; cq_head++) {
+			struct tegra_crypto_cqe *cqe =
+				&r.cqes[cq_head & (r.hdr->cq_entries - 1)];
+
+			if (cqe->result) {
+				fprintf(stderr, "op %llu failed: %d\n",
+					(unsigned long long)(cqe->user_data >> 16),
+					cqe->result);
+				goto free;
+			}
+			free_slots[nfree++] = cqe->user_data & 0xffff;
+			inflight--;
+			completed++;
+		}
+		__atomic_store_n(&r.hdr->cq_head, cq_head, __ATOMIC_RELEASE);
+	}
+	report("ring", cfg, completed, elapsed_s(&start));
+
+	if (r.hdr->cq_overflow)
+		fprintf(stdout, "ring: %u CQ overflows\n", r.hdr->cq_overflow);
+	ret = 0;
+
+free:
+	free(free_slots);
+unmap:
+	munmap(r.map, r.map_size);
+	for (i = 0; i < 2; i++) {
+		struct tegra_crypto_buf_reg reg = { .index = i ? dst_idx :
+						    src_idx };
+
+		if (reg.index != ~0U)
+			ioctl(fd, TEGRA_CRYPTO_IOCTL_BUF_UNREGISTER, &reg);
+	}
+	return ret;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: tegra_cryptodev_bench [options]...\n"
+		"Compare ioctl and ring throughput of %s\n"
+		"  -a <alg>   aes or sha (default: aes)\n"
+		"  -m <mode>  AES mode: ecb, cbc, ofb, ctr, xts (default: cbc)\n"
+		"  -s <alg>   SHA: sha1, sha224, sha256, sha384, sha512\n"
+		"             (default: sha256)\n"
+		"  -k <n>     AES key length in bytes (default: 16)\n"
+		"  -l <n>     Bytes per operation (default: 4096)\n"
+		"  -n <n>     Operations per path (default: 10000)\n"
+		"  -q <n>     Ring operations in flight (default: 32)\n"
+		"  -p <path>  ioctl, ring or both (default: both)\n"
+		"  -c         Compare the first output of both paths\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"tegra_cryptodev_bench -a aes -m cbc -l 4096 -n 100000 -q 32\n",
+		CRYPTO_DEV);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_cfg cfg = {
+		.mode = TEGRA_CRYPTO_CBC,
+		.len = 4096,
+		.ops = 10000,
+		.depth = 32,
+		.keylen = TEGRA_CRYPTO_KEY_128_SIZE,
+	};
+	const char *sha_name = "sha256";
+	const char *mode_name = "cbc";
+	unsigned int paths = PATH_IOCTL | PATH_RING;
+	unsigned char *src, *dst_ioctl, *dst_ring;
+	size_t out_len;
+	int fd, c, ret = 0;
+	unsigned int i;
+
+	while ((c = getopt(argc, argv, "a:m:s:k:l:n:q:p:c?")) != -1) {
+		switch (c) {
+		case 'a':
+			if (!strcmp(optarg, "sha"))
+				cfg.sha = true;
+			else if (strcmp(optarg, "aes")) {
+				print_usage();
+				return -1;
+			}
+			break;
+		case 'm':
+			mode_name = optarg;
+			break;
+		case 's':
+			sha_name = optarg;
+			break;
+		case 'k':
+			cfg.keylen = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			cfg.len = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			cfg.ops = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			cfg.depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			if (!strcmp(optarg, "ioctl"))
+				paths = PATH_IOCTL;
+			else if (!strcmp(optarg, "ring"))
+				paths = PATH_RING;
+			else if (strcmp(optarg, "both")) {
+				print_usage();
+				return -1;
+			}
+			break;
+		case 'c':
+			cfg.check = true;
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (cfg.sha) {
+		for (i = 0; i < sizeof(sha_algs) / sizeof(sha_algs[0]); i++)
+			if (sha_algs[i].name && !strcmp(sha_algs[i].name,
+							sha_name))
+				break;
+		if (i == sizeof(sha_algs) / sizeof(sha_algs[0])) {
+			fprintf(stderr, "Unknown SHA %s\n", sha_name);
+			return -1;
+		}
+		cfg.mode = i;
+		out_len = sha_algs[i].digest;
+	} else {
+		for (i = 0; i < TEGRA_CRYPTO_MAX; i++)
+			if (!strcmp(aes_modes[i], mode_name))
+				break;
+		if (i == TEGRA_CRYPTO_MAX) {
+			fprintf(stderr, "Unknown AES mode %s\n", mode_name);
+			return -1;
+		}
+		cfg.mode = i;
+		out_len = cfg.len;
+		if (cfg.len % AES_BLOCK_SIZE) {
+			fprintf(stderr, "AES length must be a multiple of %d\n",
+				AES_BLOCK_SIZE);
+			return -1;
+		}
+	}
+
+	if (!cfg.len || !cfg.ops || !cfg.depth ||
+	    cfg.depth > TEGRA_CRYPTO_RING_MAX_ENTRIES) {
+		fprintf(stderr, "Invalid length, count or depth\n");
+		return -1;
+	}
+
+	src = malloc(cfg.len);
+	dst_ioctl = calloc(1, out_len);
+	dst_ring = calloc(cfg.depth, out_len);
+	if (!src || !dst_ioctl || !dst_ring) {
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+	for (i = 0; i < cfg.len; i++)
+		src[i] = i * 7;
+
+	fd = open(CRYPTO_DEV, O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", CRYPTO_DEV,
+			strerror(errno));
+		return -1;
+	}
+
+	if (paths & PATH_IOCTL)
+		ret = run_ioctl(fd, &cfg, src, dst_ioctl);
+	if (!ret && (paths & PATH_RING))
+		ret = run_ring(fd, &cfg, src, dst_ring);
+
+	/* every op uses the same input, key and IV, so any slot will do */
+	if (!ret && cfg.check && paths == (PATH_IOCTL | PATH_RING)) {
+		if (memcmp(dst_ioctl, dst_ring, out_len)) {
+			fprintf(stderr, "ioctl and ring outputs differ\n");
+			ret = -1;
+		} else {
+			fprintf(stdout, "ioctl and ring outputs match\n");
+		}
+	}
+
+	close(fd);
+	free(src);
+	free(dst_ioctl);
+	free(dst_ring);
+	return ret;
+}
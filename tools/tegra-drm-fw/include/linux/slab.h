@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Minimal user-space stand-in for <linux/slab.h>, enough to build
+ * drivers/gpu/drm/tegra/firewall.c into tegra_drm_fw_bench.
+ */
+
+#ifndef _TOOLS_LINUX_SLAB_H
+#define _TOOLS_LINUX_SLAB_H
+
+#include <stdlib.h>
+
+#define GFP_KERNEL	0
+
+#define kcalloc(n, size, gfp)	calloc((n), (size))
+#define kfree(ptr)		free(ptr)
+
+#endif
@@ -0,0 +1,526 @@
+/*
+ * tegra_drm_fw_bench - run the Tegra DRM command stream firewall in user
+ * space, either over captured command streams or over generated ones, to
+ * benchmark it and to fuzz the precomputed address register bitmaps against
+ * the client's is_addr_reg() callback.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * drivers/gpu/drm/tegra/firewall.c is built in as is. The stand-in client
+ * has the GR2D address register layout, so captured GR2D streams validate
+ * the same way they do in the kernel.
+ *
+ * Build:
+ *	cc -O2 -Iinclude -o tegra_drm_fw_bench tegra_drm_fw_bench.c
+ *
+ * Example Usage:
+ *	tegra_drm_fw_bench -f stream.bin -c 0x51 -m 0x10000000:0x1000000 -n 1000
+ *	tegra_drm_fw_bench -g 65536 -n 1000
+ *	tegra_drm_fw_bench -z 1 -n 100000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <linux/bitmap.h>
+#include <linux/slab.h>
+
+/* The driver headers pull in the kernel, provide what firewall.c uses */
+#define HOST1X_DRM_H
+#define _TEGRA_DRM_UAPI_SUBMIT_H
+#define _TEGRA_DRM_UAPI_H
+
+#define HOST1X_CLASS_HOST1X	0x01
+#define HOST1X_CLASS_GR2D	0x51
+#define HOST1X_CLASS_GR2D_SB	0x52
+
+static bool verbose;
+
+#define dev_warn(dev, fmt, ...) \
+	do { \
+		if (verbose) \
+			fprintf(stderr, fmt "\n", ##__VA_ARGS__); \
+	} while (0)
+
+struct device {
+	const char *name;
+};
+
+struct host1x_client {
+	struct device *dev;
+	u32 class;
+};
+
+struct tegra_drm_client;
+
+struct tegra_drm_client_ops {
+	int (*is_addr_reg)(struct device *dev, u32 class, u32 offset);
+	int (*is_valid_class)(u32 class);
+};
+
+struct tegra_drm_fw_class;
+
+struct tegra_drm_client {
+	struct host1x_client base;
+	const struct tegra_drm_client_ops *ops;
+	struct tegra_drm_fw_class *fw_classes;
+	unsigned int num_fw_classes;
+};
+
+struct tegra_drm_mapping {
+	dma_addr_t iova;
+	dma_addr_t iova_end;
+};
+
+struct tegra_drm_used_mapping {
+	struct tegra_drm_mapping *mapping;
+	u32 flags;
+};
+
+struct tegra_drm_submit_data {
+	struct tegra_drm_used_mapping *used_mappings;
+	u32 num_used_mappings;
+};
+
+#include "../../drivers/gpu/drm/tegra/firewall.c"
+
+/* GR2D address registers, see drivers/gpu/drm/tegra/gr2d.[ch] */
+static const u32 gr2d_addr_regs[] = {
+	0x1a, 0x1b, 0x26, 0x2b, 0x2c, 0x2d, 0x31, 0x32,
+	0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c,
+};
+#define GR2D_NUM_REGS	0x4d
+
+static unsigned long is_addr_reg_calls;
+
+static int stub_is_addr_reg(struct device *dev, u32 class, u32 offset)
+{
+	unsigned int i;
+
+	is_addr_reg_calls++;
+
+	switch (class) {
+	case HOST1X_CLASS_HOST1X:
+		return offset == 0x2b;
+	case HOST1X_CLASS_GR2D:
+	case HOST1X_CLASS_GR2D_SB:
+		if (offset >= GR2D_NUM_REGS)
+			return 0;
+		for (i = 0; i < sizeof(gr2d_addr_regs) /
+		     sizeof(gr2d_addr_regs[0]); i++)
+			if (gr2d_addr_regs[i] == offset)
+				return 1;
+		return 0;
+	}
+
+	return 0;
+}
+
+static int stub_is_valid_class(u32 class)
+{
+	return class == HOST1X_CLASS_GR2D || class == HOST1X_CLASS_GR2D_SB;
+}
+
+static const struct tegra_drm_client_ops stub_ops = {
+	.is_addr_reg = stub_is_addr_reg,
+	.is_valid_class = stub_is_valid_class,
+};
+
+static struct device stub_dev = { .name = "gr2d-stub" };
+
+#define MAX_MAPPINGS	16
+
+static struct tegra_drm_mapping mappings[MAX_MAPPINGS];
+static struct tegra_drm_used_mapping used[MAX_MAPPINGS];
+static struct tegra_drm_submit_data submit = { .used_mappings = used };
+
+static int add_mapping(const char *arg)
+{
+	unsigned long long iova, size;
+	char *end;
+
+	if (submit.num_used_mappings == MAX_MAPPINGS)
+		return -ENOSPC;
+
+	iova = strtoull(arg, &end, 0);
+	if (*end != ':')
+		return -EINVAL;
+	size = strtoull(end + 1, NULL, 0);
+	if (size == 0)
+		return -EINVAL;
+
+	mappings[submit.num_used_mappings].iova = iova;
+	mappings[submit.num_used_mappings].iova_end = iova + size - 1;
+	used[submit.num_used_mappings].mapping =
+		&mappings[submit.num_used_mappings];
+	submit.num_used_mappings++;
+
+	return 0;
+}
+
+static uint64_t rng_state;
+
+static u32 rng(void)
+{
+	/* xorshift64* */
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (rng_state * 0x2545f4914f6cdd1dULL) >> 32;
+}
+
+static u32 gen_data(bool valid)
+{
+	const struct tegra_drm_mapping *m;
+
+	if (submit.num_used_mappings == 0 || (!valid && rng() % 4 == 0))
+		return rng();
+
+	m = &mappings[rng() % submit.num_used_mappings];
+	return m->iova + rng() % (m->iova_end - m->iova + 1);
+}
+
+static u32 gen_offset(bool wide)
+{
+	/* mostly around the GR2D register file, sometimes anywhere */
+	if (rng() % 8)
+		return rng() % 0x60;
+
+	return wide ? rng() & 0x3fffff : rng() & 0xfff;
+}
+
+/*
+ * Fill words[] with a command stream. A valid stream only uses valid
+ * classes, known opcodes and in-range data words, so the firewall accepts
+ * it. Otherwise, anything goes.
+ */
+static u32 gen_stream(u32 *words, u32 num, bool valid)
+{
+	u32 pos = 0, start, n, i, offset, mask, class, payload = 0;
+	bool payload_valid = false;
+
+	while (pos < num) {
+		u32 opcode = rng() % (valid ? 8 : 10);
+
+		start = pos;
+
+		switch (opcode) {
+		case 0:
+			/* SETCLASS */
+			class = rng() % 2 ? HOST1X_CLASS_GR2D :
+				HOST1X_CLASS_GR2D_SB;
+			if (!valid && rng() % 4 == 0)
+				class = rng() & 0x3ff;
+			mask = rng() & 0x3f;
+			offset = gen_offset(false);
+			words[pos++] = offset << 16 | class << 6 | mask;
+			n = __builtin_popcount(mask);
+			break;
+		case 1:
+		case 2:
+		case 3:
+			/* INCR, NONINCR */
+			n = rng() % 64;
+			offset = gen_offset(false);
+			words[pos++] = (opcode == 3 ? 0x2U : 0x1U) << 28 |
+				offset << 16 | n;
+			break;
+		case 4:
+			/* MASK */
+			mask = rng() & 0xffff;
+			offset = gen_offset(false);
+			words[pos++] = 0x3U << 28 | offset << 16 | mask;
+			n = __builtin_popcount(mask);
+			break;
+		case 5:
+			/* IMM, never on an address register in a valid one */
+			offset = gen_offset(false);
+			if (valid && stub_is_addr_reg(NULL,
+					HOST1X_CLASS_GR2D, offset))
+				offset = GR2D_NUM_REGS;
+			words[pos++] = 0x4U << 28 | offset << 16 |
+				(rng() & 0xffff);
+			n = 0;
+			break;
+		case 6:
+			/* SETPYLD */
+			payload = rng() % 64;
+			payload_valid = true;
+			words[pos++] = 0x9U << 28 | payload;
+			n = 0;
+			break;
+		case 7:
+			/* INCR_W, NONINCR_W */
+			if (!payload_valid) {
+				n = 0;
+				break;
+			}
+			offset = gen_offset(true);
+			words[pos++] = (rng() % 2 ? 0xaU : 0xbU) << 28 |
+				offset;
+			n = payload;
+			break;
+		default:
+			/* anything, including invalid opcodes */
+			words[pos++] = rng();
+			n = 0;
+			break;
+		}
+
+		/* a valid stream does not end in the middle of an opcode */
+		if (valid && n > num - pos)
+			return start;
+
+		for (i = 0; i < n && pos < num; i++)
+			words[pos++] = gen_data(valid);
+	}
+
+	return pos;
+}
+
+static int init_client(struct tegra_drm_client *client, bool bitmaps)
+{
+	client->base.dev = &stub_dev;
+	client->base.class = HOST1X_CLASS_GR2D;
+	client->ops = &stub_ops;
+	client->fw_classes = NULL;
+	client->num_fw_classes = 0;
+
+	/* without bitmaps every lookup goes through is_addr_reg() */
+	if (!bitmaps)
+		return 0;
+
+	return tegra_drm_fw_init(client);
+}
+
+static int validate(struct tegra_drm_client *client, u32 *words, u32 num,
+		    u32 class, u32 *job_class)
+{
+	*job_class = class;
+
+	return tegra_drm_fw_validate(client, words, 0, num, &submit,
+				     job_class);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench(struct tegra_drm_client *fast, struct tegra_drm_client *ref,
+		 u32 *words, u32 num, u32 class, unsigned long loops)
+{
+	struct tegra_drm_client *clients[] = { ref, fast };
+	const char *names[] = { "is_addr_reg", "bitmap" };
+	double t, rate[2];
+	unsigned long i, calls;
+	u32 job_class;
+	int c, ret[2];
+
+	for (c = 0; c < 2; c++) {
+		is_addr_reg_calls = 0;
+		t = now();
+		for (i = 0; i < loops; i++)
+			ret[c] = validate(clients[c], words, num, class,
+					  &job_class);
+		t = now() - t;
+		calls = is_addr_reg_calls;
+
+		rate[c] = t > 0 ? (double)num * loops / t : 0;
+		printf("%-12s: %s, %.1f Mwords/s, %.2f ns/word, "
+		       "%.1f is_addr_reg() calls/run\n", names[c],
+		       ret[c] ? "rejected" : "accepted", rate[c] / 1e6,
+		       rate[c] > 0 ? 1e9 / rate[c] : 0,
+		       (double)calls / loops);
+	}
+
+	if (rate[0] > 0)
+		printf("speedup     : %.2fx\n", rate[1] / rate[0]);
+
+	if (ret[0] != ret[1]) {
+		fprintf(stderr, "bitmap and is_addr_reg() disagree: %d vs %d\n",
+			ret[1], ret[0]);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int fuzz(struct tegra_drm_client *fast, struct tegra_drm_client *ref,
+		u32 *words, u32 max_words, unsigned long loops)
+{
+	unsigned long i, accepted = 0;
+	u32 num, class, fast_class, ref_class;
+	int fast_ret, ref_ret;
+
+	for (i = 0; i < loops; i++) {
+		num = gen_stream(words, 1 + rng() % max_words, rng() % 2);
+		class = rng() % 4 ? HOST1X_CLASS_GR2D : HOST1X_CLASS_HOST1X;
+
+		fast_ret = validate(fast, words, num, class, &fast_class);
+		ref_ret = validate(ref, words, num, class, &ref_class);
+
+		if (fast_ret != ref_ret || fast_class != ref_class) {
+			fprintf(stderr, "mismatch at iteration %lu: bitmap %d "
+				"class 0x%x, is_addr_reg() %d class 0x%x\n",
+				i, fast_ret, fast_class, ref_ret, ref_class);
+			return 1;
+		}
+		if (fast_ret == 0)
+			accepted++;
+	}
+
+	printf("%lu streams, %lu accepted, bitmap matches is_addr_reg()\n",
+	       loops, accepted);
+
+	return 0;
+}
+
+static u32 *load_stream(const char *path, u32 *num)
+{
+	struct stat st;
+	u32 *words;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror("Failed to open command stream");
+		return NULL;
+	}
+
+	if (fstat(fileno(f), &st) == -1 || st.st_size < 4 ||
+	    st.st_size % 4) {
+		fprintf(stderr, "Command stream must be a whole number of "
+			"32-bit words\n");
+		fclose(f);
+		return NULL;
+	}
+
+	*num = st.st_size / 4;
+	words = malloc(st.st_size);
+	if (words && fread(words, 4, *num, f) != *num) {
+		perror("Failed to read command stream");
+		free(words);
+		words = NULL;
+	}
+
+	fclose(f);
+	return words;
+}
+
+void print_usage(char *bin_name)
+{
+	fprintf(stderr, "Usage: %s [options]...\n"
+		"Benchmark or fuzz the Tegra DRM command stream firewall\n"
+		"  -f <path>     Validate a captured stream (raw 32-bit words)\n"
+		"  -g <words>    Validate a generated valid stream instead\n"
+		"  -z <seed>     Fuzz bitmaps against is_addr_reg() instead\n"
+		" [-c <class>]   Class the job starts in (default 0x51)\n"
+		" [-m <iova:size>] Mapped buffer, may be repeated\n"
+		"                (default 0x10000000:0x1000000)\n"
+		" [-n <n>]       Loops or fuzz iterations (default 1000)\n"
+		" [-v]           Print the firewall's rejection reasons\n"
+		"  -h            This helptext\n"
+		"\n"
+		"Example:\n"
+		"%s -z 1 -n 100000\n"
+		"(means check 100000 random streams give the same verdict "
+		"with and without bitmaps)\n",
+		bin_name, bin_name
+	);
+}
+
+int main(int argc, char **argv)
+{
+	struct tegra_drm_client fast, ref;
+	const char *path = NULL;
+	unsigned long loops = 1000;
+	u32 class = HOST1X_CLASS_GR2D;
+	u32 gen_words = 0, num = 0, *words;
+	bool do_fuzz = false;
+	int c, ret;
+
+	while ((c = getopt(argc, argv, "c:f:g:m:n:vz:h")) != -1) {
+		switch (c) {
+		case 'c':
+			class = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			path = optarg;
+			break;
+		case 'g':
+			gen_words = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			if (add_mapping(optarg)) {
+				fprintf(stderr, "Bad mapping %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'n':
+			loops = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		case 'z':
+			rng_state = strtoull(optarg, NULL, 0) | 1;
+			do_fuzz = true;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ((!!path + !!gen_words + do_fuzz) != 1 || loops == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (submit.num_used_mappings == 0)
+		add_mapping("0x10000000:0x1000000");
+
+	if (init_client(&fast, true) || init_client(&ref, false)) {
+		fprintf(stderr, "Failed to set up the stand-in client\n");
+		return 1;
+	}
+
+	if (do_fuzz) {
+		words = malloc(4096 * sizeof(*words));
+		if (!words)
+			return 1;
+		ret = fuzz(&fast, &ref, words, 4096, loops);
+	} else {
+		if (path) {
+			words = load_stream(path, &num);
+		} else {
+			if (!rng_state)
+				rng_state = 1;
+			words = malloc(gen_words * sizeof(*words));
+			if (words)
+				num = gen_stream(words, gen_words, true);
+		}
+		if (!words)
+			return 1;
+		ret = bench(&fast, &ref, words, num, class, loops);
+	}
+
+	free(words);
+	tegra_drm_fw_exit(&fast);
+
+	return ret;
+}
@@ -8,8 +8,21 @@
  * under the terms of the GNU General Public License version 2 as published by
  * the Free Software Foundation.
  *
+ * With -s no GTE device is opened. A producer thread fills an anonymous
+ * tegra_gte_hts_event_ring at the given rate the way gte_event_irq_thread()
+ * and gte_event_ring_put() do, dropping events on a full ring and waking the
+ * reader through an eventfd once the watermark is reached, with the level
+ * check of gte_event_poll(); the model must be kept in sync with those. The
+ * synthetic timestamps count up by a fixed step, so every gap the reader sees
+ * has to be accounted for by the dropped counter.
+ *
+ * Build:
+ *	cc -O2 -pthread -I<kernel>/include/uapi -o tegra_gte_mon tegra_gte_mon.c
+ *
  * Example Usage:
  *	tegra_gte_mon -d <device> -g <global gpio pin> -r -f
+ *	tegra_gte_mon -d <device> -g <global gpio pin> -r -m 1024 -w 64 -p
+ *	tegra_gte_mon -s 1000000 -m 1024 -w 64 -p -c 20000
  */
 
 #include <unistd.h>
@@ -23,21 +36,387 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <linux/tegra-gte-ioctl.h>
 
+struct mon_stats {
+	uint64_t events;
+	uint64_t window_events;
+	struct timespec window_start;
+	bool rate_only;
+	/* simulated mode only, timestamps advance by ts_step */
+	uint64_t ts_step;
+	uint64_t next_ts;
+	uint64_t lost;
+	uint64_t reordered;
+};
+
+struct sim_producer {
+	struct tegra_gte_hts_event_ring *ring;
+	uint32_t ring_head;
+	uint32_t ring_mask;
+	uint32_t ring_watermark;
+	unsigned int rate;
+	uint64_t ts_step;
+	uint64_t produced;
+	uint64_t wakeups;
+	int efd;
+	volatile bool stop;
+};
+
+static void handle_event(struct mon_stats *st,
+			 const struct tegra_gte_hts_event_data *event)
+{
+	struct timespec now;
+	double elapsed;
+
+	st->events++;
+	st->window_events++;
+
+	if (st->ts_step) {
+		if (event->timestamp < st->next_ts)
+			st->reordered++;
+		else
+			st->lost += (event->timestamp - st->next_ts) /
+				    st->ts_step;
+		st->next_ts = event->timestamp + st->ts_step;
+	}
+
+	if (!st->rate_only) {
+		fprintf(stdout, "HW timestamp GPIO EVENT %" PRIu64 "\n",
+			event->timestamp);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = (now.tv_sec - st->window_start.tv_sec) +
+		(now.tv_nsec - st->window_start.tv_nsec) / 1e9;
+	if (elapsed >= 1.0) {
+		fprintf(stdout, "%.0f events/s (%" PRIu64 " total)\n",
+			st->window_events / elapsed, st->events);
+		st->window_events = 0;
+		st->window_start = now;
+	}
+}
+
+static int read_events(int fd, struct mon_stats *st, unsigned int batch,
+		       unsigned int loops)
+{
+	struct tegra_gte_hts_event_data *events;
+	unsigned int i = 0, n, k;
+	int ret = 0;
+
+	events = calloc(batch, sizeof(*events));
+	if (!events)
+		return -ENOMEM;
+
+	while (1) {
+		ret = read(fd, events, batch * sizeof(*events));
+		if (ret == -1) {
+			if (errno == EAGAIN) {
+				fprintf(stderr, "nothing available\n");
+				continue;
+			} else {
+				ret = -errno;
+				fprintf(stderr, "Failed to read event (%d)\n",
+					ret);
+				break;
+			}
+		}
+
+		if (ret == 0 || ret % sizeof(*events)) {
+			fprintf(stderr, "Reading event failed\n");
+			ret = -EIO;
+			break;
+		}
+
+		n = ret / sizeof(*events);
+		for (k = 0; k < n; k++)
+			handle_event(st, &events[k]);
+		ret = 0;
+
+		i++;
+		if (i == loops)
+			break;
+	}
+
+	free(events);
+	return ret;
+}
+
+/*
+ * In simulated mode fd is the producer's eventfd. It only stands in for the
+ * wait queue, the ring fill is checked first like gte_event_poll() does.
+ */
+static int ring_wait(int fd, volatile struct tegra_gte_hts_event_ring *ring,
+		     uint32_t tail, unsigned int watermark, bool sim)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint64_t cnt;
+	int ret;
+
+	if (sim && __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail >=
+	    watermark)
+		return 1;
+
+	ret = poll(&pfd, 1, 1000);
+	if (sim && ret > 0 && read(fd, &cnt, sizeof(cnt)) != sizeof(cnt))
+		return -1;
+
+	return ret;
+}
+
+static int ring_consume(int fd, volatile struct tegra_gte_hts_event_ring *ring,
+			struct mon_stats *st, unsigned int ring_size,
+			unsigned int watermark, unsigned int loops, bool sim)
+{
+	struct tegra_gte_hts_event_data event;
+	unsigned int i = 0;
+	uint32_t head, tail;
+	int ret = 0;
+
+	tail = ring->tail;
+
+	while (1) {
+		ret = ring_wait(fd, ring, tail, watermark, sim);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			perror("Failed to poll event fd");
+			break;
+		}
+
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		while (tail != head) {
+			event = ring->ev[tail & (ring_size - 1)];
+			handle_event(st, &event);
+			tail++;
+		}
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		ret = 0;
+
+		i++;
+		if (i == loops)
+			break;
+	}
+
+	return ret;
+}
+
+static int ring_events(int fd, struct mon_stats *st, unsigned int ring_size,
+		       unsigned int watermark, unsigned int loops)
+{
+	struct tegra_gte_hts_event_ring_req rreq = {0};
+	volatile struct tegra_gte_hts_event_ring *ring;
+	size_t map_size;
+	int ret;
+
+	rreq.num_events = ring_size;
+	rreq.watermark = watermark;
+	ret = ioctl(fd, TEGRA_GTE_HTS_SETUP_EV_RING_IOCTL, &rreq);
+	if (ret == -1) {
+		ret = -errno;
+		fprintf(stderr, "Failed to set up event ring (%d)\n", ret);
+		return ret;
+	}
+
+	map_size = sizeof(*ring) + ring_size * sizeof(ring->ev[0]);
+	ring = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+		ret = -errno;
+		perror("Failed to map event ring");
+		return ret;
+	}
+
+	ret = ring_consume(fd, ring, st, ring_size, watermark, loops, false);
+
+	if (ring->dropped)
+		fprintf(stderr, "%u events dropped, ring full\n",
+			ring->dropped);
+	munmap((void *)ring, map_size);
+	return ret;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Follows gte_event_ring_put() */
+static bool sim_ring_put(struct sim_producer *sp,
+			 const struct tegra_gte_hts_event_data *ge)
+{
+	struct tegra_gte_hts_event_ring *ring = sp->ring;
+
+	if (sp->ring_head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >
+	    sp->ring_mask) {
+		__atomic_store_n(&ring->dropped, ring->dropped + 1,
+				 __ATOMIC_RELAXED);
+		return false;
+	}
+
+	ring->ev[sp->ring_head & sp->ring_mask] = *ge;
+	sp->ring_head++;
+	__atomic_store_n(&ring->head, sp->ring_head, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/*
+ * Follows gte_event_irq_thread(): every pass drains all the edges that are
+ * due, as the thread drains the GTE FIFO, then wakes the reader once.
+ */
+static void *sim_producer_thread(void *arg)
+{
+	struct sim_producer *sp = arg;
+	struct tegra_gte_hts_event_data ge;
+	struct timespec delay;
+	uint64_t start, due, one = 1;
+	int queued;
+
+	memset(&ge, 0, sizeof(ge));
+	start = now_ns();
+
+	while (!sp->stop) {
+		if (sp->rate)
+			due = (now_ns() - start) * sp->rate / 1000000000ull;
+		else
+			due = sp->produced + 64;
+
+		if (due == sp->produced) {
+			delay.tv_sec = 0;
+			delay.tv_nsec = 1000000000ull / sp->rate;
+			nanosleep(&delay, NULL);
+			continue;
+		}
+
+		queued = 0;
+		for (; sp->produced < due; sp->produced++) {
+			ge.timestamp = sp->produced * sp->ts_step;
+			ge.dir = sp->produced & 1 ? TEGRA_GTE_EVENT_FALLING_EDGE :
+				 TEGRA_GTE_EVENT_RISING_EDGE;
+			queued += sim_ring_put(sp, &ge);
+		}
+
+		if (queued && sp->ring_head -
+		    __atomic_load_n(&sp->ring->tail, __ATOMIC_ACQUIRE) >=
+		    sp->ring_watermark) {
+			sp->wakeups++;
+			if (write(sp->efd, &one, sizeof(one)) != sizeof(one))
+				break;
+		}
+	}
+
+	return NULL;
+}
+
+static int simulate_ring(unsigned int rate, unsigned int ring_size,
+			 unsigned int watermark, unsigned int loops,
+			 bool rate_only)
+{
+	struct sim_producer sp = {0};
+	struct mon_stats st = {0};
+	struct tegra_gte_hts_event_data event;
+	uint64_t start, trailing;
+	pthread_t thread;
+	size_t map_size;
+	double elapsed;
+	int ret;
+
+	map_size = sizeof(*sp.ring) + ring_size * sizeof(sp.ring->ev[0]);
+	sp.ring = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sp.ring == MAP_FAILED) {
+		perror("Failed to map event ring");
+		return -errno;
+	}
+	sp.ring->num_events = ring_size;
+	sp.ring_mask = ring_size - 1;
+	sp.ring_watermark = watermark ? watermark : 1;
+	sp.rate = rate;
+	sp.ts_step = rate ? 1000000000ull / rate : 1;
+	if (!sp.ts_step)
+		sp.ts_step = 1;
+
+	sp.efd = eventfd(0, EFD_CLOEXEC);
+	if (sp.efd == -1) {
+		ret = -errno;
+		perror("Failed to create eventfd");
+		goto out_unmap;
+	}
+
+	st.rate_only = rate_only;
+	st.ts_step = sp.ts_step;
+	clock_gettime(CLOCK_MONOTONIC, &st.window_start);
+
+	fprintf(stdout, "Simulating %u events/s into a %u entry ring\n",
+		rate, ring_size);
+
+	start = now_ns();
+	ret = pthread_create(&thread, NULL, sim_producer_thread, &sp);
+	if (ret) {
+		ret = -ret;
+		fprintf(stderr, "Failed to start producer (%d)\n", ret);
+		goto out_close;
+	}
+
+	ret = ring_consume(sp.efd, sp.ring, &st, ring_size, sp.ring_watermark,
+			   loops, true);
+
+	sp.stop = true;
+	pthread_join(thread, NULL);
+	elapsed = (now_ns() - start) / 1e9;
+
+	/* pick up what was queued after the last wakeup */
+	while (sp.ring->tail != sp.ring->head) {
+		event = sp.ring->ev[sp.ring->tail & sp.ring_mask];
+		handle_event(&st, &event);
+		sp.ring->tail++;
+	}
+	trailing = sp.produced - st.next_ts / sp.ts_step;
+
+	fprintf(stdout, "%" PRIu64 " events in %.3f s, %.0f events/s, "
+		"%" PRIu64 " wakeups, %u dropped\n", st.events, elapsed,
+		st.events / elapsed, sp.wakeups, sp.ring->dropped);
+
+	if (st.events + sp.ring->dropped != sp.produced ||
+	    st.lost + trailing != sp.ring->dropped || st.reordered) {
+		fprintf(stderr, "FAIL: %" PRIu64 " produced, %" PRIu64
+			" missing, %" PRIu64 " out of order\n", sp.produced,
+			st.lost + trailing, st.reordered);
+		ret = 1;
+	}
+
+out_close:
+	close(sp.efd);
+out_unmap:
+	munmap(sp.ring, map_size);
+	return ret;
+}
+
 int monitor_device(const char *device_name,
 		   unsigned int gnum,
 		   unsigned int eventflags,
-		   unsigned int loops)
+		   unsigned int loops,
+		   unsigned int batch,
+		   unsigned int ring_size,
+		   unsigned int watermark,
+		   bool rate_only)
 {
 	struct tegra_gte_hts_event_req req = {0};
-	struct tegra_gte_hts_event_data event;
+	struct mon_stats st = {0};
 	char *chrdev_name;
 	int fd;
 	int ret;
-	int i = 0;
 
 	ret = asprintf(&chrdev_name, "/dev/%s", device_name);
 	if (ret < 0)
@@ -64,33 +443,15 @@ int monitor_device(const char *device_name,
 
 	fprintf(stdout, "Monitoring line %d on %s\n", gnum, device_name);
 
-	while (1) {
-		ret = read(req.fd, &event, sizeof(event));
-		if (ret == -1) {
-			if (errno == -EAGAIN) {
-				fprintf(stderr, "nothing available\n");
-				continue;
-			} else {
-				ret = -errno;
-				fprintf(stderr, "Failed to read event (%d)\n",
-					ret);
-				break;
-			}
-		}
+	st.rate_only = rate_only;
+	clock_gettime(CLOCK_MONOTONIC, &st.window_start);
 
-		if (ret != sizeof(event)) {
-			fprintf(stderr, "Reading event failed\n");
-			ret = -EIO;
-			break;
-		}
+	if (ring_size)
+		ret = ring_events(req.fd, &st, ring_size, watermark, loops);
+	else
+		ret = read_events(req.fd, &st, batch, loops);
 
-		fprintf(stdout, "HW timestamp GPIO EVENT %" PRIu64 "\n",
-			event.timestamp);
-
-		i++;
-		if (i == loops)
-			break;
-	}
+	close(req.fd);
 
 exit_close_error:
 	if (close(fd) == -1)
@@ -105,15 +466,29 @@ void print_usage(char *bin_name)
 		"Listen to events on GPIO lines, 0->1 1->0\n"
 		"  -d <name>  Listen using named HW ts engine device\n"
 		"  -g <n>     GPIO global id\n"
+		" [-s <n>]    No device, simulate <n> events/s into the ring\n"
+		"             (0 for as fast as possible)\n"
 		"  -r         Listen for rising edges\n"
 		"  -f         Listen for falling edges\n"
 		" [-c <n>]    Do <n> loops (optional, infinite loop if not stated)\n"
+		" [-b <n>]    Read up to <n> events per read() call (default 1)\n"
+		" [-m <n>]    Use a shared ring of <n> events (power of two)\n"
+		" [-w <n>]    Wake up once <n> events are in the ring (default 1)\n"
+		" [-p]        Print sustained events per second instead of\n"
+		"             each timestamp\n"
 		"  -h         This helptext\n"
 		"\n"
 		"Example:\n"
 		"%s -d gtechip0 -g 257 -r -f\n"
-		"(means GPIO 257 rising and falling edge monitoring)\n",
-		bin_name, bin_name
+		"(means GPIO 257 rising and falling edge monitoring)\n"
+		"%s -d gtechip0 -g 257 -r -m 1024 -w 64 -p\n"
+		"(means GPIO 257 rising edges through a 1024 entry ring, woken\n"
+		"every 64 events, reporting the event rate; drive the pin from\n"
+		"a PWM or loopback GPIO to benchmark a steady source)\n"
+		"%s -s 1000000 -m 1024 -w 64 -p -c 20000\n"
+		"(means the same ring fed by a simulated 1M events/s source,\n"
+		"stopping after 20000 wakeups)\n",
+		bin_name, bin_name, bin_name, bin_name
 	);
 }
 
@@ -123,10 +498,32 @@ int main(int argc, char **argv)
 	unsigned int gnum = -1;
 	unsigned int loops = 0;
 	unsigned int eventflags = 0;
+	unsigned int batch = 1;
+	unsigned int ring_size = 0;
+	unsigned int watermark = 1;
+	bool rate_only = false;
+	bool sim = false;
+	unsigned int sim_rate = 0;
 	int c;
 
-	while ((c = getopt(argc, argv, "c:g:d:rfh")) != -1) {
+	while ((c = getopt(argc, argv, "b:c:g:d:m:s:w:prfh")) != -1) {
 		switch (c) {
+		case 's':
+			sim = true;
+			sim_rate = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			batch = strtoul(optarg, NULL, 10);
+			break;
+		case 'm':
+			ring_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'w':
+			watermark = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			rate_only = true;
+			break;
 		case 'c':
 			loops = strtoul(optarg, NULL, 10);
 			break;
@@ -148,7 +545,21 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (!device_name || gnum == -1) {
+	if (sim) {
+		if (!ring_size)
+			ring_size = 1024;
+		if ((ring_size & (ring_size - 1)) ||
+		    ring_size > TEGRA_GTE_HTS_EVENT_RING_MAX ||
+		    watermark > ring_size) {
+			print_usage(argv[0]);
+			return 1;
+		}
+		return simulate_ring(sim_rate, ring_size, watermark, loops,
+				     rate_only);
+	}
+
+	if (!device_name || gnum == -1 || !batch ||
+	    (ring_size & (ring_size - 1))) {
 		print_usage(argv[0]);
 		return 1;
 	}
@@ -158,5 +569,6 @@ int main(int argc, char **argv)
 		       "falling edges\n");
 		eventflags = TEGRA_GTE_EVENT_REQ_BOTH_EDGES;
 	}
-	return monitor_device(device_name, gnum, eventflags, loops);
+	return monitor_device(device_name, gnum, eventflags, loops, batch,
+			      ring_size, watermark, rate_only);
 }
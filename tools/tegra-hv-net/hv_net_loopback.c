@@ -0,0 +1,915 @@
+/*
+ * hv_net_loopback - run the tegra_hv_net framing over a pair of local IVC
+ * queues, echo every packet back from the peer and check what comes back.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * No hypervisor or second guest is needed. Two endpoints share one IVC
+ * channel made of two queues in local memory, each end's tx queue being the
+ * other end's rx queue, and a notification raises the peer's interrupt. The
+ * local end sends sequence numbered packets of mixed sizes, the peer bridges
+ * whatever it receives back. Both ends run the same model of the driver:
+ * packed and fragmented tx, the NAPI rx budget that can stop in the middle
+ * of a packed frame, and the interrupt handler. The channel follows
+ * tegra_ivc_channel_reset(), tegra_ivc_channel_notified() and the frame
+ * calls in drivers/platform/tegra/tegra-ivc.c, the driver side follows
+ * tegra_hv_net_xmit_work(), tegra_hv_net_rx(), tegra_hv_net_rx_packed(),
+ * tegra_hv_net_poll() and tegra_hv_net_interrupt() in
+ * drivers/net/tegra_hv_net.c; both must be kept in sync with them.
+ *
+ * With -R the peer restarts every <n> packets: it resets the channel and
+ * loses its queues, like a guest that reboots. Packets in flight may be
+ * lost then, but the run fails if a packet comes back corrupt, out of order
+ * or if the local end counts a bad frame, which is what a stale position in
+ * a packed frame or a stale fragment leads to after the reset.
+ *
+ * Build:
+ *	cc -O2 -o hv_net_loopback hv_net_loopback.c
+ *
+ * Example Usage:
+ *	hv_net_loopback -n 100000
+ *	hv_net_loopback -n 100000 -R 1000 -b 4
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <time.h>
+
+/* from drivers/net/tegra_hv_net.c */
+#define HDR_SIZE		8
+#define F_DATA_FIRST		(1 << 1)
+#define F_DATA_LAST		(1 << 2)
+#define F_DATA_PACKED		(1 << 3)
+#define F_DATA_FSIZE_SHIFT	16
+#define F_DATA_FSIZE_MASK	(~0U << F_DATA_FSIZE_SHIFT)
+#define F_DATA_FSIZE(x)	(((uint32_t)(x) << F_DATA_FSIZE_SHIFT) & \
+			 F_DATA_FSIZE_MASK)
+#define MAX_MTU			9000
+#define MIN_MTU			14
+#define PACKED_REC_SIZE		4
+
+#define ALIGN4(x)		(((x) + 3) & ~3)
+
+#define DEFAULT_FRAME_SIZE	1024
+#define DEFAULT_NFRAMES		64
+#define DEFAULT_BUDGET		8
+#define TX_WINDOW		64
+#define WAIT_TRIES		64
+
+enum ivc_state {
+	ivc_state_established,
+	ivc_state_sync,
+	ivc_state_ack,
+};
+
+enum drop_kind {
+	dk_none,
+	dk_wq,
+	dk_frame,
+	dk_packet,
+	dk_unexpected,
+	dk_alloc,
+	dk_overflow,
+	dk_max,
+};
+
+static const char * const dk_names[dk_max] = {
+	"none", "tx wait", "bad frame", "bad packet", "unexpected",
+	"alloc", "overflow",
+};
+
+struct ivc_queue {
+	uint32_t w_count;
+	uint32_t r_count;
+	enum ivc_state state;
+	uint8_t *frames;
+};
+
+struct endpoint;
+
+struct ivc {
+	struct ivc_queue *tx_channel;
+	struct ivc_queue *rx_channel;
+	uint32_t w_pos;
+	uint32_t r_pos;
+	uint32_t nframes;
+	uint32_t frame_size;
+	struct endpoint *peer;
+};
+
+/* an skb, cap is what was allocated */
+struct pkt {
+	uint32_t len;
+	uint32_t cap;
+	uint8_t data[];
+};
+
+struct pktq {
+	struct pkt **slot;
+	unsigned int size, head, tail;
+};
+
+struct sim;
+
+struct endpoint {
+	const char *name;
+	struct sim *sim;
+	struct ivc ivc;
+	struct pktq tx_q;
+	bool irq_pending;
+	bool napi_sched;
+
+	/* tegra_hv_net_queue rx state */
+	struct pkt *rx_skb;
+	int rx_pk_off;
+	uint32_t rx_pk_left;
+	bool rx_reset;
+
+	void (*deliver)(struct endpoint *ep, struct pkt *skb);
+	unsigned long tx_packets;
+	unsigned long drops[dk_max];
+};
+
+struct sim {
+	struct endpoint local, peer;
+	unsigned int budget;
+	bool pack;
+	uint32_t *lens;
+	uint32_t sent;
+	uint32_t next_seq;
+	unsigned long received, lost, corrupt, reordered, resets;
+	uint64_t rnd;
+};
+
+static uint32_t sim_rand(struct sim *s)
+{
+	s->rnd = s->rnd * 6364136223846793005ULL + 1442695040888963407ULL;
+	return s->rnd >> 33;
+}
+
+static struct pkt *pkt_alloc(uint32_t cap)
+{
+	struct pkt *skb = malloc(sizeof(*skb) + cap);
+
+	if (skb) {
+		skb->len = 0;
+		skb->cap = cap;
+	}
+	return skb;
+}
+
+static bool pktq_empty(struct pktq *q)
+{
+	return q->head == q->tail;
+}
+
+static unsigned int pktq_len(struct pktq *q)
+{
+	return q->tail - q->head;
+}
+
+static void pktq_put(struct pktq *q, struct pkt *skb)
+{
+	if (q->tail == q->size && q->head) {
+		memmove(q->slot, q->slot + q->head,
+			pktq_len(q) * sizeof(*q->slot));
+		q->tail -= q->head;
+		q->head = 0;
+	} else if (q->tail == q->size) {
+		q->size = q->size ? q->size * 2 : 64;
+		q->slot = realloc(q->slot, q->size * sizeof(*q->slot));
+		if (!q->slot) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	q->slot[q->tail++] = skb;
+}
+
+static struct pkt *pktq_get(struct pktq *q)
+{
+	if (pktq_empty(q))
+		return NULL;
+	return q->slot[q->head++];
+}
+
+static void pktq_purge(struct pktq *q)
+{
+	struct pkt *skb;
+
+	while ((skb = pktq_get(q)) != NULL)
+		free(skb);
+}
+
+/* ---- IVC channel, follows drivers/platform/tegra/tegra-ivc.c ---- */
+
+static void ivc_notify(struct ivc *ivc)
+{
+	ivc->peer->irq_pending = true;
+}
+
+static uint32_t ivc_avail(struct ivc_queue *ch)
+{
+	return ch->w_count - ch->r_count;
+}
+
+static int ivc_check_read(struct ivc *ivc)
+{
+	uint32_t avail = ivc_avail(ivc->rx_channel);
+
+	if (ivc->tx_channel->state != ivc_state_established)
+		return -ECONNRESET;
+	if (avail == 0 || avail > ivc->nframes)
+		return -ENOMEM;
+	return 0;
+}
+
+static int ivc_check_write(struct ivc *ivc)
+{
+	if (ivc->tx_channel->state != ivc_state_established)
+		return -ECONNRESET;
+	if (ivc_avail(ivc->tx_channel) >= ivc->nframes)
+		return -ENOMEM;
+	return 0;
+}
+
+static uint32_t *ivc_read_get_next_frame(struct ivc *ivc)
+{
+	if (ivc_check_read(ivc))
+		return NULL;
+	return (uint32_t *)(ivc->rx_channel->frames +
+			    ivc->r_pos * ivc->frame_size);
+}
+
+static void ivc_read_advance(struct ivc *ivc)
+{
+	if (ivc_check_read(ivc))
+		return;
+
+	ivc->rx_channel->r_count++;
+	ivc->r_pos = (ivc->r_pos + 1) % ivc->nframes;
+
+	/* notify only upon transition from full to non-full */
+	if (ivc_avail(ivc->rx_channel) == ivc->nframes - 1)
+		ivc_notify(ivc);
+}
+
+static uint32_t *ivc_write_get_next_frame(struct ivc *ivc)
+{
+	if (ivc_check_write(ivc))
+		return NULL;
+	return (uint32_t *)(ivc->tx_channel->frames +
+			    ivc->w_pos * ivc->frame_size);
+}
+
+static void ivc_write_advance(struct ivc *ivc)
+{
+	if (ivc_check_write(ivc))
+		return;
+
+	ivc->tx_channel->w_count++;
+	ivc->w_pos = (ivc->w_pos + 1) % ivc->nframes;
+
+	/* notify only upon transition from empty to non-empty */
+	if (ivc_avail(ivc->tx_channel) == 1)
+		ivc_notify(ivc);
+}
+
+static void ivc_channel_reset(struct ivc *ivc)
+{
+	ivc->tx_channel->state = ivc_state_sync;
+	ivc_notify(ivc);
+}
+
+static int ivc_channel_notified(struct ivc *ivc)
+{
+	enum ivc_state peer_state = ivc->rx_channel->state;
+
+	if (peer_state == ivc_state_sync) {
+		ivc->tx_channel->w_count = 0;
+		ivc->rx_channel->r_count = 0;
+		ivc->w_pos = 0;
+		ivc->r_pos = 0;
+		ivc->tx_channel->state = ivc_state_ack;
+		ivc_notify(ivc);
+	} else if (ivc->tx_channel->state == ivc_state_sync &&
+		   peer_state == ivc_state_ack) {
+		ivc->tx_channel->w_count = 0;
+		ivc->rx_channel->r_count = 0;
+		ivc->w_pos = 0;
+		ivc->r_pos = 0;
+		ivc->tx_channel->state = ivc_state_established;
+		ivc_notify(ivc);
+	} else if (ivc->tx_channel->state == ivc_state_ack) {
+		ivc->tx_channel->state = ivc_state_established;
+		ivc_notify(ivc);
+	}
+
+	return ivc->tx_channel->state == ivc_state_established ? 0 : -EAGAIN;
+}
+
+/* ---- driver model, follows drivers/net/tegra_hv_net.c ---- */
+
+static void run_napi(struct endpoint *ep);
+
+/* follows tegra_hv_net_interrupt() */
+static void run_irq(struct endpoint *ep)
+{
+	if (!ep->irq_pending)
+		return;
+	ep->irq_pending = false;
+
+	if (ivc_channel_notified(&ep->ivc) != 0) {
+		ep->rx_reset = true;
+		return;
+	}
+
+	if (ivc_check_read(&ep->ivc) == 0)
+		ep->napi_sched = true;
+}
+
+/*
+ * Stands in for the wait in tegra_hv_net_xmit_get_buffer(): while this
+ * end waits for room, the interrupts and NAPI keep running elsewhere.
+ */
+static uint32_t *xmit_get_buffer(struct endpoint *ep)
+{
+	uint32_t *p;
+	int i;
+
+	for (i = 0; i < WAIT_TRIES; i++) {
+		p = ivc_write_get_next_frame(&ep->ivc);
+		if (p)
+			return p;
+		run_irq(ep);
+		run_irq(ep->ivc.peer);
+		run_napi(ep->ivc.peer);
+		run_napi(ep);
+	}
+
+	return NULL;
+}
+
+struct pack {
+	uint32_t *p;
+	int used;
+	int count;
+};
+
+static void pack_close(struct endpoint *ep, struct pack *pk)
+{
+	if (pk->p == NULL)
+		return;
+
+	pk->p[0] = F_DATA_FSIZE(pk->used) | F_DATA_FIRST | F_DATA_LAST |
+		F_DATA_PACKED;
+	pk->p[1] = pk->count;
+	ivc_write_advance(&ep->ivc);
+	pk->p = NULL;
+}
+
+static enum drop_kind pack_add(struct endpoint *ep, struct pack *pk,
+			       struct pkt *skb)
+{
+	int max_frame = ep->ivc.frame_size - HDR_SIZE;
+	int rec = PACKED_REC_SIZE + ALIGN4(skb->len);
+	uint8_t *dst;
+
+	if (pk->p != NULL && pk->used + rec > max_frame)
+		pack_close(ep, pk);
+
+	if (pk->p == NULL) {
+		pk->p = xmit_get_buffer(ep);
+		if (pk->p == NULL)
+			return dk_wq;
+		pk->used = 0;
+		pk->count = 0;
+	}
+
+	dst = (uint8_t *)&pk->p[2] + pk->used;
+	memcpy(dst, &skb->len, sizeof(uint32_t));
+	memcpy(dst + PACKED_REC_SIZE, skb->data, skb->len);
+
+	pk->used += rec;
+	pk->count++;
+
+	return dk_none;
+}
+
+static enum drop_kind xmit_frags(struct endpoint *ep, struct pkt *skb)
+{
+	int max_frame = ep->ivc.frame_size - HDR_SIZE;
+	uint32_t off = 0, count, p0;
+	uint32_t *p;
+
+	while (off < skb->len) {
+		count = skb->len - off;
+		if (count > (uint32_t)max_frame)
+			count = max_frame;
+
+		p = xmit_get_buffer(ep);
+		if (p == NULL)
+			return dk_wq;
+
+		p0 = F_DATA_FSIZE(count);
+		if (off == 0)
+			p0 |= F_DATA_FIRST;
+		if (off + count == skb->len)
+			p0 |= F_DATA_LAST;
+
+		p[0] = p0;
+		p[1] = skb->len;
+		memcpy(&p[2], skb->data + off, count);
+		ivc_write_advance(&ep->ivc);
+		off += count;
+	}
+
+	return dk_none;
+}
+
+/* follows tegra_hv_net_xmit_work() */
+static void xmit_work(struct endpoint *ep)
+{
+	int max_frame = ep->ivc.frame_size - HDR_SIZE;
+	struct pack pk = { .p = NULL };
+	enum drop_kind dk;
+	struct pkt *skb;
+
+	while ((skb = pktq_get(&ep->tx_q)) != NULL) {
+		if (ep->sim->pack &&
+		    PACKED_REC_SIZE + ALIGN4(skb->len) <= (uint32_t)max_frame) {
+			dk = pack_add(ep, &pk, skb);
+		} else {
+			pack_close(ep, &pk);
+			dk = xmit_frags(ep, skb);
+		}
+
+		if (pktq_empty(&ep->tx_q))
+			pack_close(ep, &pk);
+
+		free(skb);
+		if (dk == dk_none)
+			ep->tx_packets++;
+		else
+			ep->drops[dk]++;
+	}
+
+	pack_close(ep, &pk);
+}
+
+/* follows tegra_hv_net_rx_reset() */
+static void rx_reset(struct endpoint *ep)
+{
+	ep->rx_pk_off = 0;
+	ep->rx_pk_left = 0;
+	free(ep->rx_skb);
+	ep->rx_skb = NULL;
+}
+
+/* follows tegra_hv_net_rx_packed() */
+static int rx_packed(struct endpoint *ep, const uint32_t *p, int frame_size,
+		     int limit)
+{
+	const uint8_t *rec = (const uint8_t *)&p[2];
+	struct pkt *skb;
+	int off, nr = 0;
+	uint32_t len;
+
+	if (ep->rx_pk_left == 0) {
+		ep->rx_pk_off = 0;
+		ep->rx_pk_left = p[1];
+	}
+	off = ep->rx_pk_off;
+
+	while (ep->rx_pk_left > 0 && nr < limit) {
+		nr++;
+
+		if (off + PACKED_REC_SIZE > frame_size) {
+			ep->drops[dk_frame]++;
+			ep->rx_pk_left = 0;
+			break;
+		}
+
+		memcpy(&len, rec + off, sizeof(len));
+		if (len < MIN_MTU || len > MAX_MTU + MIN_MTU ||
+		    off + PACKED_REC_SIZE + (int)len > frame_size) {
+			ep->drops[dk_packet]++;
+			ep->rx_pk_left = 0;
+			break;
+		}
+
+		skb = pkt_alloc(len);
+		if (skb == NULL) {
+			ep->drops[dk_alloc]++;
+		} else {
+			memcpy(skb->data, rec + off + PACKED_REC_SIZE, len);
+			skb->len = len;
+			ep->deliver(ep, skb);
+		}
+
+		off += PACKED_REC_SIZE + ALIGN4(len);
+		ep->rx_pk_left--;
+	}
+
+	ep->rx_pk_off = off;
+	return nr;
+}
+
+/* follows tegra_hv_net_rx() */
+static int rx(struct endpoint *ep, int limit)
+{
+	int max_frame = ep->ivc.frame_size - HDR_SIZE;
+	int nr = 0, frame_size, first, last, n;
+	enum drop_kind dk;
+	uint32_t *p, p0, count;
+	struct pkt *skb;
+
+	while (nr < limit) {
+		if (ep->rx_reset) {
+			ep->rx_reset = false;
+			rx_reset(ep);
+		}
+
+		p = ivc_read_get_next_frame(&ep->ivc);
+		if (p == NULL)
+			break;
+
+		p0 = p[0];
+		first = !!(p0 & F_DATA_FIRST);
+		last = !!(p0 & F_DATA_LAST);
+		frame_size = (p0 & F_DATA_FSIZE_MASK) >> F_DATA_FSIZE_SHIFT;
+		count = p[1];
+
+		if ((p0 & F_DATA_PACKED) && frame_size <= max_frame &&
+		    ep->rx_skb == NULL) {
+			n = rx_packed(ep, p, frame_size, limit - nr);
+			nr += n > 1 ? n : 1;
+			if (ep->rx_pk_left == 0)
+				ivc_read_advance(&ep->ivc);
+			continue;
+		}
+
+		nr++;
+
+		if (frame_size > max_frame) {
+			dk = dk_frame;
+			goto drop;
+		}
+
+		if (p0 & F_DATA_PACKED) {
+			free(ep->rx_skb);
+			ep->rx_skb = NULL;
+			dk = dk_unexpected;
+			goto drop;
+		}
+
+		if (count < MIN_MTU || count > MAX_MTU + MIN_MTU) {
+			dk = dk_packet;
+			goto drop;
+		}
+
+		if (ep->rx_skb == NULL) {
+			if (!first) {
+				dk = dk_unexpected;
+				goto drop;
+			}
+			ep->rx_skb = pkt_alloc(count);
+			if (ep->rx_skb == NULL) {
+				dk = dk_alloc;
+				goto drop;
+			}
+		}
+
+		if (ep->rx_skb->cap - ep->rx_skb->len < (uint32_t)frame_size) {
+			free(ep->rx_skb);
+			ep->rx_skb = NULL;
+			dk = dk_overflow;
+			goto drop;
+		}
+
+		skb = ep->rx_skb;
+		memcpy(skb->data + skb->len, &p[2], frame_size);
+		skb->len += frame_size;
+
+		if (last) {
+			ep->rx_skb = NULL;
+			ep->deliver(ep, skb);
+		}
+		dk = dk_none;
+drop:
+		ivc_read_advance(&ep->ivc);
+		ep->drops[dk]++;
+	}
+
+	return nr;
+}
+
+/* follows tegra_hv_net_poll() */
+static void run_napi(struct endpoint *ep)
+{
+	int budget = ep->sim->budget;
+
+	if (!ep->napi_sched)
+		return;
+
+	if (rx(ep, budget) < budget) {
+		ep->napi_sched = false;
+		if (ivc_check_read(&ep->ivc) == 0)
+			ep->napi_sched = true;
+	}
+}
+
+/* ---- the test ---- */
+
+static uint8_t pattern(uint32_t seq, uint32_t i)
+{
+	return (uint8_t)(seq * 31 + i);
+}
+
+static void peer_deliver(struct endpoint *ep, struct pkt *skb)
+{
+	/* bridge it straight back */
+	pktq_put(&ep->tx_q, skb);
+}
+
+static void local_deliver(struct endpoint *ep, struct pkt *skb)
+{
+	struct sim *s = ep->sim;
+	uint32_t seq, i;
+
+	s->received++;
+	memcpy(&seq, skb->data, sizeof(seq));
+	if (seq >= s->sent || skb->len != s->lens[seq]) {
+		s->corrupt++;
+		goto out;
+	}
+	for (i = sizeof(seq); i < skb->len; i++) {
+		if (skb->data[i] != pattern(seq, i)) {
+			s->corrupt++;
+			goto out;
+		}
+	}
+
+	if (seq < s->next_seq) {
+		s->reordered++;
+		goto out;
+	}
+	s->lost += seq - s->next_seq;
+	s->next_seq = seq + 1;
+out:
+	free(skb);
+}
+
+static uint32_t pick_len(struct sim *s)
+{
+	uint32_t r = sim_rand(s) % 100;
+
+	/* mostly small packets that get packed, some fragmented */
+	if (r < 70)
+		return MIN_MTU + sim_rand(s) % (256 - MIN_MTU);
+	if (r < 90)
+		return 256 + sim_rand(s) % (1500 - 256);
+	return 1500 + sim_rand(s) % (MAX_MTU - 1500 + 1);
+}
+
+static void send_burst(struct sim *s, uint32_t total)
+{
+	uint32_t n = 1 + sim_rand(s) % 32, i, len;
+	struct pkt *skb;
+
+	while (n-- && s->sent < total &&
+	       pktq_len(&s->local.tx_q) < TX_WINDOW) {
+		len = pick_len(s);
+		skb = pkt_alloc(len);
+		if (!skb) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+		skb->len = len;
+		memcpy(skb->data, &s->sent, sizeof(s->sent));
+		for (i = sizeof(s->sent); i < len; i++)
+			skb->data[i] = pattern(s->sent, i);
+		s->lens[s->sent++] = len;
+		pktq_put(&s->local.tx_q, skb);
+	}
+}
+
+/* the peer reboots: it resets the channel and starts with empty queues */
+static void peer_restart(struct sim *s)
+{
+	struct endpoint *ep = &s->peer;
+
+	pktq_purge(&ep->tx_q);
+	rx_reset(ep);
+	ep->rx_reset = false;
+	ep->napi_sched = false;
+	ivc_channel_reset(&ep->ivc);
+	s->resets++;
+}
+
+static bool idle(struct sim *s)
+{
+	return pktq_empty(&s->local.tx_q) && pktq_empty(&s->peer.tx_q) &&
+		!s->local.irq_pending && !s->peer.irq_pending &&
+		!s->local.napi_sched && !s->peer.napi_sched &&
+		!ivc_avail(s->local.ivc.tx_channel) &&
+		!ivc_avail(s->peer.ivc.tx_channel);
+}
+
+static int setup_endpoint(struct sim *s, struct endpoint *ep,
+			  const char *name, struct ivc_queue *tx,
+			  struct ivc_queue *rx, struct endpoint *peer,
+			  uint32_t nframes, uint32_t frame_size)
+{
+	ep->name = name;
+	ep->sim = s;
+	ep->ivc.tx_channel = tx;
+	ep->ivc.rx_channel = rx;
+	ep->ivc.nframes = nframes;
+	ep->ivc.frame_size = frame_size;
+	ep->ivc.peer = peer;
+
+	tx->frames = calloc(nframes, frame_size);
+	return tx->frames ? 0 : -ENOMEM;
+}
+
+static int run(struct sim *s, uint32_t total, uint32_t nframes,
+	       uint32_t frame_size, uint32_t reset_every)
+{
+	struct ivc_queue q_out = { .state = ivc_state_established };
+	struct ivc_queue q_in = { .state = ivc_state_established };
+	uint32_t next_reset = reset_every;
+	unsigned long last_received = 0, stalled = 0;
+	struct timespec t0, t1;
+	double elapsed;
+	int k, ret = 0;
+
+	if (setup_endpoint(s, &s->local, "local", &q_out, &q_in, &s->peer,
+			   nframes, frame_size) ||
+	    setup_endpoint(s, &s->peer, "peer", &q_in, &q_out, &s->local,
+			   nframes, frame_size)) {
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+	s->local.deliver = local_deliver;
+	s->peer.deliver = peer_deliver;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	while (s->sent < total || !idle(s)) {
+		send_burst(s, total);
+		xmit_work(&s->local);
+
+		run_irq(&s->peer);
+		run_napi(&s->peer);
+		xmit_work(&s->peer);
+		run_irq(&s->local);
+		run_napi(&s->local);
+
+		if (reset_every && s->sent >= next_reset) {
+			peer_restart(s);
+			next_reset += reset_every;
+		}
+
+		/* nothing came back for a while */
+		if (s->received != last_received) {
+			last_received = s->received;
+			stalled = 0;
+		} else if (++stalled > 100000) {
+			fprintf(stderr, "Channel stalled\n");
+			ret = 1;
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	/* whatever never came back at the end is lost as well */
+	s->lost += s->sent - s->next_seq;
+
+	fprintf(stdout, "packets: %u sent, %lu echoed in %.3f s, %.0f "
+		"packets/s, %lu peer resets\n", s->sent, s->received, elapsed,
+		s->received / elapsed, s->resets);
+	for (k = dk_wq; k < dk_max; k++)
+		if (s->local.drops[k] || s->peer.drops[k])
+			fprintf(stdout, "  %-10s local %lu, peer %lu\n",
+				dk_names[k], s->local.drops[k],
+				s->peer.drops[k]);
+
+	if (s->corrupt || s->reordered ||
+	    (!s->resets && s->lost) || s->local.drops[dk_frame] ||
+	    s->local.drops[dk_packet] || s->local.drops[dk_unexpected] ||
+	    s->local.drops[dk_overflow]) {
+		fprintf(stderr, "FAIL: %lu corrupt, %lu out of order, %lu "
+			"lost, %lu bad frames\n", s->corrupt, s->reordered,
+			s->lost, s->local.drops[dk_frame] +
+			s->local.drops[dk_packet] +
+			s->local.drops[dk_unexpected] +
+			s->local.drops[dk_overflow]);
+		ret = 1;
+	} else if (s->lost) {
+		fprintf(stdout, "%lu packets lost across peer resets\n",
+			s->lost);
+	}
+
+	rx_reset(&s->local);
+	rx_reset(&s->peer);
+	pktq_purge(&s->local.tx_q);
+	pktq_purge(&s->peer.tx_q);
+	free(s->local.tx_q.slot);
+	free(s->peer.tx_q.slot);
+	free(q_out.frames);
+	free(q_in.frames);
+	return ret;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: hv_net_loopback [options]...\n"
+		"Echo packets through the tegra_hv_net framing over local IVC queues\n"
+		"  -n <n>     Number of packets (default: 100000)\n"
+		"  -f <n>     IVC frame size, multiple of 4 (default: %d)\n"
+		"  -F <n>     IVC frames per queue (default: %d)\n"
+		"  -b <n>     NAPI budget (default: %d)\n"
+		"  -R <n>     Restart the peer every <n> packets (default: never)\n"
+		"  -u         Do not pack small packets\n"
+		"  -s <n>     Random seed (default: 1)\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"hv_net_loopback -n 100000\n"
+		"hv_net_loopback -n 100000 -R 1000 -b 4\n",
+		DEFAULT_FRAME_SIZE, DEFAULT_NFRAMES, DEFAULT_BUDGET);
+}
+
+int main(int argc, char **argv)
+{
+	struct sim s = {
+		.budget = DEFAULT_BUDGET,
+		.pack = true,
+		.rnd = 1,
+	};
+	uint32_t total = 100000, nframes = DEFAULT_NFRAMES;
+	uint32_t frame_size = DEFAULT_FRAME_SIZE, reset_every = 0;
+	int c, ret;
+
+	while ((c = getopt(argc, argv, "n:f:F:b:R:us:?")) != -1) {
+		switch (c) {
+		case 'n':
+			total = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			frame_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'F':
+			nframes = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			s.budget = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			reset_every = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			s.pack = false;
+			break;
+		case 's':
+			s.rnd = strtoull(optarg, NULL, 0);
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	/* the driver rejects frames that cannot hold a header and a word */
+	if (frame_size <= HDR_SIZE + 4 || frame_size % 4 ||
+	    frame_size > F_DATA_FSIZE_MASK >> F_DATA_FSIZE_SHIFT ||
+	    nframes < 2 || !s.budget) {
+		fprintf(stderr, "Frame size must be a multiple of 4 above %d, "
+			"at least 2 frames and a budget\n", HDR_SIZE + 4);
+		return -1;
+	}
+
+	s.lens = calloc(total ? total : 1, sizeof(*s.lens));
+	if (!s.lens) {
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+
+	ret = run(&s, total, nframes, frame_size, reset_every);
+	free(s.lens);
+	return ret;
+}
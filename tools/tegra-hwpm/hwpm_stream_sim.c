@@ -0,0 +1,521 @@
+/*
+ * hwpm_stream_sim - drive the HWPM stream status page and poll() wakeup
+ * logic with a synthetic PMA producer and check what a profiler sees.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * No PMA is needed. A producer thread writes sequence numbered records into
+ * a ring the way the PMA streams into the membuf, dropping records and
+ * latching overflow when the ring is full. A second thread runs the notify
+ * work and a consumer thread runs the profiler side: it waits for the fill
+ * threshold, reads the status page with the seq retry, consumes records and
+ * bumps the get pointer. The sampling, bump and wakeup logic follows
+ * tegra_hwpm_stream_sample(), tegra_hwpm_stream_notify_work_fn(),
+ * tegra_hwpm_update_mem_bytes() and tegra_hwpm_stream_fill_reached() in
+ * drivers/platform/tegra/hwpm/common/tegra_hwpm_mem_buf_utils.c and must be
+ * kept in sync with them.
+ *
+ * The run fails if a record is corrupt or lost without an overflow, if the
+ * status page reports more unread bytes than the ring holds, or if a status
+ * read is torn.
+ *
+ * Build:
+ *	cc -O2 -pthread -o hwpm_stream_sim hwpm_stream_sim.c
+ *
+ * Example Usage:
+ *	hwpm_stream_sim -t 2
+ *	hwpm_stream_sim -t 2 -r 800 -d 2000
+ *	hwpm_stream_sim -t 2 -p 100 -f 65536
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#define MEM_BYTES_INVALID	0xffffffffU
+
+#define DEFAULT_RING_SIZE	(1U << 20)
+#define DEFAULT_REC_SIZE	32U
+#define DEFAULT_RATE_MBS	200U
+#define DEFAULT_PERIOD_US	1000U
+
+/* from include/uapi/linux/tegra-soc-hwpm-uapi.h */
+struct stream_status {
+	uint64_t seq;
+	uint64_t stream_buf_size;
+	uint64_t mem_head;
+	uint64_t mem_bytes;
+	uint64_t mem_bumped;
+	uint64_t overflow_count;
+	uint8_t b_overflowed;
+	uint8_t reserved[7];
+};
+
+struct sim {
+	/* Parameters */
+	uint32_t ring_size;
+	uint32_t rec_size;
+	uint32_t rate_mbs;
+	uint64_t fill_threshold;
+	uint32_t period_us;
+	uint32_t consume_delay_us;
+
+	/* PMA side */
+	uint8_t *ring;
+	uint64_t put;		/* total bytes written */
+	uint64_t get;		/* total bytes released by mem_bump */
+	uint32_t mem_bytes_buf;	/* MEM_BYTES buffer in memory */
+	bool overflow;		/* latched until read with room again */
+	uint64_t produced, dropped;
+	uint64_t filled_ns;	/* when unread bytes crossed the threshold */
+
+	/* Driver side */
+	pthread_mutex_t stream_lock;
+	pthread_cond_t stream_wq;
+	bool mem_bytes_stale;
+	struct stream_status status;
+
+	volatile bool stop;
+};
+
+/* Everything but seq is only read after an acquire on seq */
+#define LOAD(x)		__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define STORE(x, v)	__atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double now_s(void)
+{
+	return now_ns() / 1e9;
+}
+
+static void sleep_us(uint32_t us)
+{
+	struct timespec ts = { us / 1000000U, (us % 1000000U) * 1000L };
+
+	nanosleep(&ts, NULL);
+}
+
+static void fill_rec(uint8_t *rec, uint32_t size, uint64_t seq)
+{
+	uint32_t i;
+
+	memcpy(rec, &seq, sizeof(seq));
+	for (i = sizeof(seq); i < size; i++)
+		rec[i] = (uint8_t)(seq * 7 + i);
+}
+
+static bool check_rec(const uint8_t *rec, uint32_t size, uint64_t *seq)
+{
+	uint32_t i;
+
+	memcpy(seq, rec, sizeof(*seq));
+	for (i = sizeof(*seq); i < size; i++) {
+		if (rec[i] != (uint8_t)(*seq * 7 + i))
+			return false;
+	}
+	return true;
+}
+
+/* PMA model: stream records into the ring at rate_mbs */
+static void *producer_fn(void *arg)
+{
+	struct sim *s = arg;
+	double start = now_s();
+	uint64_t seq = 0, put, get, target;
+
+	while (!s->stop) {
+		target = (uint64_t)((now_s() - start) * s->rate_mbs * 1e6);
+
+		while (s->produced * s->rec_size < target) {
+			put = LOAD(s->put);
+			get = __atomic_load_n(&s->get, __ATOMIC_ACQUIRE);
+			if (put - get + s->rec_size > s->ring_size) {
+				/* Membuf full, the PMA drops the record */
+				STORE(s->overflow, true);
+				s->dropped++;
+			} else {
+				fill_rec(&s->ring[put % s->ring_size],
+					 s->rec_size, seq);
+				__atomic_store_n(&s->put, put + s->rec_size,
+						 __ATOMIC_RELEASE);
+				if (put + s->rec_size - get >=
+				    s->fill_threshold && !LOAD(s->filled_ns))
+					STORE(s->filled_ns, now_ns());
+			}
+			s->produced++;
+			seq++;
+		}
+		sleep_us(50);
+	}
+	return NULL;
+}
+
+/* hwpm->active_chip->stream_mem_bytes(): PMA writes unread bytes */
+static void stream_mem_bytes(struct sim *s)
+{
+	uint64_t unread = LOAD(s->put) - LOAD(s->get);
+
+	STORE(s->mem_bytes_buf, (uint32_t)unread);
+}
+
+/* hwpm->active_chip->membuf_overflow_status() */
+static bool membuf_overflow_status(struct sim *s)
+{
+	uint64_t unread = LOAD(s->put) - LOAD(s->get);
+	bool overflowed = LOAD(s->overflow);
+
+	/* Reported once more, then cleared if the ring is half drained */
+	if (overflowed && unread + s->rec_size <= s->ring_size / 2)
+		STORE(s->overflow, false);
+	return overflowed;
+}
+
+/* tegra_hwpm_stream_sample(), stream_lock held */
+static void stream_sample(struct sim *s, uint64_t mem_bump)
+{
+	struct stream_status *st = &s->status;
+	uint32_t mem_bytes = MEM_BYTES_INVALID;
+	uint64_t mem_head, mem_bytes_cur;
+	bool overflowed;
+
+	/* Same order as the driver: MEM_BYTES, put pointer, overflow */
+	if (!s->mem_bytes_stale)
+		mem_bytes = LOAD(s->mem_bytes_buf);
+	mem_head = __atomic_load_n(&s->put, __ATOMIC_ACQUIRE);
+	overflowed = membuf_overflow_status(s);
+
+	__atomic_store_n(&st->seq, st->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	STORE(st->mem_head, mem_head);
+	if (mem_bytes != MEM_BYTES_INVALID)
+		STORE(st->mem_bytes, mem_bytes);
+	mem_bytes_cur = LOAD(st->mem_bytes);
+	STORE(st->mem_bytes, mem_bytes_cur - (mem_bump < mem_bytes_cur ?
+					      mem_bump : mem_bytes_cur));
+	STORE(st->mem_bumped, st->mem_bumped + mem_bump);
+	if (overflowed && !st->b_overflowed)
+		STORE(st->overflow_count, st->overflow_count + 1);
+	STORE(st->b_overflowed, (uint8_t)overflowed);
+
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&st->seq, st->seq + 1, __ATOMIC_RELAXED);
+}
+
+/* tegra_hwpm_stream_fill_reached() */
+static bool stream_fill_reached(struct sim *s)
+{
+	return LOAD(s->status.mem_bytes) >= s->fill_threshold ||
+	       LOAD(s->status.b_overflowed);
+}
+
+/* tegra_hwpm_stream_notify_work_fn() */
+static void *notify_fn(void *arg)
+{
+	struct sim *s = arg;
+	bool wake;
+
+	while (!s->stop) {
+		pthread_mutex_lock(&s->stream_lock);
+		stream_sample(s, 0);
+		wake = stream_fill_reached(s);
+		stream_mem_bytes(s);
+		s->mem_bytes_stale = false;
+		pthread_mutex_unlock(&s->stream_lock);
+
+		if (wake)
+			pthread_cond_broadcast(&s->stream_wq);
+		sleep_us(s->period_us);
+	}
+
+	pthread_mutex_lock(&s->stream_lock);
+	pthread_cond_broadcast(&s->stream_wq);
+	pthread_mutex_unlock(&s->stream_lock);
+	return NULL;
+}
+
+/* tegra_hwpm_update_mem_bytes() with notification enabled */
+static void update_get_put(struct sim *s, uint64_t mem_bump)
+{
+	pthread_mutex_lock(&s->stream_lock);
+	__atomic_store_n(&s->get, s->get + mem_bump, __ATOMIC_RELEASE);
+	stream_sample(s, mem_bump);
+	if (mem_bump)
+		s->mem_bytes_stale = true;
+	stream_mem_bytes(s);
+	s->mem_bytes_stale = false;
+	pthread_mutex_unlock(&s->stream_lock);
+}
+
+struct consumer_stats {
+	uint64_t wakeups, records, lost, bytes, next_seq;
+	uint64_t retries, torn, over_reports, corrupt, unexplained;
+	uint64_t overflows_seen;
+	uint64_t wake_lat_n;
+	double wake_lat_sum, wake_lat_max;
+};
+
+/* Read the status page like an mmap user */
+static void read_status(struct sim *s, struct stream_status *out,
+			struct consumer_stats *cs)
+{
+	const struct stream_status *st = &s->status;
+	uint64_t seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&st->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			cs->retries++;
+			continue;
+		}
+		out->mem_head = LOAD(st->mem_head);
+		out->mem_bytes = LOAD(st->mem_bytes);
+		out->mem_bumped = LOAD(st->mem_bumped);
+		out->overflow_count = LOAD(st->overflow_count);
+		out->b_overflowed = LOAD(st->b_overflowed);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&st->seq, __ATOMIC_RELAXED) == seq)
+			break;
+		cs->retries++;
+	}
+
+	/* Unread bytes can never be more than written minus released */
+	if (out->mem_bumped > out->mem_head ||
+	    out->mem_bytes > out->mem_head - out->mem_bumped)
+		cs->torn++;
+}
+
+static void *consumer_fn(void *arg)
+{
+	struct sim *s = arg;
+	struct consumer_stats *cs = calloc(1, sizeof(*cs));
+	struct stream_status st;
+	uint64_t get = 0, next_seq = 0, seq, avail, bump, overflows = 0;
+	uint64_t t, filled;
+	double lat;
+
+	while (!s->stop) {
+		pthread_mutex_lock(&s->stream_lock);
+		while (!s->stop && !stream_fill_reached(s))
+			pthread_cond_wait(&s->stream_wq, &s->stream_lock);
+		pthread_mutex_unlock(&s->stream_lock);
+		if (s->stop)
+			break;
+
+		t = now_ns();
+		cs->wakeups++;
+		read_status(s, &st, cs);
+
+		/* Wakeup latency from the ring crossing the threshold */
+		filled = LOAD(s->filled_ns);
+		if (filled && t > filled) {
+			lat = (t - filled) / 1e3;
+			cs->wake_lat_sum += lat;
+			if (lat > cs->wake_lat_max)
+				cs->wake_lat_max = lat;
+			cs->wake_lat_n++;
+		}
+
+		avail = st.mem_head - get;
+		if (st.mem_bytes > avail)
+			cs->over_reports++;
+
+		if (st.overflow_count > overflows) {
+			cs->overflows_seen += st.overflow_count - overflows;
+			overflows = st.overflow_count;
+		}
+
+		for (bump = 0; bump < avail; bump += s->rec_size) {
+			if (!check_rec(&s->ring[(get + bump) % s->ring_size],
+				       s->rec_size, &seq)) {
+				cs->corrupt++;
+				continue;
+			}
+			if (seq != next_seq) {
+				/* Records can only go missing on overflow */
+				if (seq < next_seq || !overflows)
+					cs->unexplained++;
+				cs->lost += seq - next_seq;
+			}
+			next_seq = seq + 1;
+			cs->records++;
+		}
+		cs->bytes += avail;
+
+		if (s->consume_delay_us)
+			sleep_us(s->consume_delay_us);
+
+		STORE(s->filled_ns, 0);
+		update_get_put(s, avail);
+		get += avail;
+	}
+
+	cs->next_seq = next_seq;
+	return cs;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: hwpm_stream_sim [options]...\n"
+		"Run the HWPM stream notify logic against a synthetic PMA\n"
+		"  -t <s>     Run time in seconds (default: 2)\n"
+		"  -s <n>     Ring size in bytes (default: %u)\n"
+		"  -R <n>     Record size in bytes (default: %u)\n"
+		"  -r <n>     Producer rate in MB/s (default: %u)\n"
+		"  -f <n>     Fill threshold in bytes (default: ring size / 4)\n"
+		"  -p <us>    Notify sampling period (default: %u)\n"
+		"  -d <us>    Consumer processing time per wakeup (default: 0)\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"hwpm_stream_sim -t 2\n"
+		"hwpm_stream_sim -t 2 -r 800 -d 2000\n"
+		"hwpm_stream_sim -t 2 -p 100 -f 65536\n",
+		DEFAULT_RING_SIZE, DEFAULT_REC_SIZE, DEFAULT_RATE_MBS,
+		DEFAULT_PERIOD_US);
+}
+
+int main(int argc, char **argv)
+{
+	struct sim s = {
+		.ring_size = DEFAULT_RING_SIZE,
+		.rec_size = DEFAULT_REC_SIZE,
+		.rate_mbs = DEFAULT_RATE_MBS,
+		.period_us = DEFAULT_PERIOD_US,
+		.stream_lock = PTHREAD_MUTEX_INITIALIZER,
+		.stream_wq = PTHREAD_COND_INITIALIZER,
+	};
+	struct consumer_stats *cs;
+	pthread_t producer, notify, consumer;
+	double run_s = 2, start, t;
+	uint64_t unread;
+	int c, ret = 0;
+
+	while ((c = getopt(argc, argv, "t:s:R:r:f:p:d:?")) != -1) {
+		switch (c) {
+		case 't':
+			run_s = strtod(optarg, NULL);
+			break;
+		case 's':
+			s.ring_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			s.rec_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			s.rate_mbs = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			s.fill_threshold = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			s.period_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			s.consume_delay_us = strtoul(optarg, NULL, 0);
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (s.rec_size < sizeof(uint64_t) || s.ring_size % s.rec_size ||
+	    s.ring_size < 2 * s.rec_size) {
+		fprintf(stderr,
+			"Ring size must be a multiple of the record size,"
+			" records at least %zu bytes\n", sizeof(uint64_t));
+		return -1;
+	}
+	if (!s.fill_threshold)
+		s.fill_threshold = s.ring_size / 4;
+	if (!s.period_us || !s.rate_mbs) {
+		fprintf(stderr, "Period and rate must be non-zero\n");
+		return -1;
+	}
+
+	s.ring = calloc(1, s.ring_size);
+	if (!s.ring) {
+		fprintf(stderr, "Failed to allocate ring: %s\n",
+			strerror(errno));
+		return -1;
+	}
+	s.status.stream_buf_size = s.ring_size;
+
+	start = now_s();
+	pthread_create(&producer, NULL, producer_fn, &s);
+	pthread_create(&notify, NULL, notify_fn, &s);
+	pthread_create(&consumer, NULL, consumer_fn, &s);
+
+	sleep_us((uint32_t)(run_s * 1e6));
+	s.stop = true;
+
+	pthread_join(producer, NULL);
+	pthread_join(notify, NULL);
+	pthread_join(consumer, (void **)&cs);
+	t = now_s() - start;
+
+	printf("producer: %llu records, %llu dropped, %.1f MB/s offered\n",
+	       (unsigned long long)s.produced,
+	       (unsigned long long)s.dropped,
+	       s.produced * s.rec_size / t / 1e6);
+	printf("consumer: %llu records, %llu lost, %.1f MB/s, %llu wakeups"
+	       " (%.0f KB per wakeup)\n",
+	       (unsigned long long)cs->records, (unsigned long long)cs->lost,
+	       cs->bytes / t / 1e6, (unsigned long long)cs->wakeups,
+	       cs->wakeups ? cs->bytes / 1e3 / cs->wakeups : 0.0);
+	printf("status page: %llu overflows, %llu seq retries, %llu torn"
+	       " reads, %llu over-reported fills\n",
+	       (unsigned long long)cs->overflows_seen,
+	       (unsigned long long)cs->retries,
+	       (unsigned long long)cs->torn,
+	       (unsigned long long)cs->over_reports);
+
+	printf("wakeup latency: avg %.0f us, max %.0f us, period %u us\n",
+	       cs->wake_lat_n ? cs->wake_lat_sum / cs->wake_lat_n : 0.0,
+	       cs->wake_lat_max, s.period_us);
+
+	/* Records not consumed yet are either in the ring or dropped late */
+	unread = (s.put - s.get) / s.rec_size;
+	if (cs->lost + (s.produced - cs->next_seq - unread) != s.dropped) {
+		fprintf(stderr, "FAIL: %llu records lost, %llu dropped\n",
+			(unsigned long long)cs->lost,
+			(unsigned long long)s.dropped);
+		ret = 1;
+	}
+	if (cs->corrupt || cs->unexplained) {
+		fprintf(stderr, "FAIL: %llu corrupt records, %llu lost without"
+			" overflow\n", (unsigned long long)cs->corrupt,
+			(unsigned long long)cs->unexplained);
+		ret = 1;
+	}
+	if (cs->torn || cs->over_reports) {
+		fprintf(stderr, "FAIL: inconsistent status page reads\n");
+		ret = 1;
+	}
+	if (!ret)
+		printf("PASS\n");
+
+	free(cs);
+	free(s.ring);
+	return ret;
+}
@@ -0,0 +1,334 @@
+/*
+ * mttcan_loopback - send a mix of urgent and bulk CAN frames, read back the
+ * looped frames and report frames/s and latency per priority class.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * No bus or second node is needed. Put the controller in internal loopback
+ * mode so every frame goes through the Tx buffers, Tx event FIFO and Rx
+ * FIFOs of the mttcan driver:
+ *	ip link set can0 type can bitrate 1000000 loopback on
+ *	ip link set can0 up
+ * The socket receives its own frames back. The rx_ring_overruns sysfs
+ * attribute shows whether the Rx rings kept up. Frames with an ID below -P
+ * are urgent, the rest bulk; set the driver tx_prio_id sysfs knob to the
+ * same value to steer them, tx_latency then splits the driver side of the
+ * latency the same way. Any SocketCAN device works, e.g. vcan0 to check the
+ * tool itself.
+ *
+ * Build:
+ *	cc -O2 -o mttcan_loopback mttcan_loopback.c
+ *
+ * Example Usage:
+ *	mttcan_loopback -i can0 -n 100000
+ *	mttcan_loopback -i can0 -n 100000 -q 32 -r 4 -P 0x100
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#define DEFAULT_IFACE		"can0"
+#define DEFAULT_URGENT_ID	0x010
+#define DEFAULT_BULK_ID		0x600
+#define DEFAULT_PRIO_ID		0x100
+#define MAX_DEPTH		64
+
+enum { CLASS_URGENT, CLASS_BULK, CLASS_MAX };
+
+static const char * const class_names[CLASS_MAX] = { "urgent", "bulk" };
+
+struct id_stats {
+	uint32_t id;
+	unsigned long sent, received, reordered;
+	uint32_t next_seq;
+	double *lat;
+};
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	return (da > db) - (da < db);
+}
+
+static void report_id(const char *name, struct id_stats *cs)
+{
+	double sum = 0;
+	unsigned long i, n = cs->received;
+
+	if (!n) {
+		fprintf(stdout, "%-7s id 0x%03x: %lu sent, none received\n",
+			name, cs->id, cs->sent);
+		return;
+	}
+
+	qsort(cs->lat, n, sizeof(*cs->lat), cmp_double);
+	for (i = 0; i < n; i++)
+		sum += cs->lat[i];
+
+	fprintf(stdout, "%-7s id 0x%03x: %lu frames, latency avg %.1f us, "
+		"p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		name, cs->id, n, sum / n * 1e6, cs->lat[n / 2] * 1e6,
+		cs->lat[n * 99 / 100] * 1e6, cs->lat[n - 1] * 1e6);
+}
+
+static int open_socket(const char *iface)
+{
+	struct sockaddr_can addr = { .can_family = AF_CAN };
+	struct ifreq ifr;
+	int fd, on = 1;
+
+	fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open CAN socket: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, iface, IFNAMSIZ - 1);
+	if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+		fprintf(stderr, "No interface %s: %s\n", iface,
+			strerror(errno));
+		close(fd);
+		return -1;
+	}
+	addr.can_ifindex = ifr.ifr_ifindex;
+
+	/* Our own frames are the loopback echo */
+	setsockopt(fd, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &on, sizeof(on));
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "Failed to bind to %s: %s\n", iface,
+			strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int run(int fd, unsigned long total, unsigned int depth,
+	       unsigned int ratio, uint32_t prio_id,
+	       struct id_stats *cls)
+{
+	double *sent_at;
+	double start, t;
+	unsigned long sent = 0, done = 0, lost = 0;
+	struct can_frame frame;
+	struct id_stats *cs;
+	struct pollfd pfd = { .fd = fd };
+	uint32_t seq, idx;
+	ssize_t ret;
+
+	sent_at = calloc(total, sizeof(*sent_at));
+	if (!sent_at)
+		return -1;
+
+	start = now_s();
+
+	while (done + lost < total) {
+		/* keep up to 'depth' frames in flight */
+		while (sent < total && sent - done - lost < depth) {
+			/* one urgent frame for every 'ratio' bulk frames */
+			cs = &cls[(sent % (ratio + 1)) ? CLASS_BULK :
+				  CLASS_URGENT];
+
+			/* per-ID seq and frame index travel in the payload */
+			memset(&frame, 0, sizeof(frame));
+			frame.can_id = cs->id;
+			frame.can_dlc = CAN_MAX_DLEN;
+			seq = cs->sent;
+			idx = (uint32_t)sent;
+			memcpy(frame.data, &seq, sizeof(seq));
+			memcpy(frame.data + 4, &idx, sizeof(idx));
+
+			sent_at[sent] = now_s();
+			ret = write(fd, &frame, sizeof(frame));
+			if (ret < 0 && errno == ENOBUFS) {
+				/* Tx queue full, let completions drain it */
+				pfd.events = POLLOUT;
+				poll(&pfd, 1, 10);
+				break;
+			}
+			if (ret != sizeof(frame)) {
+				fprintf(stderr, "write failed: %s\n",
+					ret < 0 ? strerror(errno) : "short");
+				goto fail;
+			}
+			cs->sent++;
+			sent++;
+		}
+
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, 1000) <= 0) {
+			/* Nothing came back for a second, count as lost */
+			lost = sent - done;
+			fprintf(stderr, "%lu frames not looped back\n", lost);
+			break;
+		}
+
+		ret = read(fd, &frame, sizeof(frame));
+		if (ret != sizeof(frame)) {
+			fprintf(stderr, "read failed: %s\n",
+				ret < 0 ? strerror(errno) : "bad length");
+			goto fail;
+		}
+
+		t = now_s();
+		cs = (frame.can_id & CAN_SFF_MASK) < prio_id ?
+			&cls[CLASS_URGENT] : &cls[CLASS_BULK];
+		memcpy(&seq, frame.data, sizeof(seq));
+		memcpy(&idx, frame.data + 4, sizeof(idx));
+		if (idx >= sent) {
+			fprintf(stderr, "Unexpected frame id 0x%x\n",
+				frame.can_id);
+			continue;
+		}
+
+		/* frames with the same ID must never overtake each other */
+		if (seq != cs->next_seq)
+			cs->reordered++;
+		cs->next_seq = seq + 1;
+
+		cs->lat[cs->received++] = t - sent_at[idx];
+		done++;
+	}
+
+	t = now_s() - start;
+	fprintf(stdout, "frames: %lu in %.3f s, %.0f frames/s, depth %u, "
+		"%u bulk per urgent\n", done, t, done / t, depth, ratio);
+	report_id(class_names[CLASS_URGENT], &cls[CLASS_URGENT]);
+	report_id(class_names[CLASS_BULK], &cls[CLASS_BULK]);
+
+	free(sent_at);
+	if (lost || cls[CLASS_URGENT].reordered || cls[CLASS_BULK].reordered) {
+		fprintf(stderr, "FAIL: %lu lost, %lu/%lu out of order\n", lost,
+			cls[CLASS_URGENT].reordered, cls[CLASS_BULK].reordered);
+		return 1;
+	}
+	return 0;
+
+fail:
+	free(sent_at);
+	return -1;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: mttcan_loopback [options]...\n"
+		"Send urgent and bulk frames and read back the loopback echo\n"
+		"  -i <name>  CAN interface (default: %s)\n"
+		"  -n <n>     Number of frames (default: 100000)\n"
+		"  -q <n>     Frames in flight, 1 to %d (default: 16)\n"
+		"  -r <n>     Bulk frames per urgent frame (default: 8)\n"
+		"  -u <id>    Urgent frame ID (default: 0x%03x)\n"
+		"  -b <id>    Bulk frame ID (default: 0x%03x)\n"
+		"  -P <id>    IDs below this are urgent (default: 0x%03x)\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"mttcan_loopback -i can0 -n 100000\n"
+		"mttcan_loopback -i can0 -n 100000 -q 32 -r 4 -P 0x100\n",
+		DEFAULT_IFACE, MAX_DEPTH, DEFAULT_URGENT_ID, DEFAULT_BULK_ID,
+		DEFAULT_PRIO_ID);
+}
+
+int main(int argc, char **argv)
+{
+	struct id_stats cls[CLASS_MAX] = {
+		[CLASS_URGENT] = { .id = DEFAULT_URGENT_ID },
+		[CLASS_BULK] = { .id = DEFAULT_BULK_ID },
+	};
+	const char *iface = DEFAULT_IFACE;
+	unsigned long total = 100000;
+	unsigned int depth = 16, ratio = 8;
+	uint32_t prio_id = DEFAULT_PRIO_ID;
+	int fd, c, ret;
+
+	while ((c = getopt(argc, argv, "i:n:q:r:u:b:P:?")) != -1) {
+		switch (c) {
+		case 'i':
+			iface = optarg;
+			break;
+		case 'n':
+			total = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			ratio = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			cls[CLASS_URGENT].id = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			cls[CLASS_BULK].id = strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			prio_id = strtoul(optarg, NULL, 0);
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (!depth || depth > MAX_DEPTH) {
+		fprintf(stderr, "Depth must be 1 to %d\n", MAX_DEPTH);
+		return -1;
+	}
+	if (cls[CLASS_URGENT].id >= prio_id || cls[CLASS_BULK].id < prio_id ||
+	    cls[CLASS_BULK].id > CAN_SFF_MASK) {
+		fprintf(stderr, "Urgent ID must be below 0x%x, bulk ID from "
+			"0x%x to 0x%x\n", prio_id, prio_id, CAN_SFF_MASK);
+		return -1;
+	}
+	if (!total)
+		return 0;
+
+	cls[CLASS_URGENT].lat = calloc(total, sizeof(double));
+	cls[CLASS_BULK].lat = calloc(total, sizeof(double));
+	if (!cls[CLASS_URGENT].lat || !cls[CLASS_BULK].lat) {
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+
+	fd = open_socket(iface);
+	if (fd < 0)
+		return -1;
+
+	ret = run(fd, total, depth, ratio, prio_id, cls);
+
+	close(fd);
+	free(cls[CLASS_URGENT].lat);
+	free(cls[CLASS_BULK].lat);
+	return ret;
+}
@@ -0,0 +1,592 @@
+/*
+ * podgov_replay - replay a GPU work trace through a model of the
+ * pod_scaling_v2 devfreq governor and compare the reactive and predictive
+ * modes by deadline misses and an energy estimate.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * The governor model follows nvhost_pod_estimate_freq(),
+ * scaling_state_check() and podgov_predict_freq() in
+ * drivers/devfreq/governor_pod_scaling_v2.c and must be kept in sync with
+ * them. No device is needed. The trace is a text file with one job per line,
+ * "<arrival_us> <mcycles>", with '#' starting a comment. Jobs run in order
+ * on one engine at the frequency the governor picked for that sample. A job
+ * misses when it finishes later than its deadline after arrival. Without a
+ * trace, a periodic frame workload with jitter is generated.
+ *
+ * Energy is the dynamic energy of the work with voltage taken as linear in
+ * frequency (f^2 per cycle), relative to running all of it at the maximum
+ * frequency.
+ *
+ * Build:
+ *	cc -O2 -o podgov_replay podgov_replay.c
+ *
+ * Example Usage:
+ *	podgov_replay -p 16667 -w 6 -j 500 -n 600
+ *	podgov_replay -t gpu_jobs.txt -d 16667 -i 4000
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+
+#define MAX_FREQS		64
+#define MAX_HISTORY_BUF_SIZE	100
+
+struct job {
+	int64_t arrival_us;
+	double mcycles;
+};
+
+/* governor tunables, defaults from nvhost_pod_init() */
+struct podgov_params {
+	unsigned int block_window;
+	unsigned int smooth;
+	int damp;
+	int load_max;
+	int load_target;
+	int bias;
+	int history_buf_size;
+	unsigned int predict;
+	unsigned int predict_idle;
+};
+
+/* subset of struct podgov_info_rec used by the estimate path */
+struct podgov_state {
+	int64_t last_scale;
+	unsigned long cycles_avg;
+	unsigned long cycles_history_buf[MAX_HISTORY_BUF_SIZE];
+	int history_next;
+	int history_count;
+	unsigned long recent_high;
+	unsigned long rt_load;
+	long freq_avg;
+
+	int64_t last_sample;
+	int64_t sample_us_avg;
+	bool in_burst;
+	int64_t burst_start;
+	int64_t period_us_avg;
+	int64_t period_us_dev;
+	uint64_t burst_work;
+	uint64_t burst_work_avg;
+};
+
+struct sim_result {
+	unsigned long jobs;
+	unsigned long misses;
+	double lat_sum_us;
+	double lat_max_us;
+	double freq_time;
+	double energy;
+	double span_us;
+	unsigned long switches;
+};
+
+static unsigned long freqlist[MAX_FREQS];
+static int freq_count;
+
+static void scaling_limit(unsigned long *freq)
+{
+	if (*freq < freqlist[0])
+		*freq = freqlist[0];
+	else if (*freq > freqlist[freq_count - 1])
+		*freq = freqlist[freq_count - 1];
+}
+
+static unsigned long freqlist_up(unsigned long target)
+{
+	int i;
+
+	for (i = 0; i < freq_count; i++)
+		if (freqlist[i] >= target)
+			break;
+
+	return freqlist[i < freq_count ? i : freq_count - 1];
+}
+
+static unsigned long scaling_state_check(const struct podgov_params *p,
+					 struct podgov_state *pg, int64_t now,
+					 unsigned long prev_freq)
+{
+	unsigned long busyness;
+	long max_boost, damp, freq, boost, res;
+	unsigned long out;
+
+	if (now - pg->last_scale < p->block_window || prev_freq == 0)
+		return 0;
+
+	freq = prev_freq / 1000000;
+	max_boost = (freqlist[freq_count - 1] / 3) / 1000000;
+
+	busyness = 1000ULL * pg->cycles_avg / prev_freq;
+	if (p->history_buf_size && pg->history_count)
+		busyness = 1000ULL * pg->recent_high / prev_freq;
+
+	damp = p->damp;
+
+	if (pg->rt_load > (unsigned long)p->load_max) {
+		boost = max_boost;
+		damp = 10;
+	} else {
+		boost = (long)busyness - p->load_target;
+		boost *= (p->bias * freq);
+		boost /= (100 * p->load_target);
+		boost = (boost < max_boost) ? boost : max_boost;
+	}
+
+	res = freq + boost;
+
+	pg->freq_avg = (pg->freq_avg * p->smooth) + res;
+	pg->freq_avg /= (p->smooth + 1);
+
+	res = ((damp * res) + ((10 - damp) * pg->freq_avg)) / 10;
+
+	out = res > 0 ? res * 1000000UL : 0;
+	scaling_limit(&out);
+	return out;
+}
+
+static unsigned long podgov_predict_freq(const struct podgov_params *p,
+					 struct podgov_state *pg, int64_t now,
+					 unsigned long cur_freq,
+					 unsigned long norm_load)
+{
+	bool busy = pg->rt_load > p->predict_idle;
+	int64_t sample_us = 0, period_us, err, since_us, until_us;
+	unsigned long res, burst_freq = 0;
+
+	if (pg->last_sample) {
+		sample_us = now - pg->last_sample;
+		if (pg->sample_us_avg)
+			pg->sample_us_avg += (sample_us - pg->sample_us_avg) / 8;
+		else
+			pg->sample_us_avg = sample_us;
+	}
+	pg->last_sample = now;
+
+	/* frequency that finishes a typical burst within its period */
+	if (pg->period_us_avg > 0 && pg->burst_work_avg)
+		burst_freq = pg->burst_work_avg / pg->period_us_avg *
+			     1000 / p->load_target;
+
+	if (busy && !pg->in_burst) {
+		if (pg->burst_start) {
+			period_us = now - pg->burst_start;
+			if (!pg->period_us_avg) {
+				pg->period_us_avg = period_us;
+				pg->period_us_dev = period_us / 2;
+			} else {
+				err = period_us - pg->period_us_avg;
+				pg->period_us_avg += err / 8;
+				pg->period_us_dev +=
+					(llabs(err) - pg->period_us_dev) / 4;
+			}
+		}
+		pg->burst_start = now;
+		pg->burst_work = 0;
+		pg->in_burst = true;
+	}
+
+	if (busy) {
+		pg->burst_work += (uint64_t)norm_load * sample_us;
+		/* burst came early or was not expected, catch up at once */
+		if (burst_freq > cur_freq) {
+			res = burst_freq;
+			goto out;
+		}
+		return 0;
+	}
+
+	if (pg->in_burst) {
+		/* burst ended: update typical work per burst */
+		pg->in_burst = false;
+		if (pg->burst_work_avg)
+			pg->burst_work_avg = pg->burst_work_avg -
+				pg->burst_work_avg / 4 + pg->burst_work / 4;
+		else
+			pg->burst_work_avg = pg->burst_work;
+	}
+
+	/* periodic if deviation is within a quarter of the period */
+	if (burst_freq && pg->sample_us_avg > 0 &&
+	    pg->period_us_dev * 4 < pg->period_us_avg) {
+		since_us = now - pg->burst_start;
+		/* stream stopped, do not boost for missed bursts forever */
+		if (since_us < 4 * pg->period_us_avg) {
+			until_us = since_us % pg->period_us_avg;
+			until_us = pg->period_us_avg - until_us;
+			if (until_us <= pg->sample_us_avg) {
+				res = burst_freq;
+				goto out;
+			}
+		}
+	}
+
+	/* idle gap: drop without smoothing */
+	res = (uint64_t)norm_load * 1000 / p->load_target;
+
+out:
+	scaling_limit(&res);
+	pg->freq_avg = res / 1000000;
+
+	return res ? res : 1;
+}
+
+/* one devfreq polling period, returns the next frequency */
+static unsigned long podgov_estimate_freq(const struct podgov_params *p,
+					  struct podgov_state *pg, int64_t now,
+					  unsigned long cur_freq,
+					  int64_t busy_us, int64_t total_us)
+{
+	unsigned long norm_load, freq = 0;
+	int buf_size = p->history_buf_size;
+	bool predicted = false;
+	int i;
+
+	norm_load = (uint64_t)cur_freq * busy_us / total_us;
+	pg->cycles_avg = ((uint64_t)pg->cycles_avg * p->smooth + norm_load) /
+		(p->smooth + 1);
+	pg->rt_load = 1000ULL * busy_us / total_us;
+
+	if (buf_size) {
+		if (pg->history_count == buf_size) {
+			pg->recent_high = 0;
+			i = (pg->history_next + 1) % buf_size;
+			for (; i != pg->history_next; i = (i + 1) % buf_size) {
+				if (pg->cycles_history_buf[i] > pg->recent_high)
+					pg->recent_high =
+						pg->cycles_history_buf[i];
+			}
+		}
+		pg->cycles_history_buf[pg->history_next] = norm_load;
+		pg->history_next = (pg->history_next + 1) % buf_size;
+		if (pg->history_count < buf_size)
+			pg->history_count++;
+		if (norm_load > pg->recent_high)
+			pg->recent_high = norm_load;
+	}
+
+	if (p->predict)
+		freq = podgov_predict_freq(p, pg, now, cur_freq, norm_load);
+	if (freq) {
+		predicted = true;
+	} else {
+		freq = scaling_state_check(p, pg, now, cur_freq);
+		if (!freq)
+			return cur_freq;
+	}
+
+	freq = freqlist_up(freq);
+	if (freq != cur_freq && !predicted)
+		pg->last_scale = now;
+
+	return freq;
+}
+
+static void simulate(const struct podgov_params *p, const struct job *jobs,
+		     unsigned long njobs, int64_t interval_us,
+		     int64_t deadline_us, struct sim_result *r)
+{
+	struct podgov_state pg;
+	unsigned long freq = freqlist[0], next = 0, head = 0;
+	double fmax = freqlist[freq_count - 1] / 1e6;
+	double left = njobs ? jobs[0].mcycles : 0;
+	double cursor = 0, mhz, rate, start, run, lat;
+	int64_t now = 0, end, busy_us;
+	double busy;
+
+	memset(&pg, 0, sizeof(pg));
+	memset(r, 0, sizeof(*r));
+
+	while (head < njobs) {
+		end = now + interval_us;
+		mhz = freq / 1e6;
+		rate = mhz / 1e6;	/* Mcycles per us */
+		busy = 0;
+
+		/* run the queue in arrival order at this sample's frequency */
+		if (cursor < now)
+			cursor = now;
+		while (head < njobs && cursor < end) {
+			start = cursor > jobs[head].arrival_us ?
+				cursor : jobs[head].arrival_us;
+			if (start >= end)
+				break;
+			run = left / rate;
+			if (start + run > end) {
+				left -= (end - start) * rate;
+				busy += end - start;
+				cursor = end;
+				break;
+			}
+			busy += run;
+			cursor = start + run;
+			lat = cursor - jobs[head].arrival_us;
+			r->lat_sum_us += lat;
+			if (lat > r->lat_max_us)
+				r->lat_max_us = lat;
+			if (lat > deadline_us)
+				r->misses++;
+			r->jobs++;
+			if (++head < njobs)
+				left = jobs[head].mcycles;
+		}
+
+		r->freq_time += mhz * interval_us;
+		r->energy += busy * rate * (mhz / fmax) * (mhz / fmax);
+
+		busy_us = (int64_t)(busy + 0.5);
+		if (busy_us > interval_us)
+			busy_us = interval_us;
+
+		next = podgov_estimate_freq(p, &pg, end, freq, busy_us,
+					    interval_us);
+		if (next != freq)
+			r->switches++;
+		freq = next;
+		now = end;
+	}
+
+	r->span_us = now;
+}
+
+static void report(const char *name, const struct sim_result *r,
+		   double total_mcycles)
+{
+	fprintf(stdout,
+		"%-10s %8lu %7.2f%% %10.0f %10.0f %8.0f %8lu %7.3f\n",
+		name, r->misses, r->jobs ? 100.0 * r->misses / r->jobs : 0,
+		r->jobs ? r->lat_sum_us / r->jobs : 0, r->lat_max_us,
+		r->span_us ? r->freq_time / r->span_us : 0, r->switches,
+		total_mcycles ? r->energy / total_mcycles : 0);
+}
+
+static struct job *load_trace(const char *path, unsigned long *njobs)
+{
+	struct job *jobs = NULL, *tmp;
+	unsigned long n = 0, size = 0;
+	char line[256];
+	long long t;
+	double mc;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", path,
+			strerror(errno));
+		return NULL;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || sscanf(line, "%lld %lf", &t, &mc) != 2)
+			continue;
+		if (n && t < jobs[n - 1].arrival_us) {
+			fprintf(stderr, "%s: arrivals must be in order\n", path);
+			goto fail;
+		}
+		if (n == size) {
+			size = size ? size * 2 : 1024;
+			tmp = realloc(jobs, size * sizeof(*jobs));
+			if (!tmp)
+				goto fail;
+			jobs = tmp;
+		}
+		jobs[n].arrival_us = t;
+		jobs[n].mcycles = mc;
+		n++;
+	}
+
+	fclose(f);
+	*njobs = n;
+	return jobs;
+
+fail:
+	fclose(f);
+	free(jobs);
+	return NULL;
+}
+
+static struct job *gen_frames(unsigned long frames, int64_t period_us,
+			      double mcycles, int64_t jitter_us)
+{
+	struct job *jobs;
+	unsigned long i;
+	int64_t j = 0;
+
+	jobs = calloc(frames, sizeof(*jobs));
+	if (!jobs)
+		return NULL;
+
+	srand(1);
+	for (i = 0; i < frames; i++) {
+		if (jitter_us)
+			j = rand() % (2 * jitter_us + 1) - jitter_us;
+		jobs[i].arrival_us = period_us + i * period_us + j;
+		if (i && jobs[i].arrival_us < jobs[i - 1].arrival_us)
+			jobs[i].arrival_us = jobs[i - 1].arrival_us;
+		/* +-10% work per frame */
+		jobs[i].mcycles = mcycles * (0.9 + (rand() % 201) / 1000.0);
+	}
+
+	return jobs;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: podgov_replay [options]...\n"
+		"Replay a work trace through the pod_scaling_v2 governor model\n"
+		"  -t <file>  Trace of \"<arrival_us> <mcycles>\" lines\n"
+		"  -p <us>    Synthetic frame period (default: 16667)\n"
+		"  -w <n>     Synthetic work per frame in Mcycles (default: 4)\n"
+		"  -j <us>    Synthetic arrival jitter (default: 500)\n"
+		"  -n <n>     Synthetic frames (default: 600)\n"
+		"  -d <us>    Deadline after arrival (default: frame period)\n"
+		"  -i <us>    Governor polling interval (default: 4000)\n"
+		"  -m <MHz>   Lowest frequency (default: 100)\n"
+		"  -M <MHz>   Highest frequency (default: 1000)\n"
+		"  -k <n>     Frequency steps, 2 to %d (default: 10)\n"
+		"  -H <n>     History buffer size, 0 to %d (default: 0)\n"
+		"  -b <us>    Block window (default: 50000)\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"podgov_replay -p 16667 -w 6 -j 500 -n 600\n"
+		"podgov_replay -t gpu_jobs.txt -d 16667 -i 4000\n",
+		MAX_FREQS, MAX_HISTORY_BUF_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+	struct podgov_params p = {
+		.block_window = 50000,
+		.smooth = 10,
+		.damp = 7,
+		.load_max = 900,
+		.load_target = 700,
+		.bias = 80,
+		.history_buf_size = 0,
+		.predict = 0,
+		.predict_idle = 100,
+	};
+	const char *trace = NULL;
+	unsigned long frames = 600, njobs = 0, i;
+	int64_t period_us = 16667, jitter_us = 500, deadline_us = 0;
+	int64_t interval_us = 4000;
+	double mcycles = 4, fmin = 100, fmax = 1000, total = 0;
+	struct sim_result r;
+	struct job *jobs;
+	int steps = 10, c;
+
+	while ((c = getopt(argc, argv, "t:p:w:j:n:d:i:m:M:k:H:b:?")) != -1) {
+		switch (c) {
+		case 't':
+			trace = optarg;
+			break;
+		case 'p':
+			period_us = strtoll(optarg, NULL, 0);
+			break;
+		case 'w':
+			mcycles = strtod(optarg, NULL);
+			break;
+		case 'j':
+			jitter_us = strtoll(optarg, NULL, 0);
+			break;
+		case 'n':
+			frames = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			deadline_us = strtoll(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval_us = strtoll(optarg, NULL, 0);
+			break;
+		case 'm':
+			fmin = strtod(optarg, NULL);
+			break;
+		case 'M':
+			fmax = strtod(optarg, NULL);
+			break;
+		case 'k':
+			steps = strtol(optarg, NULL, 0);
+			break;
+		case 'H':
+			p.history_buf_size = strtol(optarg, NULL, 0);
+			break;
+		case 'b':
+			p.block_window = strtoul(optarg, NULL, 0);
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (steps < 2 || steps > MAX_FREQS || fmin <= 0 || fmax <= fmin) {
+		fprintf(stderr, "Bad frequency range\n");
+		return -1;
+	}
+	if (p.history_buf_size < 0 ||
+	    p.history_buf_size > MAX_HISTORY_BUF_SIZE) {
+		fprintf(stderr, "History buffer size must be 0 to %d\n",
+			MAX_HISTORY_BUF_SIZE);
+		return -1;
+	}
+	if (interval_us <= 0 || period_us <= 0 || jitter_us < 0 ||
+	    jitter_us >= period_us) {
+		fprintf(stderr, "Bad interval, period or jitter\n");
+		return -1;
+	}
+
+	freq_count = steps;
+	for (i = 0; i < (unsigned long)steps; i++)
+		freqlist[i] = (fmin + (fmax - fmin) * i / (steps - 1)) * 1e6;
+
+	if (trace)
+		jobs = load_trace(trace, &njobs);
+	else {
+		jobs = gen_frames(frames, period_us, mcycles, jitter_us);
+		njobs = frames;
+	}
+	if (!jobs)
+		return -1;
+	if (!njobs) {
+		fprintf(stderr, "No jobs\n");
+		free(jobs);
+		return -1;
+	}
+	if (!deadline_us)
+		deadline_us = period_us;
+
+	for (i = 0; i < njobs; i++)
+		total += jobs[i].mcycles;
+
+	fprintf(stdout, "%lu jobs, %.1f Mcycles, deadline %lld us, "
+		"polling %lld us, %d steps %.0f-%.0f MHz\n",
+		njobs, total, (long long)deadline_us, (long long)interval_us,
+		freq_count, fmin, fmax);
+	fprintf(stdout, "%-10s %8s %8s %10s %10s %8s %8s %7s\n", "mode",
+		"misses", "", "avg lat", "max lat", "avg MHz", "switches",
+		"energy");
+
+	p.predict = 0;
+	simulate(&p, jobs, njobs, interval_us, deadline_us, &r);
+	report("reactive", &r, total);
+
+	p.predict = 1;
+	simulate(&p, jobs, njobs, interval_us, deadline_us, &r);
+	report("predictive", &r, total);
+
+	free(jobs);
+	return 0;
+}
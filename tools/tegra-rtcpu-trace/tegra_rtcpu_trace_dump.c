@@ -0,0 +1,363 @@
+/*
+ * tegra_rtcpu_trace_dump - decode camera RTCPU trace events from the raw
+ * trace ring, either live through debugfs or from a saved ring image.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Build:
+ *	cc -I../../include -o tegra_rtcpu_trace_dump tegra_rtcpu_trace_dump.c
+ *
+ * Example Usage:
+ *	tegra_rtcpu_trace_dump -d /sys/kernel/debug/tegra_rtcpu_trace/raw
+ *	tegra_rtcpu_trace_dump -f ring.bin -s 0
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "soc/tegra/camrtc-trace.h"
+#include "uapi/linux/tegra-rtcpu-trace.h"
+
+#define TYPE_ALL	(-1)
+
+struct trace_ring {
+	const uint8_t *base;
+	size_t size;
+	uint32_t event_offset;
+	uint32_t event_size;
+	uint32_t event_entries;
+};
+
+static const char * const type_names[] = {
+	"array", "exception", "pad", "start", "string", "bulk",
+};
+
+static int ring_setup(struct trace_ring *ring, const void *base, size_t size)
+{
+	const struct camrtc_trace_memory_header *header = base;
+
+	if (size < sizeof(*header))
+		return -EINVAL;
+
+	ring->base = base;
+	ring->size = size;
+	ring->event_offset = header->event_offset;
+	ring->event_size = header->event_size;
+	ring->event_entries = header->event_entries;
+
+	if (ring->event_size < CAMRTC_TRACE_EVENT_HEADER_SIZE ||
+	    ring->event_size > sizeof(struct camrtc_event_struct) ||
+	    ring->event_entries == 0 ||
+	    ring->event_offset + (uint64_t)ring->event_size *
+	    ring->event_entries > size) {
+		fprintf(stderr, "Bad trace header: offset 0x%x size %u "
+			"entries %u in %zu bytes\n", ring->event_offset,
+			ring->event_size, ring->event_entries, size);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void decode_event(const struct camrtc_event_struct *event)
+{
+	uint32_t id = event->header.id;
+	uint32_t type = CAMRTC_EVENT_TYPE_FROM_ID(id);
+	uint32_t len = event->header.len;
+	uint32_t payload, i;
+
+	if (len < CAMRTC_TRACE_EVENT_HEADER_SIZE ||
+	    len > sizeof(struct camrtc_event_struct))
+		len = CAMRTC_TRACE_EVENT_HEADER_SIZE;
+	payload = len - CAMRTC_TRACE_EVENT_HEADER_SIZE;
+
+	fprintf(stdout, "%20" PRIu64 " %-9s mod %3u sub 0x%04x",
+		event->header.tstamp,
+		type < sizeof(type_names) / sizeof(type_names[0]) ?
+			type_names[type] : "unknown",
+		CAMRTC_EVENT_MODULE_FROM_ID(id),
+		CAMRTC_EVENT_SUBID_FROM_ID(id));
+
+	switch (type) {
+	case CAMRTC_EVENT_TYPE_ARRAY:
+		for (i = 0; i < payload / 4; i++)
+			fprintf(stdout, " 0x%08x", event->data.data32[i]);
+		break;
+	case CAMRTC_EVENT_TYPE_STRING:
+		fprintf(stdout, " %.*s", (int)strnlen(
+			(const char *)event->data.data8, payload),
+			(const char *)event->data.data8);
+		break;
+	case CAMRTC_EVENT_TYPE_PAD:
+	case CAMRTC_EVENT_TYPE_START:
+		break;
+	default:
+		for (i = 0; i < payload; i++)
+			fprintf(stdout, " %02x", event->data.data8[i]);
+		break;
+	}
+
+	fprintf(stdout, "\n");
+}
+
+/*
+ * Decode entries [from, to) of the ring, wrapping at the end. Events whose
+ * type does not match the filter are skipped without touching the payload.
+ */
+static uint64_t decode_range(const struct trace_ring *ring, uint32_t from,
+			     uint32_t to, int type_filter)
+{
+	struct camrtc_event_struct event;
+	uint64_t n = 0;
+
+	while (from != to) {
+		const uint8_t *entry = ring->base + ring->event_offset +
+			(size_t)from * ring->event_size;
+
+		memcpy(&event.header, entry, sizeof(event.header));
+		if (type_filter == TYPE_ALL ||
+		    CAMRTC_EVENT_TYPE_FROM_ID(event.header.id) ==
+		    (uint32_t)type_filter) {
+			memcpy(&event, entry, ring->event_size);
+			decode_event(&event);
+			n++;
+		}
+
+		if (++from == ring->event_entries)
+			from = 0;
+	}
+
+	return n;
+}
+
+static int dump_image(const char *path, uint32_t start, int type_filter)
+{
+	struct trace_ring ring;
+	const struct camrtc_trace_memory_header *header;
+	struct stat st;
+	void *base;
+	int fd, ret;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perror("Failed to open ring image");
+		return -errno;
+	}
+
+	if (fstat(fd, &st) == -1) {
+		ret = -errno;
+		perror("Failed to stat ring image");
+		goto exit_close;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		ret = -errno;
+		perror("Failed to map ring image");
+		goto exit_close;
+	}
+
+	ret = ring_setup(&ring, base, st.st_size);
+	if (ret == 0) {
+		header = base;
+		if (start >= ring.event_entries ||
+		    header->event_next_idx >= ring.event_entries) {
+			fprintf(stderr, "Index outside 0..%u\n",
+				ring.event_entries - 1);
+			ret = -EINVAL;
+		} else {
+			decode_range(&ring, start, header->event_next_idx,
+				     type_filter);
+		}
+	}
+
+	munmap(base, st.st_size);
+exit_close:
+	close(fd);
+	return ret;
+}
+
+static int map_live(int fd, struct trace_ring *ring)
+{
+	const struct camrtc_trace_memory_header *header;
+	long page = sysconf(_SC_PAGESIZE);
+	size_t size;
+	void *base;
+
+	/* map the header first to learn the full ring size */
+	base = mmap(NULL, page, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+		return -errno;
+
+	header = base;
+	size = header->event_offset +
+		(size_t)header->event_size * header->event_entries;
+	munmap(base, page);
+
+	base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+		return -errno;
+
+	return ring_setup(ring, base, size);
+}
+
+static int monitor_live(const char *path, unsigned int loops, int type_filter)
+{
+	struct trace_ring ring;
+	struct rtcpu_trace_raw_pos pos;
+	struct pollfd pfd;
+	uint64_t last_seq = 0, lost;
+	uint32_t last;
+	bool have_seq = false;
+	unsigned int i = 0;
+	int fd, ret;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perror("Failed to open raw trace file");
+		return -errno;
+	}
+
+	ret = map_live(fd, &ring);
+	if (ret) {
+		fprintf(stderr, "Failed to map trace ring (%d)\n", ret);
+		goto exit_close;
+	}
+
+	last = ((const struct camrtc_trace_memory_header *)ring.base)->
+		event_next_idx;
+	if (last >= ring.event_entries)
+		last = 0;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	while (1) {
+		ret = poll(&pfd, 1, -1);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			perror("Failed to poll raw trace file");
+			break;
+		}
+
+		ret = read(fd, &pos, sizeof(pos));
+		if (ret != sizeof(pos)) {
+			ret = ret == -1 ? -errno : -EIO;
+			fprintf(stderr, "Failed to read trace index (%d)\n",
+				ret);
+			break;
+		}
+
+		if (pos.idx >= ring.event_entries) {
+			fprintf(stderr, "Index %u outside ring\n", pos.idx);
+			ret = -EIO;
+			break;
+		}
+
+		/*
+		 * The ring holds at most event_entries - 1 unread events.
+		 * Anything older has been overwritten, so skip to the oldest
+		 * entry still in place.
+		 */
+		if (have_seq && pos.seq - last_seq >= ring.event_entries) {
+			lost = pos.seq - last_seq - (ring.event_entries - 1);
+			fprintf(stderr, "Ring overrun, %" PRIu64
+				" events lost\n", lost);
+			last = pos.idx + 1;
+			if (last == ring.event_entries)
+				last = 0;
+		}
+
+		decode_range(&ring, last, pos.idx, type_filter);
+		last = pos.idx;
+		last_seq = pos.seq;
+		have_seq = true;
+		ret = 0;
+
+		i++;
+		if (i == loops)
+			break;
+	}
+
+	munmap((void *)ring.base, ring.size);
+exit_close:
+	close(fd);
+	return ret;
+}
+
+void print_usage(char *bin_name)
+{
+	fprintf(stderr, "Usage: %s [options]...\n"
+		"Decode camera RTCPU trace events from the raw trace ring\n"
+		"  -d <path>  Follow the live ring through the debugfs raw file\n"
+		"  -f <path>  Decode a saved ring image instead\n"
+		" [-s <n>]    First entry to decode from an image (default 0)\n"
+		" [-t <n>]    Only decode events of type <n>\n"
+		" [-c <n>]    Do <n> wakeups (optional, infinite loop if not stated)\n"
+		"  -h         This helptext\n"
+		"\n"
+		"Example:\n"
+		"%s -d /sys/kernel/debug/tegra_rtcpu_trace/raw -t 4\n"
+		"(means follow the live ring and print string events only)\n",
+		bin_name, bin_name
+	);
+}
+
+int main(int argc, char **argv)
+{
+	const char *device_path = NULL;
+	const char *image_path = NULL;
+	unsigned int loops = 0;
+	uint32_t start = 0;
+	int type_filter = TYPE_ALL;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:d:f:s:t:h")) != -1) {
+		switch (c) {
+		case 'c':
+			loops = strtoul(optarg, NULL, 10);
+			break;
+		case 'd':
+			device_path = optarg;
+			break;
+		case 'f':
+			image_path = optarg;
+			break;
+		case 's':
+			start = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			type_filter = strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!device_path == !image_path) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (image_path)
+		return dump_image(image_path, start, type_filter);
+
+	return monitor_live(device_path, loops, type_filter);
+}
@@ -0,0 +1,405 @@
+/*
+ * tegra_rtcpu_trace_gen - write a synthetic camera RTCPU trace ring image
+ * and the decode tegra_rtcpu_trace_dump is expected to print for it.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * No camera RTCPU is needed. The image has the trace memory layout set up
+ * by rtcpu_trace_init_memory() in tegra-rtcpu-trace.c. Events of every
+ * type the dump tool decodes are written from index 0 on, wrapping around
+ * the ring like the firmware does, and event_next_idx is left after the
+ * last one. The oldest entry still in the ring is printed on stdout, to be
+ * passed to tegra_rtcpu_trace_dump -s. With -x the tool checks a dump
+ * binary against images of several ring sizes and event counts, with and
+ * without a type filter.
+ *
+ * Build:
+ *	cc -I../../include -o tegra_rtcpu_trace_gen tegra_rtcpu_trace_gen.c
+ *
+ * Example Usage:
+ *	tegra_rtcpu_trace_gen -f ring.bin -e expected.txt -n 5000
+ *	tegra_rtcpu_trace_gen -x ./tegra_rtcpu_trace_dump
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include "soc/tegra/camrtc-trace.h"
+
+#define DEFAULT_ENTRIES		1024
+
+static const char * const type_names[] = {
+	"array", "exception", "pad", "start", "string", "bulk",
+};
+
+/* Types the firmware logs into the event ring, in the order used here */
+static const uint32_t gen_types[] = {
+	CAMRTC_EVENT_TYPE_ARRAY,
+	CAMRTC_EVENT_TYPE_STRING,
+	CAMRTC_EVENT_TYPE_BULK,
+	CAMRTC_EVENT_TYPE_START,
+	CAMRTC_EVENT_TYPE_PAD,
+};
+
+/* Fill event number n with a payload derived from n */
+static void make_event(struct camrtc_event_struct *event, uint64_t n)
+{
+	uint32_t type = gen_types[n % (sizeof(gen_types) /
+				       sizeof(gen_types[0]))];
+	uint32_t payload, i;
+
+	memset(event, 0, sizeof(*event));
+
+	switch (type) {
+	case CAMRTC_EVENT_TYPE_ARRAY:
+		payload = 4 * (1 + n % (CAMRTC_TRACE_EVENT_PAYLOAD_SIZE / 4));
+		for (i = 0; i < payload / 4; i++)
+			event->data.data32[i] = (uint32_t)(n * 0x9e3779b1U + i);
+		break;
+	case CAMRTC_EVENT_TYPE_STRING:
+		/* a full-length string has no terminator in the ring */
+		payload = snprintf((char *)event->data.data8,
+				   CAMRTC_TRACE_EVENT_PAYLOAD_SIZE,
+				   "event %" PRIu64 " %s", n,
+				   n % 3 ? "ok" :
+				   "with a message long enough to fill it up");
+		if (payload >= CAMRTC_TRACE_EVENT_PAYLOAD_SIZE) {
+			payload = CAMRTC_TRACE_EVENT_PAYLOAD_SIZE;
+			event->data.data8[payload - 1] = 'x';
+		}
+		break;
+	case CAMRTC_EVENT_TYPE_BULK:
+		payload = 1 + n % CAMRTC_TRACE_EVENT_PAYLOAD_SIZE;
+		for (i = 0; i < payload; i++)
+			event->data.data8[i] = (uint8_t)(n + i);
+		break;
+	default:
+		payload = 0;
+		break;
+	}
+
+	event->header.len = CAMRTC_TRACE_EVENT_HEADER_SIZE + payload;
+	event->header.id = CAMRTC_EVENT_MAKE_ID(type,
+		n % 16, (uint32_t)(n & 0xffff));
+	event->header.tstamp = 1000000ULL + n * 31;
+}
+
+/* Same format as decode_event() in tegra_rtcpu_trace_dump.c */
+static void print_expected(FILE *out, const struct camrtc_event_struct *event)
+{
+	uint32_t id = event->header.id;
+	uint32_t type = CAMRTC_EVENT_TYPE_FROM_ID(id);
+	uint32_t payload = event->header.len - CAMRTC_TRACE_EVENT_HEADER_SIZE;
+	uint32_t i;
+
+	fprintf(out, "%20" PRIu64 " %-9s mod %3u sub 0x%04x",
+		event->header.tstamp, type_names[type],
+		CAMRTC_EVENT_MODULE_FROM_ID(id),
+		CAMRTC_EVENT_SUBID_FROM_ID(id));
+
+	switch (type) {
+	case CAMRTC_EVENT_TYPE_ARRAY:
+		for (i = 0; i < payload / 4; i++)
+			fprintf(out, " 0x%08x", event->data.data32[i]);
+		break;
+	case CAMRTC_EVENT_TYPE_STRING:
+		fprintf(out, " %.*s", (int)payload,
+			(const char *)event->data.data8);
+		break;
+	case CAMRTC_EVENT_TYPE_BULK:
+		for (i = 0; i < payload; i++)
+			fprintf(out, " %02x", event->data.data8[i]);
+		break;
+	default:
+		break;
+	}
+
+	fprintf(out, "\n");
+}
+
+static int generate(const char *image_path, const char *expected_path,
+		    uint32_t entries, uint64_t count, uint32_t *oldest_out)
+{
+	struct camrtc_trace_memory_header header = {
+		.signature[0] = CAMRTC_TRACE_SIGNATURE_1,
+		.signature[1] = CAMRTC_TRACE_SIGNATURE_2,
+		.revision = 1,
+		.exception_offset = CAMRTC_TRACE_EXCEPTION_OFFSET,
+		.exception_size = CAMRTC_TRACE_EXCEPTION_SIZE,
+		.exception_entries = 7,
+		.event_offset = CAMRTC_TRACE_EVENT_OFFSET,
+		.event_size = CAMRTC_TRACE_EVENT_SIZE,
+		.event_entries = entries,
+	};
+	size_t size = CAMRTC_TRACE_EVENT_OFFSET +
+		(size_t)entries * CAMRTC_TRACE_EVENT_SIZE;
+	struct camrtc_event_struct *events;
+	uint64_t n, first;
+	uint32_t oldest;
+	uint8_t *image;
+	FILE *out;
+	int ret = 0;
+
+	image = calloc(1, size);
+	if (!image) {
+		fprintf(stderr, "Failed to allocate %zu bytes\n", size);
+		return -ENOMEM;
+	}
+	events = (struct camrtc_event_struct *)(image +
+						CAMRTC_TRACE_EVENT_OFFSET);
+
+	for (n = 0; n < count; n++)
+		make_event(&events[n % entries], n);
+
+	header.event_next_idx = count % entries;
+	memcpy(image, &header, sizeof(header));
+
+	/* The entry at event_next_idx is the next to be overwritten */
+	first = count < entries ? 0 : count - (entries - 1);
+	oldest = first % entries;
+
+	out = fopen(image_path, "w");
+	if (!out || fwrite(image, size, 1, out) != 1) {
+		perror("Failed to write ring image");
+		ret = -errno;
+	}
+	if (out)
+		fclose(out);
+
+	if (!ret && expected_path) {
+		out = fopen(expected_path, "w");
+		if (!out) {
+			perror("Failed to open expected output");
+			ret = -errno;
+		} else {
+			for (n = first; n < count; n++)
+				print_expected(out, &events[n % entries]);
+			fclose(out);
+		}
+	}
+
+	*oldest_out = oldest;
+
+	free(image);
+	return ret;
+}
+
+static char *read_all(FILE *in, size_t *len)
+{
+	size_t cap = 4096, n = 0, got;
+	char *buf = malloc(cap), *tmp;
+
+	while (buf && (got = fread(buf + n, 1, cap - n, in)) > 0) {
+		n += got;
+		if (n == cap) {
+			cap *= 2;
+			tmp = realloc(buf, cap);
+			if (!tmp)
+				free(buf);
+			buf = tmp;
+		}
+	}
+	*len = n;
+	return buf;
+}
+
+/* Keep only the lines of one event type, the name starts at column 21 */
+static size_t filter_type(char *buf, size_t len, const char *name)
+{
+	size_t in = 0, out = 0, end, name_len = strlen(name);
+
+	while (in < len) {
+		for (end = in; end < len && buf[end] != '\n'; end++)
+			;
+		if (end < len)
+			end++;
+		if (end - in > 21 + name_len &&
+		    !strncmp(buf + in + 21, name, name_len) &&
+		    buf[in + 21 + name_len] == ' ') {
+			memmove(buf + out, buf + in, end - in);
+			out += end - in;
+		}
+		in = end;
+	}
+	return out;
+}
+
+static int check_case(const char *dump_path, const char *image_path,
+		      const char *expected_path, uint32_t entries,
+		      uint64_t count, int type_filter)
+{
+	char cmd[4096], *want, *got;
+	size_t want_len, got_len;
+	uint32_t oldest;
+	FILE *in;
+	int ret;
+
+	if (generate(image_path, expected_path, entries, count, &oldest))
+		return -1;
+
+	in = fopen(expected_path, "r");
+	if (!in)
+		return -1;
+	want = read_all(in, &want_len);
+	fclose(in);
+
+	if (type_filter >= 0) {
+		snprintf(cmd, sizeof(cmd), "%s -f %s -s %u -t %d", dump_path,
+			 image_path, oldest, type_filter);
+		want_len = filter_type(want, want_len,
+				       type_names[type_filter]);
+	} else {
+		snprintf(cmd, sizeof(cmd), "%s -f %s -s %u", dump_path,
+			 image_path, oldest);
+	}
+
+	in = popen(cmd, "r");
+	if (!in) {
+		free(want);
+		return -1;
+	}
+	got = read_all(in, &got_len);
+	ret = pclose(in);
+
+	if (ret || !want || !got || got_len != want_len ||
+	    memcmp(want, got, want_len)) {
+		fprintf(stderr, "FAIL: %u entries, %" PRIu64 " events, type %d"
+			": %zu bytes decoded, %zu expected\n", entries, count,
+			type_filter, got_len, want_len);
+		ret = -1;
+	}
+
+	free(want);
+	free(got);
+	return ret ? -1 : 0;
+}
+
+/* Run the dump tool over rings that are empty, partly full and wrapped */
+static int check_dump(const char *dump_path)
+{
+	static const uint32_t ring_entries[] = { 2, 7, DEFAULT_ENTRIES };
+	char image_path[] = "/tmp/rtcpu_trace_ringXXXXXX";
+	char expected_path[] = "/tmp/rtcpu_trace_expXXXXXX";
+	uint64_t counts[6];
+	unsigned int r, c, cases = 0, failed = 0;
+	int fd_image, fd_expected;
+
+	fd_image = mkstemp(image_path);
+	fd_expected = mkstemp(expected_path);
+	if (fd_image < 0 || fd_expected < 0) {
+		perror("Failed to create temporary files");
+		return 1;
+	}
+	close(fd_image);
+	close(fd_expected);
+
+	for (r = 0; r < sizeof(ring_entries) / sizeof(ring_entries[0]); r++) {
+		uint32_t entries = ring_entries[r];
+
+		counts[0] = 0;
+		counts[1] = 1;
+		counts[2] = entries - 1;
+		counts[3] = entries;
+		counts[4] = entries + 1;
+		counts[5] = 5ULL * entries + 3;
+
+		for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+			cases += 2;
+			if (check_case(dump_path, image_path, expected_path,
+				       entries, counts[c], -1))
+				failed++;
+			if (check_case(dump_path, image_path, expected_path,
+				       entries, counts[c],
+				       CAMRTC_EVENT_TYPE_STRING))
+				failed++;
+		}
+	}
+
+	unlink(image_path);
+	unlink(expected_path);
+
+	fprintf(stdout, "%u of %u ring images decoded as expected\n",
+		cases - failed, cases);
+	if (failed)
+		return 1;
+	fprintf(stdout, "PASS\n");
+	return 0;
+}
+
+void print_usage(char *bin_name)
+{
+	fprintf(stderr, "Usage: %s [options]...\n"
+		"Write a synthetic camera RTCPU trace ring image\n"
+		"  -f <path>  Ring image to write\n"
+		" [-e <path>] Write the expected decode of the image\n"
+		" [-n <n>]    Number of events to log (default %u)\n"
+		" [-r <n>]    Ring entries (default %u)\n"
+		"  -x <path>  Check tegra_rtcpu_trace_dump against images\n"
+		"  -h         This helptext\n"
+		"\n"
+		"Prints the oldest entry still in the ring.\n"
+		"\n"
+		"Example:\n"
+		"%s -f ring.bin -e expected.txt -n 5000\n"
+		"(means log 5000 events, so the ring wraps 4 times)\n"
+		"%s -x ./tegra_rtcpu_trace_dump\n",
+		bin_name, DEFAULT_ENTRIES, DEFAULT_ENTRIES, bin_name, bin_name
+	);
+}
+
+int main(int argc, char **argv)
+{
+	const char *image_path = NULL;
+	const char *expected_path = NULL;
+	const char *dump_path = NULL;
+	uint32_t entries = DEFAULT_ENTRIES;
+	uint64_t count = DEFAULT_ENTRIES;
+	uint32_t oldest;
+	int c;
+
+	while ((c = getopt(argc, argv, "e:f:n:r:x:h")) != -1) {
+		switch (c) {
+		case 'e':
+			expected_path = optarg;
+			break;
+		case 'f':
+			image_path = optarg;
+			break;
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		case 'r':
+			entries = strtoul(optarg, NULL, 0);
+			break;
+		case 'x':
+			dump_path = optarg;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (dump_path)
+		return check_dump(dump_path);
+
+	if (!image_path || entries < 2) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (generate(image_path, expected_path, entries, count, &oldest))
+		return 1;
+
+	fprintf(stdout, "%u\n", oldest);
+	return 0;
+}
@@ -0,0 +1,374 @@
+/*
+ * tegra_udrm_loopback - inject vblank events into tegra-udrm and read them
+ * back on the same DRM fd to measure events/s, one event per ioctl or
+ * batched with DRM_IOCTL_TEGRA_UDRM_SEND_EVENTS. Optionally measures the
+ * rate of repeated DMABUF_MMAP calls for the same buffer.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * tegra-udrm is a virtual DRM device, so this runs without any display
+ * attached. Events are queued to the injecting file, which reads them back.
+ * The -m test needs /dev/udmabuf to create the dma-buf.
+ *
+ * Build:
+ *	cc -O2 -I../../include/uapi -o tegra_udrm_loopback tegra_udrm_loopback.c
+ *
+ * Example Usage:
+ *	tegra_udrm_loopback -d /dev/dri/card0 -n 1000000
+ *	tegra_udrm_loopback -b 1 -n 100000
+ *	tegra_udrm_loopback -b 4 -n 1000000 -m 100000
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/udmabuf.h>
+#include <drm/drm.h>
+#include <drm/tegra_udrm.h>
+
+#define UDRM_NAME	"tegra-udrm"
+
+/* a DRM file holds at most 4096 bytes of undelivered events */
+#define MAX_IN_FLIGHT	(4096 / sizeof(struct drm_event_vblank))
+
+static double elapsed_s(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) +
+		(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static bool is_udrm(int fd)
+{
+	struct drm_version ver;
+	char name[32];
+
+	memset(&ver, 0, sizeof(ver));
+	memset(name, 0, sizeof(name));
+	ver.name = name;
+	ver.name_len = sizeof(name) - 1;
+
+	if (ioctl(fd, DRM_IOCTL_VERSION, &ver))
+		return false;
+
+	return !strcmp(name, UDRM_NAME);
+}
+
+static int open_udrm(const char *dev)
+{
+	char path[32];
+	int fd, i;
+
+	if (dev) {
+		fd = open(dev, O_RDWR | O_CLOEXEC);
+		if (fd < 0) {
+			fprintf(stderr, "Failed to open %s: %s\n", dev,
+				strerror(errno));
+			return -1;
+		}
+		if (!is_udrm(fd)) {
+			fprintf(stderr, "%s is not %s\n", dev, UDRM_NAME);
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	for (i = 0; i < 16; i++) {
+		snprintf(path, sizeof(path), "/dev/dri/card%d", i);
+		fd = open(path, O_RDWR | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		if (is_udrm(fd)) {
+			fprintf(stdout, "Using %s\n", path);
+			return fd;
+		}
+		close(fd);
+	}
+
+	fprintf(stderr, "No %s device found\n", UDRM_NAME);
+	return -1;
+}
+
+static void make_vblank(struct drm_event_vblank *vbl, uint32_t seq)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	memset(vbl, 0, sizeof(*vbl));
+	vbl->base.type = (seq & 1) ? DRM_EVENT_FLIP_COMPLETE :
+		DRM_EVENT_VBLANK;
+	vbl->base.length = sizeof(*vbl);
+	vbl->user_data = seq;
+	vbl->sequence = seq;
+	vbl->tv_sec = ts.tv_sec;
+	vbl->tv_usec = ts.tv_nsec / 1000;
+}
+
+static int send_events(int fd, uint32_t seq, unsigned int batch)
+{
+	struct drm_tegra_udrm_event events[DRM_TEGRA_UDRM_MAX_EVENTS];
+	struct drm_tegra_udrm_send_events args;
+	struct drm_tegra_udrm_send_vblank_event one;
+	unsigned int i;
+
+	if (batch == 1) {
+		make_vblank(&one.vblank, seq);
+		return ioctl(fd, DRM_IOCTL_TEGRA_UDRM_SEND_VBLANK_EVENT, &one);
+	}
+
+	memset(events, 0, sizeof(events));
+	for (i = 0; i < batch; i++) {
+		events[i].type = DRM_TEGRA_UDRM_EVENT_VBLANK;
+		make_vblank(&events[i].u.vblank, seq + i);
+	}
+
+	memset(&args, 0, sizeof(args));
+	args.events = (uintptr_t)events;
+	args.num_events = batch;
+
+	if (ioctl(fd, DRM_IOCTL_TEGRA_UDRM_SEND_EVENTS, &args))
+		return -1;
+	if (args.num_sent != batch) {
+		fprintf(stderr, "Only %u of %u events sent\n", args.num_sent,
+			batch);
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* read back and check 'count' events, starting at sequence 'seq' */
+static int read_events(int fd, uint32_t seq, unsigned int count)
+{
+	struct drm_event_vblank buf[MAX_IN_FLIGHT];
+	unsigned int got = 0, i, n;
+	ssize_t ret;
+
+	while (got < count) {
+		ret = read(fd, buf, sizeof(buf));
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Failed to read events: %s\n",
+				strerror(errno));
+			return -1;
+		}
+
+		n = ret / sizeof(buf[0]);
+		for (i = 0; i < n; i++, got++) {
+			if (buf[i].base.length != sizeof(buf[0]) ||
+			    buf[i].sequence != seq + got) {
+				fprintf(stderr,
+					"Bad event %u: type %u len %u seq %u\n",
+					seq + got, buf[i].base.type,
+					buf[i].base.length, buf[i].sequence);
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int run_events(int fd, unsigned long total, unsigned int batch,
+		      unsigned int depth)
+{
+	struct timespec start;
+	unsigned long sent = 0, ioctls = 0;
+	unsigned int queued;
+	uint32_t seq = 0;
+	double t;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (sent < total) {
+		/* queue up to 'depth' events, then drain them */
+		for (queued = 0; queued + batch <= depth && sent < total;
+		     queued += batch, sent += batch) {
+			if (send_events(fd, seq + queued, batch)) {
+				fprintf(stderr, "Failed to send events: %s\n",
+					strerror(errno));
+				return -1;
+			}
+			ioctls++;
+		}
+
+		if (read_events(fd, seq, queued))
+			return -1;
+		seq += queued;
+	}
+
+	t = elapsed_s(&start);
+	fprintf(stdout,
+		"events: %lu in %.3f s, %.0f events/s, %lu ioctls, batch %u\n",
+		sent, t, sent / t, ioctls, batch);
+
+	return 0;
+}
+
+static int run_mmap(int fd, unsigned long total)
+{
+	struct drm_tegra_udrm_dmabuf_destroy_mappings destroy;
+	struct drm_tegra_udrm_dmabuf_mmap args;
+	struct udmabuf_create create;
+	struct timespec start;
+	unsigned long offset = 0, i;
+	int memfd, ufd, buf_fd;
+	long page = sysconf(_SC_PAGESIZE);
+	int ret = -1;
+	double t;
+
+	ufd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (ufd < 0) {
+		fprintf(stderr, "Failed to open /dev/udmabuf: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	memfd = memfd_create("tegra_udrm_loopback", MFD_ALLOW_SEALING);
+	if (memfd < 0 || ftruncate(memfd, page) ||
+	    fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK)) {
+		fprintf(stderr, "Failed to create memfd: %s\n",
+			strerror(errno));
+		goto close_ufd;
+	}
+
+	memset(&create, 0, sizeof(create));
+	create.memfd = memfd;
+	create.size = page;
+	buf_fd = ioctl(ufd, UDMABUF_CREATE, &create);
+	if (buf_fd < 0) {
+		fprintf(stderr, "Failed to create dma-buf: %s\n",
+			strerror(errno));
+		goto close_memfd;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < total; i++) {
+		memset(&args, 0, sizeof(args));
+		args.fd = buf_fd;
+		if (ioctl(fd, DRM_IOCTL_TEGRA_UDRM_DMABUF_MMAP, &args)) {
+			fprintf(stderr, "DMABUF_MMAP failed: %s\n",
+				strerror(errno));
+			goto close_buf;
+		}
+
+		/* the offset must stay the same for the same buffer */
+		if (i && args.offset != offset) {
+			fprintf(stderr, "Offset changed: 0x%lx -> 0x%lx\n",
+				offset, args.offset);
+			goto close_buf;
+		}
+		offset = args.offset;
+	}
+	t = elapsed_s(&start);
+
+	fprintf(stdout, "mmap offsets: %lu in %.3f s, %.0f calls/s\n",
+		total, t, total / t);
+	ret = 0;
+
+close_buf:
+	memset(&destroy, 0, sizeof(destroy));
+	destroy.fd = buf_fd;
+	ioctl(fd, DRM_IOCTL_TEGRA_UDRM_DMABUF_DESTROY_MAPPINGS, &destroy);
+	close(buf_fd);
+close_memfd:
+	if (memfd >= 0)
+		close(memfd);
+close_ufd:
+	close(ufd);
+	return ret;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: tegra_udrm_loopback [options]...\n"
+		"Inject vblank events into tegra-udrm and read them back\n"
+		"  -d <name>  Use this DRM device (default: search card0-15)\n"
+		"  -n <n>     Number of events to inject (default: 1000000)\n"
+		"  -b <n>     Events per ioctl, 1 uses SEND_VBLANK_EVENT\n"
+		"             (default: %d)\n"
+		"  -q <n>     Events queued before reading back (default: %zu)\n"
+		"  -m <n>     Also time <n> DMABUF_MMAP calls on one buffer\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"tegra_udrm_loopback -b 1 -n 100000\n"
+		"tegra_udrm_loopback -b 4 -n 1000000 -m 100000\n",
+		DRM_TEGRA_UDRM_MAX_EVENTS, MAX_IN_FLIGHT);
+}
+
+int main(int argc, char **argv)
+{
+	const char *device = NULL;
+	unsigned long total = 1000000, mmaps = 0;
+	unsigned int batch = DRM_TEGRA_UDRM_MAX_EVENTS;
+	unsigned int depth = MAX_IN_FLIGHT;
+	int fd, c, ret = 0;
+
+	while ((c = getopt(argc, argv, "d:n:b:q:m:?")) != -1) {
+		switch (c) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'n':
+			total = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			batch = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			mmaps = strtoul(optarg, NULL, 0);
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (!batch || batch > DRM_TEGRA_UDRM_MAX_EVENTS) {
+		fprintf(stderr, "Batch must be 1 to %d\n",
+			DRM_TEGRA_UDRM_MAX_EVENTS);
+		return -1;
+	}
+	if (depth > MAX_IN_FLIGHT)
+		depth = MAX_IN_FLIGHT;
+	if (depth < batch) {
+		fprintf(stderr, "Queue depth must be at least the batch\n");
+		return -1;
+	}
+
+	fd = open_udrm(device);
+	if (fd < 0)
+		return -1;
+
+	if (total)
+		ret = run_events(fd, total, batch, depth);
+	if (!ret && mmaps)
+		ret = run_mmap(fd, mmaps);
+
+	close(fd);
+	return ret;
+}
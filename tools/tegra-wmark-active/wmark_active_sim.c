@@ -0,0 +1,564 @@
+/*
+ * wmark_active_sim - run a load trace through a model of the wmark_active
+ * devfreq governor and the activity monitor watermarks, and compare the
+ * fixed watermarks with the learned hysteresis by OPP transitions,
+ * ping-pong, unserved demand and an energy estimate.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * The governor model follows devfreq_watermark_target_freq(),
+ * update_watermarks() and wmark_account_transition() in
+ * drivers/devfreq/governor_wmark_active.c and must be kept in sync with
+ * them. No device is needed. The trace is a text file with one demand step
+ * per line, "<time_us> <demand_mhz>", with '#' starting a comment. The
+ * demand holds until the next line. Load is the demand over the current
+ * frequency. The activity monitor raises a watermark interrupt after the
+ * given number of consecutive samples above the high or below the low
+ * watermark, which re-runs the governor. Without a trace, a demand that
+ * swings around an OPP boundary with noise is generated.
+ *
+ * Energy assumes the clock runs all the time with voltage linear in
+ * frequency (f^3 per unit of time), relative to staying at the maximum
+ * frequency.
+ *
+ * Build:
+ *	cc -O2 -o wmark_active_sim wmark_active_sim.c
+ *
+ * Example Usage:
+ *	wmark_active_sim -b 700 -a 100 -p 30000 -r 80
+ *	wmark_active_sim -t emc_demand.txt -s 1000 -c 2
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+
+#define MAX_FREQS	64
+
+struct step {
+	int64_t time_us;
+	double demand_mhz;
+};
+
+/* governor tunables, defaults from devfreq_watermark_start() */
+struct wmark_gov_param {
+	unsigned int block_window;
+	unsigned int load_target;
+	unsigned int load_max;
+	unsigned int smooth;
+	bool freq_boost_en;
+	unsigned int hyst_max;
+	unsigned int osc_window;
+};
+
+/* subset of struct wmark_gov_info plus the activity monitor */
+struct wmark_gov_info {
+	struct wmark_gov_param param;
+
+	unsigned int osc_count;
+	unsigned int hyst;
+	int last_idx;
+	int prev_idx;
+	int64_t last_change;
+
+	int64_t last_frequency_update;
+	unsigned long long average_target_freq;
+
+	unsigned int low_wmark;
+	unsigned int high_wmark;
+	double busy_us;
+	double total_us;
+};
+
+struct sim_result {
+	unsigned long trans;
+	unsigned long irqs;
+	unsigned int osc;
+	double freq_time;
+	double short_mcycles;
+	double demand_mcycles;
+	double energy;
+	double span_us;
+	double time_in_state[MAX_FREQS];
+};
+
+static unsigned long freqlist[MAX_FREQS];
+static int freq_count;
+
+static unsigned long freqlist_up(unsigned long curr_freq)
+{
+	int i;
+
+	for (i = 0; i < freq_count; i++)
+		if (freqlist[i] > curr_freq)
+			break;
+
+	return freqlist[i < freq_count ? i : freq_count - 1];
+}
+
+static unsigned long freqlist_down(unsigned long curr_freq)
+{
+	int i;
+
+	for (i = freq_count - 1; i >= 0; i--)
+		if (freqlist[i] < curr_freq)
+			break;
+
+	return freqlist[i > 0 ? i : 0];
+}
+
+static unsigned long freqlist_round(unsigned long freq)
+{
+	int i;
+
+	for (i = 0; i < freq_count; i++)
+		if (freqlist[i] >= freq)
+			break;
+
+	return freqlist[i < freq_count ? i : freq_count - 1];
+}
+
+static int freqlist_index(unsigned long freq)
+{
+	int i;
+
+	for (i = 0; i < freq_count - 1; i++)
+		if (freqlist[i] >= freq)
+			break;
+
+	return i;
+}
+
+static void wmark_account_transition(struct wmark_gov_info *w,
+				     unsigned long freq, int64_t now,
+				     struct sim_result *r)
+{
+	int idx = freqlist_index(freq);
+	unsigned int hyst_max = w->param.hyst_max;
+	int64_t dt;
+
+	if (idx == w->last_idx)
+		return;
+
+	dt = now - w->last_change;
+	r->trans++;
+
+	if (idx == w->prev_idx && dt < w->param.osc_window) {
+		w->osc_count++;
+		w->hyst += hyst_max / 4 > 1 ? hyst_max / 4 : 1;
+		if (w->hyst > hyst_max)
+			w->hyst = hyst_max;
+	} else {
+		w->hyst /= 2;
+	}
+
+	w->prev_idx = w->last_idx;
+	w->last_idx = idx;
+	w->last_change = now;
+}
+
+static void update_watermarks(struct wmark_gov_info *w,
+			      unsigned long current_frequency,
+			      unsigned long ideal_frequency)
+{
+	unsigned long long relation = 0, next_freq = 0;
+	unsigned long long current_frequency_khz = current_frequency / 1000;
+	unsigned int hyst = w->hyst;
+	struct wmark_gov_param param = w->param;
+
+	if (ideal_frequency == freqlist[0]) {
+		w->low_wmark = 0;
+	} else {
+		next_freq = freqlist_down(ideal_frequency);
+		relation = ((next_freq / current_frequency_khz) *
+			(param.load_target - (hyst < param.load_target ?
+					      hyst : param.load_target))) /
+			1000;
+		w->low_wmark = relation;
+	}
+
+	if (ideal_frequency == freqlist[freq_count - 1]) {
+		w->high_wmark = 1000;
+	} else {
+		next_freq = freqlist_up(ideal_frequency);
+		relation = ((next_freq / current_frequency_khz) *
+			(param.load_target + hyst)) / 1000;
+		if (relation > param.load_max)
+			relation = param.load_max;
+		w->high_wmark = relation;
+	}
+}
+
+static unsigned long target_freq(struct wmark_gov_info *w, int64_t now,
+				 unsigned long current_frequency)
+{
+	struct wmark_gov_param param = w->param;
+	unsigned long long load, relation, ideal_freq, lower;
+	unsigned int hyst;
+	unsigned long freq;
+
+	/* dev_stat covers the time since the last call */
+	if (w->total_us < 1)
+		return current_frequency;
+
+	load = w->busy_us * 1000 / w->total_us;
+	w->busy_us = 0;
+	w->total_us = 0;
+
+	if (param.freq_boost_en && load >= param.load_max) {
+		ideal_freq = freqlist[freq_count - 1];
+	} else {
+		hyst = w->hyst;
+		relation = (load * 1000) / (param.load_target + hyst);
+		ideal_freq = relation * (current_frequency / 1000);
+
+		if (ideal_freq <= current_frequency) {
+			lower = param.load_target - (hyst < param.load_target ?
+						     hyst : param.load_target);
+			relation = (load * 1000) / (lower > 1 ? lower : 1);
+			ideal_freq = relation * (current_frequency / 1000);
+			if (ideal_freq > current_frequency)
+				ideal_freq = current_frequency;
+		}
+
+		ideal_freq = freqlist_round(ideal_freq);
+	}
+
+	w->average_target_freq =
+		(param.smooth * w->average_target_freq + ideal_freq) /
+		(param.smooth + 1);
+
+	if (now - w->last_frequency_update < param.block_window)
+		return current_frequency;
+
+	freq = freqlist_round(w->average_target_freq);
+	if (freq == current_frequency)
+		return freq;
+
+	w->last_frequency_update = now;
+
+	return freq;
+}
+
+static double demand_at(const struct step *steps, unsigned long nsteps,
+			unsigned long *pos, int64_t t)
+{
+	while (*pos + 1 < nsteps && steps[*pos + 1].time_us <= t)
+		(*pos)++;
+
+	return steps[*pos].demand_mhz;
+}
+
+static void simulate(const struct wmark_gov_param *param,
+		     const struct step *steps, unsigned long nsteps,
+		     int64_t sample_us, int64_t poll_us,
+		     unsigned int consecutive, struct sim_result *r)
+{
+	struct wmark_gov_info w;
+	unsigned long freq = freqlist[freq_count - 1], next;
+	double fmax = freqlist[freq_count - 1] / 1e6, mhz, demand, busy;
+	int64_t now = 0, end = steps[nsteps - 1].time_us, last_poll = 0;
+	unsigned int above = 0, below = 0, load;
+	unsigned long pos = 0;
+	bool irq;
+
+	memset(&w, 0, sizeof(w));
+	memset(r, 0, sizeof(*r));
+	w.param = *param;
+	w.average_target_freq = freq;
+	w.last_idx = freqlist_index(freq);
+	w.prev_idx = -1;
+	update_watermarks(&w, freq, freq);
+
+	while (now < end) {
+		demand = demand_at(steps, nsteps, &pos, now);
+		mhz = freq / 1e6;
+		busy = demand < mhz ? demand / mhz : 1;
+
+		r->demand_mcycles += demand * sample_us / 1e6;
+		if (demand > mhz)
+			r->short_mcycles += (demand - mhz) * sample_us / 1e6;
+		r->freq_time += mhz * sample_us;
+		r->energy += (mhz / fmax) * (mhz / fmax) * (mhz / fmax) *
+			     sample_us;
+		r->time_in_state[freqlist_index(freq)] += sample_us;
+
+		w.busy_us += busy * sample_us;
+		w.total_us += sample_us;
+		now += sample_us;
+
+		/* activity monitor watermarks */
+		load = busy * 1000;
+		above = load > w.high_wmark ? above + 1 : 0;
+		below = load < w.low_wmark ? below + 1 : 0;
+		irq = above >= consecutive || below >= consecutive;
+
+		if (!irq && !(poll_us && now - last_poll >= poll_us))
+			continue;
+
+		if (irq)
+			r->irqs++;
+		above = 0;
+		below = 0;
+		last_poll = now;
+
+		/* update_devfreq() and the POSTCHANGE notifier */
+		next = target_freq(&w, now, freq);
+		wmark_account_transition(&w, next, now, r);
+		update_watermarks(&w, next, next);
+		freq = next;
+	}
+
+	r->osc = w.osc_count;
+	r->span_us = now;
+}
+
+static void report(const char *name, const struct sim_result *r)
+{
+	fprintf(stdout, "%-10s %8lu %8u %8lu %8.0f %7.2f%% %7.3f\n", name,
+		r->trans, r->osc, r->irqs, r->freq_time / r->span_us,
+		r->demand_mcycles ?
+			100 * r->short_mcycles / r->demand_mcycles : 0,
+		r->energy / r->span_us);
+}
+
+static void report_states(const struct sim_result *a,
+			  const struct sim_result *b)
+{
+	int i;
+
+	fprintf(stdout, "\n%8s %10s %10s\n", "MHz", "fixed %", "learned %");
+	for (i = 0; i < freq_count; i++)
+		fprintf(stdout, "%8lu %10.1f %10.1f\n", freqlist[i] / 1000000,
+			100 * a->time_in_state[i] / a->span_us,
+			100 * b->time_in_state[i] / b->span_us);
+}
+
+static struct step *load_trace(const char *path, unsigned long *nsteps)
+{
+	struct step *steps = NULL, *tmp;
+	unsigned long n = 0, size = 0;
+	char line[256];
+	long long t;
+	double mhz;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", path,
+			strerror(errno));
+		return NULL;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || sscanf(line, "%lld %lf", &t, &mhz) != 2)
+			continue;
+		if (n && t <= steps[n - 1].time_us) {
+			fprintf(stderr, "%s: times must increase\n", path);
+			goto fail;
+		}
+		if (n == size) {
+			size = size ? size * 2 : 1024;
+			tmp = realloc(steps, size * sizeof(*steps));
+			if (!tmp)
+				goto fail;
+			steps = tmp;
+		}
+		steps[n].time_us = t;
+		steps[n].demand_mhz = mhz;
+		n++;
+	}
+
+	fclose(f);
+	*nsteps = n;
+	return steps;
+
+fail:
+	fclose(f);
+	free(steps);
+	return NULL;
+}
+
+static struct step *gen_demand(int64_t duration_us, int64_t step_us,
+			       double base, double amplitude,
+			       int64_t period_us, double noise,
+			       unsigned long *nsteps)
+{
+	unsigned long i, n = duration_us / step_us + 1;
+	struct step *steps;
+	double d;
+
+	steps = calloc(n, sizeof(*steps));
+	if (!steps)
+		return NULL;
+
+	srand(1);
+	for (i = 0; i < n; i++) {
+		steps[i].time_us = i * step_us;
+		/* square wave between base - amplitude and base + amplitude */
+		d = (steps[i].time_us % period_us) < period_us / 2 ?
+			base - amplitude : base + amplitude;
+		d += noise * ((rand() % 2001) / 1000.0 - 1);
+		steps[i].demand_mhz = d > 0 ? d : 0;
+	}
+
+	*nsteps = n;
+	return steps;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: wmark_active_sim [options]...\n"
+		"Run a demand trace through the wmark_active governor model\n"
+		"  -t <file>  Trace of \"<time_us> <demand_mhz>\" lines\n"
+		"  -b <MHz>   Synthetic mean demand (default: 700)\n"
+		"  -a <MHz>   Synthetic swing around the mean (default: 100)\n"
+		"  -p <us>    Synthetic swing period (default: 30000)\n"
+		"  -r <MHz>   Synthetic noise (default: 80)\n"
+		"  -T <us>    Synthetic duration (default: 10000000)\n"
+		"  -s <us>    Activity monitor sample period (default: 1000)\n"
+		"  -c <n>     Samples past a watermark to interrupt (default: 1)\n"
+		"  -P <us>    Governor polling interval, 0 for none (default: 0)\n"
+		"  -m <MHz>   Lowest frequency (default: 200)\n"
+		"  -M <MHz>   Highest frequency (default: 2000)\n"
+		"  -k <n>     Frequency steps, 2 to %d (default: 10)\n"
+		"  -w <us>    Block window (default: 50000)\n"
+		"  -H <n>     hyst_max for the learned run (default: 100)\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"wmark_active_sim -b 700 -a 100 -p 30000 -r 80\n"
+		"wmark_active_sim -t emc_demand.txt -s 1000 -c 2\n",
+		MAX_FREQS);
+}
+
+int main(int argc, char **argv)
+{
+	struct wmark_gov_param param = {
+		.block_window = 50000,
+		.load_target = 700,
+		.load_max = 900,
+		.smooth = 10,
+		.freq_boost_en = true,
+		.hyst_max = 100,
+	};
+	const char *trace = NULL;
+	int64_t duration_us = 10000000, period_us = 30000;
+	int64_t sample_us = 1000, poll_us = 0;
+	double base = 700, amplitude = 100, noise = 80;
+	double fmin = 200, fmax = 2000;
+	unsigned int consecutive = 1, hyst_max = 100;
+	struct sim_result fixed, learned;
+	unsigned long nsteps = 0;
+	struct step *steps;
+	int nfreq = 10, c, i;
+
+	while ((c = getopt(argc, argv, "t:b:a:p:r:T:s:c:P:m:M:k:w:H:?")) != -1) {
+		switch (c) {
+		case 't':
+			trace = optarg;
+			break;
+		case 'b':
+			base = strtod(optarg, NULL);
+			break;
+		case 'a':
+			amplitude = strtod(optarg, NULL);
+			break;
+		case 'p':
+			period_us = strtoll(optarg, NULL, 0);
+			break;
+		case 'r':
+			noise = strtod(optarg, NULL);
+			break;
+		case 'T':
+			duration_us = strtoll(optarg, NULL, 0);
+			break;
+		case 's':
+			sample_us = strtoll(optarg, NULL, 0);
+			break;
+		case 'c':
+			consecutive = strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			poll_us = strtoll(optarg, NULL, 0);
+			break;
+		case 'm':
+			fmin = strtod(optarg, NULL);
+			break;
+		case 'M':
+			fmax = strtod(optarg, NULL);
+			break;
+		case 'k':
+			nfreq = strtol(optarg, NULL, 0);
+			break;
+		case 'w':
+			param.block_window = strtoul(optarg, NULL, 0);
+			break;
+		case 'H':
+			hyst_max = strtoul(optarg, NULL, 0);
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (nfreq < 2 || nfreq > MAX_FREQS || fmin <= 0 || fmax <= fmin) {
+		fprintf(stderr, "Bad frequency range\n");
+		return -1;
+	}
+	if (sample_us <= 0 || period_us <= 1 || duration_us <= 0 ||
+	    poll_us < 0 || !consecutive || hyst_max > 1000) {
+		fprintf(stderr, "Bad sample period, duration or tunable\n");
+		return -1;
+	}
+	param.osc_window = 4 * param.block_window;
+
+	freq_count = nfreq;
+	for (i = 0; i < nfreq; i++)
+		freqlist[i] = (fmin + (fmax - fmin) * i / (nfreq - 1)) * 1e6;
+
+	if (trace)
+		steps = load_trace(trace, &nsteps);
+	else
+		steps = gen_demand(duration_us, sample_us, base, amplitude,
+				   period_us, noise, &nsteps);
+	if (!steps)
+		return -1;
+	if (nsteps < 2) {
+		fprintf(stderr, "Trace needs at least two lines\n");
+		free(steps);
+		return -1;
+	}
+
+	fprintf(stdout, "%.1f s, sample %lld us, %d steps %.0f-%.0f MHz\n",
+		(steps[nsteps - 1].time_us - steps[0].time_us) / 1e6,
+		(long long)sample_us, freq_count, fmin, fmax);
+	fprintf(stdout, "%-10s %8s %8s %8s %8s %8s %7s\n", "mode", "trans",
+		"osc", "irqs", "avg MHz", "unserved", "energy");
+
+	param.hyst_max = 0;
+	simulate(&param, steps, nsteps, sample_us, poll_us, consecutive,
+		 &fixed);
+	report("fixed", &fixed);
+
+	param.hyst_max = hyst_max;
+	simulate(&param, steps, nsteps, sample_us, poll_us, consecutive,
+		 &learned);
+	report("learned", &learned);
+
+	report_states(&fixed, &learned);
+
+	free(steps);
+	return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * trusty_ipc_loopback - send messages over a TIPC channel and read back the
+ * echoes to measure messages/s, MB/s and round trip latency of the
+ * write_iter()/read_iter() path.
+ *
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Without a TEE, load trusty-ipc with loopback=1. It adds a stand-in for the
+ * secure side that echoes every message on port com.nvidia.tipc.loopback of
+ * /dev/trusty-ipc-lb0. Any other device and port that echo work as well.
+ *
+ * Build:
+ *	cc -O2 -o trusty_ipc_loopback trusty_ipc_loopback.c
+ *
+ * Example Usage:
+ *	trusty_ipc_loopback -n 100000 -s 4080
+ *	trusty_ipc_loopback -n 100000 -s 64 -q 16
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+/* from drivers/trusty/trusty-ipc.c */
+#define TIPC_IOC_MAGIC		'r'
+#define TIPC_IOC_CONNECT	_IOW(TIPC_IOC_MAGIC, 0x80, char *)
+
+#define DEFAULT_DEV		"/dev/trusty-ipc-lb0"
+#define DEFAULT_PORT		"com.nvidia.tipc.loopback"
+
+/* PAGE_SIZE message buffer less the TIPC header */
+#define DEFAULT_MSG_SIZE	4080
+#define MAX_MSG_SIZE		65536
+#define MAX_DEPTH		32
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_msg(uint8_t *buf, size_t len, uint32_t seq)
+{
+	size_t i;
+
+	memcpy(buf, &seq, sizeof(seq));
+	for (i = sizeof(seq); i < len; i++)
+		buf[i] = (uint8_t)(seq + i);
+}
+
+static int check_msg(const uint8_t *buf, size_t len, uint32_t seq)
+{
+	uint32_t got;
+	size_t i;
+
+	memcpy(&got, buf, sizeof(got));
+	if (got != seq) {
+		fprintf(stderr, "Echo %u out of order, expected %u\n", got,
+			seq);
+		return -1;
+	}
+
+	for (i = sizeof(seq); i < len; i++) {
+		if (buf[i] != (uint8_t)(seq + i)) {
+			fprintf(stderr, "Echo %u corrupt at byte %zu\n", seq,
+				i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int run(int fd, unsigned long total, size_t size, unsigned int depth,
+	       int verify)
+{
+	static uint8_t txbuf[MAX_MSG_SIZE], rxbuf[MAX_MSG_SIZE];
+	double sent_at[MAX_DEPTH];
+	double start, t, lat, lat_sum = 0, lat_max = 0;
+	unsigned long sent = 0, done = 0;
+	ssize_t ret;
+
+	start = now_s();
+
+	while (done < total) {
+		/* keep up to 'depth' messages in flight */
+		while (sent < total && sent - done < depth) {
+			fill_msg(txbuf, size, (uint32_t)sent);
+			sent_at[sent % depth] = now_s();
+			ret = write(fd, txbuf, size);
+			if (ret != (ssize_t)size) {
+				fprintf(stderr, "write failed: %s\n",
+					ret < 0 ? strerror(errno) : "short");
+				return -1;
+			}
+			sent++;
+		}
+
+		ret = read(fd, rxbuf, sizeof(rxbuf));
+		if (ret != (ssize_t)size) {
+			fprintf(stderr, "read failed: %s\n",
+				ret < 0 ? strerror(errno) : "bad length");
+			return -1;
+		}
+
+		lat = now_s() - sent_at[done % depth];
+		lat_sum += lat;
+		if (lat > lat_max)
+			lat_max = lat;
+
+		if (verify && check_msg(rxbuf, size, (uint32_t)done))
+			return -1;
+		done++;
+	}
+
+	t = now_s() - start;
+	fprintf(stdout,
+		"msgs: %lu x %zu B in %.3f s, %.0f msgs/s, %.1f MB/s each way\n",
+		done, size, t, done / t, done * size / t / 1e6);
+	fprintf(stdout, "round trip: avg %.1f us, max %.1f us, depth %u\n",
+		lat_sum / done * 1e6, lat_max * 1e6, depth);
+
+	return 0;
+}
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: trusty_ipc_loopback [options]...\n"
+		"Send messages to an echo port over TIPC and read them back\n"
+		"  -d <name>  TIPC device (default: %s)\n"
+		"  -p <name>  Port to connect to (default: %s)\n"
+		"  -n <n>     Number of messages (default: 100000)\n"
+		"  -s <n>     Message size in bytes (default: %d)\n"
+		"  -q <n>     Messages in flight, 1 to %d (default: 1)\n"
+		"  -c         Skip checking the echoed data\n"
+		"  -?         This helptext\n"
+		"\n"
+		"Example:\n"
+		"trusty_ipc_loopback -n 100000 -s 4080\n"
+		"trusty_ipc_loopback -n 100000 -s 64 -q 16\n",
+		DEFAULT_DEV, DEFAULT_PORT, DEFAULT_MSG_SIZE, MAX_DEPTH);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = DEFAULT_DEV, *port = DEFAULT_PORT;
+	unsigned long total = 100000;
+	size_t size = DEFAULT_MSG_SIZE;
+	unsigned int depth = 1;
+	int verify = 1;
+	int fd, c, ret;
+
+	while ((c = getopt(argc, argv, "d:p:n:s:q:c?")) != -1) {
+		switch (c) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'p':
+			port = optarg;
+			break;
+		case 'n':
+			total = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			verify = 0;
+			break;
+		case '?':
+		default:
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (size < sizeof(uint32_t) || size > MAX_MSG_SIZE) {
+		fprintf(stderr, "Message size must be %zu to %d\n",
+			sizeof(uint32_t), MAX_MSG_SIZE);
+		return -1;
+	}
+	if (!depth || depth > MAX_DEPTH) {
+		fprintf(stderr, "Depth must be 1 to %d\n", MAX_DEPTH);
+		return -1;
+	}
+	if (!total)
+		return 0;
+
+	fd = open(dev, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", dev,
+			strerror(errno));
+		return -1;
+	}
+
+	if (ioctl(fd, TIPC_IOC_CONNECT, port) < 0) {
+		fprintf(stderr, "Failed to connect to %s: %s\n", port,
+			strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	ret = run(fd, total, size, depth, verify);
+
+	close(fd);
+	return ret;
+}